@@ -13,6 +13,9 @@
 #include <asm/smp_plat.h>
 #include <asm/tlbflush.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/tlb.h>
+
 /**********************************************************************/
 
 /*
@@ -105,6 +108,8 @@ void flush_tlb_kernel_page(unsigned long kaddr)
 void flush_tlb_range(struct vm_area_struct *vma,
                      unsigned long start, unsigned long end)
 {
+	trace_tlb_flush_user_range(start, end);
+
 	if (tlb_ops_need_broadcast()) {
 		struct tlb_args ta;
 		ta.ta_vma = vma;
@@ -118,6 +123,8 @@ void flush_tlb_range(struct vm_area_struct *vma,
 
 void flush_tlb_kernel_range(unsigned long start, unsigned long end)
 {
+	trace_tlb_flush_kernel_range(start, end);
+
 	if (tlb_ops_need_broadcast()) {
 		struct tlb_args ta;
 		ta.ta_start = start;
@@ -265,7 +265,8 @@ const struct clkops clkops_omap2_dflt = {
  * them do), then call ourselves, recursing on the parent clock.  This
  * can cause an entire branch of the clock tree to be powered off by
  * simply disabling one clock.  Intended to be called with the clockfw_lock
- * spinlock held.  No return value.
+ * spinlock held.  The usecount drops to 0 before the clock is stopped, see
+ * clk_usecount_add().  No return value.
  */
 void omap2_clk_disable(struct clk *clk)
 {
@@ -277,10 +278,11 @@ void omap2_clk_disable(struct clk *clk)
 
 	pr_debug("clock: %s: decrementing usecount\n", clk->name);
 
-	clk->usecount--;
-
-	if (clk->usecount > 0)
-		return;
+	/* clk_enable() may add users concurrently, without clockfw_lock */
+	do {
+		if (clk_usecount_add(clk, -1, 2))
+			return;
+	} while (cmpxchg(&clk->usecount, 1, 0) != 1);
 
 	pr_debug("clock: %s: disabling in hardware\n", clk->name);
 
@@ -304,8 +306,9 @@ void omap2_clk_disable(struct clk *clk)
  * previously, then recurse up the clock tree, enabling all of the
  * clock's parents and all of the parent clockdomains, and finally,
  * enabling @clk's clockdomain, and @clk itself.  Intended to be
- * called with the clockfw_lock spinlock held.  Returns 0 upon success
- * or a negative error code upon failure.
+ * called with the clockfw_lock spinlock held.  The usecount becomes 1
+ * only once the clock runs, see clk_usecount_add().  Returns 0 upon
+ * success or a negative error code upon failure.
  */
 int omap2_clk_enable(struct clk *clk)
 {
@@ -313,9 +316,7 @@ int omap2_clk_enable(struct clk *clk)
 
 	pr_debug("clock: %s: incrementing usecount\n", clk->name);
 
-	clk->usecount++;
-
-	if (clk->usecount > 1)
+	if (clk_usecount_add(clk, 1, 1))
 		return 0;
 
 	pr_debug("clock: %s: enabling in hardware\n", clk->name);
@@ -348,6 +349,10 @@ int omap2_clk_enable(struct clk *clk)
 		}
 	}
 
+	/* the clock runs before lockless users can see it enabled */
+	smp_wmb();
+	clk->usecount = 1;
+
 	return 0;
 
 oce_err3:
@@ -357,8 +362,6 @@ oce_err2:
 	if (clk->parent)
 		omap2_clk_disable(clk->parent);
 oce_err1:
-	clk->usecount--;
-
 	return ret;
 }
 
@@ -15,8 +15,13 @@
 #include <linux/cpu_pm.h>
 #include <linux/export.h>
 #include <linux/clockchips.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/proc-fns.h>
+#include <asm/hardware/gic.h>
 
 #include "common.h"
 #include "pm.h"
@@ -48,6 +53,94 @@ static struct clockdomain *cpu_clkdm[NR_CPUS];
 static atomic_t abort_barrier;
 static bool cpu_done[NR_CPUS];
 
+/*
+ * Entry and exit costs measured by CPU0 on each coupled wake, including
+ * the wait for CPU1 and the context save/restore. They replace the static
+ * cpuidle_params_table values once they exceed them.
+ */
+struct omap4_idle_stats {
+	unsigned int entry_us;	/* running average */
+	unsigned int exit_us;	/* running average */
+	unsigned int entered;
+	unsigned int aborted;	/* CPU1 woke before reaching OFF */
+	unsigned int wasted;	/* slept less than target_residency */
+};
+
+#define OMAP4_IDLE_AVG_SHIFT	3
+
+static struct omap4_idle_stats omap4_idle_stats[OMAP4_NUM_STATES];
+
+/*
+ * CPU1 goes OFF on its own, as when hotplugged, while waiting for CPU0
+ * to join a coupled state if it expects to idle long enough.
+ */
+static bool cpu1_idle_off;
+static unsigned int cpu1_avg_idle_us;
+static unsigned int cpu1_off_entered, cpu1_off_wasted;
+
+static inline unsigned int omap4_idle_avg(unsigned int avg, s64 sample)
+{
+	if (sample < 0)
+		sample = 0;
+	if (!avg)
+		return sample;
+	return avg - (avg >> OMAP4_IDLE_AVG_SHIFT) +
+		((unsigned int)sample >> OMAP4_IDLE_AVG_SHIFT);
+}
+
+static void omap4_idle_account(struct cpuidle_driver *drv, int index,
+			       ktime_t start, ktime_t sleep, ktime_t wake,
+			       ktime_t end)
+{
+	struct omap4_idle_stats *st = &omap4_idle_stats[index];
+	struct cpuidle_state *state = &drv->states[index];
+	struct cpuidle_params *params = &cpuidle_params_table[index];
+	unsigned int latency;
+
+	st->entered++;
+	if (ktime_us_delta(wake, sleep) < state->target_residency)
+		st->wasted++;
+
+	st->entry_us = omap4_idle_avg(st->entry_us,
+				      ktime_us_delta(sleep, start));
+	st->exit_us = omap4_idle_avg(st->exit_us, ktime_us_delta(end, wake));
+
+	/* keep the break-even margin of the static table */
+	latency = max(st->entry_us + st->exit_us, params->exit_latency);
+	state->exit_latency = latency;
+	state->target_residency = params->target_residency +
+		latency - params->exit_latency;
+}
+
+static void omap4_enter_cpu1_off(struct cpuidle_device *dev,
+				 struct cpuidle_driver *drv)
+{
+	int cpu_id = dev->cpu;
+	ktime_t sleep;
+	s64 slept;
+
+	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_ENTER, &cpu_id);
+	cpu_pm_enter();
+
+	/* SGIs can't wake CPU1 from OFF, see omap4_idle_raise_softirq() */
+	cpu1_idle_off = true;
+	smp_mb();
+
+	sleep = ktime_get();
+	omap_enter_lowpower(dev->cpu, PWRDM_POWER_OFF);
+	slept = ktime_us_delta(ktime_get(), sleep);
+
+	cpu1_idle_off = false;
+	smp_mb();
+
+	cpu_pm_exit();
+	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_EXIT, &cpu_id);
+
+	cpu1_off_entered++;
+	if (slept < drv->states[1].target_residency)
+		cpu1_off_wasted++;
+}
+
 /**
  * omap4_enter_idle_coupled_[simple/coupled] - OMAP4 cpuidle entry functions
  * @dev: cpuidle device
@@ -62,10 +155,39 @@ static int omap4_enter_idle_simple(struct cpuidle_device *dev,
 				   struct cpuidle_driver *drv,
 				   int index)
 {
+	ktime_t start;
+	s64 predicted;
+
+	if (dev->cpu != 1 || drv->state_count < 2) {
+		local_fiq_disable();
+		omap_do_wfi();
+		local_fiq_enable();
+
+		return index;
+	}
+
+	start = ktime_get();
 	local_fiq_disable();
-	omap_do_wfi();
+
+	/*
+	 * Predict from the next timer event and from how long CPU1 idled
+	 * recently, and go OFF if that pays back the shallowest coupled
+	 * state's cost.
+	 */
+	predicted = ktime_to_us(tick_nohz_get_sleep_length());
+	if (predicted > cpu1_avg_idle_us)
+		predicted = cpu1_avg_idle_us;
+
+	if (predicted >= drv->states[1].target_residency)
+		omap4_enter_cpu1_off(dev, drv);
+	else
+		omap_do_wfi();
+
 	local_fiq_enable();
 
+	cpu1_avg_idle_us = omap4_idle_avg(cpu1_avg_idle_us,
+					  ktime_us_delta(ktime_get(), start));
+
 	return index;
 }
 
@@ -76,7 +198,9 @@ static int omap4_enter_idle_coupled(struct cpuidle_device *dev,
 	struct omap4_idle_statedata *cx =
 			cpuidle_get_statedata(&dev->states_usage[index]);
 	int cpu_id = smp_processor_id();
+	ktime_t start, sleep, wake;
 
+	start = ktime_get();
 	local_fiq_disable();
 
 	/*
@@ -96,8 +220,10 @@ static int omap4_enter_idle_coupled(struct cpuidle_device *dev,
 			 * that here, otherwise we could spin forever
 			 * waiting for CPU1 off.
 			 */
-			if (cpu_done[1])
-			    goto fail;
+			if (cpu_done[1]) {
+				omap4_idle_stats[index].aborted++;
+				goto fail;
+			}
 
 		}
 	}
@@ -121,7 +247,9 @@ static int omap4_enter_idle_coupled(struct cpuidle_device *dev,
 			cpu_cluster_pm_enter();
 	}
 
+	sleep = ktime_get();
 	omap_enter_lowpower(dev->cpu, cx->cpu_state);
+	wake = ktime_get();
 	cpu_done[dev->cpu] = true;
 
 	/* Wakeup CPU1 only if it is not offlined */
@@ -145,8 +273,17 @@ static int omap4_enter_idle_coupled(struct cpuidle_device *dev,
 
 	clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_EXIT, &cpu_id);
 
+	cpuidle_coupled_parallel_barrier(dev, &abort_barrier);
+
+	/* CPU0 does the whole cluster transition, CPU1 only follows */
+	if (dev->cpu == 0)
+		omap4_idle_account(drv, index, start, sleep, wake,
+				   ktime_get());
+	goto out;
+
 fail:
 	cpuidle_coupled_parallel_barrier(dev, &abort_barrier);
+out:
 	cpu_done[dev->cpu] = false;
 
 	local_fiq_enable();
@@ -154,6 +291,75 @@ fail:
 	return index;
 }
 
+#ifdef CONFIG_SMP
+/*
+ * The SGIs are not wakeup capable from low power states, so force the
+ * CPU1 clockdomain awake before signalling it while it idles OFF on its
+ * own, as boot_secondary() does for a hotplugged CPU1.
+ */
+static void omap4_idle_raise_softirq(const struct cpumask *mask,
+				     unsigned int irq)
+{
+	smp_mb();
+	if (cpu1_idle_off && cpumask_test_cpu(1, mask)) {
+		clkdm_wakeup(cpu_clkdm[1]);
+		clkdm_allow_idle(cpu_clkdm[1]);
+	}
+
+	gic_raise_softirq(mask, irq);
+}
+#endif
+
+#ifdef CONFIG_DEBUG_FS
+static int omap4_idle_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap4_idle_stats *st;
+	struct cpuidle_state *state;
+	int i;
+
+	seq_printf(s, "%-4s %8s %8s %8s %8s %8s %8s %8s\n", "",
+		   "latency", "resid", "entry", "exit", "entered",
+		   "aborted", "wasted");
+
+	for (i = 0; i < omap4_idle_driver.state_count; i++) {
+		state = &omap4_idle_driver.states[i];
+		st = &omap4_idle_stats[i];
+		if (!(state->flags & CPUIDLE_FLAG_COUPLED))
+			continue;
+
+		seq_printf(s, "%-4s %8u %8u %8u %8u %8u %8u %8u\n",
+			   state->name, state->exit_latency,
+			   state->target_residency, st->entry_us, st->exit_us,
+			   st->entered, st->aborted, st->wasted);
+	}
+
+	seq_printf(s, "cpu1 off: entered %u wasted %u avg idle %u us\n",
+		   cpu1_off_entered, cpu1_off_wasted, cpu1_avg_idle_us);
+
+	return 0;
+}
+
+static int omap4_idle_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap4_idle_stats_show, inode->i_private);
+}
+
+static const struct file_operations omap4_idle_stats_fops = {
+	.open		= omap4_idle_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init omap4_idle_debugfs_init(void)
+{
+	debugfs_create_file("omap4_idle", S_IRUGO, NULL, NULL,
+			    &omap4_idle_stats_fops);
+}
+#else
+static inline void omap4_idle_debugfs_init(void) { }
+#endif
+
 static DEFINE_PER_CPU(struct cpuidle_device, omap4_idle_dev);
 
 static struct cpuidle_driver omap4_idle_driver = {
@@ -266,5 +472,10 @@ int __init omap4_idle_init(void)
 		}
 	}
 
+#ifdef CONFIG_SMP
+	set_smp_cross_call(omap4_idle_raise_softirq);
+#endif
+	omap4_idle_debugfs_init();
+
 	return 0;
 }
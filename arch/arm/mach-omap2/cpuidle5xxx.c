@@ -17,6 +17,9 @@
 #include <linux/export.h>
 #include <linux/clockchips.h>
 #include <linux/suspend.h>
+#include <linux/hrtimer.h>
+#include <linux/cpu.h>
+#include <linux/device.h>
 
 #include <asm/proc-fns.h>
 #include <asm/system_misc.h>
@@ -36,7 +39,10 @@ struct omap5_idle_statedata {
 	u8 valid;
 };
 
-/* FIXME: C-states needs to be fine tuned with measurements */
+/*
+ * Static C-state costs. Measured costs replace them at runtime within
+ * bounds, see omap5_idle_adjust().
+ */
 static struct cpuidle_params cpuidle_params_table[] = {
 	/* C1 - CPU0 ON + CPU1 ON + MPU ON + CORE ON */
 	{.exit_latency = 2 + 2 , .target_residency = 5, .valid = 1},
@@ -67,6 +73,170 @@ static struct clockdomain *cpu_clkdm[NR_CPUS];
 static atomic_t abort_barrier;
 static bool cpu_done[NR_CPUS];
 
+/*
+ * Measured cost of each C-state, from cpuidle entry to exit. It includes
+ * the context save/restore in omap_enter_lowpower() and the wakeupgen
+ * path, and is used to adjust the table within bounds of the static
+ * values above.
+ */
+struct omap5_idle_stats {
+	unsigned int min_us;	/* shortest sleep seen, i.e. the fixed cost */
+	unsigned int entry_us;	/* running average up to WFI */
+	unsigned int exit_us;	/* running average after wakeup */
+	unsigned int entered;
+	unsigned int short_sleeps; /* woke before target_residency */
+};
+
+#define OMAP5_IDLE_AVG_SHIFT		3
+/* adjust a state after this many new samples */
+#define OMAP5_IDLE_ADJUST_SAMPLES	256
+/* bounds of the adjusted latency, relative to cpuidle_params_table */
+#define OMAP5_IDLE_MIN_DIV		2
+#define OMAP5_IDLE_MAX_MULT		4
+#define OMAP5_IDLE_CALIBRATE_SAMPLES	64
+
+static DEFINE_SPINLOCK(omap5_idle_stats_lock);
+static struct omap5_idle_stats omap5_idle_stats[OMAP5_NUM_STATES];
+static bool omap5_idle_adjust_enabled = true;
+
+/* boot calibration: force each state in turn for this many entries */
+static unsigned int omap5_idle_calib_samples = OMAP5_IDLE_CALIBRATE_SAMPLES;
+static unsigned int omap5_idle_calib_left;
+static int omap5_idle_calib_state;
+
+static int __init omap5_idle_calibrate_setup(char *str)
+{
+	get_option(&str, &omap5_idle_calib_samples);
+	return 1;
+}
+__setup("omap5_idle_calibrate=", omap5_idle_calibrate_setup);
+
+static inline unsigned int omap5_idle_avg(unsigned int avg, s64 sample)
+{
+	if (sample < 0)
+		sample = 0;
+	if (!avg)
+		return sample;
+	return avg - (avg >> OMAP5_IDLE_AVG_SHIFT) +
+		((unsigned int)sample >> OMAP5_IDLE_AVG_SHIFT);
+}
+
+static unsigned int omap5_idle_cost(struct omap5_idle_stats *st)
+{
+	return max(st->min_us, st->entry_us + st->exit_us);
+}
+
+/*
+ * Set the latency of each measured state to its cost, within bounds, and
+ * keep the break-even margin of the static table on top of it for the
+ * target residency. Deeper states never get cheaper than shallower ones.
+ * Called with omap5_idle_stats_lock held.
+ */
+static void omap5_idle_adjust(struct cpuidle_driver *drv)
+{
+	struct cpuidle_params *params;
+	struct cpuidle_state *state;
+	unsigned int lat, res, prev_lat = 0, prev_res = 0;
+	int i;
+
+	for (i = 0; i < drv->state_count; i++) {
+		params = &cpuidle_params_table[i];
+		state = &drv->states[i];
+
+		if (i && omap5_idle_adjust_enabled &&
+		    omap5_idle_stats[i].entered) {
+			lat = clamp(omap5_idle_cost(&omap5_idle_stats[i]),
+				    params->exit_latency / OMAP5_IDLE_MIN_DIV,
+				    params->exit_latency * OMAP5_IDLE_MAX_MULT);
+			res = lat + params->target_residency -
+				min(params->target_residency,
+				    params->exit_latency);
+		} else {
+			lat = params->exit_latency;
+			res = params->target_residency;
+		}
+
+		state->exit_latency = max(lat, prev_lat);
+		state->target_residency = max(res, prev_res);
+		prev_lat = state->exit_latency;
+		prev_res = state->target_residency;
+	}
+}
+
+/* pick the state to calibrate instead of the governor's choice */
+static int omap5_idle_calib_index(struct cpuidle_driver *drv, int index)
+{
+	unsigned long flags;
+
+	if (likely(!omap5_idle_calib_left))
+		return index;
+
+	spin_lock_irqsave(&omap5_idle_stats_lock, flags);
+	if (omap5_idle_calib_left)
+		index = omap5_idle_calib_state;
+	spin_unlock_irqrestore(&omap5_idle_stats_lock, flags);
+
+	return index;
+}
+
+static void omap5_idle_account(struct cpuidle_driver *drv, int index,
+			       ktime_t start, ktime_t sleep, ktime_t wake,
+			       ktime_t end)
+{
+	struct omap5_idle_stats *st = &omap5_idle_stats[index];
+	s64 total = ktime_us_delta(end, start);
+	unsigned long flags;
+
+	spin_lock_irqsave(&omap5_idle_stats_lock, flags);
+
+	st->entered++;
+	if (total < drv->states[index].target_residency)
+		st->short_sleeps++;
+	if (!st->min_us || total < st->min_us)
+		st->min_us = total;
+	st->entry_us = omap5_idle_avg(st->entry_us,
+				      ktime_us_delta(sleep, start));
+	st->exit_us = omap5_idle_avg(st->exit_us, ktime_us_delta(end, wake));
+
+	if (omap5_idle_calib_left && index == omap5_idle_calib_state &&
+	    !--omap5_idle_calib_left) {
+		/* next enabled state, or calibration is done */
+		while (++omap5_idle_calib_state < drv->state_count)
+			if (!drv->states[omap5_idle_calib_state].disable)
+				break;
+		if (omap5_idle_calib_state < drv->state_count)
+			omap5_idle_calib_left = omap5_idle_calib_samples;
+		else
+			omap5_idle_adjust(drv);
+	} else if (!omap5_idle_calib_left &&
+		   !(st->entered % OMAP5_IDLE_ADJUST_SAMPLES)) {
+		omap5_idle_adjust(drv);
+	}
+
+	spin_unlock_irqrestore(&omap5_idle_stats_lock, flags);
+}
+
+static void omap5_idle_calibrate(struct cpuidle_driver *drv,
+				 unsigned int samples)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&omap5_idle_stats_lock, flags);
+	memset(omap5_idle_stats, 0, sizeof(omap5_idle_stats));
+	omap5_idle_calib_left = 0;
+
+	/* C1 is the reference, measure the low power states only */
+	for (i = 1; i < drv->state_count; i++) {
+		if (!drv->states[i].disable) {
+			omap5_idle_calib_state = i;
+			omap5_idle_calib_left = samples;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&omap5_idle_stats_lock, flags);
+}
+
 /**
  * omap5_enter_idle - Programs OMAP5 to enter the specified state
  * @dev: cpuidle device
@@ -81,10 +251,14 @@ static int omap5_enter_idle(struct cpuidle_device *dev,
 			struct cpuidle_driver *drv,
 			int index)
 {
-	struct omap5_idle_statedata *cx =
-			cpuidle_get_statedata(&dev->states_usage[index]);
+	struct omap5_idle_statedata *cx;
 	int cpu_id = smp_processor_id();
 	unsigned long flag;
+	ktime_t start, sleep, wake;
+
+	start = ktime_get();
+	index = omap5_idle_calib_index(drv, index);
+	cx = cpuidle_get_statedata(&dev->states_usage[index]);
 
 	local_fiq_disable();
 
@@ -103,7 +277,9 @@ static int omap5_enter_idle(struct cpuidle_device *dev,
 
 	spin_unlock_irqrestore(&mpu_lock, flag);
 
+	sleep = ktime_get();
 	omap_enter_lowpower(dev->cpu, cx->cpu_state);
+	wake = ktime_get();
 
 	spin_lock_irqsave(&mpu_lock, flag);
 	smp_mb__before_atomic_dec();
@@ -119,6 +295,10 @@ static int omap5_enter_idle(struct cpuidle_device *dev,
 
 	local_fiq_enable();
 
+	if (index > 0)
+		omap5_idle_account(drv, index, start, sleep, wake,
+				   ktime_get());
+
 	return index;
 }
 
@@ -291,6 +471,107 @@ static void __init cpuidle_register_sleep_pm_notifier(void)
 	register_pm_notifier(&cpuidle_sleep_pm_notifier);
 }
 
+static ssize_t omap5_idle_stats_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct omap5_idle_stats *st;
+	struct cpuidle_state *state;
+	unsigned long flags;
+	ssize_t len = 0;
+	int i;
+
+	len += snprintf(buf + len, PAGE_SIZE - len,
+			"%-4s %8s %8s %8s %8s %8s %8s %8s\n", "",
+			"latency", "resid", "min", "entry", "exit",
+			"entered", "short");
+
+	spin_lock_irqsave(&omap5_idle_stats_lock, flags);
+	for (i = 1; i < omap5_idle_driver.state_count; i++) {
+		state = &omap5_idle_driver.states[i];
+		st = &omap5_idle_stats[i];
+		len += snprintf(buf + len, PAGE_SIZE - len,
+				"%-4s %8u %8u %8u %8u %8u %8u %8u\n",
+				state->name, state->exit_latency,
+				state->target_residency, st->min_us,
+				st->entry_us, st->exit_us, st->entered,
+				st->short_sleeps);
+	}
+	spin_unlock_irqrestore(&omap5_idle_stats_lock, flags);
+
+	return len;
+}
+
+static ssize_t omap5_idle_adjust_show(struct device *dev,
+				      struct device_attribute *attr,
+				      char *buf)
+{
+	return sprintf(buf, "%d\n", omap5_idle_adjust_enabled);
+}
+
+static ssize_t omap5_idle_adjust_store(struct device *dev,
+				       struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	unsigned long flags;
+	int ret, val;
+
+	ret = kstrtoint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	/* turning adjustment off puts the static table back */
+	spin_lock_irqsave(&omap5_idle_stats_lock, flags);
+	omap5_idle_adjust_enabled = !!val;
+	omap5_idle_adjust(&omap5_idle_driver);
+	spin_unlock_irqrestore(&omap5_idle_stats_lock, flags);
+
+	return count;
+}
+
+static ssize_t omap5_idle_calibrate_show(struct device *dev,
+					 struct device_attribute *attr,
+					 char *buf)
+{
+	return sprintf(buf, "%u\n", omap5_idle_calib_left);
+}
+
+static ssize_t omap5_idle_calibrate_store(struct device *dev,
+					  struct device_attribute *attr,
+					  const char *buf, size_t count)
+{
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+	if (!val)
+		return -EINVAL;
+
+	omap5_idle_calib_samples = val;
+	omap5_idle_calibrate(&omap5_idle_driver, val);
+
+	return count;
+}
+
+static DEVICE_ATTR(stats, S_IRUGO, omap5_idle_stats_show, NULL);
+static DEVICE_ATTR(adjust, S_IRUGO | S_IWUSR, omap5_idle_adjust_show,
+		   omap5_idle_adjust_store);
+static DEVICE_ATTR(calibrate, S_IRUGO | S_IWUSR, omap5_idle_calibrate_show,
+		   omap5_idle_calibrate_store);
+
+static struct attribute *omap5_idle_attrs[] = {
+	&dev_attr_stats.attr,
+	&dev_attr_adjust.attr,
+	&dev_attr_calibrate.attr,
+	NULL,
+};
+
+static struct attribute_group omap5_idle_attr_group = {
+	.attrs	= omap5_idle_attrs,
+	.name	= "omap5_idle",
+};
+
 /**
  * omap5_idle_init - Init routine for OMAP5 idle
  *
@@ -399,5 +680,14 @@ int __init omap5_idle_init(void)
 
 	cpuidle_register_sleep_pm_notifier();
 
+	/* /sys/devices/system/cpu/omap5_idle */
+	if (sysfs_create_group(&cpu_subsys.dev_root->kobj,
+			       &omap5_idle_attr_group))
+		pr_warn("%s: failed to create sysfs group\n", __func__);
+
+	if (omap5_idle_calib_samples)
+		omap5_idle_calibrate(&omap5_idle_driver,
+				     omap5_idle_calib_samples);
+
 	return 0;
 }
@@ -22,6 +22,7 @@
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/pm_qos.h>
+#include <linux/hrtimer.h>
 #include <linux/power/smartreflex.h>
 #include <plat/common.h>
 #include <plat/omap_device.h>
@@ -77,7 +78,9 @@
  *    scalable devices belonging to this voltage domain and scale them to the
  *    appropriate frequencies using the set_rate pointer in the device opp
  *    tables.
- * 6. Handle inter VDD dependecies.
+ * 6. Handle inter VDD dependecies. The rails of dependent domains ramp at
+ *    the same time: a domain sends its new voltage, scales its dependent
+ *    domains and only then waits for its own rail to settle.
  *
  *
  * DOC: The Core DVFS data structure:
@@ -179,6 +182,10 @@ struct omap_vdd_dvfs_info {
 	struct plist_head vdd_user_list;
 	struct voltagedomain *voltdm;
 	struct list_head dev_list;
+
+	/* time spent by the last scale, locked by omap_dvfs_lock */
+	u32 volt_us;
+	u32 clk_us;
 };
 
 static LIST_HEAD(omap_dvfs_info_list);
@@ -590,6 +597,7 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 	struct omap_volt_data *new_vdata;
 	struct omap_volt_data *curr_vdata;
 	struct list_head *dev_list;
+	ktime_t start;
 
 	voltdm = tdvfs_info->voltdm;
 	if (IS_ERR_OR_NULL(voltdm)) {
@@ -615,6 +623,9 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 		return PTR_ERR(curr_vdata);
 	}
 
+	tdvfs_info->volt_us = 0;
+	tdvfs_info->clk_us = 0;
+
 	/* Disable smartreflex module across voltage and frequency scaling */
 	omap_sr_disable(voltdm);
 
@@ -623,6 +634,29 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 	if (!curr_volt)
 		curr_volt = omap_get_operation_voltage(curr_vdata);
 
+	/*
+	 * Now decide on switching OPP. The new voltage is only sent here,
+	 * the rail ramps while the dependent domains are scaled and we
+	 * wait for it once before raising any of our clocks. No clock is
+	 * raised before its own rail settled, so this is as safe as doing
+	 * the rails one after the other.
+	 */
+	if (curr_volt == new_volt) {
+		volt_scale_dir = DVFS_VOLT_SCALE_NONE;
+	} else if (curr_volt < new_volt) {
+		start = ktime_get();
+		ret = voltdm_scale_start(voltdm, new_vdata);
+		tdvfs_info->volt_us = ktime_to_us(ktime_sub(ktime_get(),
+							    start));
+		if (ret) {
+			dev_err(target_dev,
+				"%s: Unable to scale the %s to %ld volt\n",
+				__func__, voltdm->name, new_volt);
+			goto out;
+		}
+		volt_scale_dir = DVFS_VOLT_SCALE_UP;
+	}
+
 	/* Make a decision to scale dependent domain based on nominal voltage */
 	if (omap_get_nominal_voltage(new_vdata) >
 					omap_get_nominal_voltage(curr_vdata)) {
@@ -635,19 +669,11 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 		}
 	}
 
-	/* Now decide on switching OPP */
-	if (curr_volt == new_volt) {
-		volt_scale_dir = DVFS_VOLT_SCALE_NONE;
-	} else if (curr_volt < new_volt) {
-
-		ret = voltdm_scale(voltdm, new_vdata);
-		if (ret) {
-			dev_err(target_dev,
-				"%s: Unable to scale the %s to %ld volt\n",
-				__func__, voltdm->name, new_volt);
-			goto out;
-		}
-		volt_scale_dir = DVFS_VOLT_SCALE_UP;
+	if (volt_scale_dir == DVFS_VOLT_SCALE_UP) {
+		start = ktime_get();
+		voltdm_scale_finish(voltdm);
+		tdvfs_info->volt_us += ktime_to_us(ktime_sub(ktime_get(),
+							     start));
 	}
 
 	/*
@@ -657,6 +683,7 @@ static int _dvfs_scale(struct device *req_dev, struct device *target_dev,
 	 * after the frequency on which they depend. In case of scaling
 	 * down to lower OPP the order of scaling frequencies is reverse.
 	 */
+	start = ktime_get();
 	dev_list = (volt_scale_dir == DVFS_VOLT_SCALE_DOWN) ?
 			tdvfs_info->dev_list.prev : tdvfs_info->dev_list.next;
 	while (dev_list != &tdvfs_info->dev_list) {
@@ -692,11 +719,18 @@ next:
 				dev_list->prev : dev_list->next;
 	}
 
+	tdvfs_info->clk_us = ktime_to_us(ktime_sub(ktime_get(), start));
+
 	if (ret)
 		goto fail;
 
-	if (DVFS_VOLT_SCALE_DOWN == volt_scale_dir)
-		voltdm_scale(voltdm, new_vdata);
+	/* Lower our rail while the dependent domains scale down */
+	if (DVFS_VOLT_SCALE_DOWN == volt_scale_dir) {
+		start = ktime_get();
+		voltdm_scale_start(voltdm, new_vdata);
+		tdvfs_info->volt_us = ktime_to_us(ktime_sub(ktime_get(),
+							    start));
+	}
 
 	/* Make a decision to scale dependent domain based on nominal voltage */
 	if (omap_get_nominal_voltage(new_vdata) <
@@ -704,6 +738,13 @@ next:
 		_dep_scale_domains(target_dev, voltdm->dep_vdd_info);
 	}
 
+	if (DVFS_VOLT_SCALE_DOWN == volt_scale_dir) {
+		start = ktime_get();
+		voltdm_scale_finish(voltdm);
+		tdvfs_info->volt_us += ktime_to_us(ktime_sub(ktime_get(),
+							     start));
+	}
+
 	/* All clear.. go out gracefully */
 	goto out;
 
@@ -711,6 +752,9 @@ fail:
 	pr_warning("%s: domain%s: No clean recovery available! could be bad!\n",
 		   __func__, voltdm->name);
 out:
+	/* never leave a started transition behind */
+	voltdm_scale_finish(voltdm);
+
 	/* Re-enable Smartreflex module */
 	omap_sr_enable(voltdm);
 
@@ -830,6 +874,38 @@ out:
 }
 EXPORT_SYMBOL(omap_device_scale);
 
+/**
+ * omap_dvfs_get_scale_time() - time spent by the last scale of a domain
+ * @target_dev:	device scaled through omap_device_scale()
+ * @volt_us:	filled with the time spent ramping the voltage
+ * @clk_us:	filled with the time spent setting the device rates
+ *
+ * Reports on the last scale of the voltage domain of @target_dev, both
+ * values are 0 for the parts that were not needed.
+ *
+ * Returns 0 on success else the error value
+ */
+int omap_dvfs_get_scale_time(struct device *target_dev, u32 *volt_us,
+			     u32 *clk_us)
+{
+	struct omap_vdd_dvfs_info *tdvfs_info;
+	int ret = 0;
+
+	mutex_lock(&omap_dvfs_lock);
+	tdvfs_info = _dev_to_dvfs_info(target_dev);
+	if (IS_ERR_OR_NULL(tdvfs_info)) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	*volt_us = tdvfs_info->volt_us;
+	*clk_us = tdvfs_info->clk_us;
+out:
+	mutex_unlock(&omap_dvfs_lock);
+	return ret;
+}
+EXPORT_SYMBOL(omap_dvfs_get_scale_time);
+
 #ifdef CONFIG_PM_DEBUG
 static int dvfs_dump_vdd(struct seq_file *sf, void *unused)
 {
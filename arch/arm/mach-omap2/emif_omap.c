@@ -18,8 +18,18 @@
 #include <plat/omap_device.h>
 #include "common.h"
 
+/* L3 master ids of the initiators whose DDR bandwidth is measured */
+static const struct emif_initiator omap_emif_initiators[] = {
+	{ .name = "mpu",	.conn_id = 0x00 },
+	{ .name = "iva",	.conn_id = 0x30 },
+	{ .name = "gpu",	.conn_id = 0x60 },
+	{ .name = "dss",	.conn_id = 0x70 },
+};
+
 static struct emif_platform_data omap_emif_platform_data __initdata = {
-	.hw_caps = EMIF_HW_CAPS_LL_INTERFACE
+	.hw_caps = EMIF_HW_CAPS_LL_INTERFACE,
+	.initiators = omap_emif_initiators,
+	.num_initiators = ARRAY_SIZE(omap_emif_initiators),
 };
 
 /**
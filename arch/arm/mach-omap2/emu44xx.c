@@ -0,0 +1,168 @@
+/*
+ * emu44xx.c
+ *
+ * Cortex-A9 PMU interrupts routed through the OMAP4 cross trigger interfaces
+ *
+ * Copyright (C) 2012 Texas Instruments Incorporated - http://www.ti.com/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The overflow interrupt of each Cortex-A9 PMU is not wired to the GIC on
+ * OMAP4.  It only reaches the CTI of its core in the debug subsystem, which
+ * has to be told to turn it into one of its own output triggers, the one
+ * wired to the CTI interrupt line.  Without this, perf works in counting
+ * mode but sampling never sees an overflow.
+ *
+ * The CTIs sit in the EMU clock domain, which is kept idle while no perf
+ * event uses the PMU: the perf core enables the interrupts when it reserves
+ * the PMU for the first event and disables them when the last one is gone,
+ * and the domain is forced awake only in between.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/io.h>
+#include <linux/interrupt.h>
+#include <linux/platform_device.h>
+
+#include <asm/cti.h>
+#include <asm/pmu.h>
+
+#include <plat/irqs.h>
+#include <plat/omap44xx.h>
+
+#include "common.h"
+#include "clockdomain.h"
+
+/* Cortex-A9 PMU overflow on trigger input 1, CTI interrupt on output 6 */
+#define OMAP4_CTI_TRIG_IN_PMU	1
+#define OMAP4_CTI_TRIG_OUT_IRQ	6
+#define OMAP4_CTI_CHANNEL	2
+
+static struct cti omap4_cti[2];
+static struct clockdomain *emu_clkdm;
+/* serialized by the perf core, which enables and disables irqs in order */
+static int omap4_pmu_users;
+
+static struct cti *omap4_pmu_irq_to_cti(int irq)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(omap4_cti); i++)
+		if (omap4_cti[i].irq == irq)
+			return &omap4_cti[i];
+	return NULL;
+}
+
+static void omap4_pmu_enable_irq(int irq)
+{
+	struct cti *cti = omap4_pmu_irq_to_cti(irq);
+
+	if (!cti)
+		return;
+
+	if (!omap4_pmu_users++)
+		clkdm_wakeup(emu_clkdm);
+
+	/* the EMU domain may have lost its context while idle, reprogram */
+	cti_unlock(cti);
+	cti_map_trigger(cti, OMAP4_CTI_TRIG_IN_PMU, OMAP4_CTI_TRIG_OUT_IRQ,
+			OMAP4_CTI_CHANNEL);
+	cti_enable(cti);
+}
+
+static void omap4_pmu_disable_irq(int irq)
+{
+	struct cti *cti = omap4_pmu_irq_to_cti(irq);
+
+	if (!cti)
+		return;
+
+	cti_disable(cti);
+	cti_lock(cti);
+
+	if (!--omap4_pmu_users)
+		clkdm_allow_idle(emu_clkdm);
+}
+
+static irqreturn_t omap4_pmu_handle_irq(int irq, void *dev,
+					irq_handler_t handler)
+{
+	struct cti *cti = omap4_pmu_irq_to_cti(irq);
+
+	if (cti)
+		cti_irq_ack(cti);
+	return handler(irq, dev);
+}
+
+static struct arm_pmu_platdata omap4_pmu_data = {
+	.handle_irq	= omap4_pmu_handle_irq,
+	.enable_irq	= omap4_pmu_enable_irq,
+	.disable_irq	= omap4_pmu_disable_irq,
+};
+
+static struct resource omap4_pmu_resources[] = {
+	{
+		.start	= OMAP44XX_IRQ_CTI0,
+		.end	= OMAP44XX_IRQ_CTI0,
+		.flags	= IORESOURCE_IRQ,
+	},
+	{
+		.start	= OMAP44XX_IRQ_CTI1,
+		.end	= OMAP44XX_IRQ_CTI1,
+		.flags	= IORESOURCE_IRQ,
+	},
+};
+
+static struct platform_device omap4_pmu_device = {
+	.name		= "arm-pmu",
+	.id		= ARM_PMU_DEVICE_CPU,
+	.num_resources	= ARRAY_SIZE(omap4_pmu_resources),
+	.resource	= omap4_pmu_resources,
+	.dev		= {
+		.platform_data	= &omap4_pmu_data,
+	},
+};
+
+static int __init omap4_pmu_init(void)
+{
+	static const u32 cti_base[] = {
+		OMAP44XX_CTI0_BASE, OMAP44XX_CTI1_BASE,
+	};
+	void __iomem *base;
+	int i, r;
+
+	if (!cpu_is_omap44xx())
+		return -ENODEV;
+
+	emu_clkdm = clkdm_lookup("emu_sys_clkdm");
+	if (!emu_clkdm) {
+		pr_err("%s: no emu_sys_clkdm\n", __func__);
+		return -ENODEV;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(omap4_cti); i++) {
+		base = ioremap(cti_base[i], SZ_4K);
+		if (!base) {
+			r = -ENOMEM;
+			goto err_unmap;
+		}
+		cti_init(&omap4_cti[i], base, omap4_pmu_resources[i].start,
+			 OMAP4_CTI_TRIG_OUT_IRQ);
+	}
+
+	r = platform_device_register(&omap4_pmu_device);
+	if (r)
+		goto err_unmap;
+
+	return 0;
+
+err_unmap:
+	while (--i >= 0)
+		iounmap(omap4_cti[i].base);
+	pr_err("%s: PMU interrupts not routed: %d\n", __func__, r);
+	return r;
+}
+arch_initcall(omap4_pmu_init);
@@ -0,0 +1,128 @@
+/*
+ * OMAP L3/DDR frequency scaling driven by the measured DDR bandwidth
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/err.h>
+#include <linux/opp.h>
+#include <linux/devfreq.h>
+#include <linux/pm_qos.h>
+#include <linux/platform_data/emif_plat.h>
+#include <plat/omap_device.h>
+#include "common.h"
+
+/*
+ * The EMIF counters give the DDR bandwidth and the simple_ondemand
+ * governor picks the L3 OPP from its ratio to what the current OPP can
+ * carry. The OPP is not changed from here directly: it is applied as a
+ * memory throughput PM QoS request, so that the constraints of other
+ * users are aggregated with it by omap2_pm_qos_tput_handler().
+ *
+ * Throughput and frequency are related as in omap2_pm_qos_tput_handler(),
+ * 4 bytes per L3 cycle, expressed in KiB/s.
+ */
+#define L3_TPUT_KIBPS(freq)		((freq) / 250)
+#define L3_POLLING_MS			100
+
+static struct device *l3_dev;
+static struct devfreq *l3_devfreq;
+static struct pm_qos_request l3_tput_req;
+static unsigned long l3_cur_freq;
+
+static int l3_devfreq_target(struct device *dev, unsigned long *freq,
+			     u32 flags)
+{
+	struct opp *opp;
+
+	rcu_read_lock();
+	opp = devfreq_recommended_opp(dev, freq, flags);
+	if (IS_ERR(opp)) {
+		rcu_read_unlock();
+		dev_err(dev, "%s: no OPP for %lu\n", __func__, *freq);
+		return PTR_ERR(opp);
+	}
+	*freq = opp_get_freq(opp);
+	rcu_read_unlock();
+
+	if (*freq == l3_cur_freq)
+		return 0;
+
+	pm_qos_update_request(&l3_tput_req, L3_TPUT_KIBPS(*freq));
+	l3_cur_freq = *freq;
+
+	return 0;
+}
+
+static int l3_devfreq_get_dev_status(struct device *dev,
+				     struct devfreq_dev_status *stat)
+{
+	stat->current_frequency = l3_cur_freq;
+	stat->busy_time = emif_get_bandwidth() >> 10;
+	stat->total_time = L3_TPUT_KIBPS(l3_cur_freq);
+
+	return 0;
+}
+
+static struct devfreq_dev_profile l3_devfreq_profile = {
+	.polling_ms		= L3_POLLING_MS,
+	.target			= l3_devfreq_target,
+	.get_dev_status		= l3_devfreq_get_dev_status,
+};
+
+static int __init omap_l3_devfreq_init(void)
+{
+	unsigned long freq = ULONG_MAX;
+	const char *oh_name;
+	struct opp *opp;
+	int ret;
+
+	if (!cpu_is_omap44xx() && !cpu_is_omap54xx())
+		return -ENODEV;
+
+	oh_name = "l3_main_1";
+	l3_dev = omap_device_get_by_hwmod_name(oh_name);
+	if (IS_ERR(l3_dev)) {
+		pr_err("%s: no device for oh %s\n", __func__, oh_name);
+		return PTR_ERR(l3_dev);
+	}
+
+	rcu_read_lock();
+	opp = opp_find_freq_floor(l3_dev, &freq);
+	rcu_read_unlock();
+	if (IS_ERR(opp)) {
+		dev_err(l3_dev, "%s: no OPP\n", __func__);
+		return PTR_ERR(opp);
+	}
+
+	ret = emif_bw_monitor_get();
+	if (ret) {
+		dev_err(l3_dev, "%s: no bandwidth monitor: %d\n",
+			__func__, ret);
+		return ret;
+	}
+
+	l3_cur_freq = freq;
+	l3_devfreq_profile.initial_freq = freq;
+	pm_qos_add_request(&l3_tput_req, PM_QOS_MEMORY_THROUGHPUT,
+			   L3_TPUT_KIBPS(freq));
+
+	l3_devfreq = devfreq_add_device(l3_dev, &l3_devfreq_profile,
+					&devfreq_simple_ondemand, NULL);
+	if (IS_ERR(l3_devfreq)) {
+		ret = PTR_ERR(l3_devfreq);
+		dev_err(l3_dev, "%s: devfreq_add_device failed: %d\n",
+			__func__, ret);
+		pm_qos_remove_request(&l3_tput_req);
+		emif_bw_monitor_put();
+		return ret;
+	}
+
+	return 0;
+}
+late_initcall(omap_l3_devfreq_init);
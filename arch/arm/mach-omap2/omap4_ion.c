@@ -10,6 +10,7 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/dma-contiguous.h>
 #include <linux/ion.h>
 #include <linux/memblock.h>
 #include <linux/omap_ion.h>
@@ -17,8 +18,19 @@
 
 #include "omap4_ion.h"
 
+/* enough for the camera preview/capture and codec buffer sets */
+static struct omap_ion_tiler_heap_data omap4_tiler_heap_data = {
+	.recycle_blocks = 16,
+};
+
+static struct platform_device omap4_ion_device;
+
 static struct ion_platform_data omap4_ion_data = {
+#ifdef CONFIG_CMA
+	.nr = 4,
+#else
 	.nr = 3,
+#endif
 	.heaps = {
 		{
 			.type = ION_HEAP_TYPE_CARVEOUT,
@@ -27,6 +39,7 @@ static struct ion_platform_data omap4_ion_data = {
 			.base = PHYS_ADDR_SMC_MEM -
 					OMAP4_ION_HEAP_SECURE_INPUT_SIZE,
 			.size = OMAP4_ION_HEAP_SECURE_INPUT_SIZE,
+			.flags = ION_HEAP_FLAG_SIZE_CLASS,
 		},
 		{	.type = OMAP_ION_HEAP_TYPE_TILER,
 			.id = OMAP_ION_HEAP_TILER,
@@ -35,6 +48,8 @@ static struct ion_platform_data omap4_ion_data = {
 					OMAP4_ION_HEAP_SECURE_INPUT_SIZE -
 					OMAP4_ION_HEAP_TILER_SIZE,
 			.size = OMAP4_ION_HEAP_TILER_SIZE,
+			.flags = ION_HEAP_FLAG_DEFER_FREE,
+			.priv = &omap4_tiler_heap_data,
 		},
 		{
 			.type = OMAP_ION_HEAP_TYPE_TILER,
@@ -42,7 +57,18 @@ static struct ion_platform_data omap4_ion_data = {
 			.name = "nonsecure_tiler",
 			.base = 0x80000000 + SZ_512M + SZ_2M,
 			.size = OMAP4_ION_HEAP_NONSECURE_TILER_SIZE,
+			.flags = ION_HEAP_FLAG_DEFER_FREE,
 		},
+#ifdef CONFIG_CMA
+		{
+			/* lent to movable allocations while unused */
+			.type = ION_HEAP_TYPE_CMA,
+			.id = OMAP_ION_HEAP_CMA,
+			.name = "cma",
+			.size = OMAP4_ION_HEAP_CMA_SIZE,
+			.priv = &omap4_ion_device.dev,
+		},
+#endif
 	},
 };
 
@@ -73,5 +99,12 @@ void __init omap4_ion_init(void)
 				pr_err("memblock remove of %x@%lx failed\n",
 				       omap4_ion_data.heaps[i].size,
 				       omap4_ion_data.heaps[i].base);
+		} else if (omap4_ion_data.heaps[i].type == ION_HEAP_TYPE_CMA) {
+			ret = dma_declare_contiguous(omap4_ion_data.heaps[i].priv,
+						     omap4_ion_data.heaps[i].size,
+						     0, 0);
+			if (ret)
+				pr_err("cma reserve of %x failed\n",
+				       omap4_ion_data.heaps[i].size);
 		}
 }
@@ -10,6 +10,7 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/dma-contiguous.h>
 #include <linux/ion.h>
 #include <linux/memblock.h>
 #include <linux/omap_ion.h>
@@ -17,14 +18,21 @@
 
 #include "omap5_ion.h"
 
+static struct platform_device omap5_ion_device;
+
 static struct ion_platform_data omap5_ion_data = {
+#ifdef CONFIG_CMA
+	.nr = 5,
+#else
 	.nr = 4,
+#endif
 	.heaps = {
 		{
 			.type = ION_HEAP_TYPE_SYSTEM,
 			.id = OMAP_ION_HEAP_SYSTEM,
 			.name = "system_heap",
 			.size = -1,
+			.flags = ION_HEAP_FLAG_DEFER_FREE,
 		},
 		{
 			.type = ION_HEAP_TYPE_CARVEOUT,
@@ -33,6 +41,7 @@ static struct ion_platform_data omap5_ion_data = {
 			.base = PHYS_ADDR_SMC_MEM -
 					OMAP_ION_HEAP_SECURE_INPUT_SIZE,
 			.size = OMAP_ION_HEAP_SECURE_INPUT_SIZE,
+			.flags = ION_HEAP_FLAG_SIZE_CLASS,
 		},
 		{	.type = OMAP_ION_HEAP_TYPE_TILER,
 			.id = OMAP_ION_HEAP_TILER,
@@ -41,6 +50,7 @@ static struct ion_platform_data omap5_ion_data = {
 					OMAP_ION_HEAP_SECURE_INPUT_SIZE -
 					OMAP5_ION_HEAP_TILER_SIZE,
 			.size = OMAP5_ION_HEAP_TILER_SIZE,
+			.flags = ION_HEAP_FLAG_DEFER_FREE,
 		},
 		{
 			.type = OMAP_ION_HEAP_TYPE_TILER,
@@ -51,7 +61,18 @@ static struct ion_platform_data omap5_ion_data = {
 					OMAP5_ION_HEAP_TILER_SIZE -
 					OMAP5_ION_HEAP_NONSECURE_TILER_SIZE,
 			.size = OMAP5_ION_HEAP_NONSECURE_TILER_SIZE,
+			.flags = ION_HEAP_FLAG_DEFER_FREE,
+		},
+#ifdef CONFIG_CMA
+		{
+			/* lent to movable allocations while unused */
+			.type = ION_HEAP_TYPE_CMA,
+			.id = OMAP_ION_HEAP_CMA,
+			.name = "cma",
+			.size = OMAP5_ION_HEAP_CMA_SIZE,
+			.priv = &omap5_ion_device.dev,
 		},
+#endif
 	},
 };
 
@@ -82,6 +103,13 @@ void __init omap5_ion_init(void)
 				pr_err("memblock remove of %x@%lx failed\n",
 				       omap5_ion_data.heaps[i].size,
 				       omap5_ion_data.heaps[i].base);
+		} else if (omap5_ion_data.heaps[i].type == ION_HEAP_TYPE_CMA) {
+			ret = dma_declare_contiguous(omap5_ion_data.heaps[i].priv,
+						     omap5_ion_data.heaps[i].size,
+						     0, 0);
+			if (ret)
+				pr_err("cma reserve of %x failed\n",
+				       omap5_ion_data.heaps[i].size);
 		}
 
 }
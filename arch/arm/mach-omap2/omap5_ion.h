@@ -27,6 +27,7 @@
 #define OMAP5_ION_HEAP_NONSECURE_TILER_SIZE	(SZ_1M * 15)
 #define OMAP5_ION_HEAP_TILER_SIZE	(SZ_128M - SZ_32M - \
 					OMAP5_ION_HEAP_NONSECURE_TILER_SIZE)
+#define OMAP5_ION_HEAP_CMA_SIZE		SZ_32M
 
 #ifdef CONFIG_ION_OMAP
 void omap5_ion_init(void);
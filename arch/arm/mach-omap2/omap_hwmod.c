@@ -133,6 +133,7 @@
 #include <linux/clk.h>
 #include <linux/delay.h>
 #include <linux/err.h>
+#include <linux/hrtimer.h>
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
@@ -140,6 +141,9 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
+#include <linux/workqueue.h>
+
+#include <trace/events/power.h>
 
 #include "common.h"
 #include <plat/cpu.h>
@@ -168,7 +172,7 @@
 static LIST_HEAD(omap_hwmod_list);
 
 struct hwmod_ops {
-	void	(*hwmod_update_context_lost)(struct omap_hwmod *oh);
+	int	(*hwmod_update_context_lost)(struct omap_hwmod *oh);
 	int	(*hwmod_get_context_lost)(struct omap_hwmod *oh);
 };
 
@@ -202,7 +206,8 @@ static int _update_sysc_cache(struct omap_hwmod *oh)
 	oh->_sysc_cache = omap_hwmod_read(oh, oh->class->sysc->sysc_offs);
 
 	if (!(oh->class->sysc->sysc_flags & SYSC_NO_CACHE))
-		oh->_int_flags |= _HWMOD_SYSCONFIG_LOADED;
+		oh->_int_flags |= _HWMOD_SYSCONFIG_LOADED |
+			_HWMOD_SYSCONFIG_VALID;
 
 	return 0;
 }
@@ -213,7 +218,8 @@ static int _update_sysc_cache(struct omap_hwmod *oh)
  * @oh: struct omap_hwmod *
  *
  * Write @v into the module class' OCP_SYSCONFIG register, if it has
- * one.  No return value.
+ * one.  The write is skipped when the register is known to already
+ * hold @v, see _HWMOD_SYSCONFIG_VALID.  No return value.
  */
 static void _write_sysconfig(u32 v, struct omap_hwmod *oh)
 {
@@ -224,9 +230,14 @@ static void _write_sysconfig(u32 v, struct omap_hwmod *oh)
 
 	/* XXX ensure module interface clock is up */
 
-	/* Module might have lost context, always update cache and register */
+	if ((oh->_int_flags & _HWMOD_SYSCONFIG_VALID) && oh->_sysc_cache == v)
+		return;
+
 	oh->_sysc_cache = v;
 	omap_hwmod_write(v, oh, oh->class->sysc->sysc_offs);
+
+	if (!(oh->class->sysc->sysc_flags & SYSC_NO_CACHE))
+		oh->_int_flags |= _HWMOD_SYSCONFIG_VALID;
 }
 
 /**
@@ -1514,6 +1525,8 @@ static int _ocp_softreset(struct omap_hwmod *oh)
 	if (ret)
 		goto dis_opt_clks;
 	_write_sysconfig(v, oh);
+	/* The register goes back to its reset value */
+	oh->_int_flags &= ~_HWMOD_SYSCONFIG_VALID;
 
 	if (oh->class->sysc->srst_udelay)
 		udelay(oh->class->sysc->srst_udelay);
@@ -1630,27 +1643,30 @@ static inline void _omap4_inc_context_loss(unsigned int *v)
  *
  * If the PRCM indicates that the hwmod @oh lost context, increment
  * our in-memory context loss counter, and clear the RM_*_CONTEXT
- * bits. No return value.
+ * bits. Returns 0 if the context is known to be retained, 1 if it was
+ * lost or if the hwmod has no context register to tell.
  */
-static void _omap4_update_context_lost(struct omap_hwmod *oh)
+static int _omap4_update_context_lost(struct omap_hwmod *oh)
 {
 	u32 r;
 
 	if (oh->prcm.omap4.context_offs == USHRT_MAX)
-		return;
+		return 1;
 
 	r = omap4_prminst_read_inst_reg(oh->clkdm->pwrdm.ptr->prcm_partition,
 					oh->clkdm->pwrdm.ptr->prcm_offs,
 					oh->prcm.omap4.context_offs);
 
 	if (!r)
-		return;
+		return 0;
 
 	_omap4_inc_context_loss(&oh->prcm.omap4.context_lost_counter);
 
 	omap4_prminst_write_inst_reg(r, oh->clkdm->pwrdm.ptr->prcm_partition,
 				     oh->clkdm->pwrdm.ptr->prcm_offs,
 				     oh->prcm.omap4.context_offs);
+
+	return 1;
 }
 
 /**
@@ -1672,6 +1688,32 @@ static struct hwmod_ops omap4_hwmod_ops = {
 	.hwmod_get_context_lost		= _omap4_get_context_lost,
 };
 
+static bool _setup_deferred(struct omap_hwmod *oh);
+
+/**
+ * _account_latency - record the duration of an enable or idle transition
+ * @st: struct omap_hwmod_lat_stats * to update
+ * @start: time the transition started at
+ * @r: return value of the transition, failed ones are not accounted
+ *
+ * Returns the duration of the transition in microseconds.
+ */
+static u32 _account_latency(struct omap_hwmod_lat_stats *st, ktime_t start,
+			    int r)
+{
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	if (r)
+		return us;
+
+	st->count++;
+	st->total_us += us;
+	if (us > st->max_us)
+		st->max_us = us;
+
+	return us;
+}
+
 /**
  * _enable - enable an omap_hwmod
  * @oh: struct omap_hwmod *
@@ -1684,9 +1726,13 @@ static int _enable(struct omap_hwmod *oh)
 {
 	int r;
 	int hwsup = 0;
+	int lost = 1;
 
 	pr_debug("omap_hwmod: %s: enabling\n", oh->name);
 
+	if (_setup_deferred(oh) && oh->_state == _HWMOD_STATE_ENABLED)
+		return 0;
+
 	/*
 	 * hwmods with HWMOD_INIT_NO_IDLE flag set are left
 	 * in enabled state at init.
@@ -1752,8 +1798,14 @@ static int _enable(struct omap_hwmod *oh)
 	     oh->_state == _HWMOD_STATE_DISABLED) && oh->rst_lines_cnt == 1)
 		_deassert_hardreset(oh, oh->rst_lines[0].name);
 
+	/*
+	 * OCP_SYSCONFIG can only be trusted to still hold the cached value
+	 * coming back from idle with the module context retained.
+	 */
 	if (arch_hwmod && arch_hwmod->hwmod_update_context_lost)
-		arch_hwmod->hwmod_update_context_lost(oh);
+		lost = arch_hwmod->hwmod_update_context_lost(oh);
+	if (lost || oh->_state != _HWMOD_STATE_IDLE)
+		oh->_int_flags &= ~_HWMOD_SYSCONFIG_VALID;
 
 	r = _wait_target_ready(oh);
 	if (!r) {
@@ -1798,6 +1850,9 @@ static int _idle(struct omap_hwmod *oh)
 	int r, hwsup = 0;
 	pr_debug("omap_hwmod: %s: idling\n", oh->name);
 
+	if (_setup_deferred(oh) && oh->_state != _HWMOD_STATE_ENABLED)
+		return 0;
+
 	if (oh->_state != _HWMOD_STATE_ENABLED) {
 		WARN(1, "omap_hwmod: %s: idle state can only be entered from enabled state\n",
 			oh->name);
@@ -1901,6 +1956,9 @@ static int _shutdown(struct omap_hwmod *oh)
 	int ret, hwsup = 0;
 	u8 prev_state;
 
+	if (_setup_deferred(oh) && oh->_state == _HWMOD_STATE_DISABLED)
+		return 0;
+
 	if (oh->_state != _HWMOD_STATE_IDLE &&
 	    oh->_state != _HWMOD_STATE_ENABLED) {
 		WARN(1, "omap_hwmod: %s: disabled state can only be entered from idle, or enabled state\n",
@@ -1976,20 +2034,17 @@ static int _shutdown(struct omap_hwmod *oh)
 }
 
 /**
- * _setup - do initial configuration of omap_hwmod
+ * _do_setup - do initial configuration of omap_hwmod
  * @oh: struct omap_hwmod *
  *
  * Writes the CLOCKACTIVITY bits @clockact to the hwmod @oh
  * OCP_SYSCONFIG register.  Returns 0.
  */
-static int _setup(struct omap_hwmod *oh, void *data)
+static int _do_setup(struct omap_hwmod *oh)
 {
 	int i, r;
 	u8 postsetup_state;
 
-	if (oh->_state != _HWMOD_STATE_CLKS_INITED)
-		return 0;
-
 	/* Set iclk autoidle mode */
 	if (oh->slaves_cnt > 0) {
 		for (i = 0; i < oh->slaves_cnt; i++) {
@@ -2063,6 +2118,117 @@ static int _setup(struct omap_hwmod *oh, void *data)
 	return 0;
 }
 
+/**
+ * _setup - do initial configuration of omap_hwmod, if not done yet
+ * @oh: struct omap_hwmod *
+ * @data: unused, for omap_hwmod_for_each()
+ *
+ * Times _do_setup() and reports it like initcall_debug does for
+ * initcalls.  Returns 0.
+ */
+static int _setup(struct omap_hwmod *oh, void *data)
+{
+	ktime_t start;
+
+	if (oh->_state != _HWMOD_STATE_CLKS_INITED)
+		return 0;
+
+	start = ktime_get();
+	_do_setup(oh);
+	oh->_setup_us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	if (initcall_debug)
+		pr_info("omap_hwmod: %s: setup in %u usecs\n", oh->name,
+			oh->_setup_us);
+
+	return 0;
+}
+
+#ifdef CONFIG_OMAP_HWMOD_LAZY_SETUP
+/*
+ * _setup_is_deferrable - can _setup() of @oh wait for its first use?
+ *
+ * hwmods flagged to be left alone at init, and those a board asked to
+ * be left in a state other than idle, are set up during boot as before.
+ * The MPU and interconnects are among them.  Everything else is enabled,
+ * reset and idled only when its omap_device first uses it, or by
+ * omap_hwmod_setup_deferred_work() once boot is done.
+ */
+static bool _setup_is_deferrable(struct omap_hwmod *oh)
+{
+	if (oh == mpu_oh)
+		return false;
+	if (oh->flags & (HWMOD_INIT_NO_RESET | HWMOD_INIT_NO_IDLE))
+		return false;
+	return oh->_postsetup_state == _HWMOD_STATE_IDLE;
+}
+
+static int _setup_boot(struct omap_hwmod *oh, void *data)
+{
+	if (_setup_is_deferrable(oh))
+		return 0;
+	return _setup(oh, data);
+}
+
+/**
+ * _setup_deferred - set up @oh on its first use
+ * @oh: struct omap_hwmod *, with its _lock held
+ *
+ * Called by the state transitions before they check the current state.
+ * Returns true if @oh was set up here, in which case it may already be
+ * in the state the caller wants.
+ */
+static bool _setup_deferred(struct omap_hwmod *oh)
+{
+	if (oh->_state != _HWMOD_STATE_CLKS_INITED)
+		return false;
+
+	pr_debug("omap_hwmod: %s: deferred setup\n", oh->name);
+	_setup(oh, NULL);
+	return true;
+}
+
+static int _setup_deferred_locked(struct omap_hwmod *oh, void *data)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&oh->_lock, flags);
+	_setup(oh, NULL);
+	spin_unlock_irqrestore(&oh->_lock, flags);
+
+	cond_resched();
+	return 0;
+}
+
+/*
+ * Modules nobody used during boot may still run as the bootloader left
+ * them and keep their power domain on, so they are idled once boot is
+ * done, in parallel with the rest of it.
+ */
+static void omap_hwmod_setup_deferred_work(struct work_struct *work)
+{
+	omap_hwmod_for_each(_setup_deferred_locked, NULL);
+}
+static DECLARE_WORK(omap_hwmod_setup_work, omap_hwmod_setup_deferred_work);
+
+static int __init omap_hwmod_setup_deferred(void)
+{
+	schedule_work(&omap_hwmod_setup_work);
+	return 0;
+}
+late_initcall(omap_hwmod_setup_deferred);
+#else
+static int _setup_boot(struct omap_hwmod *oh, void *data)
+{
+	return _setup(oh, data);
+}
+
+static bool _setup_deferred(struct omap_hwmod *oh)
+{
+	return false;
+}
+#endif
+
 /**
  * _register - register a struct omap_hwmod
  * @oh: struct omap_hwmod *
@@ -2156,6 +2322,7 @@ int omap_hwmod_softreset(struct omap_hwmod *oh)
 	if (ret)
 		goto error;
 	_write_sysconfig(v, oh);
+	oh->_int_flags &= ~_HWMOD_SYSCONFIG_VALID;
 
 error:
 	return ret;
@@ -2400,8 +2567,9 @@ static int omap_hwmod_dbg_show(struct seq_file *s, void *unused)
 	struct omap_hwmod *oh;
 
 	list_for_each_entry(oh, &omap_hwmod_list, node) {
-		seq_printf(s, "name: %16s, state %d/%s\n", oh->name,
-			oh->_state, _state_str(oh->_state));
+		seq_printf(s, "name: %16s, state %d/%s, setup %u us\n",
+			oh->name, oh->_state, _state_str(oh->_state),
+			oh->_setup_us);
 	}
 
 	return 0;
@@ -2412,6 +2580,43 @@ static int omap_hwmod_dbg_open(struct inode *inode, struct file *file)
 	return single_open(file, omap_hwmod_dbg_show, inode->i_private);
 }
 
+static int omap_hwmod_lat_dbg_show(struct seq_file *s, void *unused)
+{
+	struct omap_hwmod_lat_stats *en, *id;
+	struct omap_hwmod *oh;
+
+	seq_printf(s, "%16s %10s %8s %8s %10s %8s %8s\n", "name",
+		   "enables", "avg_us", "max_us", "idles", "avg_us", "max_us");
+
+	list_for_each_entry(oh, &omap_hwmod_list, node) {
+		en = &oh->_enable_lat;
+		id = &oh->_idle_lat;
+		if (!en->count && !id->count)
+			continue;
+
+		seq_printf(s, "%16s %10u %8llu %8u %10u %8llu %8u\n", oh->name,
+			   en->count,
+			   en->count ? div_u64(en->total_us, en->count) : 0,
+			   en->max_us, id->count,
+			   id->count ? div_u64(id->total_us, id->count) : 0,
+			   id->max_us);
+	}
+
+	return 0;
+}
+
+static int omap_hwmod_lat_dbg_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_hwmod_lat_dbg_show, inode->i_private);
+}
+
+static const struct file_operations omap_hwmod_lat_dbg_fops = {
+	.open		= omap_hwmod_lat_dbg_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static const struct file_operations omap_hwmod_dbg_fops = {
 	.open		= omap_hwmod_dbg_open,
 	.read		= seq_read,
@@ -2427,6 +2632,8 @@ static void __init omap_hwmod_dbg_init(void)
 
 	(void)debugfs_create_file("state", S_IRUGO, omap_hwmod_dbg_dir,
 					NULL, &omap_hwmod_dbg_fops);
+	(void)debugfs_create_file("latency", S_IRUGO, omap_hwmod_dbg_dir,
+					NULL, &omap_hwmod_lat_dbg_fops);
 }
 
 #endif	/* CONFIG_DEBUG_FS */
@@ -2458,7 +2665,7 @@ static int __init omap_hwmod_setup_all(void)
 	WARN(IS_ERR_VALUE(r),
 	     "omap_hwmod: %s: _init_clocks failed\n", __func__);
 
-	omap_hwmod_for_each(_setup, NULL);
+	omap_hwmod_for_each(_setup_boot, NULL);
 
 #ifdef CONFIG_DEBUG_FS
 	omap_hwmod_dbg_init();
@@ -2479,12 +2686,16 @@ int omap_hwmod_enable(struct omap_hwmod *oh)
 {
 	int r;
 	unsigned long flags;
+	ktime_t start;
 
 	if (!oh)
 		return -EINVAL;
 
 	spin_lock_irqsave(&oh->_lock, flags);
+	start = ktime_get();
 	r = _enable(oh);
+	trace_hwmod_enable(oh->name,
+			   _account_latency(&oh->_enable_lat, start, r), r);
 	spin_unlock_irqrestore(&oh->_lock, flags);
 
 	return r;
@@ -2500,12 +2711,17 @@ int omap_hwmod_enable(struct omap_hwmod *oh)
 int omap_hwmod_idle(struct omap_hwmod *oh)
 {
 	unsigned long flags;
+	ktime_t start;
+	int r;
 
 	if (!oh)
 		return -EINVAL;
 
 	spin_lock_irqsave(&oh->_lock, flags);
-	_idle(oh);
+	start = ktime_get();
+	r = _idle(oh);
+	trace_hwmod_idle(oh->name,
+			 _account_latency(&oh->_idle_lat, start, r), r);
 	spin_unlock_irqrestore(&oh->_lock, flags);
 
 	return 0;
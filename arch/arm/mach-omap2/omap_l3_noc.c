@@ -27,6 +27,15 @@
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/clk.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+
+#include <plat/cpu.h>
 
 #include "omap_l3_noc.h"
 
@@ -128,6 +137,433 @@ static irqreturn_t l3_interrupt_handler(int irq, void *_l3)
 	return IRQ_HANDLED;
 }
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Statistic collectors
+ *
+ * Counters are set up through debugfs, l3_noc/<collector>/counter<n>,
+ * with a line "<probe> <initiator|any> <rd|wr|rw>", or "off". Once
+ * l3_noc/enable is set, all the counters are sampled every sample_ms
+ * into a ring of the last L3_SC_SAMPLES samples, which l3_noc/samples
+ * prints as the bytes seen by each counter during each period.
+ */
+static void l3_sc_program(struct l3_sc *sc, int n)
+{
+	struct l3_sc_counter *c = &sc->cnt[n];
+	void __iomem *base = sc->base + L3_SC_CNT_BASE(n);
+
+	__raw_writel(0, base + L3_SC_CNT_GLOBALEN);
+	if (c->probe < 0)
+		return;
+
+	__raw_writel(c->probe, sc->base + L3_SC_EVTMUX_SEL(n));
+	__raw_writel(c->master < 0 ? 0 : L3_SC_MSTADDR_MASK,
+		     base + L3_SC_CNT_MASK_MSTADDR);
+	__raw_writel(c->master < 0 ? 0 : l3_masters[c->master].id,
+		     base + L3_SC_CNT_MATCH_MSTADDR);
+	__raw_writel(c->rd, base + L3_SC_CNT_MATCH_RD);
+	__raw_writel(c->wr, base + L3_SC_CNT_MATCH_WR);
+	__raw_writel(L3_SC_OP_PAYLOAD_BYTES, base + L3_SC_CNT_OP_SEL);
+	__raw_writel(1, base + L3_SC_CNT_GLOBALEN);
+
+	c->last = __raw_readl(base + L3_SC_CNT_VALUE);
+}
+
+static void l3_sc_start(struct omap4_l3 *l3)
+{
+	struct l3_sc *sc;
+	int i, n;
+
+	for (i = 0; i < L3_SC_MAX_COLLECTORS; i++) {
+		sc = &l3->sc[i];
+		if (!sc->base)
+			continue;
+		__raw_writel(1, sc->base + L3_SC_EN);
+		for (n = 0; n < sc->desc->num_counters; n++)
+			l3_sc_program(sc, n);
+	}
+
+	l3->sc_head = 0;
+	l3->sc_count = 0;
+	l3->sc_stamp = ktime_get();
+	schedule_delayed_work(&l3->sc_work,
+			      msecs_to_jiffies(max(l3->sc_sample_ms, 1u)));
+}
+
+static void l3_sc_stop(struct omap4_l3 *l3)
+{
+	int i;
+
+	for (i = 0; i < L3_SC_MAX_COLLECTORS; i++)
+		if (l3->sc[i].base)
+			__raw_writel(0, l3->sc[i].base + L3_SC_EN);
+}
+
+static void l3_sc_sample(struct work_struct *work)
+{
+	struct omap4_l3 *l3 = container_of(to_delayed_work(work),
+					   struct omap4_l3, sc_work);
+	struct l3_sc_sample *s;
+	struct l3_sc *sc;
+	ktime_t now;
+	u32 val;
+	int i, n;
+
+	mutex_lock(&l3->sc_lock);
+	if (!l3->sc_enabled)
+		goto out;
+
+	now = ktime_get();
+	s = &l3->sc_ring[l3->sc_head];
+	s->stamp_us = ktime_us_delta(now, l3->sc_stamp);
+	memset(s->bytes, 0, sizeof(s->bytes));
+
+	for (i = 0; i < L3_SC_MAX_COLLECTORS; i++) {
+		sc = &l3->sc[i];
+		if (!sc->base)
+			continue;
+		for (n = 0; n < sc->desc->num_counters; n++) {
+			if (sc->cnt[n].probe < 0)
+				continue;
+			val = __raw_readl(sc->base + L3_SC_CNT_BASE(n) +
+					  L3_SC_CNT_VALUE);
+			s->bytes[i][n] = val - sc->cnt[n].last;
+			sc->cnt[n].last = val;
+		}
+	}
+
+	l3->sc_head = (l3->sc_head + 1) % L3_SC_SAMPLES;
+	if (l3->sc_count < L3_SC_SAMPLES)
+		l3->sc_count++;
+
+	schedule_delayed_work(&l3->sc_work,
+			      msecs_to_jiffies(max(l3->sc_sample_ms, 1u)));
+out:
+	mutex_unlock(&l3->sc_lock);
+}
+
+static int l3_sc_enable_set(void *data, u64 val)
+{
+	struct omap4_l3 *l3 = data;
+	int ret = 0;
+
+	mutex_lock(&l3->sc_lock);
+	if (!!val == l3->sc_enabled)
+		goto out;
+
+	if (val) {
+		ret = clk_enable(l3->sc_ick);
+		if (ret)
+			goto out;
+		l3_sc_start(l3);
+	} else {
+		l3_sc_stop(l3);
+		clk_disable(l3->sc_ick);
+	}
+	l3->sc_enabled = !!val;
+out:
+	mutex_unlock(&l3->sc_lock);
+
+	/* an already queued sample finds sc_enabled cleared and stops */
+	if (!val)
+		cancel_delayed_work_sync(&l3->sc_work);
+
+	return ret;
+}
+
+static int l3_sc_enable_get(void *data, u64 *val)
+{
+	struct omap4_l3 *l3 = data;
+
+	*val = l3->sc_enabled;
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(l3_sc_enable_fops, l3_sc_enable_get,
+			l3_sc_enable_set, "%llu\n");
+
+static void l3_sc_show_counter(struct seq_file *s, struct l3_sc *sc, int n)
+{
+	struct l3_sc_counter *c = &sc->cnt[n];
+
+	if (c->probe < 0) {
+		seq_printf(s, "off");
+		return;
+	}
+	seq_printf(s, "%s %s %s", sc->desc->probes[c->probe],
+		   c->master < 0 ? "any" : l3_masters[c->master].name,
+		   c->rd && c->wr ? "rw" : c->rd ? "rd" : "wr");
+}
+
+static int l3_sc_samples_show(struct seq_file *s, void *unused)
+{
+	struct omap4_l3 *l3 = s->private;
+	struct l3_sc_sample *smp;
+	struct l3_sc *sc;
+	unsigned int k, idx;
+	int i, n;
+
+	mutex_lock(&l3->sc_lock);
+
+	seq_printf(s, "# time_us");
+	for (i = 0; i < L3_SC_MAX_COLLECTORS; i++) {
+		sc = &l3->sc[i];
+		for (n = 0; sc->base && n < sc->desc->num_counters; n++) {
+			if (sc->cnt[n].probe < 0)
+				continue;
+			seq_printf(s, " | %s%d: ", sc->desc->name, n);
+			l3_sc_show_counter(s, sc, n);
+		}
+	}
+	seq_printf(s, "\n");
+
+	idx = (l3->sc_head + L3_SC_SAMPLES - l3->sc_count) % L3_SC_SAMPLES;
+	for (k = 0; k < l3->sc_count; k++) {
+		smp = &l3->sc_ring[(idx + k) % L3_SC_SAMPLES];
+		seq_printf(s, "%lld", smp->stamp_us);
+		for (i = 0; i < L3_SC_MAX_COLLECTORS; i++) {
+			sc = &l3->sc[i];
+			for (n = 0; sc->base && n < sc->desc->num_counters;
+			     n++)
+				if (sc->cnt[n].probe >= 0)
+					seq_printf(s, " %u", smp->bytes[i][n]);
+		}
+		seq_printf(s, "\n");
+	}
+
+	mutex_unlock(&l3->sc_lock);
+
+	return 0;
+}
+
+static int l3_sc_samples_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, l3_sc_samples_show, inode->i_private);
+}
+
+static const struct file_operations l3_sc_samples_fops = {
+	.open		= l3_sc_samples_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* counter files carry the collector in i_private, the index in the name */
+static struct l3_sc_counter *l3_sc_file_counter(struct file *file,
+						struct l3_sc **scp, int *np)
+{
+	struct l3_sc *sc = file->f_dentry->d_inode->i_private;
+	const char *name = (const char *)file->f_dentry->d_name.name;
+	int n;
+
+	if (sscanf(name, "counter%d", &n) != 1 ||
+	    n < 0 || n >= sc->desc->num_counters)
+		return NULL;
+
+	*scp = sc;
+	*np = n;
+	return &sc->cnt[n];
+}
+
+static int l3_sc_counter_show(struct seq_file *s, void *unused)
+{
+	struct l3_sc *sc;
+	int n;
+
+	if (!l3_sc_file_counter(s->private, &sc, &n))
+		return -EINVAL;
+
+	l3_sc_show_counter(s, sc, n);
+	seq_printf(s, "\n");
+	return 0;
+}
+
+static int l3_sc_counter_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, l3_sc_counter_show, file);
+}
+
+static ssize_t l3_sc_counter_write(struct file *file, const char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	struct l3_sc_counter *c, new = { .probe = -1, .master = -1 };
+	char buf[48], probe[16], master[16], dir[4];
+	struct omap4_l3 *l3;
+	struct l3_sc *sc;
+	int i, n;
+
+	c = l3_sc_file_counter(file, &sc, &n);
+	if (!c)
+		return -EINVAL;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%15s %15s %3s", probe, master, dir) != 3) {
+		if (strncmp(buf, "off", 3))
+			return -EINVAL;
+		goto set;
+	}
+
+	for (i = 0; i < sc->desc->num_probes; i++)
+		if (!strcasecmp(probe, sc->desc->probes[i]))
+			new.probe = i;
+	if (new.probe < 0)
+		return -EINVAL;
+
+	if (strcasecmp(master, "any")) {
+		for (i = 0; i < NUM_OF_L3_MASTERS; i++)
+			if (!strcasecmp(master, l3_masters[i].name))
+				new.master = i;
+		if (new.master < 0)
+			return -EINVAL;
+	}
+
+	new.rd = !strcmp(dir, "rd") || !strcmp(dir, "rw");
+	new.wr = !strcmp(dir, "wr") || !strcmp(dir, "rw");
+	if (!new.rd && !new.wr)
+		return -EINVAL;
+
+set:
+	l3 = sc->l3;
+	mutex_lock(&l3->sc_lock);
+	*c = new;
+	if (l3->sc_enabled)
+		l3_sc_program(sc, n);
+	mutex_unlock(&l3->sc_lock);
+
+	return count;
+}
+
+static const struct file_operations l3_sc_counter_fops = {
+	.open		= l3_sc_counter_open,
+	.read		= seq_read,
+	.write		= l3_sc_counter_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int l3_sc_probes_show(struct seq_file *s, void *unused)
+{
+	struct l3_sc *sc = s->private;
+	int i;
+
+	for (i = 0; i < sc->desc->num_probes; i++)
+		seq_printf(s, "%s\n", sc->desc->probes[i]);
+
+	return 0;
+}
+
+static int l3_sc_probes_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, l3_sc_probes_show, inode->i_private);
+}
+
+static const struct file_operations l3_sc_probes_fops = {
+	.open		= l3_sc_probes_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void l3_sc_exit(struct omap4_l3 *l3)
+{
+	int i;
+
+	if (!l3->debugfs_root)
+		return;
+
+	l3_sc_enable_set(l3, 0);
+	debugfs_remove_recursive(l3->debugfs_root);
+	for (i = 0; i < L3_SC_MAX_COLLECTORS; i++)
+		if (l3->sc[i].base)
+			iounmap(l3->sc[i].base);
+	clk_put(l3->sc_ick);
+	kfree(l3->sc_ring);
+	l3->debugfs_root = NULL;
+}
+
+static void __devinit l3_sc_init(struct omap4_l3 *l3)
+{
+	const struct l3_sc_desc *desc;
+	struct dentry *dir;
+	struct l3_sc *sc;
+	char name[16];
+	int i, n;
+
+	/* only the OMAP4 collectors are described */
+	if (!cpu_is_omap44xx())
+		return;
+
+	mutex_init(&l3->sc_lock);
+	INIT_DELAYED_WORK(&l3->sc_work, l3_sc_sample);
+	l3->sc_sample_ms = L3_SC_SAMPLE_MS;
+
+	l3->sc_ick = clk_get(NULL, "l3_instr_ick");
+	if (IS_ERR(l3->sc_ick)) {
+		dev_err(l3->dev, "no l3_instr_ick, no statistic collectors\n");
+		return;
+	}
+
+	l3->sc_ring = kcalloc(L3_SC_SAMPLES, sizeof(*l3->sc_ring),
+			      GFP_KERNEL);
+	if (!l3->sc_ring)
+		goto err_clk;
+
+	l3->debugfs_root = debugfs_create_dir("l3_noc", NULL);
+	if (IS_ERR_OR_NULL(l3->debugfs_root))
+		goto err_ring;
+
+	debugfs_create_file("enable", S_IRUGO | S_IWUSR, l3->debugfs_root,
+			    l3, &l3_sc_enable_fops);
+	debugfs_create_u32("sample_ms", S_IRUGO | S_IWUSR, l3->debugfs_root,
+			   &l3->sc_sample_ms);
+	debugfs_create_file("samples", S_IRUGO, l3->debugfs_root, l3,
+			    &l3_sc_samples_fops);
+
+	for (i = 0; i < L3_SC_MAX_COLLECTORS; i++) {
+		desc = &omap44xx_l3_sc[i];
+		sc = &l3->sc[i];
+		sc->l3 = l3;
+		sc->desc = desc;
+		for (n = 0; n < L3_SC_MAX_COUNTERS; n++)
+			sc->cnt[n].probe = -1;
+
+		sc->base = ioremap(desc->pa, 0x1000);
+		if (!sc->base) {
+			dev_err(l3->dev, "ioremap of %s collector failed\n",
+				desc->name);
+			continue;
+		}
+
+		dir = debugfs_create_dir(desc->name, l3->debugfs_root);
+		if (IS_ERR_OR_NULL(dir))
+			continue;
+		debugfs_create_file("probes", S_IRUGO, dir, sc,
+				    &l3_sc_probes_fops);
+		for (n = 0; n < desc->num_counters; n++) {
+			snprintf(name, sizeof(name), "counter%d", n);
+			debugfs_create_file(name, S_IRUGO | S_IWUSR, dir, sc,
+					    &l3_sc_counter_fops);
+		}
+	}
+
+	return;
+
+err_ring:
+	kfree(l3->sc_ring);
+	l3->debugfs_root = NULL;
+err_clk:
+	clk_put(l3->sc_ick);
+}
+#else
+static inline void l3_sc_init(struct omap4_l3 *l3) { }
+static inline void l3_sc_exit(struct omap4_l3 *l3) { }
+#endif
+
 static int __devinit omap4_l3_probe(struct platform_device *pdev)
 {
 	static struct omap4_l3 *l3;
@@ -138,6 +574,7 @@ static int __devinit omap4_l3_probe(struct platform_device *pdev)
 	if (!l3)
 		return -ENOMEM;
 
+	l3->dev = &pdev->dev;
 	platform_set_drvdata(pdev, l3);
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (!res) {
@@ -204,6 +641,8 @@ static int __devinit omap4_l3_probe(struct platform_device *pdev)
 		goto err4;
 	}
 
+	l3_sc_init(l3);
+
 	return 0;
 
 err4:
@@ -223,6 +662,7 @@ static int __devexit omap4_l3_remove(struct platform_device *pdev)
 {
 	struct omap4_l3 *l3 = platform_get_drvdata(pdev);
 
+	l3_sc_exit(l3);
 	free_irq(l3->app_irq, l3);
 	free_irq(l3->debug_irq, l3);
 	iounmap(l3->l3_base[0]);
@@ -163,6 +163,99 @@ static u32 *l3_targ[L3_MODULES] = {
 	l3_targ_inst_clk3,
 };
 
+/*
+ * L3 statistic collectors, in the L3 instrumentation clock domain. Each
+ * collector observes a set of probes (target or initiator ports) and has
+ * a few counters, each one counting the payload bytes seen on one probe,
+ * optionally restricted to one initiator and to reads or writes.
+ */
+#define L3_SC_MAX_COUNTERS		4
+#define L3_SC_MAX_COLLECTORS		2
+#define L3_SC_SAMPLES			512
+#define L3_SC_SAMPLE_MS			10
+
+/* collector registers */
+#define L3_SC_EN			0x08
+#define L3_SC_SOFTEN			0x0c
+#define L3_SC_EVTMUX_SEL(n)		(0x20 + ((n) << 2))
+#define L3_SC_CNT_BASE(n)		(0x40 + ((n) << 6))
+
+/* per counter registers, relative to L3_SC_CNT_BASE() */
+#define L3_SC_CNT_GLOBALEN		0x00
+#define L3_SC_CNT_MASK_MSTADDR		0x04
+#define L3_SC_CNT_MATCH_MSTADDR		0x08
+#define L3_SC_CNT_MATCH_RD		0x0c
+#define L3_SC_CNT_MATCH_WR		0x10
+#define L3_SC_CNT_OP_SEL		0x14
+#define L3_SC_CNT_VALUE			0x18
+
+#define L3_SC_OP_PAYLOAD_BYTES		0x3
+#define L3_SC_MSTADDR_MASK		0xff
+
+struct l3_sc_desc {
+	const char *name;
+	u32 pa;
+	int num_counters;
+	const char * const *probes;
+	int num_probes;
+};
+
+static const char * const l3_sc_sdram_probes[] = {
+	"EMIF1", "EMIF2",
+};
+
+static const char * const l3_sc_lat_probes[] = {
+	"MPU", "DSS", "ISS", "IVAHD", "SGX", "SDMA_Rd", "SDMA_Wr", "DucatiM3",
+	"FaceDetect",
+};
+
+static const struct l3_sc_desc omap44xx_l3_sc[L3_SC_MAX_COLLECTORS] = {
+	{
+		.name		= "sdram",
+		.pa		= 0x45001000,
+		.num_counters	= 4,
+		.probes		= l3_sc_sdram_probes,
+		.num_probes	= ARRAY_SIZE(l3_sc_sdram_probes),
+	},
+	{
+		.name		= "lat",
+		.pa		= 0x45002000,
+		.num_counters	= 4,
+		.probes		= l3_sc_lat_probes,
+		.num_probes	= ARRAY_SIZE(l3_sc_lat_probes),
+	},
+};
+
+/**
+ * struct l3_sc_counter - what one statistic collector counter counts
+ * @probe:	index in the probes of the collector, -1 when unused
+ * @master:	index in l3_masters, -1 for any initiator
+ * @rd:		count reads
+ * @wr:		count writes
+ * @last:	counter value at the previous sample
+ */
+struct l3_sc_counter {
+	int probe;
+	int master;
+	bool rd;
+	bool wr;
+	u32 last;
+};
+
+struct omap4_l3;
+
+struct l3_sc {
+	struct omap4_l3 *l3;
+	const struct l3_sc_desc *desc;
+	void __iomem *base;
+	struct l3_sc_counter cnt[L3_SC_MAX_COUNTERS];
+};
+
+struct l3_sc_sample {
+	s64 stamp_us;
+	u32 bytes[L3_SC_MAX_COLLECTORS][L3_SC_MAX_COUNTERS];
+};
+
 struct omap4_l3 {
 	struct device *dev;
 	struct clk *ick;
@@ -172,5 +265,18 @@ struct omap4_l3 {
 
 	int debug_irq;
 	int app_irq;
+
+	/* statistic collectors, sampled into a ring while enabled */
+	struct l3_sc sc[L3_SC_MAX_COLLECTORS];
+	struct clk *sc_ick;
+	struct mutex sc_lock;
+	struct delayed_work sc_work;
+	bool sc_enabled;
+	u32 sc_sample_ms;
+	ktime_t sc_stamp;
+	struct l3_sc_sample *sc_ring;
+	unsigned int sc_head;
+	unsigned int sc_count;
+	struct dentry *debugfs_root;
 };
 #endif
@@ -12,13 +12,280 @@
  */
 
 #include <linux/power/smartreflex.h>
+#include <linux/jiffies.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/workqueue.h>
+#include <linux/thermal_framework.h>
+
+#include <mach/id.h>
+
 #include "voltage.h"
 
+/*
+ * Calibrated voltages reached by SmartReflex, per OPP and temperature
+ * band. They are used as the OPP voltage on the next entry so that SR
+ * only has to correct the remaining error instead of converging down
+ * from the nominal voltage each time. The cache is kept across boots
+ * by saving /sys/power/sr_calibration and writing it back; it is keyed
+ * by the die id, so a cache from another chip is refused.
+ */
+#define SR_CAL_MAX_VDD		4
+#define SR_CAL_MAX_OPP		8
+#define SR_CAL_BANDS		6
+#define SR_CAL_BAND_MC		20000	/* 20C per band, above 100C last */
+/* only trust SR once it had this long to converge */
+#define SR_CAL_MIN_RUN		(HZ / 10)
+/* guard band added to a cached voltage */
+#define SR_CAL_MARGIN_UV	10000
+#define SR_CAL_TEMP_PERIOD	(10 * HZ)
+
+struct sr_class3_cal {
+	struct voltagedomain *voltdm;
+	u32 volt[SR_CAL_MAX_OPP][SR_CAL_BANDS];
+	unsigned long enabled_at;
+};
+
+static struct sr_class3_cal sr_cal[SR_CAL_MAX_VDD];
+static DEFINE_SPINLOCK(sr_cal_lock);
+static int sr_cal_band;
+static struct delayed_work sr_cal_temp_work;
+
+static struct sr_class3_cal *sr_class3_cal_get(struct voltagedomain *voltdm)
+{
+	int i;
+
+	for (i = 0; i < SR_CAL_MAX_VDD; i++) {
+		if (sr_cal[i].voltdm == voltdm)
+			return &sr_cal[i];
+		if (!sr_cal[i].voltdm) {
+			sr_cal[i].voltdm = voltdm;
+			return &sr_cal[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int sr_class3_vdata_index(struct voltagedomain *voltdm,
+				 struct omap_volt_data *vdata)
+{
+	int i = vdata - voltdm->volt_data;
+
+	return (i >= 0 && i < SR_CAL_MAX_OPP) ? i : -EINVAL;
+}
+
+/*
+ * Point each OPP of the domain at the voltage cached for the current
+ * temperature band. Runs with SR disabled, serialized with DVFS.
+ */
+static void sr_class3_cal_apply(struct sr_class3_cal *cal)
+{
+	struct voltagedomain *voltdm = cal->voltdm;
+	struct omap_volt_data *vdata;
+	unsigned long flags;
+	u32 volt;
+	int i;
+
+	spin_lock_irqsave(&sr_cal_lock, flags);
+	for (i = 0; i < SR_CAL_MAX_OPP &&
+	     voltdm->volt_data[i].volt_nominal; i++) {
+		vdata = &voltdm->volt_data[i];
+		volt = cal->volt[i][sr_cal_band];
+		if (volt)
+			volt = min(volt + SR_CAL_MARGIN_UV,
+				   vdata->volt_nominal);
+		vdata->volt_calibrated = volt;
+	}
+	spin_unlock_irqrestore(&sr_cal_lock, flags);
+
+	/* may run with irqs off, only refresh an existing cache */
+	if (voltdm->scale_cmds)
+		omap_voltage_update_scale_cmds(voltdm);
+}
+
+/* remember where SR took the current OPP */
+static void sr_class3_cal_save(struct omap_sr *sr, struct sr_class3_cal *cal)
+{
+	struct omap_volt_data *vdata;
+	unsigned long volt, flags;
+	int i;
+
+	if (!cal->enabled_at ||
+	    time_before(jiffies, cal->enabled_at + SR_CAL_MIN_RUN))
+		return;
+
+	vdata = omap_voltage_get_curr_vdata(sr->voltdm);
+	if (IS_ERR_OR_NULL(vdata))
+		return;
+	i = sr_class3_vdata_index(sr->voltdm, vdata);
+	if (i < 0)
+		return;
+
+	volt = omap_vp_get_curr_volt(sr->voltdm);
+	if (!volt || volt > vdata->volt_nominal)
+		return;
+
+	spin_lock_irqsave(&sr_cal_lock, flags);
+	cal->volt[i][sr_cal_band] = volt;
+	spin_unlock_irqrestore(&sr_cal_lock, flags);
+}
+
+static void sr_class3_cal_temp(struct work_struct *work)
+{
+	int temp;
+
+	if (!thermal_check_domain("cpu")) {
+		temp = thermal_lookup_temp("cpu");
+		if (temp >= 0)
+			sr_cal_band = clamp(temp / SR_CAL_BAND_MC, 0,
+					    SR_CAL_BANDS - 1);
+	}
+
+	schedule_delayed_work(&sr_cal_temp_work, SR_CAL_TEMP_PERIOD);
+}
+
+static void sr_class3_die_id(u32 *id)
+{
+	struct omap_die_id odi;
+
+	omap_get_die_id(&odi);
+	id[0] = odi.id_3;
+	id[1] = odi.id_2;
+	id[2] = odi.id_1;
+	id[3] = odi.id_0;
+}
+
+/*
+ * Format: a "die" line, then one "<vdd> <nominal uV> <band> <uV>" line
+ * per known calibration.
+ */
+static ssize_t sr_calibration_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	struct sr_class3_cal *cal;
+	unsigned long flags;
+	ssize_t len;
+	u32 id[4];
+	int v, i, b;
+
+	sr_class3_die_id(id);
+	len = snprintf(buf, PAGE_SIZE, "die %08x%08x%08x%08x\n",
+		       id[0], id[1], id[2], id[3]);
+
+	spin_lock_irqsave(&sr_cal_lock, flags);
+	for (v = 0; v < SR_CAL_MAX_VDD && sr_cal[v].voltdm; v++) {
+		cal = &sr_cal[v];
+		for (i = 0; i < SR_CAL_MAX_OPP &&
+		     cal->voltdm->volt_data[i].volt_nominal; i++)
+			for (b = 0; b < SR_CAL_BANDS; b++)
+				if (cal->volt[i][b])
+					len += snprintf(buf + len,
+						PAGE_SIZE - len,
+						"%s %u %d %u\n",
+						cal->voltdm->name,
+						cal->voltdm->volt_data[i].volt_nominal,
+						b, cal->volt[i][b]);
+	}
+	spin_unlock_irqrestore(&sr_cal_lock, flags);
+
+	return len;
+}
+
+static int sr_class3_cal_load(char *line)
+{
+	struct voltagedomain *voltdm;
+	struct sr_class3_cal *cal;
+	unsigned long flags;
+	char name[16];
+	u32 nominal, volt;
+	int band, i;
+
+	if (sscanf(line, "%15s %u %d %u", name, &nominal, &band, &volt) != 4)
+		return -EINVAL;
+	if (band < 0 || band >= SR_CAL_BANDS)
+		return -EINVAL;
+
+	voltdm = voltdm_lookup(name);
+	if (!voltdm || !voltdm->volt_data)
+		return -ENODEV;
+
+	for (i = 0; i < SR_CAL_MAX_OPP &&
+	     voltdm->volt_data[i].volt_nominal != nominal; i++)
+		if (!voltdm->volt_data[i].volt_nominal)
+			return -ENOENT;
+	if (i == SR_CAL_MAX_OPP)
+		return -ENOENT;
+	if (!volt || volt > nominal)
+		return -ERANGE;
+
+	spin_lock_irqsave(&sr_cal_lock, flags);
+	cal = sr_class3_cal_get(voltdm);
+	if (cal)
+		cal->volt[i][band] = volt;
+	spin_unlock_irqrestore(&sr_cal_lock, flags);
+
+	/* takes effect the next time SR is disabled on the domain */
+	return cal ? 0 : -ENOSPC;
+}
+
+static ssize_t sr_calibration_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t n)
+{
+	char *copy, *p, *line;
+	char die[33];
+	u32 id[4];
+	int ret = 0;
+
+	copy = kstrndup(buf, n, GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+
+	p = copy;
+	line = strsep(&p, "\n");
+	sr_class3_die_id(id);
+	snprintf(die, sizeof(die), "%08x%08x%08x%08x",
+		 id[0], id[1], id[2], id[3]);
+	if (strncmp(line, "die ", 4) || strcmp(strim(line + 4), die)) {
+		pr_warn("%s: calibration belongs to another chip\n", __func__);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	while ((line = strsep(&p, "\n"))) {
+		if (!*strim(line))
+			continue;
+		ret = sr_class3_cal_load(line);
+		if (ret) {
+			pr_warn("%s: bad entry \"%s\"\n", __func__, line);
+			goto out;
+		}
+	}
+
+out:
+	kfree(copy);
+	return ret ? ret : n;
+}
+
+static struct kobj_attribute sr_calibration_attr =
+	__ATTR(sr_calibration, 0644, sr_calibration_show,
+	       sr_calibration_store);
+
 static int sr_class3_enable(struct omap_sr *sr)
 {
 	unsigned long volt = 0;
 	struct omap_volt_data *vdata = NULL;
+	struct sr_class3_cal *cal;
+	unsigned long flags;
 
+	spin_lock_irqsave(&sr_cal_lock, flags);
+	cal = sr_class3_cal_get(sr->voltdm);
+	spin_unlock_irqrestore(&sr_cal_lock, flags);
+	if (cal)
+		cal->enabled_at = jiffies ? jiffies : 1;
 
 	vdata = omap_voltage_get_curr_vdata(sr->voltdm);
 	if (!vdata) {
@@ -40,9 +307,24 @@ static int sr_class3_enable(struct omap_sr *sr)
 
 static int sr_class3_disable(struct omap_sr *sr, int is_volt_reset)
 {
+	struct sr_class3_cal *cal;
+	unsigned long flags;
+
+	spin_lock_irqsave(&sr_cal_lock, flags);
+	cal = sr_class3_cal_get(sr->voltdm);
+	spin_unlock_irqrestore(&sr_cal_lock, flags);
+
 	sr_disable_errgen(sr->voltdm);
+	if (cal)
+		sr_class3_cal_save(sr, cal);
 	omap_vp_disable(sr->voltdm);
 	sr_disable(sr->voltdm);
+
+	if (cal) {
+		cal->enabled_at = 0;
+		sr_class3_cal_apply(cal);
+	}
+
 	if (is_volt_reset)
 		voltdm_reset(sr->voltdm);
 
@@ -66,6 +348,13 @@ static struct omap_sr_class_data class3_data = {
 static int __init sr_class3_init(void)
 {
 	pr_info("SmartReflex Class3 initialized\n");
+
+	if (sysfs_create_file(power_kobj, &sr_calibration_attr.attr))
+		pr_warn("%s: no sr_calibration file\n", __func__);
+
+	INIT_DELAYED_WORK_DEFERRABLE(&sr_cal_temp_work, sr_class3_cal_temp);
+	schedule_delayed_work(&sr_cal_temp_work, SR_CAL_TEMP_PERIOD);
+
 	return sr_register_class(&class3_data);
 }
 device_initcall(sr_class3_init);
@@ -10,6 +10,8 @@
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/bug.h>
+#include <linux/delay.h>
+#include <linux/hrtimer.h>
 
 
 #include "voltage.h"
@@ -110,6 +112,7 @@ int omap_vc_pre_scale(struct voltagedomain *voltdm,
 		      u8 *target_vsel, u8 *current_vsel)
 {
 	struct omap_vc_channel *vc = voltdm->vc;
+	struct omap_vdd_scale_cmd *cmd;
 	u32 vc_cmdval;
 
 	/* Check if sufficient pmic info is available for this vdd */
@@ -132,7 +135,8 @@ int omap_vc_pre_scale(struct voltagedomain *voltdm,
 		return -EINVAL;
 	}
 
-	*target_vsel = voltdm->pmic->uv_to_vsel(target_volt);
+	cmd = omap_voltage_get_scale_cmd(voltdm, target_v);
+	*target_vsel = cmd ? cmd->vsel : voltdm->pmic->uv_to_vsel(target_volt);
 	*current_vsel = voltdm->read(voltdm->vp->voltage);
 
 	/* Setting the ON voltage to the new target voltage */
@@ -143,8 +147,6 @@ int omap_vc_pre_scale(struct voltagedomain *voltdm,
 
 	voltdm->vc_param->on = target_volt;
 
-	omap_vp_update_errorgain(voltdm, target_v);
-
 	return 0;
 }
 
@@ -154,6 +156,7 @@ void omap_vc_post_scale(struct voltagedomain *voltdm,
 			u8 target_vsel, u8 current_vsel)
 {
 	struct omap_vc_channel *vc;
+	struct omap_vdd_scale_cmd *cmd;
 	u32 smps_steps = 0, smps_delay = 0;
 	u8 on_vsel, onlp_vsel;
 	u32 val;
@@ -173,16 +176,24 @@ void omap_vc_post_scale(struct voltagedomain *voltdm,
 	/* SMPS slew rate / step size. 2us added as buffer. */
 	smps_delay = DIV_ROUND_UP(smps_steps * voltdm->pmic->step_size,
 				  voltdm->pmic->slew_rate) + 2;
-	udelay(smps_delay);
+	if (voltdm->defer_settle)
+		voltdm->settle_until = ktime_add_us(ktime_get(), smps_delay);
+	else
+		udelay(smps_delay);
 
 	voltdm->curr_volt = target_vdata;
 
 	/* Set up the on voltage for wakeup from lp and OFF */
-	onlp_vsel = target_vsel;
-	on_vsel = target_vsel;
-	val = (on_vsel << vc->common->cmd_on_shift) |
-	       (onlp_vsel << vc->common->cmd_onlp_shift) |
-	       vc->setup_voltage_common;
+	cmd = omap_voltage_get_scale_cmd(voltdm, target_vdata);
+	if (cmd) {
+		val = cmd->vc_cmdval;
+	} else {
+		onlp_vsel = target_vsel;
+		on_vsel = target_vsel;
+		val = (on_vsel << vc->common->cmd_on_shift) |
+		       (onlp_vsel << vc->common->cmd_onlp_shift) |
+		       vc->setup_voltage_common;
+	}
 	voltdm->write(val, vc->cmdval_reg);
 }
 
@@ -202,6 +213,8 @@ int omap_vc_bypass_scale(struct voltagedomain *voltdm,
 	if (ret)
 		return ret;
 
+	omap_vp_update_errorgain(voltdm, target_v);
+
 	vc_valid = vc->common->valid;
 	vc_bypass_val_reg = vc->common->bypass_val_reg;
 	vc_bypass_value = (target_vsel << vc->common->data_shift) |
@@ -77,15 +77,17 @@ int voltdm_unregister_notifier(struct voltagedomain *voltdm,
 
 
 /**
- * voltdm_scale() - API to scale voltage of a particular voltage domain.
+ * voltdm_scale_start() - Start scaling the voltage of a voltage domain
  * @voltdm: pointer to the voltage domain which is to be scaled.
- * @target_volt: The target voltage of the voltage domain
+ * @target_v: The target voltage data of the voltage domain
  *
- * This API should be called by the kernel to do the voltage scaling
- * for a particular voltage domain during DVFS.
+ * Sends the new voltage to the PMIC but doesn't wait for the SMPS to
+ * slew to it, so that several rails can ramp at the same time. Every
+ * successful call must be followed by voltdm_scale_finish() before the
+ * domain is used at the new voltage.
  */
-int voltdm_scale(struct voltagedomain *voltdm,
-			struct omap_volt_data *target_v)
+int voltdm_scale_start(struct voltagedomain *voltdm,
+		       struct omap_volt_data *target_v)
 {
 	int ret;
 	struct omap_voltage_notifier notify;
@@ -102,16 +104,77 @@ int voltdm_scale(struct voltagedomain *voltdm,
 		return -ENODATA;
 	}
 
+	/* a previous transition has to settle first */
+	voltdm_scale_finish(voltdm);
+
 	notify.voltdm = voltdm;
 	notify.target_volt = target_volt;
 	srcu_notifier_call_chain(&voltdm->change_notify_list,
 				 OMAP_VOLTAGE_PRECHANGE, (void *)&notify);
 
+	voltdm->settle_until = ktime_get();
+	voltdm->defer_settle = true;
 	ret = voltdm->scale(voltdm, target_v);
+	voltdm->defer_settle = false;
+
+	if (ret) {
+		notify.op_result = ret;
+		srcu_notifier_call_chain(&voltdm->change_notify_list,
+					 OMAP_VOLTAGE_POSTCHANGE,
+					 (void *)&notify);
+		return ret;
+	}
+
+	voltdm->settle_volt = target_volt;
+	voltdm->settle_pending = true;
+	return 0;
+}
+
+/**
+ * voltdm_scale_finish() - Wait for a voltage domain to settle
+ * @voltdm: pointer to the voltage domain started by voltdm_scale_start()
+ *
+ * Waits for whatever is left of the SMPS slew time and notifies the
+ * voltage change. Does nothing if no transition is pending.
+ */
+void voltdm_scale_finish(struct voltagedomain *voltdm)
+{
+	struct omap_voltage_notifier notify;
+	s64 left;
+
+	if (!voltdm || IS_ERR(voltdm) || !voltdm->settle_pending)
+		return;
 
-	notify.op_result = ret;
+	left = ktime_us_delta(voltdm->settle_until, ktime_get());
+	if (left > 0)
+		udelay(left);
+
+	voltdm->settle_pending = false;
+
+	notify.voltdm = voltdm;
+	notify.target_volt = voltdm->settle_volt;
+	notify.op_result = 0;
 	srcu_notifier_call_chain(&voltdm->change_notify_list,
 				 OMAP_VOLTAGE_POSTCHANGE, (void *)&notify);
+}
+
+/**
+ * voltdm_scale() - API to scale voltage of a particular voltage domain.
+ * @voltdm: pointer to the voltage domain which is to be scaled.
+ * @target_volt: The target voltage of the voltage domain
+ *
+ * This API should be called by the kernel to do the voltage scaling
+ * for a particular voltage domain during DVFS.
+ */
+int voltdm_scale(struct voltagedomain *voltdm,
+			struct omap_volt_data *target_v)
+{
+	int ret;
+
+	ret = voltdm_scale_start(voltdm, target_v);
+	if (!ret)
+		voltdm_scale_finish(voltdm);
+
 	return ret;
 }
 
@@ -208,6 +271,67 @@ struct omap_volt_data *omap_voltage_get_voltdata(struct voltagedomain *voltdm,
 	return ERR_PTR(-ENODATA);
 }
 
+/**
+ * omap_voltage_update_scale_cmds() - Precompute the VP/VC scale commands
+ * @voltdm:	pointer to the VDD whose commands are to be built
+ *
+ * Converts every entry of the voltage table into the register values the
+ * scale path writes out, so that nothing but the current voltage has to
+ * be read back on a transition. Must be called again whenever the
+ * operation voltages of the table change, e.g. on a SmartReflex
+ * calibration update, with no transition running on the domain.
+ *
+ * Returns 0 on success, else the error value. Without precomputed
+ * commands the scale path computes the values on the fly.
+ */
+int omap_voltage_update_scale_cmds(struct voltagedomain *voltdm)
+{
+	struct omap_vdd_scale_cmd *cmds;
+	struct omap_volt_data *vdata;
+	int i, n;
+
+	if (!voltdm || IS_ERR(voltdm) || !voltdm->volt_data)
+		return -EINVAL;
+
+	if (!voltdm->pmic || !voltdm->pmic->uv_to_vsel)
+		return -ENODATA;
+
+	for (n = 0; voltdm->volt_data[n].volt_nominal; n++)
+		;
+
+	cmds = voltdm->scale_cmds;
+	if (n != voltdm->nr_scale_cmds) {
+		cmds = krealloc(cmds, n * sizeof(*cmds), GFP_KERNEL);
+		if (!cmds)
+			return -ENOMEM;
+	}
+
+	for (i = 0; i < n; i++) {
+		vdata = &voltdm->volt_data[i];
+		cmds[i].vsel = voltdm->pmic->uv_to_vsel(
+					omap_get_operation_voltage(vdata));
+
+		cmds[i].vpconfig = 0;
+		if (voltdm->vp)
+			cmds[i].vpconfig = (vdata->vp_errgain <<
+				__ffs(voltdm->vp->common->vpconfig_errorgain_mask)) |
+				(cmds[i].vsel <<
+				__ffs(voltdm->vp->common->vpconfig_initvoltage_mask));
+
+		cmds[i].vc_cmdval = 0;
+		if (voltdm->vc)
+			cmds[i].vc_cmdval =
+				(cmds[i].vsel << voltdm->vc->common->cmd_on_shift) |
+				(cmds[i].vsel << voltdm->vc->common->cmd_onlp_shift) |
+				voltdm->vc->setup_voltage_common;
+	}
+
+	voltdm->scale_cmds = cmds;
+	voltdm->nr_scale_cmds = n;
+
+	return 0;
+}
+
 /**
  * omap_voltage_register_pmic() - API to register PMIC specific data
  * @voltdm:	pointer to the VDD for which the PMIC specific data is
@@ -372,6 +496,10 @@ int __init omap_voltage_late_init(void)
 			omap_vp_init(voltdm);
 		}
 
+		if (omap_voltage_update_scale_cmds(voltdm))
+			pr_warning("%s: vdd_%s scale commands not cached\n",
+				   __func__, voltdm->name);
+
 		if (voltage_dir)
 			voltdm_debugfs_init(voltage_dir, voltdm);
 	}
@@ -17,6 +17,7 @@
 #include <linux/notifier.h>
 #include <linux/err.h>
 #include <linux/spinlock.h>
+#include <linux/ktime.h>
 
 #include <mach/common.h>
 #include <plat/voltage.h>
@@ -74,6 +75,8 @@ struct omap_vfsm_instance {
  *             by the domain and other associated per voltage data.
  * @change_notify_list: notifiers that need to be told on pre and post change
  * @auto_ret: does voltage domain can use auto_ret feature
+ * @scale_cmds: VP/VC values precomputed for each entry of @volt_data
+ * @nr_scale_cmds: number of entries in @scale_cmds
  */
 struct voltagedomain {
 	char *name;
@@ -111,6 +114,30 @@ struct voltagedomain {
 	/* spinlock for voltage usecount */
 	spinlock_t lock;
 	bool auto_ret;
+
+	/* SMPS settling deferred by voltdm_scale_start() */
+	bool defer_settle;
+	bool settle_pending;
+	ktime_t settle_until;
+	unsigned long settle_volt;
+
+	struct omap_vdd_scale_cmd *scale_cmds;
+	int nr_scale_cmds;
+};
+
+/**
+ * struct omap_vdd_scale_cmd - register values precomputed for one OPP
+ * @vsel:	PMIC value of the OPP operation voltage
+ * @vpconfig:	VP_CONFIG error gain and init voltage fields
+ * @vc_cmdval:	VC_CMD_VAL value to program once the OPP is reached
+ *
+ * Built by omap_voltage_update_scale_cmds() so that the scale path only
+ * has to write them out.
+ */
+struct omap_vdd_scale_cmd {
+	u8 vsel;
+	u32 vpconfig;
+	u32 vc_cmdval;
 };
 
 /* Min and max voltages from OMAP perspective */
@@ -239,6 +266,23 @@ void omap_voltage_get_volttable(struct voltagedomain *voltdm,
 struct omap_volt_data *omap_voltage_get_curr_vdata(struct voltagedomain *voltdm);
 struct omap_volt_data *omap_voltage_get_voltdata(struct voltagedomain *voltdm,
 						 unsigned long volt);
+int omap_voltage_update_scale_cmds(struct voltagedomain *voltdm);
+
+/* precomputed commands for vdata, or NULL to compute them on the fly */
+static inline struct omap_vdd_scale_cmd *omap_voltage_get_scale_cmd(
+		struct voltagedomain *voltdm, struct omap_volt_data *vdata)
+{
+	int i;
+
+	if (!voltdm->scale_cmds || IS_ERR_OR_NULL(vdata))
+		return NULL;
+
+	i = vdata - voltdm->volt_data;
+	if (i < 0 || i >= voltdm->nr_scale_cmds)
+		return NULL;
+
+	return &voltdm->scale_cmds[i];
+}
 
 int omap_voltage_register_pmic(struct voltagedomain *voltdm,
 			       struct omap_voltdm_pmic *pmic);
@@ -261,6 +305,9 @@ int voltdm_for_each_pwrdm(struct voltagedomain *voltdm,
 			  int (*fn)(struct voltagedomain *voltdm,
 				    struct powerdomain *pwrdm));
 void voltdm_reset(struct voltagedomain *voltdm);
+int voltdm_scale_start(struct voltagedomain *voltdm,
+		       struct omap_volt_data *target_v);
+void voltdm_scale_finish(struct voltagedomain *voltdm);
 
 int __init __init_volt_domain_notifier_list(struct voltagedomain **voltdms);
 
@@ -270,7 +317,8 @@ static inline unsigned long omap_get_operation_voltage(
 {
 	if (!vdata)
 		return 0;
-	return vdata->volt_nominal;
+	return vdata->volt_calibrated ? vdata->volt_calibrated :
+		vdata->volt_nominal;
 }
 static inline unsigned long omap_get_nominal_voltage(
 				struct omap_volt_data *vdata)
@@ -89,20 +89,30 @@ static inline int _vp_wait_for_idle(struct voltagedomain *voltdm,
 	return 0;
 }
 
+/*
+ * With precomputed commands the error gain is updated in the same write
+ * as the init voltage.
+ */
 static u32 _vp_set_init_voltage(struct voltagedomain *voltdm,
-				unsigned long volt)
+				unsigned long volt,
+				struct omap_vdd_scale_cmd *cmd)
 {
 	struct omap_vp_instance *vp = voltdm->vp;
 	u32 vpconfig;
 	char vsel;
 
-	vsel = voltdm->pmic->uv_to_vsel(volt);
-
 	vpconfig = voltdm->read(vp->vpconfig);
 	vpconfig &= ~(vp->common->vpconfig_initvoltage_mask |
 		      vp->common->vpconfig_forceupdate |
 		      vp->common->vpconfig_initvdd);
-	vpconfig |= vsel << __ffs(vp->common->vpconfig_initvoltage_mask);
+	if (cmd) {
+		vpconfig &= ~vp->common->vpconfig_errorgain_mask;
+		vpconfig |= cmd->vpconfig;
+	} else {
+		vsel = voltdm->pmic->uv_to_vsel(volt);
+		vpconfig |= vsel <<
+			__ffs(vp->common->vpconfig_initvoltage_mask);
+	}
 	voltdm->write(vpconfig, vp->vpconfig);
 
 	/* Trigger initVDD value copy to voltage processor */
@@ -261,6 +271,7 @@ int omap_vp_forceupdate_scale(struct voltagedomain *voltdm,
 			      struct omap_volt_data *target_v)
 {
 	struct omap_vp_instance *vp;
+	struct omap_vdd_scale_cmd *cmd;
 	u32 vpconfig;
 	u8 target_vsel, current_vsel;
 	int ret, timeout = 0;
@@ -304,11 +315,16 @@ int omap_vp_forceupdate_scale(struct voltagedomain *voltdm,
 	if (ret)
 		return ret;
 
+	cmd = omap_voltage_get_scale_cmd(voltdm, target_v);
+	if (!cmd)
+		omap_vp_update_errorgain(voltdm, target_v);
+
 	/*
 	 * Clear all pending TransactionDone interrupt/status. Typical latency
-	 * is <3us
+	 * is <3us. The previous transition normally left it clear already.
 	 */
-	while (timeout++ < VP_TRANXDONE_TIMEOUT) {
+	while (vp->common->ops->check_txdone(vp->id) &&
+	       timeout++ < VP_TRANXDONE_TIMEOUT) {
 		vp->common->ops->clear_txdone(vp->id);
 		if (!vp->common->ops->check_txdone(vp->id))
 			break;
@@ -324,7 +340,7 @@ int omap_vp_forceupdate_scale(struct voltagedomain *voltdm,
 		return -ETIMEDOUT;
 	}
 
-	vpconfig = _vp_set_init_voltage(voltdm, target_volt);
+	vpconfig = _vp_set_init_voltage(voltdm, target_volt, cmd);
 
 	/* Force update of voltage */
 	voltdm->write(vpconfig | vp->common->vpconfig_forceupdate,
@@ -417,7 +433,9 @@ void omap_vp_enable(struct voltagedomain *voltdm)
 	}
 
 	vpconfig = _vp_set_init_voltage(voltdm,
-					omap_get_operation_voltage(volt));
+					omap_get_operation_voltage(volt),
+					omap_voltage_get_scale_cmd(voltdm,
+								   volt));
 
 	/* Enable VP */
 	vpconfig |= vp->common->vpconfig_vpenable;
@@ -21,6 +21,7 @@
 #include <linux/mutex.h>
 #include <linux/cpufreq.h>
 #include <linux/io.h>
+#include <linux/percpu.h>
 
 #include <plat/clock.h>
 
@@ -30,6 +31,77 @@ static DEFINE_SPINLOCK(clockfw_lock);
 
 static struct clk_functions *arch_clock;
 
+/* set once every clock rate has been computed from its parent's */
+static bool clk_rates_valid;
+
+#if defined(CONFIG_PM_DEBUG) && defined(CONFIG_DEBUG_FS)
+/**
+ * struct clk_lock_stats - clockfw_lock usage, per CPU
+ * @locked: clockfw_lock acquisitions
+ * @contended: acquisitions that had to wait for another CPU
+ * @fast_enable: clk_enable() calls that did not take clockfw_lock
+ * @fast_disable: clk_disable() calls that did not take clockfw_lock
+ * @recalc: child rates recalculated by propagate_rate()
+ * @recalc_pruned: subtrees propagate_rate() skipped, their rate unchanged
+ */
+struct clk_lock_stats {
+	unsigned long	locked;
+	unsigned long	contended;
+	unsigned long	fast_enable;
+	unsigned long	fast_disable;
+	unsigned long	recalc;
+	unsigned long	recalc_pruned;
+};
+static DEFINE_PER_CPU(struct clk_lock_stats, clk_lock_stats);
+
+#define clk_stat_inc(field)	this_cpu_inc(clk_lock_stats.field)
+#else
+#define clk_stat_inc(field)	do { } while (0)
+#endif
+
+#define clockfw_lock_irqsave(flags)					\
+	do {								\
+		if (!spin_trylock_irqsave(&clockfw_lock, flags)) {	\
+			spin_lock_irqsave(&clockfw_lock, flags);	\
+			clk_stat_inc(contended);			\
+		}							\
+		clk_stat_inc(locked);					\
+	} while (0)
+
+#ifdef CONFIG_ARCH_OMAP2PLUS
+/**
+ * clk_usecount_add - change the usecount of a clock that stays enabled
+ * @clk: struct clk * to change the usecount of
+ * @delta: +1 to add a user, -1 to remove one
+ * @min: lowest usecount the change is allowed from
+ *
+ * omap2_clk_enable() sets the usecount to 1 only once the clock runs
+ * and omap2_clk_disable() drops it to 0 before stopping the clock, both
+ * under clockfw_lock.  Any other change leaves the hardware alone and is
+ * made with a cmpxchg, so it does not need the lock.  Returns true if the
+ * usecount was changed, false if it was below @min.
+ */
+bool clk_usecount_add(struct clk *clk, int delta, int min)
+{
+	int n = ACCESS_ONCE(clk->usecount);
+	int old;
+
+	while (n >= min) {
+		old = cmpxchg(&clk->usecount, n, n + delta);
+		if (old == n)
+			return true;
+		n = old;
+	}
+
+	return false;
+}
+#else
+static inline bool clk_usecount_add(struct clk *clk, int delta, int min)
+{
+	return false;
+}
+#endif
+
 /*
  * Standard clock functions defined in include/linux/clk.h
  */
@@ -45,7 +117,12 @@ int clk_enable(struct clk *clk)
 	if (!arch_clock || !arch_clock->clk_enable)
 		return -EINVAL;
 
-	spin_lock_irqsave(&clockfw_lock, flags);
+	if (clk_usecount_add(clk, 1, 1)) {
+		clk_stat_inc(fast_enable);
+		return 0;
+	}
+
+	clockfw_lock_irqsave(flags);
 	ret = arch_clock->clk_enable(clk);
 	spin_unlock_irqrestore(&clockfw_lock, flags);
 
@@ -63,7 +140,12 @@ void clk_disable(struct clk *clk)
 	if (!arch_clock || !arch_clock->clk_disable)
 		return;
 
-	spin_lock_irqsave(&clockfw_lock, flags);
+	if (clk_usecount_add(clk, -1, 2)) {
+		clk_stat_inc(fast_disable);
+		return;
+	}
+
+	clockfw_lock_irqsave(flags);
 	if (clk->usecount == 0) {
 		pr_err("Trying disable clock %s with 0 usecount\n",
 		       clk->name);
@@ -80,17 +162,11 @@ EXPORT_SYMBOL(clk_disable);
 
 unsigned long clk_get_rate(struct clk *clk)
 {
-	unsigned long flags;
-	unsigned long ret;
-
 	if (clk == NULL || IS_ERR(clk))
 		return 0;
 
-	spin_lock_irqsave(&clockfw_lock, flags);
-	ret = clk->rate;
-	spin_unlock_irqrestore(&clockfw_lock, flags);
-
-	return ret;
+	/* a single word, updated under clockfw_lock */
+	return ACCESS_ONCE(clk->rate);
 }
 EXPORT_SYMBOL(clk_get_rate);
 
@@ -109,7 +185,7 @@ long clk_round_rate(struct clk *clk, unsigned long rate)
 	if (!arch_clock || !arch_clock->clk_round_rate)
 		return 0;
 
-	spin_lock_irqsave(&clockfw_lock, flags);
+	clockfw_lock_irqsave(flags);
 	ret = arch_clock->clk_round_rate(clk, rate);
 	spin_unlock_irqrestore(&clockfw_lock, flags);
 
@@ -128,7 +204,7 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 	if (!arch_clock || !arch_clock->clk_set_rate)
 		return ret;
 
-	spin_lock_irqsave(&clockfw_lock, flags);
+	clockfw_lock_irqsave(flags);
 	ret = arch_clock->clk_set_rate(clk, rate);
 	if (ret == 0)
 		propagate_rate(clk);
@@ -149,7 +225,7 @@ int clk_set_parent(struct clk *clk, struct clk *parent)
 	if (!arch_clock || !arch_clock->clk_set_parent)
 		return ret;
 
-	spin_lock_irqsave(&clockfw_lock, flags);
+	clockfw_lock_irqsave(flags);
 	if (clk->usecount == 0) {
 		ret = arch_clock->clk_set_parent(clk, parent);
 		if (ret == 0)
@@ -220,18 +296,38 @@ void clk_reparent(struct clk *child, struct clk *parent)
 	   to the proper parent */
 }
 
-/* Propagate rate to children */
-void propagate_rate(struct clk *tclk)
+static void __propagate_rate(struct clk *tclk, bool all)
 {
 	struct clk *clkp;
+	unsigned long rate;
 
 	list_for_each_entry(clkp, &tclk->children, sibling) {
-		if (clkp->recalc)
+		rate = clkp->rate;
+		if (clkp->recalc) {
 			clkp->rate = clkp->recalc(clkp);
-		propagate_rate(clkp);
+			clk_stat_inc(recalc);
+		}
+
+		/* the rates below only depend on this one */
+		if (!all && clkp->rate == rate) {
+			if (!list_empty(&clkp->children))
+				clk_stat_inc(recalc_pruned);
+			continue;
+		}
+
+		__propagate_rate(clkp, all);
 	}
 }
 
+/*
+ * Propagate rate to children.  Once recalculate_root_clocks() has run,
+ * children whose rate did not change keep their subtree as it is.
+ */
+void propagate_rate(struct clk *tclk)
+{
+	__propagate_rate(tclk, !clk_rates_valid);
+}
+
 /**
  * followparent_set_rate - set rate on parent and propagate to children
  * @clk: struct clk * to set the rate on
@@ -270,8 +366,10 @@ void recalculate_root_clocks(void)
 	list_for_each_entry(clkp, &root_clks, sibling) {
 		if (clkp->recalc)
 			clkp->rate = clkp->recalc(clkp);
-		propagate_rate(clkp);
+		__propagate_rate(clkp, true);
 	}
+
+	clk_rates_valid = true;
 }
 
 /**
@@ -366,7 +464,7 @@ int omap_clk_enable_autoidle_all(void)
 	struct clk *c;
 	unsigned long flags;
 
-	spin_lock_irqsave(&clockfw_lock, flags);
+	clockfw_lock_irqsave(flags);
 
 	list_for_each_entry(c, &clocks, node)
 		if (c->ops->allow_idle)
@@ -399,7 +497,7 @@ int omap_clk_for_each(int (*fn)(struct clk *clk, void *user), void *data)
 		return -EINVAL;
 	}
 
-	spin_lock_irqsave(&clockfw_lock, flags);
+	clockfw_lock_irqsave(flags);
 
 	list_for_each_entry(c, &clocks, node) {
 		ret = fn(c, data);
@@ -421,7 +519,7 @@ int omap_clk_disable_autoidle_all(void)
 	struct clk *c;
 	unsigned long flags;
 
-	spin_lock_irqsave(&clockfw_lock, flags);
+	clockfw_lock_irqsave(flags);
 
 	list_for_each_entry(c, &clocks, node)
 		if (c->ops->deny_idle)
@@ -477,7 +575,7 @@ static int __init clk_disable_unused(void)
 
 	pr_info("clock: disabling unused clocks to save power\n");
 
-	spin_lock_irqsave(&clockfw_lock, flags);
+	clockfw_lock_irqsave(flags);
 	list_for_each_entry(ck, &clocks, node) {
 		if (ck->ops == &clkops_null)
 			continue;
@@ -548,6 +646,43 @@ static const struct file_operations debug_clock_fops = {
 	.release        = single_release,
 };
 
+static int clk_dbg_show_lock_stats(struct seq_file *s, void *unused)
+{
+	struct clk_lock_stats *st, sum = { 0 };
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(clk_lock_stats, cpu);
+		sum.locked += st->locked;
+		sum.contended += st->contended;
+		sum.fast_enable += st->fast_enable;
+		sum.fast_disable += st->fast_disable;
+		sum.recalc += st->recalc;
+		sum.recalc_pruned += st->recalc_pruned;
+	}
+
+	seq_printf(s, "locked:        %lu\n", sum.locked);
+	seq_printf(s, "contended:     %lu\n", sum.contended);
+	seq_printf(s, "fast_enable:   %lu\n", sum.fast_enable);
+	seq_printf(s, "fast_disable:  %lu\n", sum.fast_disable);
+	seq_printf(s, "recalc:        %lu\n", sum.recalc);
+	seq_printf(s, "recalc_pruned: %lu\n", sum.recalc_pruned);
+
+	return 0;
+}
+
+static int clk_dbg_lock_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, clk_dbg_show_lock_stats, inode->i_private);
+}
+
+static const struct file_operations debug_clock_lock_stats_fops = {
+	.open           = clk_dbg_lock_stats_open,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static int clk_debugfs_register_one(struct clk *c)
 {
 	int err;
@@ -559,7 +694,7 @@ static int clk_debugfs_register_one(struct clk *c)
 		return -ENOMEM;
 	c->dent = d;
 
-	d = debugfs_create_u8("usecount", S_IRUGO, c->dent, (u8 *)&c->usecount);
+	d = debugfs_create_u32("usecount", S_IRUGO, c->dent, (u32 *)&c->usecount);
 	if (!d) {
 		err = -ENOMEM;
 		goto err_out;
@@ -618,7 +753,12 @@ static int __init clk_debugfs_init(void)
 	}
 
 	d = debugfs_create_file("summary", S_IRUGO,
-		d, NULL, &debug_clock_fops);
+		clk_debugfs_root, NULL, &debug_clock_fops);
+	if (!d)
+		return -ENOMEM;
+
+	d = debugfs_create_file("lock_stats", S_IRUGO,
+		clk_debugfs_root, NULL, &debug_clock_lock_stats_fops);
 	if (!d)
 		return -ENOMEM;
 
@@ -35,6 +35,9 @@
 #include <linux/io.h>
 #include <linux/slab.h>
 #include <linux/delay.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
 
 #include <mach/hardware.h>
 #include <plat/dma.h>
@@ -120,6 +123,8 @@ static struct dma_link_info *dma_linked_lch;
 static int dma_lch_count;
 static int dma_chan_count;
 static int omap_dma_reserve_channels;
+/* channels at the top of the range kept for OMAP_DMA_PRIO_RT */
+static int omap_dma_rt_channels = 2;
 
 static spinlock_t dma_chan_lock;
 static struct omap_dma_lch *dma_chan;
@@ -678,21 +683,68 @@ static inline void omap2_disable_irq_lch(int lch)
 	spin_unlock_irqrestore(&dma_chan_lock, flags);
 }
 
+/* Called with dma_chan_lock held */
+static int omap_dma_find_free_ch(int first, int last)
+{
+	int ch;
+
+	for (ch = first; ch < last; ch++)
+		if (dma_chan[ch].dev_id == -1)
+			return ch;
+
+	return -1;
+}
+
+static inline void omap_dma_account_start(int lch)
+{
+	dma_chan[lch].starts++;
+	dma_chan[lch].start_ns = sched_clock();
+}
+
+static inline void omap_dma_account_stop(int lch, bool restart)
+{
+	struct omap_dma_lch *chan = dma_chan + lch;
+	u64 now;
+
+	if (!chan->start_ns)
+		return;
+
+	now = sched_clock();
+	chan->busy_ns += now - chan->start_ns;
+	chan->start_ns = restart ? now : 0;
+}
+
 int omap_request_dma(int dev_id, const char *dev_name,
 		     void (*callback)(int lch, u16 ch_status, void *data),
 		     void *data, int *dma_ch_out)
 {
-	int ch, free_ch = -1;
+	return omap_request_dma_prio(dev_id, dev_name, callback, data,
+				     dma_ch_out, OMAP_DMA_PRIO_BULK);
+}
+EXPORT_SYMBOL(omap_request_dma);
+
+/**
+ * omap_request_dma_prio - request a channel of a given priority class
+ * @prio_class: OMAP_DMA_PRIO_RT channels are taken from the reserved pool
+ * first, the other classes never touch that pool.
+ */
+int omap_request_dma_prio(int dev_id, const char *dev_name,
+		     void (*callback)(int lch, u16 ch_status, void *data),
+		     void *data, int *dma_ch_out,
+		     enum omap_dma_prio_class prio_class)
+{
+	int free_ch, rt_first;
 	unsigned long flags;
 	struct omap_dma_lch *chan;
 
 	spin_lock_irqsave(&dma_chan_lock, flags);
-	for (ch = 0; ch < dma_chan_count; ch++) {
-		if (free_ch == -1 && dma_chan[ch].dev_id == -1) {
-			free_ch = ch;
-			/* Exit after first free channel found */
-			break;
-		}
+	rt_first = dma_chan_count - omap_dma_rt_channels;
+	if (prio_class == OMAP_DMA_PRIO_RT) {
+		free_ch = omap_dma_find_free_ch(rt_first, dma_chan_count);
+		if (free_ch == -1)
+			free_ch = omap_dma_find_free_ch(0, rt_first);
+	} else {
+		free_ch = omap_dma_find_free_ch(0, rt_first);
 	}
 	if (free_ch == -1) {
 		spin_unlock_irqrestore(&dma_chan_lock, flags);
@@ -713,6 +765,17 @@ int omap_request_dma(int dev_id, const char *dev_name,
 	chan->callback = callback;
 	chan->data = data;
 	chan->flags = 0;
+	chan->prio_class = prio_class;
+	chan->starts = 0;
+	chan->busy_ns = 0;
+	chan->start_ns = 0;
+
+	if (cpu_class_is_omap2())
+		omap_dma_set_prio_lch(free_ch,
+			prio_class != OMAP_DMA_PRIO_BULK ?
+				DMA_CH_PRIO_HIGH : DMA_CH_PRIO_LOW,
+			prio_class == OMAP_DMA_PRIO_RT ?
+				DMA_CH_PRIO_HIGH : DMA_CH_PRIO_LOW);
 
 #ifndef CONFIG_ARCH_OMAP1
 	if (cpu_class_is_omap2()) {
@@ -753,7 +816,7 @@ int omap_request_dma(int dev_id, const char *dev_name,
 
 	return 0;
 }
-EXPORT_SYMBOL(omap_request_dma);
+EXPORT_SYMBOL(omap_request_dma_prio);
 
 void omap_free_dma(int lch)
 {
@@ -926,6 +989,7 @@ void omap_start_dma(int lch)
 	p->dma_write(l, CCR, lch);
 
 	dma_chan[lch].flags |= OMAP_DMA_ACTIVE;
+	omap_dma_account_start(lch);
 }
 EXPORT_SYMBOL(omap_start_dma);
 
@@ -998,6 +1062,7 @@ void omap_stop_dma(int lch)
 	}
 
 	dma_chan[lch].flags &= ~OMAP_DMA_ACTIVE;
+	omap_dma_account_stop(lch, false);
 }
 EXPORT_SYMBOL(omap_stop_dma);
 
@@ -1845,8 +1910,10 @@ static int omap1_dma_handle_ch(int ch)
 	if (unlikely(csr & OMAP_DMA_DROP_IRQ))
 		printk(KERN_WARNING "DMA synchronization event drop occurred with device %d\n",
 				    dma_chan[ch].dev_id);
-	if (likely(csr & OMAP_DMA_BLOCK_IRQ))
+	if (likely(csr & OMAP_DMA_BLOCK_IRQ)) {
 		dma_chan[ch].flags &= ~OMAP_DMA_ACTIVE;
+		omap_dma_account_stop(ch, dma_chan[ch].next_lch != -1);
+	}
 	if (likely(dma_chan[ch].callback != NULL))
 		dma_chan[ch].callback(ch, csr, dma_chan[ch].data);
 
@@ -1941,6 +2008,10 @@ static int omap2_dma_handle_ch(int ch)
 		p->dma_write(status, CSR, ch);
 	}
 
+	/* linked channels carry on with the next block by themselves */
+	if (status & OMAP_DMA_BLOCK_IRQ)
+		omap_dma_account_stop(ch, dma_chan[ch].next_lch != -1);
+
 	if (likely(dma_chan[ch].callback != NULL))
 		dma_chan[ch].callback(ch, status, dma_chan[ch].data);
 
@@ -2019,6 +2090,106 @@ void omap2_dma_context_restore(void)
 		p->dma_write(0x3 , IRQSTATUS_L0, 0);
 }
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *omap_dma_debugfs_dir;
+static u64 omap_dma_stats_start;
+
+static int omap_dma_channels_show(struct seq_file *s, void *unused)
+{
+	static const char * const class_names[] = {
+		[OMAP_DMA_PRIO_BULK]	= "bulk",
+		[OMAP_DMA_PRIO_DISPLAY]	= "display",
+		[OMAP_DMA_PRIO_RT]	= "rt",
+	};
+	u64 now, window, busy;
+	unsigned long flags;
+	int ch;
+
+	now = sched_clock();
+	window = max_t(u64, now - omap_dma_stats_start, 1);
+	seq_printf(s, "window: %llu ms, rt pool: lch %d-%d\n",
+		   div_u64(window, NSEC_PER_MSEC),
+		   dma_chan_count - omap_dma_rt_channels, dma_chan_count - 1);
+	seq_printf(s, "lch dev_id class   starts     busy_ms util name\n");
+
+	for (ch = 0; ch < dma_chan_count; ch++) {
+		struct omap_dma_lch *chan = dma_chan + ch;
+
+		spin_lock_irqsave(&dma_chan_lock, flags);
+		if (chan->dev_id == -1) {
+			spin_unlock_irqrestore(&dma_chan_lock, flags);
+			continue;
+		}
+		busy = chan->busy_ns;
+		if (chan->start_ns)
+			busy += now - chan->start_ns;
+		spin_unlock_irqrestore(&dma_chan_lock, flags);
+
+		seq_printf(s, "%3d %6d %-7s %8u %11llu %3u%% %s\n",
+			   ch, chan->dev_id, class_names[chan->prio_class],
+			   chan->starts, div_u64(busy, NSEC_PER_MSEC),
+			   (unsigned)div64_u64(busy * 100, window),
+			   chan->dev_name ? chan->dev_name : "");
+	}
+
+	return 0;
+}
+
+static int omap_dma_channels_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_dma_channels_show, inode->i_private);
+}
+
+/* any write restarts the accounting window */
+static ssize_t omap_dma_channels_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+	u64 now;
+	int ch;
+
+	spin_lock_irqsave(&dma_chan_lock, flags);
+	now = sched_clock();
+	for (ch = 0; ch < dma_chan_count; ch++) {
+		dma_chan[ch].starts = 0;
+		dma_chan[ch].busy_ns = 0;
+		if (dma_chan[ch].start_ns)
+			dma_chan[ch].start_ns = now;
+	}
+	omap_dma_stats_start = now;
+	spin_unlock_irqrestore(&dma_chan_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations omap_dma_channels_fops = {
+	.open		= omap_dma_channels_open,
+	.read		= seq_read,
+	.write		= omap_dma_channels_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void omap_dma_debugfs_init(void)
+{
+	omap_dma_stats_start = sched_clock();
+	omap_dma_debugfs_dir = debugfs_create_dir("omap_dma", NULL);
+	if (IS_ERR_OR_NULL(omap_dma_debugfs_dir))
+		return;
+	debugfs_create_file("channels", S_IRUGO | S_IWUSR,
+			    omap_dma_debugfs_dir, NULL,
+			    &omap_dma_channels_fops);
+}
+
+static void omap_dma_debugfs_exit(void)
+{
+	debugfs_remove_recursive(omap_dma_debugfs_dir);
+}
+#else
+static inline void omap_dma_debugfs_init(void) { }
+static inline void omap_dma_debugfs_exit(void) { }
+#endif
+
 static int __devinit omap_system_dma_probe(struct platform_device *pdev)
 {
 	int ch, ret = 0;
@@ -2042,6 +2213,10 @@ static int __devinit omap_system_dma_probe(struct platform_device *pdev)
 
 	dma_lch_count		= d->lch_count;
 	dma_chan_count		= dma_lch_count;
+
+	/* leave at least half of the channels to everybody else */
+	omap_dma_rt_channels	= clamp(omap_dma_rt_channels, 0,
+					dma_chan_count / 2);
 	dma_chan		= d->chan;
 	enable_1510_mode	= d->dev_caps & ENABLE_1510_MODE;
 
@@ -2091,10 +2266,12 @@ static int __devinit omap_system_dma_probe(struct platform_device *pdev)
 		}
 	}
 
+	/* one thread is kept for the high priority (RT) channels */
 	if (cpu_is_omap2430() || cpu_is_omap34xx() || cpu_is_omap44xx() ||
 							cpu_is_omap54xx())
 		omap_dma_set_global_params(DMA_DEFAULT_ARB_RATE,
-				DMA_DEFAULT_FIFO_DEPTH, 0);
+				DMA_DEFAULT_FIFO_DEPTH,
+				omap_dma_rt_channels ? 1 : 0);
 
 	if (cpu_class_is_omap2()) {
 		strcpy(irq_name, "0");
@@ -2119,6 +2296,7 @@ static int __devinit omap_system_dma_probe(struct platform_device *pdev)
 		dma_chan[1].dev_id = 1;
 	}
 	p->show_dma_caps();
+	omap_dma_debugfs_init();
 	return 0;
 
 exit_dma_irq_fail:
@@ -2140,6 +2318,8 @@ static int __devexit omap_system_dma_remove(struct platform_device *pdev)
 {
 	int dma_irq;
 
+	omap_dma_debugfs_exit();
+
 	if (cpu_class_is_omap2()) {
 		char irq_name[4];
 		strcpy(irq_name, "0");
@@ -2224,4 +2404,17 @@ static int __init omap_dma_cmdline_reserve_ch(char *str)
 
 __setup("omap_dma_reserve_ch=", omap_dma_cmdline_reserve_ch);
 
+/*
+ * Size the pool reserved for OMAP_DMA_PRIO_RT channels with
+ * "omap_dma_rt_ch=", 0 disables the reservation.
+ */
+static int __init omap_dma_cmdline_rt_ch(char *str)
+{
+	if (get_option(&str, &omap_dma_rt_channels) != 1)
+		omap_dma_rt_channels = 0;
+	return 1;
+}
+
+__setup("omap_dma_rt_ch=", omap_dma_cmdline_rt_ch);
+
 
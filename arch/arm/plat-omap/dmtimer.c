@@ -506,6 +506,36 @@ int omap_dm_timer_set_pwm(struct omap_dm_timer *timer, int def_on,
 }
 EXPORT_SYMBOL_GPL(omap_dm_timer_set_pwm);
 
+/*
+ * Latch the counter into TCAR1 on the given OMAP_TIMER_CTRL_TCM_* edges of
+ * the timer event pin, 0 stops capturing. The pin is turned into an input
+ * while capturing.
+ */
+int omap_dm_timer_set_capture(struct omap_dm_timer *timer, unsigned int edges)
+{
+	u32 l;
+
+	if (unlikely(!timer))
+		return -EINVAL;
+
+	if (edges & ~OMAP_TIMER_CTRL_TCM_BOTHEDGES)
+		return -EINVAL;
+
+	omap_dm_timer_enable(timer);
+	l = omap_dm_timer_read_reg(timer, OMAP_TIMER_CTRL_REG);
+	l &= ~(OMAP_TIMER_CTRL_GPOCFG | OMAP_TIMER_CTRL_CAPTMODE |
+	       OMAP_TIMER_CTRL_TCM_BOTHEDGES);
+	if (edges)
+		l |= OMAP_TIMER_CTRL_GPOCFG | edges;
+	omap_dm_timer_write_reg(timer, OMAP_TIMER_CTRL_REG, l);
+
+	/* Save the context */
+	timer->context.tclr = l;
+	omap_dm_timer_disable(timer);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(omap_dm_timer_set_capture);
+
 int omap_dm_timer_set_prescaler(struct omap_dm_timer *timer, int prescaler)
 {
 	u32 l;
@@ -584,6 +614,17 @@ unsigned int omap_dm_timer_read_counter(struct omap_dm_timer *timer)
 }
 EXPORT_SYMBOL_GPL(omap_dm_timer_read_counter);
 
+unsigned int omap_dm_timer_read_capture(struct omap_dm_timer *timer)
+{
+	if (unlikely(!timer || pm_runtime_suspended(&timer->pdev->dev))) {
+		pr_err("%s: timer not available or enabled.\n", __func__);
+		return 0;
+	}
+
+	return __omap_dm_timer_read_capture(timer, timer->posted);
+}
+EXPORT_SYMBOL_GPL(omap_dm_timer_read_capture);
+
 int omap_dm_timer_write_counter(struct omap_dm_timer *timer, unsigned int value)
 {
 	if (unlikely(!timer || pm_runtime_suspended(&timer->pdev->dev))) {
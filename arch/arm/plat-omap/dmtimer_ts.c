@@ -0,0 +1,268 @@
+/*
+ * linux/arch/arm/plat-omap/dmtimer_ts.c
+ *
+ * Hardware event timestamps latched by dual-mode timer captures
+ *
+ * Copyright (C) 2012 Texas Instruments Incorporated - http://www.ti.com/
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * A driver that timestamps an event with ktime_get() in its interrupt
+ * handler also stamps the interrupt latency, which varies by tens of
+ * microseconds with what the CPU was doing.  When the event line is also
+ * wired to the event capture pin of a dual-mode timer, the timer latches
+ * its free-running counter on the edge itself.  The handler then only has
+ * to read how many timer cycles ago that was and subtract it from the
+ * current time.
+ *
+ * Events whose line does not reach a timer are still registered with a
+ * negative timer id. They are stamped with ktime_get() and show up in the
+ * statistics, so the latency of the stamps that do get corrected can be
+ * compared to them.
+ */
+
+#include <linux/module.h>
+#include <linux/clk.h>
+#include <linux/clocksource.h>
+#include <linux/debugfs.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include <plat/dmtimer.h>
+#include <plat/dmtimer_ts.h>
+
+/**
+ * struct omap_ts_event - a timestamped hardware event
+ * @node:		entry in omap_ts_events
+ * @name:		event name, shown in debugfs
+ * @timer:		timer latching the event, NULL for software stamps
+ * @rate:		timer counter rate
+ * @mult:		timer cycles to ns, with @shift
+ * @shift:		timer cycles to ns, with @mult
+ * @lock:		serializes stamps and protects the statistics below
+ * @events:		number of stamps taken
+ * @captured:		stamps corrected by a capture
+ * @missed:		stamps a capture was expected for but did not come
+ * @latency_ns:		total time between the events and their stamps
+ * @latency_max_ns:	longest time between an event and its stamp
+ */
+struct omap_ts_event {
+	struct list_head node;
+	const char *name;
+	struct omap_dm_timer *timer;
+	unsigned long rate;
+	u32 mult, shift;
+	spinlock_t lock;
+	unsigned long events;
+	unsigned long captured;
+	unsigned long missed;
+	u64 latency_ns;
+	u64 latency_max_ns;
+};
+
+static LIST_HEAD(omap_ts_events);
+static DEFINE_MUTEX(omap_ts_lock);
+
+/**
+ * omap_ts_event_get - register a timestamped event
+ * @name:	event name
+ * @timer_id:	dual-mode timer whose capture pin the event is wired to,
+ *		negative if it is wired to none
+ *
+ * The timer is claimed and kept running from the system clock as long as
+ * the event is registered.
+ */
+struct omap_ts_event *omap_ts_event_get(const char *name, int timer_id)
+{
+	struct omap_ts_event *ev;
+	int r;
+
+	ev = kzalloc(sizeof(*ev), GFP_KERNEL);
+	if (!ev)
+		return ERR_PTR(-ENOMEM);
+
+	ev->name = name;
+	spin_lock_init(&ev->lock);
+
+	if (timer_id >= 0) {
+		ev->timer = omap_dm_timer_request_specific(timer_id);
+		if (!ev->timer) {
+			r = -EBUSY;
+			goto err_free;
+		}
+
+		r = omap_dm_timer_set_source(ev->timer,
+					     OMAP_TIMER_SRC_SYS_CLK);
+		if (r)
+			goto err_timer;
+
+		ev->rate = clk_get_rate(omap_dm_timer_get_fclk(ev->timer));
+		if (!ev->rate) {
+			r = -EINVAL;
+			goto err_timer;
+		}
+		clocks_calc_mult_shift(&ev->mult, &ev->shift, ev->rate,
+				       NSEC_PER_SEC, 1);
+
+		r = omap_dm_timer_set_capture(ev->timer,
+					      OMAP_TIMER_CTRL_TCM_LOWTOHIGH);
+		if (r)
+			goto err_timer;
+
+		/* leaves the timer enabled, stamps read it from any context */
+		r = omap_dm_timer_set_load_start(ev->timer, 1, 0);
+		if (r)
+			goto err_timer;
+		omap_dm_timer_write_status(ev->timer, OMAP_TIMER_INT_CAPTURE);
+	}
+
+	mutex_lock(&omap_ts_lock);
+	list_add_tail(&ev->node, &omap_ts_events);
+	mutex_unlock(&omap_ts_lock);
+
+	return ev;
+
+err_timer:
+	omap_dm_timer_free(ev->timer);
+err_free:
+	pr_err("%s: no capture timer %d for %s: %d\n", __func__,
+	       timer_id, name, r);
+	kfree(ev);
+	return ERR_PTR(r);
+}
+EXPORT_SYMBOL_GPL(omap_ts_event_get);
+
+void omap_ts_event_put(struct omap_ts_event *ev)
+{
+	if (IS_ERR_OR_NULL(ev))
+		return;
+
+	mutex_lock(&omap_ts_lock);
+	list_del(&ev->node);
+	mutex_unlock(&omap_ts_lock);
+
+	if (ev->timer) {
+		omap_dm_timer_stop(ev->timer);
+		omap_dm_timer_set_capture(ev->timer, 0);
+		omap_dm_timer_free(ev->timer);
+	}
+	kfree(ev);
+}
+EXPORT_SYMBOL_GPL(omap_ts_event_put);
+
+/**
+ * omap_ts_event_stamp - time at which the last event happened
+ * @ev:		event, or NULL or an error pointer to stamp with ktime_get()
+ *
+ * Called from the interrupt handler of the event, before anything slow.
+ * Falls back to the current time when the timer did not capture an edge
+ * since the previous stamp, or captured one too long ago to belong to
+ * this event.
+ */
+ktime_t omap_ts_event_stamp(struct omap_ts_event *ev)
+{
+	struct omap_dm_timer *timer;
+	unsigned long flags;
+	ktime_t now, stamp;
+	u32 count, capture;
+	u64 ns;
+
+	if (IS_ERR_OR_NULL(ev))
+		return ktime_get();
+
+	spin_lock_irqsave(&ev->lock, flags);
+
+	now = ktime_get();
+	stamp = now;
+	ev->events++;
+
+	timer = ev->timer;
+	if (!timer)
+		goto out;
+
+	count = __omap_dm_timer_read_counter(timer, timer->posted);
+	if (!(__omap_dm_timer_read_raw_status(timer) &
+	      OMAP_TIMER_INT_CAPTURE)) {
+		ev->missed++;
+		goto out;
+	}
+
+	capture = __omap_dm_timer_read_capture(timer, timer->posted);
+	__omap_dm_timer_write_status(timer, OMAP_TIMER_INT_CAPTURE);
+
+	/* captured more than a second ago, not this event */
+	if (count - capture >= ev->rate) {
+		ev->missed++;
+		goto out;
+	}
+
+	ns = ((u64)(count - capture) * ev->mult) >> ev->shift;
+	stamp = ktime_sub_ns(now, ns);
+
+	ev->captured++;
+	ev->latency_ns += ns;
+	ev->latency_max_ns = max(ev->latency_max_ns, ns);
+out:
+	spin_unlock_irqrestore(&ev->lock, flags);
+
+	return stamp;
+}
+EXPORT_SYMBOL_GPL(omap_ts_event_stamp);
+
+#ifdef CONFIG_DEBUG_FS
+static int omap_ts_show(struct seq_file *s, void *unused)
+{
+	struct omap_ts_event *ev;
+	unsigned long events, captured, missed;
+	u64 latency_ns, latency_max_ns;
+
+	seq_printf(s, "%-16s %5s %10s %10s %10s %8s %8s\n", "event", "timer",
+		   "events", "captured", "missed", "avg us", "max us");
+
+	mutex_lock(&omap_ts_lock);
+	list_for_each_entry(ev, &omap_ts_events, node) {
+		spin_lock_irq(&ev->lock);
+		events = ev->events;
+		captured = ev->captured;
+		missed = ev->missed;
+		latency_ns = ev->latency_ns;
+		latency_max_ns = ev->latency_max_ns;
+		spin_unlock_irq(&ev->lock);
+
+		if (captured)
+			do_div(latency_ns, captured);
+		seq_printf(s, "%-16s %5d %10lu %10lu %10lu %8llu %8llu\n",
+			   ev->name, ev->timer ? ev->timer->id : -1,
+			   events, captured, missed,
+			   div_u64(latency_ns, NSEC_PER_USEC),
+			   div_u64(latency_max_ns, NSEC_PER_USEC));
+	}
+	mutex_unlock(&omap_ts_lock);
+
+	return 0;
+}
+
+static int omap_ts_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_ts_show, NULL);
+}
+
+static const struct file_operations omap_ts_fops = {
+	.open		= omap_ts_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init omap_ts_debugfs_init(void)
+{
+	debugfs_create_file("dmtimer_ts", S_IRUGO, NULL, NULL, &omap_ts_fops);
+	return 0;
+}
+late_initcall(omap_ts_debugfs_init);
+#endif
@@ -255,9 +255,9 @@ struct clk {
 	long			(*round_rate)(struct clk *, unsigned long);
 	void			(*init)(struct clk *);
 	u8			enable_bit;
-	s8			usecount;
 	u8			fixed_div;
 	u8			flags;
+	int			usecount;
 #ifdef CONFIG_ARCH_OMAP2PLUS
 	void __iomem		*clksel_reg;
 	u32			clksel_mask;
@@ -293,6 +293,9 @@ extern int clk_register(struct clk *clk);
 extern void clk_reparent(struct clk *child, struct clk *parent);
 extern void clk_unregister(struct clk *clk);
 extern void propagate_rate(struct clk *clk);
+#ifdef CONFIG_ARCH_OMAP2PLUS
+extern bool clk_usecount_add(struct clk *clk, int delta, int min);
+#endif
 extern void recalculate_root_clocks(void);
 extern unsigned long followparent_recalc(struct clk *clk);
 extern int followparent_set_rate(struct clk *clk, unsigned long rate);
@@ -406,6 +406,17 @@ struct omap_dma_channel_params {
 #endif
 };
 
+/*
+ * Channel priority classes, given at request time.  Realtime channels
+ * come from a reserved pool and get high read and write priority,
+ * display channels high read priority, bulk channels the default.
+ */
+enum omap_dma_prio_class {
+	OMAP_DMA_PRIO_BULK = 0,
+	OMAP_DMA_PRIO_DISPLAY,
+	OMAP_DMA_PRIO_RT,
+};
+
 struct omap_dma_lch {
 	int next_lch;
 	int dev_id;
@@ -421,6 +432,11 @@ struct omap_dma_lch {
 	int state;
 	int chain_id;
 	int status;
+	/* utilisation accounting */
+	enum omap_dma_prio_class prio_class;
+	u32 starts;
+	u64 busy_ns;
+	u64 start_ns;
 };
 
 struct omap_dma_dev_attr {
@@ -452,6 +468,10 @@ extern void omap_set_dma_priority(int lch, int dst_port, int priority);
 extern int omap_request_dma(int dev_id, const char *dev_name,
 			void (*callback)(int lch, u16 ch_status, void *data),
 			void *data, int *dma_ch);
+extern int omap_request_dma_prio(int dev_id, const char *dev_name,
+			void (*callback)(int lch, u16 ch_status, void *data),
+			void *data, int *dma_ch,
+			enum omap_dma_prio_class prio_class);
 extern void omap_enable_dma_irq(int ch, u16 irq_bits);
 extern void omap_disable_dma_irq(int ch, u16 irq_bits);
 extern void omap_free_dma(int ch);
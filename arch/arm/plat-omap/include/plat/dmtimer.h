@@ -130,6 +130,7 @@ int omap_dm_timer_set_load(struct omap_dm_timer *timer, int autoreload, unsigned
 int omap_dm_timer_set_load_start(struct omap_dm_timer *timer, int autoreload, unsigned int value);
 int omap_dm_timer_set_match(struct omap_dm_timer *timer, int enable, unsigned int match);
 int omap_dm_timer_set_pwm(struct omap_dm_timer *timer, int def_on, int toggle, int trigger);
+int omap_dm_timer_set_capture(struct omap_dm_timer *timer, unsigned int edges);
 int omap_dm_timer_set_prescaler(struct omap_dm_timer *timer, int prescaler);
 
 int omap_dm_timer_set_int_enable(struct omap_dm_timer *timer, unsigned int value);
@@ -137,6 +138,7 @@ int omap_dm_timer_set_int_enable(struct omap_dm_timer *timer, unsigned int value
 unsigned int omap_dm_timer_read_status(struct omap_dm_timer *timer);
 int omap_dm_timer_write_status(struct omap_dm_timer *timer, unsigned int value);
 unsigned int omap_dm_timer_read_counter(struct omap_dm_timer *timer);
+unsigned int omap_dm_timer_read_capture(struct omap_dm_timer *timer);
 int omap_dm_timer_write_counter(struct omap_dm_timer *timer, unsigned int value);
 
 int omap_dm_timers_active(void);
@@ -446,6 +448,22 @@ __omap_dm_timer_read_counter(struct omap_dm_timer *timer, int posted)
 	return __omap_dm_timer_read(timer, OMAP_TIMER_COUNTER_REG, posted);
 }
 
+static inline unsigned int
+__omap_dm_timer_read_capture(struct omap_dm_timer *timer, int posted)
+{
+	return __omap_dm_timer_read(timer, OMAP_TIMER_CAPTURE_REG, posted);
+}
+
+/* interrupt flags, including the disabled ones */
+static inline unsigned int
+__omap_dm_timer_read_raw_status(struct omap_dm_timer *timer)
+{
+	if (timer->revision == 1)
+		return __raw_readl(timer->irq_stat);
+
+	return __raw_readl(timer->io_base + OMAP_TIMER_V2_IRQSTATUS_RAW);
+}
+
 static inline void __omap_dm_timer_write_status(struct omap_dm_timer *timer,
 						unsigned int value)
 {
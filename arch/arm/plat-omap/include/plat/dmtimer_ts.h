@@ -0,0 +1,42 @@
+/*
+ * arch/arm/plat-omap/include/plat/dmtimer_ts.h
+ *
+ * Hardware event timestamps latched by dual-mode timer captures
+ *
+ * Copyright (C) 2012 Texas Instruments Incorporated - http://www.ti.com/
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ */
+
+#ifndef __ASM_ARCH_DMTIMER_TS_H
+#define __ASM_ARCH_DMTIMER_TS_H
+
+#include <linux/err.h>
+#include <linux/hrtimer.h>
+
+struct omap_ts_event;
+
+#ifdef CONFIG_OMAP_DM_TIMER_TS
+struct omap_ts_event *omap_ts_event_get(const char *name, int timer_id);
+void omap_ts_event_put(struct omap_ts_event *ev);
+ktime_t omap_ts_event_stamp(struct omap_ts_event *ev);
+#else
+static inline struct omap_ts_event *omap_ts_event_get(const char *name,
+						      int timer_id)
+{
+	return NULL;
+}
+
+static inline void omap_ts_event_put(struct omap_ts_event *ev)
+{
+}
+
+static inline ktime_t omap_ts_event_stamp(struct omap_ts_event *ev)
+{
+	return ktime_get();
+}
+#endif
+
+#endif /* __ASM_ARCH_DMTIMER_TS_H */
@@ -26,6 +26,8 @@
 
 struct dsscomp_platform_data {
 	unsigned int tiler1d_slotsz;
+	/* dual-mode timer capturing the primary display vsync, 0 if none */
+	int vsync_capture_timer;
 };
 
 /* queuing operations */
@@ -49,4 +51,9 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 
 void dsscomp_set_platform_data(struct dsscomp_platform_data *data);
 
+/* primary display vsync, called from interrupt context */
+struct notifier_block;
+int dsscomp_register_vsync_notifier(struct notifier_block *nb);
+void dsscomp_unregister_vsync_notifier(struct notifier_block *nb);
+
 #endif
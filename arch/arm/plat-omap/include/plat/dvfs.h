@@ -21,6 +21,8 @@ extern struct mutex omap_dvfs_lock;
 int omap_dvfs_register_device(struct device *dev, char *voltdm_name,
 				char *clk_name);
 int omap_device_scale(struct device *target_dev, unsigned long rate);
+int omap_dvfs_get_scale_time(struct device *target_dev, u32 *volt_us,
+			     u32 *clk_us);
 static inline bool omap_dvfs_is_any_dev_scaling(void)
 {
 	return mutex_is_locked(&omap_dvfs_lock);
@@ -36,6 +38,11 @@ static inline int omap_device_scale(struct device *target_dev,
 {
 	return 0;
 }
+static inline int omap_dvfs_get_scale_time(struct device *target_dev,
+					   u32 *volt_us, u32 *clk_us)
+{
+	return -ENODEV;
+}
 static inline bool omap_dvfs_is_any_dev_scaling(void)
 {
 	return false;
@@ -32,6 +32,29 @@ union iommu_qos {
 	struct dev_pm_qos_request dev_pm_qos;
 };
 
+struct cr_regs {
+	union {
+		struct {
+			u16 cam_l;
+			u16 cam_h;
+		};
+		u32 cam;
+	};
+	union {
+		struct {
+			u16 ram_l;
+			u16 ram_h;
+		};
+		u32 ram;
+	};
+};
+
+/* at most this many tlb entries can be locked, the rest is for the walker */
+#define OMAP_IOMMU_MAX_LOCKED	16
+
+/* number of OMAP_IOMMU_ERR_* bits */
+#define OMAP_IOMMU_NR_ERRS	5
+
 struct omap_iommu {
 	const char	*name;
 	struct module	*owner;
@@ -59,23 +82,15 @@ struct omap_iommu {
 	u32 da_start;
 	u32 da_end;
 	union iommu_qos	qos_request;
-};
 
-struct cr_regs {
-	union {
-		struct {
-			u16 cam_l;
-			u16 cam_h;
-		};
-		u32 cam;
-	};
-	union {
-		struct {
-			u16 ram_l;
-			u16 ram_h;
-		};
-		u32 ram;
-	};
+	/* tlb entries locked at runtime, least recently used first */
+	spinlock_t	tlb_lock;	/* protect locked* */
+	struct cr_regs	locked[OMAP_IOMMU_MAX_LOCKED];
+	int		nr_locked;
+	int		max_locked;
+	unsigned long	lock_evictions;
+
+	unsigned long	faults[OMAP_IOMMU_NR_ERRS];
 };
 
 struct iotlb_lock {
@@ -231,5 +246,14 @@ extern ssize_t
 omap_iommu_dump_ctx(struct omap_iommu *obj, char *buf, ssize_t len);
 extern size_t
 omap_dump_tlb_entries(struct omap_iommu *obj, char *buf, ssize_t len);
+extern ssize_t
+omap_iommu_dump_pgsizes(struct omap_iommu *obj, char *buf, ssize_t len);
+extern ssize_t
+omap_iommu_dump_tlb_stats(struct omap_iommu *obj, char *buf, ssize_t len);
+
+extern int omap_iommu_lock_region(struct iommu_domain *domain, u32 da,
+				  size_t len, u32 flags);
+extern void omap_iommu_unlock_region(struct iommu_domain *domain, u32 da,
+				     size_t len);
 
 #endif /* __MACH_IOMMU_H */
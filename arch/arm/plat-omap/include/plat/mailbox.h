@@ -49,7 +49,7 @@ struct omap_mbox_queue {
 	struct work_struct	work;
 	struct tasklet_struct	tasklet;
 	struct omap_mbox	*mbox;
-	bool full;
+	bool full;		/* rx interrupt masked until the work catches up */
 };
 
 struct omap_mbox {
@@ -61,6 +61,7 @@ struct omap_mbox {
 	void			*priv;
 	int			use_count;
 	struct blocking_notifier_head   notifier;
+	struct blocking_notifier_head	batch_notifier;
 	unsigned int		pm_constraint;
 };
 
@@ -68,6 +69,7 @@ int omap_mbox_msg_send(struct omap_mbox *, mbox_msg_t msg);
 void omap_mbox_init_seq(struct omap_mbox *);
 
 struct omap_mbox *omap_mbox_get(const char *, struct notifier_block *nb);
+struct omap_mbox *omap_mbox_get_batch(const char *, struct notifier_block *nb);
 void omap_mbox_put(struct omap_mbox *mbox, struct notifier_block *nb);
 
 int omap_mbox_register(struct device *parent, struct omap_mbox **);
@@ -10,6 +10,8 @@
 struct omap2_mcspi_platform_config {
 	unsigned short	num_cs;
 	unsigned int regs_offset;
+	/* run the message pump with realtime priority */
+	bool		rt;
 };
 
 struct omap2_mcspi_dev_attr {
@@ -28,6 +28,8 @@
 #define OMAP44XX_EMIF1_BASE		0x4c000000
 #define OMAP44XX_EMIF2_BASE		0x4d000000
 #define OMAP44XX_DMM_BASE		0x4e000000
+#define OMAP44XX_CTI0_BASE		0x54148000
+#define OMAP44XX_CTI1_BASE		0x54149000
 #define OMAP4430_32KSYNCT_BASE		0x4a304000
 #define OMAP4430_CM1_BASE		0x4a004000
 #define OMAP4430_CM_BASE		OMAP4430_CM1_BASE
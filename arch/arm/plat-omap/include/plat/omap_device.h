@@ -32,6 +32,7 @@
 #define __ARCH_ARM_PLAT_OMAP_INCLUDE_MACH_OMAP_DEVICE_H
 
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/platform_device.h>
 
 #include <plat/omap_hwmod.h>
@@ -48,6 +49,35 @@ extern struct dev_pm_domain omap_device_pm_domain;
 #define OMAP_DEVICE_SUSPENDED BIT(0)
 #define OMAP_DEVICE_NO_IDLE_ON_SUSPEND BIT(1)
 
+/* Gap histogram buckets: [0, 2), [2, 4), ... [1024, 2048), [2048, inf) ms */
+#define OMAP_DEVICE_AS_BUCKETS		12
+
+/**
+ * struct omap_device_autosuspend - adaptive autosuspend state
+ * @hist: idle gaps seen during the current learning window, per bucket
+ * @suspended_at: time of the last runtime suspend
+ * @learned_at: time the last learning window ended
+ * @wake_cost_us: average time spent in runtime suspend + resume
+ * @suspend_us: time spent in the last runtime suspend
+ * @max_delay: autosuspend delay set by the driver or user, upper bound
+ * @delay: autosuspend delay currently programmed, in ms
+ * @samples: gaps sampled in the current learning window
+ * @resumes: resumes since the last learning window
+ * @learning: a learning window is running
+ */
+struct omap_device_autosuspend {
+	u16				hist[OMAP_DEVICE_AS_BUCKETS];
+	ktime_t				suspended_at;
+	ktime_t				learned_at;
+	u32				wake_cost_us;
+	u32				suspend_us;
+	int				max_delay;
+	int				delay;
+	u16				samples;
+	u16				resumes;
+	bool				learning;
+};
+
 /**
  * struct omap_device - omap_device wrapper for platform_devices
  * @pdev: platform_device
@@ -60,6 +90,7 @@ extern struct dev_pm_domain omap_device_pm_domain;
  * @_dev_wakeup_lat_limit: dev wakeup latency limit in nsec - set by OMAP PM
  * @_state: one of OMAP_DEVICE_STATE_* (see above)
  * @flags: device flags
+ * @_autosuspend: adaptive autosuspend state
  *
  * Integrates omap_hwmod data into Linux platform_device.
  *
@@ -78,6 +109,7 @@ struct omap_device {
 	u8				hwmods_cnt;
 	u8				_state;
 	u8                              flags;
+	struct omap_device_autosuspend	_autosuspend;
 };
 
 /* Device driver interface (call via platform_data fn ptrs) */
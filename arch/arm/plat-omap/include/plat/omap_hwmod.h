@@ -155,6 +155,18 @@ struct omap_hwmod_rst_info {
 	u8		st_shift;
 };
 
+/**
+ * struct omap_hwmod_lat_stats - enable or idle transition timings
+ * @count: number of transitions
+ * @max_us: slowest transition, in microseconds
+ * @total_us: sum of all transition times, in microseconds
+ */
+struct omap_hwmod_lat_stats {
+	u32		count;
+	u32		max_us;
+	u64		total_us;
+};
+
 /**
  * struct omap_hwmod_opt_clk - optional clocks used by this hwmod
  * @role: "sys", "32k", "tv", etc -- for use in clk_get()
@@ -442,11 +454,14 @@ struct omap_hwmod_omap4_prcm {
  * _HWMOD_SYSCONFIG_LOADED: set when the OCP_SYSCONFIG value has been cached
  * _HWMOD_SKIP_ENABLE: set if hwmod enabled during init (HWMOD_INIT_NO_IDLE) -
  *     causes the first call to _enable() to only update the pinmux
+ * _HWMOD_SYSCONFIG_VALID: set while the OCP_SYSCONFIG register is known to
+ *     still hold the cached value, so identical writes can be skipped
  */
 #define _HWMOD_NO_MPU_PORT			(1 << 0)
 #define _HWMOD_WAKEUP_ENABLED			(1 << 1)
 #define _HWMOD_SYSCONFIG_LOADED			(1 << 2)
 #define _HWMOD_SKIP_ENABLE			(1 << 3)
+#define _HWMOD_SYSCONFIG_VALID			(1 << 4)
 
 /*
  * omap_hwmod._state definitions
@@ -514,6 +529,9 @@ struct omap_hwmod_class {
  * @slaves: ptr to array of OCP ifs that this hwmod can respond on
  * @dev_attr: arbitrary device attributes that can be passed to the driver
  * @_sysc_cache: internal-use hwmod flags
+ * @_enable_lat: timings of _enable() (internal use)
+ * @_idle_lat: timings of _idle() (internal use)
+ * @_setup_us: duration of _setup(), in microseconds (internal use)
  * @_mpu_rt_va: cached register target start address (internal use)
  * @_mpu_port_index: cached MPU register target slave ID (internal use)
  * @opt_clks_cnt: number of @opt_clks
@@ -556,6 +574,9 @@ struct omap_hwmod {
 	struct omap_hwmod_ocp_if	**slaves;  /* connect to *_TA */
 	void				*dev_attr;
 	u32				_sysc_cache;
+	struct omap_hwmod_lat_stats	_enable_lat;
+	struct omap_hwmod_lat_stats	_idle_lat;
+	u32				_setup_us;
 	void __iomem			*_mpu_rt_va;
 	spinlock_t			_lock;
 	struct list_head		node;
@@ -22,9 +22,12 @@
  *			with voltage.
  * @vp_errgain:		Error gain value for the voltage processor. This
  *			field also differs according to the voltage/opp.
+ * @volt_calibrated:	SmartReflex calibrated voltage to use in place of
+ *			@volt_nominal, 0 if none is known.
  */
 struct omap_volt_data {
 	u32	volt_nominal;
+	u32	volt_calibrated;
 	u32	sr_efuse_offs;
 	u32	lvt_sr_efuse_offs;
 	u8	sr_errminlimit;
@@ -49,6 +49,14 @@ static unsigned int mbox_kfifo_size = CONFIG_OMAP_MBOX_KFIFO_SIZE;
 module_param(mbox_kfifo_size, uint, S_IRUGO);
 MODULE_PARM_DESC(mbox_kfifo_size, "Size of omap's mailbox kfifo (bytes)");
 
+static bool mbox_rx_mitigation;
+module_param(mbox_rx_mitigation, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mbox_rx_mitigation,
+		"Keep RX interrupts masked until the receive queue is drained");
+
+/* maximum number of messages handed to a batch notifier at once */
+#define MBOX_RX_BATCH	16
+
 /* Runtime PM */
 static int omap_mbox_save_ctx(struct device *dev, void *data)
 {
@@ -205,28 +213,79 @@ static void mbox_tx_tasklet(unsigned long tx_data)
 	}
 }
 
+/*
+ * Move the messages of the hardware fifo to the rx queue. Returns -ENOMEM
+ * when the queue filled up before the hardware fifo was empty, in which
+ * case the interrupt source is left pending.
+ */
+static int __mbox_rx_drain(struct omap_mbox *mbox)
+{
+	struct omap_mbox_queue *mq = mbox->rxq;
+	mbox_msg_t msg;
+	int len;
+
+	while (!mbox_fifo_empty(mbox)) {
+		if (unlikely(kfifo_avail(&mq->fifo) < sizeof(msg)))
+			return -ENOMEM;
+
+		msg = mbox_fifo_read(mbox);
+
+		len = kfifo_in(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
+		WARN_ON(len != sizeof(msg));
+
+		if (mbox->ops->type == OMAP_MBOX_TYPE1)
+			break;
+	}
+
+	/* no more messages in the fifo. clear IRQ source. */
+	ack_mbox_irq(mbox, IRQ_RX);
+	return 0;
+}
+
 /*
  * Message receiver(workqueue)
+ *
+ * Messages are taken off the queue up to MBOX_RX_BATCH at a time. The batch
+ * notifiers get them all in one call, with the message count as action and
+ * the array as data; the per-message notifiers are then called for each.
  */
 static void mbox_rx_work(struct work_struct *work)
 {
 	struct omap_mbox_queue *mq =
 			container_of(work, struct omap_mbox_queue, work);
-	mbox_msg_t msg;
+	struct omap_mbox *mbox = mq->mbox;
+	mbox_msg_t msgs[MBOX_RX_BATCH];
+	unsigned int i, count;
 	int len;
 
-	while (kfifo_len(&mq->fifo) >= sizeof(msg)) {
-		len = kfifo_out(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
-		WARN_ON(len != sizeof(msg));
-
-		blocking_notifier_call_chain(&mq->mbox->notifier, len,
-								(void *)msg);
+	for (;;) {
 		spin_lock_irq(&mq->lock);
-		if (mq->full) {
+		/* the rx interrupt is masked, pick up what arrived meanwhile */
+		if (mq->full)
+			__mbox_rx_drain(mbox);
+
+		len = kfifo_out(&mq->fifo, (unsigned char *)msgs,
+								sizeof(msgs));
+
+		/*
+		 * Without mitigation the interrupt only had to wait for room
+		 * in the queue; with it, until both fifos are empty.
+		 */
+		if (mq->full && (!mbox_rx_mitigation || !len)) {
 			mq->full = false;
-			omap_mbox_enable_irq(mq->mbox, IRQ_RX);
+			omap_mbox_enable_irq(mbox, IRQ_RX);
 		}
 		spin_unlock_irq(&mq->lock);
+
+		count = len / sizeof(mbox_msg_t);
+		if (!count)
+			break;
+
+		blocking_notifier_call_chain(&mbox->batch_notifier, count,
+								msgs);
+		for (i = 0; i < count; i++)
+			blocking_notifier_call_chain(&mbox->notifier,
+					sizeof(mbox_msg_t), (void *)msgs[i]);
 	}
 }
 
@@ -243,29 +302,19 @@ static void __mbox_tx_interrupt(struct omap_mbox *mbox)
 static void __mbox_rx_interrupt(struct omap_mbox *mbox)
 {
 	struct omap_mbox_queue *mq = mbox->rxq;
-	mbox_msg_t msg;
-	int len;
-
-	while (!mbox_fifo_empty(mbox)) {
-		if (unlikely(kfifo_avail(&mq->fifo) < sizeof(msg))) {
-			omap_mbox_disable_irq(mbox, IRQ_RX);
-			mq->full = true;
-			goto nomem;
-		}
-
-		msg = mbox_fifo_read(mbox);
 
-		len = kfifo_in(&mq->fifo, (unsigned char *)&msg, sizeof(msg));
-		WARN_ON(len != sizeof(msg));
-
-		if (mbox->ops->type == OMAP_MBOX_TYPE1)
-			break;
+	spin_lock(&mq->lock);
+	/*
+	 * With mitigation the work keeps polling the hardware fifo, so no
+	 * further interrupt is needed until it has caught up.
+	 */
+	if (__mbox_rx_drain(mbox) || mbox_rx_mitigation) {
+		omap_mbox_disable_irq(mbox, IRQ_RX);
+		mq->full = true;
 	}
+	spin_unlock(&mq->lock);
 
-	/* no more messages in the fifo. clear IRQ source. */
-	ack_mbox_irq(mbox, IRQ_RX);
-nomem:
-	schedule_work(&mbox->rxq->work);
+	schedule_work(&mq->work);
 }
 
 static irqreturn_t mbox_interrupt(int irq, void *p)
@@ -394,7 +443,8 @@ static void omap_mbox_fini(struct omap_mbox *mbox)
 	mutex_unlock(&mbox_configured_lock);
 }
 
-struct omap_mbox *omap_mbox_get(const char *name, struct notifier_block *nb)
+static struct omap_mbox *__omap_mbox_get(const char *name,
+		struct notifier_block *nb, bool batch)
 {
 	struct omap_mbox *_mbox, *mbox = NULL;
 	int i, ret;
@@ -417,17 +467,35 @@ struct omap_mbox *omap_mbox_get(const char *name, struct notifier_block *nb)
 		return ERR_PTR(-ENODEV);
 
 	if (nb)
-		blocking_notifier_chain_register(&mbox->notifier, nb);
+		blocking_notifier_chain_register(batch ? &mbox->batch_notifier :
+						 &mbox->notifier, nb);
 
 	return mbox;
 }
+
+struct omap_mbox *omap_mbox_get(const char *name, struct notifier_block *nb)
+{
+	return __omap_mbox_get(name, nb, false);
+}
 EXPORT_SYMBOL(omap_mbox_get);
 
+/*
+ * Like omap_mbox_get(), but @nb is called once per batch of received
+ * messages, with the number of messages as action and a mbox_msg_t array
+ * as data.
+ */
+struct omap_mbox *omap_mbox_get_batch(const char *name,
+						struct notifier_block *nb)
+{
+	return __omap_mbox_get(name, nb, true);
+}
+EXPORT_SYMBOL(omap_mbox_get_batch);
+
 void omap_mbox_put(struct omap_mbox *mbox, struct notifier_block *nb)
 {
 	omap_mbox_fini(mbox);
-	if (nb)
-		blocking_notifier_chain_unregister(&mbox->notifier, nb);
+	if (nb && blocking_notifier_chain_unregister(&mbox->notifier, nb))
+		blocking_notifier_chain_unregister(&mbox->batch_notifier, nb);
 }
 EXPORT_SYMBOL(omap_mbox_put);
 
@@ -464,6 +532,7 @@ int omap_mbox_register(struct device *parent, struct omap_mbox **list)
 		}
 
 		BLOCKING_INIT_NOTIFIER_HEAD(&mbox->notifier);
+		BLOCKING_INIT_NOTIFIER_HEAD(&mbox->batch_notifier);
 	}
 
 	pm_runtime_enable(parent);
@@ -91,6 +91,9 @@
 #include <linux/of.h>
 #include <linux/notifier.h>
 #include <linux/pm_qos.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <plat/omap_device.h>
 #include <plat/omap_hwmod.h>
@@ -721,6 +724,7 @@ struct platform_device __init *omap_device_build_ss(const char *pdev_name, int p
 	int ret = -ENOMEM;
 	struct platform_device *pdev;
 	struct omap_device *od;
+	ktime_t start;
 
 	if (!ohs || oh_cnt == 0 || !pdev_name)
 		return ERR_PTR(-EINVAL);
@@ -728,6 +732,7 @@ struct platform_device __init *omap_device_build_ss(const char *pdev_name, int p
 	if (!pdata && pdata_len > 0)
 		return ERR_PTR(-EINVAL);
 
+	start = ktime_get();
 	pdev = platform_device_alloc(pdev_name, pdev_id);
 	if (!pdev) {
 		ret = -ENOMEM;
@@ -755,6 +760,11 @@ struct platform_device __init *omap_device_build_ss(const char *pdev_name, int p
 	if (ret)
 		goto odbs_exit2;
 
+	if (initcall_debug)
+		pr_info("omap_device: %s: built in %lld usecs\n",
+			dev_name(&pdev->dev),
+			ktime_to_us(ktime_sub(ktime_get(), start)));
+
 	return pdev;
 
 odbs_exit2:
@@ -787,15 +797,167 @@ static int __init omap_early_device_register(struct platform_device *pdev)
 }
 
 #ifdef CONFIG_PM_RUNTIME
+/*
+ * Adaptive autosuspend
+ *
+ * For devices whose driver uses autosuspend, the delay set by the driver
+ * (or written to power/autosuspend_delay_ms) is taken as an upper bound.
+ * Every so often a learning window runs the device with the shortest
+ * delay and records the idle gaps between runtime suspend and the next
+ * resume.  The delay then picked is the candidate minimising the expected
+ * cost of a gap: its wake cost (measured suspend + resume time, weighted)
+ * times the odds of the gap outlasting the delay, plus the time the
+ * device stays on for nothing while waiting for it.
+ */
+#define OMAP_DEVICE_AS_MIN_DELAY	1	/* ms, used while learning */
+#define OMAP_DEVICE_AS_LEARN		32	/* gaps per learning window */
+#define OMAP_DEVICE_AS_RELEARN		256	/* resumes between windows */
+#define OMAP_DEVICE_AS_RELEARN_MS	60000
+
+static u32 omap_device_as_wake_weight = 16;
+
+static void _od_as_set_delay(struct omap_device *od, int delay)
+{
+	struct device *dev = &od->pdev->dev;
+	unsigned long flags;
+
+	/*
+	 * Called from the runtime PM callbacks, where
+	 * pm_runtime_set_autosuspend_delay() would re-enter the runtime PM
+	 * core.  The new delay only needs to be seen by the next autosuspend.
+	 */
+	spin_lock_irqsave(&dev->power.lock, flags);
+	dev->power.autosuspend_delay = delay;
+	spin_unlock_irqrestore(&dev->power.lock, flags);
+
+	od->_autosuspend.delay = delay;
+}
+
+static void _od_as_start_learning(struct omap_device *od)
+{
+	struct omap_device_autosuspend *as = &od->_autosuspend;
+
+	memset(as->hist, 0, sizeof(as->hist));
+	as->samples = 0;
+	as->learning = true;
+	_od_as_set_delay(od, OMAP_DEVICE_AS_MIN_DELAY);
+}
+
+/* Pick the candidate delay with the lowest cost over the learnt gaps */
+static int _od_as_choose_delay(struct omap_device *od)
+{
+	struct omap_device_autosuspend *as = &od->_autosuspend;
+	u64 wake_us = (u64)as->wake_cost_us * omap_device_as_wake_weight;
+	u64 cost, best_cost = ULLONG_MAX;
+	int best = as->max_delay;
+	int i, k, delay;
+
+	for (k = 0; k <= OMAP_DEVICE_AS_BUCKETS; k++) {
+		if (k == OMAP_DEVICE_AS_BUCKETS)
+			delay = as->max_delay;
+		else
+			delay = min(OMAP_DEVICE_AS_MIN_DELAY << k,
+				    as->max_delay);
+
+		cost = 0;
+		for (i = 0; i < OMAP_DEVICE_AS_BUCKETS; i++) {
+			/* Middle of the bucket */
+			u64 gap_us = (3000ULL << i) / 2;
+
+			if (gap_us > delay * 1000ULL)
+				cost += as->hist[i] * (delay * 1000ULL +
+						       wake_us);
+			else
+				cost += as->hist[i] * gap_us;
+		}
+
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = delay;
+		}
+
+		if (delay == as->max_delay)
+			break;
+	}
+
+	return best;
+}
+
+static void _od_as_suspended(struct omap_device *od, ktime_t start)
+{
+	struct omap_device_autosuspend *as = &od->_autosuspend;
+
+	as->suspended_at = ktime_get();
+	as->suspend_us = ktime_to_us(ktime_sub(as->suspended_at, start));
+}
+
+static void _od_as_resumed(struct omap_device *od, ktime_t start)
+{
+	struct omap_device_autosuspend *as = &od->_autosuspend;
+	struct device *dev = &od->pdev->dev;
+	ktime_t now = ktime_get();
+	s64 gap_ms;
+	u32 wake_us;
+	int i;
+
+	if (!dev->power.use_autosuspend)
+		return;
+
+	wake_us = ktime_to_us(ktime_sub(now, start)) + as->suspend_us;
+	as->wake_cost_us = as->wake_cost_us ?
+		(as->wake_cost_us * 7 + wake_us) / 8 : wake_us;
+
+	/* First use, or the driver or user changed the delay behind us */
+	if (ACCESS_ONCE(dev->power.autosuspend_delay) != as->delay) {
+		as->max_delay = dev->power.autosuspend_delay;
+		as->delay = as->max_delay;
+		as->learning = false;
+		if (as->max_delay > OMAP_DEVICE_AS_MIN_DELAY)
+			_od_as_start_learning(od);
+		return;
+	}
+
+	if (as->max_delay <= OMAP_DEVICE_AS_MIN_DELAY)
+		return;
+
+	if (!as->learning) {
+		if (++as->resumes >= OMAP_DEVICE_AS_RELEARN ||
+		    ktime_to_ms(ktime_sub(now, as->learned_at)) >=
+		    OMAP_DEVICE_AS_RELEARN_MS)
+			_od_as_start_learning(od);
+		return;
+	}
+
+	/* The device went idle as->delay ms after its last use */
+	gap_ms = ktime_to_ms(ktime_sub(now, as->suspended_at)) + as->delay;
+	i = clamp_t(int, fls64(gap_ms) - 1, 0, OMAP_DEVICE_AS_BUCKETS - 1);
+	as->hist[i]++;
+
+	if (++as->samples < OMAP_DEVICE_AS_LEARN)
+		return;
+
+	as->learning = false;
+	as->resumes = 0;
+	as->learned_at = now;
+	_od_as_set_delay(od, _od_as_choose_delay(od));
+
+	dev_dbg(dev, "omap_device: autosuspend delay %d ms (max %d)\n",
+		as->delay, as->max_delay);
+}
+
 int omap_device_runtime_suspend(struct device *dev)
 {
 	struct platform_device *pdev = to_platform_device(dev);
+	ktime_t start = ktime_get();
 	int ret;
 
 	ret = pm_generic_runtime_suspend(dev);
 
-	if (!ret)
+	if (!ret) {
 		omap_device_idle(pdev);
+		if (to_omap_device(pdev))
+			_od_as_suspended(to_omap_device(pdev), start);
+	}
 
 	return ret;
 }
@@ -808,10 +970,16 @@ static int _od_runtime_idle(struct device *dev)
 int omap_device_runtime_resume(struct device *dev)
 {
 	struct platform_device *pdev = to_platform_device(dev);
+	ktime_t start = ktime_get();
+	int ret;
 
 	omap_device_enable(pdev);
 
-	return pm_generic_runtime_resume(dev);
+	ret = pm_generic_runtime_resume(dev);
+	if (!ret && to_omap_device(pdev))
+		_od_as_resumed(to_omap_device(pdev), start);
+
+	return ret;
 }
 #endif
 
@@ -1316,3 +1484,64 @@ static int __init omap_device_init(void)
 	return ret;
 }
 core_initcall(omap_device_init);
+
+#if defined(CONFIG_DEBUG_FS) && defined(CONFIG_PM_RUNTIME)
+static int _od_as_dbg_show_one(struct device *dev, void *data)
+{
+	struct seq_file *s = data;
+	struct omap_device_autosuspend *as;
+	struct omap_device *od;
+
+	if (dev->pm_domain != &omap_device_pm_domain)
+		return 0;
+
+	od = to_omap_device(to_platform_device(dev));
+	if (!od || !dev->power.use_autosuspend)
+		return 0;
+
+	as = &od->_autosuspend;
+	seq_printf(s, "%-24s %6d %6d %8u %s\n", dev_name(dev), as->max_delay,
+		   as->delay, as->wake_cost_us,
+		   as->learning ? "learning" : "");
+
+	return 0;
+}
+
+static int omap_device_as_dbg_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "%-24s %6s %6s %8s\n", "device", "max_ms", "delay",
+		   "wake_us");
+
+	return bus_for_each_dev(&platform_bus_type, NULL, s,
+				_od_as_dbg_show_one);
+}
+
+static int omap_device_as_dbg_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_device_as_dbg_show, inode->i_private);
+}
+
+static const struct file_operations omap_device_as_dbg_fops = {
+	.open		= omap_device_as_dbg_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init omap_device_dbg_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_dir("omap_device", NULL);
+	if (IS_ERR_OR_NULL(d))
+		return 0;
+
+	(void)debugfs_create_file("autosuspend", S_IRUGO, d, NULL,
+				  &omap_device_as_dbg_fops);
+	(void)debugfs_create_u32("autosuspend_wake_weight", S_IRUGO | S_IWUSR,
+				 d, &omap_device_as_wake_weight);
+
+	return 0;
+}
+late_initcall(omap_device_dbg_init);
+#endif
@@ -24,6 +24,9 @@
 #include <linux/wait.h>
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -333,6 +336,202 @@ void wait_for_device_probe(void)
 	wait_event(probe_waitqueue, atomic_read(&probe_count) == 0);
 	async_synchronize_full();
 }
+
+/*
+ * Asynchronous probing.
+ *
+ * Drivers setting async_probe have the devices that are already registered
+ * when the driver is, probed from a workqueue.  Power sequencing and
+ * firmware loading of independent devices then overlap, instead of running
+ * one after another in initcall order.  The number of concurrent probes is
+ * bounded by the async_probe= parameter.  Devices registered after their
+ * driver are still probed synchronously from device_add().
+ *
+ * The usual ordering rules still hold: a probe takes the parent's lock, so
+ * it waits for the parent's probe to finish, and a probe missing another
+ * device returns -EPROBE_DEFER to be retried once more drivers are bound.
+ * Async probes are counted in probe_count, so wait_for_device_probe()
+ * waits for them, and are flushed before their driver is detached.
+ *
+ * Probes finishing before late_initcall_sync are recorded, for a boot
+ * report of the chain of probes that determined how long probing took.
+ */
+struct async_probe {
+	struct work_struct work;
+	struct list_head node;
+	struct device *dev;
+	struct device_driver *drv;
+	ktime_t queued;		/* driver registered */
+	ktime_t started;	/* got a worker */
+	ktime_t probing;	/* got the device locks */
+	ktime_t done;
+	struct async_probe *next;	/* on the critical path */
+};
+
+static struct workqueue_struct *async_probe_wq;
+static int async_probe_max = 8;
+static DEFINE_MUTEX(async_probe_mutex);
+static LIST_HEAD(async_probe_records);
+static bool async_probe_recording = true;
+
+static int __init async_probe_setup(char *str)
+{
+	get_option(&str, &async_probe_max);
+	return 1;
+}
+__setup("async_probe=", async_probe_setup);
+
+static void async_probe_free(struct async_probe *ap)
+{
+	put_device(ap->dev);
+	kfree(ap);
+}
+
+static void driver_async_probe_work(struct work_struct *work)
+{
+	struct async_probe *ap = container_of(work, struct async_probe, work);
+	struct device *dev = ap->dev;
+	bool record;
+
+	ap->started = ktime_get();
+
+	if (dev->parent)
+		device_lock(dev->parent);
+	device_lock(dev);
+	ap->probing = ktime_get();
+	if (!dev->driver)
+		driver_probe_device(ap->drv, dev);
+	device_unlock(dev);
+	if (dev->parent)
+		device_unlock(dev->parent);
+
+	ap->done = ktime_get();
+
+	mutex_lock(&async_probe_mutex);
+	record = async_probe_recording;
+	if (record)
+		list_add_tail(&ap->node, &async_probe_records);
+	mutex_unlock(&async_probe_mutex);
+
+	if (!record)
+		async_probe_free(ap);
+
+	atomic_dec(&probe_count);
+	wake_up(&probe_waitqueue);
+}
+
+/* returns true if the probe of @dev was queued */
+static bool driver_probe_async(struct device_driver *drv, struct device *dev)
+{
+	struct async_probe *ap;
+
+	if (!drv->async_probe || !async_probe_wq)
+		return false;
+
+	ap = kzalloc(sizeof(*ap), GFP_KERNEL);
+	if (!ap)
+		return false;
+
+	INIT_WORK(&ap->work, driver_async_probe_work);
+	ap->dev = get_device(dev);
+	ap->drv = drv;
+	ap->queued = ktime_get();
+
+	atomic_inc(&probe_count);
+	queue_work(async_probe_wq, &ap->work);
+
+	return true;
+}
+
+static int __init async_probe_init(void)
+{
+	if (async_probe_max <= 0)
+		return 0;
+
+	async_probe_wq = alloc_workqueue("async_probe", WQ_UNBOUND,
+					 async_probe_max);
+	WARN_ON(!async_probe_wq);
+	return 0;
+}
+core_initcall(async_probe_init);
+
+/*
+ * The probe that @ap most likely waited for: the last one to finish while
+ * @ap was waiting for a worker or for the device locks.
+ */
+static struct async_probe *async_probe_blocker(struct list_head *records,
+					       struct async_probe *ap)
+{
+	struct async_probe *p, *blocker = NULL;
+
+	list_for_each_entry(p, records, node) {
+		s64 done = ktime_to_ns(p->done);
+
+		/* strictly earlier, so that the path ends */
+		if (done < ktime_to_ns(ap->queued) ||
+		    done > ktime_to_ns(ap->probing) ||
+		    done >= ktime_to_ns(ap->done))
+			continue;
+		if (!blocker || done > ktime_to_ns(blocker->done))
+			blocker = p;
+	}
+
+	return blocker;
+}
+
+static int __init async_probe_report(void)
+{
+	struct async_probe *ap, *tmp, *last = NULL, *path = NULL;
+	LIST_HEAD(records);
+	ktime_t first;
+	s64 probing_us = 0;
+	unsigned int n = 0;
+
+	if (async_probe_wq)
+		flush_workqueue(async_probe_wq);
+
+	mutex_lock(&async_probe_mutex);
+	async_probe_recording = false;
+	list_splice_init(&async_probe_records, &records);
+	mutex_unlock(&async_probe_mutex);
+
+	if (list_empty(&records))
+		return 0;
+
+	first = list_first_entry(&records, struct async_probe, node)->queued;
+	list_for_each_entry(ap, &records, node) {
+		if (ktime_to_ns(ap->queued) < ktime_to_ns(first))
+			first = ap->queued;
+		if (!last || ktime_to_ns(ap->done) > ktime_to_ns(last->done))
+			last = ap;
+		probing_us += ktime_us_delta(ap->done, ap->probing);
+		n++;
+	}
+
+	pr_info("async probe: %u devices in %lld us, %lld us of probing\n",
+		n, ktime_us_delta(last->done, first), probing_us);
+
+	for (ap = last; ap; ap = async_probe_blocker(&records, ap)) {
+		ap->next = path;
+		path = ap;
+	}
+
+	pr_info("async probe: critical path:\n");
+	for (ap = path; ap; ap = ap->next)
+		pr_info("  %-20s %-24s +%lld us, waited %lld us, probe %lld us\n",
+			ap->drv->name, dev_name(ap->dev),
+			ktime_us_delta(ap->queued, first),
+			ktime_us_delta(ap->probing, ap->queued),
+			ktime_us_delta(ap->done, ap->probing));
+
+	list_for_each_entry_safe(ap, tmp, &records, node) {
+		list_del(&ap->node);
+		async_probe_free(ap);
+	}
+
+	return 0;
+}
+late_initcall_sync(async_probe_report);
 EXPORT_SYMBOL_GPL(wait_for_device_probe);
 
 /**
@@ -433,6 +632,9 @@ static int __driver_attach(struct device *dev, void *data)
 	if (!driver_match_device(drv, dev))
 		return 0;
 
+	if (driver_probe_async(drv, dev))
+		return 0;
+
 	if (dev->parent)	/* Needed for USB */
 		device_lock(dev->parent);
 	device_lock(dev);
@@ -525,6 +727,10 @@ void driver_detach(struct device_driver *drv)
 	struct device_private *dev_prv;
 	struct device *dev;
 
+	/* the driver must not be probing devices it is detached from */
+	if (drv->async_probe && async_probe_wq)
+		flush_workqueue(async_probe_wq);
+
 	for (;;) {
 		spin_lock(&drv->p->klist_devices.k_lock);
 		if (list_empty(&drv->p->klist_devices.k_list)) {
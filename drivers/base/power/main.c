@@ -29,6 +29,8 @@
 #include <linux/async.h>
 #include <linux/suspend.h>
 #include <linux/timer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "../base.h"
 #include "power.h"
@@ -63,6 +65,13 @@ struct dpm_drv_wd_data {
 
 static int async_error;
 
+#define DPM_RESUME_EVENTS	(PM_EVENT_RESUME | PM_EVENT_THAW | \
+				 PM_EVENT_RESTORE | PM_EVENT_RECOVER)
+
+/* Start of the last resume, and how long until the last device was done */
+static ktime_t dpm_resume_starttime;
+static u32 dpm_resume_total_us;
+
 /**
  * device_pm_init - Initialize the PM-related part of a device object.
  * @dev: Device object being initialized.
@@ -196,6 +205,26 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 	}
 }
 
+/**
+ * dpm_account_time - Charge a suspend or resume callback to its device.
+ * @dev: Device the callback was run for.
+ * @state: PM transition of the system being carried out.
+ * @starttime: When the callback was started.
+ *
+ * The noirq, late/early and regular phases are summed, so the totals are what
+ * each device costs the whole transition.
+ */
+static void dpm_account_time(struct device *dev, pm_message_t state,
+			     ktime_t starttime)
+{
+	u32 usecs = ktime_us_delta(ktime_get(), starttime);
+
+	if (state.event & DPM_RESUME_EVENTS)
+		dev->power.resume_us += usecs;
+	else
+		dev->power.suspend_us += usecs;
+}
+
 /**
  * dpm_wait - Wait for a PM operation to complete.
  * @dev: Device to wait for.
@@ -379,7 +408,7 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, char *info)
 {
-	ktime_t calltime;
+	ktime_t calltime, starttime;
 	int error;
 
 	if (!cb)
@@ -388,7 +417,9 @@ static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 	calltime = initcall_debug_start(dev);
 
 	pm_dev_dbg(dev, state, info);
+	starttime = ktime_get();
 	error = cb(dev);
+	dpm_account_time(dev, state, starttime);
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
@@ -451,6 +482,7 @@ static void dpm_resume_noirq(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
 
+	dpm_resume_starttime = starttime;
 	mutex_lock(&dpm_list_mtx);
 	while (!list_empty(&dpm_noirq_list)) {
 		struct device *dev = to_device(dpm_noirq_list.next);
@@ -638,6 +670,8 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 
  Unlock:
 	device_unlock(dev);
+	dev->power.resume_done_us = ktime_us_delta(ktime_get(),
+						   dpm_resume_starttime);
 	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
@@ -739,6 +773,7 @@ void dpm_resume(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_resume_total_us = ktime_us_delta(ktime_get(), dpm_resume_starttime);
 	dpm_show_time(starttime, state, NULL);
 }
 
@@ -1033,11 +1068,13 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
 			  int (*cb)(struct device *dev, pm_message_t state))
 {
 	int error;
-	ktime_t calltime;
+	ktime_t calltime, starttime;
 
 	calltime = initcall_debug_start(dev);
 
+	starttime = ktime_get();
 	error = cb(dev, state);
+	dpm_account_time(dev, state, starttime);
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
@@ -1244,6 +1281,9 @@ static int device_prepare(struct device *dev, pm_message_t state)
 	device_lock(dev);
 
 	dev->power.wakeup_path = device_may_wakeup(dev);
+	dev->power.suspend_us = 0;
+	dev->power.resume_us = 0;
+	dev->power.resume_done_us = 0;
 
 	if (dev->pm_domain) {
 		info = "preparing power domain ";
@@ -1356,3 +1396,53 @@ int device_pm_wait_for_dev(struct device *subordinate, struct device *dev)
 	return async_error;
 }
 EXPORT_SYMBOL_GPL(device_pm_wait_for_dev);
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Per-device view of the last transition.  "done" is when the device finished
+ * its resume, counted from the start of the noirq phase: the device with the
+ * largest value is the end of the resume critical path.
+ */
+static int suspend_devices_show(struct seq_file *s, void *unused)
+{
+	struct device *dev;
+
+	seq_printf(s, "last resume: %u usecs, async %s\n", dpm_resume_total_us,
+		   pm_async_enabled ? "enabled" : "disabled");
+	seq_printf(s, "%-32s %5s %10s %10s %10s\n", "device", "async",
+		   "suspend", "resume", "done");
+
+	mutex_lock(&dpm_list_mtx);
+	list_for_each_entry(dev, &dpm_list, power.entry) {
+		if (!dev->power.suspend_us && !dev->power.resume_us)
+			continue;
+		seq_printf(s, "%-32s %5s %10u %10u %10u\n", dev_name(dev),
+			   dev->power.async_suspend ? "yes" : "no",
+			   dev->power.suspend_us, dev->power.resume_us,
+			   dev->power.resume_done_us);
+	}
+	mutex_unlock(&dpm_list_mtx);
+
+	return 0;
+}
+
+static int suspend_devices_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_devices_show, NULL);
+}
+
+static const struct file_operations suspend_devices_fops = {
+	.open		= suspend_devices_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init suspend_devices_debugfs_init(void)
+{
+	debugfs_create_file("suspend_devices", S_IRUGO, NULL, NULL,
+			    &suspend_devices_fops);
+	return 0;
+}
+late_initcall(suspend_devices_debugfs_init);
+#endif
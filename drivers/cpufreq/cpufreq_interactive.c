@@ -30,6 +30,8 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/input.h>
+#include <linux/irq_work.h>
+#include <linux/pm_qos.h>
 #include <asm/cputime.h>
 
 #define CREATE_TRACE_POINTS
@@ -85,25 +87,80 @@ static unsigned long min_sample_time;
 #define DEFAULT_TIMER_RATE (20 * USEC_PER_MSEC)
 static unsigned long timer_rate;
 
+/*
+ * Target load, keyed by frequency: "load freq:load freq:load ..." gives
+ * the load used from each freq upwards. The governor picks the lowest
+ * speed that keeps the load at or below the target of that speed, so
+ * lower values result in higher speeds.
+ */
+#define DEFAULT_TARGET_LOAD 90
+static unsigned int default_target_loads[] = {DEFAULT_TARGET_LOAD};
+static spinlock_t target_loads_lock;
+static unsigned int *target_loads = default_target_loads;
+static int ntarget_loads = ARRAY_SIZE(default_target_loads);
+
 /*
  * Wait this long before raising speed above hispeed, by default a single
- * timer interval.
+ * timer interval. Keyed by frequency like target_loads, so that each step
+ * above hispeed can require the load to be sustained for longer.
  */
 #define DEFAULT_ABOVE_HISPEED_DELAY DEFAULT_TIMER_RATE
-static unsigned long above_hispeed_delay_val;
+static unsigned int default_above_hispeed_delay[] = {
+	DEFAULT_ABOVE_HISPEED_DELAY };
+static spinlock_t above_hispeed_delay_lock;
+static unsigned int *above_hispeed_delay = default_above_hispeed_delay;
+static int nabove_hispeed_delay = ARRAY_SIZE(default_above_hispeed_delay);
 
 /*
- * Boost pulse to hispeed on touchscreen input.
+ * Boost pulse on touchscreen and key input, with a speed and a duration
+ * per kind of event. A zero speed means hispeed_freq, a zero duration
+ * disables the boost for that kind of event.
  */
 
 static int input_boost_val;
 
-struct cpufreq_interactive_inputopen {
-	struct input_handle *handle;
-	struct work_struct inputopen_work;
+enum {
+	INPUT_BOOST_TOUCH,	/* new contact */
+	INPUT_BOOST_MOVE,	/* contact moving */
+	INPUT_BOOST_KEY,	/* key press */
+	INPUT_BOOST_COUNT,
+};
+
+struct cpufreq_interactive_input_boost {
+	unsigned int freq;
+	unsigned int duration;	/* us */
 };
 
-static struct cpufreq_interactive_inputopen inputopen;
+static struct cpufreq_interactive_input_boost input_boosts[INPUT_BOOST_COUNT];
+
+struct cpufreq_interactive_input {
+	struct input_handle handle;
+	struct work_struct open_work;
+	unsigned long pending;	/* INPUT_BOOST_* seen since the last SYN */
+};
+
+/*
+ * Ignore boostpulse writes coming closer than this to the previous one.
+ */
+#define DEFAULT_BOOSTPULSE_MIN_INTERVAL (20 * USEC_PER_MSEC)
+static unsigned long boostpulse_min_interval;
+static u64 boostpulse_last;
+
+/*
+ * Memory throughput (KiB/s, PM_QOS_MEMORY_THROUGHPUT) requested while a
+ * boost lasts, so that the L3/DDR OPP doesn't hold back scrolling.
+ * 0 disables.
+ */
+#define DEFAULT_BOOST_MEMORY_TPUT	(200 * 4 * 1000)
+static unsigned long boost_memory_tput;
+static struct pm_qos_request mem_boost_req;
+static struct delayed_work mem_boost_work;
+static u64 mem_boost_until;	/* locked by up_cpumask_lock */
+static bool mem_boosted;
+
+/* highest input boost speed and when it ends, locked by up_cpumask_lock */
+static unsigned int input_boost_freq;
+static u64 input_boost_until;
 
 /*
  * Non-zero means longer-term speed boost active.
@@ -111,6 +168,17 @@ static struct cpufreq_interactive_inputopen inputopen;
 
 static int boost_val;
 
+/*
+ * Raise to hispeed as soon as a wakeup leaves this many tasks runnable on
+ * a CPU below hispeed, rather than waiting for the next sample. 0 disables.
+ */
+#define DEFAULT_WAKEUP_BOOST_NR 2
+static unsigned long wakeup_boost_nr;
+
+/* CPUs flagged by the scheduler hook, handled from irq_work */
+static cpumask_t wakeup_cpumask;
+static struct irq_work wakeup_boost_work;
+
 static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		unsigned int event);
 
@@ -124,6 +192,120 @@ struct cpufreq_governor cpufreq_gov_interactive = {
 	.owner = THIS_MODULE,
 };
 
+/*
+ * Expire the sampling timers of all CPUs on the same timer_rate boundary,
+ * at least half a period away, so that CPUs sharing a policy are sampled
+ * together and their new targets coalesce into a single speed change.
+ */
+static unsigned long cpufreq_interactive_expires(void)
+{
+	unsigned long rate = max(usecs_to_jiffies(timer_rate), 1UL);
+	unsigned long now = jiffies;
+	unsigned long expires = now + rate;
+
+	expires -= expires % rate;
+	if (time_before(expires, now + (rate + 1) / 2))
+		expires += rate;
+	return expires;
+}
+
+/* value of a "val freq:val ..." table for freq, locked by lock */
+static unsigned int freq_to_table_val(unsigned int *table, int ntokens,
+				      spinlock_t *lock, unsigned int freq)
+{
+	unsigned long flags;
+	unsigned int ret;
+	int i;
+
+	spin_lock_irqsave(lock, flags);
+	for (i = 0; i < ntokens - 1 && freq >= table[i + 1]; i += 2)
+		;
+	ret = table[i];
+	spin_unlock_irqrestore(lock, flags);
+	return ret;
+}
+
+static unsigned int freq_to_targetload(unsigned int freq)
+{
+	return freq_to_table_val(target_loads, ntarget_loads,
+				 &target_loads_lock, freq);
+}
+
+static unsigned int freq_to_above_hispeed_delay(unsigned int freq)
+{
+	return freq_to_table_val(above_hispeed_delay, nabove_hispeed_delay,
+				 &above_hispeed_delay_lock, freq);
+}
+
+/*
+ * Lowest table frequency at which loadadjfreq (load in percent times the
+ * current speed) stays at or below that frequency's target load. As the
+ * target depends on the frequency, iterate until the choice is stable,
+ * bracketing it between a speed known to be too low and one known to be
+ * fast enough.
+ */
+static unsigned int choose_freq(struct cpufreq_interactive_cpuinfo *pcpu,
+				unsigned int loadadjfreq)
+{
+	unsigned int freq = pcpu->policy->cur;
+	unsigned int prevfreq, freqmin, freqmax;
+	unsigned int tl;
+	unsigned int index;
+
+	freqmin = 0;
+	freqmax = UINT_MAX;
+
+	do {
+		prevfreq = freq;
+		tl = freq_to_targetload(freq);
+
+		if (cpufreq_frequency_table_target(pcpu->policy,
+						   pcpu->freq_table,
+						   loadadjfreq / tl,
+						   CPUFREQ_RELATION_L, &index))
+			break;
+		freq = pcpu->freq_table[index].frequency;
+
+		if (freq > prevfreq) {
+			/* the previous frequency is too low */
+			freqmin = prevfreq;
+
+			if (freq >= freqmax) {
+				/* take the highest speed below freqmax */
+				if (cpufreq_frequency_table_target(pcpu->policy,
+						pcpu->freq_table, freqmax - 1,
+						CPUFREQ_RELATION_H, &index))
+					break;
+				freq = pcpu->freq_table[index].frequency;
+
+				/* already found too low: freqmax it is */
+				if (freq == freqmin) {
+					freq = freqmax;
+					break;
+				}
+			}
+		} else if (freq < prevfreq) {
+			/* the previous frequency is fast enough */
+			freqmax = prevfreq;
+
+			if (freq <= freqmin) {
+				/* take the lowest speed above freqmin */
+				if (cpufreq_frequency_table_target(pcpu->policy,
+						pcpu->freq_table, freqmin + 1,
+						CPUFREQ_RELATION_L, &index))
+					break;
+				freq = pcpu->freq_table[index].frequency;
+
+				/* already found fast enough */
+				if (freq == freqmax)
+					break;
+			}
+		}
+	} while (freq != prevfreq);
+
+	return freq;
+}
+
 static void cpufreq_interactive_timer(unsigned long data)
 {
 	unsigned int delta_idle;
@@ -136,6 +318,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 		&per_cpu(cpuinfo, data);
 	u64 now_idle;
 	unsigned int new_freq;
+	unsigned int loadadjfreq;
 	unsigned int index;
 	unsigned long flags;
 
@@ -194,29 +377,41 @@ static void cpufreq_interactive_timer(unsigned long data)
 	if (load_since_change > cpu_load)
 		cpu_load = load_since_change;
 
+	loadadjfreq = (unsigned int)cpu_load * pcpu->policy->cur;
+
 	if (cpu_load >= go_hispeed_load || boost_val) {
 		if (pcpu->target_freq <= pcpu->policy->min) {
 			new_freq = hispeed_freq;
 		} else {
-			new_freq = pcpu->policy->max * cpu_load / 100;
+			new_freq = choose_freq(pcpu, loadadjfreq);
 
 			if (new_freq < hispeed_freq)
 				new_freq = hispeed_freq;
-
-			if (pcpu->target_freq == hispeed_freq &&
-			    new_freq > hispeed_freq &&
-			    pcpu->timer_run_time - pcpu->target_set_time
-			    < above_hispeed_delay_val) {
-				trace_cpufreq_interactive_notyet(data, cpu_load,
-								 pcpu->target_freq,
-								 new_freq);
-				goto rearm;
-			}
 		}
 	} else {
-		new_freq = pcpu->policy->max * cpu_load / 100;
+		new_freq = choose_freq(pcpu, loadadjfreq);
 	}
 
+	/*
+	 * Above hispeed, only go up one step at a time and only once the
+	 * load has lasted for the delay of the current speed range.
+	 */
+	if (pcpu->target_freq >= hispeed_freq &&
+	    new_freq > pcpu->target_freq &&
+	    pcpu->timer_run_time - pcpu->target_set_time <
+	    freq_to_above_hispeed_delay(pcpu->target_freq)) {
+		trace_cpufreq_interactive_notyet(data, cpu_load,
+						 pcpu->target_freq, new_freq);
+		goto rearm;
+	}
+
+	/* hold an input boost for its whole duration */
+	spin_lock_irqsave(&up_cpumask_lock, flags);
+	if (pcpu->timer_run_time < input_boost_until &&
+	    new_freq < input_boost_freq)
+		new_freq = input_boost_freq;
+	spin_unlock_irqrestore(&up_cpumask_lock, flags);
+
 	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
 					   new_freq, CPUFREQ_RELATION_H,
 					   &index)) {
@@ -294,8 +489,7 @@ rearm:
 
 		pcpu->time_in_idle = get_cpu_idle_time_us(
 			data, &pcpu->idle_exit_time);
-		mod_timer(&pcpu->cpu_timer,
-			  jiffies + usecs_to_jiffies(timer_rate));
+		mod_timer(&pcpu->cpu_timer, cpufreq_interactive_expires());
 	}
 
 exit:
@@ -329,8 +523,7 @@ static void cpufreq_interactive_idle_start(void)
 			pcpu->time_in_idle = get_cpu_idle_time_us(
 				smp_processor_id(), &pcpu->idle_exit_time);
 			pcpu->timer_idlecancel = 0;
-			mod_timer(&pcpu->cpu_timer,
-				  jiffies + usecs_to_jiffies(timer_rate));
+			mod_timer(&pcpu->cpu_timer, cpufreq_interactive_expires());
 		}
 #endif
 	} else {
@@ -380,18 +573,63 @@ static void cpufreq_interactive_idle_end(void)
 			get_cpu_idle_time_us(smp_processor_id(),
 					     &pcpu->idle_exit_time);
 		pcpu->timer_idlecancel = 0;
-		mod_timer(&pcpu->cpu_timer,
-			  jiffies + usecs_to_jiffies(timer_rate));
+		mod_timer(&pcpu->cpu_timer, cpufreq_interactive_expires());
 	}
 
 }
 
-static int cpufreq_interactive_up_task(void *data)
+/*
+ * Set each policy with a CPU in mask to the highest target of its CPUs.
+ * All the CPUs of a policy are settled by a single transition, however
+ * many of them asked for one.
+ */
+static void cpufreq_interactive_speedchange(cpumask_t *mask, bool up)
 {
 	unsigned int cpu;
+	struct cpufreq_interactive_cpuinfo *pcpu;
+
+	while ((cpu = cpumask_first(mask)) < nr_cpu_ids) {
+		unsigned int j;
+		unsigned int max_freq = 0;
+
+		cpumask_clear_cpu(cpu, mask);
+		pcpu = &per_cpu(cpuinfo, cpu);
+		smp_rmb();
+
+		if (!pcpu->governor_enabled)
+			continue;
+
+		/* the other CPUs of this policy are handled right here */
+		cpumask_andnot(mask, mask, pcpu->policy->cpus);
+
+		mutex_lock(&set_speed_lock);
+
+		for_each_cpu(j, pcpu->policy->cpus) {
+			struct cpufreq_interactive_cpuinfo *pjcpu =
+				&per_cpu(cpuinfo, j);
+
+			if (pjcpu->target_freq > max_freq)
+				max_freq = pjcpu->target_freq;
+		}
+
+		if (max_freq != pcpu->policy->cur)
+			__cpufreq_driver_target(pcpu->policy, max_freq,
+						CPUFREQ_RELATION_H);
+		mutex_unlock(&set_speed_lock);
+
+		if (up)
+			trace_cpufreq_interactive_up(cpu, pcpu->target_freq,
+						     pcpu->policy->cur);
+		else
+			trace_cpufreq_interactive_down(cpu, pcpu->target_freq,
+						       pcpu->policy->cur);
+	}
+}
+
+static int cpufreq_interactive_up_task(void *data)
+{
 	cpumask_t tmp_mask;
 	unsigned long flags;
-	struct cpufreq_interactive_cpuinfo *pcpu;
 
 	while (1) {
 		set_current_state(TASK_INTERRUPTIBLE);
@@ -412,34 +650,7 @@ static int cpufreq_interactive_up_task(void *data)
 		cpumask_clear(&up_cpumask);
 		spin_unlock_irqrestore(&up_cpumask_lock, flags);
 
-		for_each_cpu(cpu, &tmp_mask) {
-			unsigned int j;
-			unsigned int max_freq = 0;
-
-			pcpu = &per_cpu(cpuinfo, cpu);
-			smp_rmb();
-
-			if (!pcpu->governor_enabled)
-				continue;
-
-			mutex_lock(&set_speed_lock);
-
-			for_each_cpu(j, pcpu->policy->cpus) {
-				struct cpufreq_interactive_cpuinfo *pjcpu =
-					&per_cpu(cpuinfo, j);
-
-				if (pjcpu->target_freq > max_freq)
-					max_freq = pjcpu->target_freq;
-			}
-
-			if (max_freq != pcpu->policy->cur)
-				__cpufreq_driver_target(pcpu->policy,
-							max_freq,
-							CPUFREQ_RELATION_H);
-			mutex_unlock(&set_speed_lock);
-			trace_cpufreq_interactive_up(cpu, pcpu->target_freq,
-						     pcpu->policy->cur);
-		}
+		cpufreq_interactive_speedchange(&tmp_mask, true);
 	}
 
 	return 0;
@@ -447,60 +658,61 @@ static int cpufreq_interactive_up_task(void *data)
 
 static void cpufreq_interactive_freq_down(struct work_struct *work)
 {
-	unsigned int cpu;
 	cpumask_t tmp_mask;
 	unsigned long flags;
-	struct cpufreq_interactive_cpuinfo *pcpu;
 
 	spin_lock_irqsave(&down_cpumask_lock, flags);
 	tmp_mask = down_cpumask;
 	cpumask_clear(&down_cpumask);
 	spin_unlock_irqrestore(&down_cpumask_lock, flags);
 
-	for_each_cpu(cpu, &tmp_mask) {
-		unsigned int j;
-		unsigned int max_freq = 0;
-
-		pcpu = &per_cpu(cpuinfo, cpu);
-		smp_rmb();
-
-		if (!pcpu->governor_enabled)
-			continue;
-
-		mutex_lock(&set_speed_lock);
-
-		for_each_cpu(j, pcpu->policy->cpus) {
-			struct cpufreq_interactive_cpuinfo *pjcpu =
-				&per_cpu(cpuinfo, j);
+	cpufreq_interactive_speedchange(&tmp_mask, false);
+}
 
-			if (pjcpu->target_freq > max_freq)
-				max_freq = pjcpu->target_freq;
-		}
+static void cpufreq_interactive_mem_boost(struct work_struct *work)
+{
+	unsigned long flags;
+	u64 now, until;
 
-		if (max_freq != pcpu->policy->cur)
-			__cpufreq_driver_target(pcpu->policy, max_freq,
-						CPUFREQ_RELATION_H);
+	spin_lock_irqsave(&up_cpumask_lock, flags);
+	until = mem_boost_until;
+	spin_unlock_irqrestore(&up_cpumask_lock, flags);
 
-		mutex_unlock(&set_speed_lock);
-		trace_cpufreq_interactive_down(cpu, pcpu->target_freq,
-					       pcpu->policy->cur);
+	now = ktime_to_us(ktime_get());
+	if (now < until && boost_memory_tput) {
+		/* a no-op while the value is unchanged */
+		pm_qos_update_request(&mem_boost_req, boost_memory_tput);
+		mem_boosted = true;
+		queue_delayed_work(down_wq, &mem_boost_work,
+				   usecs_to_jiffies(until - now) + 1);
+	} else if (mem_boosted) {
+		pm_qos_update_request(&mem_boost_req,
+				      PM_QOS_MEMORY_THROUGHPUT_DEFAULT_VALUE);
+		mem_boosted = false;
 	}
 }
 
-static void cpufreq_interactive_boost(void)
+/*
+ * Raise all CPUs to at least freq and keep them there for duration us,
+ * then let the usual min_sample_time algorithm decide when to drop.
+ */
+static void cpufreq_interactive_boost_to(unsigned int freq,
+					 unsigned int duration)
 {
 	int i;
 	int anyboost = 0;
 	unsigned long flags;
 	struct cpufreq_interactive_cpuinfo *pcpu;
+	u64 now = ktime_to_us(ktime_get());
+	bool mem_boost = false;
 
 	spin_lock_irqsave(&up_cpumask_lock, flags);
 
 	for_each_online_cpu(i) {
 		pcpu = &per_cpu(cpuinfo, i);
 
-		if (pcpu->target_freq < hispeed_freq) {
-			pcpu->target_freq = hispeed_freq;
+		if (pcpu->target_freq < freq) {
+			pcpu->target_freq = freq;
 			cpumask_set_cpu(i, &up_cpumask);
 			pcpu->target_set_time_in_idle =
 				get_cpu_idle_time_us(i, &pcpu->target_set_time);
@@ -512,56 +724,170 @@ static void cpufreq_interactive_boost(void)
 		 * validated.
 		 */
 
-		pcpu->floor_freq = hispeed_freq;
-		pcpu->floor_validate_time = ktime_to_us(ktime_get());
+		pcpu->floor_freq = freq;
+		pcpu->floor_validate_time = now;
+	}
+
+	if (duration) {
+		if (now >= input_boost_until || freq > input_boost_freq)
+			input_boost_freq = freq;
+		if (now + duration > input_boost_until)
+			input_boost_until = now + duration;
+	}
+
+	if (now + max(duration, (unsigned int)min_sample_time) >
+	    mem_boost_until) {
+		mem_boost_until = now + max(duration,
+					    (unsigned int)min_sample_time);
+		mem_boost = true;
 	}
 
 	spin_unlock_irqrestore(&up_cpumask_lock, flags);
 
 	if (anyboost)
 		wake_up_process(up_task);
+
+	/* a pending release picks the new end time up by itself */
+	if (mem_boost && boost_memory_tput && !mem_boosted)
+		queue_delayed_work(down_wq, &mem_boost_work, 0);
+}
+
+static void cpufreq_interactive_boost(void)
+{
+	cpufreq_interactive_boost_to(hispeed_freq, 0);
 }
 
 /*
- * Pulsed boost on input event raises CPUs to hispeed_freq and lets
- * usual algorithm of min_sample_time  decide when to allow speed
- * to drop.
+ * Runs with the waking CPU's runqueue locked: only flag the CPU here, the
+ * up task is woken from irq_work once the scheduler has let go.
+ */
+static void cpufreq_interactive_sched_wakeup(int cpu, unsigned int nr_running)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+
+	if (!wakeup_boost_nr || nr_running < wakeup_boost_nr)
+		return;
+
+	if (!pcpu->governor_enabled || pcpu->target_freq >= hispeed_freq)
+		return;
+
+	if (!cpumask_test_and_set_cpu(cpu, &wakeup_cpumask))
+		irq_work_queue(&wakeup_boost_work);
+}
+
+static void cpufreq_interactive_wakeup_boost(struct irq_work *work)
+{
+	int i;
+	int anyboost = 0;
+	unsigned long flags;
+	struct cpufreq_interactive_cpuinfo *pcpu;
+
+	spin_lock_irqsave(&up_cpumask_lock, flags);
+
+	for_each_online_cpu(i) {
+		if (!cpumask_test_and_clear_cpu(i, &wakeup_cpumask))
+			continue;
+
+		pcpu = &per_cpu(cpuinfo, i);
+		smp_rmb();
+
+		if (!pcpu->governor_enabled || pcpu->target_freq >= hispeed_freq)
+			continue;
+
+		pcpu->target_freq = hispeed_freq;
+		cpumask_set_cpu(i, &up_cpumask);
+		pcpu->target_set_time_in_idle =
+			get_cpu_idle_time_us(i, &pcpu->target_set_time);
+		pcpu->floor_freq = hispeed_freq;
+		pcpu->floor_validate_time = pcpu->target_set_time;
+		anyboost = 1;
+	}
+
+	spin_unlock_irqrestore(&up_cpumask_lock, flags);
+
+	if (anyboost) {
+		trace_cpufreq_interactive_boost("wakeup");
+		wake_up_process(up_task);
+	}
+}
+
+/*
+ * Pulsed boost on input event raises CPUs to the speed set for that kind
+ * of event for its duration, then lets usual algorithm of min_sample_time
+ * decide when to allow speed to drop.
  */
 
 static void cpufreq_interactive_input_event(struct input_handle *handle,
 					    unsigned int type,
 					    unsigned int code, int value)
 {
-	if (input_boost_val && type == EV_SYN && code == SYN_REPORT) {
-		trace_cpufreq_interactive_boost("input");
-		cpufreq_interactive_boost();
+	struct cpufreq_interactive_input *ih =
+		container_of(handle, struct cpufreq_interactive_input, handle);
+	struct cpufreq_interactive_input_boost *ib;
+	int i;
+
+	if (!input_boost_val)
+		return;
+
+	switch (type) {
+	case EV_KEY:
+		if (value != 1)
+			break;
+		if (code == BTN_TOUCH)
+			__set_bit(INPUT_BOOST_TOUCH, &ih->pending);
+		else
+			__set_bit(INPUT_BOOST_KEY, &ih->pending);
+		break;
+	case EV_ABS:
+		if (code == ABS_MT_TRACKING_ID && value >= 0)
+			__set_bit(INPUT_BOOST_TOUCH, &ih->pending);
+		else
+			__set_bit(INPUT_BOOST_MOVE, &ih->pending);
+		break;
+	case EV_SYN:
+		if (code != SYN_REPORT || !ih->pending)
+			break;
+
+		for (i = 0; i < INPUT_BOOST_COUNT; i++) {
+			ib = &input_boosts[i];
+			if (!test_bit(i, &ih->pending) || !ib->duration)
+				continue;
+
+			trace_cpufreq_interactive_boost("input");
+			cpufreq_interactive_boost_to(ib->freq ? ib->freq :
+						     hispeed_freq,
+						     ib->duration);
+		}
+		ih->pending = 0;
+		break;
 	}
 }
 
 static void cpufreq_interactive_input_open(struct work_struct *w)
 {
-	struct cpufreq_interactive_inputopen *io =
-		container_of(w, struct cpufreq_interactive_inputopen,
-			     inputopen_work);
+	struct cpufreq_interactive_input *ih =
+		container_of(w, struct cpufreq_interactive_input, open_work);
 	int error;
 
-	error = input_open_device(io->handle);
+	error = input_open_device(&ih->handle);
 	if (error)
-		input_unregister_handle(io->handle);
+		input_unregister_handle(&ih->handle);
 }
 
 static int cpufreq_interactive_input_connect(struct input_handler *handler,
 					     struct input_dev *dev,
 					     const struct input_device_id *id)
 {
+	struct cpufreq_interactive_input *ih;
 	struct input_handle *handle;
 	int error;
 
 	pr_info("%s: connect to %s\n", __func__, dev->name);
-	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
-	if (!handle)
+	ih = kzalloc(sizeof(*ih), GFP_KERNEL);
+	if (!ih)
 		return -ENOMEM;
 
+	handle = &ih->handle;
 	handle->dev = dev;
 	handle->handler = handler;
 	handle->name = "cpufreq_interactive";
@@ -570,19 +896,24 @@ static int cpufreq_interactive_input_connect(struct input_handler *handler,
 	if (error)
 		goto err;
 
-	inputopen.handle = handle;
-	queue_work(down_wq, &inputopen.inputopen_work);
+	/* each device gets its own work, several may connect at once */
+	INIT_WORK(&ih->open_work, cpufreq_interactive_input_open);
+	queue_work(down_wq, &ih->open_work);
 	return 0;
 err:
-	kfree(handle);
+	kfree(ih);
 	return error;
 }
 
 static void cpufreq_interactive_input_disconnect(struct input_handle *handle)
 {
+	struct cpufreq_interactive_input *ih =
+		container_of(handle, struct cpufreq_interactive_input, handle);
+
+	cancel_work_sync(&ih->open_work);
 	input_close_device(handle);
 	input_unregister_handle(handle);
-	kfree(handle);
+	kfree(ih);
 }
 
 static const struct input_device_id cpufreq_interactive_ids[] = {
@@ -601,6 +932,10 @@ static const struct input_device_id cpufreq_interactive_ids[] = {
 		.absbit = { [BIT_WORD(ABS_X)] =
 			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
 	}, /* touchpad */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	}, /* keys */
 	{ },
 };
 
@@ -680,10 +1015,134 @@ static ssize_t store_min_sample_time(struct kobject *kobj,
 static struct global_attr min_sample_time_attr = __ATTR(min_sample_time, 0644,
 		show_min_sample_time, store_min_sample_time);
 
+/*
+ * Parse "val freq:val freq:val", an odd number of tokens with the
+ * frequencies in increasing order.
+ */
+static unsigned int *get_tokenized_data(const char *buf, int *num_tokens)
+{
+	const char *cp;
+	int i;
+	int ntokens = 1;
+	unsigned int *tokenized_data;
+	int err = -EINVAL;
+
+	cp = buf;
+	while ((cp = strpbrk(cp + 1, " :")))
+		ntokens++;
+
+	if (!(ntokens & 0x1))
+		goto err;
+
+	tokenized_data = kmalloc(ntokens * sizeof(unsigned int), GFP_KERNEL);
+	if (!tokenized_data) {
+		err = -ENOMEM;
+		goto err;
+	}
+
+	cp = buf;
+	i = 0;
+	while (i < ntokens) {
+		if (sscanf(cp, "%u", &tokenized_data[i++]) != 1)
+			goto err_kfree;
+
+		cp = strpbrk(cp, " :");
+		if (!cp)
+			break;
+		cp++;
+	}
+
+	if (i != ntokens)
+		goto err_kfree;
+
+	for (i = 3; i < ntokens; i += 2) {
+		if (tokenized_data[i] <= tokenized_data[i - 2])
+			goto err_kfree;
+	}
+
+	*num_tokens = ntokens;
+	return tokenized_data;
+
+err_kfree:
+	kfree(tokenized_data);
+err:
+	return ERR_PTR(err);
+}
+
+static ssize_t show_table(char *buf, unsigned int *table, int ntokens,
+			  spinlock_t *lock)
+{
+	unsigned long flags;
+	ssize_t ret = 0;
+	int i;
+
+	spin_lock_irqsave(lock, flags);
+	for (i = 0; i < ntokens; i++)
+		ret += sprintf(buf + ret, "%u%s", table[i],
+			       i & 0x1 ? ":" : " ");
+	spin_unlock_irqrestore(lock, flags);
+
+	/* replace the trailing separator */
+	sprintf(buf + ret - 1, "\n");
+	return ret;
+}
+
+static ssize_t store_table(const char *buf, unsigned int **table,
+			   int *ntokens, unsigned int *default_table,
+			   unsigned int min_val, spinlock_t *lock)
+{
+	unsigned int *new_table, *old_table;
+	unsigned long flags;
+	int i, n;
+
+	new_table = get_tokenized_data(buf, &n);
+	if (IS_ERR(new_table))
+		return PTR_ERR(new_table);
+
+	for (i = 0; i < n; i += 2) {
+		if (new_table[i] < min_val) {
+			kfree(new_table);
+			return -EINVAL;
+		}
+	}
+
+	spin_lock_irqsave(lock, flags);
+	old_table = *table;
+	*table = new_table;
+	*ntokens = n;
+	spin_unlock_irqrestore(lock, flags);
+
+	if (old_table != default_table)
+		kfree(old_table);
+	return 0;
+}
+
+static ssize_t show_target_loads(struct kobject *kobj,
+				 struct attribute *attr, char *buf)
+{
+	return show_table(buf, target_loads, ntarget_loads,
+			  &target_loads_lock);
+}
+
+static ssize_t store_target_loads(struct kobject *kobj,
+				  struct attribute *attr,
+				  const char *buf, size_t count)
+{
+	int ret;
+
+	ret = store_table(buf, &target_loads, &ntarget_loads,
+			  default_target_loads, 1, &target_loads_lock);
+	return ret ? ret : count;
+}
+
+static struct global_attr target_loads_attr =
+	__ATTR(target_loads, 0644, show_target_loads, store_target_loads);
+
 static ssize_t show_above_hispeed_delay(struct kobject *kobj,
 					struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", above_hispeed_delay_val);
+	return show_table(buf, above_hispeed_delay, nabove_hispeed_delay,
+			  &above_hispeed_delay_lock);
 }
 
 static ssize_t store_above_hispeed_delay(struct kobject *kobj,
@@ -691,16 +1150,16 @@ static ssize_t store_above_hispeed_delay(struct kobject *kobj,
 					 const char *buf, size_t count)
 {
 	int ret;
-	unsigned long val;
 
-	ret = strict_strtoul(buf, 0, &val);
-	if (ret < 0)
-		return ret;
-	above_hispeed_delay_val = val;
-	return count;
+	ret = store_table(buf, &above_hispeed_delay, &nabove_hispeed_delay,
+			  default_above_hispeed_delay, 0,
+			  &above_hispeed_delay_lock);
+	return ret ? ret : count;
 }
 
-define_one_global_rw(above_hispeed_delay);
+static struct global_attr above_hispeed_delay_attr =
+	__ATTR(above_hispeed_delay, 0644, show_above_hispeed_delay,
+	       store_above_hispeed_delay);
 
 static ssize_t show_timer_rate(struct kobject *kobj,
 			struct attribute *attr, char *buf)
@@ -781,10 +1240,18 @@ static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
 	int ret;
 	unsigned long val;
 
+	u64 now;
+
 	ret = kstrtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
 
+	now = ktime_to_us(ktime_get());
+	if (boostpulse_last &&
+	    now - boostpulse_last < boostpulse_min_interval)
+		return count;
+	boostpulse_last = now;
+
 	trace_cpufreq_interactive_boost("pulse");
 	cpufreq_interactive_boost();
 	return count;
@@ -793,15 +1260,127 @@ static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
 static struct global_attr boostpulse =
 	__ATTR(boostpulse, 0200, NULL, store_boostpulse);
 
+#define input_boost_attr(_name, _type, _field)				\
+static ssize_t show_##_name(struct kobject *kobj,			\
+			    struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%u\n", input_boosts[_type]._field);	\
+}									\
+									\
+static ssize_t store_##_name(struct kobject *kobj,			\
+			     struct attribute *attr, const char *buf,	\
+			     size_t count)				\
+{									\
+	int ret;							\
+	unsigned long val;						\
+									\
+	ret = kstrtoul(buf, 0, &val);					\
+	if (ret < 0)							\
+		return ret;						\
+	input_boosts[_type]._field = val;				\
+	return count;							\
+}									\
+									\
+static struct global_attr _name##_attr = __ATTR(_name, 0644,		\
+		show_##_name, store_##_name)
+
+input_boost_attr(touch_boost_freq, INPUT_BOOST_TOUCH, freq);
+input_boost_attr(touch_boost_duration, INPUT_BOOST_TOUCH, duration);
+input_boost_attr(move_boost_freq, INPUT_BOOST_MOVE, freq);
+input_boost_attr(move_boost_duration, INPUT_BOOST_MOVE, duration);
+input_boost_attr(key_boost_freq, INPUT_BOOST_KEY, freq);
+input_boost_attr(key_boost_duration, INPUT_BOOST_KEY, duration);
+
+static ssize_t show_boostpulse_min_interval(struct kobject *kobj,
+					    struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", boostpulse_min_interval);
+}
+
+static ssize_t store_boostpulse_min_interval(struct kobject *kobj,
+					     struct attribute *attr,
+					     const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	boostpulse_min_interval = val;
+	return count;
+}
+
+static struct global_attr boostpulse_min_interval_attr =
+	__ATTR(boostpulse_min_interval, 0644, show_boostpulse_min_interval,
+	       store_boostpulse_min_interval);
+
+static ssize_t show_boost_memory_tput(struct kobject *kobj,
+				      struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", boost_memory_tput);
+}
+
+static ssize_t store_boost_memory_tput(struct kobject *kobj,
+				       struct attribute *attr,
+				       const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	boost_memory_tput = val;
+	return count;
+}
+
+static struct global_attr boost_memory_tput_attr =
+	__ATTR(boost_memory_tput, 0644, show_boost_memory_tput,
+	       store_boost_memory_tput);
+
+static ssize_t show_wakeup_boost_nr(struct kobject *kobj,
+				    struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", wakeup_boost_nr);
+}
+
+static ssize_t store_wakeup_boost_nr(struct kobject *kobj,
+				     struct attribute *attr, const char *buf,
+				     size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	wakeup_boost_nr = val;
+	return count;
+}
+
+static struct global_attr wakeup_boost_nr_attr = __ATTR(wakeup_boost_nr,
+		0644, show_wakeup_boost_nr, store_wakeup_boost_nr);
+
 static struct attribute *interactive_attributes[] = {
 	&hispeed_freq_attr.attr,
 	&go_hispeed_load_attr.attr,
-	&above_hispeed_delay.attr,
+	&target_loads_attr.attr,
+	&above_hispeed_delay_attr.attr,
 	&min_sample_time_attr.attr,
 	&timer_rate_attr.attr,
 	&input_boost.attr,
 	&boost.attr,
 	&boostpulse.attr,
+	&touch_boost_freq_attr.attr,
+	&touch_boost_duration_attr.attr,
+	&move_boost_freq_attr.attr,
+	&move_boost_duration_attr.attr,
+	&key_boost_freq_attr.attr,
+	&key_boost_duration_attr.attr,
+	&boostpulse_min_interval_attr.attr,
+	&boost_memory_tput_attr.attr,
+	&wakeup_boost_nr_attr.attr,
 	NULL,
 };
 
@@ -861,6 +1440,10 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			pr_warn("%s: failed to register input handler\n",
 				__func__);
 
+		pm_qos_add_request(&mem_boost_req, PM_QOS_MEMORY_THROUGHPUT,
+				   PM_QOS_MEMORY_THROUGHPUT_DEFAULT_VALUE);
+		sched_set_wakeup_hook(cpufreq_interactive_sched_wakeup);
+
 		break;
 
 	case CPUFREQ_GOV_STOP:
@@ -883,7 +1466,14 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		if (atomic_dec_return(&active_count) > 0)
 			return 0;
 
+		sched_set_wakeup_hook(NULL);
+		irq_work_sync(&wakeup_boost_work);
+
 		input_unregister_handler(&cpufreq_interactive_input_handler);
+		cancel_delayed_work_sync(&mem_boost_work);
+		pm_qos_remove_request(&mem_boost_req);
+		mem_boosted = false;
+
 		sysfs_remove_group(cpufreq_global_kobject,
 				&interactive_attr_group);
 
@@ -929,8 +1519,13 @@ static int __init cpufreq_interactive_init(void)
 
 	go_hispeed_load = DEFAULT_GO_HISPEED_LOAD;
 	min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
-	above_hispeed_delay_val = DEFAULT_ABOVE_HISPEED_DELAY;
 	timer_rate = DEFAULT_TIMER_RATE;
+	wakeup_boost_nr = DEFAULT_WAKEUP_BOOST_NR;
+	boostpulse_min_interval = DEFAULT_BOOSTPULSE_MIN_INTERVAL;
+	boost_memory_tput = DEFAULT_BOOST_MEMORY_TPUT;
+
+	for (i = 0; i < INPUT_BOOST_COUNT; i++)
+		input_boosts[i].duration = DEFAULT_MIN_SAMPLE_TIME;
 
 	/* Initalize per-cpu timers */
 	for_each_possible_cpu(i) {
@@ -960,10 +1555,13 @@ static int __init cpufreq_interactive_init(void)
 
 	spin_lock_init(&up_cpumask_lock);
 	spin_lock_init(&down_cpumask_lock);
+	spin_lock_init(&target_loads_lock);
+	spin_lock_init(&above_hispeed_delay_lock);
 	mutex_init(&set_speed_lock);
 
 	idle_notifier_register(&cpufreq_interactive_idle_nb);
-	INIT_WORK(&inputopen.inputopen_work, cpufreq_interactive_input_open);
+	INIT_DELAYED_WORK(&mem_boost_work, cpufreq_interactive_mem_boost);
+	init_irq_work(&wakeup_boost_work, cpufreq_interactive_wakeup_boost);
 	return cpufreq_register_governor(&cpufreq_gov_interactive);
 
 err_freeuptask:
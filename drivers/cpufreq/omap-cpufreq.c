@@ -26,6 +26,9 @@
 #include <linux/cpu.h>
 #include <linux/module.h>
 #include <linux/thermal_framework.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/smp_plat.h>
 #include <asm/cpu.h>
@@ -61,12 +64,42 @@ static DEFINE_MUTEX(omap_cpufreq_lock);
 static unsigned int max_thermal;
 static unsigned int max_freq;
 static unsigned int current_target_freq;
-static unsigned int current_cooling_level;
 static unsigned int cpu_cooling_level;
 static unsigned int case_cooling_level;
-static unsigned int new_cooling_level;
 static bool omap_cpufreq_ready;
 
+/*
+ * Transition latency accounting. Bucket 0 counts transitions under
+ * OMAP_CPUFREQ_LAT_BASE_US, bucket n those under BASE << n, and the last
+ * one everything slower.
+ */
+#define OMAP_CPUFREQ_LAT_BASE_US	25
+#define OMAP_CPUFREQ_LAT_BUCKETS	10
+
+enum {
+	OMAP_CPUFREQ_LAT_PRECHANGE,
+	OMAP_CPUFREQ_LAT_VOLT,
+	OMAP_CPUFREQ_LAT_CLK,
+	OMAP_CPUFREQ_LAT_POSTCHANGE,
+	OMAP_CPUFREQ_LAT_TOTAL,
+	OMAP_CPUFREQ_LAT_COUNT,
+};
+
+static const char * const omap_cpufreq_lat_names[] = {
+	"prechange", "voltage", "dpll", "postchange", "total",
+};
+
+struct omap_cpufreq_lat {
+	u32 hist[OMAP_CPUFREQ_LAT_BUCKETS];
+	u32 last_us;
+	u32 max_us;
+	u64 total_us;
+};
+
+/* locked by omap_cpufreq_lock */
+static struct omap_cpufreq_lat omap_cpufreq_lat[OMAP_CPUFREQ_LAT_COUNT];
+static u32 omap_cpufreq_transitions;
+
 static unsigned int en_therm_freq_print;
 module_param(en_therm_freq_print, uint, 0644);
 MODULE_PARM_DESC(en_therm_freq_print,
@@ -83,6 +116,23 @@ static unsigned int omap_getspeed(unsigned int cpu)
 	return rate;
 }
 
+static void omap_cpufreq_lat_add(int phase, u32 us)
+{
+	struct omap_cpufreq_lat *lat = &omap_cpufreq_lat[phase];
+	int bucket = fls(us / OMAP_CPUFREQ_LAT_BASE_US);
+
+	lat->hist[min(bucket, OMAP_CPUFREQ_LAT_BUCKETS - 1)]++;
+	lat->last_us = us;
+	lat->total_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+}
+
+static inline u32 omap_cpufreq_us_since(ktime_t start)
+{
+	return ktime_to_us(ktime_sub(ktime_get(), start));
+}
+
 static int omap_cpufreq_scale(struct cpufreq_policy *policy,
 				unsigned int target_freq, unsigned int cur_freq,
 				unsigned int relation)
@@ -90,6 +140,8 @@ static int omap_cpufreq_scale(struct cpufreq_policy *policy,
 	unsigned int i;
 	int ret = 0;
 	struct cpufreq_freqs freqs;
+	ktime_t start, phase;
+	u32 scale_us, volt_us, clk_us;
 
 	if (!freq_table) {
 		dev_err(mpu_dev, "%s: cpu%d: no freq table!\n", __func__,
@@ -124,17 +176,37 @@ static int omap_cpufreq_scale(struct cpufreq_policy *policy,
 	if (freqs.old == freqs.new && cur_freq == freqs.new)
 		return ret;
 
+	start = ktime_get();
+
 	/* notifiers */
 	for_each_cpu(i, policy->cpus) {
 		freqs.cpu = i;
 		cpufreq_notify_transition(&freqs, CPUFREQ_PRECHANGE);
 	}
 
+	omap_cpufreq_lat_add(OMAP_CPUFREQ_LAT_PRECHANGE,
+			     omap_cpufreq_us_since(start));
+
 #ifdef CONFIG_CPU_FREQ_DEBUG
 	pr_info("cpufreq-omap: transition: %u --> %u\n", freqs.old, freqs.new);
 #endif
 
+	phase = ktime_get();
 	ret = omap_device_scale(mpu_dev, freqs.new * 1000);
+	scale_us = omap_cpufreq_us_since(phase);
+
+	if (!ret && !omap_dvfs_get_scale_time(mpu_dev, &volt_us, &clk_us)) {
+		omap_cpufreq_lat_add(OMAP_CPUFREQ_LAT_VOLT, volt_us);
+		omap_cpufreq_lat_add(OMAP_CPUFREQ_LAT_CLK, clk_us);
+	}
+
+	/*
+	 * Report the slowest voltage and DPLL change seen so far rather
+	 * than a guess, governors use it to size their sampling period.
+	 */
+	if (!ret && scale_us * NSEC_PER_USEC >
+			policy->cpuinfo.transition_latency)
+		policy->cpuinfo.transition_latency = scale_us * NSEC_PER_USEC;
 
 	freqs.new = omap_getspeed(policy->cpu);
 
@@ -165,11 +237,18 @@ static int omap_cpufreq_scale(struct cpufreq_policy *policy,
 #endif
 
 	/* notifiers */
+	phase = ktime_get();
 	for_each_cpu(i, policy->cpus) {
 		freqs.cpu = i;
 		cpufreq_notify_transition(&freqs, CPUFREQ_POSTCHANGE);
 	}
 
+	omap_cpufreq_lat_add(OMAP_CPUFREQ_LAT_POSTCHANGE,
+			     omap_cpufreq_us_since(phase));
+	omap_cpufreq_lat_add(OMAP_CPUFREQ_LAT_TOTAL,
+			     omap_cpufreq_us_since(start));
+	omap_cpufreq_transitions++;
+
 	return ret;
 }
 
@@ -215,14 +294,11 @@ static inline void freq_table_free(void)
 }
 
 #ifdef CONFIG_THERMAL_FRAMEWORK
-static unsigned int omap_thermal_lower_speed(void)
+static unsigned int omap_thermal_lower_speed(unsigned int curr)
 {
 	unsigned int max = 0;
-	unsigned int curr;
 	int i;
 
-	curr = max_thermal;
-
 	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++)
 		if (freq_table[i].frequency > max &&
 				freq_table[i].frequency < curr)
@@ -234,37 +310,63 @@ static unsigned int omap_thermal_lower_speed(void)
 	return max;
 }
 
-/* This function needs to be called with omap_cpufreq_lock held */
-static void omap_thermal_step_freq_down(struct cpufreq_policy *policy)
+/*
+ * Highest frequency giving up at least @reduction percent of max_freq, or
+ * the lowest one when none does.
+ */
+static unsigned int omap_thermal_cpu_limit(unsigned int reduction)
 {
-	unsigned int cur;
+	unsigned int limit, best = 0, lowest = UINT_MAX;
+	int i;
 
-	max_thermal = omap_thermal_lower_speed();
+	if (!reduction)
+		return max_freq;
 
-	if (en_therm_freq_print)
-		pr_info("%s: temperature too high, starting cpu throtling at max %u\n",
-			__func__, max_thermal);
+	limit = max_freq / 100 * (100 - reduction);
+	for (i = 0; freq_table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		unsigned int freq = freq_table[i].frequency;
 
-	cur = omap_getspeed(0);
-	if (cur > max_thermal)
-		omap_cpufreq_scale(policy, max_thermal, cur,
-				   CPUFREQ_RELATION_L);
+		if (freq == CPUFREQ_ENTRY_INVALID)
+			continue;
+		if (freq < lowest)
+			lowest = freq;
+		if (freq <= limit && freq > best)
+			best = freq;
+	}
+
+	return best ? best : lowest;
+}
+
+/* One OPP below max_freq per case cooling step */
+static unsigned int omap_thermal_case_limit(unsigned int steps)
+{
+	unsigned int limit = max_freq;
+
+	while (steps--)
+		limit = omap_thermal_lower_speed(limit);
+
+	return limit;
 }
 
 /* This function needs to be called with omap_cpufreq_lock held */
-static void omap_thermal_step_freq_up(struct cpufreq_policy *policy)
+static void omap_thermal_set_max(struct cpufreq_policy *policy,
+				 unsigned int new_max)
 {
 	unsigned int cur;
+	bool up = new_max > max_thermal;
 
-	max_thermal = max_freq;
+	max_thermal = new_max;
 
 	if (en_therm_freq_print)
-		pr_info("%s: temperature reduced, stepping up to %i\n",
-			__func__, current_target_freq);
+		pr_info("%s: cpu throttling at max %u\n", __func__, max_thermal);
 
 	cur = omap_getspeed(0);
-	omap_cpufreq_scale(policy, current_target_freq, cur,
-			   CPUFREQ_RELATION_L);
+	if (up)
+		omap_cpufreq_scale(policy, current_target_freq, cur,
+				   CPUFREQ_RELATION_L);
+	else if (cur > max_thermal)
+		omap_cpufreq_scale(policy, max_thermal, cur,
+				   CPUFREQ_RELATION_L);
 }
 
 /*
@@ -272,11 +374,14 @@ static void omap_thermal_step_freq_up(struct cpufreq_policy *policy)
  * @param cooling_level: percentage of required cooling at the moment
  *
  * The maximum cpu frequency will be readjusted based on the required
- * cooling_level.
+ * cooling_level.  The die governor asks for a percentage of max_freq to
+ * give up, the case governor for a number of OPPs to step down past its
+ * sub-zones; the lowest of both limits applies.
 */
 static int cpufreq_apply_cooling(struct thermal_dev *dev, int cooling_level)
 {
 	struct cpufreq_policy policy;
+	unsigned int new_max;
 
 	cpufreq_get_policy(&policy, 0);
 
@@ -290,29 +395,18 @@ static int cpufreq_apply_cooling(struct thermal_dev *dev, int cooling_level)
 			tmp = 0;
 		case_cooling_level = tmp;
 	} else {
-		cpu_cooling_level = cooling_level;
+		cpu_cooling_level = clamp(cooling_level, 0, 100);
 	}
 
-	if (case_cooling_level > cpu_cooling_level)
-		new_cooling_level = case_cooling_level;
-	else
-		new_cooling_level = cpu_cooling_level;
+	new_max = min(omap_thermal_cpu_limit(cpu_cooling_level),
+		      omap_thermal_case_limit(case_cooling_level));
 
-	pr_debug("%s: cooling_level %d case %d cpu %d new %d curr %d\n",
+	pr_debug("%s: cooling_level %d case %d cpu %d max %u curr max %u\n",
 		__func__, cooling_level, case_cooling_level,
-		cpu_cooling_level, new_cooling_level, current_cooling_level);
-
-	if (new_cooling_level < current_cooling_level) {
-		pr_debug("%s: Unthrottle cool level %i curr cool %i\n",
-			__func__, new_cooling_level, current_cooling_level);
-		omap_thermal_step_freq_up(&policy);
-	} else if (new_cooling_level > current_cooling_level) {
-		pr_debug("%s: Throttle cool level %i curr cool %i\n",
-			__func__, new_cooling_level, current_cooling_level);
-		omap_thermal_step_freq_down(&policy);
-	}
+		cpu_cooling_level, new_max, max_thermal);
 
-	current_cooling_level = new_cooling_level;
+	if (new_max != max_thermal)
+		omap_thermal_set_max(&policy, new_max);
 
 	mutex_unlock(&omap_cpufreq_lock);
 
@@ -412,7 +506,7 @@ static int __cpuinit omap_cpu_init(struct cpufreq_policy *policy)
 		cpumask_setall(policy->cpus);
 	}
 
-	/* FIXME: what's the actual transition time? */
+	/* until measured by the first transitions, see omap_cpufreq_scale() */
 	policy->cpuinfo.transition_latency = 300 * 1000;
 
 	return 0;
@@ -447,6 +541,76 @@ static struct cpufreq_driver omap_driver = {
 	.attr		= omap_cpufreq_attr,
 };
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *omap_cpufreq_dbg_dir;
+
+static int omap_cpufreq_lat_show(struct seq_file *s, void *unused)
+{
+	struct omap_cpufreq_lat *lat;
+	u32 n;
+	int i, j;
+
+	mutex_lock(&omap_cpufreq_lock);
+	n = omap_cpufreq_transitions;
+
+	seq_printf(s, "transitions: %u\n\n%-10s %8s %8s %8s", n, "phase",
+		   "last", "max", "avg");
+	for (j = 0; j < OMAP_CPUFREQ_LAT_BUCKETS - 1; j++)
+		seq_printf(s, " <%6u", OMAP_CPUFREQ_LAT_BASE_US << j);
+	seq_printf(s, " >=%5u\n",
+		   OMAP_CPUFREQ_LAT_BASE_US << (OMAP_CPUFREQ_LAT_BUCKETS - 2));
+
+	for (i = 0; i < OMAP_CPUFREQ_LAT_COUNT; i++) {
+		lat = &omap_cpufreq_lat[i];
+		seq_printf(s, "%-10s %8u %8u %8llu", omap_cpufreq_lat_names[i],
+			   lat->last_us, lat->max_us,
+			   n ? div_u64(lat->total_us, n) : 0);
+		for (j = 0; j < OMAP_CPUFREQ_LAT_BUCKETS; j++)
+			seq_printf(s, " %7u", lat->hist[j]);
+		seq_printf(s, "\n");
+	}
+	mutex_unlock(&omap_cpufreq_lock);
+
+	seq_printf(s, "\nall times in us\n");
+	return 0;
+}
+
+static int omap_cpufreq_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_cpufreq_lat_show, inode->i_private);
+}
+
+static const struct file_operations omap_cpufreq_lat_fops = {
+	.open = omap_cpufreq_lat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void __init omap_cpufreq_dbg_init(void)
+{
+	omap_cpufreq_dbg_dir = debugfs_create_dir("omap_cpufreq", NULL);
+	if (IS_ERR_OR_NULL(omap_cpufreq_dbg_dir))
+		return;
+
+	debugfs_create_file("latency", S_IRUGO, omap_cpufreq_dbg_dir, NULL,
+			    &omap_cpufreq_lat_fops);
+}
+
+static void __exit omap_cpufreq_dbg_exit(void)
+{
+	debugfs_remove_recursive(omap_cpufreq_dbg_dir);
+}
+#else
+static inline void omap_cpufreq_dbg_init(void)
+{
+}
+
+static inline void omap_cpufreq_dbg_exit(void)
+{
+}
+#endif
+
 static int __init omap_cpufreq_init(void)
 {
 	int ret;
@@ -475,7 +639,6 @@ static int __init omap_cpufreq_init(void)
 	omap_cpufreq_ready = !ret;
 
 	max_thermal = max_freq;
-	current_cooling_level = 0;
 	en_therm_freq_print = 0;
 	cpu_cooling_level = 0;
 	case_cooling_level = 0;
@@ -483,11 +646,15 @@ static int __init omap_cpufreq_init(void)
 	if (!ret)
 		ret = omap_cpufreq_cooling_init();
 
+	if (!ret)
+		omap_cpufreq_dbg_init();
+
 	return ret;
 }
 
 static void __exit omap_cpufreq_exit(void)
 {
+	omap_cpufreq_dbg_exit();
 	omap_cpufreq_cooling_exit();
 	cpufreq_unregister_driver(&omap_driver);
 }
@@ -23,6 +23,8 @@
 #include "cpuidle.h"
 
 DEFINE_PER_CPU(struct cpuidle_device *, cpuidle_devices);
+/* state each cpu is idling in, NULL while it runs */
+static DEFINE_PER_CPU(struct cpuidle_state *, cpuidle_cur_state);
 
 DEFINE_MUTEX(cpuidle_lock);
 LIST_HEAD(cpuidle_detected_devices);
@@ -170,6 +172,7 @@ int cpuidle_idle_call(void)
 
 	trace_power_start_rcuidle(POWER_CSTATE, next_state, dev->cpu);
 	trace_cpu_idle_rcuidle(next_state, dev->cpu);
+	__this_cpu_write(cpuidle_cur_state, &drv->states[next_state]);
 
 	if (cpuidle_state_is_coupled(dev, drv, next_state))
 		entered_state = cpuidle_enter_state_coupled(dev, drv,
@@ -177,6 +180,7 @@ int cpuidle_idle_call(void)
 	else
 		entered_state = cpuidle_enter_state(dev, drv, next_state);
 
+	__this_cpu_write(cpuidle_cur_state, NULL);
 	trace_power_end_rcuidle(dev->cpu);
 	trace_cpu_idle_rcuidle(PWR_EVENT_EXIT, dev->cpu);
 
@@ -187,6 +191,17 @@ int cpuidle_idle_call(void)
 	return 0;
 }
 
+/**
+ * cpuidle_get_cur_state - the state a cpu is currently idling in
+ * @cpu: the cpu to look at
+ *
+ * Returns NULL if @cpu is not inside cpuidle_idle_call().
+ */
+struct cpuidle_state *cpuidle_get_cur_state(int cpu)
+{
+	return ACCESS_ONCE(per_cpu(cpuidle_cur_state, cpu));
+}
+
 /**
  * cpuidle_install_idle_handler - installs the cpuidle idle loop handler
  */
@@ -77,6 +77,7 @@
 #define FLAGS_INIT		BIT(4)
 #define FLAGS_FAST		BIT(5)
 #define FLAGS_BUSY		BIT(6)
+#define FLAGS_CLK		BIT(7)
 
 struct omap_aes_ctx {
 	struct omap_aes_dev *dd;
@@ -84,15 +85,26 @@ struct omap_aes_ctx {
 	int		keylen;
 	u32		key[AES_KEYSIZE_256 / sizeof(u32)];
 	unsigned long	flags;
+
+	/* software implementation for requests not worth the DMA setup */
+	struct crypto_blkcipher	*fallback;
 };
 
 struct omap_aes_reqctx {
 	unsigned long mode;
 };
 
-#define OMAP_AES_QUEUE_LENGTH	1
+#define OMAP_AES_QUEUE_LENGTH	32
 #define OMAP_AES_CACHE_SIZE	0
 
+/*
+ * Requests shorter than this go to the software fallback: below it the
+ * DMA setup and completion tasklet cost more than the cipher itself.
+ */
+static unsigned int fallback_size = 256;
+module_param(fallback_size, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(fallback_size, "requests shorter than this many bytes are done in software");
+
 struct omap_aes_dev {
 	struct list_head	list;
 	unsigned long		phys_base;
@@ -115,6 +127,8 @@ struct omap_aes_dev {
 	size_t				in_offset;
 	struct scatterlist		*out_sg;
 	size_t				out_offset;
+	int				in_nents;
+	int				out_nents;
 
 	size_t			buflen;
 	void			*buf_in;
@@ -177,11 +191,15 @@ static int omap_aes_wait(struct omap_aes_dev *dd, u32 offset, u32 bit)
 static int omap_aes_hw_init(struct omap_aes_dev *dd)
 {
 	/*
-	 * clocks are enabled when request starts and disabled when finished.
+	 * clocks are enabled when a request starts and stay on while more
+	 * are queued behind it; they are disabled once the queue is empty.
 	 * It may be long delays between requests.
 	 * Device might go to off mode to save power.
 	 */
-	clk_enable(dd->iclk);
+	if (!(dd->flags & FLAGS_CLK)) {
+		clk_enable(dd->iclk);
+		dd->flags |= FLAGS_CLK;
+	}
 
 	if (!(dd->flags & FLAGS_INIT)) {
 		/* is it necessary to reset before every operation? */
@@ -427,6 +445,80 @@ static int sg_copy(struct scatterlist **sg, size_t *offset, void *buf,
 	return off;
 }
 
+/*
+ * DMA can go straight to and from the caller's buffers when every entry
+ * covering the request starts word aligned and holds whole AES blocks,
+ * however many entries there are. Returns the number of entries, 0 if
+ * the request has to be bounced through the cache buffers.
+ */
+static int omap_aes_sg_aligned(struct scatterlist *sg, size_t total)
+{
+	size_t len;
+	int nents = 0;
+
+	while (sg && total) {
+		len = min_t(size_t, sg->length, total);
+		if (!IS_ALIGNED(sg->offset, sizeof(u32)) ||
+		    !IS_ALIGNED(len, AES_BLOCK_SIZE))
+			return 0;
+		total -= len;
+		sg = sg_next(sg);
+		nents++;
+	}
+
+	return total ? 0 : nents;
+}
+
+static int omap_aes_map_req(struct omap_aes_dev *dd)
+{
+	struct ablkcipher_request *req = dd->req;
+
+	dd->in_nents = omap_aes_sg_aligned(req->src, req->nbytes);
+	dd->out_nents = omap_aes_sg_aligned(req->dst, req->nbytes);
+	if (!dd->in_nents || !dd->out_nents) {
+		dd->flags &= ~FLAGS_FAST;
+		return 0;
+	}
+
+	if (!dma_map_sg(dd->dev, req->src, dd->in_nents, DMA_TO_DEVICE)) {
+		dev_err(dd->dev, "dma_map_sg() error\n");
+		return -EINVAL;
+	}
+
+	if (!dma_map_sg(dd->dev, req->dst, dd->out_nents, DMA_FROM_DEVICE)) {
+		dev_err(dd->dev, "dma_map_sg() error\n");
+		dma_unmap_sg(dd->dev, req->src, dd->in_nents, DMA_TO_DEVICE);
+		return -EINVAL;
+	}
+
+	dd->flags |= FLAGS_FAST;
+
+	return 0;
+}
+
+static void omap_aes_unmap_req(struct omap_aes_dev *dd)
+{
+	struct ablkcipher_request *req = dd->req;
+
+	if (!(dd->flags & FLAGS_FAST))
+		return;
+
+	dma_unmap_sg(dd->dev, req->dst, dd->out_nents, DMA_FROM_DEVICE);
+	dma_unmap_sg(dd->dev, req->src, dd->in_nents, DMA_TO_DEVICE);
+	dd->flags &= ~FLAGS_FAST;
+}
+
+/* step over @count bytes just transferred from the current sg entry */
+static void omap_aes_sg_advance(struct scatterlist **sg, size_t *offset,
+				size_t count)
+{
+	*offset += count;
+	if (*offset == sg_dma_len(*sg)) {
+		*sg = sg_next(*sg);
+		*offset = 0;
+	}
+}
+
 static int omap_aes_crypt_dma(struct crypto_tfm *tfm, dma_addr_t dma_addr_in,
 			       dma_addr_t dma_addr_out, int length)
 {
@@ -474,49 +566,21 @@ static int omap_aes_crypt_dma_start(struct omap_aes_dev *dd)
 {
 	struct crypto_tfm *tfm = crypto_ablkcipher_tfm(
 					crypto_ablkcipher_reqtfm(dd->req));
-	int err, fast = 0, in, out;
 	size_t count;
 	dma_addr_t addr_in, addr_out;
 
 	pr_debug("total: %d\n", dd->total);
 
-	if (sg_is_last(dd->in_sg) && sg_is_last(dd->out_sg)) {
-		/* check for alignment */
-		in = IS_ALIGNED((u32)dd->in_sg->offset, sizeof(u32));
-		out = IS_ALIGNED((u32)dd->out_sg->offset, sizeof(u32));
-
-		fast = in && out;
-	}
-
-	if (fast)  {
-		count = min(dd->total, sg_dma_len(dd->in_sg));
-		count = min(count, sg_dma_len(dd->out_sg));
-
-		if (count != dd->total) {
-			pr_err("request length != buffer length\n");
-			return -EINVAL;
-		}
+	if (dd->flags & FLAGS_FAST) {
+		/* as much as both current entries have left */
+		count = min(sg_dma_len(dd->in_sg) - dd->in_offset,
+			    sg_dma_len(dd->out_sg) - dd->out_offset);
+		count = min(count, dd->total);
 
 		pr_debug("fast\n");
 
-		err = dma_map_sg(dd->dev, dd->in_sg, 1, DMA_TO_DEVICE);
-		if (!err) {
-			dev_err(dd->dev, "dma_map_sg() error\n");
-			return -EINVAL;
-		}
-
-		err = dma_map_sg(dd->dev, dd->out_sg, 1, DMA_FROM_DEVICE);
-		if (!err) {
-			dev_err(dd->dev, "dma_map_sg() error\n");
-			dma_unmap_sg(dd->dev, dd->in_sg, 1, DMA_TO_DEVICE);
-			return -EINVAL;
-		}
-
-		addr_in = sg_dma_address(dd->in_sg);
-		addr_out = sg_dma_address(dd->out_sg);
-
-		dd->flags |= FLAGS_FAST;
-
+		addr_in = sg_dma_address(dd->in_sg) + dd->in_offset;
+		addr_out = sg_dma_address(dd->out_sg) + dd->out_offset;
 	} else {
 		/* use cache buffers */
 		count = sg_copy(&dd->in_sg, &dd->in_offset, dd->buf_in,
@@ -524,20 +588,11 @@ static int omap_aes_crypt_dma_start(struct omap_aes_dev *dd)
 
 		addr_in = dd->dma_addr_in;
 		addr_out = dd->dma_addr_out;
-
-		dd->flags &= ~FLAGS_FAST;
-
 	}
 
 	dd->total -= count;
 
-	err = omap_aes_crypt_dma(tfm, addr_in, addr_out, count);
-	if (err) {
-		dma_unmap_sg(dd->dev, dd->in_sg, 1, DMA_TO_DEVICE);
-		dma_unmap_sg(dd->dev, dd->out_sg, 1, DMA_TO_DEVICE);
-	}
-
-	return err;
+	return omap_aes_crypt_dma(tfm, addr_in, addr_out, count);
 }
 
 static void omap_aes_finish_req(struct omap_aes_dev *dd, int err)
@@ -546,7 +601,7 @@ static void omap_aes_finish_req(struct omap_aes_dev *dd, int err)
 
 	pr_debug("err: %d\n", err);
 
-	clk_disable(dd->iclk);
+	omap_aes_unmap_req(dd);
 	dd->flags &= ~FLAGS_BUSY;
 
 	req->base.complete(&req->base, err);
@@ -565,8 +620,9 @@ static int omap_aes_crypt_dma_stop(struct omap_aes_dev *dd)
 	omap_stop_dma(dd->dma_lch_out);
 
 	if (dd->flags & FLAGS_FAST) {
-		dma_unmap_sg(dd->dev, dd->out_sg, 1, DMA_FROM_DEVICE);
-		dma_unmap_sg(dd->dev, dd->in_sg, 1, DMA_TO_DEVICE);
+		omap_aes_sg_advance(&dd->in_sg, &dd->in_offset, dd->dma_size);
+		omap_aes_sg_advance(&dd->out_sg, &dd->out_offset,
+				    dd->dma_size);
 	} else {
 		dma_sync_single_for_device(dd->dev, dd->dma_addr_out,
 					   dd->dma_size, DMA_FROM_DEVICE);
@@ -601,8 +657,13 @@ static int omap_aes_handle_queue(struct omap_aes_dev *dd,
 	}
 	backlog = crypto_get_backlog(&dd->queue);
 	async_req = crypto_dequeue_request(&dd->queue);
-	if (async_req)
+	if (async_req) {
 		dd->flags |= FLAGS_BUSY;
+	} else if (dd->flags & FLAGS_CLK) {
+		/* queue ran dry, let the module idle */
+		clk_disable(dd->iclk);
+		dd->flags &= ~FLAGS_CLK;
+	}
 	spin_unlock_irqrestore(&dd->lock, flags);
 
 	if (!async_req)
@@ -630,6 +691,8 @@ static int omap_aes_handle_queue(struct omap_aes_dev *dd,
 	ctx->dd = dd;
 
 	err = omap_aes_write_ctrl(dd);
+	if (!err)
+		err = omap_aes_map_req(dd);
 	if (!err)
 		err = omap_aes_crypt_dma_start(dd);
 	if (err) {
@@ -671,6 +734,24 @@ static void omap_aes_queue_task(unsigned long data)
 	omap_aes_handle_queue(dd, NULL);
 }
 
+static int omap_aes_crypt_fallback(struct ablkcipher_request *req,
+				   unsigned long mode)
+{
+	struct omap_aes_ctx *ctx = crypto_ablkcipher_ctx(
+			crypto_ablkcipher_reqtfm(req));
+	struct blkcipher_desc desc = {
+		.tfm	= ctx->fallback,
+		.info	= req->info,
+		.flags	= req->base.flags,
+	};
+
+	if (mode & FLAGS_ENCRYPT)
+		return crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+						   req->nbytes);
+	return crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+					   req->nbytes);
+}
+
 static int omap_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 {
 	struct omap_aes_ctx *ctx = crypto_ablkcipher_ctx(
@@ -687,6 +768,9 @@ static int omap_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 		return -EINVAL;
 	}
 
+	if (ctx->fallback && req->nbytes < fallback_size)
+		return omap_aes_crypt_fallback(req, mode);
+
 	dd = omap_aes_find_dev(ctx);
 	if (!dd)
 		return -ENODEV;
@@ -712,6 +796,9 @@ static int omap_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 	memcpy(ctx->key, key, keylen);
 	ctx->keylen = keylen;
 
+	if (ctx->fallback)
+		return crypto_blkcipher_setkey(ctx->fallback, key, keylen);
+
 	return 0;
 }
 
@@ -737,16 +824,31 @@ static int omap_aes_cbc_decrypt(struct ablkcipher_request *req)
 
 static int omap_aes_cra_init(struct crypto_tfm *tfm)
 {
+	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
 	pr_debug("enter\n");
 
 	tfm->crt_ablkcipher.reqsize = sizeof(struct omap_aes_reqctx);
 
+	/* without a fallback every request just goes to the hardware */
+	ctx->fallback = crypto_alloc_blkcipher(crypto_tfm_alg_name(tfm), 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		pr_debug("no fallback for %s\n", crypto_tfm_alg_name(tfm));
+		ctx->fallback = NULL;
+	}
+
 	return 0;
 }
 
 static void omap_aes_cra_exit(struct crypto_tfm *tfm)
 {
+	struct omap_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
 	pr_debug("enter\n");
+
+	if (ctx->fallback)
+		crypto_free_blkcipher(ctx->fallback);
 }
 
 /* ********************** ALGS ************************************ */
@@ -758,6 +860,7 @@ static struct crypto_alg algs[] = {
 	.cra_priority		= 100,
 	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
 				  CRYPTO_ALG_KERN_DRIVER_ONLY |
+				  CRYPTO_ALG_NEED_FALLBACK |
 				  CRYPTO_ALG_ASYNC,
 	.cra_blocksize		= AES_BLOCK_SIZE,
 	.cra_ctxsize		= sizeof(struct omap_aes_ctx),
@@ -780,6 +883,7 @@ static struct crypto_alg algs[] = {
 	.cra_priority		= 100,
 	.cra_flags		= CRYPTO_ALG_TYPE_ABLKCIPHER |
 				  CRYPTO_ALG_KERN_DRIVER_ONLY |
+				  CRYPTO_ALG_NEED_FALLBACK |
 				  CRYPTO_ALG_ASYNC,
 	.cra_blocksize		= AES_BLOCK_SIZE,
 	.cra_ctxsize		= sizeof(struct omap_aes_ctx),
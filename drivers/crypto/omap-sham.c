@@ -34,6 +34,7 @@
 #include <crypto/scatterwalk.h>
 #include <crypto/algapi.h>
 #include <crypto/sha.h>
+#include <crypto/md5.h>
 #include <crypto/hash.h>
 #include <crypto/internal/hash.h>
 
@@ -45,7 +46,6 @@
 #define SHA_REG_DIN(x)			(0x1C + ((x) * 0x04))
 
 #define SHA1_MD5_BLOCK_SIZE		SHA1_BLOCK_SIZE
-#define MD5_DIGEST_SIZE			16
 
 #define SHA_REG_DIGCNT			0x14
 
@@ -80,6 +80,7 @@
 #define FLAGS_INIT		4
 #define FLAGS_CPU		5
 #define FLAGS_DMA_READY		6
+#define FLAGS_CLK		7
 /* context flags */
 #define FLAGS_FINUP		16
 #define FLAGS_SG		17
@@ -116,10 +117,20 @@ struct omap_sham_reqctx {
 	u8			buffer[0] OMAP_ALIGNED;
 };
 
+union omap_sham_state {
+	struct sha1_state	sha1;
+	struct md5_state	md5;
+};
+
 struct omap_sham_hmac_ctx {
 	struct crypto_shash	*shash;
 	u8			ipad[SHA1_MD5_BLOCK_SIZE];
 	u8			opad[SHA1_MD5_BLOCK_SIZE];
+
+	/* pad states precomputed at setkey time */
+	bool			prekey;
+	u32			ipad_digest[SHA1_DIGEST_SIZE / sizeof(u32)];
+	union omap_sham_state	opad_state;
 };
 
 struct omap_sham_ctx {
@@ -133,7 +144,7 @@ struct omap_sham_ctx {
 	struct omap_sham_hmac_ctx base[0];
 };
 
-#define OMAP_SHAM_QUEUE_LENGTH	1
+#define OMAP_SHAM_QUEUE_LENGTH	32
 
 struct omap_sham_dev {
 	struct list_head	list;
@@ -164,6 +175,14 @@ static struct omap_sham_drv sham = {
 	.lock = __SPIN_LOCK_UNLOCKED(sham.lock),
 };
 
+/*
+ * Below this size the engine setup, the interrupt and the tasklet cost
+ * more than hashing on the cpu, so whole digests go to the fallback.
+ */
+static unsigned int fallback_size = 256;
+module_param(fallback_size, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(fallback_size, "digests shorter than this many bytes are done in software");
+
 static inline u32 omap_sham_read(struct omap_sham_dev *dd, u32 offset)
 {
 	return __raw_readl(dd->io_base + offset);
@@ -238,7 +257,9 @@ static void omap_sham_copy_ready_hash(struct ahash_request *req)
 
 static int omap_sham_hw_init(struct omap_sham_dev *dd)
 {
-	clk_enable(dd->iclk);
+	/* clock stays on while there are queued requests */
+	if (!test_and_set_bit(FLAGS_CLK, &dd->flags))
+		clk_enable(dd->iclk);
 
 	if (!test_bit(FLAGS_INIT, &dd->flags)) {
 		omap_sham_write_mask(dd, SHA_REG_MASK,
@@ -550,8 +571,14 @@ static int omap_sham_init(struct ahash_request *req)
 	if (tctx->flags & BIT(FLAGS_HMAC)) {
 		struct omap_sham_hmac_ctx *bctx = tctx->base;
 
-		memcpy(ctx->buffer, bctx->ipad, SHA1_MD5_BLOCK_SIZE);
-		ctx->bufcnt = SHA1_MD5_BLOCK_SIZE;
+		if (bctx->prekey) {
+			/* resume from the inner state, ipad is already hashed */
+			memcpy(ctx->digest, bctx->ipad_digest, SHA1_DIGEST_SIZE);
+			ctx->digcnt = SHA1_MD5_BLOCK_SIZE;
+		} else {
+			memcpy(ctx->buffer, bctx->ipad, SHA1_MD5_BLOCK_SIZE);
+			ctx->bufcnt = SHA1_MD5_BLOCK_SIZE;
+		}
 		ctx->flags |= BIT(FLAGS_HMAC);
 	}
 
@@ -615,6 +642,11 @@ static int omap_sham_finish_hmac(struct ahash_request *req)
 	desc.shash.tfm = bctx->shash;
 	desc.shash.flags = 0; /* not CRYPTO_TFM_REQ_MAY_SLEEP */
 
+	if (bctx->prekey)
+		return crypto_shash_import(&desc.shash, &bctx->opad_state) ?:
+		       crypto_shash_finup(&desc.shash, req->result, ds,
+					  req->result);
+
 	return crypto_shash_init(&desc.shash) ?:
 	       crypto_shash_update(&desc.shash, bctx->opad, bs) ?:
 	       crypto_shash_finup(&desc.shash, req->result, ds, req->result);
@@ -653,7 +685,6 @@ static void omap_sham_finish_req(struct ahash_request *req, int err)
 	/* atomic operation is not needed here */
 	dd->flags &= ~(BIT(FLAGS_BUSY) | BIT(FLAGS_FINAL) | BIT(FLAGS_CPU) |
 			BIT(FLAGS_DMA_READY) | BIT(FLAGS_OUTPUT_READY));
-	clk_disable(dd->iclk);
 
 	if (req->base.complete)
 		req->base.complete(&req->base, err);
@@ -681,6 +712,9 @@ static int omap_sham_handle_queue(struct omap_sham_dev *dd,
 	async_req = crypto_dequeue_request(&dd->queue);
 	if (async_req)
 		set_bit(FLAGS_BUSY, &dd->flags);
+	else if (test_and_clear_bit(FLAGS_CLK, &dd->flags))
+		/* queue ran dry, let the module idle */
+		clk_disable(dd->iclk);
 	spin_unlock_irqrestore(&dd->lock, flags);
 
 	if (!async_req)
@@ -813,6 +847,10 @@ static int omap_sham_final(struct ahash_request *req)
 	/* HMAC is always >= 9 because ipad == block size */
 	if ((ctx->digcnt + ctx->bufcnt) < 9)
 		return omap_sham_final_shash(req);
+	/* only the ipad went through, the fallback knows the key too */
+	else if ((ctx->flags & BIT(FLAGS_HMAC)) && !ctx->bufcnt &&
+		 ctx->digcnt == SHA1_MD5_BLOCK_SIZE)
+		return omap_sham_final_shash(req);
 	else if (ctx->bufcnt)
 		return omap_sham_enqueue(req, OP_FINAL);
 
@@ -839,11 +877,80 @@ static int omap_sham_finup(struct ahash_request *req)
 	return err1 ?: err2;
 }
 
+static int omap_sham_digest_shash(struct ahash_request *req)
+{
+	struct omap_sham_ctx *tctx = crypto_tfm_ctx(req->base.tfm);
+	struct {
+		struct shash_desc shash;
+		char ctx[crypto_shash_descsize(tctx->fallback)];
+	} desc;
+
+	desc.shash.tfm = tctx->fallback;
+	desc.shash.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	return shash_ahash_digest(req, &desc.shash);
+}
+
 static int omap_sham_digest(struct ahash_request *req)
 {
+	if (req->nbytes < fallback_size)
+		return omap_sham_digest_shash(req);
+
 	return omap_sham_init(req) ?: omap_sham_finup(req);
 }
 
+/*
+ * Hash ipad and opad once per key: the inner state is loaded into the
+ * digest registers so the engine never sees the ipad block, the outer
+ * state is imported by finish_hmac().  Only done when the base shash
+ * exports the generic state layout.
+ */
+static int omap_sham_hmac_prekey(struct omap_sham_hmac_ctx *bctx)
+{
+	int bs = crypto_shash_blocksize(bctx->shash);
+	int ds = crypto_shash_digestsize(bctx->shash);
+	union omap_sham_state state;
+	struct {
+		struct shash_desc shash;
+		char ctx[crypto_shash_descsize(bctx->shash)];
+	} desc;
+	size_t size;
+	int err;
+
+	bctx->prekey = false;
+
+	size = ds == SHA1_DIGEST_SIZE ? sizeof(struct sha1_state) :
+					sizeof(struct md5_state);
+	if (crypto_shash_statesize(bctx->shash) != size)
+		return 0;
+
+	desc.shash.tfm = bctx->shash;
+	desc.shash.flags = crypto_shash_get_flags(bctx->shash) &
+			   CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	err = crypto_shash_init(&desc.shash) ?:
+	      crypto_shash_update(&desc.shash, bctx->ipad, bs) ?:
+	      crypto_shash_export(&desc.shash, &state);
+	if (err)
+		return err;
+
+	/* the digest registers take the state words in cpu order */
+	if (ds == SHA1_DIGEST_SIZE)
+		memcpy(bctx->ipad_digest, state.sha1.state, ds);
+	else
+		memcpy(bctx->ipad_digest, state.md5.hash, ds);
+
+	err = crypto_shash_init(&desc.shash) ?:
+	      crypto_shash_update(&desc.shash, bctx->opad, bs) ?:
+	      crypto_shash_export(&desc.shash, &bctx->opad_state);
+	if (err)
+		return err;
+
+	bctx->prekey = true;
+
+	return 0;
+}
+
 static int omap_sham_setkey(struct crypto_ahash *tfm, const u8 *key,
 		      unsigned int keylen)
 {
@@ -875,7 +982,7 @@ static int omap_sham_setkey(struct crypto_ahash *tfm, const u8 *key,
 		bctx->opad[i] ^= 0x5c;
 	}
 
-	return err;
+	return omap_sham_hmac_prekey(bctx);
 }
 
 static int omap_sham_cra_init_alg(struct crypto_tfm *tfm, const char *alg_base)
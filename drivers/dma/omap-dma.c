@@ -0,0 +1,753 @@
+/*
+ * OMAP system DMA DMAengine support
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * Built on top of the channel API in arch/arm/plat-omap/dma.c, so the
+ * legacy users and this driver share the same logical channel pool.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/device.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/omap-dma.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+
+#include <plat/cpu.h>
+#include <plat/dma.h>
+
+#include "dmaengine.h"
+
+/* one virtual channel per request line, the lch is taken on demand */
+#define OMAP_DMA_NR_SIGNALS	127
+
+struct omap_dmadev {
+	struct dma_device ddev;
+};
+
+struct omap_sg {
+	dma_addr_t addr;
+	u32 en;			/* number of elements (24-bit) */
+	u32 fn;			/* number of frames (16-bit) */
+};
+
+struct omap_desc {
+	struct dma_async_tx_descriptor tx;
+	struct list_head node;
+
+	enum dma_transfer_direction dir;
+	dma_addr_t dev_addr;
+
+	u8 es;			/* OMAP_DMA_DATA_TYPE_xxx */
+	u8 sync_mode;		/* OMAP_DMA_SYNC_xxx */
+	u8 sync_type;		/* OMAP_DMA_xxx_SYNC* */
+	u8 periph_port;		/* Peripheral port */
+
+	unsigned sglen;
+	struct omap_sg sg[0];
+};
+
+struct omap_chan {
+	struct dma_chan chan;
+	spinlock_t lock;
+
+	struct dma_slave_config cfg;
+	unsigned dma_sig;
+	int dma_ch;
+	bool cyclic;
+	bool paused;
+
+	/* submitted -> issued -> running -> completed */
+	struct list_head desc_submitted;
+	struct list_head desc_issued;
+	struct list_head desc_completed;
+	struct omap_desc *desc;
+	unsigned sgidx;
+
+	/* periods elapsed since the tasklet last ran, cyclic only */
+	unsigned periods;
+	struct tasklet_struct task;
+};
+
+static const unsigned es_bytes[] = {
+	[OMAP_DMA_DATA_TYPE_S8] = 1,
+	[OMAP_DMA_DATA_TYPE_S16] = 2,
+	[OMAP_DMA_DATA_TYPE_S32] = 4,
+};
+
+static inline struct omap_chan *to_omap_dma_chan(struct dma_chan *c)
+{
+	return container_of(c, struct omap_chan, chan);
+}
+
+static inline struct omap_desc *to_omap_dma_desc(
+	struct dma_async_tx_descriptor *tx)
+{
+	return container_of(tx, struct omap_desc, tx);
+}
+
+static void omap_dma_start_sg(struct omap_chan *c, struct omap_desc *d,
+	unsigned idx)
+{
+	struct omap_sg *sg = d->sg + idx;
+
+	if (d->dir == DMA_DEV_TO_MEM)
+		omap_set_dma_dest_params(c->dma_ch, OMAP_DMA_PORT_EMIFF,
+			OMAP_DMA_AMODE_POST_INC, sg->addr, 0, 0);
+	else
+		omap_set_dma_src_params(c->dma_ch, OMAP_DMA_PORT_EMIFF,
+			OMAP_DMA_AMODE_POST_INC, sg->addr, 0, 0);
+
+	omap_set_dma_transfer_params(c->dma_ch, d->es, sg->en, sg->fn,
+		d->sync_mode, c->dma_sig, d->sync_type);
+
+	omap_start_dma(c->dma_ch);
+}
+
+/* Start the next issued descriptor.  Called with c->lock held. */
+static void omap_dma_start_desc(struct omap_chan *c)
+{
+	struct omap_desc *d;
+
+	if (list_empty(&c->desc_issued)) {
+		c->desc = NULL;
+		return;
+	}
+
+	d = list_first_entry(&c->desc_issued, struct omap_desc, node);
+	list_del(&d->node);
+	c->desc = d;
+	c->sgidx = 0;
+
+	if (d->dir == DMA_DEV_TO_MEM)
+		omap_set_dma_src_params(c->dma_ch, d->periph_port,
+			OMAP_DMA_AMODE_CONSTANT, d->dev_addr, 0, 0);
+	else
+		omap_set_dma_dest_params(c->dma_ch, d->periph_port,
+			OMAP_DMA_AMODE_CONSTANT, d->dev_addr, 0, 0);
+
+	omap_dma_start_sg(c, d, 0);
+}
+
+/*
+ * Legacy channel callback, runs from the sDMA interrupt.  The next
+ * segment or descriptor is programmed right here so the channel does
+ * not sit idle until the tasklet gets to run.
+ */
+static void omap_dma_callback(int ch, u16 status, void *data)
+{
+	struct omap_chan *c = data;
+	struct omap_desc *d;
+	unsigned long flags;
+
+	if (status & (OMAP2_DMA_TRANS_ERR_IRQ | OMAP2_DMA_MISALIGNED_ERR_IRQ))
+		dev_err(c->chan.device->dev, "lch %d: error status %04x\n",
+			ch, status);
+
+	spin_lock_irqsave(&c->lock, flags);
+	d = c->desc;
+	if (d) {
+		if (c->cyclic) {
+			c->periods++;
+		} else if (++c->sgidx < d->sglen) {
+			omap_dma_start_sg(c, d, c->sgidx);
+		} else {
+			dma_cookie_complete(&d->tx);
+			list_add_tail(&d->node, &c->desc_completed);
+			omap_dma_start_desc(c);
+		}
+		tasklet_schedule(&c->task);
+	}
+	spin_unlock_irqrestore(&c->lock, flags);
+}
+
+/* Run the client callbacks outside of the channel lock. */
+static void omap_dma_tasklet(unsigned long arg)
+{
+	struct omap_chan *c = (struct omap_chan *)arg;
+	dma_async_tx_callback callback = NULL;
+	void *callback_param = NULL;
+	struct omap_desc *d, *n;
+	unsigned periods = 0;
+	LIST_HEAD(head);
+
+	spin_lock_irq(&c->lock);
+	list_splice_tail_init(&c->desc_completed, &head);
+	if (c->cyclic && c->desc) {
+		periods = c->periods;
+		c->periods = 0;
+		callback = c->desc->tx.callback;
+		callback_param = c->desc->tx.callback_param;
+	}
+	spin_unlock_irq(&c->lock);
+
+	while (callback && periods--)
+		callback(callback_param);
+
+	list_for_each_entry_safe(d, n, &head, node) {
+		if (d->tx.callback)
+			d->tx.callback(d->tx.callback_param);
+		list_del(&d->node);
+		kfree(d);
+	}
+}
+
+static void omap_dma_free_list(struct list_head *head)
+{
+	struct omap_desc *d, *n;
+
+	list_for_each_entry_safe(d, n, head, node) {
+		list_del(&d->node);
+		kfree(d);
+	}
+}
+
+static int omap_dma_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+
+	dev_dbg(c->chan.device->dev, "allocating channel for %u\n",
+		c->dma_sig);
+
+	return omap_request_dma(c->dma_sig, "DMA engine",
+		omap_dma_callback, c, &c->dma_ch);
+}
+
+static int omap_dma_terminate_all(struct omap_chan *c);
+
+static void omap_dma_free_chan_resources(struct dma_chan *chan)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+
+	omap_dma_terminate_all(c);
+	tasklet_kill(&c->task);
+	omap_dma_free_list(&c->desc_completed);
+
+	omap_free_dma(c->dma_ch);
+
+	dev_dbg(c->chan.device->dev, "freeing channel for %u\n", c->dma_sig);
+}
+
+static size_t omap_dma_sg_size(struct omap_desc *d, unsigned idx)
+{
+	return d->sg[idx].en * d->sg[idx].fn * es_bytes[d->es];
+}
+
+static size_t omap_dma_desc_size(struct omap_desc *d)
+{
+	size_t size = 0;
+	unsigned i;
+
+	for (i = 0; i < d->sglen; i++)
+		size += omap_dma_sg_size(d, i);
+
+	return size;
+}
+
+/* Bytes left in the running descriptor.  Called with c->lock held. */
+static size_t omap_dma_running_residue(struct omap_chan *c)
+{
+	struct omap_desc *d = c->desc;
+	size_t size = 0, cur, done;
+	dma_addr_t pos;
+	unsigned i;
+
+	for (i = c->sgidx + 1; i < d->sglen; i++)
+		size += omap_dma_sg_size(d, i);
+
+	if (c->sgidx < d->sglen) {
+		if (d->dir == DMA_DEV_TO_MEM)
+			pos = omap_get_dma_dst_pos(c->dma_ch);
+		else
+			pos = omap_get_dma_src_pos(c->dma_ch);
+
+		cur = omap_dma_sg_size(d, c->sgidx);
+		done = 0;
+		if (pos >= d->sg[c->sgidx].addr)
+			done = min_t(size_t, cur, pos - d->sg[c->sgidx].addr);
+		size += cur - done;
+	}
+
+	return size;
+}
+
+static enum dma_status omap_dma_tx_status(struct dma_chan *chan,
+	dma_cookie_t cookie, struct dma_tx_state *txstate)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	struct omap_desc *d;
+	enum dma_status ret;
+	unsigned long flags;
+	size_t bytes = 0;
+
+	ret = dma_cookie_status(chan, cookie, txstate);
+	if (ret == DMA_SUCCESS || !txstate)
+		return ret;
+
+	spin_lock_irqsave(&c->lock, flags);
+	if (c->desc && c->desc->tx.cookie == cookie) {
+		bytes = omap_dma_running_residue(c);
+	} else {
+		list_for_each_entry(d, &c->desc_issued, node)
+			if (d->tx.cookie == cookie)
+				bytes = omap_dma_desc_size(d);
+		list_for_each_entry(d, &c->desc_submitted, node)
+			if (d->tx.cookie == cookie)
+				bytes = omap_dma_desc_size(d);
+	}
+	if (c->paused)
+		ret = DMA_PAUSED;
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	dma_set_residue(txstate, bytes);
+
+	return ret;
+}
+
+static void omap_dma_issue_pending(struct dma_chan *chan)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	unsigned long flags;
+
+	spin_lock_irqsave(&c->lock, flags);
+	list_splice_tail_init(&c->desc_submitted, &c->desc_issued);
+	if (!c->desc)
+		omap_dma_start_desc(c);
+	spin_unlock_irqrestore(&c->lock, flags);
+}
+
+static dma_cookie_t omap_dma_tx_submit(struct dma_async_tx_descriptor *tx)
+{
+	struct omap_chan *c = to_omap_dma_chan(tx->chan);
+	struct omap_desc *d = to_omap_dma_desc(tx);
+	unsigned long flags;
+	dma_cookie_t cookie;
+
+	spin_lock_irqsave(&c->lock, flags);
+	cookie = dma_cookie_assign(tx);
+	list_add_tail(&d->node, &c->desc_submitted);
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	return cookie;
+}
+
+static int omap_dma_slave_params(struct omap_chan *c,
+	enum dma_transfer_direction dir, dma_addr_t *dev_addr, unsigned *es,
+	u32 *burst)
+{
+	enum dma_slave_buswidth dev_width;
+
+	if (dir == DMA_DEV_TO_MEM) {
+		*dev_addr = c->cfg.src_addr;
+		dev_width = c->cfg.src_addr_width;
+		*burst = c->cfg.src_maxburst;
+	} else if (dir == DMA_MEM_TO_DEV) {
+		*dev_addr = c->cfg.dst_addr;
+		dev_width = c->cfg.dst_addr_width;
+		*burst = c->cfg.dst_maxburst;
+	} else {
+		dev_err(c->chan.device->dev, "invalid dma direction\n");
+		return -EINVAL;
+	}
+
+	switch (dev_width) {
+	case DMA_SLAVE_BUSWIDTH_1_BYTE:
+		*es = OMAP_DMA_DATA_TYPE_S8;
+		break;
+	case DMA_SLAVE_BUSWIDTH_2_BYTES:
+		*es = OMAP_DMA_DATA_TYPE_S16;
+		break;
+	case DMA_SLAVE_BUSWIDTH_4_BYTES:
+		*es = OMAP_DMA_DATA_TYPE_S32;
+		break;
+	default: /* not reached */
+		return -EINVAL;
+	}
+
+	if (!*burst)
+		*burst = 1;
+
+	return 0;
+}
+
+static struct omap_desc *omap_dma_alloc_desc(struct omap_chan *c,
+	unsigned sglen, enum dma_transfer_direction dir, dma_addr_t dev_addr,
+	unsigned es, unsigned long flags)
+{
+	struct omap_desc *d;
+
+	d = kzalloc(sizeof(*d) + sglen * sizeof(d->sg[0]), GFP_ATOMIC);
+	if (!d)
+		return NULL;
+
+	dma_async_tx_descriptor_init(&d->tx, &c->chan);
+	d->tx.tx_submit = omap_dma_tx_submit;
+	d->tx.flags = flags;
+	d->dir = dir;
+	d->dev_addr = dev_addr;
+	d->es = es;
+	d->sync_type = dir == DMA_DEV_TO_MEM ?
+		OMAP_DMA_SRC_SYNC : OMAP_DMA_DST_SYNC;
+	d->periph_port = OMAP_DMA_PORT_TIPB;
+
+	return d;
+}
+
+static struct dma_async_tx_descriptor *omap_dma_prep_slave_sg(
+	struct dma_chan *chan, struct scatterlist *sgl, unsigned sglen,
+	enum dma_transfer_direction dir, unsigned long tx_flags, void *context)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	struct scatterlist *sgent;
+	struct omap_desc *d;
+	struct omap_sg *osg;
+	dma_addr_t dev_addr;
+	unsigned i, es;
+	size_t frame_bytes;
+	u32 burst;
+
+	if (omap_dma_slave_params(c, dir, &dev_addr, &es, &burst))
+		return NULL;
+
+	d = omap_dma_alloc_desc(c, sglen, dir, dev_addr, es, tx_flags);
+	if (!d)
+		return NULL;
+
+	d->sync_mode = OMAP_DMA_SYNC_FRAME;
+
+	/*
+	 * Each frame is one device burst.  Entries which continue where
+	 * the previous one ended are merged into a single segment, which
+	 * saves one interrupt and one channel reprogramming each.
+	 */
+	frame_bytes = es_bytes[es] * burst;
+	osg = NULL;
+	for_each_sg(sgl, sgent, sglen, i) {
+		dma_addr_t addr = sg_dma_address(sgent);
+		u32 fn = sg_dma_len(sgent) / frame_bytes;
+
+		if (sg_dma_len(sgent) % frame_bytes) {
+			dev_err(chan->device->dev,
+				"sg entry %u not a multiple of the burst\n", i);
+			kfree(d);
+			return NULL;
+		}
+
+		if (osg && osg->addr + osg->fn * frame_bytes == addr &&
+		    osg->fn + fn <= 0xffff) {
+			osg->fn += fn;
+			continue;
+		}
+
+		osg = &d->sg[d->sglen++];
+		osg->addr = addr;
+		osg->en = burst;
+		osg->fn = fn;
+	}
+
+	return &d->tx;
+}
+
+static struct dma_async_tx_descriptor *omap_dma_prep_dma_cyclic(
+	struct dma_chan *chan, dma_addr_t buf_addr, size_t buf_len,
+	size_t period_len, enum dma_transfer_direction dir, void *context)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	struct omap_desc *d;
+	dma_addr_t dev_addr;
+	unsigned es;
+	u32 burst;
+
+	if (omap_dma_slave_params(c, dir, &dev_addr, &es, &burst))
+		return NULL;
+
+	if (!period_len || buf_len % period_len ||
+	    period_len % es_bytes[es]) {
+		dev_err(chan->device->dev, "bad cyclic buffer geometry\n");
+		return NULL;
+	}
+
+	d = omap_dma_alloc_desc(c, 1, dir, dev_addr, es, DMA_PREP_INTERRUPT);
+	if (!d)
+		return NULL;
+
+	/* one frame per period, the frame interrupt marks a period */
+	d->sync_mode = OMAP_DMA_SYNC_ELEMENT;
+	d->sglen = 1;
+	d->sg[0].addr = buf_addr;
+	d->sg[0].en = period_len / es_bytes[es];
+	d->sg[0].fn = buf_len / period_len;
+
+	if (!c->cyclic) {
+		c->cyclic = true;
+		omap_dma_link_lch(c->dma_ch, c->dma_ch);
+		omap_enable_dma_irq(c->dma_ch, OMAP_DMA_FRAME_IRQ);
+		omap_disable_dma_irq(c->dma_ch, OMAP_DMA_BLOCK_IRQ);
+	}
+
+	if (!cpu_class_is_omap1()) {
+		omap_set_dma_src_burst_mode(c->dma_ch, OMAP_DMA_DATA_BURST_16);
+		omap_set_dma_dest_burst_mode(c->dma_ch, OMAP_DMA_DATA_BURST_16);
+	}
+
+	return &d->tx;
+}
+
+static int omap_dma_slave_config(struct omap_chan *c,
+	struct dma_slave_config *cfg)
+{
+	if (cfg->src_addr_width == DMA_SLAVE_BUSWIDTH_8_BYTES ||
+	    cfg->dst_addr_width == DMA_SLAVE_BUSWIDTH_8_BYTES)
+		return -EINVAL;
+
+	memcpy(&c->cfg, cfg, sizeof(c->cfg));
+
+	return 0;
+}
+
+static int omap_dma_terminate_all(struct omap_chan *c)
+{
+	unsigned long flags;
+	LIST_HEAD(head);
+
+	spin_lock_irqsave(&c->lock, flags);
+
+	/*
+	 * Stop the running descriptor before unlinking a cyclic channel,
+	 * the legacy code refuses to unlink an active channel.
+	 */
+	if (c->desc) {
+		omap_stop_dma(c->dma_ch);
+		list_add_tail(&c->desc->node, &head);
+		c->desc = NULL;
+	}
+
+	if (c->cyclic) {
+		c->cyclic = false;
+		c->paused = false;
+		c->periods = 0;
+		omap_dma_unlink_lch(c->dma_ch, c->dma_ch);
+		omap_disable_dma_irq(c->dma_ch, OMAP_DMA_FRAME_IRQ);
+		omap_enable_dma_irq(c->dma_ch, OMAP_DMA_BLOCK_IRQ);
+	}
+
+	list_splice_tail_init(&c->desc_submitted, &head);
+	list_splice_tail_init(&c->desc_issued, &head);
+	spin_unlock_irqrestore(&c->lock, flags);
+
+	omap_dma_free_list(&head);
+
+	return 0;
+}
+
+static int omap_dma_pause(struct omap_chan *c)
+{
+	/* pause/resume only make sense for cyclic mode */
+	if (!c->cyclic)
+		return -EINVAL;
+
+	if (!c->paused) {
+		omap_stop_dma(c->dma_ch);
+		c->paused = true;
+	}
+
+	return 0;
+}
+
+static int omap_dma_resume(struct omap_chan *c)
+{
+	if (!c->cyclic)
+		return -EINVAL;
+
+	if (c->paused) {
+		omap_start_dma(c->dma_ch);
+		c->paused = false;
+	}
+
+	return 0;
+}
+
+static int omap_dma_control(struct dma_chan *chan, enum dma_ctrl_cmd cmd,
+	unsigned long arg)
+{
+	struct omap_chan *c = to_omap_dma_chan(chan);
+	int ret;
+
+	switch (cmd) {
+	case DMA_SLAVE_CONFIG:
+		ret = omap_dma_slave_config(c, (struct dma_slave_config *)arg);
+		break;
+
+	case DMA_TERMINATE_ALL:
+		ret = omap_dma_terminate_all(c);
+		break;
+
+	case DMA_PAUSE:
+		ret = omap_dma_pause(c);
+		break;
+
+	case DMA_RESUME:
+		ret = omap_dma_resume(c);
+		break;
+
+	default:
+		ret = -ENXIO;
+		break;
+	}
+
+	return ret;
+}
+
+static int omap_dma_chan_init(struct omap_dmadev *od, unsigned dma_sig)
+{
+	struct omap_chan *c;
+
+	c = kzalloc(sizeof(*c), GFP_KERNEL);
+	if (!c)
+		return -ENOMEM;
+
+	c->dma_sig = dma_sig;
+	c->chan.device = &od->ddev;
+	spin_lock_init(&c->lock);
+	INIT_LIST_HEAD(&c->desc_submitted);
+	INIT_LIST_HEAD(&c->desc_issued);
+	INIT_LIST_HEAD(&c->desc_completed);
+	tasklet_init(&c->task, omap_dma_tasklet, (unsigned long)c);
+	dma_cookie_init(&c->chan);
+
+	list_add_tail(&c->chan.device_node, &od->ddev.channels);
+
+	return 0;
+}
+
+static void omap_dma_free(struct omap_dmadev *od)
+{
+	while (!list_empty(&od->ddev.channels)) {
+		struct omap_chan *c = list_first_entry(&od->ddev.channels,
+			struct omap_chan, chan.device_node);
+
+		list_del(&c->chan.device_node);
+		tasklet_kill(&c->task);
+		kfree(c);
+	}
+	kfree(od);
+}
+
+static int __devinit omap_dma_probe(struct platform_device *pdev)
+{
+	struct omap_dmadev *od;
+	int rc, i;
+
+	od = kzalloc(sizeof(*od), GFP_KERNEL);
+	if (!od)
+		return -ENOMEM;
+
+	dma_cap_set(DMA_SLAVE, od->ddev.cap_mask);
+	dma_cap_set(DMA_CYCLIC, od->ddev.cap_mask);
+	od->ddev.device_alloc_chan_resources = omap_dma_alloc_chan_resources;
+	od->ddev.device_free_chan_resources = omap_dma_free_chan_resources;
+	od->ddev.device_tx_status = omap_dma_tx_status;
+	od->ddev.device_issue_pending = omap_dma_issue_pending;
+	od->ddev.device_prep_slave_sg = omap_dma_prep_slave_sg;
+	od->ddev.device_prep_dma_cyclic = omap_dma_prep_dma_cyclic;
+	od->ddev.device_control = omap_dma_control;
+	od->ddev.dev = &pdev->dev;
+	INIT_LIST_HEAD(&od->ddev.channels);
+
+	for (i = 0; i < OMAP_DMA_NR_SIGNALS; i++) {
+		rc = omap_dma_chan_init(od, i);
+		if (rc) {
+			omap_dma_free(od);
+			return rc;
+		}
+	}
+
+	rc = dma_async_device_register(&od->ddev);
+	if (rc) {
+		pr_warn("OMAP-DMA: failed to register slave DMA engine device: %d\n",
+			rc);
+		omap_dma_free(od);
+		return rc;
+	}
+
+	platform_set_drvdata(pdev, od);
+
+	dev_info(&pdev->dev, "OMAP DMA engine driver\n");
+
+	return 0;
+}
+
+static int __devexit omap_dma_remove(struct platform_device *pdev)
+{
+	struct omap_dmadev *od = platform_get_drvdata(pdev);
+
+	dma_async_device_unregister(&od->ddev);
+	omap_dma_free(od);
+
+	return 0;
+}
+
+static struct platform_driver omap_dma_driver = {
+	.probe	= omap_dma_probe,
+	.remove	= __devexit_p(omap_dma_remove),
+	.driver = {
+		.name = "omap-dma-engine",
+		.owner = THIS_MODULE,
+	},
+};
+
+bool omap_dma_filter_fn(struct dma_chan *chan, void *param)
+{
+	if (chan->device->dev->driver == &omap_dma_driver.driver) {
+		struct omap_chan *c = to_omap_dma_chan(chan);
+		unsigned req = *(unsigned *)param;
+
+		return req == c->dma_sig;
+	}
+	return false;
+}
+EXPORT_SYMBOL_GPL(omap_dma_filter_fn);
+
+static struct platform_device *pdev;
+
+static const struct platform_device_info omap_dma_dev_info = {
+	.name = "omap-dma-engine",
+	.id = -1,
+	.dma_mask = DMA_BIT_MASK(32),
+};
+
+static int omap_dma_init(void)
+{
+	int rc = platform_driver_register(&omap_dma_driver);
+
+	if (rc == 0) {
+		pdev = platform_device_register_full(&omap_dma_dev_info);
+		if (IS_ERR(pdev)) {
+			platform_driver_unregister(&omap_dma_driver);
+			rc = PTR_ERR(pdev);
+		}
+	}
+	return rc;
+}
+subsys_initcall(omap_dma_init);
+
+static void __exit omap_dma_exit(void)
+{
+	platform_device_unregister(pdev);
+	platform_driver_unregister(&omap_dma_driver);
+}
+module_exit(omap_dma_exit);
+
+MODULE_AUTHOR("Texas Instruments, Inc.");
+MODULE_DESCRIPTION("OMAP system DMA engine driver");
+MODULE_LICENSE("GPL");
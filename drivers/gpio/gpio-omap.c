@@ -28,6 +28,9 @@
 #include <linux/gpio.h>
 #include <linux/bitops.h>
 #include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <mach/hardware.h>
 #include <asm/irq.h>
 #include <mach/irqs.h>
@@ -90,6 +93,15 @@ struct gpio_bank {
 	u32 pending_wakeups;
 	u32 wakeup_enabled;
 
+#ifdef CONFIG_DEBUG_FS
+	/* demux statistics, updated by the bank interrupt handler only */
+	unsigned long irq_count[32];
+	unsigned long irq_count_last[32];
+	unsigned long fast_path;
+	unsigned long slow_path;
+	ktime_t stats_stamp;
+#endif
+
 	void (*set_dataout)(struct gpio_bank *bank, int gpio, int enable);
 	int (*get_context_loss_count)(struct device *dev);
 
@@ -659,16 +671,31 @@ static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 {
 	void __iomem *isr_reg = NULL;
 	u32 isr;
-	unsigned int gpio_irq, gpio_index;
+	unsigned int gpio_index;
 	struct gpio_bank *bank;
 	int unmasked = 0;
+	bool fast;
 	struct irq_chip *chip = irq_desc_get_chip(desc);
 
 	chained_irq_enter(chip, desc);
 
 	bank = irq_get_handler_data(irq);
 	isr_reg = bank->base + bank->regs->irqstatus;
-	pm_runtime_get_sync(bank->dev);
+
+	/*
+	 * A bank with requested lines holds a runtime PM reference and, unless
+	 * it went through runtime suspend, is known to be active: there is no
+	 * need to get and put the device on every interrupt then.
+	 */
+	fast = bank->mod_usage && !bank->is_idle;
+	if (!fast)
+		pm_runtime_get_sync(bank->dev);
+#ifdef CONFIG_DEBUG_FS
+	if (fast)
+		bank->fast_path++;
+	else
+		bank->slow_path++;
+#endif
 
 	if (WARN_ON(!isr_reg))
 		goto exit;
@@ -689,20 +716,18 @@ static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 		if (bank->edge_mask)
 			edge_mask = bank->edge_mask & enabled;
 		/*
-		 * For level+edge GPIOs, if module is IDLE, a sWakeup event
-		 * is triggered in which case if irq status is not cleared
-		 * immediately the line is not de-asserted preventing the
-		 * module to IDLE further and resulting it in getting stuck
-		 * in transition when disabled
+		 * Clear edge sensitive interrupts, and the edge part of
+		 * level+edge GPIOs, with a single write before the handlers
+		 * are called so that we don't miss any interrupt occurring
+		 * while they run. For level+edge GPIOs, if module is IDLE, a
+		 * sWakeup event is triggered in which case if irq status is
+		 * not cleared immediately the line is not de-asserted,
+		 * preventing the module to IDLE further and resulting in
+		 * getting stuck in transition when disabled.
 		 */
-		_clear_gpio_irqbank(bank, isr_saved & edge_mask);
-
-		/* clear edge sensitive interrupts before handler(s) are
-		called so that we don't miss any interrupt occurred while
-		executing them */
-		_disable_gpio_irqbank(bank, isr_saved & ~level_mask);
-		_clear_gpio_irqbank(bank, isr_saved & ~level_mask);
-		_enable_gpio_irqbank(bank, isr_saved & ~level_mask);
+		if (isr_saved & (edge_mask | ~level_mask))
+			_clear_gpio_irqbank(bank,
+					isr_saved & (edge_mask | ~level_mask));
 
 		/* if there is only edge sensitive GPIO pin interrupts
 		configured, we could unmask GPIO bank interrupt immediately */
@@ -714,14 +739,9 @@ static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 		if (!isr)
 			break;
 
-		gpio_irq = bank->irq_base;
-		for (; isr != 0; isr >>= 1, gpio_irq++) {
-			int gpio = irq_to_gpio(bank, gpio_irq);
-
-			if (!(isr & 1))
-				continue;
-
-			gpio_index = GPIO_INDEX(bank, gpio);
+		while (isr) {
+			gpio_index = __ffs(isr);
+			isr &= isr - 1;
 
 			/*
 			 * Some chips can't respond to both rising and falling
@@ -733,7 +753,10 @@ static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 			if (bank->toggle_mask & (1 << gpio_index))
 				_toggle_gpio_edge_triggering(bank, gpio_index);
 
-			generic_handle_irq(gpio_irq);
+#ifdef CONFIG_DEBUG_FS
+			bank->irq_count[gpio_index]++;
+#endif
+			generic_handle_irq(bank->irq_base + gpio_index);
 		}
 	}
 	/* if bank has any level sensitive GPIO pin interrupt
@@ -743,7 +766,8 @@ static void gpio_irq_handler(unsigned int irq, struct irq_desc *desc)
 exit:
 	if (!unmasked)
 		chained_irq_exit(chip, desc);
-	pm_runtime_put(bank->dev);
+	if (!fast)
+		pm_runtime_put(bank->dev);
 }
 
 static void gpio_irq_shutdown(struct irq_data *d)
@@ -1806,6 +1830,71 @@ static struct platform_driver omap_gpio_driver = {
  * machine_init functions access gpio APIs.
  * Hence omap_gpio_drv_reg() is a postcore_initcall.
  */
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Per line interrupt counts, with the rate since the previous read of the
+ * file, and how often the demux could skip the runtime PM calls.
+ */
+static int omap_gpio_irq_stats_show(struct seq_file *s, void *unused)
+{
+	struct gpio_bank *bank;
+	unsigned long count, delta;
+	ktime_t now = ktime_get();
+	s64 us;
+	int i;
+
+	list_for_each_entry(bank, &omap_gpio_list, node) {
+		us = ktime_us_delta(now, bank->stats_stamp);
+		bank->stats_stamp = now;
+
+		seq_printf(s, "bank %d: fast %lu slow %lu\n", bank->id,
+			   bank->fast_path, bank->slow_path);
+
+		for (i = 0; i < bank->width; i++) {
+			count = ACCESS_ONCE(bank->irq_count[i]);
+			delta = count - bank->irq_count_last[i];
+			bank->irq_count_last[i] = count;
+			if (!count)
+				continue;
+			seq_printf(s, "  gpio %d: %lu irqs, %llu/s\n",
+				   bank->chip.base + i, count, us > 0 ?
+				   div64_u64((u64)delta * USEC_PER_SEC, us) :
+				   0ULL);
+		}
+	}
+
+	return 0;
+}
+
+static int omap_gpio_irq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_gpio_irq_stats_show, NULL);
+}
+
+static const struct file_operations omap_gpio_irq_stats_fops = {
+	.open		= omap_gpio_irq_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init omap_gpio_debugfs_init(void)
+{
+	struct gpio_bank *bank;
+
+	if (list_empty(&omap_gpio_list))
+		return 0;
+
+	list_for_each_entry(bank, &omap_gpio_list, node)
+		bank->stats_stamp = ktime_get();
+
+	debugfs_create_file("omap_gpio_irq_stats", S_IRUGO, NULL, NULL,
+			    &omap_gpio_irq_stats_fops);
+	return 0;
+}
+late_initcall(omap_gpio_debugfs_init);
+#endif
+
 static int __init omap_gpio_drv_reg(void)
 {
 	return platform_driver_register(&omap_gpio_driver);
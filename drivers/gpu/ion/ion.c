@@ -18,6 +18,8 @@
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/anon_inodes.h>
+#include <linux/hash.h>
+#include <linux/ktime.h>
 #include <linux/ion.h>
 #include <linux/list.h>
 #include <linux/memblock.h>
@@ -33,10 +35,59 @@
 #include <linux/debugfs.h>
 #include <linux/dma-buf.h>
 
+#include <asm/cacheflush.h>
+
 #include "ion_priv.h"
 
 
 
+static void ion_latency_account(struct ion_latency_hist *hist,
+				enum ion_latency_op op, s64 us)
+{
+	int bucket = us > 0 ? min(fls64(us), ION_LATENCY_BUCKETS - 1) : 0;
+
+	atomic_inc(&hist->buckets[op][bucket]);
+}
+
+static void ion_latency_record(struct ion_client *client,
+			       struct ion_heap *heap, enum ion_latency_op op,
+			       ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	if (client)
+		ion_latency_account(&client->latency, op, us);
+	if (heap)
+		ion_latency_account(&heap->latency, op, us);
+}
+
+static void ion_latency_show(struct seq_file *s, struct ion_latency_hist *hist)
+{
+	static const char * const names[ION_LATENCY_NUM_OPS] = {
+		[ION_LATENCY_ALLOC] = "alloc",
+		[ION_LATENCY_FREE] = "free",
+		[ION_LATENCY_MAP_KERNEL] = "map_kernel",
+		[ION_LATENCY_SHARE] = "share",
+	};
+	int op, i;
+
+	seq_printf(s, "latency histogram (usecs, log2 buckets):\n");
+	seq_printf(s, "%12.12s", "<usecs");
+	for (op = 0; op < ION_LATENCY_NUM_OPS; op++)
+		seq_printf(s, " %10.10s", names[op]);
+	seq_printf(s, "\n");
+	for (i = 0; i < ION_LATENCY_BUCKETS; i++) {
+		if (i == ION_LATENCY_BUCKETS - 1)
+			seq_printf(s, "%12s", "inf");
+		else
+			seq_printf(s, "%12u", 1 << i);
+		for (op = 0; op < ION_LATENCY_NUM_OPS; op++)
+			seq_printf(s, " %10d",
+				   atomic_read(&hist->buckets[op][i]));
+		seq_printf(s, "\n");
+	}
+}
+
 bool ion_buffer_fault_user_mappings(struct ion_buffer *buffer)
 {
         return ((buffer->flags & ION_FLAG_CACHED) &&
@@ -75,13 +126,16 @@ static void ion_buffer_add(struct ion_device *dev,
 }
 
 static int ion_buffer_alloc_dirty(struct ion_buffer *buffer);
+static void ion_buffer_mark_dirty(struct ion_buffer *buffer, size_t offset,
+				  size_t len);
 
 /* this function should only be called while dev->lock is held */
 static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 				     struct ion_device *dev,
 				     unsigned long len,
 				     unsigned long align,
-				     unsigned long flags)
+				     unsigned long flags,
+				     bool reclaim)
 {
 	struct ion_buffer *buffer;
 	struct sg_table *table;
@@ -97,6 +151,9 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 	kref_init(&buffer->ref);
 
 	ret = heap->ops->allocate(heap, buffer, len, align, flags);
+	/* memory may still be sitting in the deferred free list, reclaim it */
+	if (ret && reclaim && ion_heap_freelist_drain(heap, 0))
+		ret = heap->ops->allocate(heap, buffer, len, align, flags);
 	if (ret) {
 		kfree(buffer);
 		return ERR_PTR(ret);
@@ -122,7 +179,8 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 			ret = -EINVAL;
 			goto err;
 		}
-
+	}
+	if (ion_buffer_cached(buffer)) {
 		ret = ion_buffer_alloc_dirty(buffer);
 		if (ret)
 			goto err;
@@ -155,23 +213,34 @@ err:
 	return ERR_PTR(ret);
 }
 
-static void ion_buffer_destroy(struct kref *kref)
+void ion_buffer_destroy(struct ion_buffer *buffer)
 {
-	struct ion_buffer *buffer = container_of(kref, struct ion_buffer, ref);
-	struct ion_device *dev = buffer->dev;
-
+	atomic_inc(&buffer->heap->free_seq);
 	if (WARN_ON(buffer->kmap_cnt > 0))
 		buffer->heap->ops->unmap_kernel(buffer->heap, buffer);
 	buffer->heap->ops->unmap_dma(buffer->heap, buffer);
 	buffer->heap->ops->free(buffer);
-	mutex_lock(&dev->buffer_lock);
-	rb_erase(&buffer->node, &dev->buffers);
-	mutex_unlock(&dev->buffer_lock);
 	if (buffer->flags & ION_FLAG_CACHED)
 		kfree(buffer->dirty);
 	kfree(buffer);
 }
 
+static void _ion_buffer_destroy(struct kref *kref)
+{
+	struct ion_buffer *buffer = container_of(kref, struct ion_buffer, ref);
+	struct ion_heap *heap = buffer->heap;
+	struct ion_device *dev = buffer->dev;
+
+	mutex_lock(&dev->buffer_lock);
+	rb_erase(&buffer->node, &dev->buffers);
+	mutex_unlock(&dev->buffer_lock);
+
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+		ion_heap_freelist_add(heap, buffer);
+	else
+		ion_buffer_destroy(buffer);
+}
+
 static void ion_buffer_get(struct ion_buffer *buffer)
 {
 	kref_get(&buffer->ref);
@@ -179,7 +248,7 @@ static void ion_buffer_get(struct ion_buffer *buffer)
 
 static int ion_buffer_put(struct ion_buffer *buffer)
 {
-	return kref_put(&buffer->ref, ion_buffer_destroy);
+	return kref_put(&buffer->ref, _ion_buffer_destroy);
 }
 
 static void ion_buffer_add_to_handle(struct ion_buffer *buffer)
@@ -222,7 +291,9 @@ static struct ion_handle *ion_handle_create(struct ion_client *client,
 	if (!handle)
 		return ERR_PTR(-ENOMEM);
 	kref_init(&handle->ref);
-	rb_init_node(&handle->node);
+	INIT_LIST_HEAD(&handle->node);
+	INIT_HLIST_NODE(&handle->hash_node);
+	INIT_HLIST_NODE(&handle->buffer_node);
 	handle->client = client;
 	ion_buffer_get(buffer);
 	ion_buffer_add_to_handle(buffer);
@@ -236,7 +307,6 @@ static void ion_handle_kmap_put(struct ion_handle *);
 static void ion_handle_destroy(struct kref *kref)
 {
 	struct ion_handle *handle = container_of(kref, struct ion_handle, ref);
-	struct ion_client *client = handle->client;
 	struct ion_buffer *buffer = handle->buffer;
 
 	mutex_lock(&buffer->lock);
@@ -244,8 +314,11 @@ static void ion_handle_destroy(struct kref *kref)
 		ion_handle_kmap_put(handle);
 	mutex_unlock(&buffer->lock);
 
-	if (!RB_EMPTY_NODE(&handle->node))
-		rb_erase(&handle->node, &client->handles);
+	if (!list_empty(&handle->node)) {
+		list_del(&handle->node);
+		hlist_del(&handle->hash_node);
+		hlist_del(&handle->buffer_node);
+	}
 
 	ion_buffer_remove_from_handle(buffer);
 	ion_buffer_put(buffer);
@@ -268,59 +341,179 @@ static int ion_handle_put(struct ion_handle *handle)
 	return kref_put(&handle->ref, ion_handle_destroy);
 }
 
+static struct hlist_head *ion_handle_hash(struct ion_client *client,
+					  struct ion_handle *handle)
+{
+	return &client->handle_hash[hash_ptr(handle, ION_CLIENT_HASH_BITS)];
+}
+
+static struct hlist_head *ion_buffer_hash(struct ion_client *client,
+					  struct ion_buffer *buffer)
+{
+	return &client->buffer_hash[hash_ptr(buffer, ION_CLIENT_HASH_BITS)];
+}
+
 static struct ion_handle *ion_handle_lookup(struct ion_client *client,
 					    struct ion_buffer *buffer)
 {
-	struct rb_node *n;
+	struct ion_handle *handle;
+	struct hlist_node *pos;
 
-	for (n = rb_first(&client->handles); n; n = rb_next(n)) {
-		struct ion_handle *handle = rb_entry(n, struct ion_handle,
-						     node);
+	hlist_for_each_entry(handle, pos, ion_buffer_hash(client, buffer),
+			     buffer_node)
 		if (handle->buffer == buffer)
 			return handle;
-	}
 	return NULL;
 }
 
 static bool ion_handle_validate(struct ion_client *client, struct ion_handle *handle)
 {
-	struct rb_node *n = client->handles.rb_node;
+	struct ion_handle *entry;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(entry, pos, ion_handle_hash(client, handle),
+			     hash_node)
+		if (entry == handle)
+			return true;
+	return false;
+}
+
+static void ion_handle_add(struct ion_client *client, struct ion_handle *handle)
+{
+	if (WARN(ion_handle_validate(client, handle),
+		 "%s: buffer already found.", __func__))
+		return;
+
+	list_add(&handle->node, &client->handles);
+	hlist_add_head(&handle->hash_node, ion_handle_hash(client, handle));
+	hlist_add_head(&handle->buffer_node,
+		       ion_buffer_hash(client, handle->buffer));
+}
+
+/* this function should only be called while dev->lock is held */
+static struct ion_policy *ion_policy_find(struct ion_device *dev,
+					  unsigned int heap_mask)
+{
+	int i;
+
+	for (i = 0; i < dev->nr_policies; i++)
+		if (dev->policies[i].policy.heap_mask == heap_mask)
+			return &dev->policies[i];
+	return NULL;
+}
+
+/* this function should only be called while dev->lock is held */
+static struct ion_heap *ion_heap_find(struct ion_device *dev, int id)
+{
+	struct rb_node *n = dev->heaps.rb_node;
 
 	while (n) {
-		struct ion_handle *handle_node = rb_entry(n, struct ion_handle,
-							  node);
-		if (handle < handle_node)
+		struct ion_heap *heap = rb_entry(n, struct ion_heap, node);
+
+		if (id < heap->id)
 			n = n->rb_left;
-		else if (handle > handle_node)
+		else if (id > heap->id)
 			n = n->rb_right;
 		else
-			return true;
+			return heap;
 	}
-	return false;
+	return NULL;
 }
 
-static void ion_handle_add(struct ion_client *client, struct ion_handle *handle)
+/*
+ * Nothing was returned to the heap since it failed an allocation of at
+ * most this size, so trying it again would only pay for another failure.
+ */
+static bool ion_policy_should_skip(struct ion_policy *policy,
+				   struct ion_heap *heap, size_t len)
 {
-	struct rb_node **p = &client->handles.rb_node;
-	struct rb_node *parent = NULL;
-	struct ion_handle *entry;
+	bool skip;
+
+	if (!(policy->policy.flags & ION_POLICY_FAST_FAIL))
+		return false;
+	spin_lock(&policy->lock);
+	skip = policy->fail_len && len >= policy->fail_len &&
+		policy->fail_seq == atomic_read(&heap->free_seq);
+	spin_unlock(&policy->lock);
+	return skip;
+}
 
-	while (*p) {
-		parent = *p;
-		entry = rb_entry(parent, struct ion_handle, node);
+static void ion_policy_update(struct ion_policy *policy,
+			      struct ion_heap *heap, size_t len, bool failed)
+{
+	unsigned int seq = atomic_read(&heap->free_seq);
+
+	spin_lock(&policy->lock);
+	if (!failed) {
+		if (len >= policy->fail_len)
+			policy->fail_len = 0;
+	} else if (!policy->fail_len || policy->fail_seq != seq ||
+		   len < policy->fail_len) {
+		policy->fail_len = len;
+		policy->fail_seq = seq;
+	}
+	spin_unlock(&policy->lock);
+}
 
-		if (handle < entry)
-			p = &(*p)->rb_left;
-		else if (handle > entry)
-			p = &(*p)->rb_right;
-		else
-			WARN(1, "%s: buffer already found.", __func__);
+static bool ion_client_can_use(struct ion_client *client,
+			       struct ion_heap *heap)
+{
+	return heap && ((1 << heap->type) & client->heap_mask);
+}
+
+/* this function should only be called while dev->lock is held */
+static struct ion_buffer *ion_alloc_with_policy(struct ion_client *client,
+						struct ion_policy *policy,
+						size_t len, size_t align,
+						unsigned int flags)
+{
+	struct ion_device *dev = client->dev;
+	struct ion_heap *heap;
+	struct ion_buffer *buffer = NULL;
+	bool reclaim = policy->policy.flags & ION_POLICY_RECLAIM;
+
+	heap = ion_heap_find(dev, policy->policy.preferred);
+	if (ion_client_can_use(client, heap) &&
+	    !ion_policy_should_skip(policy, heap, len)) {
+		buffer = ion_buffer_create(heap, dev, len, align, flags,
+					   reclaim);
+		ion_policy_update(policy, heap, len, IS_ERR(buffer));
+		if (!IS_ERR(buffer))
+			return buffer;
 	}
 
-	rb_link_node(&handle->node, parent, p);
-	rb_insert_color(&handle->node, &client->handles);
+	if (policy->policy.fallback == ION_POLICY_NO_FALLBACK)
+		return buffer ? buffer : ERR_PTR(-ENOMEM);
+
+	heap = ion_heap_find(dev, policy->policy.fallback);
+	if (!ion_client_can_use(client, heap))
+		return buffer;
+	return ion_buffer_create(heap, dev, len, align, flags, true);
 }
 
+int ion_device_set_policies(struct ion_device *dev,
+			    struct ion_alloc_policy *policies, int nr)
+{
+	struct ion_policy *new;
+	int i;
+
+	new = kcalloc(nr, sizeof(struct ion_policy), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+	for (i = 0; i < nr; i++) {
+		new[i].policy = policies[i];
+		spin_lock_init(&new[i].lock);
+	}
+
+	down_write(&dev->lock);
+	kfree(dev->policies);
+	dev->policies = new;
+	dev->nr_policies = nr;
+	up_write(&dev->lock);
+	return 0;
+}
+EXPORT_SYMBOL(ion_device_set_policies);
+
 struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 			     size_t align, unsigned int heap_mask,
 			     unsigned int flags)
@@ -329,18 +522,27 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 	struct ion_handle *handle;
 	struct ion_device *dev = client->dev;
 	struct ion_buffer *buffer = NULL;
+	struct ion_policy *policy;
+	ktime_t start = ktime_get();
 
 	pr_debug("%s: len %d align %d heap_mask %u flags %x\n", __func__, len,
 		 align, heap_mask, flags);
+	len = PAGE_ALIGN(len);
+
+	down_read(&dev->lock);
+	policy = ion_policy_find(dev, heap_mask);
+	if (policy) {
+		buffer = ion_alloc_with_policy(client, policy, len, align,
+					       flags);
+		up_read(&dev->lock);
+		goto done;
+	}
 	/*
 	 * traverse the list of heaps available in this system in priority
 	 * order.  If the heap type is supported by the client, and matches the
 	 * request of the caller allocate from it.  Repeat until allocate has
 	 * succeeded or all heaps have been tried
 	 */
-	len = PAGE_ALIGN(len);
-
-	down_read(&dev->lock);
 	for (n = rb_first(&dev->heaps); n != NULL; n = rb_next(n)) {
 		struct ion_heap *heap = rb_entry(n, struct ion_heap, node);
 		/* if the client doesn't support this heap type */
@@ -349,12 +551,13 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 		/* if the caller didn't specify this heap type */
 		if (!((1 << heap->id) & heap_mask))
 			continue;
-		buffer = ion_buffer_create(heap, dev, len, align, flags);
+		buffer = ion_buffer_create(heap, dev, len, align, flags, true);
 		if (!IS_ERR_OR_NULL(buffer))
 			break;
 	}
 	up_read(&dev->lock);
 
+done:
 	if (buffer == NULL)
 		return ERR_PTR(-ENODEV);
 
@@ -373,9 +576,10 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 		mutex_lock(&client->lock);
 		ion_handle_add(client, handle);
 		mutex_unlock(&client->lock);
+		ion_latency_record(client, handle->buffer->heap,
+				   ION_LATENCY_ALLOC, start);
 	}
 
-
 	return handle;
 }
 EXPORT_SYMBOL(ion_alloc);
@@ -383,6 +587,8 @@ EXPORT_SYMBOL(ion_alloc);
 void ion_free(struct ion_client *client, struct ion_handle *handle)
 {
 	bool valid_handle;
+	struct ion_heap *heap;
+	ktime_t start = ktime_get();
 
 	BUG_ON(client != handle->client);
 
@@ -394,8 +600,10 @@ void ion_free(struct ion_client *client, struct ion_handle *handle)
 		mutex_unlock(&client->lock);
 		return;
 	}
+	heap = handle->buffer->heap;
 	ion_handle_put(handle);
 	mutex_unlock(&client->lock);
+	ion_latency_record(client, heap, ION_LATENCY_FREE, start);
 }
 EXPORT_SYMBOL(ion_free);
 
@@ -470,6 +678,8 @@ static void ion_handle_kmap_put(struct ion_handle *handle)
 {
 	struct ion_buffer *buffer = handle->buffer;
 
+	/* writes through the kernel mapping can't be tracked per page */
+	ion_buffer_mark_dirty(buffer, 0, buffer->size);
 	handle->kmap_cnt--;
 	if (!handle->kmap_cnt)
 		ion_buffer_kmap_put(buffer);
@@ -479,6 +689,7 @@ void *ion_map_kernel(struct ion_client *client, struct ion_handle *handle)
 {
 	struct ion_buffer *buffer;
 	void *vaddr;
+	ktime_t start = ktime_get();
 
 	mutex_lock(&client->lock);
 	if (!ion_handle_validate(client, handle)) {
@@ -501,6 +712,7 @@ void *ion_map_kernel(struct ion_client *client, struct ion_handle *handle)
 	vaddr = ion_handle_kmap_get(handle);
 	mutex_unlock(&buffer->lock);
 	mutex_unlock(&client->lock);
+	ion_latency_record(client, buffer->heap, ION_LATENCY_MAP_KERNEL, start);
 	return vaddr;
 }
 EXPORT_SYMBOL(ion_map_kernel);
@@ -521,15 +733,13 @@ EXPORT_SYMBOL(ion_unmap_kernel);
 static int ion_debug_client_show(struct seq_file *s, void *unused)
 {
 	struct ion_client *client = s->private;
-	struct rb_node *n;
+	struct ion_handle *handle;
 	size_t sizes[ION_NUM_HEAPS] = {0};
 	const char *names[ION_NUM_HEAPS] = {(char *)0};
 	int i;
 
 	mutex_lock(&client->lock);
-	for (n = rb_first(&client->handles); n; n = rb_next(n)) {
-		struct ion_handle *handle = rb_entry(n, struct ion_handle,
-						     node);
+	list_for_each_entry(handle, &client->handles, node) {
 		enum ion_heap_type type = handle->buffer->heap->type;
 
 		if (!names[type])
@@ -544,6 +754,7 @@ static int ion_debug_client_show(struct seq_file *s, void *unused)
 			continue;
 		seq_printf(s, "%16.16s: %16u\n", names[i], sizes[i]);
 	}
+	ion_latency_show(s, &client->latency);
 	return 0;
 }
 
@@ -570,6 +781,7 @@ struct ion_client *ion_client_create(struct ion_device *dev,
 	struct ion_client *entry;
 	char debug_name[64];
 	pid_t pid;
+	int i;
 
 	get_task_struct(current->group_leader);
 	task_lock(current->group_leader);
@@ -592,7 +804,11 @@ struct ion_client *ion_client_create(struct ion_device *dev,
 	}
 
 	client->dev = dev;
-	client->handles = RB_ROOT;
+	INIT_LIST_HEAD(&client->handles);
+	for (i = 0; i < ION_CLIENT_HASH_SIZE; i++) {
+		INIT_HLIST_HEAD(&client->handle_hash[i]);
+		INIT_HLIST_HEAD(&client->buffer_hash[i]);
+	}
 	mutex_init(&client->lock);
 	client->name = name;
 	client->heap_mask = heap_mask;
@@ -626,14 +842,11 @@ EXPORT_SYMBOL(ion_client_create);
 void ion_client_destroy(struct ion_client *client)
 {
 	struct ion_device *dev = client->dev;
-	struct rb_node *n;
+	struct ion_handle *handle, *tmp;
 
 	pr_debug("%s: %d\n", __func__, __LINE__);
-	while ((n = rb_first(&client->handles))) {
-		struct ion_handle *handle = rb_entry(n, struct ion_handle,
-						     node);
+	list_for_each_entry_safe(handle, tmp, &client->handles, node)
 		ion_handle_destroy(&handle->ref);
-	}
 	down_write(&dev->lock);
 	if (client->task)
 		put_task_struct(client->task);
@@ -687,46 +900,98 @@ static void ion_unmap_dma_buf(struct dma_buf_attachment *attachment,
 
 static int ion_buffer_alloc_dirty(struct ion_buffer *buffer)
 {
-	unsigned long pages = buffer->sg_table->nents;
-	unsigned long length = (pages + BITS_PER_LONG - 1)/BITS_PER_LONG;
+	unsigned long pages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
 
-	buffer->dirty = kzalloc(length * sizeof(unsigned long), GFP_KERNEL);
+	buffer->dirty = kzalloc(BITS_TO_LONGS(pages) * sizeof(unsigned long),
+				GFP_KERNEL);
 	if (!buffer->dirty)
 		return -ENOMEM;
 	return 0;
 }
 
+/* this function should only be called while buffer->lock is held */
+static void ion_buffer_mark_dirty(struct ion_buffer *buffer, size_t offset,
+				  size_t len)
+{
+	unsigned long first, last;
+
+	if (!buffer->dirty || !len || offset >= buffer->size)
+		return;
+	len = min(len, buffer->size - offset);
+	first = offset >> PAGE_SHIFT;
+	last = (offset + len - 1) >> PAGE_SHIFT;
+	bitmap_set(buffer->dirty, first, last - first + 1);
+}
+
+/* cache maintenance on part of a single scatterlist entry */
+static void ion_sync_sg_range(struct scatterlist *sg, size_t offset,
+			      size_t len, enum dma_data_direction dir)
+{
+	struct scatterlist range;
+
+	sg_init_table(&range, 1);
+	sg_set_page(&range, sg_page(sg), len, sg->offset + offset);
+	sg_dma_address(&range) = sg_dma_address(sg) + offset;
+	if (dir == DMA_FROM_DEVICE)
+		dma_sync_sg_for_cpu(NULL, &range, 1, dir);
+	else
+		dma_sync_sg_for_device(NULL, &range, 1, dir);
+}
+
 struct ion_vma_list {
 	struct list_head list;
 	struct vm_area_struct *vma;
 };
 
+/*
+ * Only the pages the cpu dirtied since the last sync, through a faulted
+ * user mapping or a kernel mapping, are cleaned.  Contiguous runs of dirty
+ * pages are synced with a single call.
+ */
 static void ion_buffer_sync_for_device(struct ion_buffer *buffer,
 				       struct device *dev,
 				       enum dma_data_direction dir)
 {
 	struct scatterlist *sg;
+	unsigned long pgoff = 0;
 	int i;
 	struct ion_vma_list *vma_list;
 
 	pr_debug("%s: syncing for device %s\n", __func__,
 		 dev ? dev_name(dev) : "null");
 
-	if (!ion_buffer_fault_user_mappings(buffer))
+	if (!ion_buffer_cached(buffer))
 		return;
 
 	mutex_lock(&buffer->lock);
+	/* the kernel may still be writing through a live mapping */
+	if (buffer->kmap_cnt)
+		ion_buffer_mark_dirty(buffer, 0, buffer->size);
 	for_each_sg(buffer->sg_table->sgl, sg, buffer->sg_table->nents, i) {
-		if (!test_bit(i, buffer->dirty))
-			continue;
-		dma_sync_sg_for_device(dev, sg, 1, dir);
-		clear_bit(i, buffer->dirty);
+		unsigned long end = pgoff +
+			(PAGE_ALIGN(sg_dma_len(sg)) >> PAGE_SHIFT);
+		unsigned long bit, run_end;
+
+		for (bit = find_next_bit(buffer->dirty, end, pgoff); bit < end;
+		     bit = find_next_bit(buffer->dirty, end, run_end)) {
+			size_t offset = (bit - pgoff) << PAGE_SHIFT;
+			size_t len;
+
+			run_end = find_next_zero_bit(buffer->dirty, end, bit);
+			len = min_t(size_t, (run_end - bit) << PAGE_SHIFT,
+				    sg_dma_len(sg) - offset);
+			ion_sync_sg_range(sg, offset, len, dir);
+			bitmap_clear(buffer->dirty, bit, run_end - bit);
+		}
+		pgoff = end;
 	}
-	list_for_each_entry(vma_list, &buffer->vmas, list) {
-		struct vm_area_struct *vma = vma_list->vma;
+	if (ion_buffer_fault_user_mappings(buffer)) {
+		list_for_each_entry(vma_list, &buffer->vmas, list) {
+			struct vm_area_struct *vma = vma_list->vma;
 
-		zap_page_range(vma, vma->vm_start, vma->vm_end - vma->vm_start,
-			       NULL);
+			zap_page_range(vma, vma->vm_start,
+				       vma->vm_end - vma->vm_start, NULL);
+		}
 	}
 	mutex_unlock(&buffer->lock);
 }
@@ -738,7 +1003,7 @@ static int ion_vm_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	int i;
 
 	mutex_lock(&buffer->lock);
-	set_bit(vmf->pgoff, buffer->dirty);
+	ion_buffer_mark_dirty(buffer, vmf->pgoff << PAGE_SHIFT, PAGE_SIZE);
 
 	for_each_sg(buffer->sg_table->sgl, sg, buffer->sg_table->nents, i) {
 		if (i != vmf->pgoff)
@@ -872,6 +1137,8 @@ static void ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf, size_t start,
 	struct ion_buffer *buffer = dmabuf->priv;
 
 	mutex_lock(&buffer->lock);
+	if (direction != DMA_FROM_DEVICE)
+		ion_buffer_mark_dirty(buffer, start, len);
 	ion_buffer_kmap_put(buffer);
 	mutex_unlock(&buffer->lock);
 }
@@ -895,6 +1162,7 @@ int ion_share_dma_buf(struct ion_client *client, struct ion_handle *handle)
 	struct dma_buf *dmabuf;
 	bool valid_handle;
 	int fd;
+	ktime_t start = ktime_get();
 
 	mutex_lock(&client->lock);
 	valid_handle = ion_handle_validate(client, handle);
@@ -914,6 +1182,7 @@ int ion_share_dma_buf(struct ion_client *client, struct ion_handle *handle)
 	fd = dma_buf_fd(dmabuf, O_CLOEXEC);
 	if (fd < 0)
 		dma_buf_put(dmabuf);
+	ion_latency_record(client, buffer->heap, ION_LATENCY_SHARE, start);
 
 	return fd;
 }
@@ -1030,6 +1299,100 @@ static int ion_sync_for_device(struct ion_client *client, int fd)
 	return 0;
 }
 
+static void ion_sync_range(struct ion_buffer *buffer, size_t offset,
+			   size_t length, enum dma_data_direction dir)
+{
+	struct scatterlist *sg;
+	int i;
+
+	for_each_sg(buffer->sg_table->sgl, sg, buffer->sg_table->nents, i) {
+		size_t chunk;
+
+		if (!length)
+			break;
+		/* pages before the range don't need any maintenance */
+		if (offset >= sg_dma_len(sg)) {
+			offset -= sg_dma_len(sg);
+			continue;
+		}
+		chunk = min_t(size_t, length, sg_dma_len(sg) - offset);
+		ion_sync_sg_range(sg, offset, chunk, dir);
+		length -= chunk;
+		offset = 0;
+	}
+}
+
+static void ion_flush_all_cpu_caches(void *unused)
+{
+	flush_cache_all();
+}
+
+static int ion_sync_ranges(struct ion_client *client,
+			   struct ion_sync_range *ranges, unsigned int count)
+{
+	static const enum dma_data_direction dirs[] = {
+		[ION_SYNC_FOR_DEVICE] = DMA_TO_DEVICE,
+		[ION_SYNC_FOR_CPU] = DMA_FROM_DEVICE,
+		[ION_SYNC_BIDIRECTIONAL] = DMA_BIDIRECTIONAL,
+	};
+	struct dma_buf **dmabufs;
+	size_t total = 0;
+	unsigned int i;
+	int ret = 0;
+
+	dmabufs = kcalloc(count, sizeof(struct dma_buf *), GFP_KERNEL);
+	if (!dmabufs)
+		return -ENOMEM;
+
+	/* validate everything before touching any cache */
+	for (i = 0; i < count; i++) {
+		struct ion_sync_range *range = &ranges[i];
+		struct ion_buffer *buffer;
+
+		if (range->dir >= ARRAY_SIZE(dirs)) {
+			ret = -EINVAL;
+			goto out;
+		}
+		dmabufs[i] = dma_buf_get(range->fd);
+		if (IS_ERR_OR_NULL(dmabufs[i])) {
+			ret = dmabufs[i] ? PTR_ERR(dmabufs[i]) : -EBADF;
+			dmabufs[i] = NULL;
+			goto out;
+		}
+		if (dmabufs[i]->ops != &dma_buf_ops) {
+			pr_err("%s: can not sync dmabuf from another exporter\n",
+			       __func__);
+			ret = -EINVAL;
+			goto out;
+		}
+		buffer = dmabufs[i]->priv;
+		if (range->offset > buffer->size ||
+		    range->length > buffer->size - range->offset) {
+			ret = -EINVAL;
+			goto out;
+		}
+		total += range->length;
+	}
+
+	if (total > FULL_CACHE_FLUSH_THRESHOLD) {
+		on_each_cpu(ion_flush_all_cpu_caches, NULL, 1);
+		outer_flush_all();
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct ion_buffer *buffer = dmabufs[i]->priv;
+
+		ion_sync_range(buffer, ranges[i].offset, ranges[i].length,
+			       dirs[ranges[i].dir]);
+	}
+out:
+	for (i = 0; i < count && dmabufs[i]; i++)
+		dma_buf_put(dmabufs[i]);
+	kfree(dmabufs);
+	return ret;
+}
+
 static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	struct ion_client *client = filp->private_data;
@@ -1118,6 +1481,30 @@ static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		ion_sync_for_device(client, data.fd);
 		break;
 	}
+	case ION_IOC_SYNC_RANGES:
+	{
+		struct ion_sync_ranges_data data;
+		struct ion_sync_range *ranges;
+		int ret;
+
+		if (copy_from_user(&data, (void __user *)arg, sizeof(data)))
+			return -EFAULT;
+		if (!data.count || data.count > ION_SYNC_RANGES_MAX)
+			return -EINVAL;
+		ranges = kmalloc(data.count * sizeof(*ranges), GFP_KERNEL);
+		if (!ranges)
+			return -ENOMEM;
+		if (copy_from_user(ranges, (void __user *)data.ranges,
+				   data.count * sizeof(*ranges))) {
+			kfree(ranges);
+			return -EFAULT;
+		}
+		ret = ion_sync_ranges(client, ranges, data.count);
+		kfree(ranges);
+		if (ret)
+			return ret;
+		break;
+	}
 	case ION_IOC_CUSTOM:
 	{
 		struct ion_device *dev = client->dev;
@@ -1221,13 +1608,10 @@ static size_t ion_debug_heap_total(struct ion_client *client,
 				   enum ion_heap_type type)
 {
 	size_t size = 0;
-	struct rb_node *n;
+	struct ion_handle *handle;
 
 	mutex_lock(&client->lock);
-	for (n = rb_first(&client->handles); n; n = rb_next(n)) {
-		struct ion_handle *handle = rb_entry(n,
-						     struct ion_handle,
-						     node);
+	list_for_each_entry(handle, &client->handles, node) {
 		if (handle->buffer->heap->type == type)
 			size += handle->buffer->size;
 	}
@@ -1284,6 +1668,11 @@ static int ion_debug_heap_show(struct seq_file *s, void *unused)
 	seq_printf(s, "%16.s %16u\n", "total orphaned",
 		   total_orphaned_size);
 	seq_printf(s, "%16.s %16u\n", "total ", total_size);
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+		seq_printf(s, "%16.s %16u\n", "deferred free",
+			   ion_heap_freelist_size(heap));
+	seq_printf(s, "----------------------------------------------------\n");
+	ion_latency_show(s, &heap->latency);
 	seq_printf(s, "----------------------------------------------------\n");
 
 	if (heap->debug_show)
@@ -1332,6 +1721,9 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap)
 		}
 	}
 
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+		ion_heap_init_deferred_free(heap);
+
 	rb_link_node(&heap->node, parent, p);
 	rb_insert_color(&heap->node, &dev->heaps);
 	debugfs_create_file(heap->name, 0664, dev->debug_root, heap,
@@ -1379,6 +1771,7 @@ void ion_device_destroy(struct ion_device *dev)
 {
 	misc_deregister(&dev->dev);
 	/* XXX need to free the heaps and clients ? */
+	kfree(dev->policies);
 	kfree(dev);
 }
 
@@ -15,12 +15,14 @@
  */
 #include <linux/spinlock.h>
 
+#include <linux/bitmap.h>
 #include <linux/err.h>
 #include <linux/genalloc.h>
 #include <linux/io.h>
 #include <linux/ion.h>
 #include <linux/mm.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include "ion_priv.h"
@@ -28,22 +30,145 @@
 #include <asm/mach/map.h>
 #include <asm/cacheflush.h>
 
+/*
+ * Allocations in a size class heap are aligned to their size rounded up to
+ * a power of two, capped at this order, so that freeing neighbours
+ * naturally coalesces into larger aligned extents as with a buddy
+ * allocator.
+ */
+#define ION_CARVEOUT_MAX_ALIGN_ORDER	8
+
+/**
+ * struct ion_carveout_heap - a heap backed by a reserved physical range
+ * @heap:		the ion heap
+ * @pool:		first fit allocator, unused for size class heaps
+ * @base:		physical start of the range
+ * @bitmap:		one bit per page, set when allocated, size class heaps
+ * @nr_pages:		number of pages in the range
+ * @lock:		protects @bitmap
+ * @frag_failures:	failed allocations that would have fit in the total
+ *			free space, ie failed because of fragmentation
+ */
 struct ion_carveout_heap {
 	struct ion_heap heap;
 	struct gen_pool *pool;
 	ion_phys_addr_t base;
+	unsigned long *bitmap;
+	unsigned long nr_pages;
+	spinlock_t lock;
+	atomic_t frag_failures;
+};
+
+/**
+ * struct ion_carveout_frag - free space summary of a carveout
+ * @free:		number of free pages
+ * @largest:		number of pages of the largest free extent
+ * @extents:		number of free extents
+ */
+struct ion_carveout_frag {
+	unsigned long free;
+	unsigned long largest;
+	unsigned long extents;
 };
 
+static void ion_carveout_frag_scan(unsigned long *map, unsigned long size,
+				   struct ion_carveout_frag *frag)
+{
+	unsigned long start = find_first_zero_bit(map, size);
+
+	while (start < size) {
+		unsigned long end = find_next_bit(map, size, start);
+
+		frag->free += end - start;
+		frag->largest = max(frag->largest, end - start);
+		frag->extents++;
+		start = find_next_zero_bit(map, size, end);
+	}
+}
+
+static void ion_carveout_frag_chunk(struct gen_pool *pool,
+				    struct gen_pool_chunk *chunk, void *data)
+{
+	unsigned long size = (chunk->end_addr - chunk->start_addr) >>
+			     pool->min_alloc_order;
+
+	ion_carveout_frag_scan(chunk->bits, size, data);
+}
+
+static void ion_carveout_frag_get(struct ion_carveout_heap *carveout_heap,
+				  struct ion_carveout_frag *frag)
+{
+	memset(frag, 0, sizeof(*frag));
+	if (carveout_heap->bitmap) {
+		spin_lock(&carveout_heap->lock);
+		ion_carveout_frag_scan(carveout_heap->bitmap,
+				       carveout_heap->nr_pages, frag);
+		spin_unlock(&carveout_heap->lock);
+	} else {
+		/* the pool's min_alloc_order is PAGE_SHIFT */
+		gen_pool_for_each_chunk(carveout_heap->pool,
+					ion_carveout_frag_chunk, frag);
+	}
+}
+
+static unsigned long ion_carveout_size_class_alloc(
+				struct ion_carveout_heap *carveout_heap,
+				unsigned long size, unsigned long align)
+{
+	unsigned long nr = PAGE_ALIGN(size) >> PAGE_SHIFT;
+	unsigned int order = max(get_order(size), get_order(align));
+	unsigned long pos;
+
+	order = min_t(unsigned int, order, ION_CARVEOUT_MAX_ALIGN_ORDER);
+
+	spin_lock(&carveout_heap->lock);
+	pos = bitmap_find_next_zero_area(carveout_heap->bitmap,
+					 carveout_heap->nr_pages, 0, nr,
+					 (1UL << order) - 1);
+	if (pos >= carveout_heap->nr_pages) {
+		spin_unlock(&carveout_heap->lock);
+		return 0;
+	}
+	bitmap_set(carveout_heap->bitmap, pos, nr);
+	spin_unlock(&carveout_heap->lock);
+
+	return carveout_heap->base + (pos << PAGE_SHIFT);
+}
+
+static void ion_carveout_size_class_free(
+				struct ion_carveout_heap *carveout_heap,
+				ion_phys_addr_t addr, unsigned long size)
+{
+	unsigned long pos = (addr - carveout_heap->base) >> PAGE_SHIFT;
+
+	spin_lock(&carveout_heap->lock);
+	bitmap_clear(carveout_heap->bitmap, pos,
+		     PAGE_ALIGN(size) >> PAGE_SHIFT);
+	spin_unlock(&carveout_heap->lock);
+}
+
 ion_phys_addr_t ion_carveout_allocate(struct ion_heap *heap,
 				      unsigned long size,
 				      unsigned long align)
 {
 	struct ion_carveout_heap *carveout_heap =
 		container_of(heap, struct ion_carveout_heap, heap);
-	unsigned long offset = gen_pool_alloc(carveout_heap->pool, size);
+	unsigned long offset;
+
+	if (carveout_heap->bitmap)
+		offset = ion_carveout_size_class_alloc(carveout_heap, size,
+						       align);
+	else
+		offset = gen_pool_alloc(carveout_heap->pool, size);
+
+	if (!offset) {
+		struct ion_carveout_frag frag;
 
-	if (!offset)
+		ion_carveout_frag_get(carveout_heap, &frag);
+		if ((frag.free << PAGE_SHIFT) >= size)
+			atomic_inc(&carveout_heap->frag_failures);
 		return ION_CARVEOUT_ALLOCATE_FAIL;
+	}
 
 	return offset;
 }
@@ -56,7 +181,32 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
 
 	if (addr == ION_CARVEOUT_ALLOCATE_FAIL)
 		return;
-	gen_pool_free(carveout_heap->pool, addr, size);
+	if (carveout_heap->bitmap)
+		ion_carveout_size_class_free(carveout_heap, addr, size);
+	else
+		gen_pool_free(carveout_heap->pool, addr, size);
+}
+
+static int ion_carveout_heap_debug_show(struct ion_heap *heap,
+					struct seq_file *s, void *unused)
+{
+	struct ion_carveout_heap *carveout_heap =
+		container_of(heap, struct ion_carveout_heap, heap);
+	struct ion_carveout_frag frag;
+
+	ion_carveout_frag_get(carveout_heap, &frag);
+	seq_printf(s, "allocator: %s\n",
+		   carveout_heap->bitmap ? "size class" : "first fit");
+	seq_printf(s, "free: %lu bytes in %lu extents\n",
+		   frag.free << PAGE_SHIFT, frag.extents);
+	seq_printf(s, "largest free extent: %lu bytes\n",
+		   frag.largest << PAGE_SHIFT);
+	/* 0 when all free memory is one extent, approaching 100 when shredded */
+	seq_printf(s, "fragmentation: %lu%%\n", frag.free ?
+		   100 - frag.largest * 100 / frag.free : 0);
+	seq_printf(s, "failures due to fragmentation: %d\n",
+		   atomic_read(&carveout_heap->frag_failures));
+	return 0;
 }
 
 static int ion_carveout_heap_phys(struct ion_heap *heap,
@@ -218,16 +368,29 @@ struct ion_heap *ion_carveout_heap_create(struct ion_platform_heap *heap_data)
 	if (!carveout_heap)
 		return ERR_PTR(-ENOMEM);
 
-	carveout_heap->pool = gen_pool_create(12, -1);
-	if (!carveout_heap->pool) {
-		kfree(carveout_heap);
-		return ERR_PTR(-ENOMEM);
-	}
 	carveout_heap->base = heap_data->base;
-	gen_pool_add(carveout_heap->pool, carveout_heap->base, heap_data->size,
-		     -1);
+	carveout_heap->nr_pages = heap_data->size >> PAGE_SHIFT;
+	spin_lock_init(&carveout_heap->lock);
+	if (heap_data->flags & ION_HEAP_FLAG_SIZE_CLASS) {
+		carveout_heap->bitmap = kzalloc(
+				BITS_TO_LONGS(carveout_heap->nr_pages) *
+				sizeof(unsigned long), GFP_KERNEL);
+		if (!carveout_heap->bitmap) {
+			kfree(carveout_heap);
+			return ERR_PTR(-ENOMEM);
+		}
+	} else {
+		carveout_heap->pool = gen_pool_create(PAGE_SHIFT, -1);
+		if (!carveout_heap->pool) {
+			kfree(carveout_heap);
+			return ERR_PTR(-ENOMEM);
+		}
+		gen_pool_add(carveout_heap->pool, carveout_heap->base,
+			     heap_data->size, -1);
+	}
 	carveout_heap->heap.ops = &carveout_heap_ops;
 	carveout_heap->heap.type = ION_HEAP_TYPE_CARVEOUT;
+	carveout_heap->heap.debug_show = ion_carveout_heap_debug_show;
 
 	return &carveout_heap->heap;
 }
@@ -237,7 +400,9 @@ void ion_carveout_heap_destroy(struct ion_heap *heap)
 	struct ion_carveout_heap *carveout_heap =
 	     container_of(heap, struct  ion_carveout_heap, heap);
 
-	gen_pool_destroy(carveout_heap->pool);
+	if (carveout_heap->pool)
+		gen_pool_destroy(carveout_heap->pool);
+	kfree(carveout_heap->bitmap);
 	kfree(carveout_heap);
 	carveout_heap = NULL;
 }
@@ -0,0 +1,259 @@
+/*
+ * drivers/gpu/ion/ion_cma_heap.c
+ *
+ * Copyright (C) 2011 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/device.h>
+#include <linux/dma-contiguous.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/highmem.h>
+#include <linux/ion.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
+#include "ion_priv.h"
+
+/*
+ * A contiguous heap carved out of a CMA area instead of a memblock_remove'd
+ * range: while no buffer uses them, the pages of the area serve movable
+ * allocations of the rest of the system, and are migrated away when ion
+ * needs them back.  That migration is what makes an allocation slow, so
+ * its latency is accounted and shown in the heap's debug file.
+ */
+
+/**
+ * struct ion_cma_heap - a heap backed by a CMA area
+ * @heap:		the ion heap
+ * @dev:		device owning the CMA area, the default area if it has
+ *			none of its own
+ * @lock:		protects the statistics below
+ * @allocs:		number of successful allocations
+ * @failures:		number of failed allocations
+ * @alloc_ns:		total time spent in successful allocations
+ * @alloc_max_ns:	longest successful allocation
+ * @allocated:		bytes currently allocated
+ */
+struct ion_cma_heap {
+	struct ion_heap heap;
+	struct device *dev;
+	spinlock_t lock;
+	unsigned long allocs;
+	unsigned long failures;
+	u64 alloc_ns;
+	u64 alloc_max_ns;
+	size_t allocated;
+};
+
+static int ion_cma_heap_allocate(struct ion_heap *heap,
+				 struct ion_buffer *buffer,
+				 unsigned long size, unsigned long align,
+				 unsigned long flags)
+{
+	struct ion_cma_heap *cma_heap =
+		container_of(heap, struct ion_cma_heap, heap);
+	int count = PAGE_ALIGN(size) >> PAGE_SHIFT;
+	unsigned int order = get_order(max_t(unsigned long, align, PAGE_SIZE));
+	struct page *page;
+	ktime_t start;
+	s64 delta;
+	int i;
+
+	start = ktime_get();
+	page = dma_alloc_from_contiguous(cma_heap->dev, count, order);
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&cma_heap->lock);
+	if (!page) {
+		cma_heap->failures++;
+		spin_unlock(&cma_heap->lock);
+		return -ENOMEM;
+	}
+	cma_heap->allocs++;
+	cma_heap->alloc_ns += delta;
+	cma_heap->alloc_max_ns = max_t(u64, cma_heap->alloc_max_ns, delta);
+	cma_heap->allocated += count << PAGE_SHIFT;
+	spin_unlock(&cma_heap->lock);
+
+	/* the pages held other users' data until they were migrated */
+	for (i = 0; i < count; i++)
+		clear_highpage(page + i);
+	__dma_page_cpu_to_dev(page, 0, count << PAGE_SHIFT, DMA_BIDIRECTIONAL);
+
+	buffer->priv_phys = page_to_phys(page);
+	return 0;
+}
+
+static void ion_cma_heap_free(struct ion_buffer *buffer)
+{
+	struct ion_cma_heap *cma_heap =
+		container_of(buffer->heap, struct ion_cma_heap, heap);
+	int count = PAGE_ALIGN(buffer->size) >> PAGE_SHIFT;
+	struct page *page = pfn_to_page(PFN_DOWN(buffer->priv_phys));
+
+	dma_release_from_contiguous(cma_heap->dev, page, count);
+
+	spin_lock(&cma_heap->lock);
+	cma_heap->allocated -= count << PAGE_SHIFT;
+	spin_unlock(&cma_heap->lock);
+}
+
+static int ion_cma_heap_phys(struct ion_heap *heap,
+			     struct ion_buffer *buffer,
+			     ion_phys_addr_t *addr, size_t *len)
+{
+	*addr = buffer->priv_phys;
+	*len = buffer->size;
+	return 0;
+}
+
+static struct sg_table *ion_cma_heap_map_dma(struct ion_heap *heap,
+					     struct ion_buffer *buffer)
+{
+	struct sg_table *table;
+	int ret;
+
+	table = kzalloc(sizeof(struct sg_table), GFP_KERNEL);
+	if (!table)
+		return ERR_PTR(-ENOMEM);
+
+	ret = sg_alloc_table(table, 1, GFP_KERNEL);
+	if (ret) {
+		kfree(table);
+		return ERR_PTR(ret);
+	}
+	sg_set_page(table->sgl, pfn_to_page(PFN_DOWN(buffer->priv_phys)),
+		    PAGE_ALIGN(buffer->size), 0);
+
+	return table;
+}
+
+static void ion_cma_heap_unmap_dma(struct ion_heap *heap,
+				   struct ion_buffer *buffer)
+{
+	if (buffer->sg_table) {
+		sg_free_table(buffer->sg_table);
+		kfree(buffer->sg_table);
+	}
+}
+
+static void *ion_cma_heap_map_kernel(struct ion_heap *heap,
+				     struct ion_buffer *buffer)
+{
+	int npages = PAGE_ALIGN(buffer->size) >> PAGE_SHIFT;
+	struct page *page = pfn_to_page(PFN_DOWN(buffer->priv_phys));
+	struct page **pages;
+	pgprot_t pgprot;
+	void *vaddr;
+	int i;
+
+	pages = vmalloc(sizeof(struct page *) * npages);
+	if (!pages)
+		return NULL;
+
+	if (buffer->flags & ION_FLAG_CACHED)
+		pgprot = PAGE_KERNEL;
+	else
+		pgprot = pgprot_writecombine(PAGE_KERNEL);
+
+	for (i = 0; i < npages; i++)
+		pages[i] = page + i;
+	vaddr = vmap(pages, npages, VM_MAP, pgprot);
+	vfree(pages);
+
+	return vaddr;
+}
+
+static void ion_cma_heap_unmap_kernel(struct ion_heap *heap,
+				      struct ion_buffer *buffer)
+{
+	vunmap(buffer->vaddr);
+}
+
+static int ion_cma_heap_map_user(struct ion_heap *heap,
+				 struct ion_buffer *buffer,
+				 struct vm_area_struct *vma)
+{
+	return remap_pfn_range(vma, vma->vm_start,
+			       __phys_to_pfn(buffer->priv_phys) + vma->vm_pgoff,
+			       vma->vm_end - vma->vm_start,
+			       vma->vm_page_prot);
+}
+
+static struct ion_heap_ops cma_heap_ops = {
+	.allocate = ion_cma_heap_allocate,
+	.free = ion_cma_heap_free,
+	.phys = ion_cma_heap_phys,
+	.map_dma = ion_cma_heap_map_dma,
+	.unmap_dma = ion_cma_heap_unmap_dma,
+	.map_kernel = ion_cma_heap_map_kernel,
+	.unmap_kernel = ion_cma_heap_unmap_kernel,
+	.map_user = ion_cma_heap_map_user,
+};
+
+static int ion_cma_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
+				   void *unused)
+{
+	struct ion_cma_heap *cma_heap =
+		container_of(heap, struct ion_cma_heap, heap);
+	unsigned long allocs, failures;
+	u64 alloc_ns, alloc_max_ns;
+	size_t allocated;
+
+	spin_lock(&cma_heap->lock);
+	allocs = cma_heap->allocs;
+	failures = cma_heap->failures;
+	alloc_ns = cma_heap->alloc_ns;
+	alloc_max_ns = cma_heap->alloc_max_ns;
+	allocated = cma_heap->allocated;
+	spin_unlock(&cma_heap->lock);
+
+	if (allocs)
+		do_div(alloc_ns, allocs);
+	seq_printf(s, "allocated: %zu bytes\n", allocated);
+	seq_printf(s, "allocations: %lu, failed: %lu\n", allocs, failures);
+	seq_printf(s, "allocation latency: avg %llu us, max %llu us\n",
+		   div_u64(alloc_ns, NSEC_PER_USEC),
+		   div_u64(alloc_max_ns, NSEC_PER_USEC));
+	return 0;
+}
+
+struct ion_heap *ion_cma_heap_create(struct ion_platform_heap *heap_data)
+{
+	struct ion_cma_heap *cma_heap;
+
+	cma_heap = kzalloc(sizeof(struct ion_cma_heap), GFP_KERNEL);
+	if (!cma_heap)
+		return ERR_PTR(-ENOMEM);
+
+	cma_heap->dev = heap_data->priv;
+	spin_lock_init(&cma_heap->lock);
+	cma_heap->heap.ops = &cma_heap_ops;
+	cma_heap->heap.type = ION_HEAP_TYPE_CMA;
+	cma_heap->heap.debug_show = ion_cma_heap_debug_show;
+
+	return &cma_heap->heap;
+}
+
+void ion_cma_heap_destroy(struct ion_heap *heap)
+{
+	struct ion_cma_heap *cma_heap =
+		container_of(heap, struct ion_cma_heap, heap);
+
+	kfree(cma_heap);
+}
@@ -20,6 +20,7 @@
 #include <linux/fs.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <linux/slab.h>
 #include <linux/shrinker.h>
 #include "ion_priv.h"
@@ -29,11 +30,6 @@
 static struct plist_head pools = PLIST_HEAD_INIT(pools);
 static struct shrinker shrinker;
 
-struct ion_page_pool_item {
-	struct page *page;
-	struct list_head list;
-};
-
 static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
 {
 	struct page *page = alloc_pages(pool->gfp_mask, pool->order);
@@ -54,76 +50,180 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+/*
+ * Pages sitting in the pool are not owned by anyone else, so page->lru is
+ * free to be used to link them onto the pool lists.  This avoids having to
+ * allocate a side structure for every page that is returned to the pool.
+ */
+static void ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 {
-	struct ion_page_pool_item *item;
-
-	item = kmalloc(sizeof(struct ion_page_pool_item), GFP_KERNEL);
-	if (!item)
-		return -ENOMEM;
+	unsigned long flags;
 
-	mutex_lock(&pool->mutex);
-	item->page = page;
+	spin_lock_irqsave(&pool->lock, flags);
 	if (PageHighMem(page)) {
-		list_add_tail(&item->list, &pool->high_items);
+		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
 	} else {
-		list_add_tail(&item->list, &pool->low_items);
+		list_add_tail(&page->lru, &pool->low_items);
 		pool->low_count++;
 	}
-	mutex_unlock(&pool->mutex);
-	return 0;
+	spin_unlock_irqrestore(&pool->lock, flags);
 }
 
+/* this function should only be called while pool->lock is held */
 static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 {
-	struct ion_page_pool_item *item;
 	struct page *page;
 
 	if (high) {
 		BUG_ON(!pool->high_count);
-		item = list_first_entry(&pool->high_items,
-					struct ion_page_pool_item, list);
+		page = list_first_entry(&pool->high_items, struct page, lru);
 		pool->high_count--;
 	} else {
 		BUG_ON(!pool->low_count);
-		item = list_first_entry(&pool->low_items,
-					struct ion_page_pool_item, list);
+		page = list_first_entry(&pool->low_items, struct page, lru);
 		pool->low_count--;
 	}
 
-	list_del(&item->list);
-	page = item->page;
-	kfree(item);
+	list_del(&page->lru);
 	return page;
 }
 
-void *ion_page_pool_alloc(struct ion_page_pool *pool)
+/*
+ * The per-cpu caches are only ever touched by their own cpu with interrupts
+ * disabled, which keeps them coherent against ion_page_pool_drain_cpu()
+ * being run from an IPI.  No lock is taken and no cache lines are shared
+ * between cpus on this path.
+ */
+static struct page *ion_page_pool_cache_get(struct ion_page_pool *pool)
 {
+	struct ion_page_pool_cache *cache;
 	struct page *page = NULL;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(pool->cache);
+	if (cache->count)
+		page = cache->pages[--cache->count];
+	local_irq_restore(flags);
+	return page;
+}
+
+static bool ion_page_pool_cache_put(struct ion_page_pool *pool,
+				    struct page *page)
+{
+	struct ion_page_pool_cache *cache;
+	bool cached = false;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(pool->cache);
+	if (cache->count < ION_PAGE_POOL_CACHE_SIZE) {
+		cache->pages[cache->count++] = page;
+		cached = true;
+	}
+	local_irq_restore(flags);
+	return cached;
+}
+
+/* runs on the cpu owning the cache, with interrupts disabled */
+static void ion_page_pool_drain_cpu(void *data)
+{
+	struct ion_page_pool *pool = data;
+	struct ion_page_pool_cache *cache = this_cpu_ptr(pool->cache);
+
+	while (cache->count)
+		ion_page_pool_add(pool, cache->pages[--cache->count]);
+}
+
+static void ion_page_pool_drain(struct ion_page_pool *pool)
+{
+	on_each_cpu(ion_page_pool_drain_cpu, pool, 1);
+}
+
+/**
+ * ion_page_pool_cache_count - number of items held in the per-cpu caches
+ * @pool:		the pool
+ *
+ * The result is only a snapshot, the caches are not locked while reading.
+ */
+int ion_page_pool_cache_count(struct ion_page_pool *pool)
+{
+	int cpu, count = 0;
+
+	for_each_possible_cpu(cpu)
+		count += per_cpu_ptr(pool->cache, cpu)->count;
+	return count;
+}
+
+/**
+ * ion_page_pool_count - number of items currently held by the pool
+ * @pool:		the pool
+ *
+ * Includes the items parked in the per-cpu caches.
+ */
+int ion_page_pool_count(struct ion_page_pool *pool)
+{
+	return pool->high_count + pool->low_count +
+		ion_page_pool_cache_count(pool);
+}
+
+/**
+ * ion_page_pool_fill - grow the pool by one freshly allocated item
+ * @pool:		the pool
+ *
+ * The new item is zeroed and clean for dma before it is added.  This is
+ * meant for background refill so it will not retry or warn when memory is
+ * tight, it returns -ENOMEM instead and the caller should back off.
+ */
+int ion_page_pool_fill(struct ion_page_pool *pool)
+{
+	struct page *page;
+
+	page = alloc_pages(pool->gfp_mask | __GFP_NORETRY | __GFP_NOWARN,
+			   pool->order);
+	if (!page)
+		return -ENOMEM;
+	__dma_page_cpu_to_dev(page, 0, PAGE_SIZE << pool->order,
+			      DMA_BIDIRECTIONAL);
+	ion_page_pool_add(pool, page);
+	return 0;
+}
+
+void *ion_page_pool_alloc(struct ion_page_pool *pool)
+{
+	struct page *page;
+	unsigned long flags;
 
 	BUG_ON(!pool);
 
-	mutex_lock(&pool->mutex);
+	page = ion_page_pool_cache_get(pool);
+	if (page) {
+		atomic_inc(&pool->hits);
+		return page;
+	}
+
+	spin_lock_irqsave(&pool->lock, flags);
 	if (pool->high_count)
 		page = ion_page_pool_remove(pool, true);
 	else if (pool->low_count)
 		page = ion_page_pool_remove(pool, false);
-	mutex_unlock(&pool->mutex);
+	spin_unlock_irqrestore(&pool->lock, flags);
 
-	if (!page)
-		page = ion_page_pool_alloc_pages(pool);
+	if (page) {
+		atomic_inc(&pool->hits);
+		return page;
+	}
 
-	return page;
+	atomic_inc(&pool->misses);
+	return ion_page_pool_alloc_pages(pool);
 }
 
 void ion_page_pool_free(struct ion_page_pool *pool, struct page* page)
 {
-	int ret;
-
-	ret = ion_page_pool_add(pool, page);
-	if (ret)
-		ion_page_pool_free_pages(pool, page);
+	if (ion_page_pool_cache_put(pool, page))
+		return;
+	ion_page_pool_add(pool, page);
 }
 
 #ifdef DEBUG_PAGE_POOL_SHRINKER
@@ -194,42 +294,58 @@ static int ion_page_pool_total(bool high)
 	return total;
 }
 
+static int ion_page_pool_total_cached(void)
+{
+	struct ion_page_pool *pool;
+	int total = 0;
+
+	plist_for_each_entry(pool, &pools, list)
+		total += ion_page_pool_cache_count(pool) * (1 << pool->order);
+	return total;
+}
+
 static int ion_page_pool_shrink(struct shrinker *shrinker,
 				 struct shrink_control *sc)
 {
 	struct ion_page_pool *pool;
 	int nr_freed = 0;
 	int i;
-	bool high;
+	bool high = false;
 	int nr_to_scan = sc->nr_to_scan;
+	unsigned long flags;
 
 	if (sc->gfp_mask & __GFP_HIGHMEM)
 		high = true;
 
 	if (nr_to_scan == 0)
-		return ion_page_pool_total(high);
+		return ion_page_pool_total(high) +
+			ion_page_pool_total_cached();
 
 	plist_for_each_entry(pool, &pools, list) {
+		/* pages parked in the per-cpu caches are reclaimable too */
+		if (ion_page_pool_cache_count(pool))
+			ion_page_pool_drain(pool);
+
 		for (i = 0; i < nr_to_scan; i++) {
 			struct page *page;
 
-			mutex_lock(&pool->mutex);
+			spin_lock_irqsave(&pool->lock, flags);
 			if (high && pool->high_count) {
 				page = ion_page_pool_remove(pool, true);
 			} else if (pool->low_count) {
 				page = ion_page_pool_remove(pool, false);
 			} else {
-				mutex_unlock(&pool->mutex);
+				spin_unlock_irqrestore(&pool->lock, flags);
 				break;
 			}
-			mutex_unlock(&pool->mutex);
+			spin_unlock_irqrestore(&pool->lock, flags);
 			ion_page_pool_free_pages(pool, page);
 			nr_freed += (1 << pool->order);
 		}
 		nr_to_scan -= i;
 	}
 
-	return ion_page_pool_total(high);
+	return ion_page_pool_total(high) + ion_page_pool_total_cached();
 }
 
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
@@ -238,13 +354,20 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 					     GFP_KERNEL);
 	if (!pool)
 		return NULL;
+	pool->cache = alloc_percpu(struct ion_page_pool_cache);
+	if (!pool->cache) {
+		kfree(pool);
+		return NULL;
+	}
 	pool->high_count = 0;
 	pool->low_count = 0;
+	atomic_set(&pool->hits, 0);
+	atomic_set(&pool->misses, 0);
 	INIT_LIST_HEAD(&pool->low_items);
 	INIT_LIST_HEAD(&pool->high_items);
 	pool->gfp_mask = gfp_mask;
 	pool->order = order;
-	mutex_init(&pool->mutex);
+	spin_lock_init(&pool->lock);
 	plist_node_init(&pool->list, order);
 	plist_add(&pool->list, &pools);
 
@@ -253,7 +376,27 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	struct page *page;
+	int cpu;
+
 	plist_del(&pool->list, &pools);
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_cache *cache = per_cpu_ptr(pool->cache,
+								cpu);
+
+		while (cache->count)
+			ion_page_pool_free_pages(pool,
+						 cache->pages[--cache->count]);
+	}
+	free_percpu(pool->cache);
+	while (pool->high_count) {
+		page = ion_page_pool_remove(pool, true);
+		ion_page_pool_free_pages(pool, page);
+	}
+	while (pool->low_count) {
+		page = ion_page_pool_remove(pool, false);
+		ion_page_pool_free_pages(pool, page);
+	}
 	kfree(pool);
 }
 
@@ -19,12 +19,16 @@
 
 #include <linux/ion.h>
 #include <linux/kref.h>
+#include <linux/list.h>
 #include <linux/mm_types.h>
 #include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/rbtree.h>
 #include <linux/sched.h>
 #include <linux/shrinker.h>
+#include <linux/spinlock.h>
 #include <linux/types.h>
+#include <linux/wait.h>
 #include <linux/miscdevice.h>
 
 /**
@@ -35,6 +39,8 @@
  * @lock:		rwsem protecting the tree of heaps and clients
  * @heaps:		list of all the heaps in the system
  * @user_clients:	list of all the clients created from userspace
+ * @policies:		allocation policies, protected by @lock
+ * @nr_policies:	number of entries in @policies
  */
 struct ion_device {
 	struct miscdevice dev;
@@ -46,32 +52,84 @@ struct ion_device {
 			      unsigned long arg);
 	struct rb_root clients;
 	struct dentry *debug_root;
+	struct ion_policy *policies;
+	int nr_policies;
 };
 
+/**
+ * struct ion_policy - an allocation policy and its fast fail state
+ * @policy:		the policy as provided by the platform
+ * @fail_len:		smallest allocation the preferred heap failed
+ * @fail_seq:		free_seq of the preferred heap at that failure
+ * @lock:		protects @fail_len and @fail_seq
+ */
+struct ion_policy {
+	struct ion_alloc_policy policy;
+	size_t fail_len;
+	unsigned int fail_seq;
+	spinlock_t lock;
+};
+
+/*
+ * Latency of the ion entry points is accounted per heap and per client in
+ * log2 buckets of microseconds: bucket 0 counts calls below 1us, bucket n
+ * calls in [2^(n-1), 2^n) us, and the last bucket everything slower.
+ */
+#define ION_LATENCY_BUCKETS	16
+
+enum ion_latency_op {
+	ION_LATENCY_ALLOC,
+	ION_LATENCY_FREE,
+	ION_LATENCY_MAP_KERNEL,
+	ION_LATENCY_SHARE,
+	ION_LATENCY_NUM_OPS,
+};
+
+struct ion_latency_hist {
+	atomic_t buckets[ION_LATENCY_NUM_OPS][ION_LATENCY_BUCKETS];
+};
+
+/*
+ * Handles are passed to and from userspace as the kernel address of the
+ * ion_handle, so they are hashed by pointer value: validating a cookie
+ * never dereferences it and costs the same no matter how many handles the
+ * client holds.
+ */
+#define ION_CLIENT_HASH_BITS	7
+#define ION_CLIENT_HASH_SIZE	(1 << ION_CLIENT_HASH_BITS)
+
 /**
  * struct ion_client - a process/hw block local address space
  * @node:		node in the tree of all clients
  * @dev:		backpointer to ion device
- * @handles:		an rb tree of all the handles in this client
- * @lock:		lock protecting the tree of handles
+ * @handles:		list of all the handles in this client
+ * @handle_hash:	handles hashed by their own address, for validation
+ * @buffer_hash:	handles hashed by the address of their buffer, for
+ *			finding an existing handle to a buffer on import
+ * @lock:		lock protecting the handle list and hashes
  * @heap_mask:		mask of all supported heaps
  * @name:		used for debugging
  * @task:		used for debugging
+ * @latency:		latency histograms of calls made by this client
  *
  * A client represents a list of buffers this client may access.
- * The mutex stored here is used to protect both handles tree
- * as well as the handles themselves, and should be held while modifying either.
+ * The mutex stored here is used to protect both handles list and hashes
+ * as well as the handles themselves, and should be held while modifying
+ * either.
  */
 struct ion_client {
 	struct rb_node node;
 	struct ion_device *dev;
-	struct rb_root handles;
+	struct list_head handles;
+	struct hlist_head handle_hash[ION_CLIENT_HASH_SIZE];
+	struct hlist_head buffer_hash[ION_CLIENT_HASH_SIZE];
 	struct mutex lock;
 	unsigned int heap_mask;
 	const char *name;
 	struct task_struct *task;
 	pid_t pid;
 	struct dentry *debug_root;
+	struct ion_latency_hist latency;
 };
 
 /**
@@ -79,7 +137,9 @@ struct ion_client {
  * @ref:		reference count
  * @client:		back pointer to the client the buffer resides in
  * @buffer:		pointer to the buffer
- * @node:		node in the client's handle rbtree
+ * @node:		node in the client's handle list
+ * @hash_node:		node in the client's handle_hash
+ * @buffer_node:	node in the client's buffer_hash
  * @kmap_cnt:		count of times this client has mapped to kernel
  * @dmap_cnt:		count of times this client has mapped for dma
  *
@@ -90,7 +150,9 @@ struct ion_handle {
 	struct kref ref;
 	struct ion_client *client;
 	struct ion_buffer *buffer;
-	struct rb_node node;
+	struct list_head node;
+	struct hlist_node hash_node;
+	struct hlist_node buffer_node;
 	unsigned int kmap_cnt;
 };
 
@@ -100,6 +162,8 @@ struct ion_buffer *ion_handle_buffer(struct ion_handle *handle);
  * struct ion_buffer - metadata for a particular buffer
  * @ref:		refernce count
  * @node:		node in the ion_device buffers tree
+ * @list:		element in the heap's deferred free list, only used
+ *			once the buffer has been removed from the buffers tree
  * @dev:		back pointer to the ion_device
  * @heap:		back pointer to the heap the buffer came from
  * @flags:		buffer specific flags
@@ -125,7 +189,10 @@ struct ion_buffer *ion_handle_buffer(struct ion_handle *handle);
 */
 struct ion_buffer {
 	struct kref ref;
-	struct rb_node node;
+	union {
+		struct rb_node node;
+		struct list_head list;
+	};
 	struct ion_device *dev;
 	struct ion_heap *heap;
 	unsigned long flags;
@@ -192,6 +259,14 @@ struct ion_heap_ops {
  *			allocating.  These are specified by platform data and
  *			MUST be unique
  * @name:		used for debugging
+ * @flags:		ION_HEAP_FLAG_* flags from the platform data
+ * @free_list:		buffers waiting to be freed when the heap defers frees
+ * @free_list_size:	total size in bytes of the buffers in @free_list
+ * @free_lock:		protects @free_list and @free_list_size
+ * @waitqueue:		wait queue the deferred free thread sleeps on
+ * @task:		thread draining @free_list
+ * @latency:		latency histograms of calls on buffers of this heap
+ * @free_seq:		bumped every time a buffer is returned to the heap
  * @debug_show:		called when heap debug file is read to add any
  *			heap specific debug info to output
  *
@@ -207,6 +282,14 @@ struct ion_heap {
 	struct ion_heap_ops *ops;
 	int id;
 	const char *name;
+	unsigned long flags;
+	struct list_head free_list;
+	size_t free_list_size;
+	spinlock_t free_lock;
+	wait_queue_head_t waitqueue;
+	struct task_struct *task;
+	struct ion_latency_hist latency;
+	atomic_t free_seq;
 	int (*debug_show)(struct ion_heap *heap, struct seq_file *, void *);
 };
 
@@ -251,6 +334,53 @@ void ion_device_destroy(struct ion_device *dev);
  */
 void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap);
 
+/**
+ * ion_buffer_destroy - release a buffer back to its heap
+ * @buffer:		the buffer, already removed from the device
+ *
+ * Called once the last reference is dropped, either directly or from the
+ * heap's deferred free thread.
+ */
+void ion_buffer_destroy(struct ion_buffer *buffer);
+
+/**
+ * ion_heap_init_deferred_free - start the deferred free thread of a heap
+ * @heap:		the heap, must have ION_HEAP_FLAG_DEFER_FREE set
+ */
+int ion_heap_init_deferred_free(struct ion_heap *heap);
+
+/**
+ * ion_heap_freelist_add - queue a buffer to be freed by the heap's thread
+ * @heap:		the heap
+ * @buffer:		the buffer
+ */
+void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer);
+
+/**
+ * ion_heap_freelist_drain - synchronously free queued buffers
+ * @heap:		the heap
+ * @size:		amount of memory to drain in bytes, 0 drains everything
+ *
+ * Used by allocation paths to reclaim memory still sitting in the free
+ * list when the heap runs dry.  Returns the number of bytes drained.
+ */
+size_t ion_heap_freelist_drain(struct ion_heap *heap, size_t size);
+
+/**
+ * ion_heap_freelist_size - bytes currently waiting in the free list
+ * @heap:		the heap
+ */
+size_t ion_heap_freelist_size(struct ion_heap *heap);
+
+/**
+ * ion_device_set_policies - install allocation policies on a device
+ * @dev:		the device
+ * @policies:		array of policies, copied
+ * @nr:			number of entries in @policies
+ */
+int ion_device_set_policies(struct ion_device *dev,
+			    struct ion_alloc_policy *policies, int nr);
+
 /**
  * functions for creating and destroying the built in ion heaps.
  * architectures can add their own custom architecture specific
@@ -268,6 +398,9 @@ void ion_system_contig_heap_destroy(struct ion_heap *);
 
 struct ion_heap *ion_carveout_heap_create(struct ion_platform_heap *);
 void ion_carveout_heap_destroy(struct ion_heap *);
+
+struct ion_heap *ion_cma_heap_create(struct ion_platform_heap *);
+void ion_cma_heap_destroy(struct ion_heap *);
 /**
  * kernel api to allocate/free from carveout -- used when carveout is
  * used to back an architecture specific custom heap
@@ -289,15 +422,33 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * invalidated from the cache, provides a significant peformance benefit on
  * many systems */
 
+/**
+ * struct ion_page_pool_cache - per-cpu front cache of a page pool
+ * @count:		number of pages currently held in @pages
+ * @pages:		stack of pages, most recently freed on top
+ *
+ * Only accessed by the owning cpu with interrupts disabled, so the common
+ * alloc/free case neither takes the pool lock nor bounces cache lines
+ * between cpus.
+ */
+#define ION_PAGE_POOL_CACHE_SIZE 16
+
+struct ion_page_pool_cache {
+	int count;
+	struct page *pages[ION_PAGE_POOL_CACHE_SIZE];
+};
+
 /**
  * struct ion_page_pool - pagepool struct
  * @high_count:		number of highmem items in the pool
  * @low_count:		number of lowmem items in the pool
  * @high_items:		list of highmem items
  * @low_items:		list of lowmem items
- * @shrinker:		a shrinker for the items
- * @mutex:		lock protecting this struct and especially the count
+ * @lock:		lock protecting this struct and especially the count
  *			item list
+ * @cache:		per-cpu caches sitting in front of the item lists
+ * @hits:		allocations served from the pool
+ * @misses:		allocations that had to go to the page allocator
  * @alloc:		function to be used to allocate pageory when the pool
  *			is empty
  * @free:		function to be used to free pageory back to the system
@@ -309,14 +460,17 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
  * been invalidated from the cache, provides a significant peformance benefit
- * on many systems
+ * on many systems.  Pages in the item lists are linked through page->lru.
  */
 struct ion_page_pool {
 	int high_count;
 	int low_count;
 	struct list_head high_items;
 	struct list_head low_items;
-	struct mutex mutex;
+	spinlock_t lock;
+	struct ion_page_pool_cache __percpu *cache;
+	atomic_t hits;
+	atomic_t misses;
 	void *(*alloc)(struct ion_page_pool *pool);
 	void (*free)(struct ion_page_pool *pool, struct page *page);
 	gfp_t gfp_mask;
@@ -328,6 +482,9 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
 void ion_page_pool_destroy(struct ion_page_pool *);
 void *ion_page_pool_alloc(struct ion_page_pool *);
 void ion_page_pool_free(struct ion_page_pool *, struct page *);
+int ion_page_pool_cache_count(struct ion_page_pool *);
+int ion_page_pool_count(struct ion_page_pool *);
+int ion_page_pool_fill(struct ion_page_pool *);
 
 /**
  * Flushing entire cache is more efficient than flushing virtual address
@@ -15,15 +15,20 @@
  */
 
 #include <asm/page.h>
+#include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/highmem.h>
 #include <linux/ion.h>
+#include <linux/kthread.h>
 #include <linux/mm.h>
+#include <linux/compaction.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/wait.h>
 #include "ion_priv.h"
 
 static unsigned int high_order_gfp_flags = (GFP_HIGHUSER | __GFP_ZERO |
@@ -33,6 +38,15 @@ static unsigned int low_order_gfp_flags  = (GFP_HIGHUSER | __GFP_ZERO |
 					 __GFP_NOWARN);
 static const unsigned int orders[] = {8, 4, 0};
 static const int num_orders = ARRAY_SIZE(orders);
+/*
+ * number of items the refill thread keeps in each order pool by default,
+ * about 1MB per order, tunable through debugfs
+ */
+static const u32 default_watermarks[] = {1, 16, 256};
+/* free orders[0] blocks kcompactd is asked to keep around */
+#define ION_COMPACTION_TARGET	4
+/* pages mapped at once when zeroing uncached pages for the pools */
+#define ION_ZERO_BATCH_PAGES	16
 static int order_to_index(unsigned int order)
 {
 	int i;
@@ -48,11 +62,86 @@ static unsigned int order_to_size(int order)
 	return PAGE_SIZE << order;
 }
 
+/**
+ * struct ion_system_heap - system heap built on top of order pools
+ * @heap:		the ion heap
+ * @pools:		one page pool per entry in orders[]
+ * @watermarks:		number of items the refill thread keeps in each pool
+ * @refill_thread:	low priority thread pre-zeroing and pre-flushing pages
+ * @refill_wait:	wait queue the refill thread sleeps on
+ * @debug_root:		debugfs directory holding the watermark tunables
+ * @alloc_chunks:	number of chunks of each order handed out
+ * @map_chunks:		number of user mapped chunks that were aligned well
+ *			enough, virtually and physically, to be backed by a
+ *			mapping of each order in orders[]
+ */
 struct ion_system_heap {
 	struct ion_heap heap;
 	struct ion_page_pool **pools;
+	u32 *watermarks;
+	struct task_struct *refill_thread;
+	wait_queue_head_t refill_wait;
+	struct dentry *debug_root;
+	atomic_t *alloc_chunks;
+	atomic_t *map_chunks;
 };
 
+static bool ion_system_heap_needs_refill(struct ion_system_heap *heap)
+{
+	int i;
+
+	for (i = 0; i < num_orders; i++)
+		if (ion_page_pool_count(heap->pools[i]) <
+		    (int)ACCESS_ONCE(heap->watermarks[i]))
+			return true;
+	return false;
+}
+
+/*
+ * Keep the pools topped up so the allocating thread gets pages that are
+ * already zeroed and clean, instead of paying for the memset and the cache
+ * maintenance itself.  Stop filling a pool as soon as an allocation fails,
+ * there is no point in fighting the shrinker when memory is tight.
+ */
+static int ion_system_heap_refill_thread(void *data)
+{
+	struct ion_system_heap *heap = data;
+	int i;
+
+	set_user_nice(current, 19);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(heap->refill_wait,
+				     ion_system_heap_needs_refill(heap) ||
+				     kthread_should_stop());
+
+		for (i = 0; i < num_orders; i++) {
+			struct ion_page_pool *pool = heap->pools[i];
+
+			while (!kthread_should_stop() &&
+			       ion_page_pool_count(pool) <
+			       (int)ACCESS_ONCE(heap->watermarks[i])) {
+				if (ion_page_pool_fill(pool))
+					break;
+				cond_resched();
+			}
+		}
+		/* memory is tight, don't spin on the watermark */
+		if (ion_system_heap_needs_refill(heap))
+			schedule_timeout_interruptible(HZ);
+	}
+	return 0;
+}
+
+static void ion_system_heap_kick_refill(struct ion_system_heap *heap,
+					int index)
+{
+	if (ion_page_pool_count(heap->pools[index]) <
+	    (int)ACCESS_ONCE(heap->watermarks[index]))
+		wake_up(&heap->refill_wait);
+}
+
 struct page_info {
 	struct page *page;
 	unsigned int order;
@@ -70,6 +159,7 @@ static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 
 	if (!cached) {
 		page = ion_page_pool_alloc(pool);
+		ion_system_heap_kick_refill(heap, order_to_index(order));
 	} else {
 		gfp_t gfp_flags = low_order_gfp_flags;
 
@@ -99,15 +189,24 @@ static void free_buffer_page(struct ion_system_heap *heap,
 
 	if (!cached) {
 		struct ion_page_pool *pool = heap->pools[order_to_index(order)];
+		struct page *pages[ION_ZERO_BATCH_PAGES];
+		int j, n;
+
 		/* zero the pages before returning them to the pool for
 		   security.  This uses vmap as we want to set the pgprot so
 		   the writes to occur to noncached mappings, as the pool's
-		   purpose is to keep the pages out of the cache */
-		for (i = 0; i < order / PAGE_SIZE; i++) {
-			struct page *sub_page = page + i;
-			void *addr = vmap(&sub_page, 1, VM_MAP,
-					  pgprot_writecombine(PAGE_KERNEL));
-			memset(addr, 0, PAGE_SIZE);
+		   purpose is to keep the pages out of the cache.  The pages
+		   are mapped a batch at a time, so that a large page costs a
+		   few mappings and TLB invalidates rather than one per page */
+		for (i = 0; i < (1 << order); i += n) {
+			void *addr;
+
+			n = min(1 << order, i + ION_ZERO_BATCH_PAGES) - i;
+			for (j = 0; j < n; j++)
+				pages[j] = page + i + j;
+			addr = vmap(pages, n, VM_MAP,
+				    pgprot_writecombine(PAGE_KERNEL));
+			memset(addr, 0, n * PAGE_SIZE);
 			vunmap(addr);
 		}
 		ion_page_pool_free(pool, page);
@@ -136,8 +235,12 @@ static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 			continue;
 
 		page = alloc_buffer_page(heap, buffer, orders[i]);
-		if (!page)
+		if (!page) {
+			if (orders[i] == orders[0])
+				wakeup_kcompactd();
 			continue;
+		}
+		atomic_inc(&heap->alloc_chunks[i]);
 
 		info = kmalloc(sizeof(struct page_info), GFP_KERNEL);
 		info->page = page;
@@ -287,14 +390,44 @@ static void ion_system_heap_unmap_kernel(struct ion_heap *heap,
 	vunmap(buffer->vaddr);
 }
 
+/*
+ * Largest order in orders[] that a mapping of len bytes at addr backed by
+ * pfn could use, ie both addresses are aligned to it and the mapping
+ * covers it completely.
+ */
+static int ion_system_heap_map_order_index(unsigned long addr,
+					   unsigned long pfn,
+					   unsigned long len)
+{
+	int i;
+
+	for (i = 0; i < num_orders - 1; i++) {
+		unsigned long size = order_to_size(orders[i]);
+
+		if (len >= size && IS_ALIGNED(addr, size) &&
+		    IS_ALIGNED(pfn, 1 << orders[i]))
+			return i;
+	}
+	return num_orders - 1;
+}
+
+/*
+ * Each sg entry is physically contiguous, so map a whole entry with a
+ * single remap_pfn_range call rather than page by page.  The achieved
+ * alignment of every entry is accounted so the debug show can tell how
+ * much of the mapped memory could use 64K/1M translations.
+ */
 static int ion_system_heap_map_user(struct ion_heap *heap,
 		struct ion_buffer *buffer, struct vm_area_struct *vma)
 {
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
 	struct sg_table *table = buffer->priv_virt;
 	unsigned long addr = vma->vm_start;
 	unsigned long offset = vma->vm_pgoff * PAGE_SIZE;
 	struct scatterlist *sg;
-	int i;
+	int i, ret;
 
 	for_each_sg(table->sgl, sg, table->nents, i) {
 		struct page *page = sg_page(sg);
@@ -310,8 +443,14 @@ static int ion_system_heap_map_user(struct ion_heap *heap,
 			offset = 0;
 		}
 		len = min(len, remainder);
-		remap_pfn_range(vma, addr, page_to_pfn(page), len,
-				vma->vm_page_prot);
+		ret = remap_pfn_range(vma, addr, page_to_pfn(page), len,
+				      vma->vm_page_prot);
+		if (ret)
+			return ret;
+		atomic_inc(&sys_heap->map_chunks[
+			   ion_system_heap_map_order_index(addr,
+							   page_to_pfn(page),
+							   len)]);
 		addr += len;
 		if (addr >= vma->vm_end)
 			return 0;
@@ -345,10 +484,41 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 		seq_printf(s, "%d order %u lowmem pages in pool = %lu total\n",
 			   pool->low_count, pool->order,
 			   (1 << pool->order) * PAGE_SIZE * pool->low_count);
+		seq_printf(s, "%d order %u pages in per-cpu caches\n",
+			   ion_page_pool_cache_count(pool), pool->order);
+		seq_printf(s, "%u order %u refill watermark\n",
+			   sys_heap->watermarks[i], pool->order);
+		seq_printf(s, "%d order %u pool hits, %d misses\n",
+			   atomic_read(&pool->hits), pool->order,
+			   atomic_read(&pool->misses));
 	}
+	seq_printf(s, "%8.s %16.s %16.s\n", "order", "chunks allocated",
+		   "chunks mapped");
+	for (i = 0; i < num_orders; i++)
+		seq_printf(s, "%8u %16d %16d\n", orders[i],
+			   atomic_read(&sys_heap->alloc_chunks[i]),
+			   atomic_read(&sys_heap->map_chunks[i]));
 	return 0;
 }
 
+static void ion_system_heap_debugfs_init(struct ion_system_heap *heap)
+{
+	char name[32];
+	int i;
+
+	heap->debug_root = debugfs_create_dir("ion_system_heap", NULL);
+	if (IS_ERR_OR_NULL(heap->debug_root)) {
+		pr_err("%s: failed to create debug files.\n", __func__);
+		heap->debug_root = NULL;
+		return;
+	}
+	for (i = 0; i < num_orders; i++) {
+		snprintf(name, sizeof(name), "order%u_watermark", orders[i]);
+		debugfs_create_u32(name, 0664, heap->debug_root,
+				   &heap->watermarks[i]);
+	}
+}
+
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 {
 	struct ion_system_heap *heap;
@@ -374,12 +544,30 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 			goto err_create_pool;
 		heap->pools[i] = pool;
 	}
+	heap->watermarks = kmemdup(default_watermarks,
+				   sizeof(default_watermarks), GFP_KERNEL);
+	heap->alloc_chunks = kcalloc(num_orders, sizeof(atomic_t), GFP_KERNEL);
+	heap->map_chunks = kcalloc(num_orders, sizeof(atomic_t), GFP_KERNEL);
+	if (!heap->watermarks || !heap->alloc_chunks || !heap->map_chunks)
+		goto err_create_pool;
+	init_waitqueue_head(&heap->refill_wait);
+	heap->refill_thread = kthread_run(ion_system_heap_refill_thread, heap,
+					  "ion_pool_refill");
+	if (IS_ERR(heap->refill_thread)) {
+		pr_err("%s: failed to start pool refill thread.\n", __func__);
+		heap->refill_thread = NULL;
+	}
+	ion_system_heap_debugfs_init(heap);
 	heap->heap.debug_show = ion_system_heap_debug_show;
+	compaction_register_target(orders[0], ION_COMPACTION_TARGET);
 	return &heap->heap;
 err_create_pool:
 	for (i = 0; i < num_orders; i++)
 		if (heap->pools[i])
 			ion_page_pool_destroy(heap->pools[i]);
+	kfree(heap->map_chunks);
+	kfree(heap->alloc_chunks);
+	kfree(heap->watermarks);
 	kfree(heap->pools);
 err_alloc_pools:
 	kfree(heap);
@@ -393,8 +581,15 @@ void ion_system_heap_destroy(struct ion_heap *heap)
 							heap);
 	int i;
 
+	compaction_unregister_target(orders[0], ION_COMPACTION_TARGET);
+	if (sys_heap->refill_thread)
+		kthread_stop(sys_heap->refill_thread);
+	debugfs_remove_recursive(sys_heap->debug_root);
 	for (i = 0; i < num_orders; i++)
 		ion_page_pool_destroy(sys_heap->pools[i]);
+	kfree(sys_heap->map_chunks);
+	kfree(sys_heap->alloc_chunks);
+	kfree(sys_heap->watermarks);
 	kfree(sys_heap->pools);
 	kfree(sys_heap);
 }
@@ -48,6 +48,13 @@ int omap_ion_nonsecure_tiler_alloc(struct ion_client *client,
 }
 EXPORT_SYMBOL(omap_ion_nonsecure_tiler_alloc);
 
+int omap_ion_tiler_alloc_nv12(struct ion_client *client,
+			 struct omap_ion_tiler_alloc_nv12_data *data)
+{
+	return omap_tiler_alloc_nv12(tiler_heap, client, data);
+}
+EXPORT_SYMBOL(omap_ion_tiler_alloc_nv12);
+
 static long omap_ion_ioctl(struct ion_client *client, unsigned int cmd,
 		    unsigned long arg)
 {
@@ -72,6 +79,26 @@ static long omap_ion_ioctl(struct ion_client *client, unsigned int cmd,
 			return -EFAULT;
 		break;
 	}
+	case OMAP_ION_TILER_ALLOC_NV12:
+	{
+		struct omap_ion_tiler_alloc_nv12_data data;
+		int ret;
+
+		if (!tiler_heap) {
+			pr_err("%s: Tiler heap requested but no tiler heap "
+					"exists on this platform\n", __func__);
+			return -EINVAL;
+		}
+		if (copy_from_user(&data, (void __user *)arg, sizeof(data)))
+			return -EFAULT;
+		ret = omap_ion_tiler_alloc_nv12(client, &data);
+		if (ret)
+			return ret;
+		if (copy_to_user((void __user *)arg, &data,
+				 sizeof(data)))
+			return -EFAULT;
+		break;
+	}
 	default:
 		pr_err("%s: Unknown custom ioctl\n", __func__);
 		return -ENOTTY;
@@ -119,6 +146,15 @@ static int omap_ion_probe(struct platform_device *pdev)
 
 	}
 
+	if (pdata->nr_policies) {
+		err = ion_device_set_policies(omap_ion_device,
+					      pdata->policies,
+					      pdata->nr_policies);
+		if (err)
+			pr_err("%s: failed to set allocation policies\n",
+			       __func__);
+	}
+
 	platform_set_drvdata(pdev, omap_ion_device);
 	return 0;
 err:
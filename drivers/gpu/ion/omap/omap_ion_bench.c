@@ -0,0 +1,531 @@
+/*
+ * drivers/gpu/ion/omap/omap_ion_bench.c
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Benchmark of the ion paths every buffer goes through: allocation, kernel
+ * mapping, export as a dma-buf, import by another client, cache sync and
+ * free.  It sweeps buffer sizes, thread counts and, for TILER heaps, pixel
+ * formats over the heaps of omap_ion_device and reports the latency
+ * percentiles of each step, so a change in a pool, TILER pinning or cache
+ * maintenance shows up as numbers:
+ *
+ *	cd /sys/kernel/debug/ion_bench
+ *	echo 4096 > min_size; echo 4194304 > max_size; echo 4 > max_threads
+ *	echo 1 > run
+ *	cat results
+ */
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/ion.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/omap_ion.h>
+#include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/syscalls.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+
+#define ION_BENCH_MAX_THREADS	8
+#define ION_BENCH_MAX_ITERS	1024
+#define ION_BENCH_TILER_W	1024	/* pixels per row of TILER buffers */
+
+enum {
+	ION_BENCH_ALLOC,
+	ION_BENCH_MAP_KERNEL,
+	ION_BENCH_SHARE,
+	ION_BENCH_IMPORT,
+	ION_BENCH_SYNC,
+	ION_BENCH_FREE,
+	ION_BENCH_NUM_OPS,
+};
+
+static const char * const ion_bench_ops[ION_BENCH_NUM_OPS] = {
+	"alloc", "map_kernel", "share", "import", "sync", "free",
+};
+
+static const char * const ion_bench_heaps[] = {
+	[OMAP_ION_HEAP_SYSTEM]		= "system",
+	[OMAP_ION_HEAP_TILER]		= "tiler",
+	[OMAP_ION_HEAP_SECURE_INPUT]	= "secure_input",
+	[OMAP_ION_HEAP_NONSECURE_TILER]	= "nonsecure_tiler",
+	[OMAP_ION_HEAP_CMA]		= "cma",
+};
+
+static const char * const ion_bench_fmts[] = {
+	[TILER_PIXEL_FMT_8BIT]	= "8bit",
+	[TILER_PIXEL_FMT_16BIT]	= "16bit",
+	[TILER_PIXEL_FMT_32BIT]	= "32bit",
+	[TILER_PIXEL_FMT_PAGE]	= "page",
+};
+
+/* sweep parameters, set through debugfs */
+static u32 heap_mask = (1 << ARRAY_SIZE(ion_bench_heaps)) - 1;
+static u32 tiler_fmts = (1 << ARRAY_SIZE(ion_bench_fmts)) - 1;
+static u32 min_size = SZ_4K;
+static u32 max_size = SZ_4M;
+static u32 max_threads = 4;
+static u32 iterations = 64;
+
+/**
+ * struct ion_bench_result - one step of one point of the sweep
+ * @node:	entry in ion_bench_results
+ * @heap:	heap id
+ * @fmt:	TILER pixel format, -1 for other heaps
+ * @size:	buffer size
+ * @threads:	threads running concurrently
+ * @op:		ION_BENCH_* step
+ * @count:	number of samples
+ * @failed:	iterations that failed
+ * @p50:	median latency, ns
+ * @p90:	90th percentile latency, ns
+ * @p99:	99th percentile latency, ns
+ * @max:	worst latency, ns
+ * @wall_ns:	time for all threads to complete all iterations
+ */
+struct ion_bench_result {
+	struct list_head node;
+	int heap;
+	int fmt;
+	size_t size;
+	int threads;
+	int op;
+	int count;
+	int failed;
+	u32 p50, p90, p99, max;
+	u64 wall_ns;
+};
+
+struct ion_bench_point {
+	int heap;
+	int fmt;
+	size_t size;
+	int threads;
+	int iters;
+	struct ion_client *client;
+	struct ion_client *importer;
+	atomic_t ready;
+	wait_queue_head_t start;
+	bool go;
+	atomic_t done;
+	struct completion finished;
+	/* samples[thread][op][iter] */
+	u32 *samples;
+	int count[ION_BENCH_MAX_THREADS][ION_BENCH_NUM_OPS];
+	int failed[ION_BENCH_MAX_THREADS];
+};
+
+struct ion_bench_thread {
+	struct ion_bench_point *pt;
+	int index;
+};
+
+static LIST_HEAD(ion_bench_results);
+static DEFINE_MUTEX(ion_bench_lock);
+
+static u32 *ion_bench_sample(struct ion_bench_point *pt, int thread, int op)
+{
+	return pt->samples + (thread * ION_BENCH_NUM_OPS + op) * pt->iters;
+}
+
+static void ion_bench_record(struct ion_bench_point *pt, int thread, int op,
+			     ktime_t *start)
+{
+	ktime_t now = ktime_get();
+	s64 ns = ktime_to_ns(ktime_sub(now, *start));
+
+	ion_bench_sample(pt, thread, op)[pt->count[thread][op]++] =
+		min_t(s64, ns, ~0U);
+	*start = now;
+}
+
+static struct ion_handle *ion_bench_alloc(struct ion_bench_point *pt)
+{
+	struct omap_ion_tiler_alloc_data data = {
+		.fmt = pt->fmt,
+	};
+	int bpp, r;
+
+	if (pt->fmt < 0)
+		return ion_alloc(pt->client, pt->size, PAGE_SIZE,
+				 1 << pt->heap, 0);
+
+	if (pt->fmt == TILER_PIXEL_FMT_PAGE) {
+		data.w = pt->size;
+		data.h = 1;
+	} else {
+		bpp = 1 << (pt->fmt - TILER_PIXEL_FMT_8BIT);
+		data.w = ION_BENCH_TILER_W;
+		data.h = max_t(size_t, pt->size / (ION_BENCH_TILER_W * bpp),
+			       1);
+	}
+
+	if (pt->heap == OMAP_ION_HEAP_TILER)
+		r = omap_ion_tiler_alloc(pt->client, &data);
+	else
+		r = omap_ion_nonsecure_tiler_alloc(pt->client, &data);
+
+	return r ? ERR_PTR(r) : data.handle;
+}
+
+/* one buffer through all the steps, each step timed on its own */
+static int ion_bench_iterate(struct ion_bench_point *pt, int thread)
+{
+	struct ion_handle *handle, *imported;
+	struct sg_table *table;
+	ktime_t t = ktime_get();
+	void *vaddr;
+	int fd;
+
+	handle = ion_bench_alloc(pt);
+	if (IS_ERR_OR_NULL(handle))
+		return handle ? PTR_ERR(handle) : -ENOMEM;
+	ion_bench_record(pt, thread, ION_BENCH_ALLOC, &t);
+
+	vaddr = ion_map_kernel(pt->client, handle);
+	if (!IS_ERR_OR_NULL(vaddr)) {
+		ion_unmap_kernel(pt->client, handle);
+		ion_bench_record(pt, thread, ION_BENCH_MAP_KERNEL, &t);
+	}
+
+	t = ktime_get();
+	fd = ion_share_dma_buf(pt->client, handle);
+	if (fd >= 0) {
+		ion_bench_record(pt, thread, ION_BENCH_SHARE, &t);
+
+		imported = ion_import_dma_buf(pt->importer, fd);
+		if (!IS_ERR_OR_NULL(imported)) {
+			ion_free(pt->importer, imported);
+			ion_bench_record(pt, thread, ION_BENCH_IMPORT, &t);
+		}
+		sys_close(fd);
+	}
+
+	t = ktime_get();
+	table = ion_sg_table(pt->client, handle);
+	if (!IS_ERR_OR_NULL(table)) {
+		dma_sync_sg_for_device(NULL, table->sgl, table->nents,
+				       DMA_BIDIRECTIONAL);
+		ion_bench_record(pt, thread, ION_BENCH_SYNC, &t);
+	}
+
+	t = ktime_get();
+	ion_free(pt->client, handle);
+	ion_bench_record(pt, thread, ION_BENCH_FREE, &t);
+
+	return 0;
+}
+
+static int ion_bench_thread(void *data)
+{
+	struct ion_bench_thread *th = data;
+	struct ion_bench_point *pt = th->pt;
+	int i;
+
+	atomic_inc(&pt->ready);
+	wait_event(pt->start, pt->go);
+
+	for (i = 0; i < pt->iters; i++) {
+		if (ion_bench_iterate(pt, th->index)) {
+			pt->failed[th->index] = pt->iters - i;
+			break;
+		}
+	}
+
+	if (atomic_dec_and_test(&pt->done))
+		complete(&pt->finished);
+	kfree(th);
+	return 0;
+}
+
+static int ion_bench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* merge the samples of all threads into one result per step */
+static void ion_bench_report(struct ion_bench_point *pt, u64 wall_ns,
+			     u32 *merged)
+{
+	struct ion_bench_result *res;
+	int failed = 0;
+	int op, i, n;
+
+	for (i = 0; i < pt->threads; i++)
+		failed += pt->failed[i];
+
+	for (op = 0; op < ION_BENCH_NUM_OPS; op++) {
+		n = 0;
+		for (i = 0; i < pt->threads; i++) {
+			memcpy(merged + n, ion_bench_sample(pt, i, op),
+			       pt->count[i][op] * sizeof(u32));
+			n += pt->count[i][op];
+		}
+
+		res = kzalloc(sizeof(*res), GFP_KERNEL);
+		if (!res)
+			return;
+		res->heap = pt->heap;
+		res->fmt = pt->fmt;
+		res->size = pt->size;
+		res->threads = pt->threads;
+		res->op = op;
+		res->count = n;
+		res->failed = failed;
+		res->wall_ns = wall_ns;
+		if (n) {
+			sort(merged, n, sizeof(u32), ion_bench_cmp, NULL);
+			res->p50 = merged[n * 50 / 100];
+			res->p90 = merged[n * 90 / 100];
+			res->p99 = merged[n * 99 / 100];
+			res->max = merged[n - 1];
+		}
+		list_add_tail(&res->node, &ion_bench_results);
+	}
+}
+
+static int ion_bench_point(struct ion_bench_point *pt, u32 *merged)
+{
+	struct ion_bench_thread *th;
+	struct task_struct *task;
+	ktime_t start;
+	int i, started = 0;
+
+	memset(pt->count, 0, sizeof(pt->count));
+	memset(pt->failed, 0, sizeof(pt->failed));
+	atomic_set(&pt->ready, 0);
+	atomic_set(&pt->done, pt->threads);
+	init_waitqueue_head(&pt->start);
+	init_completion(&pt->finished);
+	pt->go = false;
+
+	for (i = 0; i < pt->threads; i++) {
+		th = kzalloc(sizeof(*th), GFP_KERNEL);
+		if (!th)
+			break;
+		th->pt = pt;
+		th->index = i;
+		task = kthread_run(ion_bench_thread, th, "ion_bench/%d", i);
+		if (IS_ERR(task)) {
+			kfree(th);
+			break;
+		}
+		started++;
+	}
+
+	/* threads that did not start count as done */
+	for (i = started; i < pt->threads; i++) {
+		pt->failed[i] = pt->iters;
+		if (atomic_dec_and_test(&pt->done))
+			complete(&pt->finished);
+	}
+
+	while (atomic_read(&pt->ready) < started)
+		msleep(1);
+
+	start = ktime_get();
+	pt->go = true;
+	wake_up_all(&pt->start);
+	wait_for_completion(&pt->finished);
+
+	ion_bench_report(pt, ktime_to_ns(ktime_sub(ktime_get(), start)),
+			 merged);
+	return started ? 0 : -ENOMEM;
+}
+
+static void ion_bench_clear(void)
+{
+	struct ion_bench_result *res, *tmp;
+
+	list_for_each_entry_safe(res, tmp, &ion_bench_results, node) {
+		list_del(&res->node);
+		kfree(res);
+	}
+}
+
+static int ion_bench_run(void)
+{
+	struct ion_bench_point pt;
+	u32 *merged;
+	int heap, fmt, r = 0;
+
+	if (!omap_ion_device)
+		return -ENODEV;
+	if (!min_size || min_size > max_size || !iterations ||
+	    iterations > ION_BENCH_MAX_ITERS || !max_threads ||
+	    max_threads > ION_BENCH_MAX_THREADS)
+		return -EINVAL;
+
+	memset(&pt, 0, sizeof(pt));
+	pt.iters = iterations;
+	pt.samples = vmalloc(ION_BENCH_MAX_THREADS * ION_BENCH_NUM_OPS *
+			     pt.iters * sizeof(u32));
+	merged = vmalloc(ION_BENCH_MAX_THREADS * pt.iters * sizeof(u32));
+	pt.client = ion_client_create(omap_ion_device, -1, "ion_bench");
+	pt.importer = ion_client_create(omap_ion_device, -1,
+					"ion_bench_import");
+	if (!pt.samples || !merged || IS_ERR_OR_NULL(pt.client) ||
+	    IS_ERR_OR_NULL(pt.importer)) {
+		r = -ENOMEM;
+		goto out;
+	}
+
+	ion_bench_clear();
+
+	for (heap = 0; heap < ARRAY_SIZE(ion_bench_heaps); heap++) {
+		bool tiler = heap == OMAP_ION_HEAP_TILER ||
+			     heap == OMAP_ION_HEAP_NONSECURE_TILER;
+
+		if (!(heap_mask & (1 << heap)))
+			continue;
+
+		for (fmt = tiler ? 0 : -1;
+		     fmt < (tiler ? (int)ARRAY_SIZE(ion_bench_fmts) : 0);
+		     fmt++) {
+			if (fmt >= 0 && !(tiler_fmts & (1 << fmt)))
+				continue;
+
+			pt.heap = heap;
+			pt.fmt = fmt;
+			for (pt.size = min_size; pt.size <= max_size;
+			     pt.size <<= 1) {
+				for (pt.threads = 1;
+				     pt.threads <= max_threads;
+				     pt.threads <<= 1) {
+					r = ion_bench_point(&pt, merged);
+					if (r)
+						goto out;
+				}
+			}
+		}
+	}
+
+out:
+	if (!IS_ERR_OR_NULL(pt.importer))
+		ion_client_destroy(pt.importer);
+	if (!IS_ERR_OR_NULL(pt.client))
+		ion_client_destroy(pt.client);
+	vfree(merged);
+	vfree(pt.samples);
+	return r;
+}
+
+static int ion_bench_run_set(void *data, u64 val)
+{
+	int r;
+
+	if (!val)
+		return 0;
+
+	mutex_lock(&ion_bench_lock);
+	r = ion_bench_run();
+	mutex_unlock(&ion_bench_lock);
+
+	return r;
+}
+DEFINE_SIMPLE_ATTRIBUTE(ion_bench_run_fops, NULL, ion_bench_run_set,
+			"%llu\n");
+
+static int ion_bench_results_show(struct seq_file *s, void *unused)
+{
+	struct ion_bench_result *res;
+	u64 ops, mbs;
+
+	seq_printf(s, "%-16s %-6s %9s %3s %-10s %8s %8s %8s %8s %8s %8s %6s\n",
+		   "heap", "fmt", "size", "thr", "op", "p50 us", "p90 us",
+		   "p99 us", "max us", "ops/s", "MB/s", "failed");
+
+	mutex_lock(&ion_bench_lock);
+	list_for_each_entry(res, &ion_bench_results, node) {
+		ops = res->wall_ns ?
+			div64_u64((u64)res->count * NSEC_PER_SEC,
+				  res->wall_ns) : 0;
+		mbs = div_u64(ops * res->size, SZ_1M);
+
+		seq_printf(s, "%-16s %-6s %9zu %3d %-10s "
+			   "%8u %8u %8u %8u %8llu %8llu %6d\n",
+			   ion_bench_heaps[res->heap],
+			   res->fmt < 0 ? "-" : ion_bench_fmts[res->fmt],
+			   res->size, res->threads, ion_bench_ops[res->op],
+			   res->p50 / NSEC_PER_USEC, res->p90 / NSEC_PER_USEC,
+			   res->p99 / NSEC_PER_USEC, res->max / NSEC_PER_USEC,
+			   ops, mbs, res->failed);
+	}
+	mutex_unlock(&ion_bench_lock);
+
+	return 0;
+}
+
+static int ion_bench_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ion_bench_results_show, NULL);
+}
+
+static const struct file_operations ion_bench_results_fops = {
+	.open		= ion_bench_results_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static struct dentry *ion_bench_dir;
+
+static int __init ion_bench_init(void)
+{
+	ion_bench_dir = debugfs_create_dir("ion_bench", NULL);
+	if (IS_ERR_OR_NULL(ion_bench_dir))
+		return -ENODEV;
+
+	debugfs_create_x32("heap_mask", S_IRUGO | S_IWUSR, ion_bench_dir,
+			   &heap_mask);
+	debugfs_create_x32("tiler_fmts", S_IRUGO | S_IWUSR, ion_bench_dir,
+			   &tiler_fmts);
+	debugfs_create_u32("min_size", S_IRUGO | S_IWUSR, ion_bench_dir,
+			   &min_size);
+	debugfs_create_u32("max_size", S_IRUGO | S_IWUSR, ion_bench_dir,
+			   &max_size);
+	debugfs_create_u32("max_threads", S_IRUGO | S_IWUSR, ion_bench_dir,
+			   &max_threads);
+	debugfs_create_u32("iterations", S_IRUGO | S_IWUSR, ion_bench_dir,
+			   &iterations);
+	debugfs_create_file("run", S_IWUSR, ion_bench_dir, NULL,
+			    &ion_bench_run_fops);
+	debugfs_create_file("results", S_IRUGO, ion_bench_dir, NULL,
+			    &ion_bench_results_fops);
+
+	return 0;
+}
+
+static void __exit ion_bench_exit(void)
+{
+	debugfs_remove_recursive(ion_bench_dir);
+
+	mutex_lock(&ion_bench_lock);
+	ion_bench_clear();
+	mutex_unlock(&ion_bench_lock);
+}
+
+module_init(ion_bench_init);
+module_exit(ion_bench_exit);
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("OMAP ion allocation and mapping benchmark");
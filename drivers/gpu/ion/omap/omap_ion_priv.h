@@ -22,6 +22,9 @@
 int omap_tiler_alloc(struct ion_heap *heap,
 		     struct ion_client *client,
 		     struct omap_ion_tiler_alloc_data *data);
+int omap_tiler_alloc_nv12(struct ion_heap *heap,
+			  struct ion_client *client,
+			  struct omap_ion_tiler_alloc_nv12_data *data);
 struct ion_heap *omap_tiler_heap_create(struct ion_platform_heap *heap_data);
 void omap_tiler_heap_destroy(struct ion_heap *heap);
 
@@ -18,12 +18,17 @@
 #include <linux/genalloc.h>
 #include <linux/io.h>
 #include <linux/ion.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/mm.h>
 #include <linux/omap_ion.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include "../../../drivers/staging/omapdrm/omap_dmm_tiler.h"
 #include <asm/mach/map.h>
+#include <asm/sizes.h>
 #include <asm/page.h>
 
 
@@ -61,24 +66,21 @@ struct omap_tiler_info {
 	u32 vstride;			/* virtual size of buffer */
 };
 
-int omap_tiler_alloc(struct ion_heap *heap,
-		     struct ion_client *client,
-		     struct omap_ion_tiler_alloc_data *data)
+/* reserve tiler space for the request and work out the pages that back it */
+static struct omap_tiler_info *tiler_info_create(
+		struct omap_ion_tiler_alloc_data *data)
 {
-	struct ion_handle *handle;
-	struct ion_buffer *buffer;
-	struct omap_tiler_info *info = NULL;
+	struct omap_tiler_info *info;
 	u32 n_phys_pages;
 	u32 n_tiler_pages;
-	ion_phys_addr_t addr = 0;
-	int i = 0, ret;
-	uint32_t phys_stride, remainder;
+	u32 phys_stride, remainder;
 	dma_addr_t ssptr;
+	int i;
 
 	if (data->fmt == TILFMT_PAGE && data->h != 1) {
 		pr_err("%s: Page mode (1D) allocations must have a height of "
 				"one\n", __func__);
-		return -EINVAL;
+		return ERR_PTR(-EINVAL);
 	}
 
 	if (data->fmt == TILFMT_PAGE) {
@@ -97,7 +99,7 @@ int omap_tiler_alloc(struct ion_heap *heap,
 		       sizeof(u32) * n_phys_pages +
 		       sizeof(u32) * n_tiler_pages, GFP_KERNEL);
 	if (!info)
-		return -ENOMEM;
+		return ERR_PTR(-ENOMEM);
 
 	info->n_phys_pages = n_phys_pages;
 	info->n_tiler_pages = n_tiler_pages;
@@ -114,10 +116,12 @@ int omap_tiler_alloc(struct ion_heap *heap,
 				data->h, PAGE_SIZE);
 
 	if (IS_ERR_OR_NULL(info->tiler_handle)) {
-		ret = PTR_ERR(info->tiler_handle);
+		int ret = PTR_ERR(info->tiler_handle);
+
 		pr_err("%s: failure to allocate address space from tiler\n",
 		       __func__);
-		goto err_got_mem;
+		kfree(info);
+		return ERR_PTR(ret);
 	}
 
 	/* get physical address of tiler buffer */
@@ -144,66 +148,231 @@ int omap_tiler_alloc(struct ion_heap *heap,
 		}
 	}
 
+	data->stride = info->vstride;
+	return info;
+}
+
+static void tiler_info_destroy(struct omap_tiler_info *info)
+{
+	tiler_release(info->tiler_handle);
+	kfree(info);
+}
+
+/* allocate physical pages for info, in one lump if possible */
+static int tiler_info_back(struct ion_heap *heap, struct omap_tiler_info *info)
+{
+	u32 n_phys_pages = info->n_phys_pages;
+	ion_phys_addr_t addr;
+	int i;
+
 	addr = ion_carveout_allocate(heap, n_phys_pages*PAGE_SIZE, 0);
-	if (addr == ION_CARVEOUT_ALLOCATE_FAIL) {
-		for (i = 0; i < n_phys_pages; i++) {
-			addr = ion_carveout_allocate(heap, PAGE_SIZE, 0);
-
-			if (addr == ION_CARVEOUT_ALLOCATE_FAIL) {
-				ret = -ENOMEM;
-				pr_err("%s: failed to allocate pages to back "
-					"tiler address space\n", __func__);
-				goto err_got_tiler;
-			}
-			info->phys_addrs[i] = addr;
-		}
-	} else {
+	/* freed buffers may still be waiting for the deferred free thread */
+	if (addr == ION_CARVEOUT_ALLOCATE_FAIL &&
+	    ion_heap_freelist_drain(heap, 0))
+		addr = ion_carveout_allocate(heap, n_phys_pages*PAGE_SIZE, 0);
+	if (addr != ION_CARVEOUT_ALLOCATE_FAIL) {
 		info->lump = true;
 		for (i = 0; i < n_phys_pages; i++)
 			info->phys_addrs[i] = addr + i*PAGE_SIZE;
+		return 0;
 	}
 
-	ret = tiler_pin_phys(info->tiler_handle, info->phys_addrs,
-			info->n_phys_pages);
-	if (ret) {
-		pr_err("%s: failure to pin pages to tiler\n", __func__);
-		goto err_got_tiler;
+	for (i = 0; i < n_phys_pages; i++) {
+		addr = ion_carveout_allocate(heap, PAGE_SIZE, 0);
+
+		if (addr == ION_CARVEOUT_ALLOCATE_FAIL) {
+			pr_err("%s: failed to allocate pages to back "
+				"tiler address space\n", __func__);
+			for (i -= 1; i >= 0; i--)
+				ion_carveout_free(heap, info->phys_addrs[i],
+						PAGE_SIZE);
+			return -ENOMEM;
+		}
+		info->phys_addrs[i] = addr;
 	}
 
-	data->stride = info->vstride;
+	return 0;
+}
+
+static void tiler_info_unback(struct ion_heap *heap,
+			      struct omap_tiler_info *info)
+{
+	if (info->lump) {
+		ion_carveout_free(heap, info->phys_addrs[0],
+				  info->n_phys_pages*PAGE_SIZE);
+	} else {
+		int i;
+		for (i = 0; i < info->n_phys_pages; i++)
+			ion_carveout_free(heap, info->phys_addrs[i],
+					  PAGE_SIZE);
+	}
+}
+
+/* create an ion handle for a pinned allocation */
+static int tiler_info_handle(struct ion_heap *heap, struct ion_client *client,
+			     struct omap_ion_tiler_alloc_data *data,
+			     struct omap_tiler_info *info)
+{
+	struct ion_handle *handle;
+	struct ion_buffer *buffer;
 
-	/* create an ion handle  for the allocation */
 	handle = ion_alloc(client, 0, 0, 1 << OMAP_ION_HEAP_TILER, 0);
 	if (IS_ERR_OR_NULL(handle)) {
-		ret = PTR_ERR(handle);
 		pr_err("%s: failure to allocate handle to manage "
 				"tiler allocation\n", __func__);
-		goto err;
+		return PTR_ERR(handle);
 	}
 
 	buffer = ion_handle_buffer(handle);
-	buffer->size = n_tiler_pages * PAGE_SIZE;
+	buffer->size = info->n_tiler_pages * PAGE_SIZE;
 	buffer->priv_virt = info;
 	data->handle = handle;
 	data->offset = (size_t)(info->tiler_start & ~PAGE_MASK);
 
 	return 0;
+}
+
+int omap_tiler_alloc(struct ion_heap *heap,
+		     struct ion_client *client,
+		     struct omap_ion_tiler_alloc_data *data)
+{
+	struct omap_tiler_info *info;
+	int ret;
+
+	info = tiler_info_create(data);
+	if (IS_ERR(info))
+		return PTR_ERR(info);
+
+	ret = tiler_info_back(heap, info);
+	if (ret)
+		goto err_got_tiler;
+
+	ret = tiler_pin_phys(info->tiler_handle, info->phys_addrs,
+			info->n_phys_pages);
+	if (ret) {
+		pr_err("%s: failure to pin pages to tiler\n", __func__);
+		goto err_got_mem;
+	}
+
+	ret = tiler_info_handle(heap, client, data, info);
+	if (ret)
+		goto err;
+
+	return 0;
 
 err:
 	tiler_unpin(info->tiler_handle);
+err_got_mem:
+	tiler_info_unback(heap, info);
 err_got_tiler:
-	tiler_release(info->tiler_handle);
-	if (info) {
-		if (info->lump) {
-			ion_carveout_free(heap, addr, n_phys_pages * PAGE_SIZE);
-		} else {
-			for (i -= 1; i >= 0; i--)
-				ion_carveout_free(heap, info->phys_addrs[i],
-						PAGE_SIZE);
+	tiler_info_destroy(info);
+	return ret;
+}
+
+/*
+ * Allocate both planes of an NV12 buffer.  The caller fills in planes[0]
+ * for the 8-bit Y plane; the 16-bit UV plane is derived from it.  The
+ * backing pages are allocated together and both planes are pinned in a
+ * single DMM refill.  Each plane gets its own handle.
+ */
+int omap_tiler_alloc_nv12(struct ion_heap *heap,
+			  struct ion_client *client,
+			  struct omap_ion_tiler_alloc_nv12_data *data)
+{
+	struct omap_ion_tiler_alloc_data *y = &data->planes[0];
+	struct omap_ion_tiler_alloc_data *uv = &data->planes[1];
+	struct omap_tiler_info *info[2];
+	struct tiler_block *blocks[2];
+	u32 *phys_addrs[2], num_pages[2];
+	ion_phys_addr_t addr = ION_CARVEOUT_ALLOCATE_FAIL;
+	int i, ret;
+
+	if (y->fmt != TILER_PIXEL_FMT_8BIT || !y->w || !y->h) {
+		pr_err("%s: Y plane must be a non-empty 8-bit allocation\n",
+				__func__);
+		return -EINVAL;
+	}
+
+	*uv = *y;
+	uv->fmt = TILER_PIXEL_FMT_16BIT;
+	uv->w = DIV_ROUND_UP(y->w, 2);
+	uv->h = DIV_ROUND_UP(y->h, 2);
+
+	info[0] = tiler_info_create(y);
+	if (IS_ERR(info[0]))
+		return PTR_ERR(info[0]);
+	info[1] = tiler_info_create(uv);
+	if (IS_ERR(info[1])) {
+		ret = PTR_ERR(info[1]);
+		goto err_got_y;
+	}
+
+	/*
+	 * Back both planes from one lump when the heap allows freeing part of
+	 * an allocation; size class heaps only free what they handed out.
+	 */
+	if (!(heap->flags & ION_HEAP_FLAG_SIZE_CLASS))
+		addr = ion_carveout_allocate(heap, (info[0]->n_phys_pages +
+				info[1]->n_phys_pages) * PAGE_SIZE, 0);
+	if (addr != ION_CARVEOUT_ALLOCATE_FAIL) {
+		for (i = 0; i < 2; i++) {
+			int j;
+
+			info[i]->lump = true;
+			for (j = 0; j < info[i]->n_phys_pages; j++) {
+				info[i]->phys_addrs[j] = addr;
+				addr += PAGE_SIZE;
+			}
+		}
+	} else {
+		ret = tiler_info_back(heap, info[0]);
+		if (ret)
+			goto err_got_tiler;
+		ret = tiler_info_back(heap, info[1]);
+		if (ret) {
+			tiler_info_unback(heap, info[0]);
+			goto err_got_tiler;
 		}
 	}
+
+	for (i = 0; i < 2; i++) {
+		blocks[i] = info[i]->tiler_handle;
+		phys_addrs[i] = info[i]->phys_addrs;
+		num_pages[i] = info[i]->n_phys_pages;
+	}
+
+	ret = tiler_pin_phys_multi(blocks, phys_addrs, num_pages, 2);
+	if (ret) {
+		pr_err("%s: failure to pin pages to tiler\n", __func__);
+		goto err_got_mem;
+	}
+
+	ret = tiler_info_handle(heap, client, y, info[0]);
+	if (ret)
+		goto err;
+
+	ret = tiler_info_handle(heap, client, uv, info[1]);
+	if (ret) {
+		/* this frees the Y plane */
+		ion_free(client, y->handle);
+		tiler_unpin(info[1]->tiler_handle);
+		tiler_info_unback(heap, info[1]);
+		tiler_info_destroy(info[1]);
+		return ret;
+	}
+
+	return 0;
+
+err:
+	tiler_unpin(info[0]->tiler_handle);
+	tiler_unpin(info[1]->tiler_handle);
 err_got_mem:
-	kfree(info);
+	tiler_info_unback(heap, info[0]);
+	tiler_info_unback(heap, info[1]);
+err_got_tiler:
+	tiler_info_destroy(info[1]);
+err_got_y:
+	tiler_info_destroy(info[0]);
 	return ret;
 }
 
@@ -212,18 +381,8 @@ static void omap_tiler_heap_free(struct ion_buffer *buffer)
 	struct omap_tiler_info *info = buffer->priv_virt;
 
 	tiler_unpin(info->tiler_handle);
-	tiler_release(info->tiler_handle);
-
-	if (info->lump) {
-		ion_carveout_free(buffer->heap, info->phys_addrs[0],
-				  info->n_phys_pages*PAGE_SIZE);
-	} else {
-		int i;
-		for (i = 0; i < info->n_phys_pages; i++)
-			ion_carveout_free(buffer->heap,
-					  info->phys_addrs[i], PAGE_SIZE);
-	}
-
+	tiler_recycle(info->tiler_handle);
+	tiler_info_unback(buffer->heap, info);
 	kfree(info);
 }
 
@@ -312,6 +471,62 @@ static void per_cpu_cache_flush_arm(void *arg)
 	   flush_cache_all();
 }
 
+/*
+ * Buffer size above which flushing the whole cache is cheaper than range
+ * operations, measured by tiler_measure_flush_threshold().
+ */
+static size_t tiler_flush_threshold = FULL_CACHE_FLUSH_THRESHOLD;
+static bool tiler_flush_measured;
+
+#define FLUSH_BENCH_SIZE	SZ_64K
+#define FLUSH_BENCH_LOOPS	4
+
+/*
+ * Time a full L1 + L2 flush against range maintenance of a cached buffer
+ * and set the crossover point from that.  The fastest of a few runs is
+ * used to discount interrupts and cold TLBs.
+ */
+static void tiler_measure_flush_threshold(void)
+{
+	s64 t_full = LLONG_MAX, t_range = LLONG_MAX, t;
+	ktime_t start;
+	void *buf;
+	int i;
+
+	buf = kmalloc(FLUSH_BENCH_SIZE, GFP_KERNEL);
+	if (!buf)
+		return;
+
+	for (i = 0; i < FLUSH_BENCH_LOOPS; i++) {
+		memset(buf, i, FLUSH_BENCH_SIZE);
+		start = ktime_get();
+		__cpuc_flush_dcache_area(buf, FLUSH_BENCH_SIZE);
+		outer_flush_range(virt_to_phys(buf),
+				  virt_to_phys(buf) + FLUSH_BENCH_SIZE);
+		t = ktime_to_ns(ktime_sub(ktime_get(), start));
+		t_range = min(t_range, t);
+
+		memset(buf, i, FLUSH_BENCH_SIZE);
+		preempt_disable();
+		start = ktime_get();
+		flush_cache_all();
+		preempt_enable();
+		outer_flush_all();
+		t = ktime_to_ns(ktime_sub(ktime_get(), start));
+		t_full = min(t_full, t);
+	}
+	kfree(buf);
+
+	if (t_range <= 0)
+		return;
+
+	tiler_flush_threshold = clamp_t(s64,
+			div64_s64(t_full * FLUSH_BENCH_SIZE, t_range),
+			FLUSH_BENCH_SIZE, SZ_8M);
+	pr_info("%s: full cache flush above %zu bytes\n", __func__,
+			tiler_flush_threshold);
+}
+
 static int omap_tiler_cache_operation(struct ion_buffer *buffer, size_t len,
 			unsigned long vaddr, enum cache_operation cacheop)
 {
@@ -345,8 +560,13 @@ static int omap_tiler_cache_operation(struct ion_buffer *buffer, size_t len,
 		return -EINVAL;
 	}
 
-	if (len > FULL_CACHE_FLUSH_THRESHOLD) {
-		on_each_cpu(per_cpu_cache_flush_arm, NULL, 1);
+	/*
+	 * Only cpus that have run this mm can hold lines of the user mapping,
+	 * the L2 is shared so a single flush covers it.
+	 */
+	if (len > tiler_flush_threshold) {
+		on_each_cpu_mask(mm_cpumask(current->mm),
+				 per_cpu_cache_flush_arm, NULL, 1);
 		outer_flush_all();
 		return 0;
 	}
@@ -439,10 +659,27 @@ struct ion_heap *omap_tiler_heap_create(struct ion_platform_heap *data)
 	heap->type = OMAP_ION_HEAP_TYPE_TILER;
 	heap->name = data->name;
 	heap->id = data->id;
+	heap->flags = data->flags;
+
+	/* both tiler heaps share the caches, measure once */
+	if (!tiler_flush_measured) {
+		tiler_measure_flush_threshold();
+		tiler_flush_measured = true;
+	}
+
+	if (data->priv) {
+		struct omap_ion_tiler_heap_data *tdata = data->priv;
+
+		tiler_set_recycle_size(tdata->recycle_blocks);
+	}
 	return heap;
 }
 
 void omap_tiler_heap_destroy(struct ion_heap *heap)
 {
+	if (heap->task) {
+		kthread_stop(heap->task);
+		ion_heap_freelist_drain(heap, 0);
+	}
 	kfree(heap);
 }
@@ -69,13 +69,16 @@ static int ti_gfx_buf_allocate_planes(void* buf_mgr_cxt,
                                         ti_gfx_buf_t *gfx_buf,
                                         ti_gfx_buf_req_t* req);
 
-/* Obtain a handle for the buffer */
-static int ti_gfx_buf_get_name(ti_gfx_buf_t *gfx_buf)
+/* Obtain handles for a batch of buffers, taking the idr lock once per
+ * preallocation rather than once per buffer. On failure the buffers named
+ * so far keep their names; ti_gfx_buf_release_name() drops them */
+static int ti_gfx_buf_get_names(ti_gfx_buf_t **gfx_bufs, unsigned int n)
 {
-        int ret;
+        int ret = 0;
+        unsigned int i = 0;
         unsigned long flags;
 
-        do {
+        while (i < n) {
                 if (idr_pre_get(&ti_gfx_buf_names_idr, GFP_KERNEL) == 0) {
                         ret = -ENOMEM;
                         return ret;
@@ -83,24 +86,36 @@ static int ti_gfx_buf_get_name(ti_gfx_buf_t *gfx_buf)
 
                 spin_lock_irqsave(&ti_gfx_buf_idr_lock, flags);
 
-                /* Deal with the name roll-over.
-                 * 0 is an invalid name for gfx_buf */
-                if(ti_gfx_buf_next_idr_name == 0)
-                        ti_gfx_buf_next_idr_name++;
+                for (; i < n; i++) {
+                        /* Deal with the name roll-over.
+                         * 0 is an invalid name for gfx_buf */
+                        if(ti_gfx_buf_next_idr_name == 0)
+                                ti_gfx_buf_next_idr_name++;
+
+                        /* Register the object and get a name */
+                        ret = idr_get_new_above(&ti_gfx_buf_names_idr,
+                                                gfx_bufs[i],
+                                                ti_gfx_buf_next_idr_name,
+                                                &gfx_bufs[i]->name);
+                        if (ret)
+                                break;
 
-                /* Register the object and get a name */
-                ret = idr_get_new_above(&ti_gfx_buf_names_idr, gfx_buf,
-                                        ti_gfx_buf_next_idr_name++,
-                                        &gfx_buf->name);
+                        ti_gfx_buf_next_idr_name = gfx_bufs[i]->name + 1;
+                }
 
                 spin_unlock_irqrestore(&ti_gfx_buf_idr_lock, flags);
 
                 if ((ret != -EAGAIN) && (ret != 0))
                         return ret;
+        }
 
-        } while(ret == -EAGAIN);
+        return 0;
+}
 
-        return ret;
+/* Obtain a handle for the buffer */
+static int ti_gfx_buf_get_name(ti_gfx_buf_t *gfx_buf)
+{
+        return ti_gfx_buf_get_names(&gfx_buf, 1);
 }
 
 /* Release the handle of the buffer */
@@ -353,13 +368,109 @@ static size_t get_ti_gfx_buf_size(unsigned int num_planes)
                 ((num_planes - 1) * sizeof(ti_gfx_buf_plane_t)));
 }
 
+/* How many planes does the request describe */
+static unsigned int ti_gfx_buf_count_planes(ti_gfx_buf_req_t* req)
+{
+        unsigned i, num_planes = 0;
+
+        for(i = 0; i < TI_MAX_SUB_ALLOCS; i++) {
+                if(!req->planes[i].params.mem_flags)
+                        break;
+
+                num_planes++;
+        }
+
+        /* At least one valid plane must exist */
+        if(!num_planes)
+                pr_err("%s: Invalid all planes mem_flags == 0\n",
+                       __func__);
+
+        return num_planes;
+}
+
+/* Allocate an unnamed ti_gfx_buf and reset the request's output fds */
+static ti_gfx_buf_t *ti_gfx_buf_alloc(unsigned int num_planes,
+                                        ti_gfx_buf_req_t* req)
+{
+        ti_gfx_buf_t *gfx_buf;
+        unsigned i;
+
+        gfx_buf = kzalloc(get_ti_gfx_buf_size(num_planes), GFP_KERNEL);
+        if (gfx_buf == NULL) {
+                pr_err("%s: Can't allocate object - out-of-memory\n",
+                       __func__);
+                return NULL;
+        }
+
+        gfx_buf->num_planes = num_planes;
+        mutex_init(&gfx_buf->lock);
+
+        for(i = 0; i < TI_MAX_SUB_ALLOCS; i++)
+                req->planes[i].export_fd = -1;
+
+        req->sync_fd = -1;
+
+        return gfx_buf;
+}
+
+/* Close the per-plane fds handed out to the user */
+static void ti_gfx_buf_close_export_fds(ti_gfx_buf_req_t* req)
+{
+        unsigned i;
+
+        for(i = 0; i < TI_MAX_SUB_ALLOCS; i++) {
+                if(req->planes[i].export_fd >= 0) {
+                        sys_close(req->planes[i].export_fd);
+                        req->planes[i].export_fd = -1;
+                }
+        }
+}
+
+/* Get a Fd for the user, through which the named gfx_buf lives */
+static int ti_gfx_buf_install_fd(ti_gfx_buf_t *gfx_buf,
+                                   ti_gfx_buf_req_t* req)
+{
+        int fd;
+
+        fd = anon_inode_getfd("ti_gfx_buf", &ti_gfx_buf_fops,
+                              gfx_buf, O_CLOEXEC);
+        if (IS_ERR_VALUE(fd)) {
+                pr_err("%s: Can't allocate buffer's inode & fd - %d\n",
+                       __func__, fd);
+                return -ENOMEM;
+        }
+
+        /* and a file inode */
+        gfx_buf->file = fget(fd);
+        /* The sync_fd should have a valid file,
+         * associated with it.
+         */
+        BUG_ON(!gfx_buf->file);
+
+        /* Need only one reference for the user,
+         * so when the user closes the fd,
+         * the gfx_buf goes away
+         */
+        fput(gfx_buf->file);
+
+        req->sync_fd = fd;
+
+        /* Send the gfx_buf name back to client */
+        req->name = gfx_buf->name;
+
+        return 0;
+}
+
 /* Create a new ti_gfx_buf */
 int ti_gfx_buf_create(void* buf_mgr_cxt,
                         ti_gfx_buf_req_t* req)
 {
         ti_gfx_buf_t *gfx_buf;
         int ret;
-        unsigned i, num_planes = 0;
+        unsigned num_planes;
+#ifdef DEBUG_TIGFX_BUF_DUMP_PARAMS
+        unsigned i;
+#endif
 
 
 #ifdef DEBUG_TIGFX_BUF_DUMP_PARAMS
@@ -389,36 +500,13 @@ int ti_gfx_buf_create(void* buf_mgr_cxt,
         }
 #endif
 
-        /* How many planes do we need */
-        for(i = 0; i < TI_MAX_SUB_ALLOCS; i++) {
-                if(!req->planes[i].params.mem_flags)
-                        break;
-
-                num_planes++;
-        }
-
-        /* At least one valid plane must exist */
-        if(!num_planes) {
-                pr_err("%s: Invalid all planes mem_flags == 0\n",
-                       __func__);
+        num_planes = ti_gfx_buf_count_planes(req);
+        if(!num_planes)
                 return -EINVAL;
-        }
 
-        gfx_buf = kzalloc(get_ti_gfx_buf_size(num_planes), GFP_KERNEL);
-        if (gfx_buf == NULL) {
-                pr_err("%s: Can't allocate object - out-of-memory\n",
-                       __func__);
-                ret = -ENOMEM;
-                return ret;
-        }
-
-        gfx_buf->num_planes = num_planes;
-        mutex_init(&gfx_buf->lock);
-
-        for(i = 0; i < TI_MAX_SUB_ALLOCS; i++)
-                req->planes[i].export_fd = -1;
-
-        req->sync_fd = -1;
+        gfx_buf = ti_gfx_buf_alloc(num_planes, req);
+        if (gfx_buf == NULL)
+                return -ENOMEM;
 
         /* Allocate the buffers first */
         ret = ti_gfx_buf_allocate_planes(buf_mgr_cxt, gfx_buf, req);
@@ -433,38 +521,15 @@ int ti_gfx_buf_create(void* buf_mgr_cxt,
         if(IS_ERR_VALUE(ret)) {
                 pr_err("%s: Can't allocate buffer's common name - %d\n",
                        __func__, ret);
-                ti_gfx_buf_free_planes(gfx_buf);
-                goto err;
+                goto err_planes;
         }
 
-        /* Get a Fd for the user */
-        req->sync_fd = anon_inode_getfd("ti_gfx_buf", &ti_gfx_buf_fops,
-                                        gfx_buf, O_CLOEXEC);
-        if (IS_ERR_VALUE(req->sync_fd)) {
-                pr_err("%s: Can't allocate buffer's inode & fd - %d\n",
-                       __func__, ret);
-                ti_gfx_buf_free_planes(gfx_buf);
+        ret = ti_gfx_buf_install_fd(gfx_buf, req);
+        if(IS_ERR_VALUE(ret)) {
                 ti_gfx_buf_release_name(gfx_buf);
-                ret = -ENOMEM;
-                goto err;
+                goto err_planes;
         }
 
-        /* and a file inode */
-        gfx_buf->file = fget(req->sync_fd);
-        /* The sync_fd should have a valid file,
-         * associated with it.
-         */
-        BUG_ON(!gfx_buf->file);
-
-        /* Need only one reference for the user,
-         * so when the user closes the fd,
-         * the gfx_buf goes away
-         */
-        fput(gfx_buf->file);
-
-        /* Send the gfx_buf name back to client */
-        req->name = gfx_buf->name;
-
 #ifdef DEBUG_TIGFX_BUF_DUMP_PARAMS
         {
                 gfx_buf_info("<= Return: gfx_buf buffer parameters with "
@@ -500,12 +565,87 @@ int ti_gfx_buf_create(void* buf_mgr_cxt,
 
         return ret;
 
+err_planes:
+        ti_gfx_buf_close_export_fds(req);
+        ti_gfx_buf_free_planes(gfx_buf);
 err:
         kfree(gfx_buf);
         return ret;
 }
 EXPORT_SYMBOL(ti_gfx_buf_create);
 
+/* Create num_bufs identical ti_gfx_bufs. The planes of all the buffers are
+ * allocated back to back before any of them is named, so same sized TILER
+ * blocks are reserved next to each other and the names come from a single
+ * batch. Either all the buffers are created or none is. */
+int ti_gfx_buf_create_bulk(void* buf_mgr_cxt, ti_gfx_buf_req_t* req,
+                           ti_gfx_buf_req_t* bufs, unsigned int num_bufs)
+{
+        ti_gfx_buf_t *gfx_bufs[TI_GFX_BUF_MAX_BULK];
+        unsigned i, n, num_planes;
+        int ret = 0;
+
+        if (!num_bufs || num_bufs > TI_GFX_BUF_MAX_BULK) {
+                pr_err("%s: Invalid number of buffers %u\n",
+                       __func__, num_bufs);
+                return -EINVAL;
+        }
+
+        num_planes = ti_gfx_buf_count_planes(req);
+        if(!num_planes)
+                return -EINVAL;
+
+        for (n = 0; n < num_bufs; n++) {
+                bufs[n] = *req;
+
+                gfx_bufs[n] = ti_gfx_buf_alloc(num_planes, &bufs[n]);
+                if (gfx_bufs[n] == NULL) {
+                        ret = -ENOMEM;
+                        goto err;
+                }
+
+                ret = ti_gfx_buf_allocate_planes(buf_mgr_cxt, gfx_bufs[n],
+                                                 &bufs[n]);
+                if(IS_ERR_VALUE(ret)) {
+                        pr_err("%s: Can't allocate planes of buffer %u - %d\n",
+                               __func__, n, ret);
+                        kfree(gfx_bufs[n]);
+                        goto err;
+                }
+        }
+
+        ret = ti_gfx_buf_get_names(gfx_bufs, num_bufs);
+        if(IS_ERR_VALUE(ret)) {
+                pr_err("%s: Can't allocate buffers' common names - %d\n",
+                       __func__, ret);
+                goto err;
+        }
+
+        for (i = 0; i < num_bufs; i++) {
+                ret = ti_gfx_buf_install_fd(gfx_bufs[i], &bufs[i]);
+                if(IS_ERR_VALUE(ret))
+                        goto err;
+        }
+
+        return 0;
+
+err:
+        for (i = 0; i < n; i++) {
+                /* Closing the fd releases the name and the planes */
+                if (bufs[i].sync_fd >= 0) {
+                        sys_close(bufs[i].sync_fd);
+                        bufs[i].sync_fd = -1;
+                } else {
+                        ti_gfx_buf_release_name(gfx_bufs[i]);
+                        ti_gfx_buf_free_planes(gfx_bufs[i]);
+                        kfree(gfx_bufs[i]);
+                }
+                ti_gfx_buf_close_export_fds(&bufs[i]);
+        }
+        return ret;
+}
+EXPORT_SYMBOL(ti_gfx_buf_create_bulk);
+
 /* Obtains a ti_gfx_buf object from a fd
  * increments the object reference count */
 ti_gfx_buf_t *ti_gfx_buf_fdget(int fd)
@@ -657,6 +797,122 @@ static void ti_gfx_buf_free_planes(ti_gfx_buf_t *gfx_buf)
         }
 }
 
+/* Get the 2D buffer stride in pixels */
+static __u16 ti_gfx_buf_stride_pixels(ti_gfx_buf_params_t *params,
+                                      u32 stride_bytes)
+{
+        unsigned int bytes_per_pixel = (params->bpp >> 3);
+
+        if(bytes_per_pixel == 0)
+                bytes_per_pixel = 1;
+
+        return stride_bytes / bytes_per_pixel;
+}
+
+/* Export the ION handle of a plane to the user and keep a dma-buf reference
+ * for gfx_buf. The handle itself is released either way */
+static int ti_gfx_buf_export_plane(struct ion_client* client,
+                                   ti_gfx_buf_t *gfx_buf,
+                                   ti_gfx_buf_req_t* req, unsigned i,
+                                   struct ion_handle* handle,
+                                   __u16 stride_pixels, __u32 offset_bytes)
+{
+        /* Get the dma_buf representing the handle */
+        /* This fd holds one reference for the ION handle.
+         * It goes to the client */
+        req->planes[i].export_fd = ion_share_dma_buf(client, handle);
+        if(IS_ERR_VALUE(req->planes[i].export_fd)) {
+                pr_err("%s: Could not export ION handle to dma-buf for "
+                       "gfx_buf: %p\n", __func__, gfx_buf);
+                ion_free(client, handle);
+                return req->planes[i].export_fd;
+        }
+
+        /* Obtain the dmabuf from the fd, taking an extra reference
+         * to it.
+         * This extra reference of dmabuf ensures the buffer does not
+         * go away, while in use by gfx_buf clients during rendering
+         * and sync. */
+        gfx_buf->planes[i].dmabuf = dma_buf_get(
+                req->planes[i].export_fd);
+        /* dmabuf should never be invalid if we got an fd above */
+        BUG_ON(gfx_buf->planes[i].dmabuf == NULL);
+
+        /* Got dma_buf, we do not need the handle anymore */
+        ion_free(client, handle);
+
+        req->planes[i].params.stride_pixels = stride_pixels;
+        req->planes[i].params.offset_bytes = offset_bytes;
+        req->planes[i].params.size_bytes =
+                gfx_buf->planes[i].dmabuf->size;
+
+        memcpy(&gfx_buf->planes[i].params, &req->planes[i].params,
+               sizeof(gfx_buf->planes[i].params));
+
+        return 0;
+}
+
+/* Is planes[i] an NV12 Y plane, followed by its UV plane ? */
+static bool ti_gfx_buf_is_nv12_pair(ti_gfx_buf_req_t* req, unsigned i)
+{
+        ti_gfx_buf_params_t *y = &req->planes[i].params;
+        ti_gfx_buf_params_t *uv = &req->planes[i + 1].params;
+        __u32 same_flags = TI_MEM_TYPE_CACHED | TI_MEM_TYPE_MAP_CPU_PAGEABLE |
+                TI_MEM_TYPE_FB_VRAM;
+
+        if((y->mem_flags & TI_MEM_TYPE_TILER) != TI_MEM_TYPE_TILER_8BIT ||
+           (uv->mem_flags & TI_MEM_TYPE_TILER) != TI_MEM_TYPE_TILER_16BIT)
+                return false;
+
+        if((y->mem_flags ^ uv->mem_flags) & same_flags)
+                return false;
+
+        return uv->width == DIV_ROUND_UP(y->width, 2) &&
+                uv->height == DIV_ROUND_UP(y->height, 2);
+}
+
+/* Allocate the Y and UV planes of an NV12 pair from one TILER request */
+static int ti_gfx_buf_allocate_nv12(struct ion_client* client,
+                                    ti_gfx_buf_t *gfx_buf,
+                                    ti_gfx_buf_req_t* req, unsigned i,
+                                    unsigned int flags)
+{
+        struct omap_ion_tiler_alloc_nv12_data nv12;
+        unsigned j;
+        int ret;
+
+        memset(&nv12, 0x00, sizeof(nv12));
+
+        nv12.planes[0].w = req->planes[i].params.width;
+        nv12.planes[0].h = req->planes[i].params.height;
+        nv12.planes[0].fmt = TILFMT_8BIT;
+        nv12.planes[0].flags = flags;
+
+        ret = omap_ion_tiler_alloc_nv12(client, &nv12);
+        if(IS_ERR_VALUE(ret)) {
+                pr_err("%s: Could not allocate NV12 tiler memory "
+                       "for gfx_buf: %p\n", __func__, gfx_buf);
+                ti_gfx_buf_mem_flag_dump(req->planes[i].params.mem_flags);
+                return ret;
+        }
+
+        for(j = 0; j < 2; j++) {
+                ret = ti_gfx_buf_export_plane(client, gfx_buf, req, i + j,
+                                nv12.planes[j].handle,
+                                ti_gfx_buf_stride_pixels(
+                                        &req->planes[i + j].params,
+                                        nv12.planes[j].stride),
+                                (__u32)nv12.planes[j].offset);
+                if(IS_ERR_VALUE(ret)) {
+                        if(j == 0)
+                                ion_free(client, nv12.planes[1].handle);
+                        return ret;
+                }
+        }
+
+        return 0;
+}
+
 /* Allocate buffers for gfx_buf */
 static int ti_gfx_buf_allocate_planes(void* buf_mgr_cxt,
                                         ti_gfx_buf_t *gfx_buf,
@@ -717,6 +973,17 @@ static int ti_gfx_buf_allocate_planes(void* buf_mgr_cxt,
 
                         /* TODO: End of the code above to go away with ION FB_VRAM */
 
+                }/* Is that an NV12 pair, allocated and pinned together ? */
+                else if((i + 1 < gfx_buf->num_planes) &&
+                        ti_gfx_buf_is_nv12_pair(req, i)) {
+                        ret = ti_gfx_buf_allocate_nv12(client, gfx_buf, req,
+                                                       i, flags);
+                        if(IS_ERR_VALUE(ret))
+                                break;
+
+                        /* Both planes are done */
+                        i++;
+                        continue;
                 }/* Is that a tiler allocation ? */
                 else if(req->planes[i].params.mem_flags & TI_MEM_TYPE_TILER) {
                         struct omap_ion_tiler_alloc_data tiler_alloc;
@@ -746,16 +1013,11 @@ static int ti_gfx_buf_allocate_planes(void* buf_mgr_cxt,
                         if(!IS_ERR_VALUE(ret)) {
                                 handle = tiler_alloc.handle;
                                 if(!(req->planes[i].params.mem_flags &
-                                                TI_MEM_TYPE_TILER_PAGE)) {
-                                        unsigned int bytes_per_pixel =
-                                                (req->planes[i].params.bpp >> 3);
-                                        /* Get the 2D buffer stride in pixels */
-                                        if(bytes_per_pixel == 0)
-                                                bytes_per_pixel = 1;
-
-                                        stride_pixels = tiler_alloc.stride /
-                                                bytes_per_pixel;
-                                }
+                                                TI_MEM_TYPE_TILER_PAGE))
+                                        stride_pixels =
+                                                ti_gfx_buf_stride_pixels(
+                                                &req->planes[i].params,
+                                                tiler_alloc.stride);
                                 offset_bytes = (__u32)tiler_alloc.offset;
                         } else {
                                 pr_err("%s: Could not allocate tiler memory "
@@ -799,51 +1061,15 @@ static int ti_gfx_buf_allocate_planes(void* buf_mgr_cxt,
                         break;
                 }
 
-                /* Get the dma_buf representing the handle */
-                /* This fd holds one reference for the ION handle.
-                 * It goes to the client */
-                req->planes[i].export_fd = ion_share_dma_buf(client, handle);
-                if(IS_ERR_VALUE(req->planes[i].export_fd)) {
-                        pr_err("%s: Could not export ION handle to dma-buf for "
-                               "gfx_buf: %p\n", __func__, gfx_buf);
-                        ret = req->planes[i].export_fd;
+                ret = ti_gfx_buf_export_plane(client, gfx_buf, req, i, handle,
+                                              stride_pixels, offset_bytes);
+                if(IS_ERR_VALUE(ret))
                         break;
-                }
-
-                /* Obtain the dmabuf from the fd, taking an extra reference
-                 * to it.
-                 * This extra reference of dmabuf ensures the buffer does not
-                 * go away, while in use by gfx_buf clients during rendering
-                 * and sync. */
-                gfx_buf->planes[i].dmabuf = dma_buf_get(
-                        req->planes[i].export_fd);
-                /* dmabuf should never be invalid if we got an fd above */
-                BUG_ON(gfx_buf->planes[i].dmabuf == NULL);
-                if(gfx_buf->planes[i].dmabuf == NULL) {
-                        ret = -ENODEV;
-                        break;
-                }
-
-                /* Got dma_buf, we do not need the handle anymore */
-                ion_free(client, handle);
-
-                req->planes[i].params.stride_pixels = stride_pixels;
-                req->planes[i].params.offset_bytes = offset_bytes;
-                req->planes[i].params.size_bytes =
-                        gfx_buf->planes[i].dmabuf->size;
-
-                memcpy(&gfx_buf->planes[i].params, &req->planes[i].params,
-                       sizeof(gfx_buf->planes[i].params));
         }
 
         if(IS_ERR_VALUE(ret)) {
                 /* Clean-up the user handles first */
-                for(i = 0; i < gfx_buf->num_planes; i++) {
-                        if(req->planes[i].export_fd > 0) {
-                                sys_close(req->planes[i].export_fd);
-                                req->planes[i].export_fd = -1;
-                        }
-                }
+                ti_gfx_buf_close_export_fds(req);
 
                 /* Then release the buffers */
                 ti_gfx_buf_free_planes(gfx_buf);
@@ -958,6 +1184,35 @@ static long ti_gfx_buf_mgr_ioctl(struct file *filp, unsigned int cmd, unsigned l
                             return -EFAULT;
                     break;
             }
+            case TI_GFX_BUF_IOC_ALLOC_BUFS:
+            {
+                    ti_gfx_buf_bulk_req_t bulk_req;
+                    ti_gfx_buf_req_t *bufs;
+                    int ret;
+
+                    if (copy_from_user(&bulk_req, (void __user *)arg, sizeof(bulk_req)))
+                            return -EFAULT;
+
+                    if (!bulk_req.num_bufs ||
+                        bulk_req.num_bufs > TI_GFX_BUF_MAX_BULK)
+                            return -EINVAL;
+
+                    bufs = kcalloc(bulk_req.num_bufs, sizeof(*bufs), GFP_KERNEL);
+                    if (!bufs)
+                            return -ENOMEM;
+
+                    ret = ti_gfx_buf_create_bulk(client, &bulk_req.req, bufs,
+                                                 bulk_req.num_bufs);
+                    if (!ret && copy_to_user(
+                                (void __user *)(uintptr_t)bulk_req.bufs, bufs,
+                                bulk_req.num_bufs * sizeof(*bufs)))
+                            ret = -EFAULT;
+
+                    kfree(bufs);
+                    if (ret)
+                            return ret;
+                    break;
+            }
             case TI_GFX_BUF_IOC_GET_PARAMS:
             {
                     ti_gfx_buf_info_t buf_info;
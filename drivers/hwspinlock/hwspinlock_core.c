@@ -27,6 +27,10 @@
 #include <linux/hwspinlock.h>
 #include <linux/pm_runtime.h>
 #include <linux/mutex.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "hwspinlock_internal.h"
 
@@ -59,40 +63,28 @@ static RADIX_TREE(hwspinlock_tree, GFP_KERNEL);
  */
 static DEFINE_MUTEX(hwspinlock_tree_lock);
 
+/*
+ * A contended lock is polled with only the relax handler in between for
+ * HWSPINLOCK_SPIN_NS.  A lock held longer than that is usually held by a
+ * remote core for a whole transaction, so the polling then backs off
+ * exponentially: with udelay() for spinlock type locks, whose users may be
+ * atomic, and with usleep_range() for mutex type locks.
+ */
+#define HWSPINLOCK_SPIN_NS		(10 * NSEC_PER_USEC)
+#define HWSPINLOCK_MAX_DELAY_US		16
+#define HWSPINLOCK_MIN_SLEEP_US		50
+#define HWSPINLOCK_MAX_SLEEP_US		1000
 
-/**
- * __hwspin_trylock() - attempt to lock a specific hwspinlock
- * @hwlock: an hwspinlock which we want to trylock
- * @mode: controls whether local interrupts are disabled or not
- * @flags: a pointer where the caller's interrupt state will be saved at (if
- *         requested)
- *
- * This function attempts to lock an hwspinlock, and will immediately
- * fail if the hwspinlock is already taken.
- *
- * Upon a successful return from this function, preemption (and possibly
- * interrupts) is disabled, so the caller must not sleep, and is advised to
- * release the hwspinlock as soon as possible. This is required in order to
- * minimize remote cores polling on the hardware interconnect.
- *
- * The user decides whether local interrupts are disabled or not, and if yes,
- * whether he wants their previous state to be saved. It is up to the user
- * to choose the appropriate @mode of operation, exactly the same way users
- * should decide between spin_trylock, spin_trylock_irq and
- * spin_trylock_irqsave. However if the user wishes to use hwspinlock from
- * context that sleeps, it needs to be decided when hwspinlock is requested.
- *
- * Returns 0 if we successfully locked the hwspinlock or -EBUSY if
- * the hwspinlock was already taken.
- * This function will never sleep.
+/*
+ * Single attempt to take @hwlock.  Returns 0 on success, -EBUSY if the
+ * lock is taken by another context on the local host, and -EAGAIN if it
+ * is taken by a remote core.
  */
-int __hwspin_trylock(struct hwspinlock *hwlock, int mode, unsigned long *flags)
+static int hwspin_trylock_once(struct hwspinlock *hwlock, int mode,
+		unsigned long *flags)
 {
 	int ret;
 
-	BUG_ON(!hwlock);
-	BUG_ON(!flags && mode == HWLOCK_IRQSTATE);
-
 	/*
 	 * This spin_lock{_irq, _irqsave} serves three purposes:
 	 *
@@ -136,7 +128,7 @@ int __hwspin_trylock(struct hwspinlock *hwlock, int mode, unsigned long *flags)
 			else
 				spin_unlock(&hwlock->sw_l.slock);
 		}
-		return -EBUSY;
+		return -EAGAIN;
 	}
 
 	/*
@@ -153,6 +145,51 @@ int __hwspin_trylock(struct hwspinlock *hwlock, int mode, unsigned long *flags)
 
 	return 0;
 }
+
+/**
+ * __hwspin_trylock() - attempt to lock a specific hwspinlock
+ * @hwlock: an hwspinlock which we want to trylock
+ * @mode: controls whether local interrupts are disabled or not
+ * @flags: a pointer where the caller's interrupt state will be saved at (if
+ *         requested)
+ *
+ * This function attempts to lock an hwspinlock, and will immediately
+ * fail if the hwspinlock is already taken.
+ *
+ * Upon a successful return from this function, preemption (and possibly
+ * interrupts) is disabled, so the caller must not sleep, and is advised to
+ * release the hwspinlock as soon as possible. This is required in order to
+ * minimize remote cores polling on the hardware interconnect.
+ *
+ * The user decides whether local interrupts are disabled or not, and if yes,
+ * whether he wants their previous state to be saved. It is up to the user
+ * to choose the appropriate @mode of operation, exactly the same way users
+ * should decide between spin_trylock, spin_trylock_irq and
+ * spin_trylock_irqsave. However if the user wishes to use hwspinlock from
+ * context that sleeps, it needs to be decided when hwspinlock is requested.
+ *
+ * Returns 0 if we successfully locked the hwspinlock or -EBUSY if
+ * the hwspinlock was already taken.
+ * This function will never sleep.
+ */
+int __hwspin_trylock(struct hwspinlock *hwlock, int mode, unsigned long *flags)
+{
+	int ret;
+
+	BUG_ON(!hwlock);
+	BUG_ON(!flags && mode == HWLOCK_IRQSTATE);
+
+	ret = hwspin_trylock_once(hwlock, mode, flags);
+	if (ret == -EAGAIN) {
+		atomic_inc(&hwlock->remote);
+		return -EBUSY;
+	}
+
+	if (!ret)
+		hwlock->acquired++;
+
+	return ret;
+}
 EXPORT_SYMBOL_GPL(__hwspin_trylock);
 
 /**
@@ -166,6 +203,8 @@ EXPORT_SYMBOL_GPL(__hwspin_trylock);
  * This function locks the given @hwlock. If the @hwlock
  * is already taken, the function will busy loop waiting for it to
  * be released, but give up after @timeout msecs have elapsed.
+ * Once the lock has been taken for longer than HWSPINLOCK_SPIN_NS, the
+ * polling backs off, and sleeps for locks requested as USE_MUTEX_LOCK.
  *
  * Upon a successful return from this function, preemption is disabled
  * (and possibly local interrupts, too), so the caller must not sleep,
@@ -180,35 +219,66 @@ EXPORT_SYMBOL_GPL(__hwspin_trylock);
  *
  * Returns 0 when the @hwlock was successfully taken, and an appropriate
  * error code otherwise (most notably -ETIMEDOUT if the @hwlock is still
- * busy after @timeout msecs). The function will never sleep.
+ * busy after @timeout msecs). The function will only sleep for
+ * USE_MUTEX_LOCK locks.
  */
 int __hwspin_lock_timeout(struct hwspinlock *hwlock, unsigned int to,
 					int mode, unsigned long *flags)
 {
 	int ret;
 	unsigned long expire;
+	unsigned int delay = 0;
+	ktime_t start;
+	u64 waited;
+
+	/* Try to take the hwspinlock */
+	ret = __hwspin_trylock(hwlock, mode, flags);
+	if (ret != -EBUSY)
+		return ret;
 
+	start = ktime_get();
 	expire = msecs_to_jiffies(to) + jiffies;
 
 	for (;;) {
-		/* Try to take the hwspinlock */
-		ret = __hwspin_trylock(hwlock, mode, flags);
-		if (ret != -EBUSY)
-			break;
-
 		/*
 		 * The lock is already taken, let's check if the user wants
 		 * us to try again
 		 */
-		if (time_is_before_eq_jiffies(expire))
+		if (time_is_before_eq_jiffies(expire)) {
+			atomic_inc(&hwlock->timeouts);
 			return -ETIMEDOUT;
+		}
 
-		/*
-		 * Allow platform-specific relax handlers to prevent
-		 * hogging the interconnect (no sleeping, though)
-		 */
-		if (hwlock->bank->ops->relax)
-			hwlock->bank->ops->relax(hwlock);
+		waited = ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (waited < HWSPINLOCK_SPIN_NS) {
+			/*
+			 * Allow platform-specific relax handlers to prevent
+			 * hogging the interconnect (no sleeping, though)
+			 */
+			if (hwlock->bank->ops->relax)
+				hwlock->bank->ops->relax(hwlock);
+		} else if (hwlock->tlock == USE_MUTEX_LOCK) {
+			delay = clamp_t(unsigned int, delay * 2,
+					HWSPINLOCK_MIN_SLEEP_US,
+					HWSPINLOCK_MAX_SLEEP_US);
+			usleep_range(delay, delay * 2);
+		} else {
+			delay = clamp_t(unsigned int, delay * 2, 1,
+					HWSPINLOCK_MAX_DELAY_US);
+			udelay(delay);
+		}
+
+		ret = __hwspin_trylock(hwlock, mode, flags);
+		if (ret != -EBUSY)
+			break;
+	}
+
+	if (!ret) {
+		waited = ktime_to_ns(ktime_sub(ktime_get(), start));
+		hwlock->contended++;
+		hwlock->wait_ns += waited;
+		if (waited > hwlock->max_wait_ns)
+			hwlock->max_wait_ns = waited;
 	}
 
 	return ret;
@@ -679,6 +749,77 @@ out:
 }
 EXPORT_SYMBOL_GPL(__hwspin_lock_reset);
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *hwspinlock_debugfs;
+
+/* the counters are read without taking the locks */
+static int hwspinlock_stats_show(struct seq_file *s, void *unused)
+{
+	struct hwspinlock *hwlocks[32];
+	unsigned long next = 0;
+	unsigned int i, n;
+
+	seq_printf(s, "%4s %6s %10s %10s %10s %8s %8s %8s\n", "id", "type",
+		   "acquired", "contended", "remote", "timeouts", "avg us",
+		   "max us");
+
+	mutex_lock(&hwspinlock_tree_lock);
+	do {
+		n = radix_tree_gang_lookup(&hwspinlock_tree, (void **)hwlocks,
+					   next, ARRAY_SIZE(hwlocks));
+		for (i = 0; i < n; i++) {
+			struct hwspinlock *hwlock = hwlocks[i];
+			u64 wait_ns = hwlock->wait_ns;
+
+			if (hwlock->contended)
+				do_div(wait_ns, hwlock->contended);
+
+			seq_printf(s, "%4d %6s %10lu %10lu %10d %8d %8llu %8llu\n",
+				   hwlock_to_id(hwlock),
+				   hwlock->tlock == USE_MUTEX_LOCK ?
+				   "mutex" : "spin",
+				   hwlock->acquired, hwlock->contended,
+				   atomic_read(&hwlock->remote),
+				   atomic_read(&hwlock->timeouts),
+				   div_u64(wait_ns, NSEC_PER_USEC),
+				   div_u64(hwlock->max_wait_ns,
+					   NSEC_PER_USEC));
+
+			next = hwlock_to_id(hwlock) + 1;
+		}
+	} while (n == ARRAY_SIZE(hwlocks));
+	mutex_unlock(&hwspinlock_tree_lock);
+
+	return 0;
+}
+
+static int hwspinlock_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hwspinlock_stats_show, NULL);
+}
+
+static const struct file_operations hwspinlock_stats_fops = {
+	.open		= hwspinlock_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init hwspinlock_debugfs_init(void)
+{
+	hwspinlock_debugfs = debugfs_create_file("hwspinlock", S_IRUGO, NULL,
+						 NULL, &hwspinlock_stats_fops);
+	return 0;
+}
+module_init(hwspinlock_debugfs_init);
+
+static void __exit hwspinlock_debugfs_exit(void)
+{
+	debugfs_remove(hwspinlock_debugfs);
+}
+module_exit(hwspinlock_debugfs_exit);
+#endif
+
 MODULE_LICENSE("GPL v2");
 MODULE_DESCRIPTION("Hardware spinlock interface");
 MODULE_AUTHOR("Ohad Ben-Cohen <ohad@wizery.com>");
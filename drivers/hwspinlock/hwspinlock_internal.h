@@ -52,12 +52,27 @@ struct hwspinlock_ops {
  * @slock: mutex lock used by hwspinlock core
  * @lock_type: User of hwspinlock to decide whether to use mutex or spinlock
  * @priv: private data, owned by the underlying platform-specific hwspinlock drv
+ * @acquired: number of times the lock was taken
+ * @contended: acquisitions that had to wait for the lock
+ * @wait_ns: total time the contended acquisitions waited
+ * @max_wait_ns: longest time an acquisition waited
+ * @remote: attempts that found the lock taken by another core
+ * @timeouts: acquisitions that gave up waiting
+ *
+ * @acquired, @contended and the wait times are only updated with the lock
+ * held, @remote and @timeouts are updated without it.
  */
 struct hwspinlock {
 	struct hwspinlock_device *bank;
 	union sw_lock sw_l;
 	enum lock_type tlock;
 	void *priv;
+	unsigned long acquired;
+	unsigned long contended;
+	u64 wait_ns;
+	u64 max_wait_ns;
+	atomic_t remote;
+	atomic_t timeouts;
 };
 
 /**
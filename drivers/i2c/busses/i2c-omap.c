@@ -34,6 +34,7 @@
 #include <linux/err.h>
 #include <linux/interrupt.h>
 #include <linux/completion.h>
+#include <linux/dma-mapping.h>
 #include <linux/platform_device.h>
 #include <linux/clk.h>
 #include <linux/io.h>
@@ -45,6 +46,7 @@
 #include <linux/i2c-omap.h>
 #include <linux/pm_runtime.h>
 #include <plat/omap_device.h>
+#include <plat/dma.h>
 #include <linux/pm_qos.h>
 
 /* I2C controller revisions */
@@ -58,6 +60,19 @@
 /* timeout waiting for the controller to respond */
 #define OMAP_I2C_TIMEOUT (msecs_to_jiffies(1000))
 
+/*
+ * Keep the controller active that long after a transfer, so that clients
+ * polling the bus back to back don't pay a runtime PM cycle every time.
+ */
+#define OMAP_I2C_PM_TIMEOUT	100	/* ms */
+
+/*
+ * Messages at least that long are moved by sDMA rather than through the
+ * FIFO interrupts. The bounce buffer bounds the length of a DMA message.
+ */
+#define OMAP_I2C_DMA_MIN_LEN	32
+#define OMAP_I2C_DMA_BUF_SIZE	PAGE_SIZE
+
 /* For OMAP3 I2C_IV has changed to I2C_WE (wakeup enable) */
 enum {
 	OMAP_I2C_REV_REG = 0,
@@ -132,6 +147,8 @@ enum {
 #define OMAP_I2C_BUF_RXFIF_CLR	(1 << 14)	/* RX FIFO Clear */
 #define OMAP_I2C_BUF_XDMA_EN	(1 << 7)	/* TX DMA channel enable */
 #define OMAP_I2C_BUF_TXFIF_CLR	(1 << 6)	/* TX FIFO Clear */
+#define OMAP_I2C_BUF_RTRSH_MASK	(0x3f << 8)	/* RX FIFO threshold */
+#define OMAP_I2C_BUF_XTRSH_MASK	(0x3f << 0)	/* TX FIFO threshold */
 
 /* I2C Configuration Register (OMAP_I2C_CON): */
 #define OMAP_I2C_CON_EN		(1 << 15)	/* I2C module enable */
@@ -177,6 +194,7 @@ enum {
 struct omap_i2c_dev {
 	struct device		*dev;
 	void __iomem		*base;		/* virtual */
+	resource_size_t		phys;		/* physical, for DMA */
 	int			irq;
 	int			reg_shift;      /* bit shift for I2C register addresses */
 	struct completion	cmd_complete;
@@ -210,6 +228,15 @@ struct omap_i2c_dev {
 	bool			suspended;	/* if true - I2C device
 						   suspended and can't be
 						   accessible*/
+	int			dma_rx_sync_dev;
+	int			dma_tx_sync_dev;
+	int			dma_rx_ch;	/* -1 when not using DMA */
+	int			dma_tx_ch;
+	u8			*dma_buf;	/* bounce buffer, client
+						 * buffers may not be DMA safe
+						 */
+	dma_addr_t		dma_buf_phys;
+	struct completion	dma_complete;
 };
 
 static const u8 reg_map_ip_v1[] = {
@@ -521,6 +548,133 @@ static int omap_i2c_bus_clear(struct omap_i2c_dev *dev)
 	return omap_i2c_wait_for_bb(dev);
 }
 
+static void omap_i2c_dma_callback(int lch, u16 ch_status, void *data)
+{
+	struct omap_i2c_dev *dev = data;
+
+	complete(&dev->dma_complete);
+}
+
+static void omap_i2c_free_dma(struct omap_i2c_dev *dev)
+{
+	if (dev->dma_rx_ch >= 0)
+		omap_free_dma(dev->dma_rx_ch);
+	if (dev->dma_tx_ch >= 0)
+		omap_free_dma(dev->dma_tx_ch);
+	if (dev->dma_buf)
+		dma_free_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE,
+				  dev->dma_buf, dev->dma_buf_phys);
+
+	dev->dma_rx_ch = -1;
+	dev->dma_tx_ch = -1;
+	dev->dma_buf = NULL;
+}
+
+/*
+ * Get the DMA channels and the bounce buffer. Failing that, the bus falls
+ * back to interrupt driven transfers.
+ */
+static void omap_i2c_request_dma(struct omap_i2c_dev *dev)
+{
+	init_completion(&dev->dma_complete);
+
+	dev->dma_buf = dma_alloc_coherent(dev->dev, OMAP_I2C_DMA_BUF_SIZE,
+					  &dev->dma_buf_phys, GFP_KERNEL);
+	if (!dev->dma_buf)
+		goto err;
+
+	if (omap_request_dma(dev->dma_rx_sync_dev, "I2C RX",
+			     omap_i2c_dma_callback, dev, &dev->dma_rx_ch)) {
+		dev->dma_rx_ch = -1;
+		goto err;
+	}
+
+	if (omap_request_dma(dev->dma_tx_sync_dev, "I2C TX",
+			     omap_i2c_dma_callback, dev, &dev->dma_tx_ch)) {
+		dev->dma_tx_ch = -1;
+		goto err;
+	}
+
+	return;
+
+err:
+	dev_warn(dev->dev, "no DMA channels, using interrupt mode\n");
+	omap_i2c_free_dma(dev);
+}
+
+static bool omap_i2c_use_dma(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	return dev->dma_buf && msg->len >= OMAP_I2C_DMA_MIN_LEN &&
+	       msg->len <= OMAP_I2C_DMA_BUF_SIZE;
+}
+
+/*
+ * Set up the sDMA channel for the message. The FIFO raises a DMA request
+ * for every byte, and the data interrupts are masked so that only the
+ * end of transfer and error conditions reach the CPU.
+ */
+static void omap_i2c_dma_start(struct omap_i2c_dev *dev, struct i2c_msg *msg)
+{
+	dma_addr_t data_reg = dev->phys +
+		(dev->regs[OMAP_I2C_DATA_REG] << dev->reg_shift);
+	bool rd = msg->flags & I2C_M_RD;
+	int ch = rd ? dev->dma_rx_ch : dev->dma_tx_ch;
+
+	if (!rd)
+		memcpy(dev->dma_buf, msg->buf, msg->len);
+
+	INIT_COMPLETION(dev->dma_complete);
+
+	omap_set_dma_transfer_params(ch, OMAP_DMA_DATA_TYPE_S8, msg->len, 1,
+				     OMAP_DMA_SYNC_ELEMENT,
+				     rd ? dev->dma_rx_sync_dev :
+					  dev->dma_tx_sync_dev, rd);
+	if (rd) {
+		omap_set_dma_src_params(ch, 0, OMAP_DMA_AMODE_CONSTANT,
+					data_reg, 0, 0);
+		omap_set_dma_dest_params(ch, 0, OMAP_DMA_AMODE_POST_INC,
+					 dev->dma_buf_phys, 0, 0);
+	} else {
+		omap_set_dma_src_params(ch, 0, OMAP_DMA_AMODE_POST_INC,
+					dev->dma_buf_phys, 0, 0);
+		omap_set_dma_dest_params(ch, 0, OMAP_DMA_AMODE_CONSTANT,
+					 data_reg, 0, 0);
+	}
+
+	omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, dev->iestate &
+			   ~(OMAP_I2C_IE_XRDY | OMAP_I2C_IE_RRDY |
+			     OMAP_I2C_IE_XDR | OMAP_I2C_IE_RDR));
+	omap_start_dma(ch);
+}
+
+/*
+ * Tear the DMA transfer down and restore the interrupt driven setup. A
+ * completed read still has to wait for the channel to drain the FIFO
+ * before the data is copied back to the client.
+ */
+static int omap_i2c_dma_finish(struct omap_i2c_dev *dev, struct i2c_msg *msg,
+			       u16 buf, bool done)
+{
+	bool rd = msg->flags & I2C_M_RD;
+	int ch = rd ? dev->dma_rx_ch : dev->dma_tx_ch;
+	int r = 0;
+
+	if (done && rd && !wait_for_completion_timeout(&dev->dma_complete,
+						       OMAP_I2C_TIMEOUT)) {
+		dev_err(dev->dev, "DMA timed out\n");
+		r = -ETIMEDOUT;
+	}
+
+	omap_stop_dma(ch);
+	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, buf);
+	omap_i2c_write_reg(dev, OMAP_I2C_IE_REG, dev->iestate);
+
+	if (done && rd && !r)
+		memcpy(msg->buf, dev->dma_buf, msg->len);
+
+	return r;
+}
+
 /*
  * Low level master read/write transaction.
  */
@@ -529,7 +683,9 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 {
 	struct omap_i2c_dev *dev = i2c_get_adapdata(adap);
 	unsigned long timeout;
-	u16 w;
+	bool use_dma;
+	u16 w, buf;
+	int r;
 
 	dev_dbg(dev->dev, "addr: 0x%04x, len: %d, flags: 0x%x, stop: %d\n",
 		msg->addr, msg->len, msg->flags, stop);
@@ -546,13 +702,27 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	omap_i2c_write_reg(dev, OMAP_I2C_CNT_REG, dev->buf_len);
 
 	/* Clear the FIFO Buffers */
-	w = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG);
-	w |= OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR;
+	buf = omap_i2c_read_reg(dev, OMAP_I2C_BUF_REG);
+	w = buf | OMAP_I2C_BUF_RXFIF_CLR | OMAP_I2C_BUF_TXFIF_CLR;
+
+	/* DMA requests are raised for every byte */
+	use_dma = omap_i2c_use_dma(dev, msg);
+	if (use_dma) {
+		if (msg->flags & I2C_M_RD)
+			w = (w & ~OMAP_I2C_BUF_RTRSH_MASK) |
+			    OMAP_I2C_BUF_RDMA_EN;
+		else
+			w = (w & ~OMAP_I2C_BUF_XTRSH_MASK) |
+			    OMAP_I2C_BUF_XDMA_EN;
+	}
 	omap_i2c_write_reg(dev, OMAP_I2C_BUF_REG, w);
 
 	INIT_COMPLETION(dev->cmd_complete);
 	dev->cmd_err = 0;
 
+	if (use_dma)
+		omap_i2c_dma_start(dev, msg);
+
 	w = OMAP_I2C_CON_EN | OMAP_I2C_CON_MST | OMAP_I2C_CON_STT;
 
 	/* High speed configuration */
@@ -582,6 +752,9 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 			if (time_after(jiffies, delay)) {
 				dev_err(dev->dev, "controller timed out "
 				"waiting for start condition to finish\n");
+				if (use_dma)
+					omap_i2c_dma_finish(dev, msg, buf,
+							    false);
 				return -ETIMEDOUT;
 			}
 			cpu_relax();
@@ -599,6 +772,14 @@ static int omap_i2c_xfer_msg(struct i2c_adapter *adap,
 	timeout = wait_for_completion_timeout(&dev->cmd_complete,
 						OMAP_I2C_TIMEOUT);
 	dev->buf_len = 0;
+	if (use_dma) {
+		r = omap_i2c_dma_finish(dev, msg, buf,
+					timeout && !dev->cmd_err);
+		if (r < 0) {
+			omap_i2c_init(dev);
+			return r;
+		}
+	}
 	if (timeout == 0) {
 		dev_err(dev->dev, "controller timed out\n");
 		omap_i2c_init(dev);
@@ -699,7 +880,8 @@ omap_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 out:
 	disable_irq(dev->irq);
 err_pm:
-	pm_runtime_put_sync(dev->dev);
+	pm_runtime_mark_last_busy(dev->dev);
+	pm_runtime_put_autosuspend(dev->dev);
 	omap_i2c_hwspinlock_unlock(dev);
 	return r;
 }
@@ -884,17 +1066,33 @@ static int process_read_rdy(struct omap_i2c_dev *dev, u16 stat)
 	return 0;
 }
 
+/*
+ * Only check that the controller raised the interrupt, the FIFO is
+ * serviced from the thread, with the line masked until it is done.
+ */
 static irqreturn_t
 omap_i2c_isr(int this_irq, void *dev_id)
 {
 	struct omap_i2c_dev *dev = dev_id;
-	u16 bits;
-	u16 stat, w;
-	int err, count = 0;
+	u16 mask, stat;
 
 	if (pm_runtime_suspended(dev->dev))
 		return IRQ_NONE;
 
+	mask = omap_i2c_read_reg(dev, OMAP_I2C_IE_REG);
+	stat = omap_i2c_read_reg(dev, OMAP_I2C_STAT_REG);
+
+	return (stat & mask) ? IRQ_WAKE_THREAD : IRQ_NONE;
+}
+
+static irqreturn_t
+omap_i2c_isr_thread(int this_irq, void *dev_id)
+{
+	struct omap_i2c_dev *dev = dev_id;
+	u16 bits;
+	u16 stat, w;
+	int err, count = 0;
+
 	bits = omap_i2c_read_reg(dev, OMAP_I2C_IE_REG);
 	while ((stat = (omap_i2c_read_reg(dev, OMAP_I2C_STAT_REG))) & bits) {
 		dev_dbg(dev->dev, "IRQ (ISR = 0x%04x)\n", stat);
@@ -1039,11 +1237,10 @@ omap_i2c_probe(struct platform_device *pdev)
 {
 	struct omap_i2c_dev	*dev;
 	struct i2c_adapter	*adap;
-	struct resource		*mem, *irq;
+	struct resource		*mem, *irq, *dma;
 	struct omap_i2c_bus_platform_data *pdata = pdev->dev.platform_data;
 	struct device_node	*node = pdev->dev.of_node;
 	const struct of_device_id *match;
-	irq_handler_t isr;
 	int r;
 
 	/* NOTE: driver uses the static register mapping */
@@ -1069,6 +1266,18 @@ omap_i2c_probe(struct platform_device *pdev)
 		dev_err(&pdev->dev, "I2C region already claimed\n");
 		return -ENOMEM;
 	}
+	dev->phys = mem->start;
+
+	dev->dma_rx_ch = -1;
+	dev->dma_tx_ch = -1;
+	dev->dma_rx_sync_dev = -1;
+	dev->dma_tx_sync_dev = -1;
+	dma = platform_get_resource_byname(pdev, IORESOURCE_DMA, "rx");
+	if (dma)
+		dev->dma_rx_sync_dev = dma->start;
+	dma = platform_get_resource_byname(pdev, IORESOURCE_DMA, "tx");
+	if (dma)
+		dev->dma_tx_sync_dev = dma->start;
 
 	match = of_match_device(of_match_ptr(omap_i2c_of_match), &pdev->dev);
 	if (match) {
@@ -1101,6 +1310,8 @@ omap_i2c_probe(struct platform_device *pdev)
 	else
 		dev->regs = (u8 *)reg_map_ip_v1;
 
+	pm_runtime_set_autosuspend_delay(dev->dev, OMAP_I2C_PM_TIMEOUT);
+	pm_runtime_use_autosuspend(dev->dev);
 	pm_runtime_enable(dev->dev);
 	r = pm_runtime_get_sync(dev->dev);
 	if (r < 0)
@@ -1141,14 +1352,27 @@ omap_i2c_probe(struct platform_device *pdev)
 		/* calculate wakeup latency constraint */
 		dev->latency = (1000000 * dev->fifo_size) /
 			       (1000 * dev->speed / 8);
+
+		/*
+		 * DMA only works with the 8 bit data register, and is kept
+		 * off the controllers that need the i462 workaround.
+		 */
+		if (!dev->b_hw && dev->dma_rx_sync_dev >= 0 &&
+		    dev->dma_tx_sync_dev >= 0 &&
+		    !(dev->flags & OMAP_I2C_FLAG_16BIT_DATA_REG))
+			omap_i2c_request_dma(dev);
 	}
 
 	/* reset ASAP, clearing any IRQs */
 	omap_i2c_init(dev);
 
-	isr = (dev->rev < OMAP_I2C_OMAP1_REV_2) ? omap_i2c_omap1_isr :
-								   omap_i2c_isr;
-	r = request_irq(dev->irq, isr, 0, pdev->name, dev);
+	if (dev->rev < OMAP_I2C_OMAP1_REV_2)
+		r = request_irq(dev->irq, omap_i2c_omap1_isr, 0,
+				pdev->name, dev);
+	else
+		r = request_threaded_irq(dev->irq, omap_i2c_isr,
+					 omap_i2c_isr_thread, IRQF_ONESHOT,
+					 pdev->name, dev);
 
 	/* We enable IRQ only when request for I2C from master */
 	disable_irq(dev->irq);
@@ -1158,8 +1382,9 @@ omap_i2c_probe(struct platform_device *pdev)
 		goto err_unuse_clocks;
 	}
 
-	dev_info(dev->dev, "bus %d rev%d.%d.%d at %d kHz\n", pdev->id,
-		 dev->dtrev, dev->rev >> 4, dev->rev & 0xf, dev->speed);
+	dev_info(dev->dev, "bus %d rev%d.%d.%d at %d kHz%s\n", pdev->id,
+		 dev->dtrev, dev->rev >> 4, dev->rev & 0xf, dev->speed,
+		 dev->dma_buf ? ", DMA" : "");
 
 	adap = &dev->adapter;
 	i2c_set_adapdata(adap, dev);
@@ -1180,15 +1405,18 @@ omap_i2c_probe(struct platform_device *pdev)
 
 	of_i2c_register_devices(adap);
 
-	pm_runtime_put(dev->dev);
+	pm_runtime_mark_last_busy(dev->dev);
+	pm_runtime_put_autosuspend(dev->dev);
 
 	return 0;
 
 err_free_irq:
 	free_irq(dev->irq, dev);
 err_unuse_clocks:
+	omap_i2c_free_dma(dev);
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
 	pm_runtime_put(dev->dev);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
 	pm_runtime_disable(&pdev->dev);
 	platform_set_drvdata(pdev, NULL);
 
@@ -1208,8 +1436,10 @@ static int __devexit omap_i2c_remove(struct platform_device *pdev)
 	if (ret < 0)
 		return ret;
 
+	omap_i2c_free_dma(dev);
 	omap_i2c_write_reg(dev, OMAP_I2C_CON_REG, 0);
 	pm_runtime_put(&pdev->dev);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
 	pm_runtime_disable(&pdev->dev);
 	return 0;
 }
@@ -20,6 +20,9 @@
 #include <linux/input/mt.h>
 #include <linux/interrupt.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/notifier.h>
+#include <linux/spinlock.h>
 
 /* Version */
 #define MXT_VER_20		20
@@ -212,6 +215,9 @@
 
 #define MXT_MAX_FINGER		10
 
+/* Messages read in one I2C transfer when the T44 message count is known */
+#define MXT_MAX_MESSAGES	16
+
 struct mxt_info {
 	u8 family_id;
 	u8 variant_id;
@@ -258,6 +264,32 @@ struct mxt_data {
 	unsigned int irq;
 	unsigned int max_x;
 	unsigned int max_y;
+
+	/* message objects, cached by mxt_initialize() */
+	u16 T5_address;
+	u8 T5_msg_size;
+	u16 T44_address;
+	u8 T9_min_reportid;
+	u8 T9_max_reportid;
+	u8 *msg_buf;
+
+	/*
+	 * The finger updates of all the messages read on one interrupt make
+	 * up one frame, reported with a single input_sync() either at once or
+	 * on the next vsync. The lock protects the finger state and the
+	 * statistics against the vsync notifier.
+	 */
+	spinlock_t lock;
+	bool frame_pending;
+	int last_id;
+	ktime_t frame_stamp;
+	bool vsync_aligned;
+	struct notifier_block vsync_nb;
+
+	/* touch interrupt to input_sync() latency */
+	unsigned long frames;
+	u64 latency_us;
+	u32 latency_max_us;
 };
 
 static bool mxt_object_readable(unsigned int type)
@@ -513,12 +545,15 @@ static int mxt_write_object(struct mxt_data *data,
 	return mxt_write_reg(data->client, reg + offset, val);
 }
 
-static void mxt_input_report(struct mxt_data *data, int single_id)
+/* report the pending frame, called with data->lock held */
+static void mxt_input_report(struct mxt_data *data)
 {
 	struct mxt_finger *finger = data->finger;
 	struct input_dev *input_dev = data->input_dev;
+	int single_id = data->last_id;
 	int status = finger[single_id].status;
 	int finger_num = 0;
+	u32 latency;
 	int id;
 
 	for (id = 0; id < MXT_MAX_FINGER; id++) {
@@ -554,26 +589,49 @@ static void mxt_input_report(struct mxt_data *data, int single_id)
 	}
 
 	input_sync(input_dev);
+
+	latency = ktime_us_delta(ktime_get(), data->frame_stamp);
+	data->frames++;
+	data->latency_us += latency;
+	data->latency_max_us = max(data->latency_max_us, latency);
+	data->frame_pending = false;
+}
+
+/* add a finger update to the pending frame, called with data->lock held */
+static void mxt_frame_update(struct mxt_data *data, int id, ktime_t stamp)
+{
+	if (!data->frame_pending) {
+		data->frame_pending = true;
+		data->frame_stamp = stamp;
+	}
+	data->last_id = id;
 }
 
 static void mxt_input_touchevent(struct mxt_data *data,
-				      struct mxt_message *message, int id)
+				      struct mxt_message *message, int id,
+				      ktime_t stamp)
 {
 	struct mxt_finger *finger = data->finger;
 	struct device *dev = &data->client->dev;
 	u8 status = message->message[0];
+	unsigned long flags;
 	int x;
 	int y;
 	int area;
 	int pressure;
 
+	if (id >= MXT_MAX_FINGER)
+		return;
+
 	/* Check the touch is present on the screen */
 	if (!(status & MXT_DETECT)) {
 		if (status & MXT_RELEASE) {
 			dev_dbg(dev, "[%d] released\n", id);
 
+			spin_lock_irqsave(&data->lock, flags);
 			finger[id].status = MXT_RELEASE;
-			mxt_input_report(data, id);
+			mxt_frame_update(data, id, stamp);
+			spin_unlock_irqrestore(&data->lock, flags);
 		}
 		return;
 	}
@@ -596,52 +654,128 @@ static void mxt_input_touchevent(struct mxt_data *data,
 		status & MXT_MOVE ? "moved" : "pressed",
 		x, y, area);
 
+	spin_lock_irqsave(&data->lock, flags);
 	finger[id].status = status & MXT_MOVE ?
 				MXT_MOVE : MXT_PRESS;
 	finger[id].x = x;
 	finger[id].y = y;
 	finger[id].area = area;
 	finger[id].pressure = pressure;
+	mxt_frame_update(data, id, stamp);
+	spin_unlock_irqrestore(&data->lock, flags);
+}
+
+static void mxt_handle_message(struct mxt_data *data,
+			       struct mxt_message *message, ktime_t stamp)
+{
+	u8 reportid = message->reportid;
+
+	if (reportid >= data->T9_min_reportid &&
+	    reportid <= data->T9_max_reportid)
+		mxt_input_touchevent(data, message,
+				     reportid - data->T9_min_reportid, stamp);
+	else if (reportid != 0xff)
+		mxt_dump_message(&data->client->dev, message);
+}
 
-	mxt_input_report(data, id);
+/* read all the pending messages in as few transfers as the T44 count allows */
+static int mxt_read_messages(struct mxt_data *data, ktime_t stamp)
+{
+	u8 count;
+	int error;
+	int i, n;
+
+	error = __mxt_read_reg(data->client, data->T44_address, 1, &count);
+	if (error)
+		return error;
+
+	while (count) {
+		n = min_t(int, count, MXT_MAX_MESSAGES);
+		error = __mxt_read_reg(data->client, data->T5_address,
+				       n * data->T5_msg_size, data->msg_buf);
+		if (error)
+			return error;
+
+		for (i = 0; i < n; i++)
+			mxt_handle_message(data, (struct mxt_message *)
+				(data->msg_buf + i * data->T5_msg_size), stamp);
+		count -= n;
+	}
+
+	return 0;
 }
 
 static irqreturn_t mxt_interrupt(int irq, void *dev_id)
 {
 	struct mxt_data *data = dev_id;
 	struct mxt_message message;
-	struct mxt_object *object;
 	struct device *dev = &data->client->dev;
-	int id;
-	u8 reportid;
-	u8 max_reportid;
-	u8 min_reportid;
+	ktime_t stamp = ktime_get();
+	unsigned long flags;
 
-	do {
-		if (mxt_read_message(data, &message)) {
-			dev_err(dev, "Failed to read message\n");
-			goto end;
-		}
+	if (data->T44_address) {
+		if (mxt_read_messages(data, stamp))
+			dev_err(dev, "Failed to read messages\n");
+	} else {
+		do {
+			if (mxt_read_message(data, &message)) {
+				dev_err(dev, "Failed to read message\n");
+				break;
+			}
+			mxt_handle_message(data, &message, stamp);
+		} while (message.reportid != 0xff);
+	}
+
+	spin_lock_irqsave(&data->lock, flags);
+	if (data->frame_pending && !data->vsync_aligned)
+		mxt_input_report(data);
+	spin_unlock_irqrestore(&data->lock, flags);
+
+	return IRQ_HANDLED;
+}
+
+static int mxt_vsync_notify(struct notifier_block *nb, unsigned long count,
+			    void *stamp)
+{
+	struct mxt_data *data = container_of(nb, struct mxt_data, vsync_nb);
+	unsigned long flags;
 
-		reportid = message.reportid;
+	spin_lock_irqsave(&data->lock, flags);
+	if (data->frame_pending)
+		mxt_input_report(data);
+	spin_unlock_irqrestore(&data->lock, flags);
 
-		/* whether reportid is thing of MXT_TOUCH_MULTI_T9 */
-		object = mxt_get_object(data, MXT_TOUCH_MULTI_T9);
-		if (!object)
-			goto end;
+	return NOTIFY_OK;
+}
 
-		max_reportid = object->max_reportid;
-		min_reportid = max_reportid - object->num_report_ids + 1;
-		id = reportid - min_reportid;
+static int mxt_set_vsync_aligned(struct mxt_data *data, bool aligned)
+{
+	const struct mxt_platform_data *pdata = data->pdata;
+	unsigned long flags;
+	int error;
 
-		if (reportid >= min_reportid && reportid <= max_reportid)
-			mxt_input_touchevent(data, &message, id);
-		else
-			mxt_dump_message(dev, &message);
-	} while (reportid != 0xff);
+	if (aligned == data->vsync_aligned)
+		return 0;
 
-end:
-	return IRQ_HANDLED;
+	if (aligned) {
+		if (!pdata->register_vsync)
+			return -ENODEV;
+		data->vsync_nb.notifier_call = mxt_vsync_notify;
+		error = pdata->register_vsync(&data->vsync_nb);
+		if (error)
+			return error;
+	} else {
+		pdata->unregister_vsync(&data->vsync_nb);
+	}
+
+	spin_lock_irqsave(&data->lock, flags);
+	data->vsync_aligned = aligned;
+	/* do not hold back a frame until the next touch */
+	if (!aligned && data->frame_pending)
+		mxt_input_report(data);
+	spin_unlock_irqrestore(&data->lock, flags);
+
+	return 0;
 }
 
 static int mxt_check_reg_init(struct mxt_data *data)
@@ -817,6 +951,44 @@ static int mxt_get_object_table(struct mxt_data *data)
 	return 0;
 }
 
+static int mxt_init_messages(struct mxt_data *data)
+{
+	struct mxt_object *object;
+	int i;
+
+	object = mxt_get_object(data, MXT_GEN_MESSAGE_T5);
+	if (!object)
+		return -EINVAL;
+	data->T5_address = object->start_address;
+	data->T5_msg_size = object->size + 1;
+
+	object = mxt_get_object(data, MXT_TOUCH_MULTI_T9);
+	if (!object)
+		return -EINVAL;
+	data->T9_max_reportid = object->max_reportid;
+	data->T9_min_reportid = object->max_reportid -
+				object->num_report_ids + 1;
+
+	/* T44 is optional, only then can messages be read in bursts */
+	data->T44_address = 0;
+	for (i = 0; i < data->info.object_num; i++) {
+		object = data->object_table + i;
+		if (object->type == MXT_SPT_MESSAGECOUNT_T44)
+			data->T44_address = object->start_address;
+	}
+
+	/* room for the last message to be handled as a whole mxt_message */
+	kfree(data->msg_buf);
+	data->msg_buf = kzalloc(MXT_MAX_MESSAGES * data->T5_msg_size +
+				sizeof(struct mxt_message), GFP_KERNEL);
+	if (!data->msg_buf) {
+		data->T44_address = 0;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
 static int mxt_initialize(struct mxt_data *data)
 {
 	struct i2c_client *client = data->client;
@@ -841,6 +1013,10 @@ static int mxt_initialize(struct mxt_data *data)
 	if (error)
 		return error;
 
+	error = mxt_init_messages(data);
+	if (error)
+		return error;
+
 	/* Check register init values */
 	error = mxt_check_reg_init(data);
 	if (error)
@@ -1049,12 +1225,61 @@ static ssize_t mxt_update_fw_store(struct device *dev,
 	return count;
 }
 
+static ssize_t mxt_vsync_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct mxt_data *data = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", data->vsync_aligned);
+}
+
+static ssize_t mxt_vsync_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct mxt_data *data = dev_get_drvdata(dev);
+	unsigned long val;
+	int error;
+
+	if (kstrtoul(buf, 0, &val))
+		return -EINVAL;
+
+	error = mxt_set_vsync_aligned(data, !!val);
+
+	return error ? error : count;
+}
+
+static ssize_t mxt_latency_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct mxt_data *data = dev_get_drvdata(dev);
+	unsigned long flags, frames;
+	u64 avg;
+	u32 max;
+
+	spin_lock_irqsave(&data->lock, flags);
+	frames = data->frames;
+	avg = data->latency_us;
+	max = data->latency_max_us;
+	spin_unlock_irqrestore(&data->lock, flags);
+
+	if (frames)
+		do_div(avg, frames);
+
+	return sprintf(buf, "frames: %lu avg: %llu us max: %u us\n",
+		       frames, avg, max);
+}
+
 static DEVICE_ATTR(object, 0444, mxt_object_show, NULL);
 static DEVICE_ATTR(update_fw, 0664, NULL, mxt_update_fw_store);
+static DEVICE_ATTR(vsync, 0664, mxt_vsync_show, mxt_vsync_store);
+static DEVICE_ATTR(latency, 0444, mxt_latency_show, NULL);
 
 static struct attribute *mxt_attrs[] = {
 	&dev_attr_object.attr,
 	&dev_attr_update_fw.attr,
+	&dev_attr_vsync.attr,
+	&dev_attr_latency.attr,
 	NULL
 };
 
@@ -1121,6 +1346,7 @@ static int __devinit mxt_probe(struct i2c_client *client,
 	data->input_dev = input_dev;
 	data->pdata = pdata;
 	data->irq = client->irq;
+	spin_lock_init(&data->lock);
 
 	mxt_calc_resolution(data);
 
@@ -1181,6 +1407,7 @@ err_unregister_device:
 err_free_irq:
 	free_irq(client->irq, data);
 err_free_object:
+	kfree(data->msg_buf);
 	kfree(data->object_table);
 err_free_mem:
 	input_free_device(input_dev);
@@ -1193,8 +1420,10 @@ static int __devexit mxt_remove(struct i2c_client *client)
 	struct mxt_data *data = i2c_get_clientdata(client);
 
 	sysfs_remove_group(&client->dev.kobj, &mxt_attr_group);
+	mxt_set_vsync_aligned(data, false);
 	free_irq(data->irq, data);
 	input_unregister_device(data->input_dev);
+	kfree(data->msg_buf);
 	kfree(data->object_table);
 	kfree(data);
 
@@ -26,6 +26,7 @@
 #include <linux/slab.h>
 #include <linux/errno.h>
 #include <linux/iommu.h>
+#include <linux/scatterlist.h>
 
 static ssize_t show_iommu_group(struct device *dev,
 				struct device_attribute *attr, char *buf)
@@ -350,6 +351,65 @@ size_t iommu_unmap(struct iommu_domain *domain, unsigned long iova, size_t size)
 }
 EXPORT_SYMBOL_GPL(iommu_unmap);
 
+/**
+ * iommu_map_sg - map a scatterlist to consecutive io virtual addresses
+ * @domain: iommu domain
+ * @iova: io virtual address of the first entry
+ * @sg: scatterlist
+ * @nents: number of entries in @sg
+ * @prot: protection flags
+ *
+ * Each entry covers sg->offset + sg->length bytes from the start of its
+ * page. Physically contiguous entries are merged so that iommu_map() can
+ * use the largest page sizes the hardware supports, unless the driver
+ * provides its own map_sg, which may also defer the iotlb maintenance to
+ * the end of the whole list.
+ */
+int iommu_map_sg(struct iommu_domain *domain, unsigned long iova,
+		 struct scatterlist *sg, unsigned int nents, int prot)
+{
+	phys_addr_t pa = 0;
+	size_t len = 0, mapped = 0;
+	unsigned int i;
+	int ret = 0;
+
+	if (domain->ops->map_sg)
+		return domain->ops->map_sg(domain, iova, sg, nents, prot);
+
+	for (i = 0; i < nents; i++, sg = sg_next(sg)) {
+		phys_addr_t sg_pa = sg_phys(sg) - sg->offset;
+		size_t sg_len = sg->offset + sg->length;
+
+		if (len && pa + len == sg_pa) {
+			len += sg_len;
+			continue;
+		}
+
+		if (len) {
+			ret = iommu_map(domain, iova + mapped, pa, len, prot);
+			if (ret)
+				goto unmap;
+			mapped += len;
+		}
+		pa = sg_pa;
+		len = sg_len;
+	}
+
+	if (len) {
+		ret = iommu_map(domain, iova + mapped, pa, len, prot);
+		if (ret)
+			goto unmap;
+	}
+
+	return 0;
+
+unmap:
+	if (mapped)
+		iommu_unmap(domain, iova, mapped);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iommu_map_sg);
+
 int iommu_device_group(struct device *dev, unsigned int *groupid)
 {
 	if (iommu_present(dev->bus) && dev->bus->iommu_ops->device_group)
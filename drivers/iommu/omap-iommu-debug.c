@@ -93,6 +93,42 @@ static ssize_t debug_read_tlb(struct file *file, char __user *userbuf,
 	return bytes;
 }
 
+static ssize_t debug_read_pagesizes(struct file *file, char __user *userbuf,
+				    size_t count, loff_t *ppos)
+{
+	struct device *dev = file->private_data;
+	struct omap_iommu *obj = dev_to_omap_iommu(dev);
+	char buf[MAXCOLUMN];
+	ssize_t bytes;
+
+	mutex_lock(&iommu_debug_lock);
+
+	bytes = omap_iommu_dump_pgsizes(obj, buf, sizeof(buf));
+	bytes = simple_read_from_buffer(userbuf, count, ppos, buf, bytes);
+
+	mutex_unlock(&iommu_debug_lock);
+
+	return bytes;
+}
+
+static ssize_t debug_read_tlb_stats(struct file *file, char __user *userbuf,
+				    size_t count, loff_t *ppos)
+{
+	struct device *dev = file->private_data;
+	struct omap_iommu *obj = dev_to_omap_iommu(dev);
+	char buf[4 * MAXCOLUMN];
+	ssize_t bytes;
+
+	mutex_lock(&iommu_debug_lock);
+
+	bytes = omap_iommu_dump_tlb_stats(obj, buf, sizeof(buf));
+	bytes = simple_read_from_buffer(userbuf, count, ppos, buf, bytes);
+
+	mutex_unlock(&iommu_debug_lock);
+
+	return bytes;
+}
+
 static ssize_t debug_write_pagetable(struct file *file,
 		     const char __user *userbuf, size_t count, loff_t *ppos)
 {
@@ -341,6 +377,8 @@ err_out:
 DEBUG_FOPS_RO(ver);
 DEBUG_FOPS_RO(regs);
 DEBUG_FOPS_RO(tlb);
+DEBUG_FOPS_RO(pagesizes);
+DEBUG_FOPS_RO(tlb_stats);
 DEBUG_FOPS(pagetable);
 DEBUG_FOPS_RO(mmap);
 DEBUG_FOPS(mem);
@@ -388,6 +426,8 @@ static int iommu_debug_register(struct device *dev, void *data)
 	DEBUG_ADD_FILE_RO(ver);
 	DEBUG_ADD_FILE_RO(regs);
 	DEBUG_ADD_FILE_RO(tlb);
+	DEBUG_ADD_FILE_RO(pagesizes);
+	DEBUG_ADD_FILE_RO(tlb_stats);
 	DEBUG_ADD_FILE(pagetable);
 	DEBUG_ADD_FILE_RO(mmap);
 	DEBUG_ADD_FILE(mem);
@@ -21,6 +21,7 @@
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
 #include <linux/pm_runtime.h>
+#include <linux/scatterlist.h>
 
 #include <asm/cacheflush.h>
 
@@ -45,11 +46,13 @@
  * @iommu_dev:	an omap iommu device attached to this domain. only a single
  *		iommu device can be attached for now.
  * @lock:	domain lock, should be taken when attaching/detaching
+ * @pgsz_count:	number of pages currently mapped, per MMU_CAM_PGSZ_* size
  */
 struct omap_iommu_domain {
 	u32 *pgtable;
 	struct omap_iommu *iommu_dev;
 	spinlock_t lock;
+	unsigned long pgsz_count[MMU_CAM_PGSZ_MASK + 1];
 };
 
 /* accommodate the difference between omap1 and omap2/3 */
@@ -58,6 +61,8 @@ static const struct iommu_functions *arch_iommu;
 static struct platform_driver omap_iommu_driver;
 static struct kmem_cache *iopte_cachep;
 
+static void iotlb_reload_locked(struct omap_iommu *obj);
+
 /**
  * omap_install_iommu_arch - Install archtecure specific iommu functions
  * @ops:	a pointer to architecture specific iommu functions
@@ -201,6 +206,8 @@ static int omap_iommu_runtime_resume(struct device *dev)
 	if (arch_iommu->enable)
 		arch_iommu->enable(obj);
 
+	iotlb_reload_locked(obj);
+
 	return 0;
 }
 
@@ -443,13 +450,15 @@ static int prefetch_iotlb_entry(struct omap_iommu *obj, struct iotlb_entry *e)
 }
 
 /**
- * flush_iotlb_page - Clear an iommu tlb entry
+ * flush_iotlb_range - Clear the iommu tlb entries of a range
  * @obj:	target iommu
  * @da:		iommu device virtual address
+ * @len:	length of the range
  *
- * Clear an iommu tlb entry which includes 'da' address.
+ * Clear the iommu tlb entries which overlap [da, da + len), walking the
+ * tlb only once whatever the size of the range.
  **/
-static void flush_iotlb_page(struct omap_iommu *obj, u32 da)
+static void flush_iotlb_range(struct omap_iommu *obj, u32 da, size_t len)
 {
 	int i;
 	struct cr_regs cr;
@@ -466,7 +475,7 @@ static void flush_iotlb_page(struct omap_iommu *obj, u32 da)
 		start = iotlb_cr_to_virt(&cr);
 		bytes = iopgsz_to_bytes(cr.cam & 3);
 
-		if ((start <= da) && (da < start + bytes)) {
+		if ((start < da + len) && (da < start + bytes)) {
 			dev_dbg(obj->dev, "%s: %08x<=%08x(%x)\n",
 				__func__, start, da, bytes);
 			iotlb_load_cr(obj, &cr);
@@ -479,6 +488,18 @@ static void flush_iotlb_page(struct omap_iommu *obj, u32 da)
 		dev_dbg(obj->dev, "%s: no page for %08x\n", __func__, da);
 }
 
+/**
+ * flush_iotlb_page - Clear an iommu tlb entry
+ * @obj:	target iommu
+ * @da:		iommu device virtual address
+ *
+ * Clear an iommu tlb entry which includes 'da' address.
+ **/
+static void flush_iotlb_page(struct omap_iommu *obj, u32 da)
+{
+	flush_iotlb_range(obj, da, 1);
+}
+
 /**
  * flush_iotlb_all - Clear all iommu tlb entries
  * @obj:	target iommu
@@ -498,6 +519,62 @@ static void flush_iotlb_all(struct omap_iommu *obj)
 	pm_runtime_put(obj->dev);
 }
 
+/*
+ * Write the locked entries to tlb slots [0, nr_locked) and move the lock
+ * base past them, the walker then only replaces the slots above. Slots
+ * which were locked before and no longer are keep valid translations
+ * until the walker reuses them. The iommu must be powered.
+ */
+static void __iotlb_load_locked(struct omap_iommu *obj)
+{
+	struct iotlb_lock l;
+	int i;
+
+	for (i = 0; i < obj->nr_locked; i++) {
+		l.base = i;
+		l.vict = i;
+		iotlb_lock_set(obj, &l);
+		iotlb_load_cr(obj, &obj->locked[i]);
+	}
+
+	l.base = obj->nr_locked;
+	l.vict = obj->nr_locked;
+	iotlb_lock_set(obj, &l);
+}
+
+/* the tlb content is lost across power transitions */
+static void iotlb_reload_locked(struct omap_iommu *obj)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&obj->tlb_lock, flags);
+	if (obj->nr_locked)
+		__iotlb_load_locked(obj);
+	spin_unlock_irqrestore(&obj->tlb_lock, flags);
+}
+
+/* forget the locked entries overlapping [da, da + len) */
+static int __iotlb_unlock_range(struct omap_iommu *obj, u32 da, size_t len)
+{
+	int i, n = 0;
+
+	for (i = 0; i < obj->nr_locked; i++) {
+		struct cr_regs *cr = &obj->locked[i];
+		u32 start = iotlb_cr_to_virt(cr);
+		size_t bytes = iopgsz_to_bytes(cr->cam & 3);
+
+		if ((start < da + len) && (da < start + bytes))
+			continue;
+
+		obj->locked[n++] = *cr;
+	}
+
+	i = obj->nr_locked - n;
+	obj->nr_locked = n;
+
+	return i;
+}
+
 #if defined(CONFIG_OMAP_IOMMU_DEBUG) || defined(CONFIG_OMAP_IOMMU_DEBUG_MODULE)
 
 ssize_t omap_iommu_dump_ctx(struct omap_iommu *obj, char *buf, ssize_t bytes)
@@ -572,6 +649,80 @@ int omap_foreach_iommu_device(void *data, int (*fn)(struct device *, void *))
 }
 EXPORT_SYMBOL_GPL(omap_foreach_iommu_device);
 
+/**
+ * omap_iommu_dump_pgsizes - dump the page sizes used by the attached domain
+ * @obj:	target iommu
+ * @buf:	output buffer
+ * @len:	size of @buf
+ **/
+ssize_t omap_iommu_dump_pgsizes(struct omap_iommu *obj, char *buf, ssize_t len)
+{
+	static const struct {
+		int pgsz;
+		const char *name;
+	} sizes[] = {
+		{ MMU_CAM_PGSZ_16M, "16M" },
+		{ MMU_CAM_PGSZ_1M, "1M" },
+		{ MMU_CAM_PGSZ_64K, "64K" },
+		{ MMU_CAM_PGSZ_4K, "4K" },
+	};
+	struct omap_iommu_domain *omap_domain;
+	unsigned long count[ARRAY_SIZE(sizes)];
+	char *p = buf;
+	int i;
+
+	if (!obj->domain)
+		return snprintf(buf, len, "no domain attached\n");
+
+	omap_domain = obj->domain->priv;
+	spin_lock(&omap_domain->lock);
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		count[i] = omap_domain->pgsz_count[sizes[i].pgsz];
+	spin_unlock(&omap_domain->lock);
+
+	for (i = 0; i < ARRAY_SIZE(sizes) && p < buf + len; i++)
+		p += snprintf(p, buf + len - p, "%4s: %lu\n", sizes[i].name,
+			      count[i]);
+
+	return min_t(ssize_t, p - buf, len);
+}
+EXPORT_SYMBOL_GPL(omap_iommu_dump_pgsizes);
+
+/**
+ * omap_iommu_dump_tlb_stats - dump locked entries and fault counts
+ * @obj:	target iommu
+ * @buf:	output buffer
+ * @len:	size of @buf
+ *
+ * With the hardware table walker enabled, only its faults are counted;
+ * plain tlb misses show up only while it is disabled.
+ **/
+ssize_t omap_iommu_dump_tlb_stats(struct omap_iommu *obj, char *buf,
+				  ssize_t len)
+{
+	static const char * const names[OMAP_IOMMU_NR_ERRS] = {
+		"tlb miss", "translation fault", "emu miss",
+		"table walk fault", "multi hit fault",
+	};
+	unsigned long flags, evictions;
+	int i, nr_locked;
+	char *p = buf;
+
+	spin_lock_irqsave(&obj->tlb_lock, flags);
+	nr_locked = obj->nr_locked;
+	evictions = obj->lock_evictions;
+	spin_unlock_irqrestore(&obj->tlb_lock, flags);
+
+	p += snprintf(p, len, "locked entries: %d/%d, evicted: %lu\n",
+		      nr_locked, obj->max_locked, evictions);
+	for (i = 0; i < OMAP_IOMMU_NR_ERRS && p < buf + len; i++)
+		p += snprintf(p, buf + len - p, "%s: %lu\n", names[i],
+			      obj->faults[i]);
+
+	return min_t(ssize_t, p - buf, len);
+}
+EXPORT_SYMBOL_GPL(omap_iommu_dump_tlb_stats);
+
 #endif /* CONFIG_OMAP_IOMMU_DEBUG_MODULE */
 
 /*
@@ -851,6 +1002,7 @@ static size_t iopgtable_clear_entry(struct omap_iommu *obj, u32 da)
 
 static void iopgtable_clear_entry_all(struct omap_iommu *obj)
 {
+	unsigned long flags;
 	int i;
 
 	spin_lock(&obj->page_table_lock);
@@ -875,6 +1027,17 @@ static void iopgtable_clear_entry_all(struct omap_iommu *obj)
 	flush_iotlb_all(obj);
 
 	spin_unlock(&obj->page_table_lock);
+
+	spin_lock_irqsave(&obj->tlb_lock, flags);
+	obj->nr_locked = 0;
+	spin_unlock_irqrestore(&obj->tlb_lock, flags);
+
+	if (obj->domain) {
+		struct omap_iommu_domain *omap_domain = obj->domain->priv;
+
+		memset(omap_domain->pgsz_count, 0,
+		       sizeof(omap_domain->pgsz_count));
+	}
 }
 EXPORT_SYMBOL_GPL(iopgtable_clear_entry_all);
 /*
@@ -886,6 +1049,7 @@ static irqreturn_t iommu_fault_handler(int irq, void *data)
 	u32 *iopgd, *iopte;
 	struct omap_iommu *obj = data;
 	struct iommu_domain *domain = obj->domain;
+	int i;
 
 	if (!obj->refcount)
 		return IRQ_NONE;
@@ -894,6 +1058,10 @@ static irqreturn_t iommu_fault_handler(int irq, void *data)
 	if (errs == 0)
 		return IRQ_HANDLED;
 
+	for (i = 0; i < OMAP_IOMMU_NR_ERRS; i++)
+		if (errs & (1 << i))
+			obj->faults[i]++;
+
 	/* Fault callback or TLB/PTE Dynamic loading */
 	if (!report_iommu_fault(domain, obj->dev, da, 0))
 		return IRQ_HANDLED;
@@ -1043,6 +1211,8 @@ static int __devinit omap_iommu_probe(struct platform_device *pdev)
 	mutex_init(&obj->mmap_lock);
 	spin_lock_init(&obj->page_table_lock);
 	INIT_LIST_HEAD(&obj->mmap);
+	spin_lock_init(&obj->tlb_lock);
+	obj->max_locked = min(obj->nr_tlb_entries / 2, OMAP_IOMMU_MAX_LOCKED);
 
 	if (!strcmp(obj->name, "ipu"))
 		pm_qos_add_request(&obj->qos_request.pm_qos,
@@ -1147,34 +1317,52 @@ static void iopte_cachep_ctor(void *iopte)
 	clean_dcache_area(iopte, IOPTE_TABLE_SIZE);
 }
 
-static int omap_iommu_map(struct iommu_domain *domain, unsigned long da,
-			 phys_addr_t pa, size_t bytes, int prot)
+/*
+ * map a single iommu page. the iotlb is only maintained when @flush is set,
+ * callers mapping many pages at once do it for the whole range instead.
+ */
+static int __omap_iommu_map(struct omap_iommu_domain *omap_domain, u32 da,
+			    u32 pa, size_t bytes, int prot, bool flush)
 {
-	struct omap_iommu_domain *omap_domain = domain->priv;
 	struct omap_iommu *oiommu = omap_domain->iommu_dev;
 	struct device *dev = oiommu->dev;
 	struct iotlb_entry e;
 	int omap_pgsz;
 	u32 ret, flags;
 
-	/* we only support mapping a single iommu page for now */
 	omap_pgsz = bytes_to_iopgsz(bytes);
 	if (omap_pgsz < 0) {
 		dev_err(dev, "invalid size to map: %d\n", bytes);
 		return -EINVAL;
 	}
 
-	dev_dbg(dev, "mapping da 0x%lx to pa 0x%x size 0x%x\n", da, pa, bytes);
+	dev_dbg(dev, "mapping da 0x%x to pa 0x%x size 0x%x\n", da, pa, bytes);
 
 	flags = omap_pgsz | prot;
 
 	iotlb_init_entry(&e, da, pa, flags);
 
-	ret = omap_iopgtable_store_entry(oiommu, &e);
-	if (ret)
+	if (flush)
+		ret = omap_iopgtable_store_entry(oiommu, &e);
+	else
+		ret = iopgtable_store_entry_core(oiommu, &e);
+	if (ret) {
 		dev_err(dev, "omap_iopgtable_store_entry failed: %d\n", ret);
+		return ret;
+	}
 
-	return ret;
+	spin_lock(&omap_domain->lock);
+	omap_domain->pgsz_count[omap_pgsz]++;
+	spin_unlock(&omap_domain->lock);
+
+	return 0;
+}
+
+static int omap_iommu_map(struct iommu_domain *domain, unsigned long da,
+			 phys_addr_t pa, size_t bytes, int prot)
+{
+	/* we only support mapping a single iommu page for now */
+	return __omap_iommu_map(domain->priv, da, pa, bytes, prot, true);
 }
 
 static size_t omap_iommu_unmap(struct iommu_domain *domain, unsigned long da,
@@ -1183,10 +1371,112 @@ static size_t omap_iommu_unmap(struct iommu_domain *domain, unsigned long da,
 	struct omap_iommu_domain *omap_domain = domain->priv;
 	struct omap_iommu *oiommu = omap_domain->iommu_dev;
 	struct device *dev = oiommu->dev;
+	unsigned long flags;
+	size_t bytes;
+	int omap_pgsz;
 
 	dev_dbg(dev, "unmapping da 0x%lx size %u\n", da, size);
 
-	return iopgtable_clear_entry(oiommu, da);
+	bytes = iopgtable_clear_entry(oiommu, da);
+
+	/* the tlb entry itself was flushed along with the page table one */
+	if (bytes && oiommu->nr_locked) {
+		pm_runtime_get_sync(oiommu->dev);
+		spin_lock_irqsave(&oiommu->tlb_lock, flags);
+		if (__iotlb_unlock_range(oiommu, da, bytes))
+			__iotlb_load_locked(oiommu);
+		spin_unlock_irqrestore(&oiommu->tlb_lock, flags);
+		pm_runtime_put(oiommu->dev);
+	}
+
+	omap_pgsz = bytes_to_iopgsz(bytes);
+	if (omap_pgsz >= 0) {
+		spin_lock(&omap_domain->lock);
+		if (omap_domain->pgsz_count[omap_pgsz])
+			omap_domain->pgsz_count[omap_pgsz]--;
+		spin_unlock(&omap_domain->lock);
+	}
+
+	return bytes;
+}
+
+/* largest iommu page starting at both @da and @pa and fitting in @bytes */
+static size_t omap_iommu_pgsize(u32 da, u32 pa, size_t bytes)
+{
+	size_t pgsz = iopgsz_max(bytes);
+
+	while (pgsz > SZ_4K && !IS_ALIGNED(da | pa, pgsz))
+		pgsz = iopgsz_max(pgsz - 1);
+
+	return pgsz;
+}
+
+/*
+ * map a scatterlist using the largest pages each physically contiguous
+ * run allows, and flush the iotlb once for the whole range at the end.
+ */
+static int omap_iommu_map_sg(struct iommu_domain *domain, unsigned long iova,
+			     struct scatterlist *sgl, unsigned int nents,
+			     int prot)
+{
+	struct omap_iommu_domain *omap_domain = domain->priv;
+	struct omap_iommu *oiommu = omap_domain->iommu_dev;
+	struct scatterlist *sg;
+	u32 da = iova, pa = 0;
+	size_t len = 0;
+	unsigned int i = 0;
+	int ret;
+
+	for (sg = sgl; ; sg = sg_next(sg), i++) {
+		u32 sg_pa = 0;
+		size_t sg_len = 0;
+
+		if (i < nents) {
+			sg_pa = sg_phys(sg) - sg->offset;
+			sg_len = sg->offset + sg->length;
+
+			/* still contiguous, keep growing the run */
+			if (len && pa + len == sg_pa) {
+				len += sg_len;
+				continue;
+			}
+		}
+
+		if (!IS_ALIGNED(da | pa | len, SZ_4K)) {
+			dev_err(oiommu->dev, "unaligned: da 0x%x pa 0x%x "
+				"len 0x%x\n", da, pa, len);
+			ret = -EINVAL;
+			goto unmap;
+		}
+
+		while (len) {
+			size_t pgsz = omap_iommu_pgsize(da, pa, len);
+
+			ret = __omap_iommu_map(omap_domain, da, pa, pgsz, prot,
+					       false);
+			if (ret)
+				goto unmap;
+
+			da += pgsz;
+			pa += pgsz;
+			len -= pgsz;
+		}
+
+		if (i >= nents)
+			break;
+
+		pa = sg_pa;
+		len = sg_len;
+	}
+
+	/* one tlb walk for the whole range instead of one per page */
+	flush_iotlb_range(oiommu, iova, da - iova);
+	return 0;
+
+unmap:
+	if (da != iova)
+		iommu_unmap(domain, iova, da - iova);
+	return ret;
 }
 
 static int
@@ -1325,6 +1615,137 @@ static phys_addr_t omap_iommu_iova_to_phys(struct iommu_domain *domain,
 	return ret;
 }
 
+/**
+ * omap_iommu_lock_region - pin the translations of a region in the tlb
+ * @domain:	iommu domain the region is mapped in
+ * @da:		start of the region
+ * @len:	length of the region
+ * @flags:	MMU_RAM_* attributes the region was mapped with
+ *
+ * Load one locked tlb entry per iommu page of an already mapped region,
+ * so that the remote processor never takes a table walk for it, e.g. for
+ * codec ring buffers or shared ipc memory. Locking a region again makes it
+ * the most recently used one; when no more entries can be locked, the
+ * least recently used ones are evicted. Fails with -ENOSPC if the region
+ * alone needs more entries than can be locked.
+ */
+int omap_iommu_lock_region(struct iommu_domain *domain, u32 da, size_t len,
+			   u32 flags)
+{
+	struct omap_iommu_domain *omap_domain = domain->priv;
+	struct omap_iommu *obj = omap_domain->iommu_dev;
+	struct iotlb_entry e[OMAP_IOMMU_MAX_LOCKED];
+	struct cr_regs crs[OMAP_IOMMU_MAX_LOCKED];
+	u32 start = da, end = da + len;
+	unsigned long lflags;
+	int i, n = 0, evict, err = 0;
+
+	if (!obj || !len)
+		return -EINVAL;
+
+	spin_lock(&obj->page_table_lock);
+	while (da < end) {
+		u32 *pgd, *pte, desc, mask, pgsz;
+
+		iopgtable_lookup_entry(obj, da, &pgd, &pte);
+
+		if (pte && iopte_is_small(*pte)) {
+			desc = *pte;
+			mask = IOPTE_MASK;
+			pgsz = MMU_CAM_PGSZ_4K;
+		} else if (pte && iopte_is_large(*pte)) {
+			desc = *pte;
+			mask = IOLARGE_MASK;
+			pgsz = MMU_CAM_PGSZ_64K;
+		} else if (!pte && iopgd_is_section(*pgd)) {
+			desc = *pgd;
+			mask = IOSECTION_MASK;
+			pgsz = MMU_CAM_PGSZ_1M;
+		} else if (!pte && iopgd_is_super(*pgd)) {
+			desc = *pgd;
+			mask = IOSUPER_MASK;
+			pgsz = MMU_CAM_PGSZ_16M;
+		} else {
+			err = -ENOENT;
+			break;
+		}
+
+		if (n == obj->max_locked) {
+			err = -ENOSPC;
+			break;
+		}
+
+		iotlb_init_entry(&e[n], da & mask, desc & mask,
+				 (flags & ~MMU_CAM_PGSZ_MASK) | pgsz);
+		e[n++].prsvd = MMU_CAM_P;
+
+		da = (da & mask) + ~mask + 1;
+	}
+	spin_unlock(&obj->page_table_lock);
+
+	if (err) {
+		dev_err(obj->dev, "can't lock 0x%x: %d\n", da, err);
+		return err;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct cr_regs *cr = iotlb_alloc_cr(obj, &e[i]);
+
+		if (IS_ERR(cr))
+			return PTR_ERR(cr);
+		crs[i] = *cr;
+		kfree(cr);
+	}
+
+	pm_runtime_get_sync(obj->dev);
+	spin_lock_irqsave(&obj->tlb_lock, lflags);
+
+	/* entries of the region already locked move to the recent end */
+	__iotlb_unlock_range(obj, start, len);
+
+	evict = obj->nr_locked + n - obj->max_locked;
+	if (evict > 0) {
+		obj->nr_locked -= evict;
+		memmove(obj->locked, obj->locked + evict,
+			obj->nr_locked * sizeof(*obj->locked));
+		obj->lock_evictions += evict;
+	}
+	memcpy(obj->locked + obj->nr_locked, crs, n * sizeof(*crs));
+	obj->nr_locked += n;
+
+	__iotlb_load_locked(obj);
+
+	spin_unlock_irqrestore(&obj->tlb_lock, lflags);
+	pm_runtime_put(obj->dev);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(omap_iommu_lock_region);
+
+/**
+ * omap_iommu_unlock_region - release the tlb entries locked for a region
+ * @domain:	iommu domain the region is mapped in
+ * @da:		start of the region
+ * @len:	length of the region
+ */
+void omap_iommu_unlock_region(struct iommu_domain *domain, u32 da, size_t len)
+{
+	struct omap_iommu_domain *omap_domain = domain->priv;
+	struct omap_iommu *obj = omap_domain->iommu_dev;
+	unsigned long flags;
+
+	if (!obj)
+		return;
+
+	pm_runtime_get_sync(obj->dev);
+	spin_lock_irqsave(&obj->tlb_lock, flags);
+	if (__iotlb_unlock_range(obj, da, len))
+		__iotlb_load_locked(obj);
+	spin_unlock_irqrestore(&obj->tlb_lock, flags);
+	pm_runtime_put(obj->dev);
+}
+EXPORT_SYMBOL_GPL(omap_iommu_unlock_region);
+
 static int omap_iommu_domain_has_cap(struct iommu_domain *domain,
 				    unsigned long cap)
 {
@@ -1340,6 +1761,7 @@ static struct iommu_ops omap_iommu_ops = {
 	.domain_idle	= omap_iommu_domain_idle,
 	.map		= omap_iommu_map,
 	.unmap		= omap_iommu_unmap,
+	.map_sg		= omap_iommu_map_sg,
 	.iova_to_phys	= omap_iommu_iova_to_phys,
 	.domain_has_cap	= omap_iommu_domain_has_cap,
 	.pgsize_bitmap	= OMAP_IOMMU_PGSIZES,
@@ -38,7 +38,13 @@
 #include <linux/irq.h>
 #include <linux/videodev2.h>
 #include <linux/dma-mapping.h>
+#include <linux/dma-buf.h>
+#include <linux/scatterlist.h>
 #include <linux/slab.h>
+#if IS_ENABLED(CONFIG_ION_OMAP)
+#include <linux/ion.h>
+#include <linux/omap_ion.h>
+#endif
 
 #include <media/videobuf-dma-contig.h>
 #include <media/v4l2-device.h>
@@ -52,6 +58,10 @@
 #include "omap_voutdef.h"
 #include "omap_vout_vrfb.h"
 
+#ifdef CONFIG_VIDEO_OMAP2_VOUT_TILER
+#include "../../../staging/omapdrm/omap_dmm_tiler.h"
+#endif
+
 MODULE_AUTHOR("Texas Instruments");
 MODULE_DESCRIPTION("OMAP Video for Linux Video out driver");
 MODULE_LICENSE("GPL");
@@ -256,6 +266,197 @@ void omap_vout_free_buffers(struct omap_vout_device *vout)
 	}
 }
 
+/*
+ * Release the dma-buf imported at index i
+ */
+static void omap_vout_dmabuf_put(struct omap_vout_device *vout, int i)
+{
+	struct omap_vout_dmabuf *db = &vout->dmabufs[i];
+
+	if (!db->dbuf)
+		return;
+
+#if IS_ENABLED(CONFIG_ION_OMAP)
+	if (db->handle)
+		ion_free(vout->vid_dev->ion_client, db->handle);
+#endif
+	dma_buf_unmap_attachment(db->attach, db->sgt, DMA_TO_DEVICE);
+	dma_buf_detach(db->dbuf, db->attach);
+	dma_buf_put(db->dbuf);
+	memset(db, 0, sizeof(*db));
+}
+
+static void omap_vout_free_dmabufs(struct omap_vout_device *vout)
+{
+	int i;
+
+	for (i = 0; i < VIDEO_MAX_FRAME; i++)
+		omap_vout_dmabuf_put(vout, i);
+}
+
+/*
+ * Find the address the DSS fetches an imported dma-buf from
+ */
+static int omap_vout_dmabuf_paddr(struct omap_vout_device *vout,
+			struct omap_vout_dmabuf *db)
+{
+	struct scatterlist *sg;
+	dma_addr_t next;
+	int i;
+
+#if IS_ENABLED(CONFIG_ION_OMAP)
+	/* ion TILER buffers are scanned out through their container
+	 * address, which their sg_table does not describe
+	 */
+	if (vout->vid_dev->ion_client) {
+		struct ion_client *client = vout->vid_dev->ion_client;
+		struct ion_handle *handle;
+		ion_phys_addr_t paddr;
+		size_t len;
+
+		handle = ion_import_dma_buf(client, db->fd);
+		if (!IS_ERR_OR_NULL(handle)) {
+			if (!ion_phys(client, handle, &paddr, &len)) {
+				db->handle = handle;
+				db->paddr = paddr;
+				return 0;
+			}
+			ion_free(client, handle);
+		}
+	}
+#endif
+
+	/* anything else must be physically contiguous */
+	next = sg_dma_address(db->sgt->sgl);
+	for_each_sg(db->sgt->sgl, sg, db->sgt->nents, i) {
+		if (sg_dma_address(sg) != next)
+			return -EINVAL;
+		next += sg_dma_len(sg);
+	}
+	db->paddr = sg_dma_address(db->sgt->sgl);
+	return 0;
+}
+
+/*
+ * Import the dma-buf fd queued at index i. Queueing the same buffer
+ * again reuses the existing mapping.
+ */
+static int omap_vout_dmabuf_get(struct omap_vout_device *vout, int i, int fd)
+{
+	struct omap_vout_dmabuf *db = &vout->dmabufs[i];
+	struct device *dev = vout->vid_dev->v4l2_dev.dev;
+	struct dma_buf *dbuf;
+	int ret;
+
+	dbuf = dma_buf_get(fd);
+	if (IS_ERR(dbuf))
+		return PTR_ERR(dbuf);
+
+	if (dbuf == db->dbuf) {
+		dma_buf_put(dbuf);
+		db->fd = fd;
+		return 0;
+	}
+	omap_vout_dmabuf_put(vout, i);
+
+	if (dbuf->size < vout->pix.sizeimage) {
+		ret = -EINVAL;
+		goto dmabuf_put;
+	}
+
+	db->attach = dma_buf_attach(dbuf, dev);
+	if (IS_ERR(db->attach)) {
+		ret = PTR_ERR(db->attach);
+		goto dmabuf_put;
+	}
+
+	db->sgt = dma_buf_map_attachment(db->attach, DMA_TO_DEVICE);
+	if (IS_ERR_OR_NULL(db->sgt)) {
+		ret = db->sgt ? PTR_ERR(db->sgt) : -ENOMEM;
+		goto dmabuf_detach;
+	}
+
+	db->dbuf = dbuf;
+	db->fd = fd;
+	ret = omap_vout_dmabuf_paddr(vout, db);
+	if (ret) {
+		v4l2_err(&vout->vid_dev->v4l2_dev,
+				"dma-buf %d is not contiguous\n", fd);
+		omap_vout_dmabuf_put(vout, i);
+	}
+	return ret;
+
+dmabuf_detach:
+	dma_buf_detach(dbuf, db->attach);
+dmabuf_put:
+	dma_buf_put(dbuf);
+	memset(db, 0, sizeof(*db));
+	return ret;
+}
+
+/*
+ * videobuf only knows DMABUF buffers as USERPTR ones, report them to
+ * user space the way they were queued
+ */
+static void omap_vout_dmabuf_status(struct omap_vout_device *vout,
+			struct v4l2_buffer *b)
+{
+	struct omap_vout_dmabuf *db;
+
+	if (V4L2_MEMORY_DMABUF != vout->memory || b->index >= VIDEO_MAX_FRAME)
+		return;
+
+	db = &vout->dmabufs[b->index];
+	b->memory = V4L2_MEMORY_DMABUF;
+	b->m.fd = db->dbuf ? db->fd : -1;
+	b->length = db->dbuf ? db->dbuf->size : 0;
+}
+
+#ifdef CONFIG_VIDEO_OMAP2_VOUT_TILER
+static bool omap_vout_is_tiler(u32 paddr)
+{
+	return is_tiler_addr(paddr);
+}
+
+/*
+ * Top-left corner of the crop window in the 0 degree view of a TILER
+ * buffer. The DSS derives the rotated and mirrored views from it.
+ */
+static u32 omap_vout_tiler_addr(struct omap_vout_device *vout, u32 paddr)
+{
+	struct tiler_view_t view;
+
+	tilview_create(&view, paddr, vout->pix.width, vout->pix.height);
+	tilview_crop(&view, 0, vout->crop.top, vout->pix.width,
+			vout->crop.height);
+
+	return view.tsptr + vout->crop.left * vout->ps;
+}
+#else
+static bool omap_vout_is_tiler(u32 paddr)
+{
+	return false;
+}
+
+static u32 omap_vout_tiler_addr(struct omap_vout_device *vout, u32 paddr)
+{
+	return paddr;
+}
+#endif
+
+/*
+ * Address of the cropped image in the queued buffer at index i
+ */
+static u32 omap_vout_buf_addr(struct omap_vout_device *vout, int i)
+{
+	u32 addr = (unsigned long) vout->queued_buf_addr[i];
+
+	if (omap_vout_is_tiler(addr))
+		return omap_vout_tiler_addr(vout, addr);
+
+	return addr + vout->cropped_offset;
+}
+
 /*
  * Convert V4L2 rotation to DSS rotation
  *	V4L2 understand 0, 90, 180, 270.
@@ -410,7 +611,11 @@ static int omapvid_setup_overlay(struct omap_vout_device *vout,
 	info.out_width = outw;
 	info.out_height = outh;
 	info.global_alpha = vout->win.global_alpha;
-	if (!is_rotation_enabled(vout)) {
+	if (omap_vout_is_tiler(addr)) {
+		info.rotation = vout->rotation;
+		info.rotation_type = OMAP_DSS_ROT_TILER;
+		info.screen_width = 0;
+	} else if (!is_rotation_enabled(vout)) {
 		info.rotation = 0;
 		info.rotation_type = OMAP_DSS_ROT_DMA;
 		info.screen_width = pixwidth;
@@ -633,8 +838,7 @@ static void omap_vout_isr(void *arg, unsigned int irqstatus)
 
 	vout->next_frm->state = VIDEOBUF_ACTIVE;
 
-	addr = (unsigned long) vout->queued_buf_addr[vout->next_frm->i]
-		+ vout->cropped_offset;
+	addr = omap_vout_buf_addr(vout, vout->next_frm->i);
 
 	/* First save the configuration in ovelray structure */
 	ret = omapvid_init(vout, addr);
@@ -777,7 +981,11 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 	/* if user pointer memory mechanism is used, get the physical
 	 * address of the buffer
 	 */
-	if (V4L2_MEMORY_USERPTR == vb->memory) {
+	if (V4L2_MEMORY_DMABUF == vout->memory) {
+		if (!vout->dmabufs[vb->i].dbuf)
+			return -EINVAL;
+		vout->queued_buf_addr[vb->i] = (u8 *)vout->dmabufs[vb->i].paddr;
+	} else if (V4L2_MEMORY_USERPTR == vb->memory) {
 		if (0 == vb->baddr)
 			return -EINVAL;
 		/* Physical address */
@@ -798,6 +1006,12 @@ static int omap_vout_buffer_prepare(struct videobuf_queue *q,
 		vout->queued_buf_addr[vb->i] = (u8 *)vout->buf_phy_addr[vb->i];
 	}
 
+	/* without VRFB only TILER buffers can be rotated */
+	if (ovid->rotation_type == VOUT_ROT_TILER && is_rotation_enabled(vout) &&
+			!omap_vout_is_tiler((unsigned long)
+				vout->queued_buf_addr[vb->i]))
+		return -EINVAL;
+
 	if (ovid->rotation_type == VOUT_ROT_VRFB)
 		return omap_vout_prepare_vrfb(vout, vb);
 	else
@@ -983,6 +1197,8 @@ static int omap_vout_release(struct file *file)
 		videobuf_queue_cancel(q);
 	}
 
+	omap_vout_free_dmabufs(vout);
+
 	if (vout->mmap_count != 0)
 		vout->mmap_count = 0;
 
@@ -1491,10 +1707,11 @@ static int vidioc_reqbufs(struct file *file, void *fh,
 
 	if ((req->type != V4L2_BUF_TYPE_VIDEO_OUTPUT) || (req->count < 0))
 		return -EINVAL;
-	/* if memory is not mmp or userptr
+	/* if memory is not mmp, userptr or dmabuf
 	   return error */
 	if ((V4L2_MEMORY_MMAP != req->memory) &&
-			(V4L2_MEMORY_USERPTR != req->memory))
+			(V4L2_MEMORY_USERPTR != req->memory) &&
+			(V4L2_MEMORY_DMABUF != req->memory))
 		return -EINVAL;
 
 	mutex_lock(&vout->lock);
@@ -1530,14 +1747,23 @@ static int vidioc_reqbufs(struct file *file, void *fh,
 			vout->buffer_allocated = 0;
 		}
 	}
+	omap_vout_free_dmabufs(vout);
 
 	/*store the memory type in data structure */
 	vout->memory = req->memory;
 
 	INIT_LIST_HEAD(&vout->dma_queue);
 
-	/* call videobuf_reqbufs api */
-	ret = videobuf_reqbufs(q, req);
+	/* call videobuf_reqbufs api, which manages DMABUF buffers as
+	 * USERPTR ones
+	 */
+	if (V4L2_MEMORY_DMABUF == req->memory) {
+		req->memory = V4L2_MEMORY_USERPTR;
+		ret = videobuf_reqbufs(q, req);
+		req->memory = V4L2_MEMORY_DMABUF;
+	} else {
+		ret = videobuf_reqbufs(q, req);
+	}
 	if (ret < 0)
 		goto reqbuf_err;
 
@@ -1552,8 +1778,44 @@ static int vidioc_querybuf(struct file *file, void *fh,
 			struct v4l2_buffer *b)
 {
 	struct omap_vout_device *vout = fh;
+	int ret;
+
+	ret = videobuf_querybuf(&vout->vbq, b);
+	if (!ret)
+		omap_vout_dmabuf_status(vout, b);
+	return ret;
+}
+
+/*
+ * Import the dma-buf and queue it to videobuf as a USERPTR buffer. It
+ * is only swapped while the DSS is not fetching from that index.
+ */
+static int omap_vout_qbuf_dmabuf(struct omap_vout_device *vout,
+			struct v4l2_buffer *buffer)
+{
+	struct videobuf_queue *q = &vout->vbq;
+	struct videobuf_buffer *vb = q->bufs[buffer->index];
+	struct v4l2_buffer b = *buffer;
+	int ret;
+
+	mutex_lock(&vout->lock);
+	if (VIDEOBUF_QUEUED == vb->state || VIDEOBUF_ACTIVE == vb->state) {
+		ret = -EINVAL;
+		goto qbuf_dmabuf_err;
+	}
 
-	return videobuf_querybuf(&vout->vbq, b);
+	ret = omap_vout_dmabuf_get(vout, buffer->index, buffer->m.fd);
+	if (ret)
+		goto qbuf_dmabuf_err;
+
+	b.memory = V4L2_MEMORY_USERPTR;
+	b.m.userptr = vout->dmabufs[buffer->index].paddr;
+	b.length = vout->dmabufs[buffer->index].dbuf->size;
+	ret = videobuf_qbuf(q, &b);
+
+qbuf_dmabuf_err:
+	mutex_unlock(&vout->lock);
+	return ret;
 }
 
 static int vidioc_qbuf(struct file *file, void *fh,
@@ -1561,10 +1823,11 @@ static int vidioc_qbuf(struct file *file, void *fh,
 {
 	struct omap_vout_device *vout = fh;
 	struct videobuf_queue *q = &vout->vbq;
+	struct omapvideo_info *ovid = &vout->vid_info;
 
 	if ((V4L2_BUF_TYPE_VIDEO_OUTPUT != buffer->type) ||
 			(buffer->index >= vout->buffer_allocated) ||
-			(q->bufs[buffer->index]->memory != buffer->memory)) {
+			(vout->memory != buffer->memory)) {
 		return -EINVAL;
 	}
 	if (V4L2_MEMORY_USERPTR == buffer->memory) {
@@ -1574,13 +1837,16 @@ static int vidioc_qbuf(struct file *file, void *fh,
 		}
 	}
 
-	if ((is_rotation_enabled(vout)) &&
+	if (ovid->rotation_type == VOUT_ROT_VRFB && is_rotation_enabled(vout) &&
 			vout->vrfb_dma_tx.req_status == DMA_CHAN_NOT_ALLOTED) {
 		v4l2_warn(&vout->vid_dev->v4l2_dev,
 				"DMA Channel not allocated for Rotation\n");
 		return -EINVAL;
 	}
 
+	if (V4L2_MEMORY_DMABUF == buffer->memory)
+		return omap_vout_qbuf_dmabuf(vout, buffer);
+
 	return videobuf_qbuf(q, buffer);
 }
 
@@ -1606,6 +1872,12 @@ static int vidioc_dqbuf(struct file *file, void *fh, struct v4l2_buffer *b)
 		/* Call videobuf_dqbuf for  blocking mode */
 		ret = videobuf_dqbuf(q, (struct v4l2_buffer *)b, 0);
 
+	if (V4L2_MEMORY_DMABUF == vout->memory) {
+		if (!ret)
+			omap_vout_dmabuf_status(vout, b);
+		return ret;
+	}
+
 	addr = (unsigned long) vout->buf_phy_addr[vb->i];
 	size = (unsigned long) vb->size;
 	dma_unmap_single(vout->vid_dev->v4l2_dev.dev,  addr,
@@ -1656,8 +1928,7 @@ static int vidioc_streamon(struct file *file, void *fh, enum v4l2_buf_type i)
 		ret = -EINVAL;
 		goto streamon_err1;
 	}
-	addr = (unsigned long) vout->queued_buf_addr[vout->cur_frm->i]
-		+ vout->cropped_offset;
+	addr = omap_vout_buf_addr(vout, vout->cur_frm->i);
 
 	mask = DISPC_IRQ_VSYNC | DISPC_IRQ_EVSYNC_EVEN | DISPC_IRQ_EVSYNC_ODD
 		| DISPC_IRQ_VSYNC2;
@@ -2040,9 +2311,14 @@ static int __init omap_vout_create_video_devices(struct platform_device *pdev)
 		vout->vid_info.num_overlays = 1;
 		vout->vid_info.id = k + 1;
 
-		/* Set VRFB as rotation_type for omap2 and omap3 */
+		/* Set VRFB as rotation_type for omap2 and omap3, TILER
+		 * for omap4
+		 */
 		if (cpu_is_omap24xx() || cpu_is_omap34xx())
 			vout->vid_info.rotation_type = VOUT_ROT_VRFB;
+		else if (cpu_is_omap44xx() &&
+				IS_ENABLED(CONFIG_VIDEO_OMAP2_VOUT_TILER))
+			vout->vid_info.rotation_type = VOUT_ROT_TILER;
 
 		/* Setup the default configuration for the video devices
 		 */
@@ -2151,6 +2427,10 @@ static int omap_vout_remove(struct platform_device *pdev)
 
 		omap_dss_put_device(vid_dev->displays[k]);
 	}
+#if IS_ENABLED(CONFIG_ION_OMAP)
+	if (vid_dev->ion_client)
+		ion_client_destroy(vid_dev->ion_client);
+#endif
 	kfree(vid_dev);
 	return 0;
 }
@@ -2233,6 +2513,16 @@ static int __init omap_vout_probe(struct platform_device *pdev)
 		goto probe_err1;
 	}
 
+#if IS_ENABLED(CONFIG_ION_OMAP)
+	if (omap_ion_device) {
+		vid_dev->ion_client = ion_client_create(omap_ion_device,
+				(1 << ION_HEAP_TYPE_CARVEOUT) |
+				(1 << OMAP_ION_HEAP_TYPE_TILER), VOUT_NAME);
+		if (IS_ERR(vid_dev->ion_client))
+			vid_dev->ion_client = NULL;
+	}
+#endif
+
 	ret = omap_vout_create_video_devices(pdev);
 	if (ret)
 		goto probe_err2;
@@ -2248,6 +2538,10 @@ static int __init omap_vout_probe(struct platform_device *pdev)
 	return 0;
 
 probe_err2:
+#if IS_ENABLED(CONFIG_ION_OMAP)
+	if (vid_dev->ion_client)
+		ion_client_destroy(vid_dev->ion_client);
+#endif
 	v4l2_device_unregister(&vid_dev->v4l2_dev);
 probe_err1:
 	for (i = 1; i < vid_dev->num_overlays; i++) {
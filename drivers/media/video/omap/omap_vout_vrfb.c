@@ -129,9 +129,10 @@ int omap_vout_setup_vrfb_bufs(struct platform_device *pdev, int vid_num,
 	vout->vrfb_dma_tx.dev_id = OMAP_DMA_NO_DEVICE;
 	vout->vrfb_dma_tx.dma_ch = -1;
 	vout->vrfb_dma_tx.req_status = DMA_CHAN_ALLOTED;
-	ret = omap_request_dma(vout->vrfb_dma_tx.dev_id, "VRFB DMA TX",
+	ret = omap_request_dma_prio(vout->vrfb_dma_tx.dev_id, "VRFB DMA TX",
 			omap_vout_vrfb_dma_tx_callback,
-			(void *) &vout->vrfb_dma_tx, &vout->vrfb_dma_tx.dma_ch);
+			(void *) &vout->vrfb_dma_tx, &vout->vrfb_dma_tx.dma_ch,
+			OMAP_DMA_PRIO_DISPLAY);
 	if (ret < 0) {
 		vout->vrfb_dma_tx.req_status = DMA_CHAN_NOT_ALLOTED;
 		dev_info(&pdev->dev, ": failed to allocate DMA Channel for"
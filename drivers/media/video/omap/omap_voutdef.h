@@ -48,6 +48,12 @@
 /* Max buffer size tobe allocated during init */
 #define OMAP_VOUT_MAX_BUF_SIZE (VID_MAX_WIDTH*VID_MAX_HEIGHT*4)
 
+struct dma_buf;
+struct dma_buf_attachment;
+struct sg_table;
+struct ion_client;
+struct ion_handle;
+
 enum dma_channel_state {
 	DMA_CHAN_NOT_ALLOTED,
 	DMA_CHAN_ALLOTED,
@@ -68,11 +74,13 @@ enum dss_rotation {
  * DSS2 doesn't understand no rotation as an
  * option while V4L2 driver doesn't support
  * rotation in the case where VRFB is not built in
- * the kernel
+ * the kernel. TILER rotation needs the queued
+ * buffers to be TILER buffers.
  */
 enum vout_rotaion_type {
 	VOUT_ROT_NONE	= 0,
 	VOUT_ROT_VRFB	= 1,
+	VOUT_ROT_TILER	= 2,
 };
 
 /*
@@ -87,6 +95,19 @@ struct vid_vrfb_dma {
 	wait_queue_head_t wait;
 };
 
+/*
+ * A dma-buf queued with V4L2_MEMORY_DMABUF, kept attached and mapped
+ * until another buffer is queued at its index or the buffers are freed
+ */
+struct omap_vout_dmabuf {
+	struct dma_buf *dbuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	struct ion_handle *handle;
+	int fd;
+	u32 paddr;
+};
+
 struct omapvideo_info {
 	int id;
 	int num_overlays;
@@ -108,6 +129,9 @@ struct omap2video_device {
 	struct omap_overlay *overlays[MAX_OVLS];
 	int num_managers;
 	struct omap_overlay_manager *managers[MAX_MANAGERS];
+
+	/* to look up the TILER address of imported ion buffers */
+	struct ion_client *ion_client;
 };
 
 /* per-device data structure */
@@ -172,6 +196,7 @@ struct omap_vout_device {
 	struct videobuf_buffer *cur_frm, *next_frm;
 	struct list_head dma_queue;
 	u8 *queued_buf_addr[VIDEO_MAX_FRAME];
+	struct omap_vout_dmabuf dmabufs[VIDEO_MAX_FRAME];
 	u32 cropped_offset;
 	s32 tv_field1_offset;
 	void *isr_handle;
@@ -55,6 +55,7 @@
 #include <asm/cacheflush.h>
 
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
@@ -63,6 +64,7 @@
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/regulator/consumer.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/vmalloc.h>
@@ -1964,6 +1966,76 @@ error_csiphy:
 	return ret;
 }
 
+/* -----------------------------------------------------------------------------
+ * Debugfs
+ */
+
+#ifdef CONFIG_DEBUG_FS
+
+/*
+ * isp_stats_show - Print the frame statistics of all video nodes
+ *
+ * Every stage writing to or reading from memory completes its buffers
+ * through a video node, so the per node statistics give the per frame
+ * timing and DDR traffic of each stage of the pipeline.
+ */
+static int isp_stats_show(struct seq_file *s, void *unused)
+{
+	struct isp_device *isp = s->private;
+	struct isp_video *videos[] = {
+		&isp->isp_csi2a.video_out,
+		&isp->isp_ccp2.video_in,
+		&isp->isp_ccdc.video_out,
+		&isp->isp_prev.video_in,
+		&isp->isp_prev.video_out,
+		&isp->isp_res.video_in,
+		&isp->isp_res.video_out,
+	};
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(videos); ++i)
+		omap3isp_video_stats_show(videos[i], s);
+
+	return 0;
+}
+
+static int isp_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, isp_stats_show, inode->i_private);
+}
+
+static const struct file_operations isp_stats_fops = {
+	.open = isp_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void isp_debugfs_init(struct isp_device *isp)
+{
+	isp->debugfs_dir = debugfs_create_dir("omap3isp", NULL);
+	if (IS_ERR_OR_NULL(isp->debugfs_dir)) {
+		isp->debugfs_dir = NULL;
+		return;
+	}
+
+	debugfs_create_file("stats", S_IRUGO, isp->debugfs_dir, isp,
+			    &isp_stats_fops);
+}
+
+static void isp_debugfs_cleanup(struct isp_device *isp)
+{
+	debugfs_remove_recursive(isp->debugfs_dir);
+	isp->debugfs_dir = NULL;
+}
+
+#else
+
+static inline void isp_debugfs_init(struct isp_device *isp) { }
+static inline void isp_debugfs_cleanup(struct isp_device *isp) { }
+
+#endif
+
 /*
  * isp_remove - Remove ISP platform device
  * @pdev: Pointer to ISP platform device
@@ -1975,6 +2047,7 @@ static int isp_remove(struct platform_device *pdev)
 	struct isp_device *isp = platform_get_drvdata(pdev);
 	int i;
 
+	isp_debugfs_cleanup(isp);
 	isp_unregister_entities(isp);
 	isp_cleanup_modules(isp);
 
@@ -2163,6 +2236,8 @@ static int isp_probe(struct platform_device *pdev)
 	if (ret < 0)
 		goto error_modules;
 
+	isp_debugfs_init(isp);
+
 	isp_power_settings(isp, 1);
 	omap3isp_put(isp);
 
@@ -215,6 +215,8 @@ struct isp_device {
 	struct iommu_domain *domain;
 
 	struct isp_platform_callback platform_cb;
+
+	struct dentry *debugfs_dir;
 };
 
 #define v4l2_dev_to_isp_device(dev) \
@@ -24,6 +24,7 @@
  */
 
 #include <asm/cacheflush.h>
+#include <linux/dma-buf.h>
 #include <linux/dma-mapping.h>
 #include <linux/mm.h>
 #include <linux/pagemap.h>
@@ -66,7 +67,7 @@
 
 static void isp_video_buffer_cache_sync(struct isp_video_buffer *buf)
 {
-	if (buf->skip_cache)
+	if (buf->skip_cache || buf->vbuf.memory == V4L2_MEMORY_DMABUF)
 		return;
 
 	if (buf->vbuf.m.userptr == 0 || buf->npages == 0 ||
@@ -266,6 +267,24 @@ static void isp_video_buffer_cleanup(struct isp_video_buffer *buf)
 	if (buf->queue->ops->buffer_cleanup)
 		buf->queue->ops->buffer_cleanup(buf);
 
+	if (buf->dbuf != NULL) {
+		direction = buf->vbuf.type == V4L2_BUF_TYPE_VIDEO_CAPTURE
+			  ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+		if (buf->dbuf_sgt != NULL)
+			dma_buf_unmap_attachment(buf->dbuf_attach,
+						 buf->dbuf_sgt, direction);
+		if (buf->dbuf_attach != NULL)
+			dma_buf_detach(buf->dbuf, buf->dbuf_attach);
+		dma_buf_put(buf->dbuf);
+
+		buf->dbuf_sgt = NULL;
+		buf->dbuf_attach = NULL;
+		buf->dbuf = NULL;
+		buf->sglist = NULL;
+		buf->sglen = 0;
+		return;
+	}
+
 	if (!(buf->vm_flags & VM_PFNMAP)) {
 		direction = buf->vbuf.type == V4L2_BUF_TYPE_VIDEO_CAPTURE
 			  ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
@@ -404,6 +423,53 @@ done:
 	return ret;
 }
 
+/*
+ * isp_video_buffer_prepare_dmabuf - Import a dma-buf file descriptor
+ *
+ * Attach the ISP to the dma-buf and map the attachment. The exporter's
+ * scatter list is used as is: it is already DMA-mapped for the ISP, so
+ * the buffer is neither pinned nor DMA-mapped here. The mapping is kept
+ * until the buffer is requeued with a different dma-buf or freed, so that
+ * requeuing the same buffer costs nothing.
+ *
+ * CPU cache maintenance is left to the exporter, which makes the buffer
+ * coherent for the device when the attachment is mapped, and to the CPU
+ * users of the buffer which must bracket their accesses with
+ * dma_buf_begin_cpu_access() and dma_buf_end_cpu_access().
+ */
+static int isp_video_buffer_prepare_dmabuf(struct isp_video_buffer *buf,
+					   struct dma_buf *dbuf)
+{
+	enum dma_data_direction direction;
+	struct sg_table *sgt;
+	int ret;
+
+	if (dbuf->size < buf->vbuf.length) {
+		dma_buf_put(dbuf);
+		return -EINVAL;
+	}
+
+	buf->dbuf = dbuf;
+	buf->dbuf_attach = dma_buf_attach(dbuf, buf->queue->dev);
+	if (IS_ERR(buf->dbuf_attach)) {
+		ret = PTR_ERR(buf->dbuf_attach);
+		buf->dbuf_attach = NULL;
+		return ret;
+	}
+
+	direction = buf->vbuf.type == V4L2_BUF_TYPE_VIDEO_CAPTURE
+		  ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
+	sgt = dma_buf_map_attachment(buf->dbuf_attach, direction);
+	if (IS_ERR_OR_NULL(sgt))
+		return sgt ? PTR_ERR(sgt) : -ENOMEM;
+
+	buf->dbuf_sgt = sgt;
+	buf->sglist = sgt->sgl;
+	buf->sglen = sgt->nents;
+
+	return 0;
+}
+
 /*
  * isp_video_buffer_prepare_vm_flags - Get VMA flags for a userspace address
  *
@@ -468,6 +534,7 @@ done:
  * Preparing a buffer involves:
  *
  * - validating VMAs (userspace buffers only)
+ * - attaching to and mapping the dma-buf (DMABUF buffers only)
  * - locking pages and VMAs into memory (userspace buffers only)
  * - building page and scatter-gather lists
  * - mapping buffers for DMA operation
@@ -477,7 +544,8 @@ done:
  * (this excludes cleanup paths such as sys_close when the userspace process
  * segfaults).
  */
-static int isp_video_buffer_prepare(struct isp_video_buffer *buf)
+static int isp_video_buffer_prepare(struct isp_video_buffer *buf,
+				    struct dma_buf *dbuf)
 {
 	enum dma_data_direction direction;
 	int ret;
@@ -507,6 +575,10 @@ static int isp_video_buffer_prepare(struct isp_video_buffer *buf)
 		}
 		break;
 
+	case V4L2_MEMORY_DMABUF:
+		ret = isp_video_buffer_prepare_dmabuf(buf, dbuf);
+		break;
+
 	default:
 		return -EINVAL;
 	}
@@ -514,7 +586,7 @@ static int isp_video_buffer_prepare(struct isp_video_buffer *buf)
 	if (ret < 0)
 		goto done;
 
-	if (!(buf->vm_flags & VM_PFNMAP)) {
+	if (!(buf->vm_flags & VM_PFNMAP) && buf->dbuf == NULL) {
 		direction = buf->vbuf.type == V4L2_BUF_TYPE_VIDEO_CAPTURE
 			  ? DMA_FROM_DEVICE : DMA_TO_DEVICE;
 		ret = dma_map_sg(buf->queue->dev, buf->sglist, buf->sglen,
@@ -842,12 +914,14 @@ done:
  *
  * Before being enqueued, USERPTR buffers are checked for address changes. If
  * the buffer has a different userspace address, the old memory area is unlocked
- * and the new memory area is locked.
+ * and the new memory area is locked. DMABUF buffers are likewise re-imported
+ * only when the file descriptor refers to a different dma-buf.
  */
 int omap3isp_video_queue_qbuf(struct isp_video_queue *queue,
 			      struct v4l2_buffer *vbuf)
 {
 	struct isp_video_buffer *buf;
+	struct dma_buf *dbuf = NULL;
 	unsigned long flags;
 	int ret = -EINVAL;
 
@@ -878,8 +952,27 @@ int omap3isp_video_queue_qbuf(struct isp_video_queue *queue,
 		buf->prepared = 0;
 	}
 
+	if (vbuf->memory == V4L2_MEMORY_DMABUF) {
+		dbuf = dma_buf_get(vbuf->m.fd);
+		if (IS_ERR(dbuf)) {
+			ret = PTR_ERR(dbuf);
+			goto done;
+		}
+
+		if (dbuf == buf->dbuf) {
+			/* Same buffer, keep the existing mapping. */
+			dma_buf_put(dbuf);
+			dbuf = NULL;
+		} else {
+			isp_video_buffer_cleanup(buf);
+			buf->prepared = 0;
+		}
+		buf->vbuf.m.fd = vbuf->m.fd;
+	}
+
 	if (!buf->prepared) {
-		ret = isp_video_buffer_prepare(buf);
+		/* The buffer takes over the dbuf reference. */
+		ret = isp_video_buffer_prepare(buf, dbuf);
 		if (ret < 0)
 			goto done;
 		buf->prepared = 1;
@@ -32,9 +32,12 @@
 #include <linux/videodev2.h>
 #include <linux/wait.h>
 
+struct dma_buf;
+struct dma_buf_attachment;
 struct isp_video_queue;
 struct page;
 struct scatterlist;
+struct sg_table;
 
 #define ISP_VIDEO_MAX_BUFFERS		16
 
@@ -72,6 +75,10 @@ enum isp_video_buffer_state {
  * @npages: Number of pages (for userspace buffers)
  * @pages: Pages table (for userspace non-VM_PFNMAP buffers)
  * @paddr: Memory physical address (for userspace VM_PFNMAP buffers)
+ * @dbuf: Imported dma-buf (for DMABUF buffers)
+ * @dbuf_attach: Attachment of the ISP to @dbuf (for DMABUF buffers)
+ * @dbuf_sgt: Exporter scatter table, @sglist points into it (for DMABUF
+ *	buffers)
  * @sglen: Number of elements in the scatter list (for non-VM_PFNMAP buffers)
  * @sglist: Scatter list (for non-VM_PFNMAP buffers)
  * @vbuf: V4L2 buffer
@@ -96,6 +103,11 @@ struct isp_video_buffer {
 	struct page **pages;
 	dma_addr_t paddr;
 
+	/* For DMABUF buffers. */
+	struct dma_buf *dbuf;
+	struct dma_buf_attachment *dbuf_attach;
+	struct sg_table *dbuf_sgt;
+
 	/* For all buffers except VM_PFNMAP. */
 	unsigned int sglen;
 	struct scatterlist *sglist;
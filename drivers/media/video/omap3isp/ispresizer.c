@@ -650,16 +650,27 @@ static void resizer_set_inaddr(struct isp_res_device *res, u32 addr)
  * Note: For SBL efficiency reasons the address should be on a 256-byte
  * boundary.
  */
-static void resizer_set_outaddr(struct isp_res_device *res, u32 addr)
+static void __resizer_set_outaddr(struct isp_res_device *res, u32 addr)
 {
 	struct isp_device *isp = to_isp_device(res);
 
+	isp_reg_writel(isp, addr << ISPRSZ_SDR_OUTADD_ADDR_SHIFT,
+		       OMAP3_ISP_IOMEM_RESZ, ISPRSZ_SDR_OUTADD);
+}
+
+static void resizer_set_outaddr(struct isp_res_device *res, u32 addr)
+{
 	/*
 	 * Set output address. This needs to be in its own function
-	 * because it changes often.
+	 * because it changes often. When resizing in several passes only
+	 * the last one writes to the output buffer, the address will be
+	 * programmed by resizer_configure_pass().
 	 */
-	isp_reg_writel(isp, addr << ISPRSZ_SDR_OUTADD_ADDR_SHIFT,
-		       OMAP3_ISP_IOMEM_RESZ, ISPRSZ_SDR_OUTADD);
+	res->out_addr = addr;
+	if (res->pass_count > 1 && res->pass != res->pass_count - 1)
+		return;
+
+	__resizer_set_outaddr(res, addr);
 }
 
 /*
@@ -915,6 +926,68 @@ static void resizer_calc_ratios(struct isp_res_device *res,
 	input->height = height;
 }
 
+/*
+ * resizer_calc_passes - Split resizing in passes of at most 4x downscaling
+ * @res : pointer to resizer private data structure
+ * @input : input frame crop, adjusted for the first pass
+ * @output : output frame, clamped to the size reachable in all passes
+ * @ratio : return calculated ratios of the first pass
+ * @passes : return the configuration of all passes, can be NULL
+ *
+ * The resizer can't downscale by more than 4 in a single pass. When reading
+ * from memory, larger ratios are achieved by resizing the frame several
+ * times, through intermediate buffers: every pass but the last one downscales
+ * as much as possible, the last one produces the requested size. Crop is
+ * applied to the first pass only, later passes use their whole input.
+ *
+ * Return the number of passes.
+ */
+static unsigned int resizer_calc_passes(struct isp_res_device *res,
+					struct v4l2_rect *input,
+					struct v4l2_mbus_framefmt *output,
+					struct resizer_ratio *ratio,
+					struct resizer_pass *passes)
+{
+	unsigned int max_passes = res->input == RESIZER_INPUT_MEMORY
+				? RESIZER_MAX_PASSES : 1;
+	struct v4l2_mbus_framefmt format;
+	struct resizer_ratio pass_ratio;
+	struct v4l2_rect crop = *input;
+	unsigned int count = 0;
+
+	while (1) {
+		format = *output;
+		resizer_calc_ratios(res, &crop, &format, &pass_ratio);
+
+		if (passes != NULL) {
+			passes[count].crop = crop;
+			passes[count].format = format;
+			passes[count].ratio = pass_ratio;
+		}
+		if (count == 0) {
+			*input = crop;
+			*ratio = pass_ratio;
+		}
+
+		/* An intermediate pass is needed only when the requested size
+		 * is smaller than the minimum reachable in this pass.
+		 */
+		if (++count == max_passes ||
+		    (format.width <= output->width &&
+		     format.height <= output->height))
+			break;
+
+		crop.left = 0;
+		crop.top = 0;
+		crop.width = format.width;
+		crop.height = format.height;
+	}
+
+	output->width = format.width;
+	output->height = format.height;
+	return count;
+}
+
 /*
  * resizer_set_crop_params - Setup hardware with cropping parameters
  * @res : resizer private structure
@@ -970,6 +1043,126 @@ static void resizer_set_crop_params(struct isp_res_device *res,
 			       res->crop.active.height);
 }
 
+/*
+ * resizer_free_passes - Release the intermediate buffers
+ * @res : resizer private structure
+ */
+static void resizer_free_passes(struct isp_res_device *res)
+{
+	struct isp_device *isp = to_isp_device(res);
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(res->pass_buf); ++i) {
+		if (res->pass_buf[i])
+			omap_iommu_vfree(isp->domain, isp->dev,
+					 res->pass_buf[i]);
+		res->pass_buf[i] = 0;
+	}
+
+	res->pass_count = 1;
+	res->pass = 0;
+}
+
+/*
+ * resizer_prepare_passes - Compute the passes and allocate their buffers
+ * @res : resizer private structure
+ *
+ * Passes alternate between two intermediate buffers, sized for the largest
+ * intermediate frame. Single pass configurations don't need any.
+ *
+ * Return 0 on success or -ENOMEM if the buffers can't be allocated.
+ */
+static int resizer_prepare_passes(struct isp_res_device *res)
+{
+	struct isp_device *isp = to_isp_device(res);
+	struct v4l2_mbus_framefmt format = res->formats[RESZ_PAD_SOURCE];
+	struct v4l2_rect crop = res->crop.active;
+	struct resizer_ratio ratio;
+	unsigned int nbufs;
+	size_t size = 0;
+	unsigned int i;
+
+	res->pass = 0;
+	res->pass_count = resizer_calc_passes(res, &crop, &format, &ratio,
+					      res->passes);
+	if (res->pass_count == 1)
+		return 0;
+
+	for (i = 0; i < res->pass_count - 1; ++i) {
+		const struct v4l2_mbus_framefmt *fmt = &res->passes[i].format;
+
+		size = max_t(size_t, size,
+			     ALIGN(fmt->width * 2, 32) * fmt->height);
+	}
+
+	nbufs = min_t(unsigned int, res->pass_count - 1,
+		      ARRAY_SIZE(res->pass_buf));
+	for (i = 0; i < nbufs; ++i) {
+		u32 da = omap_iommu_vmalloc(isp->domain, isp->dev, 0, size,
+					    IOMMU_FLAG);
+
+		if (IS_ERR_VALUE(da)) {
+			dev_err(isp->dev, "%s: cannot allocate %zu bytes "
+				"intermediate buffer\n", __func__, size);
+			resizer_free_passes(res);
+			return -ENOMEM;
+		}
+		res->pass_buf[i] = da;
+	}
+
+	dev_dbg(isp->dev, "%s: %u passes, %zu bytes intermediate buffers\n",
+		__func__, res->pass_count, size);
+	return 0;
+}
+
+/*
+ * resizer_configure_pass - Program the resizer for one pass
+ * @res : resizer private structure
+ * @pass : pass number
+ *
+ * The first pass reads the input buffer with the active crop rectangle, the
+ * following ones read the previous pass output. All passes but the last one
+ * write to an intermediate buffer.
+ */
+static void resizer_configure_pass(struct isp_res_device *res,
+				   unsigned int pass)
+{
+	const struct resizer_pass *cfg = &res->passes[pass];
+	const struct v4l2_mbus_framefmt *informat;
+	u32 inoff;
+	u32 offset;
+
+	informat = pass ? &res->passes[pass - 1].format
+		 : &res->formats[RESZ_PAD_SINK];
+	inoff = ALIGN(informat->width, 0x10) * 2;
+
+	resizer_set_input_offset(res, inoff);
+	resizer_set_output_offset(res, ALIGN(cfg->format.width * 2, 32));
+	resizer_set_output_size(res, cfg->format.width, cfg->format.height);
+
+	if (pass == 0) {
+		resizer_set_crop_params(res, informat, &cfg->format);
+	} else {
+		resizer_set_ratio(res, &cfg->ratio);
+		if (cfg->ratio.horz >= RESIZE_DIVISOR)
+			resizer_set_bilinear(res, RSZ_THE_SAME);
+		else
+			resizer_set_bilinear(res, RSZ_BILINEAR);
+
+		offset = cfg->crop.top * inoff + cfg->crop.left * 2;
+		resizer_set_start(res, (offset / 2) & 0xf, 0);
+		__resizer_set_inaddr(res, res->pass_buf[(pass - 1) % 2]
+				     + (offset & ~0x1f));
+		resizer_set_input_size(res, cfg->crop.width,
+				       cfg->crop.height);
+	}
+
+	if (pass == res->pass_count - 1)
+		__resizer_set_outaddr(res, res->out_addr);
+	else
+		__resizer_set_outaddr(res, res->pass_buf[pass % 2]);
+}
+
 static void resizer_configure(struct isp_res_device *res)
 {
 	struct v4l2_mbus_framefmt *informat, *outformat;
@@ -992,6 +1185,11 @@ static void resizer_configure(struct isp_res_device *res)
 	resizer_set_phase(res, DEFAULT_PHASE, DEFAULT_PHASE);
 	resizer_set_luma(res, &luma);
 
+	if (res->pass_count > 1) {
+		resizer_configure_pass(res, 0);
+		return;
+	}
+
 	/* RESZ_PAD_SOURCE */
 	resizer_set_output_offset(res, ALIGN(outformat->width * 2, 32));
 	resizer_set_output_size(res, outformat->width, outformat->height);
@@ -1088,6 +1286,20 @@ void omap3isp_resizer_isr(struct isp_res_device *res)
 		res->applycrop = 0;
 	}
 
+	/* Run the next pass, or get ready for the first pass of the next
+	 * frame before completing the buffers.
+	 */
+	if (res->pass_count > 1) {
+		if (++res->pass < res->pass_count) {
+			resizer_configure_pass(res, res->pass);
+			resizer_enable_oneshot(res);
+			return;
+		}
+
+		res->pass = 0;
+		resizer_configure_pass(res, 0);
+	}
+
 	resizer_isr_buffer(res);
 }
 
@@ -1145,11 +1357,16 @@ static int resizer_set_stream(struct v4l2_subdev *sd, int enable)
 	struct isp_video *video_out = &res->video_out;
 	struct isp_device *isp = to_isp_device(res);
 	struct device *dev = to_device(res);
+	int ret;
 
 	if (res->state == ISP_PIPELINE_STREAM_STOPPED) {
 		if (enable == ISP_PIPELINE_STREAM_STOPPED)
 			return 0;
 
+		ret = resizer_prepare_passes(res);
+		if (ret < 0)
+			return ret;
+
 		omap3isp_subclk_enable(isp, OMAP3_ISP_SUBCLK_RESIZER);
 		resizer_configure(res);
 		resizer_print_status(res);
@@ -1180,6 +1397,7 @@ static int resizer_set_stream(struct v4l2_subdev *sd, int enable)
 				OMAP3_ISP_SBL_RESIZER_WRITE);
 		omap3isp_subclk_disable(isp, OMAP3_ISP_SUBCLK_RESIZER);
 		isp_video_dmaqueue_flags_clr(video_out);
+		resizer_free_passes(res);
 		break;
 	}
 
@@ -1208,7 +1426,7 @@ static int resizer_g_crop(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh,
 
 	format = __resizer_get_format(res, fh, RESZ_PAD_SOURCE, crop->which);
 	crop->rect = *__resizer_get_crop(res, fh, crop->which);
-	resizer_calc_ratios(res, &crop->rect, format, &ratio);
+	resizer_calc_passes(res, &crop->rect, format, &ratio, NULL);
 
 	return 0;
 }
@@ -1216,7 +1434,8 @@ static int resizer_g_crop(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh,
 /*
  * resizer_try_crop - mangles crop parameters.
  */
-static void resizer_try_crop(const struct v4l2_mbus_framefmt *sink,
+static void resizer_try_crop(struct isp_res_device *res,
+			     const struct v4l2_mbus_framefmt *sink,
 			     const struct v4l2_mbus_framefmt *source,
 			     struct v4l2_rect *crop)
 {
@@ -1224,16 +1443,20 @@ static void resizer_try_crop(const struct v4l2_mbus_framefmt *sink,
 	const unsigned int sph = DEFAULT_PHASE;
 
 	/* Crop rectangle is constrained to the output size so that zoom ratio
-	 * cannot exceed +/-4.0.
+	 * cannot exceed +/-4.0, per pass when downscaling from memory.
 	 */
+	unsigned int shift = res->input == RESIZER_INPUT_MEMORY
+			   ? 2 * (RESIZER_MAX_PASSES - 1) : 0;
 	unsigned int min_width =
 		((32 * sph + (source->width - 1) * 64 + 16) >> 8) + 7;
 	unsigned int min_height =
 		((32 * spv + (source->height - 1) * 64 + 16) >> 8) + 4;
 	unsigned int max_width =
-		((64 * sph + (source->width - 1) * 1024 + 32) >> 8) + 7;
+		(((64 * sph + (source->width - 1) * 1024 + 32) >> 8) + 7)
+		<< shift;
 	unsigned int max_height =
-		((64 * spv + (source->height - 1) * 1024 + 32) >> 8) + 7;
+		(((64 * spv + (source->height - 1) * 1024 + 32) >> 8) + 7)
+		<< shift;
 
 	crop->width = clamp_t(u32, crop->width, min_width, max_width);
 	crop->height = clamp_t(u32, crop->height, min_height, max_height);
@@ -1280,9 +1503,23 @@ static int resizer_s_crop(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh,
 		format_sink->width, format_sink->height,
 		format_source->width, format_source->height);
 
-	resizer_try_crop(format_sink, format_source, &crop->rect);
+	resizer_try_crop(res, format_sink, format_source, &crop->rect);
+
+	/* The passes and their buffers are fixed while streaming, only single
+	 * pass crop changes can be applied on the fly.
+	 */
+	if (crop->which == V4L2_SUBDEV_FORMAT_ACTIVE &&
+	    res->state != ISP_PIPELINE_STREAM_STOPPED) {
+		struct v4l2_mbus_framefmt format = *format_source;
+		struct v4l2_rect rect = crop->rect;
+
+		if (res->pass_count > 1 ||
+		    resizer_calc_passes(res, &rect, &format, &ratio, NULL) > 1)
+			return -EBUSY;
+	}
+
 	*__resizer_get_crop(res, fh, crop->which) = crop->rect;
-	resizer_calc_ratios(res, &crop->rect, format_source, &ratio);
+	resizer_calc_passes(res, &crop->rect, format_source, &ratio, NULL);
 
 	if (crop->which == V4L2_SUBDEV_FORMAT_TRY)
 		return 0;
@@ -1354,7 +1591,7 @@ static void resizer_try_format(struct isp_res_device *res,
 		fmt->code = format->code;
 
 		crop = *__resizer_get_crop(res, fh, which);
-		resizer_calc_ratios(res, &crop, fmt, &ratio);
+		resizer_calc_passes(res, &crop, fmt, &ratio, NULL);
 		break;
 	}
 
@@ -1487,8 +1724,8 @@ static int resizer_set_format(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh,
 		 * format.
 		 */
 		res->crop.active = res->crop.request;
-		resizer_calc_ratios(res, &res->crop.active, format,
-				       &res->ratio);
+		resizer_calc_passes(res, &res->crop.active, format,
+				    &res->ratio, NULL);
 	}
 
 	return 0;
@@ -1724,6 +1961,7 @@ int omap3isp_resizer_init(struct isp_device *isp)
 
 	init_waitqueue_head(&res->wait);
 	atomic_set(&res->stopping, 0);
+	res->pass_count = 1;
 	return resizer_init_entities(res);
 }
 
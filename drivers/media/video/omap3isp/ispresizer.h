@@ -89,6 +89,25 @@ enum resizer_input_entity {
 	RESIZER_INPUT_MEMORY,
 };
 
+/*
+ * Maximum number of resizer passes in memory-to-memory mode. A single pass
+ * downscales by up to 4, three passes by up to 64.
+ */
+#define RESIZER_MAX_PASSES		3
+
+/*
+ * struct resizer_pass - Configuration of one memory-to-memory resizer pass
+ * @crop: Input crop rectangle
+ * @format: Output format, stored in an intermediate buffer for all passes
+ *	but the last one
+ * @ratio: Resizing ratios
+ */
+struct resizer_pass {
+	struct v4l2_rect crop;
+	struct v4l2_mbus_framefmt format;
+	struct resizer_ratio ratio;
+};
+
 /* Sink and source resizer pads */
 #define RESZ_PAD_SINK			0
 #define RESZ_PAD_SOURCE			1
@@ -98,6 +117,12 @@ enum resizer_input_entity {
  * struct isp_res_device - OMAP3 ISP resizer module
  * @crop.request: Crop rectangle requested by the user
  * @crop.active: Active crop rectangle (based on hardware requirements)
+ * @passes: Passes configuration when downscaling from memory by more than 4
+ * @pass_count: Number of passes per frame, 1 unless downscaling by more
+ *	than 4 from memory
+ * @pass: Pass being processed
+ * @pass_buf: ISP MMU addresses of the intermediate buffers
+ * @out_addr: Output buffer address, written by the last pass
  */
 struct isp_res_device {
 	struct v4l2_subdev subdev;
@@ -121,6 +146,12 @@ struct isp_res_device {
 		struct v4l2_rect request;
 		struct v4l2_rect active;
 	} crop;
+
+	struct resizer_pass passes[RESIZER_MAX_PASSES];
+	unsigned int pass_count;
+	unsigned int pass;
+	u32 pass_buf[2];
+	u32 out_addr;
 };
 
 struct isp_device;
@@ -30,6 +30,7 @@
 #include <linux/pagemap.h>
 #include <linux/scatterlist.h>
 #include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <media/v4l2-dev.h>
@@ -594,6 +595,67 @@ static const struct isp_video_queue_operations isp_video_queue_ops = {
  * Return a pointer to the next buffer in the DMA queue, or NULL if the queue is
  * empty.
  */
+/*
+ * isp_video_stats_update - Account a completed buffer
+ * @video: ISP video object
+ * @buf: Completed buffer
+ * @ts: Completion time
+ */
+static void isp_video_stats_update(struct isp_video *video,
+				   struct isp_video_buffer *buf,
+				   const struct timespec *ts)
+{
+	struct isp_video_stats *stats = &video->stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&video->stats_lock, flags);
+
+	if (stats->frames) {
+		struct timespec delta = timespec_sub(*ts, stats->last);
+		u32 interval = delta.tv_sec * USEC_PER_SEC
+			     + delta.tv_nsec / NSEC_PER_USEC;
+
+		stats->interval_last = interval;
+		if (stats->frames == 1 || interval < stats->interval_min)
+			stats->interval_min = interval;
+		if (interval > stats->interval_max)
+			stats->interval_max = interval;
+	}
+
+	stats->frames++;
+	if (buf->state == ISP_BUF_STATE_ERROR)
+		stats->errors++;
+	stats->bytes += buf->vbuf.bytesused;
+	stats->last = *ts;
+
+	spin_unlock_irqrestore(&video->stats_lock, flags);
+}
+
+/*
+ * omap3isp_video_stats_show - Print the video node frame statistics
+ * @video: ISP video object
+ * @s: seq_file to print to
+ */
+void omap3isp_video_stats_show(struct isp_video *video, struct seq_file *s)
+{
+	struct isp_video_stats stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&video->stats_lock, flags);
+	stats = video->stats;
+	spin_unlock_irqrestore(&video->stats_lock, flags);
+
+	seq_printf(s, "%s:\n", video->video.name);
+	seq_printf(s, "  frames %u errors %u underruns %u\n",
+		   stats.frames, stats.errors, stats.underruns);
+	seq_printf(s, "  %s %llu bytes\n",
+		   video->type == V4L2_BUF_TYPE_VIDEO_CAPTURE
+		   ? "written" : "read", stats.bytes);
+	seq_printf(s, "  interval last %u min %u max %u us\n",
+		   stats.interval_last, stats.interval_min,
+		   stats.interval_max);
+}
+
 struct isp_buffer *omap3isp_video_buffer_next(struct isp_video *video)
 {
 	struct isp_pipeline *pipe = to_isp_pipeline(&video->video.entity);
@@ -637,6 +699,8 @@ struct isp_buffer *omap3isp_video_buffer_next(struct isp_video *video)
 		buf->state = ISP_BUF_STATE_DONE;
 	}
 
+	isp_video_stats_update(video, buf, &ts);
+
 	wake_up(&buf->wait);
 
 	if (list_empty(&video->dmaqueue)) {
@@ -649,8 +713,12 @@ struct isp_buffer *omap3isp_video_buffer_next(struct isp_video *video)
 
 		spin_lock_irqsave(&pipe->lock, flags);
 		pipe->state &= ~state;
-		if (video->pipe.stream_state == ISP_PIPELINE_STREAM_CONTINUOUS)
+		if (video->pipe.stream_state == ISP_PIPELINE_STREAM_CONTINUOUS) {
 			video->dmaqueue_flags |= ISP_VIDEO_DMAQUEUE_UNDERRUN;
+			spin_lock(&video->stats_lock);
+			video->stats.underruns++;
+			spin_unlock(&video->stats_lock);
+		}
 		spin_unlock_irqrestore(&pipe->lock, flags);
 		return NULL;
 	}
@@ -1039,6 +1107,10 @@ isp_video_streamon(struct file *file, void *fh, enum v4l2_buf_type type)
 	INIT_LIST_HEAD(&video->dmaqueue);
 	atomic_set(&pipe->frame_number, -1);
 
+	spin_lock_irqsave(&video->stats_lock, flags);
+	memset(&video->stats, 0, sizeof(video->stats));
+	spin_unlock_irqrestore(&video->stats_lock, flags);
+
 	ret = omap3isp_video_queue_streamon(&vfh->queue);
 	if (ret < 0)
 		goto error;
@@ -1315,6 +1387,7 @@ int omap3isp_video_init(struct isp_video *video, const char *name)
 
 	spin_lock_init(&video->pipe.lock);
 	mutex_init(&video->stream_lock);
+	spin_lock_init(&video->stats_lock);
 
 	/* Initialize the video device. */
 	if (video->ops == NULL)
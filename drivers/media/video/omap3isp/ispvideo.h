@@ -38,6 +38,7 @@
 
 struct isp_device;
 struct isp_video;
+struct seq_file;
 struct v4l2_mbus_framefmt;
 struct v4l2_pix_format;
 
@@ -148,6 +149,32 @@ struct isp_video_operations {
 	int(*queue)(struct isp_video *video, struct isp_buffer *buffer);
 };
 
+/**
+ * struct isp_video_stats - Frame statistics of a video node
+ * @frames: Number of buffers completed
+ * @errors: Number of buffers completed with an error (capture nodes only)
+ * @underruns: Number of times the DMA queue ran dry during a continuous
+ *	stream, frames are dropped until a buffer is queued
+ * @bytes: Bytes written to (capture) or read from (output) memory
+ * @last: Completion time of the last buffer
+ * @interval_last: Time between the last two completions, in us
+ * @interval_min: Shortest time between two completions, in us
+ * @interval_max: Longest time between two completions, in us
+ *
+ * The statistics are reset when streaming starts, the interval range then
+ * gives the frame jitter of the stream at this stage of the pipeline.
+ */
+struct isp_video_stats {
+	u32 frames;
+	u32 errors;
+	u32 underruns;
+	u64 bytes;
+	struct timespec last;
+	u32 interval_last;
+	u32 interval_min;
+	u32 interval_max;
+};
+
 struct isp_video {
 	struct video_device video;
 	enum v4l2_buf_type type;
@@ -178,6 +205,10 @@ struct isp_video {
 	enum isp_video_dmaqueue_flags dmaqueue_flags;
 
 	const struct isp_video_operations *ops;
+
+	/* Frame statistics */
+	spinlock_t stats_lock;
+	struct isp_video_stats stats;
 };
 
 #define to_isp_video(vdev)	container_of(vdev, struct isp_video, video)
@@ -199,6 +230,7 @@ void omap3isp_video_cleanup(struct isp_video *video);
 int omap3isp_video_register(struct isp_video *video,
 			    struct v4l2_device *vdev);
 void omap3isp_video_unregister(struct isp_video *video);
+void omap3isp_video_stats_show(struct isp_video *video, struct seq_file *s);
 struct isp_buffer *omap3isp_video_buffer_next(struct isp_video *video);
 void omap3isp_video_resume(struct isp_video *video, int continuous);
 struct media_pad *omap3isp_video_remote_pad(struct isp_video *video);
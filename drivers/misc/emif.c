@@ -23,12 +23,41 @@
 #include <linux/module.h>
 #include <linux/list.h>
 #include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 #include <misc/jedec_ddr.h>
 #include <linux/notifier.h>
 #include <linux/pm.h>
 #include <mach/common.h>
 #include "emif.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/emif.h>
+
+/**
+ * struct emif_bw - Bandwidth measured with the performance counters
+ * @slot:			What counter 2 counts in the current window:
+ *				reads, writes, then each initiator class
+ * @cnt1:			Counter 1 value at the start of the window
+ * @cnt2:			Counter 2 value at the start of the window
+ * @stamp:			Start of the window
+ * @total:			Bytes/s of all accesses in the last window
+ * @read:			Bytes/s of reads, last time they were counted
+ * @write:			Bytes/s of writes, likewise
+ * @initiator:			Bytes/s of each initiator class, likewise
+ */
+struct emif_bw {
+	unsigned int			slot;
+	u32				cnt1;
+	u32				cnt2;
+	ktime_t				stamp;
+	unsigned long			total;
+	unsigned long			read;
+	unsigned long			write;
+	unsigned long			initiator[EMIF_MAX_INITIATORS];
+};
+
 /**
  * struct emif_data - Per device static data for driver's use
  * @duplicate:			Whether the DDR devices attached to this EMIF
@@ -52,6 +81,7 @@
  *				frequency in effect at the moment)
  * @plat_data:			Pointer to saved platform data.
  * @debugfs_root:		dentry to the root folder for EMIF in debugfs
+ * @bw:				Bandwidth monitoring state
  */
 struct emif_data {
 	u8				duplicate;
@@ -66,6 +96,7 @@ struct emif_data {
 	struct emif_regs		*curr_regs;
 	struct emif_platform_data	*plat_data;
 	struct dentry			*debugfs_root;
+	struct emif_bw			bw;
 };
 
 static struct emif_data *emif1;
@@ -74,6 +105,18 @@ static unsigned long	irq_state;
 static u32		t_ck; /* DDR clock period in ps */
 static LIST_HEAD(device_list);
 
+static DEFINE_SPINLOCK(emif_bw_lock);	/* protects the bw of all EMIFs */
+static DEFINE_MUTEX(emif_bw_mutex);	/* protects emif_bw_users */
+static unsigned int emif_bw_users;
+static bool emif_bw_debug_user;
+static void emif_bw_sample(struct work_struct *work);
+static u32 get_emif_bus_width(struct emif_data *emif);
+static DECLARE_DELAYED_WORK(emif_bw_work, emif_bw_sample);
+
+static unsigned int bw_sample_ms = 100;
+module_param(bw_sample_ms, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(bw_sample_ms, "Bandwidth sampling window (ms)");
+
 static void do_emif_regdump_show(struct seq_file *s, struct emif_data *emif,
 	struct emif_regs *regs)
 {
@@ -159,6 +202,259 @@ static const struct file_operations emif_mr4_fops = {
 	.release		= single_release,
 };
 
+/*
+ * Bandwidth monitoring
+ *
+ * Counter 1 always counts all the SDRAM accesses, which gives the total
+ * bandwidth in every window. Counter 2 is multiplexed over successive
+ * windows between reads, writes and the accesses of each initiator class,
+ * so those figures are refreshed less often. Bytes are estimated from the
+ * access counts assuming full BL8 bursts on the EMIF bus.
+ */
+static unsigned int emif_bw_num_slots(struct emif_data *emif)
+{
+	return 2 + emif->plat_data->num_initiators;
+}
+
+static const char *emif_bw_slot_name(struct emif_data *emif,
+				     unsigned int slot)
+{
+	if (slot == 0)
+		return "read";
+	if (slot == 1)
+		return "write";
+	return emif->plat_data->initiators[slot - 2].name;
+}
+
+static void emif_bw_program_cnt2(struct emif_data *emif, unsigned int slot)
+{
+	void __iomem *base = emif->base;
+	u32 cfg, sel;
+
+	cfg = readl(base + EMIF_PERFORMANCE_COUNTER_CONFIG);
+	cfg &= ~(CNTR2_MCONNID_EN_MASK | CNTR2_REGION_EN_MASK |
+		 CNTR2_CFG_MASK);
+	sel = readl(base + EMIF_PERFORMANCE_COUNTER_MASTER_REGION_SELECT);
+	sel &= ~MCONNID2_MASK;
+
+	if (slot == 0) {
+		cfg |= EMIF_PERF_CNT_READS << CNTR2_CFG_SHIFT;
+	} else if (slot == 1) {
+		cfg |= EMIF_PERF_CNT_WRITES << CNTR2_CFG_SHIFT;
+	} else {
+		cfg |= EMIF_PERF_CNT_ACCESSES << CNTR2_CFG_SHIFT;
+		cfg |= CNTR2_MCONNID_EN_MASK;
+		sel |= emif->plat_data->initiators[slot - 2].conn_id <<
+			MCONNID2_SHIFT;
+	}
+
+	writel(sel, base + EMIF_PERFORMANCE_COUNTER_MASTER_REGION_SELECT);
+	writel(cfg, base + EMIF_PERFORMANCE_COUNTER_CONFIG);
+
+	emif->bw.slot = slot;
+	emif->bw.cnt2 = readl(base + EMIF_PERFORMANCE_COUNTER_2);
+}
+
+static void emif_bw_start(struct emif_data *emif)
+{
+	void __iomem *base = emif->base;
+	u32 cfg;
+
+	cfg = readl(base + EMIF_PERFORMANCE_COUNTER_CONFIG);
+	cfg &= ~(CNTR1_MCONNID_EN_MASK | CNTR1_REGION_EN_MASK |
+		 CNTR1_CFG_MASK);
+	cfg |= EMIF_PERF_CNT_ACCESSES << CNTR1_CFG_SHIFT;
+	writel(cfg, base + EMIF_PERFORMANCE_COUNTER_CONFIG);
+
+	spin_lock_irq(&emif_bw_lock);
+	memset(&emif->bw, 0, sizeof(emif->bw));
+	emif_bw_program_cnt2(emif, 0);
+	emif->bw.cnt1 = readl(base + EMIF_PERFORMANCE_COUNTER_1);
+	emif->bw.stamp = ktime_get();
+	spin_unlock_irq(&emif_bw_lock);
+}
+
+static unsigned long emif_bw_rate(struct emif_data *emif, u32 count, s64 us)
+{
+	u64 bytes = (u64)count * 8 * (get_emif_bus_width(emif) / 8);
+
+	bytes *= USEC_PER_SEC;
+	do_div(bytes, us);
+
+	return bytes;
+}
+
+static void emif_bw_update(struct emif_data *emif)
+{
+	struct emif_bw *bw = &emif->bw;
+	void __iomem *base = emif->base;
+	unsigned long rate;
+	ktime_t now;
+	u32 c1, c2;
+	s64 us;
+
+	spin_lock_irq(&emif_bw_lock);
+
+	now = ktime_get();
+	c1 = readl(base + EMIF_PERFORMANCE_COUNTER_1);
+	c2 = readl(base + EMIF_PERFORMANCE_COUNTER_2);
+	us = ktime_us_delta(now, bw->stamp);
+
+	if (us > 0) {
+		bw->total = emif_bw_rate(emif, c1 - bw->cnt1, us);
+		rate = emif_bw_rate(emif, c2 - bw->cnt2, us);
+		if (bw->slot == 0)
+			bw->read = rate;
+		else if (bw->slot == 1)
+			bw->write = rate;
+		else
+			bw->initiator[bw->slot - 2] = rate;
+
+		trace_emif_bandwidth(emif->dev, bw->total,
+				     emif_bw_slot_name(emif, bw->slot), rate);
+	}
+
+	emif_bw_program_cnt2(emif, (bw->slot + 1) % emif_bw_num_slots(emif));
+	bw->cnt1 = c1;
+	bw->stamp = now;
+
+	spin_unlock_irq(&emif_bw_lock);
+}
+
+static void emif_bw_sample(struct work_struct *work)
+{
+	struct emif_data *emif;
+
+	list_for_each_entry(emif, &device_list, node)
+		emif_bw_update(emif);
+
+	schedule_delayed_work(&emif_bw_work,
+			      msecs_to_jiffies(max(bw_sample_ms, 1u)));
+}
+
+/**
+ * emif_bw_monitor_get() - Start measuring the DDR bandwidth
+ *
+ * Monitoring runs for as long as it has users. Returns 0, or -ENODEV when
+ * no EMIF has been probed.
+ */
+int emif_bw_monitor_get(void)
+{
+	struct emif_data *emif;
+	int ret = 0;
+
+	mutex_lock(&emif_bw_mutex);
+	if (list_empty(&device_list)) {
+		ret = -ENODEV;
+	} else if (!emif_bw_users++) {
+		list_for_each_entry(emif, &device_list, node)
+			emif_bw_start(emif);
+		schedule_delayed_work(&emif_bw_work,
+				      msecs_to_jiffies(max(bw_sample_ms, 1u)));
+	}
+	mutex_unlock(&emif_bw_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(emif_bw_monitor_get);
+
+/**
+ * emif_bw_monitor_put() - Drop a user of the bandwidth monitoring
+ */
+void emif_bw_monitor_put(void)
+{
+	mutex_lock(&emif_bw_mutex);
+	if (!WARN_ON(!emif_bw_users) && !--emif_bw_users)
+		cancel_delayed_work_sync(&emif_bw_work);
+	mutex_unlock(&emif_bw_mutex);
+}
+EXPORT_SYMBOL_GPL(emif_bw_monitor_put);
+
+/**
+ * emif_get_bandwidth() - DDR bandwidth of the last sampling window
+ *
+ * Returns the sum over all EMIFs, in bytes/s, or 0 when monitoring is not
+ * running.
+ */
+unsigned long emif_get_bandwidth(void)
+{
+	struct emif_data *emif;
+	unsigned long total = 0;
+
+	spin_lock_irq(&emif_bw_lock);
+	list_for_each_entry(emif, &device_list, node)
+		total += emif->bw.total;
+	spin_unlock_irq(&emif_bw_lock);
+
+	return total;
+}
+EXPORT_SYMBOL_GPL(emif_get_bandwidth);
+
+static int emif_bw_show(struct seq_file *s, void *unused)
+{
+	struct emif_data *emif = s->private;
+	struct emif_bw bw;
+	unsigned int i;
+
+	spin_lock_irq(&emif_bw_lock);
+	bw = emif->bw;
+	spin_unlock_irq(&emif_bw_lock);
+
+	if (!emif_bw_users) {
+		seq_printf(s, "monitoring stopped\n");
+		return 0;
+	}
+
+	seq_printf(s, "total\t: %lu KiB/s\n", bw.total >> 10);
+	seq_printf(s, "read\t: %lu KiB/s\n", bw.read >> 10);
+	seq_printf(s, "write\t: %lu KiB/s\n", bw.write >> 10);
+	for (i = 0; i < emif->plat_data->num_initiators; i++)
+		seq_printf(s, "%s\t: %lu KiB/s\n",
+			   emif->plat_data->initiators[i].name,
+			   bw.initiator[i] >> 10);
+
+	return 0;
+}
+
+static int emif_bw_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, emif_bw_show, inode->i_private);
+}
+
+static const struct file_operations emif_bw_fops = {
+	.open			= emif_bw_open,
+	.read			= seq_read,
+	.release		= single_release,
+};
+
+/* lets the bandwidth be watched from user space without another user */
+static int emif_bw_monitor_set(void *data, u64 val)
+{
+	int ret = 0;
+
+	if (!!val == emif_bw_debug_user)
+		return 0;
+
+	if (val)
+		ret = emif_bw_monitor_get();
+	else
+		emif_bw_monitor_put();
+
+	if (!ret)
+		emif_bw_debug_user = !!val;
+
+	return ret;
+}
+
+static int emif_bw_monitor_show(void *data, u64 *val)
+{
+	*val = emif_bw_debug_user;
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(emif_bw_monitor_fops, emif_bw_monitor_show,
+			emif_bw_monitor_set, "%llu\n");
+
 static int __init_or_module emif_debugfs_init(struct emif_data *emif)
 {
 	struct dentry	*dentry;
@@ -185,6 +481,20 @@ static int __init_or_module emif_debugfs_init(struct emif_data *emif)
 		goto err1;
 	}
 
+	dentry = debugfs_create_file("bandwidth", S_IRUGO,
+			emif->debugfs_root, emif, &emif_bw_fops);
+	if (IS_ERR(dentry)) {
+		ret = PTR_ERR(dentry);
+		goto err1;
+	}
+
+	dentry = debugfs_create_file("bw_monitor", S_IRUGO | S_IWUSR,
+			emif->debugfs_root, emif, &emif_bw_monitor_fops);
+	if (IS_ERR(dentry)) {
+		ret = PTR_ERR(dentry);
+		goto err1;
+	}
+
 	return 0;
 err1:
 	debugfs_remove_recursive(emif->debugfs_root);
@@ -1318,6 +1628,14 @@ static struct emif_data *__init_or_module get_device_details(
 		pd->min_tck = &lpddr2_jedec_min_tck;
 	}
 
+	if (!pd->initiators) {
+		pd->num_initiators = 0;
+	} else if (pd->num_initiators > EMIF_MAX_INITIATORS) {
+		dev_warn(dev, "%s: only %d initiator classes measured\n",
+			__func__, EMIF_MAX_INITIATORS);
+		pd->num_initiators = EMIF_MAX_INITIATORS;
+	}
+
 out:
 	return emif;
 
@@ -441,6 +441,12 @@
 #define CNTR1_CFG_SHIFT					0
 #define CNTR1_CFG_MASK					(0xf << 0)
 
+/* PERFORMANCE_COUNTER_CONFIG - CNTRx_CFG values */
+#define EMIF_PERF_CNT_ACCESSES				0x0
+#define EMIF_PERF_CNT_ACTIVATES				0x1
+#define EMIF_PERF_CNT_READS				0x2
+#define EMIF_PERF_CNT_WRITES				0x3
+
 /* PERFORMANCE_COUNTER_MASTER_REGION_SELECT */
 #define MCONNID2_SHIFT					24
 #define MCONNID2_MASK					(0xff << 24)
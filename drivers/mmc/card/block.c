@@ -107,7 +107,18 @@ struct mmc_blk_data {
 	unsigned int	part_curr;
 	struct device_attribute force_ro;
 	struct device_attribute power_ro_lock;
+	struct device_attribute cache_stats;
 	int	area_type;
+
+	/*
+	 * Writes issued since the last cache flush.  fsync storms send
+	 * flushes back to back; one with nothing written before it is
+	 * completed without going to the card.
+	 */
+	unsigned int	cache_dirty;
+	unsigned long	writes;
+	unsigned long	flushes;
+	unsigned long	flushes_coalesced;
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -259,6 +270,18 @@ out:
 	return ret;
 }
 
+static ssize_t cache_stats_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	ssize_t ret;
+
+	ret = snprintf(buf, PAGE_SIZE, "%lu %lu %lu\n", md->writes,
+		       md->flushes, md->flushes_coalesced);
+	mmc_blk_put(md);
+	return ret;
+}
+
 static int mmc_blk_open(struct block_device *bdev, fmode_t mode)
 {
 	struct mmc_blk_data *md = mmc_blk_get(bdev->bd_disk);
@@ -958,10 +981,19 @@ static int mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
 	struct mmc_card *card = md->queue.card;
 	int ret = 0;
 
+	if (!md->cache_dirty) {
+		md->flushes_coalesced++;
+		goto out;
+	}
+
 	ret = mmc_flush_cache(card);
 	if (ret)
 		ret = -EIO;
+	else
+		md->cache_dirty = 0;
+	md->flushes++;
 
+out:
 	spin_lock_irq(&md->lock);
 	__blk_end_request_all(req, ret);
 	spin_unlock_irq(&md->lock);
@@ -1289,6 +1321,11 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	if (!rqc && !mq->mqrq_prev->req)
 		return 0;
 
+	if (rqc && rq_data_dir(rqc) == WRITE) {
+		md->cache_dirty = 1;
+		md->writes++;
+	}
+
 	do {
 		if (rqc) {
 			mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
@@ -1667,6 +1704,8 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 		card = md->queue.card;
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
+			device_remove_file(disk_to_dev(md->disk),
+					   &md->cache_stats);
 			if ((md->area_type & MMC_BLK_DATA_AREA_BOOT) &&
 					card->ext_csd.boot_ro_lockable)
 				device_remove_file(disk_to_dev(md->disk),
@@ -1711,6 +1750,14 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	if (ret)
 		goto force_ro_fail;
 
+	md->cache_stats.show = cache_stats_show;
+	sysfs_attr_init(&md->cache_stats.attr);
+	md->cache_stats.attr.name = "cache_stats";
+	md->cache_stats.attr.mode = S_IRUGO;
+	ret = device_create_file(disk_to_dev(md->disk), &md->cache_stats);
+	if (ret)
+		goto cache_stats_fail;
+
 	if ((md->area_type & MMC_BLK_DATA_AREA_BOOT) &&
 	     card->ext_csd.boot_ro_lockable) {
 		umode_t mode;
@@ -1734,6 +1781,8 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	return ret;
 
 power_ro_lock_fail:
+	device_remove_file(disk_to_dev(md->disk), &md->cache_stats);
+cache_stats_fail:
 	device_remove_file(disk_to_dev(md->disk), &md->force_ro);
 force_ro_fail:
 	del_gendisk(md->disk);
@@ -138,6 +138,8 @@
 #define DMA_TABLE_NUM_ENTRIES	1024
 #define ADMA_TABLE_SZ \
 	(DMA_TABLE_NUM_ENTRIES * sizeof(struct adma_desc_table))
+/* one table for the request in flight, one built by pre_req for the next */
+#define ADMA_TABLES		2
 
 #define SDMA_XFER	1
 #define ADMA_XFER	2
@@ -184,8 +186,40 @@
 struct omap_hsmmc_next {
 	unsigned int	dma_len;
 	s32		cookie;
+	int		adma_slot;	/* table built for cookie, or -1 */
+	int		adma_blocks;
 };
 
+/* issue to completion latency, buckets are powers of two in us */
+#define OMAP_HSMMC_LAT_BUCKETS	16
+
+enum { OMAP_HSMMC_LAT_CMD, OMAP_HSMMC_LAT_READ, OMAP_HSMMC_LAT_WRITE,
+	OMAP_HSMMC_LAT_TYPES };
+
+struct omap_hsmmc_lat {
+	unsigned long	count;
+	u64		total_us;
+	u32		max_us;
+	unsigned long	hist[OMAP_HSMMC_LAT_BUCKETS];
+};
+
+/*
+ * Hybrid completion: small transfers at high bus clock finish within tens
+ * of microseconds, less than an interrupt round trip costs.  request()
+ * then keeps the interrupt line masked and polls STAT for a little longer
+ * than such requests took so far, and only arms the interrupt if the
+ * request is not done by then.
+ */
+enum { OMAP_HSMMC_COMPLETE_IRQ, OMAP_HSMMC_COMPLETE_HYBRID };
+
+#define OMAP_HSMMC_POLL_MAX_BYTES	4096
+#define OMAP_HSMMC_POLL_MIN_CLOCK	48000000
+#define OMAP_HSMMC_POLL_MAX_US		100	/* default poll_max_us */
+#define OMAP_HSMMC_POLL_SLACK_US	10
+
+/* CRC errors after which the next set_ios reprograms an unchanged clock */
+#define OMAP_HSMMC_CRC_RESETUP		3
+
 struct adma_desc_table {
 	u16 attr;
 	u16 length;
@@ -223,6 +257,7 @@ struct omap_hsmmc_host {
 	int			dma_type, dma_ch;
 	struct adma_desc_table	*adma_table;
 	dma_addr_t		phy_adma_table;
+	int			adma_cur;	/* table of the request in flight */
 	int			dma_line_tx, dma_line_rx;
 	int			slot_id;
 	int			got_dbclk;
@@ -238,6 +273,28 @@ struct omap_hsmmc_host {
 	int			regulator_enabled;
 	struct omap_hsmmc_next	next_data;
 
+	ktime_t			req_start;
+	struct omap_hsmmc_lat	lat[OMAP_HSMMC_LAT_TYPES];
+	unsigned long		adma_prepared;	/* table built in pre_req */
+	unsigned long		adma_unprepared;
+
+	int			completion;	/* OMAP_HSMMC_COMPLETE_* */
+	bool			polling;	/* ISE left masked for request() */
+	bool			poll_measure;	/* request counts for poll_avg8 */
+	unsigned int		poll_max_us;
+	unsigned int		poll_avg8[2];	/* 8 x avg us of reads, writes */
+	unsigned long		poll_hits;
+	unsigned long		poll_misses;
+
+	bool			clk_force;	/* reprogram even if unchanged */
+	unsigned int		crc_errors;	/* since the last clock setup */
+	unsigned long		crc_total;
+	unsigned long		clk_setups;
+	unsigned long		clk_skips;
+	ktime_t			resume_start;	/* zero once I/O was seen */
+	u32			resume_io_us;
+	u32			resume_io_max_us;
+
 	struct	omap_mmc_platform_data	*pdata;
 };
 
@@ -543,7 +600,7 @@ static void omap_hsmmc_enable_irq(struct omap_hsmmc_host *host,
 		irq_mask &= ~DTO_ENABLE;
 
 	OMAP_HSMMC_WRITE(host->base, STAT, STAT_CLEAR);
-	OMAP_HSMMC_WRITE(host->base, ISE, irq_mask);
+	OMAP_HSMMC_WRITE(host->base, ISE, host->polling ? 0 : irq_mask);
 	OMAP_HSMMC_WRITE(host->base, IE, irq_mask);
 }
 
@@ -573,6 +630,22 @@ static void omap_hsmmc_set_clock(struct omap_hsmmc_host *host)
 	struct mmc_ios *ios = &host->mmc->ios;
 	unsigned long regval;
 	unsigned long timeout;
+	u16 dsor = calc_divisor(host, ios);
+
+	/*
+	 * The core sends unchanged ios over and over, on resume in
+	 * particular, and stopping the clock and waiting for it to settle
+	 * again each time adds up.  Lost context shows in the register.
+	 */
+	regval = OMAP_HSMMC_READ(host->base, SYSCTL);
+	if (dsor && !host->clk_force && (regval & (ICS | CEN)) == (ICS | CEN) &&
+	    ((regval & CLKD_MASK) >> CLKD_SHIFT) == dsor) {
+		host->clk_skips++;
+		return;
+	}
+	host->clk_force = false;
+	host->crc_errors = 0;
+	host->clk_setups++;
 
 	dev_dbg(mmc_dev(host->mmc), "Set clock to %uHz\n", ios->clock);
 
@@ -580,7 +653,7 @@ static void omap_hsmmc_set_clock(struct omap_hsmmc_host *host)
 
 	regval = OMAP_HSMMC_READ(host->base, SYSCTL);
 	regval = regval & ~(CLKD_MASK | DTO_MASK);
-	regval = regval | (calc_divisor(host, ios) << 6) | (DTO << 16);
+	regval = regval | (dsor << 6) | (DTO << 16);
 	OMAP_HSMMC_WRITE(host->base, SYSCTL, regval);
 	OMAP_HSMMC_WRITE(host->base, SYSCTL,
 		OMAP_HSMMC_READ(host->base, SYSCTL) | ICE);
@@ -818,6 +891,69 @@ omap_hsmmc_show_slot_name(struct device *dev, struct device_attribute *attr,
 
 static DEVICE_ATTR(slot_name, S_IRUGO, omap_hsmmc_show_slot_name, NULL);
 
+static const char * const omap_hsmmc_completion_names[] = {
+	[OMAP_HSMMC_COMPLETE_IRQ]	= "irq",
+	[OMAP_HSMMC_COMPLETE_HYBRID]	= "hybrid",
+};
+
+static ssize_t
+omap_hsmmc_show_completion(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+	struct mmc_host *mmc = container_of(dev, struct mmc_host, class_dev);
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+
+	return sprintf(buf, "%s\n",
+			omap_hsmmc_completion_names[host->completion]);
+}
+
+static ssize_t
+omap_hsmmc_store_completion(struct device *dev, struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	struct mmc_host *mmc = container_of(dev, struct mmc_host, class_dev);
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(omap_hsmmc_completion_names); i++) {
+		if (sysfs_streq(buf, omap_hsmmc_completion_names[i])) {
+			host->completion = i;
+			return count;
+		}
+	}
+	return -EINVAL;
+}
+
+static DEVICE_ATTR(completion, S_IRUGO | S_IWUSR, omap_hsmmc_show_completion,
+		   omap_hsmmc_store_completion);
+
+static ssize_t
+omap_hsmmc_show_poll_max_us(struct device *dev, struct device_attribute *attr,
+			char *buf)
+{
+	struct mmc_host *mmc = container_of(dev, struct mmc_host, class_dev);
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+
+	return sprintf(buf, "%u\n", host->poll_max_us);
+}
+
+static ssize_t
+omap_hsmmc_store_poll_max_us(struct device *dev, struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	struct mmc_host *mmc = container_of(dev, struct mmc_host, class_dev);
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	unsigned int val;
+
+	if (kstrtouint(buf, 10, &val) || val > 1000)
+		return -EINVAL;
+	host->poll_max_us = val;
+	return count;
+}
+
+static DEVICE_ATTR(poll_max_us, S_IRUGO | S_IWUSR, omap_hsmmc_show_poll_max_us,
+		   omap_hsmmc_store_poll_max_us);
+
 /*
  * Configure the response type and send the cmd.
  */
@@ -882,6 +1018,45 @@ omap_hsmmc_get_dma_dir(struct omap_hsmmc_host *host, struct mmc_data *data)
 		return DMA_FROM_DEVICE;
 }
 
+/*
+ * Hand a finished request back to the core.  ADMA requests that were not
+ * prepared by pre_req were mapped at issue time, and no post_req will
+ * come for them.
+ */
+static void omap_hsmmc_complete(struct omap_hsmmc_host *host,
+				struct mmc_request *mrq)
+{
+	struct mmc_data *data = mrq->data;
+	struct omap_hsmmc_lat *lat;
+	u32 us;
+
+	if (data && host->dma_type == ADMA_XFER && !data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     omap_hsmmc_get_dma_dir(host, data));
+
+	us = ktime_to_us(ktime_sub(ktime_get(), host->req_start));
+	if (!data)
+		lat = &host->lat[OMAP_HSMMC_LAT_CMD];
+	else if (data->flags & MMC_DATA_READ)
+		lat = &host->lat[OMAP_HSMMC_LAT_READ];
+	else
+		lat = &host->lat[OMAP_HSMMC_LAT_WRITE];
+	lat->count++;
+	lat->total_us += us;
+	lat->max_us = max(lat->max_us, us);
+	lat->hist[min(fls(us), OMAP_HSMMC_LAT_BUCKETS - 1)]++;
+
+	if (host->poll_measure) {
+		unsigned int *avg8 =
+			&host->poll_avg8[!!(data->flags & MMC_DATA_WRITE)];
+
+		*avg8 = *avg8 - *avg8 / 8 + us;
+	}
+
+	host->mrq = NULL;
+	mmc_request_done(host->mmc, mrq);
+}
+
 static void omap_hsmmc_request_done(struct omap_hsmmc_host *host, struct mmc_request *mrq)
 {
 	int dma_ch;
@@ -895,8 +1070,7 @@ static void omap_hsmmc_request_done(struct omap_hsmmc_host *host, struct mmc_req
 	/* Do not complete the request if DMA is still in progress */
 	if (mrq->data && host->dma_type && dma_ch != -1)
 		return;
-	host->mrq = NULL;
-	mmc_request_done(host->mmc, mrq);
+	omap_hsmmc_complete(host, mrq);
 }
 
 /*
@@ -1100,6 +1274,11 @@ static void omap_hsmmc_do_irq(struct omap_hsmmc_host *host, int status)
 
 	if (status & ERR) {
 		omap_hsmmc_dbg_report_irq(host, status);
+		if (status & (CMD_CRC | DATA_CRC)) {
+			host->crc_total++;
+			if (++host->crc_errors >= OMAP_HSMMC_CRC_RESETUP)
+				host->clk_force = true;
+		}
 		if ((status & CMD_TIMEOUT) ||
 			(status & CMD_CRC)) {
 			if (host->cmd) {
@@ -1428,12 +1607,8 @@ static void omap_hsmmc_dma_cb(int lch, u16 ch_status, void *cb_data)
 	omap_free_dma(dma_ch);
 
 	/* If DMA has finished after TC, complete the request */
-	if (!req_in_progress) {
-		struct mmc_request *mrq = host->mrq;
-
-		host->mrq = NULL;
-		mmc_request_done(host->mmc, mrq);
-	}
+	if (!req_in_progress)
+		omap_hsmmc_complete(host, host->mrq);
 }
 
 static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
@@ -1520,20 +1695,23 @@ static int omap_hsmmc_start_sdma_transfer(struct omap_hsmmc_host *host,
 	return 0;
 }
 
-static int mmc_populate_adma_desc_table(struct omap_hsmmc_host *host,
-		struct mmc_request *req, struct adma_desc_table *pdesc)
+static inline struct adma_desc_table *
+omap_hsmmc_adma_table(struct omap_hsmmc_host *host, int slot)
+{
+	return host->adma_table + slot * DMA_TABLE_NUM_ENTRIES;
+}
+
+/* Fill ADMA table @slot from the @dma_len mapped entries of data->sg */
+static int omap_hsmmc_build_adma_table(struct omap_hsmmc_host *host,
+		struct mmc_data *data, unsigned int dma_len, int slot)
 {
+	struct adma_desc_table *pdesc = omap_hsmmc_adma_table(host, slot);
 	int i, j, dmalen;
 	int splitseg, xferaddr;
 	int numblocks = 0;
 	dma_addr_t dmaaddr;
-	struct mmc_data *data = req->data;
-	int ret = 0;
 
-	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL);
-	if (ret)
-		return ret;
-	for (i = 0, j = 0; i < host->dma_len; i++) {
+	for (i = 0, j = 0; i < dma_len; i++) {
 		dmaaddr = sg_dma_address(data->sg + i);
 		dmalen = sg_dma_len(data->sg + i);
 		numblocks += dmalen / data->blksz;
@@ -1569,14 +1747,47 @@ static int mmc_populate_adma_desc_table(struct omap_hsmmc_host *host,
 	WARN_ON((i + j - 1) > DMA_TABLE_NUM_ENTRIES);
 	dev_dbg(mmc_dev(host->mmc),
 		"ADMA table has %d entries from %d sglist\n",
-		i + j, host->dma_len);
+		i + j, dma_len);
 	return numblocks;
 }
 
+/*
+ * Find or build the ADMA table of @req.  A request that went through
+ * pre_req has it ready, others are mapped and built now, in the table the
+ * prepared one (if any) does not use.
+ */
+static int mmc_populate_adma_desc_table(struct omap_hsmmc_host *host,
+		struct mmc_request *req)
+{
+	struct mmc_data *data = req->data;
+	struct omap_hsmmc_next *next = &host->next_data;
+	int slot, ret;
+
+	if (data->host_cookie && data->host_cookie == next->cookie &&
+	    next->adma_slot >= 0) {
+		host->adma_cur = next->adma_slot;
+		host->dma_len = next->dma_len;
+		next->dma_len = 0;
+		next->adma_slot = -1;
+		host->adma_prepared++;
+		return next->adma_blocks;
+	}
+
+	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL);
+	if (ret)
+		return ret;
+
+	slot = next->adma_slot >= 0 ? !next->adma_slot : host->adma_cur;
+	host->adma_cur = slot;
+	host->adma_unprepared++;
+	return omap_hsmmc_build_adma_table(host, data, host->dma_len, slot);
+}
+
 static void omap_hsmmc_start_adma_transfer(struct omap_hsmmc_host *host)
 {
 	wmb();
-	OMAP_HSMMC_WRITE(host->base, ADMA_SAL, host->phy_adma_table);
+	OMAP_HSMMC_WRITE(host->base, ADMA_SAL,
+			 host->phy_adma_table + host->adma_cur * ADMA_TABLE_SZ);
 }
 
 static void set_data_timeout(struct omap_hsmmc_host *host,
@@ -1649,8 +1860,9 @@ omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 			return ret;
 		}
 	} else if (host->dma_type == ADMA_XFER) {
-		numblks = mmc_populate_adma_desc_table(host,
-				req, host->adma_table);
+		numblks = mmc_populate_adma_desc_table(host, req);
+		if (numblks < 0)
+			return numblks;
 		WARN_ON(numblks != req->data->blocks);
 		omap_hsmmc_start_adma_transfer(host);
 	}
@@ -1668,6 +1880,9 @@ static void omap_hsmmc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
 			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
 				     data->sg_len,
 				     omap_hsmmc_get_dma_dir(host, data));
+		/* prepared but never issued, its table is free again */
+		if (data->host_cookie == host->next_data.cookie)
+			host->next_data.adma_slot = -1;
 		data->host_cookie = 0;
 	}
 }
@@ -1682,10 +1897,70 @@ static void omap_hsmmc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
 		return ;
 	}
 
-	if (host->dma_type)
-		if (omap_hsmmc_pre_dma_transfer(host, mrq->data,
-						&host->next_data))
-			mrq->data->host_cookie = 0;
+	if (!host->dma_type)
+		return;
+
+	if (omap_hsmmc_pre_dma_transfer(host, mrq->data, &host->next_data)) {
+		mrq->data->host_cookie = 0;
+		return;
+	}
+
+	/* the request in flight, if any, uses adma_cur */
+	if (host->dma_type == ADMA_XFER) {
+		int slot = !host->adma_cur;
+
+		host->next_data.adma_blocks = omap_hsmmc_build_adma_table(host,
+				mrq->data, host->next_data.dma_len, slot);
+		host->next_data.adma_slot = slot;
+	}
+}
+
+static bool omap_hsmmc_want_poll(struct omap_hsmmc_host *host,
+				 struct mmc_request *req)
+{
+	struct mmc_data *data = req->data;
+
+	host->poll_measure = host->completion == OMAP_HSMMC_COMPLETE_HYBRID &&
+		data && data->blocks * data->blksz <= OMAP_HSMMC_POLL_MAX_BYTES &&
+		host->mmc->ios.clock >= OMAP_HSMMC_POLL_MIN_CLOCK;
+	if (!host->poll_measure)
+		return false;
+
+	/* when they take longer, sleeping until the irq is cheaper */
+	return host->poll_avg8[!!(data->flags & MMC_DATA_WRITE)] / 8 <=
+		host->poll_max_us;
+}
+
+static void omap_hsmmc_poll(struct omap_hsmmc_host *host,
+			    struct mmc_request *mrq)
+{
+	unsigned int avg = host->poll_avg8[!!(mrq->data->flags &
+					      MMC_DATA_WRITE)] / 8;
+	s64 budget = avg + avg / 4 + OMAP_HSMMC_POLL_SLACK_US;
+	unsigned long flags;
+
+	while (host->mrq == mrq) {
+		if (OMAP_HSMMC_READ(host->base, STAT) & INT_EN_MASK) {
+			/* the handlers expect to run with interrupts off */
+			local_irq_save(flags);
+			omap_hsmmc_irq(host->irq, host);
+			local_irq_restore(flags);
+			continue;
+		}
+		if (ktime_us_delta(ktime_get(), host->req_start) >= budget)
+			break;
+		cpu_relax();
+	}
+
+	host->polling = false;
+	if (host->mrq != mrq) {
+		host->poll_hits++;
+		return;
+	}
+
+	host->poll_misses++;
+	wmb();
+	OMAP_HSMMC_WRITE(host->base, ISE, OMAP_HSMMC_READ(host->base, IE));
 }
 
 /*
@@ -1739,6 +2014,16 @@ static void omap_hsmmc_request(struct mmc_host *mmc, struct mmc_request *req)
 	}
 
 	host->mrq = req;
+	host->req_start = ktime_get();
+	if (req->data && ktime_to_ns(host->resume_start)) {
+		host->resume_io_us = ktime_us_delta(host->req_start,
+						    host->resume_start);
+		host->resume_io_max_us = max(host->resume_io_max_us,
+					     host->resume_io_us);
+		host->resume_start = ktime_set(0, 0);
+		dev_dbg(mmc_dev(mmc), "first I/O %u us after resume\n",
+			host->resume_io_us);
+	}
 	err = omap_hsmmc_prepare_data(host, req);
 	if (err) {
 		req->cmd->error = err;
@@ -1749,7 +2034,10 @@ static void omap_hsmmc_request(struct mmc_host *mmc, struct mmc_request *req)
 		return;
 	}
 
+	host->polling = omap_hsmmc_want_poll(host, req);
 	omap_hsmmc_start_command(host, req->cmd, req->data);
+	if (host->polling)
+		omap_hsmmc_poll(host, req);
 }
 
 /* Routine to configure clock values. Exposed API to core */
@@ -2080,11 +2368,71 @@ static const struct file_operations mmc_regs_fops = {
 	.release        = single_release,
 };
 
+static int omap_hsmmc_req_stats_show(struct seq_file *s, void *data)
+{
+	static const char * const names[OMAP_HSMMC_LAT_TYPES] = {
+		"cmd", "read", "write" };
+	struct mmc_host *mmc = s->private;
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	int i, b;
+
+	seq_printf(s, "adma tables: %lu prepared, %lu built at issue\n",
+		   host->adma_prepared, host->adma_unprepared);
+	seq_printf(s, "completion: %s, %lu polled, %lu fell back to irq, "
+		   "small read %u us, small write %u us\n",
+		   omap_hsmmc_completion_names[host->completion],
+		   host->poll_hits, host->poll_misses,
+		   host->poll_avg8[0] / 8, host->poll_avg8[1] / 8);
+	seq_printf(s, "clock: %lu setups, %lu unchanged skipped, "
+		   "%lu crc errors\n", host->clk_setups, host->clk_skips,
+		   host->crc_total);
+	seq_printf(s, "resume to first I/O: last %u us, max %u us\n\n",
+		   host->resume_io_us, host->resume_io_max_us);
+	seq_printf(s, "%-6s %10s %10s %10s\n", "", "count", "avg us",
+		   "max us");
+	for (i = 0; i < OMAP_HSMMC_LAT_TYPES; i++) {
+		struct omap_hsmmc_lat *lat = &host->lat[i];
+
+		seq_printf(s, "%-6s %10lu %10llu %10u\n", names[i], lat->count,
+			   lat->count ? div_u64(lat->total_us, lat->count) : 0,
+			   lat->max_us);
+	}
+
+	seq_printf(s, "\n%-10s %10s %10s %10s\n", "< us", names[0],
+		   names[1], names[2]);
+	for (b = 0; b < OMAP_HSMMC_LAT_BUCKETS; b++) {
+		if (b < OMAP_HSMMC_LAT_BUCKETS - 1)
+			seq_printf(s, "%-10u", 1U << b);
+		else
+			seq_printf(s, "%-10s", "more");
+		for (i = 0; i < OMAP_HSMMC_LAT_TYPES; i++)
+			seq_printf(s, " %10lu", host->lat[i].hist[b]);
+		seq_putc(s, '\n');
+	}
+
+	return 0;
+}
+
+static int omap_hsmmc_req_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap_hsmmc_req_stats_show, inode->i_private);
+}
+
+static const struct file_operations mmc_req_stats_fops = {
+	.open           = omap_hsmmc_req_stats_open,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static void omap_hsmmc_debugfs(struct mmc_host *mmc)
 {
-	if (mmc->debugfs_root)
+	if (mmc->debugfs_root) {
 		debugfs_create_file("regs", S_IRUSR, mmc->debugfs_root,
 			mmc, &mmc_regs_fops);
+		debugfs_create_file("req_stats", S_IRUSR, mmc->debugfs_root,
+			mmc, &mmc_req_stats_fops);
+	}
 }
 
 #else
@@ -2225,6 +2573,11 @@ static int __devinit omap_hsmmc_probe(struct platform_device *pdev)
 		host->errata |= OMAP_HSMMC_ERRATA_I761;
 
 	host->next_data.cookie = 1;
+	host->next_data.adma_slot = -1;
+	/* eMMC is where small random reads come from */
+	host->completion = mmc_slot(host).nonremovable ?
+		OMAP_HSMMC_COMPLETE_HYBRID : OMAP_HSMMC_COMPLETE_IRQ;
+	host->poll_max_us = OMAP_HSMMC_POLL_MAX_US;
 	host->regulator_enabled = 0;
 
 	platform_set_drvdata(pdev, host);
@@ -2267,10 +2620,16 @@ static int __devinit omap_hsmmc_probe(struct platform_device *pdev)
 		mmc->caps2 |= MMC_CAP2_NO_MULTI_READ;
 	}
 
+	/* let the core turn on the eMMC 4.5 write cache, block.c flushes it */
+	if (mmc_slot(host).nonremovable)
+		mmc->caps2 |= MMC_CAP2_CACHE_CTRL;
+
 	pm_runtime_enable(host->dev);
 	pm_runtime_get_sync(host->dev);
 	pm_runtime_set_autosuspend_delay(host->dev, MMC_AUTOSUSPEND_DELAY);
 	pm_runtime_use_autosuspend(host->dev);
+	/* Card re-init on resume only needs the regulators, i2c is noirq */
+	device_enable_async_suspend(host->dev);
 
 	omap_hsmmc_context_save(host);
 
@@ -2297,7 +2656,7 @@ static int __devinit omap_hsmmc_probe(struct platform_device *pdev)
 		 * due to unset conherency mask
 		 */
 		host->adma_table = dma_alloc_coherent(NULL,
-			ADMA_TABLE_SZ, &host->phy_adma_table, 0);
+			ADMA_TABLES * ADMA_TABLE_SZ, &host->phy_adma_table, 0);
 		if (host->adma_table != NULL)
 			host->dma_type = ADMA_XFER;
 	}
@@ -2413,6 +2772,12 @@ static int __devinit omap_hsmmc_probe(struct platform_device *pdev)
 		if (ret < 0)
 			goto err_slot_name;
 	}
+	ret = device_create_file(&mmc->class_dev, &dev_attr_completion);
+	if (ret < 0)
+		goto err_slot_name;
+	ret = device_create_file(&mmc->class_dev, &dev_attr_poll_max_us);
+	if (ret < 0)
+		goto err_slot_name;
 
 	omap_hsmmc_debugfs(mmc);
 	pm_runtime_mark_last_busy(host->dev);
@@ -2443,7 +2808,7 @@ err_fclk:
 	host->fclk = NULL;
 err1:
 	if (host->adma_table != NULL)
-		dma_free_coherent(NULL, ADMA_TABLE_SZ,
+		dma_free_coherent(NULL, ADMA_TABLES * ADMA_TABLE_SZ,
 			host->adma_table, host->phy_adma_table);
 	iounmap(host->base);
 err_ioremap:
@@ -2471,7 +2836,7 @@ static int __devexit omap_hsmmc_remove(struct platform_device *pdev)
 	if (mmc_slot(host).card_detect_irq)
 		free_irq(mmc_slot(host).card_detect_irq, host);
 	if (host->adma_table != NULL)
-		dma_free_coherent(NULL, ADMA_TABLE_SZ,
+		dma_free_coherent(NULL, ADMA_TABLES * ADMA_TABLE_SZ,
 			host->adma_table, host->phy_adma_table);
 	pm_runtime_put_sync(host->dev);
 	pm_runtime_disable(host->dev);
@@ -2555,6 +2920,7 @@ static int omap_hsmmc_resume(struct device *dev)
 	if (host && !host->suspended)
 		return 0;
 
+	host->resume_start = ktime_get();
 	pm_runtime_get_sync(host->dev);
 
 	if (host->got_dbclk)
@@ -146,6 +146,9 @@ void dhd_os_prefree(void *osh, void *addr, uint size);
 #define DHD_SDALIGN	32
 #endif
 
+/* Size of the preallocated rx skbs, fits a full-size data frame */
+#define DHD_RXPOOL_BUFSZ	(2048 + DHD_SDALIGN)
+
 /* host reordering packts logic */
 /* followed the structure to hold the reorder buffers (void **p) */
 typedef struct reorder_info {
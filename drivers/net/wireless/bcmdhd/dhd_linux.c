@@ -254,6 +254,10 @@ typedef struct dhd_info {
 
 	tsk_ctl_t	thr_dpc_ctl;
 	tsk_ctl_t	thr_wdt_ctl;
+
+	/* Rx frames handed from the DPC thread to the delivery thread */
+	tsk_ctl_t	thr_rxf_ctl;
+	struct sk_buff_head rxf_queue;
 #endif /* DHDTHREAD */
 	bool dhd_tasklet_create;
 	tsk_ctl_t	thr_sysioc_ctl;
@@ -347,6 +351,12 @@ module_param(dhd_arp_mode, uint, 0);
 uint dhd_arp_enable = TRUE;
 module_param(dhd_arp_enable, uint, 0);
 
+#ifdef TOE
+/* Ask the dongle to verify rx checksums so the host skips csum_partial() */
+uint dhd_rx_csum_ol = TRUE;
+module_param(dhd_rx_csum_ol, uint, 0644);
+#endif /* TOE */
+
 #ifdef PKT_FILTER_SUPPORT
 /* Global Pkt filter enable control */
 uint dhd_pkt_filter_enable = TRUE;
@@ -370,6 +380,14 @@ module_param(dhd_watchdog_prio, int, 0);
 int dhd_dpc_prio = 98;
 module_param(dhd_dpc_prio, int, 0);
 
+/* Deliver rx frames from their own thread so the DPC keeps the bus busy */
+uint dhd_rxf_enable = TRUE;
+module_param(dhd_rxf_enable, uint, 0);
+
+/* CPU the rx delivery thread is bound to, -1 to let it float */
+int dhd_rxf_cpu = 1;
+module_param(dhd_rxf_cpu, int, 0);
+
 /* DPC thread priority, -1 to use tasklet */
 extern int dhd_dongle_memsize;
 module_param(dhd_dongle_memsize, int, 0);
@@ -416,6 +434,12 @@ extern uint dhd_txbound;
 extern uint dhd_rxbound;
 module_param(dhd_txbound, uint, 0);
 module_param(dhd_rxbound, uint, 0);
+extern uint dhd_txqdiv;
+module_param(dhd_txqdiv, uint, 0644);
+
+/* Number of preallocated rx skbs, 0 disables the pool */
+uint dhd_rxpool_size = 64;
+module_param(dhd_rxpool_size, uint, 0);
 
 /* Deferred transmits */
 extern uint dhd_deferred_tx;
@@ -1442,7 +1466,12 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 	dhd_if_t *ifp;
 	wl_event_msg_t event;
 	int tout = DHD_PACKET_TIMEOUT_MS;
+#ifdef DHDTHREAD
+	struct sk_buff_head rxq;
+	bool rxf = dhd->thr_rxf_ctl.thr_pid >= 0 && !in_interrupt();
 
+	__skb_queue_head_init(&rxq);
+#endif /* DHDTHREAD */
 
 	BCM_REFERENCE(tout);
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
@@ -1565,6 +1594,13 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 		dhdp->dstats.rx_bytes += skb->len;
 		dhdp->rx_packets++; /* Local count */
 
+#ifdef DHDTHREAD
+		if (rxf) {
+			__skb_queue_tail(&rxq, skb);
+			continue;
+		}
+#endif /* DHDTHREAD */
+
 		if (in_interrupt()) {
 			netif_rx(skb);
 		} else {
@@ -1585,6 +1621,18 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 0) */
 		}
 	}
+
+#ifdef DHDTHREAD
+	/* hand the whole chain over with a single wakeup */
+	if (!skb_queue_empty(&rxq)) {
+		ulong flags;
+
+		spin_lock_irqsave(&dhd->rxf_queue.lock, flags);
+		skb_queue_splice_tail(&rxq, &dhd->rxf_queue);
+		spin_unlock_irqrestore(&dhd->rxf_queue.lock, flags);
+		up(&dhd->thr_rxf_ctl.sema);
+	}
+#endif /* DHDTHREAD */
 	DHD_OS_WAKE_LOCK_TIMEOUT_ENABLE(dhdp, tout);
 }
 
@@ -1812,6 +1860,57 @@ dhd_dpc_thread(void *data)
 
 	complete_and_exit(&tsk->completed, 0);
 }
+
+static int
+dhd_rxf_thread(void *data)
+{
+	tsk_ctl_t *tsk = (tsk_ctl_t *)data;
+	dhd_info_t *dhd = (dhd_info_t *)tsk->parent;
+	struct sk_buff_head rxq;
+	struct sk_buff *skb;
+
+	/* one step below the DPC so frame pulls preempt delivery */
+	if (dhd_dpc_prio > 1)
+	{
+		struct sched_param param;
+		param.sched_priority = (dhd_dpc_prio < MAX_RT_PRIO)?dhd_dpc_prio-1:(MAX_RT_PRIO-2);
+		setScheduler(current, SCHED_FIFO, &param);
+	}
+
+	DAEMONIZE("dhd_rxf");
+
+	if (dhd_rxf_cpu >= 0 && cpu_online(dhd_rxf_cpu))
+		set_cpus_allowed_ptr(current, cpumask_of(dhd_rxf_cpu));
+
+	__skb_queue_head_init(&rxq);
+
+	/*  signal: thread has started */
+	complete(&tsk->completed);
+
+	while (1) {
+		if (down_interruptible(&tsk->sema) == 0) {
+
+			SMP_RD_BARRIER_DEPENDS();
+			if (tsk->terminated) {
+				break;
+			}
+
+			spin_lock_irq(&dhd->rxf_queue.lock);
+			skb_queue_splice_tail_init(&dhd->rxf_queue, &rxq);
+			spin_unlock_irq(&dhd->rxf_queue.lock);
+
+			/* netif_receive_skb() wants softirqs off */
+			local_bh_disable();
+			while ((skb = __skb_dequeue(&rxq)) != NULL)
+				netif_receive_skb(skb);
+			local_bh_enable();
+		}
+		else
+			break;
+	}
+
+	complete_and_exit(&tsk->completed, 0);
+}
 #endif /* DHDTHREAD */
 
 static void
@@ -2037,12 +2136,17 @@ dhd_ethtool(dhd_info_t *dhd, void *uaddr)
 		if ((ret = dhd_toe_set(dhd, 0, toe_cmpnt)) < 0)
 			return ret;
 
-		/* If setting TX checksum mode, tell Linux the new mode */
+		/* Tell Linux the new mode */
 		if (cmd == ETHTOOL_STXCSUM) {
 			if (edata.data)
 				dhd->iflist[0]->net->features |= NETIF_F_IP_CSUM;
 			else
 				dhd->iflist[0]->net->features &= ~NETIF_F_IP_CSUM;
+		} else {
+			if (edata.data)
+				dhd->iflist[0]->net->features |= NETIF_F_RXCSUM;
+			else
+				dhd->iflist[0]->net->features &= ~NETIF_F_RXCSUM;
 		}
 
 		break;
@@ -2453,10 +2557,27 @@ dhd_open(struct net_device *net)
 
 #ifdef TOE
 		/* Get current TOE mode from dongle */
-		if (dhd_toe_get(dhd, ifidx, &toe_ol) >= 0 && (toe_ol & TOE_TX_CSUM_OL) != 0)
+		if (dhd_toe_get(dhd, ifidx, &toe_ol) >= 0) {
+			/*
+			 * Frames the dongle has verified come up with BDC_FLAG_SUM_GOOD
+			 * and skip the software checksum in the stack.
+			 */
+			if (dhd_rx_csum_ol && !(toe_ol & TOE_RX_CSUM_OL) &&
+			    dhd_toe_set(dhd, ifidx, toe_ol | TOE_RX_CSUM_OL) >= 0)
+				toe_ol |= TOE_RX_CSUM_OL;
+		} else {
+			toe_ol = 0;
+		}
+
+		if (toe_ol & TOE_TX_CSUM_OL)
 			dhd->iflist[ifidx]->net->features |= NETIF_F_IP_CSUM;
 		else
 			dhd->iflist[ifidx]->net->features &= ~NETIF_F_IP_CSUM;
+
+		if (toe_ol & TOE_RX_CSUM_OL)
+			dhd->iflist[ifidx]->net->features |= NETIF_F_RXCSUM;
+		else
+			dhd->iflist[ifidx]->net->features &= ~NETIF_F_RXCSUM;
 #endif /* TOE */
 
 #if defined(WL_CFG80211)
@@ -2515,7 +2636,14 @@ int dhd_do_driver_init(struct net_device *net)
 osl_t *
 dhd_osl_attach(void *pdev, uint bustype)
 {
-	return osl_attach(pdev, bustype, TRUE);
+	osl_t *osh;
+
+	osh = osl_attach(pdev, bustype, TRUE);
+	if (osh && dhd_rxpool_size &&
+	    osl_rxpool_init(osh, dhd_rxpool_size, DHD_RXPOOL_BUFSZ) < 0)
+		DHD_ERROR(("%s: rx pool only partially filled\n", __FUNCTION__));
+
+	return osh;
 }
 
 void
@@ -2524,6 +2652,7 @@ dhd_osl_detach(osl_t *osh)
 	if (MALLOCED(osh)) {
 		DHD_ERROR(("%s: MEMORY LEAK %d bytes\n", __FUNCTION__, MALLOCED(osh)));
 	}
+	osl_rxpool_cleanup(osh);
 	osl_detach(osh);
 #if 1 && (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27))
 	up(&dhd_registration_sem);
@@ -2661,6 +2790,8 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 #ifdef DHDTHREAD
 	dhd->thr_dpc_ctl.thr_pid = DHD_PID_KT_TL_INVALID;
 	dhd->thr_wdt_ctl.thr_pid = DHD_PID_KT_INVALID;
+	dhd->thr_rxf_ctl.thr_pid = DHD_PID_KT_INVALID;
+	skb_queue_head_init(&dhd->rxf_queue);
 #endif /* DHDTHREAD */
 	dhd->dhd_tasklet_create = FALSE;
 	dhd->thr_sysioc_ctl.thr_pid = DHD_PID_KT_INVALID;
@@ -2782,6 +2913,13 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 
 	/* Set up the bottom half handler */
 	if (dhd_dpc_prio >= 0) {
+		/* Initialize rx delivery thread before the DPC can feed it */
+		if (dhd_rxf_enable) {
+			PROC_START(dhd_rxf_thread, dhd, &dhd->thr_rxf_ctl, 0);
+		} else {
+			dhd->thr_rxf_ctl.thr_pid = -1;
+		}
+
 		/* Initialize DPC thread */
 		PROC_START(dhd_dpc_thread, dhd, &dhd->thr_dpc_ctl, 0);
 	} else {
@@ -3721,6 +3859,14 @@ void dhd_detach(dhd_pub_t *dhdp)
 		else
 #endif /* DHDTHREAD */
 		tasklet_kill(&dhd->tasklet);
+
+#ifdef DHDTHREAD
+		/* the DPC is gone, nothing feeds the rx queue any more */
+		if (dhd->thr_rxf_ctl.thr_pid >= 0) {
+			PROC_STOP(&dhd->thr_rxf_ctl);
+		}
+		skb_queue_purge(&dhd->rxf_queue);
+#endif /* DHDTHREAD */
 	}
 	if (dhd->dhd_state & DHD_ATTACH_STATE_PROT_ATTACH) {
 		dhd_bus_detach(dhdp);
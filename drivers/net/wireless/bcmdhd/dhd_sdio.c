@@ -314,6 +314,11 @@ typedef struct dhd_bus {
 	uint		f2rxdata;		/* Number of frame data reads */
 	uint		f2txdata;		/* Number of f2 frame writes */
 	uint		f1regdata;		/* Number of f1 register accesses */
+	uint		f2txbytes;		/* Bytes written to f2 */
+	uint		f2rxbytes;		/* Bytes read from f2 */
+	uint64		f2tx_ns;		/* Time spent in f2 writes */
+	uint64		f2rx_ns;		/* Time spent in f2 reads */
+	uint64		ctrs_start_ns;		/* When the counters were last cleared */
 
 	uint8		*ctrl_frame_buf;
 	uint32		ctrl_frame_len;
@@ -354,6 +359,8 @@ extern void dhd_os_wd_timer(void *bus, uint wdtick);
 uint dhd_txbound;
 uint dhd_rxbound;
 uint dhd_txminmax = DHD_TXMINMAX;
+/* With rx pending, still send up to 1/dhd_txqdiv of a backed-up txq per round */
+uint dhd_txqdiv = 4;
 
 /* override the RAM size if possible */
 #define DONGLE_MIN_MEMSIZE (128 *1024)
@@ -2060,6 +2067,19 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	bcm_bprintf(strbuf, "f2rx (hdrs/data) %d (%d/%d), f2tx %d f1regs %d\n",
 	            (bus->f2rxhdrs + bus->f2rxdata), bus->f2rxhdrs, bus->f2rxdata,
 	            bus->f2txdata, bus->f1regdata);
+	bcm_bprintf(strbuf, "f2 bytes rx %u tx %u, busy ms rx %u tx %u\n",
+	            bus->f2rxbytes, bus->f2txbytes,
+	            (uint)(bus->f2rx_ns >> 20), (uint)(bus->f2tx_ns >> 20));
+	{
+		/* >> 20 keeps 100 * busy in range for ~11h between clears */
+		uint elapsed = (uint)((OSL_LOCALTIME_NS() - bus->ctrs_start_ns) >> 20);
+
+		dhd_dump_pct(strbuf, "SDIO util pct: rx", 100 * (uint)(bus->f2rx_ns >> 20),
+		             elapsed);
+		dhd_dump_pct(strbuf, ", tx", 100 * (uint)(bus->f2tx_ns >> 20), elapsed);
+		bcm_bprintf(strbuf, "\n");
+	}
+	osl_rxpool_stats(bus->dhd->osh, strbuf);
 	{
 		dhd_dump_pct(strbuf, "\nRx: pkts/f2rd", bus->dhd->rx_packets,
 		             (bus->f2rxhdrs + bus->f2rxdata));
@@ -2124,6 +2144,9 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->tx_sderrs = bus->fc_rcvd = bus->fc_xoff = bus->fc_xon = 0;
 	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = 0;
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
+	bus->f2rxbytes = bus->f2txbytes = 0;
+	bus->f2rx_ns = bus->f2tx_ns = 0;
+	bus->ctrs_start_ns = OSL_LOCALTIME_NS();
 }
 
 #ifdef SDTEST
@@ -5246,6 +5269,9 @@ clkwait:
 	else if ((bus->clkstate == CLK_AVAIL) && !bus->fcstate &&
 	    pktq_mlen(&bus->txq, ~bus->flowcontrol) && txlimit && DATAOK(bus)) {
 		framecnt = rxdone ? txlimit : MIN(txlimit, dhd_txminmax);
+		if (!rxdone && dhd_txqdiv)
+			framecnt = MIN(txlimit, MAX(framecnt,
+				pktq_mlen(&bus->txq, ~bus->flowcontrol) / dhd_txqdiv));
 		framecnt = dhdsdio_sendfromq(bus, framecnt);
 		txlimit -= framecnt;
 	}
@@ -6255,6 +6281,7 @@ dhdsdio_probe_init(dhd_bus_t *bus, osl_t *osh, void *sdh)
 	bus->sleeping = FALSE;
 	bus->rxflow = FALSE;
 	bus->prev_rxlim_hit = 0;
+	bus->ctrs_start_ns = OSL_LOCALTIME_NS();
 
 	/* Done with backplane-dependent accesses, can drop clock... */
 	bcmsdh_cfg_write(sdh, SDIO_FUNC_1, SBSDIO_FUNC1_CHIPCLKCSR, 0, NULL);
@@ -6795,13 +6822,19 @@ dhd_bcmsdh_recv_buf(dhd_bus_t *bus, uint32 addr, uint fn, uint flags, uint8 *buf
 	void *pkt, bcmsdh_cmplt_fn_t complete, void *handle)
 {
 	int status;
+	uint64 start;
 
 	if (!KSO_ENAB(bus)) {
 		DHD_ERROR(("%s: Device asleep\n", __FUNCTION__));
 		return BCME_NODEVICE;
 	}
 
+	start = OSL_LOCALTIME_NS();
 	status = bcmsdh_recv_buf(bus->sdh, addr, fn, flags, buf, nbytes, pkt, complete, handle);
+	if (fn == SDIO_FUNC_2) {
+		bus->f2rx_ns += OSL_LOCALTIME_NS() - start;
+		bus->f2rxbytes += nbytes;
+	}
 
 	return status;
 }
@@ -6810,12 +6843,22 @@ static int
 dhd_bcmsdh_send_buf(dhd_bus_t *bus, uint32 addr, uint fn, uint flags, uint8 *buf, uint nbytes,
 	void *pkt, bcmsdh_cmplt_fn_t complete, void *handle)
 {
+	int status;
+	uint64 start;
+
 	if (!KSO_ENAB(bus)) {
 		DHD_ERROR(("%s: Device asleep\n", __FUNCTION__));
 		return BCME_NODEVICE;
 	}
 
-	return (bcmsdh_send_buf(bus->sdh, addr, fn, flags, buf, nbytes, pkt, complete, handle));
+	start = OSL_LOCALTIME_NS();
+	status = bcmsdh_send_buf(bus->sdh, addr, fn, flags, buf, nbytes, pkt, complete, handle);
+	if (fn == SDIO_FUNC_2) {
+		bus->f2tx_ns += OSL_LOCALTIME_NS() - start;
+		bus->f2txbytes += nbytes;
+	}
+
+	return status;
 }
 
 uint
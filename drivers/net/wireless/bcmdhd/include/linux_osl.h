@@ -167,6 +167,7 @@ extern int osl_error(int bcmerror);
 #include <linux/string.h>       
 
 #define OSL_SYSUPTIME()		((uint32)jiffies * (1000 / HZ))
+#define OSL_LOCALTIME_NS()	((uint64)local_clock())
 #define	printf(fmt, args...)	printk(fmt , ## args)
 #include <linux/kernel.h>	
 #include <linux/string.h>	
@@ -336,6 +337,10 @@ extern void osl_ctfpool_stats(osl_t *osh, void *b);
 #define	PKTSKIPCT(osh, skb)
 #endif 
 
+extern int32 osl_rxpool_init(osl_t *osh, uint numobj, uint size);
+extern void osl_rxpool_cleanup(osl_t *osh);
+extern void osl_rxpool_stats(osl_t *osh, void *b);
+
 extern void osl_pktfree(osl_t *osh, void *skb, bool send);
 extern void *osl_pktget_static(osl_t *osh, uint len);
 extern void osl_pktfree_static(osl_t *osh, void *skb, bool send);
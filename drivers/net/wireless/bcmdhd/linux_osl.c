@@ -41,6 +41,7 @@
 
 
 #include <linux/fs.h>
+#include <linux/workqueue.h>
 
 #define PCI_CFG_RETRY 		10
 
@@ -72,6 +73,22 @@ typedef struct bcm_static_pkt {
 static bcm_static_pkt_t *bcm_static_skb = 0;
 #endif 
 
+/* Preallocated rx skbs, refilled with GFP_KERNEL from a work item and
+ * topped up with skbs recycled from osl_pktfree(), so the rx path does not
+ * depend on GFP_ATOMIC allocations succeeding under memory pressure.
+ */
+typedef struct osl_rxpool {
+	struct sk_buff_head	q;		/* lock protects the counters too */
+	struct work_struct	refill_work;
+	uint			max_obj;
+	uint			obj_size;
+	uint			fast_allocs;
+	uint			slow_allocs;
+	uint			alloc_fails;
+	uint			recycled;
+	uint			refills;
+} osl_rxpool_t;
+
 typedef struct bcm_mem_link {
 	struct bcm_mem_link *prev;
 	struct bcm_mem_link *next;
@@ -86,6 +103,7 @@ struct osl_info {
 #ifdef CTFPOOL
 	ctfpool_t *ctfpool;
 #endif 
+	osl_rxpool_t *rxpool;
 	uint magic;
 	void *pdev;
 	atomic_t malloced;
@@ -472,6 +490,131 @@ osl_pktfastget(osl_t *osh, uint len)
 }
 #endif 
 
+static void
+osl_rxpool_refill(struct work_struct *work)
+{
+	osl_rxpool_t *pool = container_of(work, osl_rxpool_t, refill_work);
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	while (skb_queue_len(&pool->q) < pool->max_obj) {
+		skb = __dev_alloc_skb(pool->obj_size, GFP_KERNEL);
+
+		spin_lock_irqsave(&pool->q.lock, flags);
+		if (skb == NULL) {
+			pool->alloc_fails++;
+			spin_unlock_irqrestore(&pool->q.lock, flags);
+			break;
+		}
+		if (skb_queue_len(&pool->q) >= pool->max_obj) {
+			spin_unlock_irqrestore(&pool->q.lock, flags);
+			dev_kfree_skb(skb);
+			break;
+		}
+		__skb_queue_tail(&pool->q, skb);
+		pool->refills++;
+		spin_unlock_irqrestore(&pool->q.lock, flags);
+	}
+}
+
+int32
+osl_rxpool_init(osl_t *osh, uint numobj, uint size)
+{
+	osl_rxpool_t *pool;
+
+	pool = kzalloc(sizeof(osl_rxpool_t), GFP_KERNEL);
+	if (pool == NULL)
+		return -1;
+
+	skb_queue_head_init(&pool->q);
+	INIT_WORK(&pool->refill_work, osl_rxpool_refill);
+	pool->max_obj = numobj;
+	pool->obj_size = size;
+
+	osl_rxpool_refill(&pool->refill_work);
+	osh->rxpool = pool;
+
+	return (skb_queue_len(&pool->q) == numobj) ? 0 : -1;
+}
+
+void
+osl_rxpool_cleanup(osl_t *osh)
+{
+	osl_rxpool_t *pool;
+
+	if ((osh == NULL) || (osh->rxpool == NULL))
+		return;
+
+	pool = osh->rxpool;
+	osh->rxpool = NULL;
+
+	cancel_work_sync(&pool->refill_work);
+	skb_queue_purge(&pool->q);
+	kfree(pool);
+}
+
+void
+osl_rxpool_stats(osl_t *osh, void *b)
+{
+	struct bcmstrbuf *bb = b;
+	osl_rxpool_t *pool;
+
+	if ((osh == NULL) || (osh->rxpool == NULL))
+		return;
+
+	pool = osh->rxpool;
+	bcm_bprintf(bb, "rxpool max_obj %d obj_size %d curr_obj %d refills %d\n",
+	            pool->max_obj, pool->obj_size, skb_queue_len(&pool->q), pool->refills);
+	bcm_bprintf(bb, "rxpool fast_allocs %d slow_allocs %d alloc_fails %d recycled %d\n",
+	            pool->fast_allocs, pool->slow_allocs, pool->alloc_fails, pool->recycled);
+}
+
+static inline struct sk_buff *
+osl_rxpool_get(osl_t *osh, uint len)
+{
+	osl_rxpool_t *pool = osh->rxpool;
+	struct sk_buff *skb;
+	unsigned long flags;
+	bool refill;
+
+	if ((pool == NULL) || (len > pool->obj_size))
+		return NULL;
+
+	spin_lock_irqsave(&pool->q.lock, flags);
+	skb = __skb_dequeue(&pool->q);
+	if (skb != NULL)
+		pool->fast_allocs++;
+	else
+		pool->slow_allocs++;
+	refill = (skb_queue_len(&pool->q) < pool->max_obj / 2);
+	spin_unlock_irqrestore(&pool->q.lock, flags);
+
+	if (refill)
+		schedule_work(&pool->refill_work);
+
+	return skb;
+}
+
+static inline bool
+osl_rxpool_put(osl_t *osh, struct sk_buff *skb)
+{
+	osl_rxpool_t *pool = osh->rxpool;
+	unsigned long flags;
+
+	if ((pool == NULL) || (skb_queue_len(&pool->q) >= pool->max_obj))
+		return FALSE;
+
+	if (!skb_recycle_check(skb, pool->obj_size))
+		return FALSE;
+
+	spin_lock_irqsave(&pool->q.lock, flags);
+	__skb_queue_tail(&pool->q, skb);
+	pool->recycled++;
+	spin_unlock_irqrestore(&pool->q.lock, flags);
+
+	return TRUE;
+}
+
 struct sk_buff * BCMFASTPATH
 osl_pkt_tonative(osl_t *osh, void *pkt)
 {
@@ -529,7 +672,8 @@ osl_pktget(osl_t *osh, uint len)
 	skb = osl_pktfastget(osh, len);
 	if ((skb != NULL) || ((skb = osl_alloc_skb(len)) != NULL)) {
 #else 
-	if ((skb = osl_alloc_skb(len))) {
+	skb = osl_rxpool_get(osh, len);
+	if ((skb != NULL) || ((skb = osl_alloc_skb(len)) != NULL)) {
 #endif 
 		skb_put(skb, len);
 		skb->priority = 0;
@@ -538,6 +682,10 @@ osl_pktget(osl_t *osh, uint len)
 		spin_lock_irqsave(&osh->pktalloc_lock, flags);
 		osh->pub.pktalloced++;
 		spin_unlock_irqrestore(&osh->pktalloc_lock, flags);
+	} else if (osh->rxpool != NULL) {
+		spin_lock_irqsave(&osh->rxpool->q.lock, flags);
+		osh->rxpool->alloc_fails++;
+		spin_unlock_irqrestore(&osh->rxpool->q.lock, flags);
 	}
 
 	return ((void*) skb);
@@ -607,7 +755,7 @@ osl_pktfree(osl_t *osh, void *p, bool send)
 			osl_pktfastfree(osh, skb);
 		else {
 #else 
-		{
+		if (!osl_rxpool_put(osh, skb)) {
 #endif 
 
 			if (skb->destructor)
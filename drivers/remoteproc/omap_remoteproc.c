@@ -29,7 +29,8 @@
 #include <linux/dma-mapping.h>
 #include <linux/remoteproc.h>
 #include <linux/hwspinlock.h>
-#include <linux/kthread.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
 #include <linux/slab.h>
 #include <linux/pm_qos.h>
 
@@ -82,6 +83,10 @@ struct hwspinlock_info {
  * @suspended: flag that says if rproc suspended
  * @need_kick: flag that says if vrings need to be kicked on resume
  * @hwlock_info: virtual addresses of hwspinlock states shared by rproc
+ * @vq_wq: ordered workqueue that processes virtqueue notifications
+ * @vq_work: handles the virtqueues flagged in @vq_pending
+ * @vq_timer: delays @vq_work by the rproc's rx_coalesce_us
+ * @vq_pending: bitmap of the virtqueue indices notified by the remote side
  *
  */
 struct omap_rproc {
@@ -91,7 +96,6 @@ struct omap_rproc {
 	void __iomem *boot_reg;
 	union oproc_pm_qos lat_req;
 	struct pm_qos_request bw_req;
-	atomic_t thrd_cnt;
 	struct completion pm_comp;
 	void __iomem *idle;
 	u32 idle_mask;
@@ -100,34 +104,64 @@ struct omap_rproc {
 	bool suspended;
 	bool need_kick;
 	struct hwspinlock_info hwlock_info;
+	struct workqueue_struct *vq_wq;
+	struct work_struct vq_work;
+	struct hrtimer vq_timer;
+	unsigned long vq_pending;
 };
 
-struct _thread_data {
-	struct rproc *rproc;
-	int msg;
-};
+/*
+ * Notifications that arrive while a virtqueue is already pending are folded
+ * into the pending one, and its consumer drains everything that is queued
+ * by then, so a burst from the remote processor is handled in one pass.
+ */
+static void omap_rproc_vq_work(struct work_struct *work)
+{
+	struct omap_rproc *oproc = container_of(work, struct omap_rproc,
+								vq_work);
+	struct device *dev = oproc->rproc->dev.parent;
+	unsigned long pending;
+	int vqid;
+
+	pending = xchg(&oproc->vq_pending, 0);
 
-static int _vq_interrupt_thread(struct _thread_data *d)
+	for_each_set_bit(vqid, &pending, BITS_PER_LONG)
+		if (rproc_vq_interrupt(oproc->rproc, vqid) == IRQ_NONE)
+			dev_dbg(dev, "no message was found in vqid 0x%x\n",
+									vqid);
+}
+
+static enum hrtimer_restart omap_rproc_vq_timer(struct hrtimer *timer)
 {
-	struct omap_rproc *oproc = d->rproc->priv;
-	struct device *dev = d->rproc->dev.parent;
-
-	/* msg contains the index of the triggered vring */
-	if (rproc_vq_interrupt(d->rproc, d->msg) == IRQ_NONE)
-		dev_dbg(dev, "no message was found in vqid 0x0\n");
-	kfree(d);
-	atomic_dec(&oproc->thrd_cnt);
-	return 0;
+	struct omap_rproc *oproc = container_of(timer, struct omap_rproc,
+								vq_timer);
+
+	queue_work(oproc->vq_wq, &oproc->vq_work);
+	return HRTIMER_NORESTART;
+}
+
+/* flag a notified virtqueue, and schedule its processing */
+static void omap_rproc_vq_notify(struct omap_rproc *oproc, int vqid)
+{
+	u32 delay_us = oproc->rproc->rx_coalesce_us;
+
+	set_bit(vqid, &oproc->vq_pending);
+
+	/* optionally give the remote side some time to queue more */
+	if (!delay_us)
+		queue_work(oproc->vq_wq, &oproc->vq_work);
+	else if (!hrtimer_is_queued(&oproc->vq_timer))
+		hrtimer_start(&oproc->vq_timer,
+				ns_to_ktime((u64)delay_us * NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
 }
 
 /**
- * omap_rproc_mbox_callback() - inbound mailbox message handler
- * @this: notifier block
- * @index: unused
- * @data: mailbox payload
+ * omap_rproc_handle_msg() - handle one inbound mailbox message
+ * @oproc: the remote processor the message came from
+ * @msg: mailbox payload
  *
- * This handler is invoked by omap's mailbox driver whenever a mailbox
- * message is received. Usually, the mailbox payload simply contains
+ * Usually, the mailbox payload simply contains
  * the index of the virtqueue that is kicked by the remote processor,
  * and we let remoteproc core handle it.
  *
@@ -135,14 +169,10 @@ static int _vq_interrupt_thread(struct _thread_data *d)
  * that indicates different events. Those values are deliberately very
  * big so they don't coincide with virtqueue indices.
  */
-static int omap_rproc_mbox_callback(struct notifier_block *this,
-					unsigned long index, void *data)
+static void omap_rproc_handle_msg(struct omap_rproc *oproc, mbox_msg_t msg)
 {
-	mbox_msg_t msg = (mbox_msg_t) data;
-	struct omap_rproc *oproc = container_of(this, struct omap_rproc, nb);
 	struct device *dev = oproc->rproc->dev.parent;
 	const char *name = oproc->rproc->name;
-	struct _thread_data *d;
 
 	dev_dbg(dev, "mbox msg: 0x%x\n", msg);
 
@@ -164,17 +194,36 @@ static int omap_rproc_mbox_callback(struct notifier_block *this,
 	default:
 		if (msg >= RP_MBOX_END_MSG) {
 			dev_info(dev, "Dropping unknown message %x", msg);
-			return NOTIFY_DONE;
+			break;
 		}
-		d = kmalloc(sizeof(*d), GFP_KERNEL);
-		if (!d)
+		/* msg contains the index of the triggered vring */
+		if (msg >= BITS_PER_LONG) {
+			dev_dbg(dev, "no vring for message %x\n", msg);
 			break;
-		d->rproc = oproc->rproc;
-		d->msg = msg;
-		atomic_inc(&oproc->thrd_cnt);
-		kthread_run((void *)_vq_interrupt_thread, d,
-					"vp_interrupt_thread");
+		}
+		omap_rproc_vq_notify(oproc, msg);
 	}
+}
+
+/**
+ * omap_rproc_mbox_callback() - inbound mailbox messages handler
+ * @this: notifier block
+ * @count: number of messages
+ * @data: array of mailbox payloads
+ *
+ * This handler is invoked by omap's mailbox driver with all the messages
+ * it has received since the last call, so that a burst of kicks costs a
+ * single notification.
+ */
+static int omap_rproc_mbox_callback(struct notifier_block *this,
+					unsigned long count, void *data)
+{
+	struct omap_rproc *oproc = container_of(this, struct omap_rproc, nb);
+	mbox_msg_t *msgs = data;
+	unsigned long i;
+
+	for (i = 0; i < count; i++)
+		omap_rproc_handle_msg(oproc, msgs[i]);
 
 	return NOTIFY_DONE;
 }
@@ -294,8 +343,6 @@ static int omap_rproc_start(struct rproc *rproc)
 	struct omap_rproc_timers_info *timers = pdata->timers;
 	int ret, i;
 
-	/* init thread counter for mbox messages */
-	atomic_set(&oproc->thrd_cnt, 0);
 	/* load remote processor boot address if needed. */
 	if (oproc->boot_reg)
 		writel(rproc->bootaddr, oproc->boot_reg);
@@ -303,10 +350,10 @@ static int omap_rproc_start(struct rproc *rproc)
 	oproc->nb.notifier_call = omap_rproc_mbox_callback;
 
 	/* every omap rproc is assigned a mailbox instance for messaging */
-	oproc->mbox = omap_mbox_get(pdata->mbox_name, &oproc->nb);
+	oproc->mbox = omap_mbox_get_batch(pdata->mbox_name, &oproc->nb);
 	if (IS_ERR(oproc->mbox)) {
 		ret = PTR_ERR(oproc->mbox);
-		dev_err(dev, "omap_mbox_get failed: %d\n", ret);
+		dev_err(dev, "omap_mbox_get_batch failed: %d\n", ret);
 		return ret;
 	}
 
@@ -426,9 +473,10 @@ static int omap_rproc_stop(struct rproc *rproc)
 
 	omap_mbox_put(oproc->mbox, &oproc->nb);
 
-	/* wait untill all threads have finished */
-	while (atomic_read(&oproc->thrd_cnt))
-		schedule();
+	/* wait until all pending notifications have been processed */
+	hrtimer_cancel(&oproc->vq_timer);
+	flush_workqueue(oproc->vq_wq);
+	oproc->vq_pending = 0;
 
 	return 0;
 }
@@ -640,10 +688,20 @@ static int __devinit omap_rproc_probe(struct platform_device *pdev)
 	oproc->suspend_timeout = pdata->suspend_timeout ? : DEF_SUSPEND_TIMEOUT;
 	init_completion(&oproc->pm_comp);
 
+	oproc->vq_wq = alloc_ordered_workqueue("%s-vq", WQ_HIGHPRI,
+								pdata->name);
+	if (!oproc->vq_wq) {
+		ret = -ENOMEM;
+		goto free_rproc;
+	}
+	INIT_WORK(&oproc->vq_work, omap_rproc_vq_work);
+	hrtimer_init(&oproc->vq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	oproc->vq_timer.function = omap_rproc_vq_timer;
+
 	if (pdata->idle_addr) {
 		oproc->idle = ioremap(pdata->idle_addr, sizeof(u32));
 		if (!oproc->idle)
-			goto free_rproc;
+			goto free_wq;
 		oproc->idle_mask = pdata->idle_mask;
 	}
 
@@ -676,6 +734,8 @@ iounmap:
 		iounmap(oproc->idle);
 	if (oproc->boot_reg)
 		iounmap(oproc->boot_reg);
+free_wq:
+	destroy_workqueue(oproc->vq_wq);
 free_rproc:
 	rproc_free(rproc);
 	return ret;
@@ -685,6 +745,8 @@ static int __devexit omap_rproc_remove(struct platform_device *pdev)
 {
 	struct rproc *rproc = platform_get_drvdata(pdev);
 	struct omap_rproc *oproc = rproc->priv;
+	struct workqueue_struct *vq_wq = oproc->vq_wq;
+	int ret;
 
 	if (oproc->idle)
 		iounmap(oproc->idle);
@@ -694,7 +756,12 @@ static int __devexit omap_rproc_remove(struct platform_device *pdev)
 
 	pm_qos_remove_request(&oproc->bw_req);
 	omap_rproc_remove_lat_request(oproc);
-	return rproc_unregister(rproc);
+
+	ret = rproc_unregister(rproc);
+
+	/* oproc may be gone with the last rproc reference by now */
+	destroy_workqueue(vq_wq);
+	return ret;
 }
 
 static struct platform_driver omap_rproc_driver = {
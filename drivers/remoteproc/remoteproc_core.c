@@ -44,11 +44,20 @@
 #include <linux/kthread.h>
 #include <linux/delay.h>
 #include <linux/vmalloc.h>
+#include <linux/crc32.h>
+#include <linux/log2.h>
 
 #include "remoteproc_internal.h"
 
 #define DEFAULT_AUTOSUSPEND_TIMEOUT 5000
 
+/* idle time a suspend/resume cycle is worth, on top of its latency */
+#define DEFAULT_PM_BREAK_EVEN_MS 50
+/* idle gaps needed before the history is trusted to pick a delay */
+#define RPROC_PM_MIN_GAPS	16
+/* the history is halved once it holds this many gaps */
+#define RPROC_PM_MAX_GAPS	256
+
 #define dev_to_rproc(dev) container_of(dev, struct rproc, dev)
 
 static void klist_rproc_get(struct klist_node *n);
@@ -188,9 +197,109 @@ out:
 	return ret;
 }
 
+/*
+ * Pick the autosuspend delay which minimizes the expected cost of the idle
+ * gaps seen so far: a gap shorter than the delay costs the time it keeps
+ * the remote processor needlessly awake, a longer one costs the delay plus
+ * a suspend/resume cycle. Gaps are accounted at the middle of their bucket.
+ */
+static int rproc_pm_pick_delay(struct rproc_pm_stats *pm, int max)
+{
+	u64 cost, best_cost = ~0ULL;
+	u32 wake = pm->break_even_ms;
+	int best = max, delay, i, k;
+
+	if (pm->resume_cnt)
+		wake += div_u64(pm->resume_us, pm->resume_cnt) / USEC_PER_MSEC;
+
+	for (k = 0, delay = 1; ; k++, delay = min(1 << k, max)) {
+		cost = 0;
+		for (i = 0; i < RPROC_PM_HIST_BUCKETS; i++) {
+			u32 gap = (3 << i) >> 2;
+
+			if (gap <= delay)
+				cost += (u64)pm->idle_hist[i] * gap;
+			else
+				cost += (u64)pm->idle_hist[i] * (delay + wake);
+		}
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = delay;
+		}
+		if (delay >= max)
+			break;
+	}
+
+	return best;
+}
+
+/**
+ * rproc_pm_mark_busy() - account traffic to or from a remote processor
+ * @rproc: the remote processor
+ *
+ * Records the idle gap since the previous message, and picks a new
+ * autosuspend delay from the history every now and then.
+ */
+void rproc_pm_mark_busy(struct rproc *rproc)
+{
+	struct rproc_pm_stats *pm = &rproc->pm;
+	ktime_t now = ktime_get();
+	unsigned long flags;
+	s64 gap;
+	int i;
+
+	spin_lock_irqsave(&pm->lock, flags);
+
+	gap = ktime_to_ms(ktime_sub(now, pm->last_busy));
+	pm->last_busy = now;
+
+	i = gap > 0 ? min_t(int, fls(gap), RPROC_PM_HIST_BUCKETS - 1) : 0;
+	pm->idle_hist[i]++;
+	pm->idle_total++;
+
+	/* let old traffic patterns fade out */
+	if (++pm->idle_cnt >= RPROC_PM_MAX_GAPS) {
+		pm->idle_cnt = 0;
+		for (i = 0; i < RPROC_PM_HIST_BUCKETS; i++) {
+			pm->idle_hist[i] >>= 1;
+			pm->idle_cnt += pm->idle_hist[i];
+		}
+	}
+
+	if (pm->adaptive && rproc->auto_suspend_timeout > 0 &&
+	    pm->idle_total >= RPROC_PM_MIN_GAPS &&
+	    !(pm->idle_total % RPROC_PM_MIN_GAPS))
+		pm->delay = rproc_pm_pick_delay(pm,
+						rproc->auto_suspend_timeout);
+
+	spin_unlock_irqrestore(&pm->lock, flags);
+}
+
+/**
+ * rproc_pm_update_delay() - apply the autosuspend delay picked for @rproc
+ * @rproc: the remote processor
+ *
+ * Called from process context, rproc_pm_mark_busy() may not be.
+ */
+void rproc_pm_update_delay(struct rproc *rproc)
+{
+	struct device *dev = &rproc->dev;
+	int delay = rproc->pm.adaptive ? rproc->pm.delay :
+					 rproc->auto_suspend_timeout;
+
+	if (rproc->auto_suspend_timeout < 0 || delay <= 0)
+		return;
+
+	if (delay != rproc->pm.applied) {
+		pm_runtime_set_autosuspend_delay(dev, delay);
+		rproc->pm.applied = delay;
+	}
+}
+
 static int rproc_runtime_resume(struct device *dev)
 {
 	struct rproc *rproc = dev_to_rproc(dev);
+	ktime_t start;
 	int ret = 0;
 
 	dev_dbg(dev, "Enter %s\n", __func__);
@@ -208,6 +317,7 @@ static int rproc_runtime_resume(struct device *dev)
 		return -EAGAIN;
 	}
 
+	start = ktime_get();
 	rproc_activate_iommu(rproc);
 	if (rproc->ops->resume) {
 		ret = rproc->ops->resume(rproc);
@@ -219,6 +329,9 @@ static int rproc_runtime_resume(struct device *dev)
 	}
 
 	rproc->state = RPROC_RUNNING;
+	rproc->pm.last_resume_us = ktime_us_delta(ktime_get(), start);
+	rproc->pm.resume_us += rproc->pm.last_resume_us;
+	rproc->pm.resume_cnt++;
 out:
 	return ret;
 }
@@ -226,6 +339,7 @@ out:
 static int rproc_runtime_suspend(struct device *dev)
 {
 	struct rproc *rproc = dev_to_rproc(dev);
+	ktime_t start;
 	int ret;
 
 	dev_dbg(dev, "Enter %s\n", __func__);
@@ -233,6 +347,7 @@ static int rproc_runtime_suspend(struct device *dev)
 	if (rproc->state != RPROC_RUNNING)
 		goto out;
 
+	start = ktime_get();
 	if (rproc->ops->suspend) {
 		ret = rproc->ops->suspend(rproc, true);
 		if (ret)
@@ -241,6 +356,8 @@ static int rproc_runtime_suspend(struct device *dev)
 	rproc_idle_iommu(rproc);
 
 	rproc->state = RPROC_SUSPENDED;
+	rproc->pm.suspend_us += ktime_us_delta(ktime_get(), start);
+	rproc->pm.suspend_cnt++;
 out:
 	return 0;
 abort:
@@ -723,6 +840,17 @@ static int rproc_handle_vdev(struct rproc *rproc, struct fw_rsc_vdev *rsc,
 	/* remember the device features */
 	rvdev->dfeatures = rsc->dfeatures;
 
+	/* the config space follows the vrings; keep it beyond the fw image */
+	if (rsc->config_len) {
+		rvdev->config = kmemdup(&rsc->vring[rsc->num_of_vrings],
+					rsc->config_len, GFP_KERNEL);
+		if (!rvdev->config) {
+			ret = -ENOMEM;
+			goto free_rvdev;
+		}
+		rvdev->config_len = rsc->config_len;
+	}
+
 	list_add_tail(&rvdev->node, &rproc->rvdevs);
 
 	/* it is now safe to add the virtio device */
@@ -733,6 +861,7 @@ static int rproc_handle_vdev(struct rproc *rproc, struct fw_rsc_vdev *rsc,
 	return 0;
 
 free_rvdev:
+	kfree(rvdev->config);
 	kfree(rvdev);
 	return ret;
 }
@@ -799,6 +928,7 @@ static int rproc_handle_last_trace(struct rproc *rproc,
 	}
 
 	trace_last->len = trace->len;
+	trace_last->flags = trace->flags;
 	trace_last->va = vmalloc(sizeof(u32) * trace_last->len);
 	if (!trace_last->va) {
 		dev_err(dev, "vmalloc failed for trace%d_last\n", count);
@@ -813,7 +943,7 @@ static int rproc_handle_last_trace(struct rproc *rproc,
 	/* create the debugfs entry */
 	if (new_trace) {
 		trace_last->priv = rproc_create_trace_file(name, rproc,
-				trace_last);
+				trace_last, false);
 		if (!trace_last->priv) {
 			dev_err(dev, "trace%d_last create debugfs failed\n",
 							count);
@@ -863,12 +993,23 @@ static int rproc_handle_trace(struct rproc *rproc, struct fw_rsc_trace *rsc,
 		return -EINVAL;
 	}
 
-	/* make sure reserved bytes are zeroes */
-	if (rsc->reserved) {
-		dev_err(dev, "trace rsc has non zero reserved bytes\n");
+	/* make sure unknown flags are zeroes */
+	if (rsc->flags & ~RPROC_TRACE_F_SEQ) {
+		dev_err(dev, "trace rsc has unknown flags 0x%x\n", rsc->flags);
 		return -EINVAL;
 	}
 
+	if (rsc->flags & RPROC_TRACE_F_SEQ) {
+		u32 ring = rsc->len - sizeof(struct fw_trace_hdr);
+
+		if (rsc->len <= sizeof(struct fw_trace_hdr) ||
+		    !is_power_of_2(ring)) {
+			dev_err(dev, "bad sequenced trace ring size 0x%x\n",
+								rsc->len);
+			return -EINVAL;
+		}
+	}
+
 	/* what's the kernel address of this resource ? */
 	ptr = rproc_da_to_va(rproc, rsc->da, rsc->len);
 	if (!ptr) {
@@ -885,12 +1026,13 @@ static int rproc_handle_trace(struct rproc *rproc, struct fw_rsc_trace *rsc,
 	/* set the trace buffer dma properties */
 	trace->len = rsc->len;
 	trace->va = ptr;
+	trace->flags = rsc->flags;
 
 	/* make sure snprintf always null terminates, even if truncating */
 	snprintf(name, sizeof(name), "trace%d", rproc->num_traces);
 
 	/* create the debugfs entry */
-	trace->priv = rproc_create_trace_file(name, rproc, trace);
+	trace->priv = rproc_create_trace_file(name, rproc, trace, true);
 	if (!trace->priv) {
 		trace->va = NULL;
 		kfree(trace);
@@ -1544,6 +1686,95 @@ static int rproc_fw_sanity_check(struct rproc *rproc, const struct firmware *fw)
 	return 0;
 }
 
+static void rproc_fw_image_release(struct kref *kref)
+{
+	struct rproc_fw_image *image = container_of(kref,
+					struct rproc_fw_image, refcount);
+
+	vfree(image);
+}
+
+static void rproc_fw_image_put(struct rproc_fw_image *image)
+{
+	kref_put(&image->refcount, rproc_fw_image_release);
+}
+
+/**
+ * rproc_fw_image_flush() - drop the cached firmware image
+ * @rproc: the rproc handle
+ *
+ * The next boot will request the firmware again, e.g. to pick up a new
+ * image. Must be called with @rproc->lock held.
+ */
+void rproc_fw_image_flush(struct rproc *rproc)
+{
+	if (rproc->fw_image) {
+		rproc_fw_image_put(rproc->fw_image);
+		rproc->fw_image = NULL;
+	}
+}
+
+/**
+ * rproc_fw_image_store() - keep a copy of a firmware image for later boots
+ * @rproc: the rproc handle
+ * @fw: the firmware image, as returned by request_firmware()
+ *
+ * Must be called with @rproc->lock held. Failing to cache the image isn't
+ * fatal, the next boot just requests the firmware again.
+ */
+static void rproc_fw_image_store(struct rproc *rproc,
+				 const struct firmware *fw)
+{
+	struct rproc_fw_image *image;
+
+	if (rproc->fw_image)
+		return;
+
+	image = vmalloc(sizeof(*image) + fw->size);
+	if (!image) {
+		dev_warn(&rproc->dev, "can't cache fw image %s\n",
+							rproc->firmware);
+		return;
+	}
+
+	memset(&image->fw, 0, sizeof(image->fw));
+	memcpy(image->data, fw->data, fw->size);
+	image->fw.size = fw->size;
+	image->fw.data = image->data;
+	image->crc = crc32_le(~0, image->data, fw->size);
+	kref_init(&image->refcount);
+
+	rproc->fw_image = image;
+}
+
+/**
+ * rproc_fw_image_get() - grab the cached firmware image, if any
+ * @rproc: the rproc handle
+ *
+ * The image is verified against the checksum taken when it was cached,
+ * and dropped if it doesn't match. Must be called with @rproc->lock held.
+ *
+ * Returns the image with a reference that must be released with
+ * rproc_fw_image_put(), or NULL if there is no (valid) cached image.
+ */
+static struct rproc_fw_image *rproc_fw_image_get(struct rproc *rproc)
+{
+	struct rproc_fw_image *image = rproc->fw_image;
+
+	if (!image)
+		return NULL;
+
+	if (crc32_le(~0, image->data, image->fw.size) != image->crc) {
+		dev_warn(&rproc->dev, "cached fw image %s is corrupted\n",
+							rproc->firmware);
+		rproc_fw_image_flush(rproc);
+		return NULL;
+	}
+
+	kref_get(&image->refcount);
+	return image;
+}
+
 /*
  * take a firmware and boot a remote processor with it.
  */
@@ -1627,6 +1858,9 @@ static int rproc_fw_boot(struct rproc *rproc, const struct firmware *fw)
 	pm_runtime_get_noresume(dev);
 	rproc->auto_suspend_timeout = rproc->auto_suspend_timeout ? :
 					DEFAULT_AUTOSUSPEND_TIMEOUT;
+	rproc->pm.delay = rproc->auto_suspend_timeout;
+	rproc->pm.applied = rproc->auto_suspend_timeout;
+	rproc->pm.last_busy = ktime_get();
 	if (rproc->auto_suspend_timeout >= 0) {
 		pm_runtime_set_autosuspend_delay(dev,
 						 rproc->auto_suspend_timeout);
@@ -1647,8 +1881,24 @@ clean_up:
 	return ret;
 }
 
+/* take a firmware and look for virtio devices to register */
+static void rproc_config_virtio(struct rproc *rproc, const struct firmware *fw)
+{
+	struct resource_table *table;
+	int tablesz;
+
+	/* look for the resource table */
+	table = rproc_find_rsc_table(rproc, fw->data, fw->size, &tablesz);
+	if (!table)
+		return;
+
+	/* look for virtio devices and register them */
+	rproc_handle_virtio_rsc(rproc, table, tablesz);
+}
+
 /*
- * take a firmware and look for virtio devices to register.
+ * take a requested firmware, cache it and look for virtio devices to
+ * register.
  *
  * Note: this function is called asynchronously upon registration of the
  * remote processor (so we must wait until it completes before we try
@@ -1658,21 +1908,16 @@ clean_up:
 static void rproc_fw_config_virtio(const struct firmware *fw, void *context)
 {
 	struct rproc *rproc = context;
-	struct resource_table *table;
-	int ret, tablesz;
 
 	if (rproc_fw_sanity_check(rproc, fw) < 0)
 		goto out;
 
-	/* look for the resource table */
-	table = rproc_find_rsc_table(rproc, fw->data, fw->size, &tablesz);
-	if (!table)
-		goto out;
+	/* the first boot can use the image too, don't request it again */
+	mutex_lock(&rproc->lock);
+	rproc_fw_image_store(rproc, fw);
+	mutex_unlock(&rproc->lock);
 
-	/* look for virtio devices and register them */
-	ret = rproc_handle_virtio_rsc(rproc, table, tablesz);
-	if (ret)
-		goto out;
+	rproc_config_virtio(rproc, fw);
 
 out:
 	if (fw)
@@ -1695,6 +1940,7 @@ out:
 int rproc_boot(struct rproc *rproc)
 {
 	const struct firmware *firmware_p;
+	struct rproc_fw_image *image;
 	struct device *dev;
 	int ret;
 
@@ -1733,6 +1979,14 @@ int rproc_boot(struct rproc *rproc)
 
 	dev_info(dev, "powering up %s\n", rproc->name);
 
+	/* use the cached image if we have one, it's already in memory */
+	image = rproc_fw_image_get(rproc);
+	if (image) {
+		ret = rproc_fw_boot(rproc, &image->fw);
+		rproc_fw_image_put(image);
+		goto downref_rproc;
+	}
+
 	/* load firmware */
 	ret = request_firmware(&firmware_p, rproc->firmware, dev);
 	if (ret < 0) {
@@ -1741,6 +1995,8 @@ int rproc_boot(struct rproc *rproc)
 	}
 
 	ret = rproc_fw_boot(rproc, firmware_p);
+	if (!ret)
+		rproc_fw_image_store(rproc, firmware_p);
 
 	release_firmware(firmware_p);
 
@@ -1863,6 +2119,8 @@ void rproc_release(struct kref *kref)
 
 	rproc_delete_debug_dir(rproc);
 
+	rproc_fw_image_flush(rproc);
+
 	/*
 	 * At this point no one holds a reference to rproc anymore,
 	 * so we can directly unroll rproc_alloc()
@@ -1909,12 +2167,23 @@ static struct rproc *next_rproc(struct klist_iter *i)
 static int _reset_all_vdev(struct rproc *rproc)
 {
 	struct rproc_vdev *rvdev, *rvtmp;
+	struct rproc_fw_image *image;
 
 	dev_dbg(&rproc->dev, "reseting virtio devices for %s\n", rproc->name);
 	/* clean up remote vdev entries */
 	list_for_each_entry_safe(rvdev, rvtmp, &rproc->rvdevs, node)
 		rproc_remove_virtio_dev(rvdev);
 
+	/* with a cached image the vdevs can be created again right away */
+	mutex_lock(&rproc->lock);
+	image = rproc_fw_image_get(rproc);
+	mutex_unlock(&rproc->lock);
+	if (image) {
+		rproc_config_virtio(rproc, &image->fw);
+		rproc_fw_image_put(image);
+		return 0;
+	}
+
 	/* run rproc_fw_config_virtio to create vdevs again */
 	return request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG,
 			rproc->firmware, &rproc->dev, GFP_KERNEL,
@@ -2256,6 +2525,10 @@ struct rproc *rproc_alloc(struct device *dev, const char *name,
 
 	mutex_init(&rproc->lock);
 
+	spin_lock_init(&rproc->pm.lock);
+	rproc->pm.break_even_ms = DEFAULT_PM_BREAK_EVEN_MS;
+	rproc->pm.adaptive = 1;
+
 	idr_init(&rproc->notifyids);
 
 	INIT_LIST_HEAD(&rproc->carveouts);
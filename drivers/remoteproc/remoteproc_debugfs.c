@@ -28,9 +28,15 @@
 #include <linux/debugfs.h>
 #include <linux/remoteproc.h>
 #include <linux/device.h>
+#include <linux/delay.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
 #include "remoteproc_internal.h"
 #include <linux/uaccess.h>
 
+/* how often a blocked reader of a sequenced trace checks for new data */
+#define RPROC_TRACE_POLL_MS	20
+
 /* remoteproc debugfs parent dir */
 static struct dentry *rproc_dbg;
 
@@ -58,6 +64,126 @@ static const struct file_operations trace_rproc_ops = {
 	.llseek = generic_file_llseek,
 };
 
+/**
+ * struct rproc_trace_reader - an open sequenced trace buffer
+ * @trace: the trace buffer
+ * @seq: position of the reader in the remote processor's log
+ * @live: the remote processor may still write, wait for it to
+ */
+struct rproc_trace_reader {
+	struct rproc_mem_entry *trace;
+	u32 seq;
+	bool live;
+};
+
+static int rproc_trace_seq_open(struct inode *inode, struct file *filp,
+								bool live)
+{
+	struct rproc_mem_entry *trace = inode->i_private;
+	struct fw_trace_hdr *hdr = trace->va;
+	u32 ring = trace->len - sizeof(*hdr);
+	struct rproc_trace_reader *reader;
+	u32 wr;
+
+	reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+	if (!reader)
+		return -ENOMEM;
+
+	/* start with what the ring still holds */
+	wr = ACCESS_ONCE(hdr->write_seq);
+	reader->seq = wr - min(wr, ring);
+	reader->trace = trace;
+	reader->live = live;
+
+	filp->private_data = reader;
+	return nonseekable_open(inode, filp);
+}
+
+static int rproc_trace_stream_open(struct inode *inode, struct file *filp)
+{
+	return rproc_trace_seq_open(inode, filp, true);
+}
+
+static int rproc_trace_snapshot_open(struct inode *inode, struct file *filp)
+{
+	return rproc_trace_seq_open(inode, filp, false);
+}
+
+static int rproc_trace_seq_release(struct inode *inode, struct file *filp)
+{
+	kfree(filp->private_data);
+	return 0;
+}
+
+/*
+ * Copy the log from the reader's position on. There is no notification
+ * when the remote processor writes, so a live reader sleeps and checks
+ * again until there is something to return.
+ */
+static ssize_t rproc_trace_seq_read(struct file *filp, char __user *userbuf,
+						size_t count, loff_t *ppos)
+{
+	struct rproc_trace_reader *reader = filp->private_data;
+	struct fw_trace_hdr *hdr = reader->trace->va;
+	u32 ring = reader->trace->len - sizeof(*hdr);
+	u32 wr, avail, off, first;
+	char msg[48];
+	size_t n;
+
+	for (;;) {
+		wr = ACCESS_ONCE(hdr->write_seq);
+		if (wr != reader->seq)
+			break;
+		if (!reader->live)
+			return 0;
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		msleep_interruptible(RPROC_TRACE_POLL_MS);
+		if (signal_pending(current))
+			return -ERESTARTSYS;
+	}
+	/* read the log only after seeing the counter covering it */
+	rmb();
+
+	avail = wr - reader->seq;
+	if (avail > ring) {
+		/* the remote processor lapped us, say so and skip ahead */
+		n = scnprintf(msg, sizeof(msg), "\n*** %u trace bytes lost ***\n",
+							avail - ring);
+		n = min(n, count);
+		if (copy_to_user(userbuf, msg, n))
+			return -EFAULT;
+		reader->seq = wr - ring;
+		return n;
+	}
+
+	n = min_t(size_t, avail, count);
+	off = reader->seq & (ring - 1);
+	first = min_t(u32, n, ring - off);
+	if (copy_to_user(userbuf, hdr->data + off, first) ||
+	    copy_to_user(userbuf + first, hdr->data, n - first))
+		return -EFAULT;
+
+	/* anything overwritten meanwhile is reported on the next read */
+	reader->seq += n;
+	*ppos += n;
+	return n;
+}
+
+static const struct file_operations trace_stream_ops = {
+	.read = rproc_trace_seq_read,
+	.open = rproc_trace_stream_open,
+	.release = rproc_trace_seq_release,
+	.llseek = no_llseek,
+};
+
+static const struct file_operations trace_snapshot_ops = {
+	.read = rproc_trace_seq_read,
+	.open = rproc_trace_snapshot_open,
+	.release = rproc_trace_seq_release,
+	.llseek = no_llseek,
+};
+
 /*
  * A state-to-string lookup table, for exposing a human readable state
  * via debugfs. Always keep in sync with enum rproc_state
@@ -175,18 +301,121 @@ static const struct file_operations rproc_recovery_ops = {
 	.llseek = generic_file_llseek,
 };
 
+/* expose the cached firmware image via debugfs, write "flush" to drop it */
+static ssize_t rproc_fw_cache_read(struct file *filp, char __user *userbuf,
+						size_t count, loff_t *ppos)
+{
+	struct rproc *rproc = filp->private_data;
+	char buf[64];
+	int i;
+
+	mutex_lock(&rproc->lock);
+	if (rproc->fw_image)
+		i = scnprintf(buf, sizeof(buf), "%zu bytes, crc %08x\n",
+			      rproc->fw_image->fw.size, rproc->fw_image->crc);
+	else
+		i = scnprintf(buf, sizeof(buf), "none\n");
+	mutex_unlock(&rproc->lock);
+
+	return simple_read_from_buffer(userbuf, count, ppos, buf, i);
+}
+
+static ssize_t rproc_fw_cache_write(struct file *filp,
+		const char __user *user_buf, size_t count, loff_t *ppos)
+{
+	struct rproc *rproc = filp->private_data;
+	char buf[10];
+	int ret;
+
+	if (count > sizeof buf)
+		goto out;
+
+	ret = copy_from_user(buf, user_buf, count);
+	if (ret)
+		return ret;
+
+	/* remove end of line */
+	if (buf[count - 1] == '\n')
+		buf[count - 1] = '\0';
+
+	if (!strncmp(buf, "flush", count)) {
+		mutex_lock(&rproc->lock);
+		rproc_fw_image_flush(rproc);
+		mutex_unlock(&rproc->lock);
+	}
+
+out:
+	return count;
+}
+static const struct file_operations rproc_fw_cache_ops = {
+	.read = rproc_fw_cache_read,
+	.write = rproc_fw_cache_write,
+	.open = simple_open,
+	.llseek = generic_file_llseek,
+};
+
+/* expose the runtime pm activity and the autosuspend delay via debugfs */
+static ssize_t rproc_pm_stats_read(struct file *filp, char __user *userbuf,
+						size_t count, loff_t *ppos)
+{
+	struct rproc *rproc = filp->private_data;
+	struct rproc_pm_stats *pm = &rproc->pm;
+	u32 hist[RPROC_PM_HIST_BUCKETS];
+	unsigned long flags;
+	char buf[512];
+	int i, n;
+
+	spin_lock_irqsave(&pm->lock, flags);
+	memcpy(hist, pm->idle_hist, sizeof(hist));
+	spin_unlock_irqrestore(&pm->lock, flags);
+
+	n = scnprintf(buf, sizeof(buf), "delay: %d ms (%s, max %d ms)\n",
+		      pm->applied,
+		      pm->adaptive ? "adaptive" : "fixed",
+		      rproc->auto_suspend_timeout);
+	n += scnprintf(buf + n, sizeof(buf) - n,
+		       "suspends: %u, avg %llu us\n", pm->suspend_cnt,
+		       pm->suspend_cnt ?
+		       div_u64(pm->suspend_us, pm->suspend_cnt) : 0);
+	n += scnprintf(buf + n, sizeof(buf) - n,
+		       "resumes: %u, avg %llu us, last %u us\n", pm->resume_cnt,
+		       pm->resume_cnt ?
+		       div_u64(pm->resume_us, pm->resume_cnt) : 0,
+		       pm->last_resume_us);
+	n += scnprintf(buf + n, sizeof(buf) - n, "idle gaps: %u\n",
+		       pm->idle_total);
+	for (i = 0; i < RPROC_PM_HIST_BUCKETS; i++)
+		if (hist[i])
+			n += scnprintf(buf + n, sizeof(buf) - n,
+				       "  < %u ms: %u\n", 1 << i, hist[i]);
+
+	return simple_read_from_buffer(userbuf, count, ppos, buf, n);
+}
+
+static const struct file_operations rproc_pm_stats_ops = {
+	.read = rproc_pm_stats_read,
+	.open = simple_open,
+	.llseek = generic_file_llseek,
+};
+
 void rproc_remove_trace_file(struct dentry *tfile)
 {
 	debugfs_remove(tfile);
 }
 
 struct dentry *rproc_create_trace_file(const char *name, struct rproc *rproc,
-					struct rproc_mem_entry *trace)
+					struct rproc_mem_entry *trace,
+					bool live)
 {
+	const struct file_operations *fops = &trace_rproc_ops;
 	struct dentry *tfile;
 
+	/* sequenced buffers are streamed, or read up to the end if saved */
+	if (trace->flags & RPROC_TRACE_F_SEQ)
+		fops = live ? &trace_stream_ops : &trace_snapshot_ops;
+
 	tfile = debugfs_create_file(name, 0400, rproc->dbg_dir,
-						trace, &trace_rproc_ops);
+						trace, fops);
 	if (!tfile) {
 		dev_err(&rproc->dev, "failed to create debugfs trace entry\n");
 		return NULL;
@@ -222,6 +451,16 @@ void rproc_create_debug_dir(struct rproc *rproc)
 					rproc, &rproc_recovery_ops);
 	debugfs_create_file("version", 0400, rproc->dbg_dir,
 					rproc, &rproc_version_ops);
+	debugfs_create_u32("rx_coalesce_us", 0600, rproc->dbg_dir,
+					&rproc->rx_coalesce_us);
+	debugfs_create_file("fw_cache", 0600, rproc->dbg_dir,
+					rproc, &rproc_fw_cache_ops);
+	debugfs_create_file("pm_stats", 0400, rproc->dbg_dir,
+					rproc, &rproc_pm_stats_ops);
+	debugfs_create_bool("pm_adaptive", 0600, rproc->dbg_dir,
+					&rproc->pm.adaptive);
+	debugfs_create_u32("pm_break_even_ms", 0600, rproc->dbg_dir,
+					&rproc->pm.break_even_ms);
 }
 
 void __init rproc_init_debugfs(void)
@@ -21,13 +21,32 @@
 #define REMOTEPROC_INTERNAL_H
 
 #include <linux/irqreturn.h>
+#include <linux/firmware.h>
+#include <linux/kref.h>
 
 struct rproc;
 
+/**
+ * struct rproc_fw_image - a firmware image kept in memory for later boots
+ * @refcount: users of the image, the rproc holds one while it's cached
+ * @crc: crc32 of the image, taken when it was cached
+ * @fw: the image, in the form rproc_fw_boot() expects it
+ * @data: the image contents
+ */
+struct rproc_fw_image {
+	struct kref refcount;
+	u32 crc;
+	struct firmware fw;
+	u8 data[0];
+};
+
 /* from remoteproc_core.c */
 void rproc_release(struct kref *kref);
 irqreturn_t rproc_vq_interrupt(struct rproc *rproc, int vq_id);
 void rproc_recover(struct rproc *rproc);
+void rproc_fw_image_flush(struct rproc *rproc);
+void rproc_pm_mark_busy(struct rproc *rproc);
+void rproc_pm_update_delay(struct rproc *rproc);
 
 /* from remoteproc_virtio.c */
 int rproc_add_virtio_dev(struct rproc_vdev *rvdev, int id);
@@ -36,7 +55,8 @@ void rproc_remove_virtio_dev(struct rproc_vdev *rvdev);
 /* from remoteproc_debugfs.c */
 void rproc_remove_trace_file(struct dentry *tfile);
 struct dentry *rproc_create_trace_file(const char *name, struct rproc *rproc,
-					struct rproc_mem_entry *trace);
+					struct rproc_mem_entry *trace,
+					bool live);
 void rproc_delete_debug_dir(struct rproc *rproc);
 void rproc_create_debug_dir(struct rproc *rproc);
 void rproc_init_debugfs(void);
@@ -57,6 +57,8 @@ static void rproc_virtio_notify(struct virtqueue *vq)
 	if (ret < 0)
 		rproc->need_resume = true;
 	rproc->ops->kick(rproc, notifyid);
+	rproc_pm_mark_busy(rproc);
+	rproc_pm_update_delay(rproc);
 	pm_runtime_mark_last_busy(dev);
 	pm_runtime_put_autosuspend(dev);
 	mutex_unlock(&rproc->lock);
@@ -88,6 +90,8 @@ irqreturn_t rproc_vq_interrupt(struct rproc *rproc, int notifyid)
 	if (!rvring || !rvring->vq)
 		return IRQ_NONE;
 
+	rproc_pm_mark_busy(rproc);
+
 	return vring_interrupt(0, rvring->vq);
 }
 EXPORT_SYMBOL(rproc_vq_interrupt);
@@ -238,6 +242,22 @@ static void rproc_virtio_finalize_features(struct virtio_device *vdev)
 	rvdev->gfeatures = vdev->features[0];
 }
 
+/* read from the config space the firmware published in its vdev entry */
+static void rproc_virtio_get(struct virtio_device *vdev, unsigned offset,
+							void *buf, unsigned len)
+{
+	struct rproc_vdev *rvdev = vdev_to_rvdev(vdev);
+
+	if (offset > rvdev->config_len || len > rvdev->config_len - offset) {
+		dev_err(&vdev->dev, "config read beyond %u bytes: %u@%u\n",
+					rvdev->config_len, len, offset);
+		memset(buf, 0, len);
+		return;
+	}
+
+	memcpy(buf, rvdev->config + offset, len);
+}
+
 static struct virtio_config_ops rproc_virtio_config_ops = {
 	.get_features	= rproc_virtio_get_features,
 	.finalize_features = rproc_virtio_finalize_features,
@@ -246,6 +266,7 @@ static struct virtio_config_ops rproc_virtio_config_ops = {
 	.reset		= rproc_virtio_reset,
 	.set_status	= rproc_virtio_set_status,
 	.get_status	= rproc_virtio_get_status,
+	.get		= rproc_virtio_get,
 };
 
 /*
@@ -263,6 +284,7 @@ static void rproc_vdev_release(struct device *dev)
 	struct rproc *rproc = vdev_to_rproc(vdev);
 
 	list_del(&rvdev->node);
+	kfree(rvdev->config);
 	kfree(rvdev);
 
 	kref_put(&rproc->refcount, rproc_release);
@@ -51,11 +51,22 @@ struct rprm_regulator_depot {
 	u32 orig_uv;
 };
 
-/* device handle for resources which use the generic apis */
+/*
+ * device handle for resources which use the generic apis, constraints go
+ * through the resmgr aggregators so repeated or toggling requests do not
+ * reach the DVFS and pm_qos layers every time
+ */
 struct rprm_gen_device_handle {
 	struct device *dev;
+	struct device *rdev;
 	struct dev_pm_qos_request req;
 	struct pm_qos_request bw_req;
+	struct rprm_qos scale;
+	struct rprm_qos lat;
+	struct rprm_qos bw;
+	struct rprm_qos_req scale_req;
+	struct rprm_qos_req lat_req;
+	struct rprm_qos_req bw_req_val;
 };
 
 /* pointer to the constraint ops exported by omap mach module */
@@ -470,6 +481,30 @@ static int rprm_regulator_get_info(void *handle, char *buf, size_t len)
 		rd->oreg->name, reg->min_uv, reg->max_uv, rd->orig_uv);
 }
 
+static int _device_scale_apply(struct rprm_qos *qos, long val)
+{
+	struct rprm_gen_device_handle *obj = qos->data;
+
+	return mach_ops->device_scale(obj->rdev, obj->dev, val);
+}
+
+static int _device_latency_apply(struct rprm_qos *qos, long val)
+{
+	struct rprm_gen_device_handle *obj = qos->data;
+	int ret = dev_pm_qos_update_request(&obj->req, val);
+
+	return ret -= ret == 1;
+}
+
+static int _device_bandwidth_apply(struct rprm_qos *qos, long val)
+{
+	struct rprm_gen_device_handle *obj = qos->data;
+
+	pm_qos_update_request(&obj->bw_req, val);
+
+	return 0;
+}
+
 static int
 _enable_device_exclusive(void **handle, struct device **pdev, const char *name)
 {
@@ -517,6 +552,15 @@ _enable_device_exclusive(void **handle, struct device **pdev, const char *name)
 	}
 
 	rprm_handle->dev = dev;
+	rprm_qos_init(&rprm_handle->scale, RPRM_SCALE, _device_scale_apply,
+		      rprm_handle);
+	rprm_qos_init(&rprm_handle->lat, RPRM_LATENCY, _device_latency_apply,
+		      rprm_handle);
+	rprm_qos_init(&rprm_handle->bw, RPRM_BANDWIDTH,
+		      _device_bandwidth_apply, rprm_handle);
+	rprm_qos_req_init(&rprm_handle->scale_req);
+	rprm_qos_req_init(&rprm_handle->lat_req);
+	rprm_qos_req_init(&rprm_handle->bw_req_val);
 	*handle = rprm_handle;
 
 	return 0;
@@ -534,6 +578,10 @@ static int _device_release(void *handle)
 	struct rprm_gen_device_handle *obj = handle;
 	struct device *dev = obj->dev;
 
+	/* flush deferred relaxations before the requests go away */
+	rprm_qos_exit(&obj->scale);
+	rprm_qos_exit(&obj->lat);
+	rprm_qos_exit(&obj->bw);
 	dev_pm_qos_remove_request(&obj->req);
 	pm_qos_remove_request(&obj->bw_req);
 	kfree(obj);
@@ -548,15 +596,15 @@ static int _device_scale(struct device *rdev, void *handle, unsigned long val)
 	if (!mach_ops || !mach_ops->device_scale)
 		return -ENOSYS;
 
-	return mach_ops->device_scale(rdev, obj->dev, val);
+	obj->rdev = rdev;
+	return rprm_qos_update(&obj->scale, &obj->scale_req, val);
 }
 
 static int _device_latency(struct device *rdev, void *handle, unsigned long val)
 {
 	struct rprm_gen_device_handle *obj = handle;
-	int ret = dev_pm_qos_update_request(&obj->req, val);
 
-	return ret -= ret == 1;
+	return rprm_qos_update(&obj->lat, &obj->lat_req, val);
 }
 
 static int _device_bandwidth(struct device *rdev, void *handle,
@@ -564,9 +612,7 @@ static int _device_bandwidth(struct device *rdev, void *handle,
 {
 	struct rprm_gen_device_handle *obj = handle;
 
-	pm_qos_update_request(&obj->bw_req, val);
-
-	return 0;
+	return rprm_qos_update(&obj->bw, &obj->bw_req_val, val);
 }
 
 static unsigned long _get_max_freq(void *handle)
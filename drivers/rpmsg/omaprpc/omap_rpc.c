@@ -16,6 +16,8 @@
  * this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/sort.h>
+
 #include "omap_rpc_internal.h"
 
 static struct class *omaprpc_class;
@@ -443,6 +445,7 @@ static int omaprpc_open(struct inode *inode, struct file *filp)
 {
 	struct omaprpc_service_t *rpcserv;
 	struct omaprpc_instance_t *rpc;
+	int i;
 
 	/* get the service pointer out of the inode */
 	rpcserv = container_of(inode->i_cdev, struct omaprpc_service_t, cdev);
@@ -481,9 +484,10 @@ static int omaprpc_open(struct inode *inode, struct file *filp)
 	/* Initialize the remember function call list */
 	INIT_LIST_HEAD(&rpc->fxn_list);
 
-#if defined(OMAPRPC_USE_DMABUF)
-	INIT_LIST_HEAD(&rpc->dma_list);
-#endif
+	/* Initialize the buffer translation cache */
+	for (i = 0; i < ARRAY_SIZE(rpc->xlate_hash); i++)
+		INIT_HLIST_HEAD(&rpc->xlate_hash[i]);
+	rpc->xlate_count = 0;
 
 	/*
 	 * assign a new, unique, local address and
@@ -585,6 +589,9 @@ static int omaprpc_release(struct inode *inode, struct file *filp)
 			rpc->ept = NULL;
 		}
 	}
+	/* Release the buffers the translation cache holds on to */
+	omaprpc_xlate_cache_clear(rpc);
+
 #if defined(OMAPRPC_USE_ION)
 	if (rpc->ion_client) {
 		/* Destroy our local client to ion */
@@ -747,6 +754,71 @@ failure:
 	return ret;
 }
 
+static int omaprpc_xlate_cmp(const void *a, const void *b)
+{
+	const struct omaprpc_param_translation_t *x = a, *y = b;
+
+	if (x->index != y->index)
+		return x->index < y->index ? -1 : 1;
+	if (x->offset != y->offset)
+		return x->offset < y->offset ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Check all the translations of a call up front, so the backends don't
+ * have to unwind half done work on bad input, and group them by buffer
+ * in ascending offsets so each buffer (and page) only has to be mapped
+ * once while translating.
+ */
+static int omaprpc_xlate_prepare(struct omaprpc_instance_t *rpc,
+				 struct omaprpc_call_function_t *function)
+{
+	struct omaprpc_param_translation_t *xlate;
+	struct omaprpc_param_t *param;
+	uint32_t idx;
+
+	for (idx = 0; idx < function->num_translations; idx++) {
+		xlate = &function->translations[idx];
+
+		/* if the pointer index for this translation is invalid */
+		if (xlate->index >= OMAPRPC_MAX_PARAMETERS) {
+			OMAPRPC_ERR(rpc->rpcserv->dev,
+				    "Invalid parameter pointer index %u\n",
+				    xlate->index);
+			return -EINVAL;
+		}
+
+		param = &function->params[xlate->index];
+		if (param->type != OMAPRPC_PARAM_TYPE_PTR) {
+			OMAPRPC_ERR(rpc->rpcserv->dev,
+				    "Parameter index %u is not a pointer "
+				    "(type %u)\n", xlate->index, param->type);
+			return -EINVAL;
+		}
+
+		if (xlate->offset < 0 ||
+		    xlate->offset >= (param->size - sizeof(virt_addr_t))) {
+			OMAPRPC_ERR(rpc->rpcserv->dev,
+				    "Offset is larger than data area! "
+				    "(offset=%d size=%zu)\n", (int)xlate->offset,
+				    param->size);
+			return -EINVAL;
+		}
+
+		if (param->data == 0) {
+			OMAPRPC_ERR(rpc->rpcserv->dev,
+				    "Supplied user pointer is NULL!\n");
+			return -EINVAL;
+		}
+	}
+
+	sort(function->translations, function->num_translations,
+	     sizeof(*xlate), omaprpc_xlate_cmp, NULL);
+
+	return 0;
+}
+
 static ssize_t omaprpc_write(struct file *filp,
 			     const char __user *ubuf,
 			     size_t len, loff_t *offp)
@@ -858,9 +930,19 @@ static ssize_t omaprpc_write(struct file *filp,
 
 	/* If there are pointers to translate for the user, do so now */
 	if (function->num_translations > 0) {
+		ktime_t xlate_start = ktime_get();
+
+		ret = omaprpc_xlate_prepare(rpc, function);
+		if (ret < 0)
+			goto failure;
+
 		/* alter our copy of function and the user's parameters so
 		   that we can send to remote cores */
 		ret = omaprpc_xlate_buffers(rpc, function, OMAPRPC_UVA_TO_RPA);
+		OMAPRPC_PRINT(OMAPRPC_ZONE_PERF, rpcserv->dev,
+			      "translating %u pointers took %lld usec\n",
+			      function->num_translations,
+			      ktime_us_delta(ktime_get(), xlate_start));
 		if (ret < 0) {
 			OMAPRPC_ERR(rpcserv->dev,
 				    "OMAPRPC: ERROR: Failed to translate all "
@@ -140,6 +140,10 @@ struct omaprpc_call_function_list_t {
 	u16 msgId;
 };
 
+/* buffer translations are cached per instance, hashed on buffer identity */
+#define OMAPRPC_XLATE_HASH_BITS	(5)
+#define OMAPRPC_XLATE_MAX	(64)
+
 /**
  * struct omaprpc_instance_t - The per-instance data structure (per user).
  */
@@ -157,9 +161,9 @@ struct omaprpc_instance_t {
 	u32 core;
 #if defined(OMAPRPC_USE_ION)
 	struct ion_client *ion_client;
-#elif defined(OMAPRPC_USE_DMABUF)
-	struct list_head dma_list;
 #endif
+	struct hlist_head xlate_hash[1 << OMAPRPC_XLATE_HASH_BITS];
+	u32 xlate_count;
 	u16 msgId;
 	struct list_head fxn_list;
 };
@@ -170,11 +174,22 @@ struct omaprpc_instance_t {
  * variables.
  */
 struct dma_info_t {
-	struct list_head list;
-	int fd;
+	struct hlist_node node;
 	struct dma_buf *dbuf;
 	struct dma_buf_attachment *attach;
 	struct sg_table *sgt;
+	phys_addr_t pa;
+};
+#elif defined(OMAPRPC_USE_ION)
+/**
+ * struct ion_info_t - A shared ION buffer imported into the instance's
+ * client, and its local physical address.
+ */
+struct ion_info_t {
+	struct hlist_node node;
+	struct ion_buffer *buffer;
+	struct ion_handle *handle;
+	phys_addr_t pa;
 };
 #endif
 
@@ -192,7 +207,8 @@ phys_addr_t rpmsg_local_to_remote_pa(uint32_t core, phys_addr_t pa);
 
 /*!
  * This function translates all the pointers within the function call
- * structure and the translation structures.
+ * structure and the translation structures. The translations must have been
+ * validated and sorted by parameter by omaprpc_xlate_prepare() first.
  */
 int omaprpc_xlate_buffers(struct omaprpc_instance_t *rpc,
 			  struct omaprpc_call_function_t *function,
@@ -212,4 +228,10 @@ phys_addr_t omaprpc_buffer_lookup(struct omaprpc_instance_t *rpc,
  */
 long omaprpc_recalc_off(phys_addr_t lpa, long uoff);
 
+/*!
+ * Drops the instance's cached buffer translations, and the references the
+ * cache holds on the buffers.
+ */
+void omaprpc_xlate_cache_clear(struct omaprpc_instance_t *rpc);
+
 #endif
@@ -16,8 +16,108 @@
  * this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <linux/hash.h>
+
 #include "omap_rpc_internal.h"
 
+static struct hlist_head *omaprpc_ion_bucket(struct omaprpc_instance_t *rpc,
+					     struct ion_buffer *buffer)
+{
+	return &rpc->xlate_hash[hash_ptr(buffer, OMAPRPC_XLATE_HASH_BITS)];
+}
+
+/* must be called with rpc->lock held */
+static void omaprpc_ion_cache_flush(struct omaprpc_instance_t *rpc)
+{
+	struct ion_info_t *pos;
+	struct hlist_node *node, *n;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(rpc->xlate_hash); i++) {
+		hlist_for_each_entry_safe(pos, node, n, &rpc->xlate_hash[i],
+					  node) {
+			hlist_del(&pos->node);
+			ion_free(rpc->ion_client, pos->handle);
+			kfree(pos);
+		}
+	}
+	rpc->xlate_count = 0;
+}
+
+void omaprpc_xlate_cache_clear(struct omaprpc_instance_t *rpc)
+{
+	mutex_lock(&rpc->lock);
+	omaprpc_ion_cache_flush(rpc);
+	mutex_unlock(&rpc->lock);
+}
+
+/*
+ * Resolve a shared fd (e.g. a PVR buffer wrapping an ion buffer) to its
+ * physical address. The imported handle is kept per ion buffer so repeated
+ * calls with the same buffer don't import and leak a handle each time.
+ */
+static int omaprpc_ion_fd_lookup(struct omaprpc_instance_t *rpc, int fd,
+				 phys_addr_t *pa)
+{
+	struct ion_buffer *ion_buffer = NULL;
+	struct ion_info_t *info;
+	struct hlist_node *node;
+	struct ion_handle *handle;
+	ion_phys_addr_t paddr;
+	size_t unused;
+	int num_handles = 1;
+
+	/*
+	 * TODO: need to support 2 ion handles
+	 * per 1 pvr handle (NV12 case)
+	 */
+	if (omap_ion_share_fd_to_buffers(fd, &ion_buffer, &num_handles) < 0 ||
+	    !ion_buffer)
+		return -EINVAL;
+
+	mutex_lock(&rpc->lock);
+	hlist_for_each_entry(info, node, omaprpc_ion_bucket(rpc, ion_buffer),
+			     node) {
+		if (info->buffer == ion_buffer) {
+			*pa = info->pa;
+			mutex_unlock(&rpc->lock);
+			return 0;
+		}
+	}
+	mutex_unlock(&rpc->lock);
+
+	handle = ion_import(rpc->ion_client, ion_buffer);
+	if (IS_ERR_OR_NULL(handle))
+		return -EINVAL;
+	if (ion_phys(rpc->ion_client, handle, &paddr, &unused))
+		goto free_handle;
+
+	info = kmalloc(sizeof(*info), GFP_KERNEL);
+	if (!info)
+		goto free_handle;
+	info->buffer = ion_buffer;
+	info->handle = handle;
+	info->pa = (phys_addr_t)paddr;
+
+	/*
+	 * the cache holds a handle on every buffer it saw, so bound it: once
+	 * it is full start over, the buffers in use get imported again
+	 */
+	mutex_lock(&rpc->lock);
+	if (rpc->xlate_count >= OMAPRPC_XLATE_MAX)
+		omaprpc_ion_cache_flush(rpc);
+	hlist_add_head(&info->node, omaprpc_ion_bucket(rpc, ion_buffer));
+	rpc->xlate_count++;
+	mutex_unlock(&rpc->lock);
+
+	*pa = info->pa;
+	return 0;
+
+free_handle:
+	ion_free(rpc->ion_client, handle);
+	return -EINVAL;
+}
+
 static uint8_t *omaprpc_map_parameter(struct omaprpc_instance_t *rpc,
 				       struct omaprpc_param_t *param)
 {
@@ -100,43 +200,15 @@ phys_addr_t omaprpc_buffer_lookup(struct omaprpc_instance_t *rpc,
 			goto to_va;
 		} else {
 			/* is it an pvr buffer wrapping an ion handle? */
-
-			/*
-			 * TODO: need to support 2 ion handles
-			 * per 1 pvr handle (NV12 case)
-			 */
-			struct ion_buffer *ion_buffer = NULL;
-			int num_handles = 1;
-			handle = NULL;
-			if (omap_ion_share_fd_to_buffers((int)reserved,
-							 &ion_buffer,
-							 &num_handles) < 0) {
-				goto to_va;
-			}
-			if (ion_buffer) {
-				handle = ion_import(rpc->ion_client,
-						    ion_buffer);
-			}
-			if (handle && !ion_phys(rpc->ion_client, handle,
-						&paddr, &unused)) {
-				lpa = (phys_addr_t) paddr;
-				OMAPRPC_PRINT(OMAPRPC_ZONE_INFO,
-					      rpc->rpcserv->dev,
-					      "FD %d is an PVR Handle to ARM PA %p "
-					      "(Uoff=%ld)\n", (int)reserved,
-					      (void *)lpa, uoff);
-				uoff = omaprpc_recalc_off(lpa, uoff);
-				lpa += uoff;
+			if (omaprpc_ion_fd_lookup(rpc, (int)reserved, &lpa))
 				goto to_va;
-			}
-			/*
-			 * TODO: need to do some buffer tracking and call
-			 * ion_free when it is no longer being used. this
-			 * will make sure the buffer is not freed while
-			 * we are still using it
-			 */
-			if (handle)
-				ion_free(rpc->ion_client, handle);
+			OMAPRPC_PRINT(OMAPRPC_ZONE_INFO, rpc->rpcserv->dev,
+				      "FD %d is an PVR Handle to ARM PA %p "
+				      "(Uoff=%ld)\n", (int)reserved,
+				      (void *)lpa, uoff);
+			uoff = omaprpc_recalc_off(lpa, uoff);
+			lpa += uoff;
+			goto to_va;
 		}
 	}
 
@@ -155,7 +227,7 @@ int omaprpc_xlate_buffers(struct omaprpc_instance_t *rpc,
 			  int direction)
 {
 	int idx = 0, start = 0, inc = 1, limit = 0, ret = 0;
-	uint32_t ptr_idx = 0, offset = 0, size = 0;
+	uint32_t ptr_idx = 0, offset = 0;
 	/* not all the parameters are pointers so this may be sparse */
 	uint8_t *base_ptrs[OMAPRPC_MAX_PARAMETERS];
 
@@ -176,36 +248,7 @@ restart:
 		ptr_idx = function->translations[idx].index;
 		offset = function->translations[idx].offset;
 
-		/* if the pointer index for this translation is invalid */
-		if (ptr_idx >= OMAPRPC_MAX_PARAMETERS) {
-			OMAPRPC_ERR(rpc->rpcserv->dev,
-				    "Invalid parameter pointer index %u\n",
-				    ptr_idx);
-			goto unwind;
-		} else if (function->params[ptr_idx].type !=
-			   OMAPRPC_PARAM_TYPE_PTR) {
-			OMAPRPC_ERR(rpc->rpcserv->dev,
-				    "Parameter index %u is not a pointer (type %u)"
-				    "\n", ptr_idx,
-				    function->params[ptr_idx].type);
-			goto unwind;
-		}
-
-		size = function->params[ptr_idx].size;
-
-		if (offset >= (size - sizeof(virt_addr_t))) {
-			OMAPRPC_ERR(rpc->rpcserv->dev,
-				    "Offset is larger than data area! "
-				    "(offset=%u size=%u)\n", offset, size);
-			goto unwind;
-		}
-
-		if (function->params[ptr_idx].data == 0) {
-			OMAPRPC_ERR(rpc->rpcserv->dev,
-				    "Supplied user pointer is NULL!\n");
-			goto unwind;
-		}
-
+		/* the translations were validated by omaprpc_xlate_prepare */
 		/* if the KVA pointer has not been mapped */
 		if (base_ptrs[ptr_idx] == NULL) {
 			/*
@@ -321,11 +364,6 @@ restart:
 			OMAPRPC_ERR(rpc->rpcserv->dev,
 				    "Failed to map UVA to KVA to do translation!"
 				    "\n");
-			/*
-			 * we can arrive here from multiple points,
-			 * but the action is the same from everywhere
-			 */
-unwind:
 			if (direction == OMAPRPC_UVA_TO_RPA) {
 				/*
 				 * we've encountered an error which
@@ -40,11 +40,15 @@
 
 #ifdef CONFIG_DMA_SHARED_BUFFER
 #include <linux/dma-buf.h>
+#include <linux/hash.h>
 #endif
 
 /* maximum OMX devices this driver can handle */
 #define MAX_OMX_DEVICES		8
 
+/* pinned buffers are hashed by dma_buf, in 1 << OMX_DMA_HASH_BITS buckets */
+#define OMX_DMA_HASH_BITS	5
+
 enum rpc_omx_map_info_type {
 	RPC_OMX_MAP_INFO_NONE          = 0,
 	RPC_OMX_MAP_INFO_ONE_BUF       = 1,
@@ -74,15 +78,22 @@ struct rpmsg_omx_instance {
 	u32 dst;
 	int state;
 #ifdef CONFIG_DMA_SHARED_BUFFER
-	struct idr dma_idr;
+	struct hlist_head dma_hash[1 << OMX_DMA_HASH_BITS];
 #endif
 };
 
 #ifdef CONFIG_DMA_SHARED_BUFFER
+/*
+ * A pinned buffer, with its device address translated once at pin time.
+ * Keyed on the dma_buf itself, so dup'ed or recycled fds can't alias.
+ */
 struct rpmsg_omx_dma_info {
+	struct hlist_node node;
 	struct dma_buf *dbuf;
 	struct dma_buf_attachment *attach;
 	struct sg_table *sgt;
+	u32 da;
+	int pins;
 };
 #endif
 
@@ -119,30 +130,97 @@ static int _rpmsg_pa_to_da(struct rpmsg_omx_instance *omx, u32 pa, u32 *da)
 }
 
 #ifdef CONFIG_DMA_SHARED_BUFFER
+static struct hlist_head *
+rpmsg_omx_dma_bucket(struct rpmsg_omx_instance *omx, struct dma_buf *dbuf)
+{
+	return &omx->dma_hash[hash_ptr(dbuf, OMX_DMA_HASH_BITS)];
+}
+
+/* must be called with omx->lock held */
+static struct rpmsg_omx_dma_info *
+rpmsg_omx_dma_find(struct rpmsg_omx_instance *omx, struct dma_buf *dbuf)
+{
+	struct rpmsg_omx_dma_info *dma;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(dma, pos, rpmsg_omx_dma_bucket(omx, dbuf), node)
+		if (dma->dbuf == dbuf)
+			return dma;
+
+	return NULL;
+}
+
+static void rpmsg_omx_remove_dma_buffer(struct rpmsg_omx_instance *omx,
+				struct rpmsg_omx_dma_info *dma)
+{
+	struct device *dev = omx->omxserv->dev;
+
+	dev_dbg(dev, "unpining with dbuf=%p\n", dma->dbuf);
+
+	hlist_del(&dma->node);
+	dma_buf_unmap_attachment(dma->attach, dma->sgt, DMA_BIDIRECTIONAL);
+	dma_buf_detach(dma->dbuf, dma->attach);
+	dma_buf_put(dma->dbuf);
+	kfree(dma);
+}
+
+/*
+ * Drop pinned buffers that nobody but us holds anymore: user space has
+ * released them, so they can't be referenced again. Called with omx->lock.
+ */
+static void rpmsg_omx_dma_prune(struct rpmsg_omx_instance *omx)
+{
+	struct rpmsg_omx_dma_info *dma;
+	struct hlist_node *pos, *n;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(omx->dma_hash); i++)
+		hlist_for_each_entry_safe(dma, pos, n, &omx->dma_hash[i], node)
+			if (file_count(dma->dbuf->file) == 1)
+				rpmsg_omx_remove_dma_buffer(omx, dma);
+}
+
 /*
  * Proudly inspired by the OMAP RPC code (omaprpc_dmabuf.c) by Hervé Fache
  */
 static int rpmsg_omx_pin_buffer(struct rpmsg_omx_instance *omx, int fd)
 {
 	struct rpmsg_omx_service *omxserv = omx->omxserv;
-	struct rpmsg_omx_dma_info *dma = kmalloc(sizeof *dma, GFP_KERNEL);
-	int id;
+	struct rpmsg_omx_dma_info *dma;
+	struct dma_buf *dbuf;
+	phys_addr_t pa;
 	int ret;
 
-	if (!dma)
-		return -ENOMEM;
-
-	dma->dbuf = dma_buf_get(fd);
-	dev_dbg(omxserv->dev, "pining with fd=%u/dbuf=%p\n", fd, dma->dbuf);
-	if (IS_ERR(dma->dbuf)) {
-		ret = PTR_ERR(dma->dbuf);
+	dbuf = dma_buf_get(fd);
+	dev_dbg(omxserv->dev, "pining with fd=%u/dbuf=%p\n", fd, dbuf);
+	if (IS_ERR(dbuf)) {
+		ret = PTR_ERR(dbuf);
 		goto err;
 	}
 
+	/* the same buffer might already be pinned, through another fd */
+	mutex_lock(&omx->lock);
+	dma = rpmsg_omx_dma_find(omx, dbuf);
+	if (dma)
+		dma->pins++;
+	mutex_unlock(&omx->lock);
+	if (dma) {
+		dma_buf_put(dbuf);
+		return 0;
+	}
+
+	dma = kzalloc(sizeof(*dma), GFP_KERNEL);
+	if (!dma) {
+		ret = -ENOMEM;
+		goto err_buf_put;
+	}
+	dma->dbuf = dbuf;
+	dma->pins = 1;
+
 	dma->attach = dma_buf_attach(dma->dbuf, omxserv->dev);
 	if (IS_ERR(dma->attach)) {
 		ret = PTR_ERR(dma->attach);
-		goto err_buf_put;
+		goto err_free;
 	}
 
 	dma->sgt = dma_buf_map_attachment(dma->attach, DMA_BIDIRECTIONAL);
@@ -151,86 +229,76 @@ static int rpmsg_omx_pin_buffer(struct rpmsg_omx_instance *omx, int fd)
 		goto err_detach;
 	}
 
-	if (!idr_pre_get(&omx->dma_idr, GFP_KERNEL)) {
-		ret = -ENOMEM;
+	/* translate once, every message carrying the buffer reuses it */
+	pa = sg_dma_address(dma->sgt->sgl) + dma->sgt->sgl->offset;
+	ret = _rpmsg_pa_to_da(omx, pa, &dma->da);
+	if (ret)
 		goto err_unmap;
-	}
 
 	mutex_lock(&omx->lock);
-	ret = idr_get_new_above(&omx->dma_idr, dma, fd, &id);
+	rpmsg_omx_dma_prune(omx);
+	hlist_add_head(&dma->node, rpmsg_omx_dma_bucket(omx, dbuf));
 	mutex_unlock(&omx->lock);
-	if (ret)
-		goto err_unmap;
-
-	if (fd != id) {
-		ret = -EINVAL;
-		goto err_rem_idr;
-	}
 
 	return 0;
 
-err_rem_idr:
-	mutex_lock(&omx->lock);
-	idr_remove(&omx->dma_idr, id);
-	mutex_unlock(&omx->lock);
 err_unmap:
 	dma_buf_unmap_attachment(dma->attach, dma->sgt, DMA_BIDIRECTIONAL);
 err_detach:
 	dma_buf_detach(dma->dbuf, dma->attach);
+err_free:
+	kfree(dma);
 err_buf_put:
-	dma_buf_put(dma->dbuf);
+	dma_buf_put(dbuf);
 err:
-	kfree(dma);
 	dev_err(omxserv->dev, "error pining buffer %d\n", ret);
 
 	return ret;
 }
 
-static struct rpmsg_omx_dma_info *
-rpmsg_omx_dma_find(struct rpmsg_omx_instance *omx, int fd, phys_addr_t *pa)
+static int rpmsg_omx_unpin_buffer(struct rpmsg_omx_instance *omx, int fd)
 {
-	struct device *dev = omx->omxserv->dev;
 	struct rpmsg_omx_dma_info *dma;
-	struct dma_buf *dbuf = dma_buf_get(fd);
+	struct dma_buf *dbuf;
 
-	dev_dbg(dev, "looking for fd=%u/dbuf=%p\n", fd, dbuf);
+	dbuf = dma_buf_get(fd);
+	if (IS_ERR(dbuf))
+		return PTR_ERR(dbuf);
 
 	mutex_lock(&omx->lock);
-	dma = idr_find(&omx->dma_idr, fd);
+	dma = rpmsg_omx_dma_find(omx, dbuf);
+	if (dma && !--dma->pins)
+		rpmsg_omx_remove_dma_buffer(omx, dma);
 	mutex_unlock(&omx->lock);
-	if (dma)
-		*pa = sg_dma_address(dma->sgt->sgl) + dma->sgt->sgl->offset;
 
-	return dma;
+	dma_buf_put(dbuf);
+
+	return dma ? 0 : -EINVAL;
 }
 
-static int rpmsg_omx_remove_dma_buffer(struct rpmsg_omx_instance *omx,
-				struct rpmsg_omx_dma_info *dma)
+/* resolve a pinned buffer's fd to its device address */
+static int rpmsg_omx_dma_lookup(struct rpmsg_omx_instance *omx, int fd,
+								u32 *da)
 {
 	struct device *dev = omx->omxserv->dev;
+	struct rpmsg_omx_dma_info *dma;
+	struct dma_buf *dbuf;
 
-	dev_dbg(dev, "unpining with dbuf=%p\n", dma->dbuf);
-
-	dma_buf_unmap_attachment(dma->attach, dma->sgt, DMA_BIDIRECTIONAL);
-	dma_buf_detach(dma->dbuf, dma->attach);
-	dma_buf_put(dma->dbuf);
-	kfree(dma);
-
-	return 0;
-}
+	dbuf = dma_buf_get(fd);
+	if (IS_ERR(dbuf))
+		return PTR_ERR(dbuf);
 
-static int rpmsg_omx_unpin_buffer(struct rpmsg_omx_instance *omx, int fd)
-{
-	struct rpmsg_omx_dma_info *dma;
-	phys_addr_t pa;
+	dev_dbg(dev, "looking for fd=%u/dbuf=%p\n", fd, dbuf);
 
-	dma = rpmsg_omx_dma_find(omx, fd, &pa);
-	if (!dma)
-		return -EINVAL;
+	mutex_lock(&omx->lock);
+	dma = rpmsg_omx_dma_find(omx, dbuf);
+	if (dma)
+		*da = dma->da;
+	mutex_unlock(&omx->lock);
 
-	idr_remove(&omx->dma_idr, fd);
+	dma_buf_put(dbuf);
 
-	return rpmsg_omx_remove_dma_buffer(omx, dma);
+	return dma ? 0 : -ENOENT;
 }
 #endif
 
@@ -241,24 +309,21 @@ static int rpmsg_omx_unpin_buffer(struct rpmsg_omx_instance *omx, int fd)
  * takes care of that.)
  */
 static int _rpmsg_omx_buffer_get(struct rpmsg_omx_instance *omx,
-					long buffer, phys_addr_t *da)
+					long buffer, u32 *da)
 {
 	struct device *dev = omx->omxserv->dev;
 	int ret = -EIO;
-	phys_addr_t pa;
 
 #ifdef CONFIG_DMA_SHARED_BUFFER
 	{
 		int fd = buffer;
-		/* find the base of the dam buf from the list */
-		if (rpmsg_omx_dma_find(omx, fd, &pa))
-			ret = 0;
-		else
-			dev_err(dev, "error getting fd %d\n", fd);
+		/* find the pinned dma buf, already translated */
+		ret = rpmsg_omx_dma_lookup(omx, fd, da);
+		if (!ret)
+			return 0;
+		dev_err(dev, "error getting fd %d\n", fd);
 	}
 #endif
-	if (!ret)
-		return _rpmsg_pa_to_da(omx, pa, da);
 
 	dev_err(dev, "buffer lookup failed %x\n", ret);
 
@@ -499,9 +564,6 @@ static int rpmsg_omx_open(struct inode *inode, struct file *filp)
 	list_add(&omx->next, &omxserv->list);
 	mutex_unlock(&omxserv->lock);
 
-#ifdef CONFIG_DMA_SHARED_BUFFER
-	idr_init(&omx->dma_idr);
-#endif
 
 	init_completion(&omx->reply_arrived);
 
@@ -517,9 +579,17 @@ err:
 }
 
 #ifdef CONFIG_DMA_SHARED_BUFFER
-int rpmsg_omx_idr_unpin_buffer(int id, void *node, void *omx)
+static void rpmsg_omx_dma_clear(struct rpmsg_omx_instance *omx)
 {
-	return rpmsg_omx_remove_dma_buffer(omx, node);
+	struct rpmsg_omx_dma_info *dma;
+	struct hlist_node *pos, *n;
+	int i;
+
+	mutex_lock(&omx->lock);
+	for (i = 0; i < ARRAY_SIZE(omx->dma_hash); i++)
+		hlist_for_each_entry_safe(dma, pos, n, &omx->dma_hash[i], node)
+			rpmsg_omx_remove_dma_buffer(omx, dma);
+	mutex_unlock(&omx->lock);
 }
 #endif
 
@@ -562,9 +632,7 @@ static int rpmsg_omx_release(struct inode *inode, struct file *filp)
 	}
 
 #ifdef CONFIG_DMA_SHARED_BUFFER
-	idr_for_each(&omx->dma_idr, rpmsg_omx_idr_unpin_buffer, omx);
-	idr_remove_all(&omx->dma_idr);
-	idr_destroy(&omx->dma_idr);
+	rpmsg_omx_dma_clear(omx);
 #endif
 	mutex_lock(&omxserv->lock);
 	list_del(&omx->next);
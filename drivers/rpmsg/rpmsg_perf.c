@@ -0,0 +1,354 @@
+/*
+ * Remote processor performance counters over rpmsg
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt)    "%s: " fmt, __func__
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/rpmsg.h>
+#include <linux/remoteproc.h>
+#include <linux/rpmsg_perf.h>
+
+/* number of reports kept per remote processor, must be a power of 2 */
+#define RPMSG_PERF_RING		32
+
+static unsigned int period_ms = 100;
+module_param(period_ms, uint, S_IRUGO);
+MODULE_PARM_DESC(period_ms, "Period of the remote reports (ms)");
+
+/**
+ * struct rpmsg_perf_sample - one report as stored by the host
+ * @stamp:	host time at which the report was received
+ * @msg:	report header
+ * @tasks:	per-task cycles, @msg.num_tasks of them are valid
+ */
+struct rpmsg_perf_sample {
+	ktime_t stamp;
+	struct rpmsg_perf_msg msg;
+	struct rpmsg_perf_task tasks[RPMSG_PERF_MAX_TASKS];
+};
+
+/**
+ * struct rpmsg_perf - performance counters of one remote processor
+ * @next:	link into rpmsg_perf_list
+ * @rpdev:	channel the reports arrive on
+ * @rproc:	remote processor the reports describe
+ * @lock:	protects the ring and the counters
+ * @ring:	last RPMSG_PERF_RING reports
+ * @head:	number of reports stored so far
+ * @received:	reports accepted
+ * @lost:	reports missing according to the sequence numbers
+ * @invalid:	messages dropped because they were malformed
+ * @dentry:	debugfs entry in the rproc directory
+ */
+struct rpmsg_perf {
+	struct list_head next;
+	struct rpmsg_channel *rpdev;
+	struct rproc *rproc;
+	spinlock_t lock;
+	struct rpmsg_perf_sample ring[RPMSG_PERF_RING];
+	unsigned int head;
+	u32 received;
+	u32 lost;
+	u32 invalid;
+	struct dentry *dentry;
+};
+
+static LIST_HEAD(rpmsg_perf_list);
+static DEFINE_MUTEX(rpmsg_perf_lock);
+
+static struct rpmsg_perf_sample *
+_perf_sample(struct rpmsg_perf *perf, unsigned int back)
+{
+	return &perf->ring[(perf->head - 1 - back) & (RPMSG_PERF_RING - 1)];
+}
+
+/**
+ * rpmsg_perf_get_load() - average load of a remote processor
+ * @name: name of the remote processor, as given to rproc_alloc()
+ * @window: number of latest reports to average, 0 means all stored ones
+ *
+ * Meant for DVFS governors which want to scale the remote processor, or the
+ * interconnect it sits behind, on the load it reports itself.
+ *
+ * Returns the load in per-mille, -ENODEV if @name has no counter channel or
+ * -ENODATA if no report arrived yet.
+ */
+int rpmsg_perf_get_load(const char *name, unsigned int window)
+{
+	struct rpmsg_perf *perf;
+	unsigned long flags;
+	unsigned int i, n;
+	u64 sum = 0, us = 0;
+	int ret = -ENODEV;
+
+	mutex_lock(&rpmsg_perf_lock);
+	list_for_each_entry(perf, &rpmsg_perf_list, next) {
+		if (strcmp(perf->rproc->name, name))
+			continue;
+
+		spin_lock_irqsave(&perf->lock, flags);
+		n = min_t(unsigned int, perf->head, RPMSG_PERF_RING);
+		if (window && window < n)
+			n = window;
+		/* weight each report by the period it covers */
+		for (i = 0; i < n; i++) {
+			struct rpmsg_perf_msg *msg = &_perf_sample(perf, i)->msg;
+
+			sum += (u64)msg->load * msg->period_us;
+			us += msg->period_us;
+		}
+		spin_unlock_irqrestore(&perf->lock, flags);
+
+		if (!n)
+			ret = -ENODATA;
+		else if (!us)
+			ret = _perf_sample(perf, 0)->msg.load;
+		else
+			ret = div64_u64(sum, us);
+		break;
+	}
+	mutex_unlock(&rpmsg_perf_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(rpmsg_perf_get_load);
+
+static void rpmsg_perf_cb(struct rpmsg_channel *rpdev, void *data, int len,
+			  void *priv, u32 src)
+{
+	struct rpmsg_perf *perf = dev_get_drvdata(&rpdev->dev);
+	struct rpmsg_perf_msg *msg = data;
+	struct rpmsg_perf_sample *s;
+	unsigned long flags;
+	unsigned int tasks;
+	u32 gap;
+
+	if (len < sizeof(*msg) || msg->version != RPMSG_PERF_VERSION ||
+	    msg->num_tasks > (len - sizeof(*msg)) / sizeof(msg->tasks[0])) {
+		dev_err(&rpdev->dev, "invalid report (len %d)\n", len);
+		spin_lock_irqsave(&perf->lock, flags);
+		perf->invalid++;
+		spin_unlock_irqrestore(&perf->lock, flags);
+		return;
+	}
+
+	tasks = min_t(u32, msg->num_tasks, RPMSG_PERF_MAX_TASKS);
+
+	spin_lock_irqsave(&perf->lock, flags);
+	if (perf->head) {
+		gap = msg->seq - _perf_sample(perf, 0)->msg.seq - 1;
+		/* a huge gap means the remote side restarted its numbering */
+		if (gap < RPMSG_PERF_RING * 16)
+			perf->lost += gap;
+	}
+
+	s = &perf->ring[perf->head++ & (RPMSG_PERF_RING - 1)];
+	s->stamp = ktime_get();
+	s->msg = *msg;
+	s->msg.num_tasks = tasks;
+	memcpy(s->tasks, msg->tasks, tasks * sizeof(s->tasks[0]));
+	perf->received++;
+	spin_unlock_irqrestore(&perf->lock, flags);
+}
+
+static int rpmsg_perf_show(struct seq_file *m, void *v)
+{
+	struct rpmsg_perf *perf = m->private;
+	struct rpmsg_perf_sample *s, *copy;
+	unsigned long flags;
+	unsigned int i, j, n;
+	u32 received, lost, invalid;
+
+	/* do not print with the lock held, the callback must not wait */
+	copy = kmalloc(sizeof(perf->ring), GFP_KERNEL);
+	if (!copy)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&perf->lock, flags);
+	n = min_t(unsigned int, perf->head, RPMSG_PERF_RING);
+	for (i = 0; i < n; i++)
+		copy[i] = *_perf_sample(perf, i);
+	received = perf->received;
+	lost = perf->lost;
+	invalid = perf->invalid;
+	spin_unlock_irqrestore(&perf->lock, flags);
+
+	seq_printf(m, "received: %u\nlost: %u\ninvalid: %u\n",
+		   received, lost, invalid);
+
+	for (i = 0; i < n; i++) {
+		s = &copy[i];
+		seq_printf(m, "\n[%lld us] seq %u period %u us load %u.%u%%\n",
+			   ktime_to_us(s->stamp), s->msg.seq, s->msg.period_us,
+			   s->msg.load / 10, s->msg.load % 10);
+		seq_printf(m, "  cycles %u icache_miss %u dcache_miss %u\n",
+			   s->msg.cycles, s->msg.icache_miss,
+			   s->msg.dcache_miss);
+		for (j = 0; j < s->msg.num_tasks; j++)
+			seq_printf(m, "  %-*.*s %u\n", RPMSG_PERF_NAME_LEN,
+				   RPMSG_PERF_NAME_LEN, s->tasks[j].name,
+				   s->tasks[j].cycles);
+	}
+
+	kfree(copy);
+	return 0;
+}
+
+static int rpmsg_perf_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rpmsg_perf_show, inode->i_private);
+}
+
+static const struct file_operations rpmsg_perf_fops = {
+	.open		= rpmsg_perf_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#define RPMSG_PERF_ATTR(_name, _expr)					\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct rpmsg_perf *perf = dev_get_drvdata(dev);			\
+	unsigned long flags;						\
+	u32 val = 0;							\
+									\
+	spin_lock_irqsave(&perf->lock, flags);				\
+	if (perf->head)							\
+		val = _expr;						\
+	spin_unlock_irqrestore(&perf->lock, flags);			\
+									\
+	return sprintf(buf, "%u\n", val);				\
+}									\
+static DEVICE_ATTR(_name, S_IRUGO, _name##_show, NULL)
+
+RPMSG_PERF_ATTR(load, _perf_sample(perf, 0)->msg.load);
+RPMSG_PERF_ATTR(cycles, _perf_sample(perf, 0)->msg.cycles);
+RPMSG_PERF_ATTR(icache_miss, _perf_sample(perf, 0)->msg.icache_miss);
+RPMSG_PERF_ATTR(dcache_miss, _perf_sample(perf, 0)->msg.dcache_miss);
+RPMSG_PERF_ATTR(received, perf->received);
+RPMSG_PERF_ATTR(lost, perf->lost);
+
+static struct attribute *rpmsg_perf_attrs[] = {
+	&dev_attr_load.attr,
+	&dev_attr_cycles.attr,
+	&dev_attr_icache_miss.attr,
+	&dev_attr_dcache_miss.attr,
+	&dev_attr_received.attr,
+	&dev_attr_lost.attr,
+	NULL,
+};
+
+static const struct attribute_group rpmsg_perf_group = {
+	.name	= "perf",
+	.attrs	= rpmsg_perf_attrs,
+};
+
+static int rpmsg_perf_probe(struct rpmsg_channel *rpdev)
+{
+	struct rpmsg_perf *perf;
+	struct rpmsg_perf_ctrl ctrl;
+	char name[32];
+	int ret;
+
+	perf = kzalloc(sizeof(*perf), GFP_KERNEL);
+	if (!perf)
+		return -ENOMEM;
+
+	spin_lock_init(&perf->lock);
+	perf->rpdev = rpdev;
+	perf->rproc = vdev_to_rproc(rpdev->vrp->vdev);
+	dev_set_drvdata(&rpdev->dev, perf);
+
+	ret = sysfs_create_group(&rpdev->dev.kobj, &rpmsg_perf_group);
+	if (ret) {
+		dev_err(&rpdev->dev, "failed to create sysfs group: %d\n", ret);
+		goto free;
+	}
+
+	snprintf(name, sizeof(name), "perf-%s", dev_name(&rpdev->dev));
+	perf->dentry = debugfs_create_file(name, 0400, perf->rproc->dbg_dir,
+					   perf, &rpmsg_perf_fops);
+
+	mutex_lock(&rpmsg_perf_lock);
+	list_add_tail(&perf->next, &rpmsg_perf_list);
+	mutex_unlock(&rpmsg_perf_lock);
+
+	/* the remote side keeps quiet until it is told how often to talk */
+	ctrl.version = RPMSG_PERF_VERSION;
+	ctrl.period_ms = period_ms;
+	ret = rpmsg_send(rpdev, &ctrl, sizeof(ctrl));
+	if (ret)
+		dev_err(&rpdev->dev, "rpmsg_send failed: %d\n", ret);
+
+	return 0;
+
+free:
+	kfree(perf);
+	return ret;
+}
+
+static void __devexit rpmsg_perf_remove(struct rpmsg_channel *rpdev)
+{
+	struct rpmsg_perf *perf = dev_get_drvdata(&rpdev->dev);
+
+	mutex_lock(&rpmsg_perf_lock);
+	list_del(&perf->next);
+	mutex_unlock(&rpmsg_perf_lock);
+
+	if (perf->dentry)
+		debugfs_remove(perf->dentry);
+	sysfs_remove_group(&rpdev->dev.kobj, &rpmsg_perf_group);
+	kfree(perf);
+}
+
+static struct rpmsg_device_id rpmsg_perf_id_table[] = {
+	{ .name	= "rpmsg-perf" },
+	{ },
+};
+MODULE_DEVICE_TABLE(rpmsg, rpmsg_perf_id_table);
+
+static struct rpmsg_driver rpmsg_perf_driver = {
+	.drv.name	= KBUILD_MODNAME,
+	.drv.owner	= THIS_MODULE,
+	.id_table	= rpmsg_perf_id_table,
+	.probe		= rpmsg_perf_probe,
+	.callback	= rpmsg_perf_cb,
+	.remove		= __devexit_p(rpmsg_perf_remove),
+};
+
+static int __init rpmsg_perf_init(void)
+{
+	return register_rpmsg_driver(&rpmsg_perf_driver);
+}
+module_init(rpmsg_perf_init);
+
+static void __exit rpmsg_perf_fini(void)
+{
+	unregister_rpmsg_driver(&rpmsg_perf_driver);
+}
+module_exit(rpmsg_perf_fini);
+
+MODULE_DESCRIPTION("Remote processor performance counters over rpmsg");
+MODULE_LICENSE("GPL v2");
@@ -30,6 +30,11 @@
 #define MAX_RES_BUF 512
 #define MAX_DENTRY_SIZE 128
 
+/* time a looser aggregated constraint must be stable before it is applied */
+static unsigned int qos_relax_ms = 100;
+module_param(qos_relax_ms, uint, 0644);
+MODULE_PARM_DESC(qos_relax_ms, "Delay before relaxing a constraint (ms)");
+
 /**
  * struct rprm_elem - an instance of this struct represents a resource
  * @next: pointer to next element
@@ -609,6 +614,146 @@ int rprm_resource_unregister(struct rprm_res *res)
 }
 EXPORT_SYMBOL(rprm_resource_unregister);
 
+/* is @a a stricter value than @b for this kind of constraint? */
+static bool rprm_qos_tighter(struct rprm_qos *qos, long a, long b)
+{
+	if (qos->type == RPRM_LATENCY) {
+		/* a negative latency means no constraint at all */
+		if (a < 0)
+			return false;
+		return b < 0 || a < b;
+	}
+
+	return a > b;
+}
+
+static long rprm_qos_effective(struct rprm_qos *qos)
+{
+	struct rprm_qos_req *req;
+	long val = qos->dflt;
+
+	list_for_each_entry(req, &qos->reqs, node)
+		if (rprm_qos_tighter(qos, req->val, val))
+			val = req->val;
+
+	return val;
+}
+
+static void rprm_qos_relax_work(struct work_struct *work)
+{
+	struct rprm_qos *qos = container_of(to_delayed_work(work),
+					    struct rprm_qos, relax);
+	long val;
+	int ret;
+
+	mutex_lock(&qos->lock);
+	val = rprm_qos_effective(qos);
+	if (val != qos->applied) {
+		ret = qos->apply(qos, val);
+		if (ret)
+			pr_err("failed to relax constraint to %ld: %d\n",
+			       val, ret);
+		else
+			qos->applied = val;
+	}
+	mutex_unlock(&qos->lock);
+}
+
+/**
+ * rprm_qos_init - initialize a constraint aggregator
+ * @qos: aggregator to initialize
+ * @type: constraint type handled by @qos
+ * @apply: callback programming the effective value
+ * @data: private data of @apply
+ *
+ * The target is assumed to be at the default value of @type, which is
+ * also the value a request uses to withdraw itself.
+ */
+void rprm_qos_init(struct rprm_qos *qos, enum rprm_constraint_type type,
+		   int (*apply)(struct rprm_qos *qos, long val), void *data)
+{
+	INIT_LIST_HEAD(&qos->reqs);
+	mutex_init(&qos->lock);
+	INIT_DELAYED_WORK(&qos->relax, rprm_qos_relax_work);
+	qos->type = type;
+	qos->dflt = type == RPRM_SCALE ? def_data.frequency :
+		    type == RPRM_BANDWIDTH ? def_data.bandwidth :
+		    def_data.latency;
+	qos->applied = qos->dflt;
+	qos->apply = apply;
+	qos->data = data;
+}
+EXPORT_SYMBOL(rprm_qos_init);
+
+/**
+ * rprm_qos_update - change the value of one request
+ * @qos: aggregator the request belongs to
+ * @req: request to change, initialized with rprm_qos_req_init()
+ * @val: new value, the default value of the type drops the request
+ *
+ * The target is only touched when the aggregated value changes. A tighter
+ * value is applied before returning and its error is returned, a looser
+ * one is deferred by qos_relax_ms and reverted on the next tightening.
+ */
+int rprm_qos_update(struct rprm_qos *qos, struct rprm_qos_req *req, long val)
+{
+	long eff;
+	int ret = 0;
+
+	mutex_lock(&qos->lock);
+	if (val == qos->dflt) {
+		list_del_init(&req->node);
+	} else {
+		req->val = val;
+		if (list_empty(&req->node))
+			list_add_tail(&req->node, &qos->reqs);
+	}
+
+	eff = rprm_qos_effective(qos);
+	if (eff == qos->applied) {
+		cancel_delayed_work(&qos->relax);
+	} else if (rprm_qos_tighter(qos, eff, qos->applied) || !qos_relax_ms) {
+		cancel_delayed_work(&qos->relax);
+		ret = qos->apply(qos, eff);
+		if (!ret)
+			qos->applied = eff;
+	} else {
+		/* keep the first deadline, a stream of relaxations must end */
+		schedule_delayed_work(&qos->relax,
+				      msecs_to_jiffies(qos_relax_ms));
+	}
+	mutex_unlock(&qos->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(rprm_qos_update);
+
+/**
+ * rprm_qos_exit - tear down a constraint aggregator
+ * @qos: aggregator to tear down
+ *
+ * Any pending relaxation is flushed and the target is put back to the
+ * default value, whatever requests are still linked.
+ */
+void rprm_qos_exit(struct rprm_qos *qos)
+{
+	int ret;
+
+	cancel_delayed_work_sync(&qos->relax);
+
+	mutex_lock(&qos->lock);
+	INIT_LIST_HEAD(&qos->reqs);
+	if (qos->applied != qos->dflt) {
+		ret = qos->apply(qos, qos->dflt);
+		if (ret)
+			pr_err("failed to restore constraint: %d\n", ret);
+		else
+			qos->applied = qos->dflt;
+	}
+	mutex_unlock(&qos->lock);
+}
+EXPORT_SYMBOL(rprm_qos_exit);
+
 /* probe function is called every time a new connection(device) is created */
 static int rprm_probe(struct rpmsg_channel *rpdev)
 {
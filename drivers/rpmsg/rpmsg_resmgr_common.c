@@ -30,11 +30,36 @@ struct rprm_i2c_depot {
 	struct device *dev;
 };
 
+/*
+ * Constraints on a remote processor are shared by every client requesting
+ * the "rproc" resource, so they are aggregated per rproc instead of being
+ * applied blindly by each handle.
+ */
+enum {
+	RPRM_RPROC_SCALE,
+	RPRM_RPROC_LATENCY,
+	RPRM_RPROC_BANDWIDTH,
+	RPRM_RPROC_QOS_MAX,
+};
+
+struct rprm_rproc_qos {
+	struct list_head next;
+	struct rproc *rp;
+	struct device *rdev;
+	unsigned int users;
+	struct rprm_qos qos[RPRM_RPROC_QOS_MAX];
+};
+
 struct rprm_rproc_depot {
 	char name[16];
 	struct rproc *rp;
+	struct rprm_rproc_qos *group;
+	struct rprm_qos_req req[RPRM_RPROC_QOS_MAX];
 };
 
+static LIST_HEAD(rproc_qos_list);
+static DEFINE_MUTEX(rproc_qos_lock);
+
 static int rprm_gpio_request(void **handle, void *args, size_t len)
 {
 	int ret;
@@ -135,11 +160,76 @@ static int rprm_i2c_get_info(void *handle, char *buf, size_t len)
 	return snprintf(buf, len, "id:%d\n", i2cd->id);
 }
 
+static int _rproc_qos_apply(struct rprm_qos *qos, long val)
+{
+	struct rprm_rproc_qos *group = qos->data;
+	static const enum rproc_constraint type[RPRM_RPROC_QOS_MAX] = {
+		[RPRM_RPROC_SCALE] = RPROC_CONSTRAINT_FREQUENCY,
+		[RPRM_RPROC_LATENCY] = RPROC_CONSTRAINT_LATENCY,
+		[RPRM_RPROC_BANDWIDTH] = RPROC_CONSTRAINT_BANDWIDTH,
+	};
+
+	return rproc_set_constraints(group->rdev, group->rp,
+				     type[qos - group->qos], val);
+}
+
+static struct rprm_rproc_qos *_rproc_qos_get(struct rproc *rp)
+{
+	struct rprm_rproc_qos *group;
+
+	mutex_lock(&rproc_qos_lock);
+	list_for_each_entry(group, &rproc_qos_list, next)
+		if (group->rp == rp)
+			goto found;
+
+	group = kzalloc(sizeof *group, GFP_KERNEL);
+	if (!group)
+		goto unlock;
+
+	group->rp = rp;
+	rprm_qos_init(&group->qos[RPRM_RPROC_SCALE], RPRM_SCALE,
+		      _rproc_qos_apply, group);
+	rprm_qos_init(&group->qos[RPRM_RPROC_LATENCY], RPRM_LATENCY,
+		      _rproc_qos_apply, group);
+	rprm_qos_init(&group->qos[RPRM_RPROC_BANDWIDTH], RPRM_BANDWIDTH,
+		      _rproc_qos_apply, group);
+	list_add_tail(&group->next, &rproc_qos_list);
+found:
+	group->users++;
+unlock:
+	mutex_unlock(&rproc_qos_lock);
+
+	return group;
+}
+
+static void _rproc_qos_put(struct rprm_rproc_depot *rprocd)
+{
+	struct rprm_rproc_qos *group = rprocd->group;
+	int i;
+
+	/* withdraw this handle, the others keep their requests */
+	for (i = 0; i < RPRM_RPROC_QOS_MAX; i++)
+		rprm_qos_update(&group->qos[i], &rprocd->req[i],
+				group->qos[i].dflt);
+
+	mutex_lock(&rproc_qos_lock);
+	if (--group->users) {
+		mutex_unlock(&rproc_qos_lock);
+		return;
+	}
+	list_del(&group->next);
+	mutex_unlock(&rproc_qos_lock);
+
+	for (i = 0; i < RPRM_RPROC_QOS_MAX; i++)
+		rprm_qos_exit(&group->qos[i]);
+	kfree(group);
+}
+
 static int rprm_rproc_request(void **handle, void *data, size_t len)
 {
 	struct rprm_rproc *rproc_data = data;
 	struct rprm_rproc_depot *rprocd;
-	int ret;
+	int ret, i;
 
 	if (len != sizeof *rproc_data)
 		return -EINVAL;
@@ -154,10 +244,20 @@ static int rprm_rproc_request(void **handle, void *data, size_t len)
 		goto error;
 	}
 
+	rprocd->group = _rproc_qos_get(rprocd->rp);
+	if (!rprocd->group) {
+		ret = -ENOMEM;
+		goto put;
+	}
+	for (i = 0; i < RPRM_RPROC_QOS_MAX; i++)
+		rprm_qos_req_init(&rprocd->req[i]);
+
 	strcpy(rprocd->name, rproc_data->name);
 	*handle = rprocd;
 
 	return 0;
+put:
+	rproc_put(rprocd->rp);
 error:
 	kfree(rprocd);
 	return ret;
@@ -167,6 +267,8 @@ static int rprm_rproc_release(void *handle)
 {
 	struct rprm_rproc_depot *rprocd = handle;
 
+	/* drop the constraints while the rproc can still take them */
+	_rproc_qos_put(rprocd);
 	rproc_shutdown(rprocd->rp);
 	kfree(rprocd);
 
@@ -180,29 +282,27 @@ static int rprm_rproc_get_info(void *handle, char *buf, size_t len)
 	return snprintf(buf, len, "Name:%s\n", rprocd->name);
 }
 
-static int _rproc_latency(struct device *rdev, void *handle, unsigned long val)
+static int _rproc_constraint(struct device *rdev,
+			     struct rprm_rproc_depot *rprocd, int i, long val)
 {
-	struct rprm_rproc_depot *rprocd = handle;
+	rprocd->group->rdev = rdev;
+	return rprm_qos_update(&rprocd->group->qos[i], &rprocd->req[i], val);
+}
 
-	return rproc_set_constraints(rdev, rprocd->rp,
-				     RPROC_CONSTRAINT_LATENCY, val);
+static int _rproc_latency(struct device *rdev, void *handle, unsigned long val)
+{
+	return _rproc_constraint(rdev, handle, RPRM_RPROC_LATENCY, val);
 }
 
 static int _rproc_bandwidth(struct device *rdev, void *handle,
 							unsigned long val)
 {
-	struct rprm_rproc_depot *rprocd = handle;
-
-	return rproc_set_constraints(rdev, rprocd->rp,
-				     RPROC_CONSTRAINT_BANDWIDTH, val);
+	return _rproc_constraint(rdev, handle, RPRM_RPROC_BANDWIDTH, val);
 }
 
 static int _rproc_scale(struct device *rdev, void *handle, unsigned long val)
 {
-	struct rprm_rproc_depot *rprocd = handle;
-
-	return rproc_set_constraints(rdev, rprocd->rp,
-				     RPROC_CONSTRAINT_FREQUENCY, val);
+	return _rproc_constraint(rdev, handle, RPRM_RPROC_SCALE, val);
 }
 
 static struct rprm_res_ops gpio_ops = {
@@ -64,17 +64,23 @@ struct rpmsg_channel_info {
  *
  * This will require a total space of 256KB for the buffers.
  *
- * We might also want to add support for user-provided buffers in time.
- * This will allow bigger buffer size flexibility, and can also be used
- * to achieve zero-copy messaging.
- *
- * Note that these numbers are purely a decision of this driver - we
- * can change this without changing anything in the firmware of the remote
- * processor.
+ * These are only the defaults: a remote processor that offers
+ * VIRTIO_RPMSG_F_BUFS publishes the number and size of buffers it can
+ * handle in the vdev config space, and the layout is sized accordingly.
+ * Payloads that don't fit a buffer can be passed by reference to a shared
+ * region instead (see rpmsg_shm_register()), which is also zero-copy.
  */
 #define RPMSG_NUM_BUFS		(512)
 #define RPMSG_BUF_SIZE		(512)
-#define RPMSG_TOTAL_BUF_SPACE	(RPMSG_NUM_BUFS * RPMSG_BUF_SIZE)
+
+/* hdr->len is 16 bits wide, and we want buffers to stay word aligned */
+#define RPMSG_MAX_BUF_SIZE	(65536)
+#define RPMSG_BUF_ALIGN		(sizeof(u32))
+
+/* default number of messages rx processing handles before yielding */
+static unsigned int rx_budget = 64;
+module_param(rx_budget, uint, 0644);
+MODULE_PARM_DESC(rx_budget, "messages received per pass before yielding");
 
 /*
  * Local addresses are dynamically allocated on-demand.
@@ -129,12 +135,26 @@ static ssize_t modalias_show(struct device *dev,
 	return sprintf(buf, RPMSG_DEVICE_MODALIAS_FMT "\n", rpdev->id.name);
 }
 
+static ssize_t tx_stats_show(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	struct rpmsg_channel *rpdev = to_rpmsg_channel(dev);
+	struct rpmsg_endpoint *ept = rpdev->ept;
+
+	if (!ept)
+		return -ENODEV;
+
+	return sprintf(buf, "%u %u %u\n", atomic_read(&ept->tx_msgs),
+			atomic_read(&ept->tx_bytes), atomic_read(&ept->tx_kicks));
+}
+
 static struct device_attribute rpmsg_dev_attrs[] = {
 	__ATTR_RO(name),
 	__ATTR_RO(modalias),
 	__ATTR_RO(dst),
 	__ATTR_RO(src),
 	__ATTR_RO(announce),
+	__ATTR_RO(tx_stats),
 	__ATTR_NULL
 };
 
@@ -565,8 +585,8 @@ static void *get_a_tx_buf(struct virtproc_info *vrp)
 	 * either pick the next unused tx buffer
 	 * (half of our buffers are used for sending messages)
 	 */
-	if (vrp->last_sbuf < RPMSG_NUM_BUFS / 2)
-		ret = vrp->sbufs + RPMSG_BUF_SIZE * vrp->last_sbuf++;
+	if (vrp->last_sbuf < vrp->num_bufs / 2)
+		ret = vrp->sbufs + vrp->buf_size * vrp->last_sbuf++;
 	/* or recycle a used one */
 	else
 		ret = virtqueue_get_buf(vrp->svq, &len);
@@ -632,73 +652,17 @@ static void rpmsg_downref_sleepers(struct virtproc_info *vrp)
 	mutex_unlock(&vrp->tx_lock);
 }
 
-/**
- * rpmsg_send_offchannel_raw() - send a message across to the remote processor
- * @rpdev: the rpmsg channel
- * @src: source address
- * @dst: destination address
- * @data: payload of message
- * @len: length of payload
- * @wait: indicates whether caller should block in case no TX buffers available
- *
- * This function is the base implementation for all of the rpmsg sending API.
- *
- * It will send @data of length @len to @dst, and say it's from @src. The
- * message will be sent to the remote processor which the @rpdev channel
- * belongs to.
- *
- * The message is sent using one of the TX buffers that are available for
- * communication with this remote processor.
- *
- * If @wait is true, the caller will be blocked until either a TX buffer is
- * available, or 15 seconds elapses (we don't want callers to
- * sleep indefinitely due to misbehaving remote processors), and in that
- * case -ERESTARTSYS is returned. The number '15' itself was picked
- * arbitrarily; there's little point in asking drivers to provide a timeout
- * value themselves.
- *
- * Otherwise, if @wait is false, and there are no TX buffers available,
- * the function will immediately fail, and -ENOMEM will be returned.
- *
- * Normally drivers shouldn't use this function directly; instead, drivers
- * should use the appropriate rpmsg_{try}send{to, _offchannel} API
- * (see include/linux/rpmsg.h).
- *
- * Returns 0 on success and an appropriate error value on failure.
- */
-int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
-					void *data, int len, bool wait)
+/* grab a tx buffer, waiting for one (but bail after 15 seconds) if @wait */
+static struct rpmsg_hdr *rpmsg_grab_tx_buf(struct virtproc_info *vrp,
+					struct device *dev, bool wait)
 {
-	struct virtproc_info *vrp = rpdev->vrp;
-	struct device *dev = &rpdev->dev;
-	struct scatterlist sg;
 	struct rpmsg_hdr *msg;
 	int err;
 
-	/* bcasting isn't allowed */
-	if (src == RPMSG_ADDR_ANY || dst == RPMSG_ADDR_ANY) {
-		dev_err(dev, "invalid addr (src 0x%x, dst 0x%x)\n", src, dst);
-		return -EINVAL;
-	}
-
-	/*
-	 * We currently use fixed-sized buffers, and therefore the payload
-	 * length is limited.
-	 *
-	 * One of the possible improvements here is either to support
-	 * user-provided buffers (and then we can also support zero-copy
-	 * messaging), or to improve the buffer allocator, to support
-	 * variable-length buffer sizes.
-	 */
-	if (len > RPMSG_BUF_SIZE - sizeof(struct rpmsg_hdr)) {
-		dev_err(dev, "message is too big (%d)\n", len);
-		return -EMSGSIZE;
-	}
-
 	/* grab a buffer */
 	msg = get_a_tx_buf(vrp);
 	if (!msg && !wait)
-		return -ENOMEM;
+		return ERR_PTR(-ENOMEM);
 
 	/* no free buffer ? wait for one (but bail after 15 seconds) */
 	while (!msg) {
@@ -721,12 +685,23 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 		/* timeout ? */
 		if (!err) {
 			dev_err(dev, "timeout waiting for a tx buffer\n");
-			return -ERESTARTSYS;
+			return ERR_PTR(-ERESTARTSYS);
 		}
 	}
 
+	return msg;
+}
+
+/* fill in a tx buffer and add it to the remote processor's virtqueue */
+static int rpmsg_queue_tx_buf(struct virtproc_info *vrp, struct device *dev,
+			struct rpmsg_hdr *msg, u32 src, u32 dst,
+			void *data, int len, u16 flags)
+{
+	struct scatterlist sg;
+	int err;
+
 	msg->len = len;
-	msg->flags = 0;
+	msg->flags = flags;
 	msg->src = src;
 	msg->dst = dst;
 	msg->reserved = 0;
@@ -742,8 +717,6 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 
 	sg_init_one(&sg, msg, sizeof(*msg) + len);
 
-	mutex_lock(&vrp->tx_lock);
-
 	/* add message to the remote processor's virtqueue */
 	err = virtqueue_add_buf(vrp->svq, &sg, 1, 0, msg, GFP_KERNEL);
 	if (err < 0) {
@@ -753,38 +726,352 @@ int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
 		 * this will wait for a buffer management overhaul.
 		 */
 		dev_err(dev, "virtqueue_add_buf failed: %d\n", err);
-		goto out;
+		return err;
 	}
 
-	/* tell the remote processor it has a pending message to read */
+	return 0;
+}
+
+/*
+ * Every kick costs the remote processor an interrupt, so senders that race
+ * with each other share one: everyone bumps @tx_senders before queueing
+ * their buffers, and only the last one out kicks (with tx_lock held, so all
+ * the buffers queued so far are visible to the remote side).
+ * Returns true if the caller kicked.
+ */
+static bool rpmsg_tx_done(struct virtproc_info *vrp)
+{
+	if (!atomic_dec_and_test(&vrp->tx_senders))
+		return false;
+
+	/* tell the remote processor it has pending messages to read */
 	virtqueue_kick(vrp->svq);
+	return true;
+}
 
-	err = 0;
-out:
+/* account for messages sent from @src, for the endpoint's statistics */
+static void rpmsg_account_tx(struct rpmsg_channel *rpdev, u32 src,
+				int msgs, int bytes, bool kicked)
+{
+	struct virtproc_info *vrp = rpdev->vrp;
+	struct rpmsg_endpoint *ept = rpdev->ept;
+	bool locked = false;
+
+	/* the channel's own ept is the common case and needs no lookup */
+	if (!ept || ept->addr != src) {
+		mutex_lock(&vrp->endpoints_lock);
+		ept = idr_find(&vrp->endpoints, src);
+		locked = true;
+	}
+
+	if (ept) {
+		atomic_add(msgs, &ept->tx_msgs);
+		atomic_add(bytes, &ept->tx_bytes);
+		if (kicked)
+			atomic_inc(&ept->tx_kicks);
+	}
+
+	if (locked)
+		mutex_unlock(&vrp->endpoints_lock);
+}
+
+/* validate a message about to be sent from @rpdev */
+static int rpmsg_check_tx(struct rpmsg_channel *rpdev, u32 src, u32 dst,
+								int len)
+{
+	struct device *dev = &rpdev->dev;
+
+	/* bcasting isn't allowed */
+	if (src == RPMSG_ADDR_ANY || dst == RPMSG_ADDR_ANY) {
+		dev_err(dev, "invalid addr (src 0x%x, dst 0x%x)\n", src, dst);
+		return -EINVAL;
+	}
+
+	/*
+	 * We use fixed-sized buffers, and therefore the payload length is
+	 * limited. Bigger payloads go through rpmsg_send_shm() instead.
+	 */
+	if (len < 0 || len > rpdev->vrp->buf_size - sizeof(struct rpmsg_hdr)) {
+		dev_err(dev, "message is too big (%d)\n", len);
+		return -EMSGSIZE;
+	}
+
+	return 0;
+}
+
+/* send @len bytes of @data as a message with header flags @flags */
+static int __rpmsg_send(struct rpmsg_channel *rpdev, u32 src, u32 dst,
+				void *data, int len, u16 flags, bool wait)
+{
+	struct virtproc_info *vrp = rpdev->vrp;
+	struct device *dev = &rpdev->dev;
+	struct rpmsg_hdr *msg;
+	bool kicked;
+	int err;
+
+	err = rpmsg_check_tx(rpdev, src, dst, len);
+	if (err)
+		return err;
+
+	msg = rpmsg_grab_tx_buf(vrp, dev, wait);
+	if (IS_ERR(msg))
+		return PTR_ERR(msg);
+
+	atomic_inc(&vrp->tx_senders);
+
+	mutex_lock(&vrp->tx_lock);
+	err = rpmsg_queue_tx_buf(vrp, dev, msg, src, dst, data, len, flags);
+	kicked = rpmsg_tx_done(vrp);
 	mutex_unlock(&vrp->tx_lock);
+
+	if (!err)
+		rpmsg_account_tx(rpdev, src, 1, len, kicked);
+
 	return err;
 }
+
+/**
+ * rpmsg_send_offchannel_raw() - send a message across to the remote processor
+ * @rpdev: the rpmsg channel
+ * @src: source address
+ * @dst: destination address
+ * @data: payload of message
+ * @len: length of payload
+ * @wait: indicates whether caller should block in case no TX buffers available
+ *
+ * This function is the base implementation for all of the rpmsg sending API.
+ *
+ * It will send @data of length @len to @dst, and say it's from @src. The
+ * message will be sent to the remote processor which the @rpdev channel
+ * belongs to.
+ *
+ * The message is sent using one of the TX buffers that are available for
+ * communication with this remote processor.
+ *
+ * If @wait is true, the caller will be blocked until either a TX buffer is
+ * available, or 15 seconds elapses (we don't want callers to
+ * sleep indefinitely due to misbehaving remote processors), and in that
+ * case -ERESTARTSYS is returned. The number '15' itself was picked
+ * arbitrarily; there's little point in asking drivers to provide a timeout
+ * value themselves.
+ *
+ * Otherwise, if @wait is false, and there are no TX buffers available,
+ * the function will immediately fail, and -ENOMEM will be returned.
+ *
+ * Normally drivers shouldn't use this function directly; instead, drivers
+ * should use the appropriate rpmsg_{try}send{to, _offchannel} API
+ * (see include/linux/rpmsg.h).
+ *
+ * Returns 0 on success and an appropriate error value on failure.
+ */
+int rpmsg_send_offchannel_raw(struct rpmsg_channel *rpdev, u32 src, u32 dst,
+					void *data, int len, bool wait)
+{
+	return __rpmsg_send(rpdev, src, dst, data, len, 0, wait);
+}
 EXPORT_SYMBOL(rpmsg_send_offchannel_raw);
 
-/* called when an rx buffer is used, and it's time to digest a message */
-static void rpmsg_recv_done(struct virtqueue *rvq)
+/**
+ * rpmsg_send_batch() - send several messages with a single notification
+ * @rpdev: the rpmsg channel
+ * @src: source address
+ * @msgs: the messages to send
+ * @num: number of messages in @msgs
+ * @wait: indicates whether caller should block in case no TX buffers available
+ *
+ * Like rpmsg_send_offchannel_raw() for each message of @msgs in turn, but
+ * the remote processor is interrupted once for the whole batch rather than
+ * once per message. If we run out of TX buffers half way, the messages
+ * queued so far are flushed to the remote processor before waiting.
+ *
+ * Can only be called from process context (for now).
+ *
+ * Returns the number of messages sent, which is less than @num only if an
+ * error stopped the batch after the first message, or an appropriate error
+ * value if nothing was sent.
+ */
+int rpmsg_send_batch(struct rpmsg_channel *rpdev, u32 src,
+			struct rpmsg_batch_msg *msgs, int num, bool wait)
 {
+	struct virtproc_info *vrp = rpdev->vrp;
+	struct device *dev = &rpdev->dev;
 	struct rpmsg_hdr *msg;
-	unsigned int len;
+	int i, bytes = 0, err = 0;
+	bool kicked;
+
+	for (i = 0; i < num; i++) {
+		err = rpmsg_check_tx(rpdev, src, msgs[i].dst, msgs[i].len);
+		if (err)
+			return err;
+	}
+
+	atomic_inc(&vrp->tx_senders);
+
+	for (i = 0; i < num; i++) {
+		msg = get_a_tx_buf(vrp);
+		if (!msg) {
+			/*
+			 * let the remote side drain what's queued so far, and
+			 * don't hold back other senders' kicks while we sleep
+			 */
+			mutex_lock(&vrp->tx_lock);
+			if (!rpmsg_tx_done(vrp))
+				virtqueue_kick(vrp->svq);
+			mutex_unlock(&vrp->tx_lock);
+
+			msg = rpmsg_grab_tx_buf(vrp, dev, wait);
+			atomic_inc(&vrp->tx_senders);
+			if (IS_ERR(msg)) {
+				err = PTR_ERR(msg);
+				break;
+			}
+		}
+
+		mutex_lock(&vrp->tx_lock);
+		err = rpmsg_queue_tx_buf(vrp, dev, msg, src, msgs[i].dst,
+				msgs[i].data, msgs[i].len, 0);
+		mutex_unlock(&vrp->tx_lock);
+		if (err)
+			break;
+
+		bytes += msgs[i].len;
+	}
+
+	mutex_lock(&vrp->tx_lock);
+	kicked = rpmsg_tx_done(vrp);
+	mutex_unlock(&vrp->tx_lock);
+
+	if (i)
+		rpmsg_account_tx(rpdev, src, i, bytes, kicked);
+
+	return i ? i : err;
+}
+EXPORT_SYMBOL(rpmsg_send_batch);
+
+/**
+ * rpmsg_get_max_payload() - largest payload that fits an rpmsg buffer
+ * @rpdev: the rpmsg channel
+ *
+ * The buffer size is negotiated with the remote processor when it boots,
+ * so drivers that used to assume the default 512-byte buffers should ask.
+ */
+int rpmsg_get_max_payload(struct rpmsg_channel *rpdev)
+{
+	return rpdev->vrp->buf_size - sizeof(struct rpmsg_hdr);
+}
+EXPORT_SYMBOL(rpmsg_get_max_payload);
+
+/**
+ * rpmsg_shm_register() - register a shared region for zero-copy messages
+ * @rpdev: the rpmsg channel
+ * @va: kernel address of the region
+ * @da: device address of the region, as seen by the remote processor
+ * @len: size of the region
+ *
+ * The region is typically a carveout of the remote processor. Once it is
+ * registered, rpmsg_send_shm() can pass data in it by reference, and
+ * messages the remote side sends with %RPMSG_F_SHM that point inside it are
+ * delivered to the endpoints of @rpdev as a pointer into the region.
+ *
+ * Register the region before the remote side may reference it, and
+ * unregister it only after the channel's endpoints are quiesced.
+ *
+ * Returns 0 on success and an appropriate error value on failure.
+ */
+int rpmsg_shm_register(struct rpmsg_channel *rpdev, void *va, u32 da,
+							size_t len)
+{
+	if (!va || !len || len > INT_MAX || da + len - 1 < da)
+		return -EINVAL;
+
+	if (rpdev->shm.va)
+		return -EBUSY;
+
+	rpdev->shm.da = da;
+	rpdev->shm.len = len;
+	rpdev->shm.va = va;
+
+	return 0;
+}
+EXPORT_SYMBOL(rpmsg_shm_register);
+
+/**
+ * rpmsg_shm_unregister() - drop the shared region of a channel
+ * @rpdev: the rpmsg channel
+ */
+void rpmsg_shm_unregister(struct rpmsg_channel *rpdev)
+{
+	memset(&rpdev->shm, 0, sizeof(rpdev->shm));
+}
+EXPORT_SYMBOL(rpmsg_shm_unregister);
+
+/**
+ * rpmsg_send_shm_offchannel() - send a shared region message, explicit addrs
+ * @rpdev: the rpmsg channel
+ * @src: source address
+ * @dst: destination address
+ * @offset: offset of the message data within the registered region
+ * @len: length of the message data
+ * @wait: indicates whether caller should block in case no TX buffers available
+ *
+ * See rpmsg_send_shm(); only a &struct rpmsg_shm_ref travels in the buffer.
+ *
+ * Returns 0 on success and an appropriate error value on failure.
+ */
+int rpmsg_send_shm_offchannel(struct rpmsg_channel *rpdev, u32 src, u32 dst,
+					u32 offset, u32 len, bool wait)
+{
+	struct rpmsg_shm_ref ref;
+
+	if (!rpdev->shm.va)
+		return -ENODEV;
+
+	if (offset > rpdev->shm.len || len > rpdev->shm.len - offset)
+		return -EINVAL;
+
+	ref.da = rpdev->shm.da + offset;
+	ref.len = len;
+
+	return __rpmsg_send(rpdev, src, dst, &ref, sizeof(ref), RPMSG_F_SHM,
+									wait);
+}
+EXPORT_SYMBOL(rpmsg_send_shm_offchannel);
+
+/*
+ * resolve a message sent by reference to the shared region of the
+ * endpoint's channel, returns the payload or NULL if it's not valid
+ */
+static void *rpmsg_shm_resolve(struct rpmsg_endpoint *ept,
+				struct rpmsg_hdr *msg, int *len)
+{
+	struct rpmsg_shm_ref *ref = (struct rpmsg_shm_ref *)msg->data;
+	struct rpmsg_shm *shm;
+	u32 offset;
+
+	if (!ept->rpdev || msg->len != sizeof(*ref))
+		return NULL;
+
+	shm = &ept->rpdev->shm;
+	if (!shm->va)
+		return NULL;
+
+	offset = ref->da - shm->da;
+	if (ref->da < shm->da || offset > shm->len ||
+					ref->len > shm->len - offset)
+		return NULL;
+
+	*len = ref->len;
+	return shm->va + offset;
+}
+
+/* digest one received message, and give its buffer back to the rx vring */
+static void rpmsg_recv_single(struct virtproc_info *vrp, struct device *dev,
+				struct rpmsg_hdr *msg, unsigned int len)
+{
 	struct rpmsg_endpoint *ept;
 	struct scatterlist sg;
-	struct virtproc_info *vrp = rvq->vdev->priv;
-	struct device *dev = &rvq->vdev->dev;
 	int err;
 
-	mutex_lock(&vrp->rx_lock);
-	msg = virtqueue_get_buf(rvq, &len);
-	if (!msg) {
-		mutex_unlock(&vrp->rx_lock);
-		dev_err(dev, "uhm, incoming signal, but no used buffer ?\n");
-		return;
-	}
-
 	dev_dbg(dev, "From: 0x%x, To: 0x%x, Len: %d, Flags: %d, Reserved: %d\n",
 					msg->src, msg->dst, msg->len,
 					msg->flags, msg->reserved);
@@ -797,9 +1084,8 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 	 * We currently use fixed-sized buffers, so trivially sanitize
 	 * the reported payload length.
 	 */
-	if (len > RPMSG_BUF_SIZE ||
+	if (len > vrp->buf_size ||
 		msg->len > (len - sizeof(struct rpmsg_hdr))) {
-		mutex_unlock(&vrp->rx_lock);
 		dev_warn(dev, "inbound msg too big: (%d, %d)\n", len, msg->len);
 		return;
 	}
@@ -816,11 +1102,21 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 	mutex_unlock(&vrp->endpoints_lock);
 
 	if (ept) {
+		void *data = msg->data;
+		int data_len = msg->len;
+
+		/* payloads passed by reference are handed over in place */
+		if (msg->flags & RPMSG_F_SHM) {
+			data = rpmsg_shm_resolve(ept, msg, &data_len);
+			if (!data)
+				dev_warn(dev, "bad shm msg for 0x%x\n", msg->dst);
+		}
+
 		/* make sure ept->cb doesn't go away while we use it */
 		mutex_lock(&ept->cb_lock);
 
-		if (ept->cb)
-			ept->cb(ept->rpdev, msg->data, msg->len, ept->priv,
+		if (ept->cb && data)
+			ept->cb(ept->rpdev, data, data_len, ept->priv,
 				msg->src);
 
 		mutex_unlock(&ept->cb_lock);
@@ -831,21 +1127,71 @@ static void rpmsg_recv_done(struct virtqueue *rvq)
 		dev_warn(dev, "msg received with no recepient\n");
 
 	/* publish the real size of the buffer */
-	sg_init_one(&sg, msg, RPMSG_BUF_SIZE);
+	sg_init_one(&sg, msg, vrp->buf_size);
 
 	/* add the buffer back to the remote processor's virtqueue */
 	err = virtqueue_add_buf(vrp->rvq, &sg, 0, 1, msg, GFP_KERNEL);
-	if (err < 0) {
-		mutex_unlock(&vrp->rx_lock);
+	if (err < 0)
 		dev_err(dev, "failed to add a virtqueue buffer: %d\n", err);
-		return;
+}
+
+/*
+ * Drain the rx vring, NAPI style: notifications from the remote processor
+ * are turned off while there are used buffers to process, and turned back
+ * on once the ring is empty. After @rx_budget messages we yield, and
+ * rx_work picks up where we left.
+ */
+static void rpmsg_rx_poll(struct virtproc_info *vrp)
+{
+	struct virtqueue *rvq = vrp->rvq;
+	struct device *dev = &rvq->vdev->dev;
+	unsigned int budget = vrp->rx_budget ? : 1;
+	unsigned int done = 0, len;
+	struct rpmsg_hdr *msg;
+
+	mutex_lock(&vrp->rx_lock);
+
+	virtqueue_disable_cb(rvq);
+
+	while (done < budget) {
+		msg = virtqueue_get_buf(rvq, &len);
+		if (!msg) {
+			/* empty: re-enable notifications, unless more raced in */
+			if (virtqueue_enable_cb(rvq))
+				break;
+			virtqueue_disable_cb(rvq);
+			continue;
+		}
+
+		rpmsg_recv_single(vrp, dev, msg, len);
+		done++;
 	}
 
-	/* tell the remote processor we added another available rx buffer */
-	virtqueue_kick(vrp->rvq);
+	/* out of budget, notifications stay off until rx_work drains the rest */
+	if (done == budget)
+		schedule_work(&vrp->rx_work);
+
+	/* tell the remote processor we added more available rx buffers */
+	if (done)
+		virtqueue_kick(rvq);
+
 	mutex_unlock(&vrp->rx_lock);
 }
 
+static void rpmsg_rx_work(struct work_struct *work)
+{
+	struct virtproc_info *vrp = container_of(work, struct virtproc_info,
+								rx_work);
+
+	rpmsg_rx_poll(vrp);
+}
+
+/* called when an rx buffer is used, and it's time to digest messages */
+static void rpmsg_recv_done(struct virtqueue *rvq)
+{
+	rpmsg_rx_poll(rvq->vdev->priv);
+}
+
 /*
  * This is invoked whenever the remote processor completed processing
  * a TX msg we just sent it, and the buffer is put back to the used ring.
@@ -937,6 +1283,66 @@ static void rpmsg_ns_cb(struct rpmsg_channel *rpdev, void *data, int len,
 	}
 }
 
+/* per remote processor override of the rx_budget module parameter */
+static ssize_t rx_budget_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct virtproc_info *vrp = dev_to_virtio(dev)->priv;
+
+	return sprintf(buf, "%u\n", vrp->rx_budget);
+}
+
+static ssize_t rx_budget_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct virtproc_info *vrp = dev_to_virtio(dev)->priv;
+	unsigned long val;
+
+	if (kstrtoul(buf, 0, &val) || !val || val > UINT_MAX)
+		return -EINVAL;
+
+	vrp->rx_budget = val;
+	return count;
+}
+
+static DEVICE_ATTR(rx_budget, 0644, rx_budget_show, rx_budget_store);
+
+/*
+ * pick the buffer layout: use what the remote processor asked for in
+ * its config space if it is sane, or fall back to the defaults
+ */
+static void rpmsg_size_bufs(struct virtproc_info *vrp)
+{
+	struct virtio_device *vdev = vrp->vdev;
+	struct rpmsg_config cfg;
+	unsigned int max_bufs;
+
+	vrp->num_bufs = RPMSG_NUM_BUFS;
+	vrp->buf_size = RPMSG_BUF_SIZE;
+
+	if (virtio_config_val(vdev, VIRTIO_RPMSG_F_BUFS, 0, &cfg))
+		return;
+
+	/* every buffer needs a slot in its vring */
+	max_bufs = 2 * min(virtqueue_get_vring_size(vrp->rvq),
+				virtqueue_get_vring_size(vrp->svq));
+
+	if (cfg.num_bufs < 2 || cfg.num_bufs > max_bufs ||
+	    cfg.num_bufs & 1 ||
+	    cfg.buf_size <= sizeof(struct rpmsg_hdr) +
+				sizeof(struct rpmsg_ns_msg) ||
+	    cfg.buf_size > RPMSG_MAX_BUF_SIZE ||
+	    !IS_ALIGNED(cfg.buf_size, RPMSG_BUF_ALIGN)) {
+		dev_warn(&vdev->dev, "ignoring bad buffer config: %u x %u\n",
+						cfg.num_bufs, cfg.buf_size);
+		return;
+	}
+
+	vrp->num_bufs = cfg.num_bufs;
+	vrp->buf_size = cfg.buf_size;
+}
+
 static int rpmsg_probe(struct virtio_device *vdev)
 {
 	vq_callback_t *vq_cbs[] = { rpmsg_recv_done, rpmsg_xmit_done };
@@ -944,6 +1350,7 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	struct virtqueue *vqs[2];
 	struct virtproc_info *vrp;
 	void *bufs_va;
+	size_t total;
 	int err = 0, i, vproc_id;
 
 	vrp = kzalloc(sizeof(*vrp), GFP_KERNEL);
@@ -957,6 +1364,9 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	mutex_init(&vrp->tx_lock);
 	mutex_init(&vrp->rx_lock);
 	init_waitqueue_head(&vrp->sendq);
+	atomic_set(&vrp->tx_senders, 0);
+	INIT_WORK(&vrp->rx_work, rpmsg_rx_work);
+	vrp->rx_budget = rx_budget;
 
 	if (!idr_pre_get(&vprocs, GFP_KERNEL))
 		goto free_vrp;
@@ -982,28 +1392,31 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	vrp->rvq = vqs[0];
 	vrp->svq = vqs[1];
 
+	rpmsg_size_bufs(vrp);
+	total = vrp->num_bufs * vrp->buf_size;
+
 	/* allocate coherent memory for the buffers */
-	bufs_va = dma_alloc_coherent(vdev->dev.parent->parent,
-				RPMSG_TOTAL_BUF_SPACE,
+	bufs_va = dma_alloc_coherent(vdev->dev.parent->parent, total,
 				&vrp->bufs_dma, GFP_KERNEL);
 	if (!bufs_va)
 		goto vqs_del;
 
-	dev_dbg(&vdev->dev, "buffers: va %p, dma 0x%llx\n", bufs_va,
-					(unsigned long long)vrp->bufs_dma);
+	dev_dbg(&vdev->dev, "buffers: va %p, dma 0x%llx, %u x %u\n", bufs_va,
+					(unsigned long long)vrp->bufs_dma,
+					vrp->num_bufs, vrp->buf_size);
 
 	/* half of the buffers is dedicated for RX */
 	vrp->rbufs = bufs_va;
 
 	/* and half is dedicated for TX */
-	vrp->sbufs = bufs_va + RPMSG_TOTAL_BUF_SPACE / 2;
+	vrp->sbufs = bufs_va + total / 2;
 
 	/* set up the receive buffers */
-	for (i = 0; i < RPMSG_NUM_BUFS / 2; i++) {
+	for (i = 0; i < vrp->num_bufs / 2; i++) {
 		struct scatterlist sg;
-		void *cpu_addr = vrp->rbufs + i * RPMSG_BUF_SIZE;
+		void *cpu_addr = vrp->rbufs + i * vrp->buf_size;
 
-		sg_init_one(&sg, cpu_addr, RPMSG_BUF_SIZE);
+		sg_init_one(&sg, cpu_addr, vrp->buf_size);
 
 		err = virtqueue_add_buf(vrp->rvq, &sg, 0, 1, cpu_addr,
 								GFP_KERNEL);
@@ -1027,6 +1440,9 @@ static int rpmsg_probe(struct virtio_device *vdev)
 		}
 	}
 
+	if (device_create_file(&vdev->dev, &dev_attr_rx_budget))
+		dev_warn(&vdev->dev, "failed to create rx_budget attribute\n");
+
 	/* tell the remote processor it can start sending messages */
 	virtqueue_kick(vrp->rvq);
 
@@ -1035,7 +1451,7 @@ static int rpmsg_probe(struct virtio_device *vdev)
 	return 0;
 
 free_coherent:
-	dma_free_coherent(vdev->dev.parent->parent, RPMSG_TOTAL_BUF_SPACE,
+	dma_free_coherent(vdev->dev.parent->parent, total,
 					 bufs_va, vrp->bufs_dma);
 vqs_del:
 	vdev->config->del_vqs(vrp->vdev);
@@ -1062,6 +1478,8 @@ static void __devexit rpmsg_remove(struct virtio_device *vdev)
 
 	vdev->config->reset(vdev);
 
+	device_remove_file(&vdev->dev, &dev_attr_rx_budget);
+
 	ret = device_for_each_child(&vdev->dev, NULL, rpmsg_remove_device);
 	if (ret)
 		dev_warn(&vdev->dev, "can't remove rpmsg device: %d\n", ret);
@@ -1072,10 +1490,12 @@ static void __devexit rpmsg_remove(struct virtio_device *vdev)
 	idr_remove_all(&vrp->endpoints);
 	idr_destroy(&vrp->endpoints);
 
+	cancel_work_sync(&vrp->rx_work);
 	vdev->config->del_vqs(vrp->vdev);
 
-	dma_free_coherent(vdev->dev.parent->parent, RPMSG_TOTAL_BUF_SPACE,
-					vrp->rbufs, vrp->bufs_dma);
+	dma_free_coherent(vdev->dev.parent->parent,
+				vrp->num_bufs * vrp->buf_size,
+				vrp->rbufs, vrp->bufs_dma);
 
 	mutex_lock(&vprocs_mutex);
 	idr_remove(&vprocs, vrp->id);
@@ -1091,6 +1511,7 @@ static struct virtio_device_id id_table[] = {
 
 static unsigned int features[] = {
 	VIRTIO_RPMSG_F_NS,
+	VIRTIO_RPMSG_F_BUFS,
 };
 
 static struct virtio_driver virtio_ipc_driver = {
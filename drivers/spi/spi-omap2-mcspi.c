@@ -36,6 +36,10 @@
 #include <linux/pm_runtime.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
+#include <linux/gcd.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/spi/spi.h>
 
@@ -60,6 +64,7 @@
 #define OMAP2_MCSPI_CHCTRL0		0x34
 #define OMAP2_MCSPI_TX0			0x38
 #define OMAP2_MCSPI_RX0			0x3c
+#define OMAP2_MCSPI_XFERLEVEL		0x7c
 
 /* per-register bitmasks: */
 
@@ -82,6 +87,8 @@
 #define OMAP2_MCSPI_CHCONF_IS		BIT(18)
 #define OMAP2_MCSPI_CHCONF_TURBO	BIT(19)
 #define OMAP2_MCSPI_CHCONF_FORCE	BIT(20)
+#define OMAP2_MCSPI_CHCONF_FFEW		BIT(27)
+#define OMAP2_MCSPI_CHCONF_FFER		BIT(28)
 
 #define OMAP2_MCSPI_CHSTAT_RXS		BIT(0)
 #define OMAP2_MCSPI_CHSTAT_TXS		BIT(1)
@@ -91,6 +98,10 @@
 
 #define OMAP2_MCSPI_WAKEUPENABLE_WKEN	BIT(0)
 
+/* FIFO shared by the channels, and the word counter of XFERLEVEL */
+#define OMAP2_MCSPI_MAX_FIFODEPTH	64
+#define OMAP2_MCSPI_MAX_FIFOWCNT	0xffff
+
 /* We have 2 DMA channels per CS, one for RX and one for TX */
 struct omap2_mcspi_dma {
 	int dma_tx_channel;
@@ -119,11 +130,21 @@ struct omap2_mcspi_regs {
 	struct list_head cs;
 };
 
+struct omap2_mcspi_stats {
+	unsigned long		messages;
+	unsigned long		transfers;
+	unsigned long		dma_transfers;
+	unsigned long		fifo_transfers;
+	unsigned long		dma_irqs;
+	u64			bytes;
+	u64			busy_ns;
+};
+
 struct omap2_mcspi {
-	struct work_struct	work;
-	/* lock protects queue and registers */
+	/* lock protects the statistics */
 	spinlock_t		lock;
-	struct list_head	msg_queue;
+	struct omap2_mcspi_stats stats;
+	struct dentry		*debugfs;
 	struct spi_master	*master;
 	/* Virtual base address of the controller */
 	void __iomem		*base;
@@ -131,7 +152,6 @@ struct omap2_mcspi {
 	/* SPI1 has 4 channels, while SPI2 has 2 */
 	struct omap2_mcspi_dma	*dma_channels;
 	struct device		*dev;
-	struct workqueue_struct *wq;
 	struct omap2_mcspi_regs ctx;
 };
 
@@ -288,6 +308,74 @@ static int mcspi_wait_for_reg_bit(void __iomem *reg, unsigned long bit)
 	return 0;
 }
 
+static void omap2_mcspi_account(struct omap2_mcspi *mcspi, unsigned count,
+				bool dma)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&mcspi->lock, flags);
+	mcspi->stats.transfers++;
+	if (dma)
+		mcspi->stats.dma_transfers++;
+	mcspi->stats.bytes += count;
+	spin_unlock_irqrestore(&mcspi->lock, flags);
+}
+
+static void omap2_mcspi_account_irq(struct omap2_mcspi *mcspi)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&mcspi->lock, flags);
+	mcspi->stats.dma_irqs++;
+	spin_unlock_irqrestore(&mcspi->lock, flags);
+}
+
+/*
+ * Use the FIFO for a TX only DMA transfer. The watermark is the largest
+ * FIFO level that divides the transfer, so that every DMA request moves a
+ * full frame and the channel raises as few requests as possible.
+ *
+ * Return the watermark in bytes, 0 when the FIFO isn't used.
+ */
+static unsigned omap2_mcspi_set_fifo(const struct spi_device *spi,
+				     unsigned count, int bytes_per_word)
+{
+	struct spi_master	*master = spi->master;
+	struct omap2_mcspi	*mcspi = spi_master_get_devdata(master);
+	unsigned long		flags;
+	unsigned		depth, wcnt;
+	u32			chconf;
+
+	if (count % bytes_per_word)
+		return 0;
+
+	depth = gcd(count, OMAP2_MCSPI_MAX_FIFODEPTH);
+	wcnt = count / bytes_per_word;
+	if (depth < 2 || depth % bytes_per_word ||
+	    wcnt > OMAP2_MCSPI_MAX_FIFOWCNT)
+		return 0;
+
+	mcspi_write_reg(master, OMAP2_MCSPI_XFERLEVEL,
+			(wcnt << 16) | (depth - 1));
+	chconf = mcspi_cached_chconf0(spi);
+	mcspi_write_chconf0(spi, chconf | OMAP2_MCSPI_CHCONF_FFEW);
+
+	spin_lock_irqsave(&mcspi->lock, flags);
+	mcspi->stats.fifo_transfers++;
+	spin_unlock_irqrestore(&mcspi->lock, flags);
+
+	return depth;
+}
+
+static void omap2_mcspi_clear_fifo(const struct spi_device *spi)
+{
+	u32 chconf;
+
+	chconf = mcspi_cached_chconf0(spi);
+	mcspi_write_chconf0(spi, chconf & ~OMAP2_MCSPI_CHCONF_FFEW);
+	mcspi_write_reg(spi->master, OMAP2_MCSPI_XFERLEVEL, 0);
+}
+
 static unsigned
 omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
 {
@@ -297,7 +385,9 @@ omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
 	unsigned int		count, c;
 	unsigned long		base, tx_reg, rx_reg;
 	int			word_len, data_type, element_count;
+	int			bytes_per_word;
 	int			elements = 0;
+	unsigned		fifo_depth = 0;
 	u32			l;
 	u8			* rx;
 	const u8		* tx;
@@ -321,20 +411,33 @@ omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
 
 	if (word_len <= 8) {
 		data_type = OMAP_DMA_DATA_TYPE_S8;
-		element_count = count;
+		bytes_per_word = 1;
 	} else if (word_len <= 16) {
 		data_type = OMAP_DMA_DATA_TYPE_S16;
-		element_count = count >> 1;
+		bytes_per_word = 2;
 	} else /* word_len <= 32 */ {
 		data_type = OMAP_DMA_DATA_TYPE_S32;
-		element_count = count >> 2;
+		bytes_per_word = 4;
 	}
+	element_count = count / bytes_per_word;
 
-	if (tx != NULL) {
+	if (tx != NULL && rx == NULL)
+		fifo_depth = omap2_mcspi_set_fifo(spi, count, bytes_per_word);
+
+	if (tx != NULL && fifo_depth) {
+		/* one frame per FIFO watermark */
+		omap_set_dma_transfer_params(mcspi_dma->dma_tx_channel,
+				data_type, fifo_depth / bytes_per_word,
+				count / fifo_depth, OMAP_DMA_SYNC_FRAME,
+				mcspi_dma->dma_tx_sync_dev, 0);
+	} else if (tx != NULL) {
 		omap_set_dma_transfer_params(mcspi_dma->dma_tx_channel,
 				data_type, element_count, 1,
 				OMAP_DMA_SYNC_ELEMENT,
 				mcspi_dma->dma_tx_sync_dev, 0);
+	}
+
+	if (tx != NULL) {
 
 		omap_set_dma_dest_params(mcspi_dma->dma_tx_channel, 0,
 				OMAP_DMA_AMODE_CONSTANT,
@@ -387,6 +490,9 @@ omap2_mcspi_txrx_dma(struct spi_device *spi, struct spi_transfer *xfer)
 						OMAP2_MCSPI_CHSTAT_EOT) < 0)
 				dev_err(&spi->dev, "EOT timed out\n");
 		}
+
+		if (fifo_depth)
+			omap2_mcspi_clear_fifo(spi);
 	}
 
 	if (rx != NULL) {
@@ -720,6 +826,7 @@ static void omap2_mcspi_dma_rx_callback(int lch, u16 ch_status, void *data)
 	mcspi = spi_master_get_devdata(spi->master);
 	mcspi_dma = &(mcspi->dma_channels[spi->chip_select]);
 
+	omap2_mcspi_account_irq(mcspi);
 	complete(&mcspi_dma->dma_rx_completion);
 
 	/* We must disable the DMA RX request */
@@ -735,6 +842,7 @@ static void omap2_mcspi_dma_tx_callback(int lch, u16 ch_status, void *data)
 	mcspi = spi_master_get_devdata(spi->master);
 	mcspi_dma = &(mcspi->dma_channels[spi->chip_select]);
 
+	omap2_mcspi_account_irq(mcspi);
 	complete(&mcspi_dma->dma_tx_completion);
 
 	/* We must disable the DMA TX request */
@@ -846,16 +954,16 @@ static void omap2_mcspi_cleanup(struct spi_device *spi)
 	}
 }
 
-static void omap2_mcspi_work(struct work_struct *work)
+static void omap2_mcspi_work(struct omap2_mcspi *mcspi, struct spi_message *m)
 {
-	struct omap2_mcspi	*mcspi;
-
-	mcspi = container_of(work, struct omap2_mcspi, work);
-
-	if (omap2_mcspi_enable_clocks(mcspi) < 0)
-		return;
-
-	spin_lock_irq(&mcspi->lock);
+	struct spi_device		*spi;
+	struct spi_transfer		*t = NULL;
+	int				cs_active = 0;
+	struct omap2_mcspi_cs		*cs;
+	struct omap2_mcspi_device_config *cd;
+	int				par_override = 0;
+	int				status = 0;
+	u32				chconf;
 
 	/* We only enable one channel at a time -- the one whose message is
 	 * at the head of the queue -- although this controller would gladly
@@ -863,127 +971,104 @@ static void omap2_mcspi_work(struct work_struct *work)
 	 * channel" master mode.  As a side effect, we need to manage the
 	 * chipselect with the FORCE bit ... CS != channel enable.
 	 */
-	while (!list_empty(&mcspi->msg_queue)) {
-		struct spi_message		*m;
-		struct spi_device		*spi;
-		struct spi_transfer		*t = NULL;
-		int				cs_active = 0;
-		struct omap2_mcspi_cs		*cs;
-		struct omap2_mcspi_device_config *cd;
-		int				par_override = 0;
-		int				status = 0;
-		u32				chconf;
-
-		m = container_of(mcspi->msg_queue.next, struct spi_message,
-				 queue);
-
-		list_del_init(&m->queue);
-		spin_unlock_irq(&mcspi->lock);
-
-		spi = m->spi;
-		cs = spi->controller_state;
-		cd = spi->controller_data;
+	spi = m->spi;
+	cs = spi->controller_state;
+	cd = spi->controller_data;
 
-		omap2_mcspi_set_enable(spi, 1);
-		list_for_each_entry(t, &m->transfers, transfer_list) {
-			if (t->tx_buf == NULL && t->rx_buf == NULL && t->len) {
-				status = -EINVAL;
+	omap2_mcspi_set_enable(spi, 1);
+	list_for_each_entry(t, &m->transfers, transfer_list) {
+		if (t->tx_buf == NULL && t->rx_buf == NULL && t->len) {
+			status = -EINVAL;
+			break;
+		}
+		if (par_override || t->speed_hz || t->bits_per_word) {
+			par_override = 1;
+			status = omap2_mcspi_setup_transfer(spi, t);
+			if (status < 0)
 				break;
-			}
-			if (par_override || t->speed_hz || t->bits_per_word) {
-				par_override = 1;
-				status = omap2_mcspi_setup_transfer(spi, t);
-				if (status < 0)
-					break;
-				if (!t->speed_hz && !t->bits_per_word)
-					par_override = 0;
-			}
-
-			if (!cs_active) {
-				omap2_mcspi_force_cs(spi, 1);
-				cs_active = 1;
-			}
-
-			chconf = mcspi_cached_chconf0(spi);
-			chconf &= ~OMAP2_MCSPI_CHCONF_TRM_MASK;
-			chconf &= ~OMAP2_MCSPI_CHCONF_TURBO;
-
-			if (t->tx_buf == NULL)
-				chconf |= OMAP2_MCSPI_CHCONF_TRM_RX_ONLY;
-			else if (t->rx_buf == NULL)
-				chconf |= OMAP2_MCSPI_CHCONF_TRM_TX_ONLY;
-
-			if (cd && cd->turbo_mode && t->tx_buf == NULL) {
-				/* Turbo mode is for more than one word */
-				if (t->len > ((cs->word_len + 7) >> 3))
-					chconf |= OMAP2_MCSPI_CHCONF_TURBO;
-			}
+			if (!t->speed_hz && !t->bits_per_word)
+				par_override = 0;
+		}
 
-			mcspi_write_chconf0(spi, chconf);
+		if (!cs_active) {
+			omap2_mcspi_force_cs(spi, 1);
+			cs_active = 1;
+		}
 
-			if (t->len) {
-				unsigned	count;
+		chconf = mcspi_cached_chconf0(spi);
+		chconf &= ~OMAP2_MCSPI_CHCONF_TRM_MASK;
+		chconf &= ~OMAP2_MCSPI_CHCONF_TURBO;
 
-				/* RX_ONLY mode needs dummy data in TX reg */
-				if (t->tx_buf == NULL)
-					__raw_writel(0, cs->base
-							+ OMAP2_MCSPI_TX0);
+		if (t->tx_buf == NULL)
+			chconf |= OMAP2_MCSPI_CHCONF_TRM_RX_ONLY;
+		else if (t->rx_buf == NULL)
+			chconf |= OMAP2_MCSPI_CHCONF_TRM_TX_ONLY;
 
-				if (m->is_dma_mapped || t->len >= DMA_MIN_BYTES)
-					count = omap2_mcspi_txrx_dma(spi, t);
-				else
-					count = omap2_mcspi_txrx_pio(spi, t);
-				m->actual_length += count;
+		if (cd && cd->turbo_mode && t->tx_buf == NULL) {
+			/* Turbo mode is for more than one word */
+			if (t->len > ((cs->word_len + 7) >> 3))
+				chconf |= OMAP2_MCSPI_CHCONF_TURBO;
+		}
 
-				if (count != t->len) {
-					status = -EIO;
-					break;
-				}
-			}
+		mcspi_write_chconf0(spi, chconf);
 
-			if (t->delay_usecs)
-				udelay(t->delay_usecs);
+		if (t->len) {
+			unsigned	count;
+			bool		dma;
 
-			/* ignore the "leave it on after last xfer" hint */
-			if (t->cs_change) {
-				omap2_mcspi_force_cs(spi, 0);
-				cs_active = 0;
+			/* RX_ONLY mode needs dummy data in TX reg */
+			if (t->tx_buf == NULL)
+				__raw_writel(0, cs->base
+						+ OMAP2_MCSPI_TX0);
+
+			dma = m->is_dma_mapped || t->len >= DMA_MIN_BYTES;
+			if (dma)
+				count = omap2_mcspi_txrx_dma(spi, t);
+			else
+				count = omap2_mcspi_txrx_pio(spi, t);
+			m->actual_length += count;
+			omap2_mcspi_account(mcspi, count, dma);
+
+			if (count != t->len) {
+				status = -EIO;
+				break;
 			}
 		}
 
-		/* Restore defaults if they were overriden */
-		if (par_override) {
-			par_override = 0;
-			status = omap2_mcspi_setup_transfer(spi, NULL);
-		}
+		if (t->delay_usecs)
+			udelay(t->delay_usecs);
 
-		if (cs_active)
+		/* ignore the "leave it on after last xfer" hint */
+		if (t->cs_change) {
 			omap2_mcspi_force_cs(spi, 0);
+			cs_active = 0;
+		}
+	}
 
-		omap2_mcspi_set_enable(spi, 0);
-
-		m->status = status;
-		m->complete(m->context);
-
-		spin_lock_irq(&mcspi->lock);
+	/* Restore defaults if they were overriden */
+	if (par_override) {
+		par_override = 0;
+		status = omap2_mcspi_setup_transfer(spi, NULL);
 	}
 
-	spin_unlock_irq(&mcspi->lock);
+	if (cs_active)
+		omap2_mcspi_force_cs(spi, 0);
 
-	omap2_mcspi_disable_clocks(mcspi);
+	omap2_mcspi_set_enable(spi, 0);
+
+	m->status = status;
 }
 
-static int omap2_mcspi_transfer(struct spi_device *spi, struct spi_message *m)
+/* reject invalid messages and transfers, map the buffers used with DMA */
+static int omap2_mcspi_prepare_message(struct spi_device *spi,
+				       struct spi_message *m)
 {
-	struct omap2_mcspi	*mcspi;
-	unsigned long		flags;
 	struct spi_transfer	*t;
 
 	m->actual_length = 0;
 	m->status = 0;
 
-	/* reject invalid messages and transfers */
-	if (list_empty(&m->transfers) || !m->complete)
+	if (list_empty(&m->transfers))
 		return -EINVAL;
 	list_for_each_entry(t, &m->transfers, transfer_list) {
 		const void	*tx_buf = t->tx_buf;
@@ -1036,16 +1121,113 @@ static int omap2_mcspi_transfer(struct spi_device *spi, struct spi_message *m)
 		}
 	}
 
-	mcspi = spi_master_get_devdata(spi->master);
+	return 0;
+}
+
+static int omap2_mcspi_transfer_one_message(struct spi_master *master,
+					    struct spi_message *m)
+{
+	struct omap2_mcspi	*mcspi = spi_master_get_devdata(master);
+	unsigned long		flags;
+	ktime_t			start;
+	int			status;
+
+	start = ktime_get();
+
+	status = omap2_mcspi_prepare_message(m->spi, m);
+	if (status == 0)
+		omap2_mcspi_work(mcspi, m);
+	else
+		m->status = status;
+
+	spin_lock_irqsave(&mcspi->lock, flags);
+	mcspi->stats.messages++;
+	mcspi->stats.busy_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	spin_unlock_irqrestore(&mcspi->lock, flags);
+
+	spi_finalize_current_message(master);
+	return 0;
+}
+
+static int omap2_mcspi_prepare_transfer_hardware(struct spi_master *master)
+{
+	struct omap2_mcspi	*mcspi = spi_master_get_devdata(master);
+	int			ret;
+
+	ret = omap2_mcspi_enable_clocks(mcspi);
+	return ret < 0 ? ret : 0;
+}
+
+static int omap2_mcspi_unprepare_transfer_hardware(struct spi_master *master)
+{
+	struct omap2_mcspi	*mcspi = spi_master_get_devdata(master);
+
+	omap2_mcspi_disable_clocks(mcspi);
+	return 0;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int omap2_mcspi_stats_show(struct seq_file *s, void *unused)
+{
+	struct omap2_mcspi	*mcspi = s->private;
+	struct omap2_mcspi_stats stats;
+	unsigned long		flags;
+	u64			rate = 0;
 
 	spin_lock_irqsave(&mcspi->lock, flags);
-	list_add_tail(&m->queue, &mcspi->msg_queue);
-	queue_work(mcspi->wq, &mcspi->work);
+	stats = mcspi->stats;
 	spin_unlock_irqrestore(&mcspi->lock, flags);
 
+	if (stats.busy_ns)
+		rate = div64_u64(stats.bytes * NSEC_PER_SEC, stats.busy_ns);
+
+	seq_printf(s, "messages: %lu\n", stats.messages);
+	seq_printf(s, "transfers: %lu (dma %lu, fifo %lu)\n",
+		   stats.transfers, stats.dma_transfers, stats.fifo_transfers);
+	seq_printf(s, "bytes: %llu\n", stats.bytes);
+	seq_printf(s, "busy: %llu us, %llu bytes/s\n",
+		   div_u64(stats.busy_ns, NSEC_PER_USEC), rate);
+	seq_printf(s, "dma irqs: %lu, %lu.%02lu per transfer\n",
+		   stats.dma_irqs,
+		   stats.transfers ? stats.dma_irqs / stats.transfers : 0,
+		   stats.transfers ?
+			stats.dma_irqs * 100 / stats.transfers % 100 : 0);
 	return 0;
 }
 
+static int omap2_mcspi_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, omap2_mcspi_stats_show, inode->i_private);
+}
+
+static const struct file_operations omap2_mcspi_stats_fops = {
+	.open		= omap2_mcspi_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void omap2_mcspi_debugfs_init(struct omap2_mcspi *mcspi)
+{
+	mcspi->debugfs = debugfs_create_dir(dev_name(mcspi->dev), NULL);
+	if (IS_ERR_OR_NULL(mcspi->debugfs)) {
+		mcspi->debugfs = NULL;
+		return;
+	}
+
+	debugfs_create_file("stats", S_IRUGO, mcspi->debugfs, mcspi,
+			    &omap2_mcspi_stats_fops);
+}
+
+static void omap2_mcspi_debugfs_exit(struct omap2_mcspi *mcspi)
+{
+	debugfs_remove_recursive(mcspi->debugfs);
+}
+#else
+static inline void omap2_mcspi_debugfs_init(struct omap2_mcspi *mcspi) { }
+static inline void omap2_mcspi_debugfs_exit(struct omap2_mcspi *mcspi) { }
+#endif
+
 static int __devinit omap2_mcspi_master_setup(struct omap2_mcspi *mcspi)
 {
 	struct spi_master	*master = mcspi->master;
@@ -1120,7 +1302,10 @@ static int __devinit omap2_mcspi_probe(struct platform_device *pdev)
 	master->mode_bits = SPI_CPOL | SPI_CPHA | SPI_CS_HIGH;
 
 	master->setup = omap2_mcspi_setup;
-	master->transfer = omap2_mcspi_transfer;
+	master->prepare_transfer_hardware = omap2_mcspi_prepare_transfer_hardware;
+	master->transfer_one_message = omap2_mcspi_transfer_one_message;
+	master->unprepare_transfer_hardware =
+		omap2_mcspi_unprepare_transfer_hardware;
 	master->cleanup = omap2_mcspi_cleanup;
 	master->dev.of_node = node;
 
@@ -1132,11 +1317,13 @@ static int __devinit omap2_mcspi_probe(struct platform_device *pdev)
 		of_property_read_u32(node, "ti,spi-num-cs", &num_cs);
 		master->num_chipselect = num_cs;
 		master->bus_num = bus_num++;
+		master->rt = of_property_read_bool(node, "ti,spi-rt");
 	} else {
 		pdata = pdev->dev.platform_data;
 		master->num_chipselect = pdata->num_cs;
 		if (pdev->id != -1)
 			master->bus_num = pdev->id;
+		master->rt = pdata->rt;
 	}
 	regs_offset = pdata->regs_offset;
 
@@ -1145,12 +1332,6 @@ static int __devinit omap2_mcspi_probe(struct platform_device *pdev)
 	mcspi = spi_master_get_devdata(master);
 	mcspi->master = master;
 
-	mcspi->wq = alloc_workqueue(dev_name(&pdev->dev), WQ_MEM_RECLAIM, 1);
-	if (mcspi->wq == NULL) {
-		status = -ENOMEM;
-		goto free_master;
-	}
-
 	r = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (r == NULL) {
 		status = -ENODEV;
@@ -1169,10 +1350,8 @@ static int __devinit omap2_mcspi_probe(struct platform_device *pdev)
 	}
 
 	mcspi->dev = &pdev->dev;
-	INIT_WORK(&mcspi->work, omap2_mcspi_work);
 
 	spin_lock_init(&mcspi->lock);
-	INIT_LIST_HEAD(&mcspi->msg_queue);
 	INIT_LIST_HEAD(&mcspi->ctx.cs);
 
 	mcspi->dma_channels = kcalloc(master->num_chipselect,
@@ -1225,6 +1404,8 @@ static int __devinit omap2_mcspi_probe(struct platform_device *pdev)
 	if (status < 0)
 		goto err_spi_register;
 
+	omap2_mcspi_debugfs_init(mcspi);
+
 	return status;
 
 err_spi_register:
@@ -1249,12 +1430,12 @@ static int __devexit omap2_mcspi_remove(struct platform_device *pdev)
 	mcspi = spi_master_get_devdata(master);
 	dma_channels = mcspi->dma_channels;
 
+	omap2_mcspi_debugfs_exit(mcspi);
 	omap2_mcspi_disable_clocks(mcspi);
 	pm_runtime_disable(&pdev->dev);
 
 	spi_unregister_master(master);
 	kfree(dma_channels);
-	destroy_workqueue(mcspi->wq);
 	platform_set_drvdata(pdev, NULL);
 
 	return 0;
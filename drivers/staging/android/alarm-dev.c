@@ -56,12 +56,20 @@ static uint32_t alarm_pending;
 static uint32_t alarm_enabled;
 static uint32_t wait_pending;
 
+/* wakeups avoided by firing two windowed wakeup alarms together */
+static unsigned int wakeups_saved;
+module_param(wakeups_saved, uint, S_IRUGO);
+
 struct devalarm {
 	union {
 		struct hrtimer hrt;
 		struct alarm alrm;
 	} u;
 	enum android_alarm_type type;
+	ktime_t exp;		/* requested expiry */
+	ktime_t window;		/* how late it may fire */
+	ktime_t at;		/* programmed expiry of wakeup alarms */
+	bool merged;		/* fires together with the other wakeup alarm */
 };
 
 static struct devalarm alarms[ANDROID_ALARM_TYPE_COUNT];
@@ -76,12 +84,70 @@ static int is_wakeup(enum android_alarm_type type)
 }
 
 
+static void devalarm_program(struct devalarm *alrm, ktime_t at, bool force)
+{
+	if (!(alarm_enabled & (1U << alrm->type)))
+		return;
+	if (!force && ktime_equal(at, alrm->at))
+		return;
+
+	alrm->at = at;
+	alarm_start(&alrm->u.alrm, at);
+}
+
+/*
+ * The two wakeup alarms each wake the SoC up on their own.  When the
+ * windows [exp, exp + window] of both overlap, fire both at the start of
+ * the overlap instead, which lies in both windows.  An exact alarm has an
+ * empty window and so is never moved, but a windowed one can be moved
+ * onto it.  @set is the alarm being started, NULL when one was cleared.
+ * Called with alarm_slock held.
+ */
+static void devalarm_coalesce(struct devalarm *set)
+{
+	struct devalarm *rtc = &alarms[ANDROID_ALARM_RTC_WAKEUP];
+	struct devalarm *elapsed = &alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP];
+	ktime_t rtc_offset, rtc_exp, rtc_at, elapsed_at;
+	s64 start, end;
+	bool merge = false;
+
+	rtc_at = rtc->exp;
+	elapsed_at = elapsed->exp;
+
+	if ((alarm_enabled & ANDROID_ALARM_WAKEUP_MASK) ==
+	    ANDROID_ALARM_WAKEUP_MASK) {
+		/* compare both on the boottime base */
+		rtc_offset = ktime_sub(ktime_get_real(), ktime_get_boottime());
+		rtc_exp = ktime_sub(rtc->exp, rtc_offset);
+
+		start = max(ktime_to_ns(rtc_exp), ktime_to_ns(elapsed->exp));
+		end = min(ktime_to_ns(ktime_add(rtc_exp, rtc->window)),
+			  ktime_to_ns(ktime_add(elapsed->exp, elapsed->window)));
+		if (start <= end) {
+			merge = true;
+			elapsed_at = ns_to_ktime(start);
+			rtc_at = ktime_add(elapsed_at, rtc_offset);
+		}
+	}
+
+	if (merge && !rtc->merged)
+		pr_alarm(IO, "alarm coalesce %lld\n", ktime_to_ns(elapsed_at));
+	rtc->merged = merge;
+	elapsed->merged = merge;
+
+	devalarm_program(rtc, rtc_at, set == rtc);
+	devalarm_program(elapsed, elapsed_at, set == elapsed);
+}
+
 static void devalarm_start(struct devalarm *alrm, ktime_t exp)
 {
+	alrm->exp = exp;
 	if (is_wakeup(alrm->type))
-		alarm_start(&alrm->u.alrm, exp);
+		devalarm_coalesce(alrm);
 	else
-		hrtimer_start(&alrm->u.hrt, exp, HRTIMER_MODE_ABS);
+		hrtimer_start_range_ns(&alrm->u.hrt, exp,
+				       ktime_to_ns(alrm->window),
+				       HRTIMER_MODE_ABS);
 }
 
 
@@ -103,6 +169,14 @@ static void devalarm_cancel(struct devalarm *alrm)
 		hrtimer_cancel(&alrm->u.hrt);
 }
 
+static void devalarm_clear(struct devalarm *alrm)
+{
+	alrm->merged = false;
+	devalarm_try_to_cancel(alrm);
+	if (is_wakeup(alrm->type))
+		devalarm_coalesce(NULL);
+}
+
 
 static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
@@ -139,13 +213,30 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case ANDROID_ALARM_CLEAR(0):
 		spin_lock_irqsave(&alarm_slock, flags);
 		pr_alarm(IO, "alarm %d clear\n", alarm_type);
-		devalarm_try_to_cancel(&alarms[alarm_type]);
 		if (alarm_pending) {
 			alarm_pending &= ~alarm_type_mask;
 			if (!alarm_pending && !wait_pending)
 				wake_unlock(&alarm_wake_lock);
 		}
 		alarm_enabled &= ~alarm_type_mask;
+		devalarm_clear(&alarms[alarm_type]);
+		spin_unlock_irqrestore(&alarm_slock, flags);
+		break;
+
+	case ANDROID_ALARM_SET_WINDOW(0):
+		if (copy_from_user(&tmp_time, (void __user *)arg,
+		    sizeof(tmp_time))) {
+			rv = -EFAULT;
+			goto err1;
+		}
+		if (!timespec_valid(&tmp_time)) {
+			rv = -EINVAL;
+			goto err1;
+		}
+		spin_lock_irqsave(&alarm_slock, flags);
+		pr_alarm(IO, "alarm %d window %ld.%09ld\n", alarm_type,
+			tmp_time.tv_sec, tmp_time.tv_nsec);
+		alarms[alarm_type].window = timespec_to_ktime(tmp_time);
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		break;
 
@@ -208,6 +299,8 @@ from_old_alarm_set:
 		if (rtc_dev)
 			rv = rtc_set_time(rtc_dev, &new_rtc_tm);
 		spin_lock_irqsave(&alarm_slock, flags);
+		/* the wakeup alarms moved relative to each other */
+		devalarm_coalesce(NULL);
 		alarm_pending |= ANDROID_ALARM_TIME_CHANGE_MASK;
 		wake_up(&alarm_wait_queue);
 		spin_unlock_irqrestore(&alarm_slock, flags);
@@ -265,6 +358,8 @@ static int alarm_release(struct inode *inode, struct file *file)
 					!!(alarm_pending & alarm_type_mask));
 				alarm_enabled &= ~alarm_type_mask;
 			}
+			alarms[i].window = ktime_set(0, 0);
+			alarms[i].merged = false;
 			spin_unlock_irqrestore(&alarm_slock, flags);
 			devalarm_cancel(&alarms[i]);
 			spin_lock_irqsave(&alarm_slock, flags);
@@ -291,6 +386,12 @@ static void devalarm_triggered(struct devalarm *alarm)
 	pr_alarm(INT, "devalarm_triggered type %d\n", alarm->type);
 	spin_lock_irqsave(&alarm_slock, flags);
 	if (alarm_enabled & alarm_type_mask) {
+		if (alarm->merged) {
+			wakeups_saved++;
+			alarms[ANDROID_ALARM_RTC_WAKEUP].merged = false;
+			alarms[ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP].merged =
+									false;
+		}
 		wake_lock_timeout(&alarm_wake_lock, 5 * HZ);
 		alarm_enabled &= ~alarm_type_mask;
 		alarm_pending |= alarm_type_mask;
@@ -32,6 +32,13 @@ struct ashmem_pin {
 	__u32 len;	/* length forward from offset, in bytes, page-aligned */
 };
 
+/* Returned by ASHMEM_GET_PURGE_STATS; counts since the region was created */
+struct ashmem_purge_stats {
+	__u32 purges;		/* unpinned ranges evicted under memory pressure */
+	__u32 purged_pages;	/* pages those ranges covered */
+	__u32 pin_misses;	/* ASHMEM_PIN calls that returned WAS_PURGED */
+};
+
 #define __ASHMEMIOC		0x77
 
 #define ASHMEM_SET_NAME		_IOW(__ASHMEMIOC, 1, char[ASHMEM_NAME_LEN])
@@ -44,5 +51,6 @@ struct ashmem_pin {
 #define ASHMEM_UNPIN		_IOW(__ASHMEMIOC, 8, struct ashmem_pin)
 #define ASHMEM_GET_PIN_STATUS	_IO(__ASHMEMIOC, 9)
 #define ASHMEM_PURGE_ALL_CACHES	_IO(__ASHMEMIOC, 10)
+#define ASHMEM_GET_PURGE_STATS	_IOR(__ASHMEMIOC, 11, struct ashmem_purge_stats)
 
 #endif	/* _LINUX_ASHMEM_H */
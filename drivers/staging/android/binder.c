@@ -19,6 +19,9 @@
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/idr.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
@@ -30,26 +33,117 @@
 #include <linux/rbtree.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
+#include <linux/seqlock.h>
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
 #include <linux/slab.h>
 
 #include "binder.h"
 
+/*
+ * Locking overview
+ *
+ * binder_lock protects the object graph: the proc list, every proc's
+ * thread/node/ref trees, node reference counts, todo lists, transaction
+ * stacks and the global stats. It is held for the bookkeeping part of
+ * each ioctl only.
+ *
+ * proc->alloc_lock protects a proc's buffer allocator: buffers,
+ * free_buffers, allocated_buffers, the size class caches,
+ * free_async_space and pages[]. It is taken inside binder_alloc_buf(),
+ * binder_free_buf() and the buffer lookups, and may be taken with or
+ * without binder_lock held. Page
+ * allocation and user/kernel mapping happen under it, never under
+ * binder_lock alone.
+ *
+ * proc->tmp_ref pins a target proc while binder_transaction() has
+ * dropped binder_lock to allocate and fill the target buffer. It is only
+ * modified under binder_lock; binder_deferred_release() postpones
+ * tearing down a pinned proc until the last pin is dropped.
+ *
+ * binder_procs_lock protects only the membership of binder_procs, so that
+ * binder/stats_summary can walk it without binder_lock. Procs are added
+ * and removed with both locks held. proc->counters_seq guards
+ * proc->counters; its writers are serialized by binder_lock.
+ *
+ * Lock order:
+ *	binder_lock
+ *	  binder_procs_lock
+ *	  binder_deferred_lock
+ *	  proc->alloc_lock
+ *	    mm->mmap_sem
+ *
+ * No user memory may be touched while holding proc->alloc_lock.
+ */
 static DEFINE_MUTEX(binder_lock);
 static DEFINE_MUTEX(binder_deferred_lock);
 static DEFINE_MUTEX(binder_mmap_lock);
+static DEFINE_MUTEX(binder_procs_lock);
 
 static HLIST_HEAD(binder_procs);
 static HLIST_HEAD(binder_deferred_list);
 static HLIST_HEAD(binder_dead_nodes);
 
+#ifdef CONFIG_ANDROID_BINDER_LOCK_STATS
+/*
+ * How long binder_lock is waited for and held, for comparing locking
+ * changes under a fixed load. Only the holder of binder_lock updates
+ * these. The wait is only timed when the trylock fails, so an
+ * uncontended acquisition costs a single clock read.
+ */
+static struct {
+	u64 acquired;
+	u64 contended;
+	u64 wait_ns;
+	u64 hold_ns;
+	u64 max_hold_ns;
+	ktime_t locked_at;
+} binder_lock_stats;
+
+static void binder_lock_acquire(void)
+{
+	ktime_t start;
+
+	if (!mutex_trylock(&binder_lock)) {
+		start = ktime_get();
+		mutex_lock(&binder_lock);
+		binder_lock_stats.contended++;
+		binder_lock_stats.wait_ns +=
+			ktime_to_ns(ktime_sub(ktime_get(), start));
+	}
+	binder_lock_stats.acquired++;
+	binder_lock_stats.locked_at = ktime_get();
+}
+
+static void binder_lock_release(void)
+{
+	u64 hold;
+
+	hold = ktime_to_ns(ktime_sub(ktime_get(), binder_lock_stats.locked_at));
+	binder_lock_stats.hold_ns += hold;
+	if (hold > binder_lock_stats.max_hold_ns)
+		binder_lock_stats.max_hold_ns = hold;
+	mutex_unlock(&binder_lock);
+}
+#else
+static inline void binder_lock_acquire(void)
+{
+	mutex_lock(&binder_lock);
+}
+
+static inline void binder_lock_release(void)
+{
+	mutex_unlock(&binder_lock);
+}
+#endif
+
 static struct dentry *binder_debugfs_dir_entry_root;
 static struct dentry *binder_debugfs_dir_entry_proc;
 static struct binder_node *binder_context_mgr_node;
 static uid_t binder_context_mgr_uid = -1;
 static int binder_last_id;
 static struct workqueue_struct *binder_deferred_workqueue;
+static struct workqueue_struct *binder_release_workqueue;
 
 #define BINDER_DEBUG_ENTRY(name) \
 static int binder_##name##_open(struct inode *inode, struct file *file) \
@@ -81,6 +175,33 @@ BINDER_DEBUG_ENTRY(proc);
 
 #define BINDER_SMALL_BUF_SIZE (PAGE_SIZE * 64)
 
+#define BINDER_REF_HASH_BITS	8
+#define BINDER_REF_HASH_SIZE	(1 << BINDER_REF_HASH_BITS)
+
+/*
+ * Small transactions are served from per-proc size classes: a freed
+ * buffer of class i is parked instead of being merged back into the
+ * free tree, so the next transaction of that class reuses it without
+ * touching the rbtree or the page tables.
+ */
+#define BINDER_SIZE_CLASSES		4
+#define BINDER_SIZE_CLASS_MIN_SHIFT	7	/* 128 bytes */
+#define BINDER_SIZE_CACHE_DEPTH		8
+
+/*
+ * Objects torn down per binder_lock hold when releasing a dead proc;
+ * the lock is dropped between chunks so other IPC can make progress.
+ */
+#define BINDER_RELEASE_CHUNK		32
+
+static unsigned int binder_resident_kb = 16;
+module_param_named(resident_kb, binder_resident_kb, uint, S_IWUSR | S_IRUGO);
+
+/* share of a proc's async space one sending proc may hold */
+static unsigned int binder_async_sender_quota = 50;
+module_param_named(async_sender_quota_percent, binder_async_sender_quota,
+		   uint, S_IWUSR | S_IRUGO);
+
 enum {
 	BINDER_DEBUG_USER_ERROR             = 1U << 0,
 	BINDER_DEBUG_FAILED_TRANSACTION     = 1U << 1,
@@ -148,7 +269,7 @@ enum binder_stat_types {
 
 struct binder_stats {
 	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
-	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
+	int bc[_IOC_NR(BC_REPLY_SG) + 1];
 	int obj_created[BINDER_STAT_COUNT];
 	int obj_deleted[BINDER_STAT_COUNT];
 };
@@ -211,6 +332,11 @@ struct binder_work {
 	} type;
 };
 
+struct binder_priority {
+	unsigned int sched_policy;
+	int prio;
+};
+
 struct binder_node {
 	int debug_id;
 	struct binder_work work;
@@ -231,8 +357,14 @@ struct binder_node {
 	unsigned pending_weak_ref:1;
 	unsigned has_async_transaction:1;
 	unsigned accept_fds:1;
+	unsigned sched_policy:2;
 	unsigned min_priority:8;
 	struct list_head async_todo;
+
+	/* transactions targeting this node, for profiling */
+	unsigned long stat_transactions;
+	u64 stat_bytes;
+	u64 stat_service_ns;	/* BR_TRANSACTION delivery to BC_REPLY */
 };
 
 struct binder_ref_death {
@@ -247,7 +379,7 @@ struct binder_ref {
 	/*   node => refs + procs (proc exit) */
 	int debug_id;
 	struct rb_node rb_node_desc;
-	struct rb_node rb_node_node;
+	struct hlist_node node_hash;
 	struct hlist_node node_entry;
 	struct binder_proc *proc;
 	struct binder_node *node;
@@ -257,6 +389,14 @@ struct binder_ref {
 	struct binder_ref_death *death;
 };
 
+/* Async space held in a target proc by one sending proc */
+struct binder_async_sender {
+	struct list_head entry;
+	int pid;
+	size_t used;
+	unsigned long stalls;	/* async allocations refused by quota */
+};
+
 struct binder_buffer {
 	struct list_head entry; /* free and allocated entries by address */
 	struct rb_node rb_node; /* free entry by size or allocated entry */
@@ -264,13 +404,17 @@ struct binder_buffer {
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
-	unsigned debug_id:29;
+	unsigned cached:1;	/* parked in proc->size_cache */
+	unsigned size_class:3;	/* 1-based binder_size_class, 0 if none */
+	unsigned debug_id:25;
 
 	struct binder_transaction *transaction;
 
 	struct binder_node *target_node;
+	struct binder_async_sender *async_sender;
 	size_t data_size;
 	size_t offsets_size;
+	size_t extra_buffers_size;
 	uint8_t data[0];
 };
 
@@ -280,12 +424,24 @@ enum binder_deferred_state {
 	BINDER_DEFERRED_RELEASE      = 0x04,
 };
 
+/* Lockless-readable view of a proc, see binder_stats_summary_show() */
+struct binder_proc_counters {
+	unsigned threads;
+	unsigned nodes;
+	unsigned refs;
+	unsigned transactions;
+	unsigned oneway;
+	unsigned replies;
+	unsigned sent;
+};
+
 struct binder_proc {
 	struct hlist_node proc_node;
 	struct rb_root threads;
 	struct rb_root nodes;
-	struct rb_root refs_by_desc;
-	struct rb_root refs_by_node;
+	struct rb_root refs_by_desc;	/* ordered, for walks */
+	struct idr ref_descs;		/* desc => ref */
+	struct hlist_head refs_by_node[BINDER_REF_HASH_SIZE];
 	int pid;
 	struct vm_area_struct *vma;
 	struct mm_struct *vma_vm_mm;
@@ -296,24 +452,48 @@ struct binder_proc {
 	void *buffer;
 	ptrdiff_t user_buffer_offset;
 
+	struct mutex alloc_lock;
 	struct list_head buffers;
 	struct rb_root free_buffers;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
+	struct list_head async_senders;
+	unsigned long async_stalls;
+
+	struct binder_buffer *size_cache[BINDER_SIZE_CLASSES]
+					[BINDER_SIZE_CACHE_DEPTH];
+	int size_cache_count[BINDER_SIZE_CLASSES];
+	size_t resident_size;
 
 	struct page **pages;
 	size_t buffer_size;
 	uint32_t buffer_free;
 	struct list_head todo;
 	wait_queue_head_t wait;
+	struct list_head waiting_threads; /* idle loopers, most recent first */
 	struct binder_stats stats;
+	seqcount_t counters_seq;
+	struct binder_proc_counters counters;
 	struct list_head delivered_death;
 	int max_threads;
 	int requested_threads;
 	int requested_threads_started;
-	int ready_threads;
-	long default_priority;
+	int ready_threads;	/* length of waiting_threads */
+	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
+	int tmp_ref;
+	unsigned release_pending:1;
+	unsigned batch_read:1;
+	unsigned is_dead:1;	/* being torn down by release_work */
+	struct work_struct release_work;
+	struct {
+		int threads;
+		int nodes;
+		int incoming_refs;
+		int outgoing_refs;
+		int active_transactions;
+		int buffers;
+	} released;
 };
 
 enum {
@@ -328,6 +508,7 @@ enum {
 struct binder_thread {
 	struct binder_proc *proc;
 	struct rb_node rb_node;
+	struct list_head waiting_thread_node;
 	int pid;
 	int looper;
 	struct binder_transaction *transaction_stack;
@@ -338,6 +519,8 @@ struct binder_thread {
 		/* we are also waiting on */
 	wait_queue_head_t wait;
 	struct binder_stats stats;
+	/* proc owed a wakeup for oneway work queued by this write */
+	struct binder_proc *pending_wake;
 };
 
 struct binder_transaction {
@@ -354,109 +537,119 @@ struct binder_transaction {
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
 	uid_t	sender_euid;
+	ktime_t	start_time;
+	ktime_t	delivered_time;
 };
 
+#define CREATE_TRACE_POINTS
+#include "binder_trace.h"
+
 static void
 binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer);
+static void binder_wakeup_proc(struct binder_proc *proc);
+
+/* Called with binder_lock held */
+static inline void binder_proc_count(struct binder_proc *proc,
+				     unsigned *counter, int delta)
+{
+	write_seqcount_begin(&proc->counters_seq);
+	*counter += delta;
+	write_seqcount_end(&proc->counters_seq);
+}
 
 /*
- * copied from get_unused_fd_flags
+ * copied from __put_unused_fd in open.c
  */
-int task_get_unused_fd_flags(struct binder_proc *proc, int flags)
+static void __put_unused_fd(struct files_struct *files, unsigned int fd)
+{
+	struct fdtable *fdt = files_fdtable(files);
+	__clear_open_fd(fd, fdt);
+	if (fd < files->next_fd)
+		files->next_fd = fd;
+}
+
+/*
+ * Reserve and install @count descriptors for @file[] in @proc, taking
+ * files->file_lock once for the whole set. Based on get_unused_fd_flags
+ * and fd_install. On failure no descriptor is left reserved and the
+ * caller still owns the file references.
+ */
+static int task_install_fds(struct binder_proc *proc, struct file **file,
+			    int *fd, int count, int flags)
 {
 	struct files_struct *files = proc->files;
-	int fd, error;
 	struct fdtable *fdt;
 	unsigned long rlim_cur;
 	unsigned long irqs;
+	int i, error;
 
 	if (files == NULL)
 		return -ESRCH;
 
-	error = -EMFILE;
-	spin_lock(&files->file_lock);
-
-repeat:
-	fdt = files_fdtable(files);
-	fd = find_next_zero_bit(fdt->open_fds, fdt->max_fds, files->next_fd);
-
-	/*
-	 * N.B. For clone tasks sharing a files structure, this test
-	 * will limit the total number of files that can be opened.
-	 */
 	rlim_cur = 0;
 	if (lock_task_sighand(proc->tsk, &irqs)) {
 		rlim_cur = proc->tsk->signal->rlim[RLIMIT_NOFILE].rlim_cur;
 		unlock_task_sighand(proc->tsk, &irqs);
 	}
-	if (fd >= rlim_cur)
-		goto out;
 
-	/* Do we need to expand the fd array or fd set?  */
-	error = expand_files(files, fd);
-	if (error < 0)
-		goto out;
+	spin_lock(&files->file_lock);
+	for (i = 0; i < count; i++) {
+repeat:
+		fdt = files_fdtable(files);
+		fd[i] = find_next_zero_bit(fdt->open_fds, fdt->max_fds,
+					   files->next_fd);
 
-	if (error) {
 		/*
-		 * If we needed to expand the fs array we
-		 * might have blocked - try again.
+		 * N.B. For clone tasks sharing a files structure, this test
+		 * will limit the total number of files that can be opened.
 		 */
 		error = -EMFILE;
-		goto repeat;
-	}
+		if (fd[i] >= rlim_cur)
+			goto err;
 
-	__set_open_fd(fd, fdt);
-	if (flags & O_CLOEXEC)
-		__set_close_on_exec(fd, fdt);
-	else
-		__clear_close_on_exec(fd, fdt);
-	files->next_fd = fd + 1;
-#if 1
-	/* Sanity check */
-	if (fdt->fd[fd] != NULL) {
-		printk(KERN_WARNING "get_unused_fd: slot %d not NULL!\n", fd);
-		fdt->fd[fd] = NULL;
+		/* Do we need to expand the fd array or fd set?  */
+		error = expand_files(files, fd[i]);
+		if (error < 0)
+			goto err;
+		if (error) {
+			/*
+			 * If we needed to expand the fs array we
+			 * might have blocked - try again.
+			 */
+			goto repeat;
+		}
+
+		__set_open_fd(fd[i], fdt);
+		if (flags & O_CLOEXEC)
+			__set_close_on_exec(fd[i], fdt);
+		else
+			__clear_close_on_exec(fd[i], fdt);
+		files->next_fd = fd[i] + 1;
+		/* Sanity check */
+		if (fdt->fd[fd[i]] != NULL) {
+			printk(KERN_WARNING "get_unused_fd: slot %d not NULL!\n",
+			       fd[i]);
+			fdt->fd[fd[i]] = NULL;
+		}
 	}
-#endif
-	error = fd;
 
-out:
+	fdt = files_fdtable(files);
+	for (i = 0; i < count; i++)
+		rcu_assign_pointer(fdt->fd[fd[i]], file[i]);
 	spin_unlock(&files->file_lock);
-	return error;
-}
-
-/*
- * copied from fd_install
- */
-static void task_fd_install(
-	struct binder_proc *proc, unsigned int fd, struct file *file)
-{
-	struct files_struct *files = proc->files;
-	struct fdtable *fdt;
-
-	if (files == NULL)
-		return;
+	return 0;
 
-	spin_lock(&files->file_lock);
+err:
 	fdt = files_fdtable(files);
-	BUG_ON(fdt->fd[fd] != NULL);
-	rcu_assign_pointer(fdt->fd[fd], file);
+	while (--i >= 0) {
+		__clear_close_on_exec(fd[i], fdt);
+		__put_unused_fd(files, fd[i]);
+	}
 	spin_unlock(&files->file_lock);
-}
-
-/*
- * copied from __put_unused_fd in open.c
- */
-static void __put_unused_fd(struct files_struct *files, unsigned int fd)
-{
-	struct fdtable *fdt = files_fdtable(files);
-	__clear_open_fd(fd, fdt);
-	if (fd < files->next_fd)
-		files->next_fd = fd;
+	return error;
 }
 
 /*
@@ -499,21 +692,126 @@ out_unlock:
 	return -EBADF;
 }
 
-static void binder_set_nice(long nice)
+static bool is_rt_policy(int policy)
 {
-	long min_nice;
-	if (can_nice(current, nice)) {
-		set_user_nice(current, nice);
-		return;
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+/* Kernel priorities: 0..MAX_RT_PRIO-1 for RT, MAX_RT_PRIO + 20 + nice */
+static int to_userspace_prio(int policy, int kernel_priority)
+{
+	if (is_rt_policy(policy))
+		return MAX_USER_RT_PRIO - 1 - kernel_priority;
+	else
+		return kernel_priority - MAX_RT_PRIO - 20;
+}
+
+static int to_kernel_prio(int policy, int user_priority)
+{
+	if (is_rt_policy(policy))
+		return MAX_USER_RT_PRIO - 1 - user_priority;
+	else
+		return MAX_RT_PRIO + 20 + user_priority;
+}
+
+static struct binder_priority binder_task_priority(struct task_struct *task)
+{
+	struct binder_priority p;
+
+	if (is_rt_policy(task->policy)) {
+		p.sched_policy = task->policy;
+		p.prio = task->normal_prio;
+	} else {
+		p.sched_policy = SCHED_NORMAL;
+		p.prio = task->static_prio;
 	}
-	min_nice = 20 - current->signal->rlim[RLIMIT_NICE].rlim_cur;
-	binder_debug(BINDER_DEBUG_PRIORITY_CAP,
-		     "binder: %d: nice value %ld not allowed use "
-		     "%ld instead\n", current->pid, nice, min_nice);
-	set_user_nice(current, min_nice);
-	if (min_nice < 20)
+	return p;
+}
+
+/*
+ * Move current to @desired. When @verify is set the request is capped
+ * by current's own CAP_SYS_NICE, RLIMIT_RTPRIO and RLIMIT_NICE, the way
+ * binder has always treated inherited nice values; restoring a thread's
+ * saved priority is never capped.
+ */
+static void binder_set_priority(struct binder_priority desired, bool verify)
+{
+	struct task_struct *task = current;
+	int policy = desired.sched_policy;
+	int priority;
+	bool has_cap_nice;
+
+	if (task->policy == policy && task->normal_prio == desired.prio)
 		return;
-	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
+
+	has_cap_nice = has_capability_noaudit(task, CAP_SYS_NICE);
+	priority = to_userspace_prio(policy, desired.prio);
+
+	if (verify && is_rt_policy(policy) && !has_cap_nice) {
+		long max_rtprio = task_rlimit(task, RLIMIT_RTPRIO);
+
+		if (max_rtprio == 0) {
+			policy = SCHED_NORMAL;
+			priority = -20;
+		} else if (priority > max_rtprio) {
+			priority = max_rtprio;
+		}
+	}
+	if (verify && !is_rt_policy(policy) && !has_cap_nice) {
+		long min_nice = 20 - task_rlimit(task, RLIMIT_NICE);
+
+		if (priority < min_nice)
+			priority = min_nice;
+		if (min_nice >= 20)
+			binder_user_error("binder: %d RLIMIT_NICE not set\n",
+					  task->pid);
+	}
+	if (policy != desired.sched_policy ||
+	    to_kernel_prio(policy, priority) != desired.prio)
+		binder_debug(BINDER_DEBUG_PRIORITY_CAP,
+			     "binder: %d: priority %d:%d not allowed, "
+			     "using %d:%d instead\n", task->pid,
+			     desired.sched_policy, desired.prio, policy,
+			     to_kernel_prio(policy, priority));
+
+	if (task->policy != policy || is_rt_policy(policy)) {
+		struct sched_param params;
+
+		params.sched_priority = is_rt_policy(policy) ? priority : 0;
+		sched_setscheduler_nocheck(task, policy | SCHED_RESET_ON_FORK,
+					   &params);
+	}
+	if (!is_rt_policy(policy))
+		set_user_nice(task, priority);
+}
+
+/*
+ * Node minimum priority from its flat_binder_object flags: an RT
+ * priority for SCHED_FIFO/SCHED_RR nodes, otherwise a nice value where
+ * anything above 19 means no minimum.
+ */
+static struct binder_priority binder_node_min_priority(struct binder_node *node)
+{
+	struct binder_priority p;
+
+	p.sched_policy = node->sched_policy;
+	if (is_rt_policy(p.sched_policy) &&
+	    node->min_priority > 0 && node->min_priority < MAX_USER_RT_PRIO) {
+		p.prio = to_kernel_prio(p.sched_policy, node->min_priority);
+	} else {
+		p.sched_policy = SCHED_NORMAL;
+		p.prio = to_kernel_prio(SCHED_NORMAL,
+					min_t(int, node->min_priority, 19));
+		if (node->min_priority > 19)
+			p.prio = MAX_PRIO;	/* weaker than any task */
+	}
+	return p;
+}
+
+static bool binder_priority_higher(struct binder_priority a,
+				   struct binder_priority b)
+{
+	return a.prio < b.prio;
 }
 
 static size_t binder_buffer_size(struct binder_proc *proc,
@@ -608,6 +906,35 @@ static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 	return NULL;
 }
 
+/*
+ * Unmap and free the non-resident pages of [start, end).  The range is
+ * unmapped in one go, so that it costs one TLB invalidate per address
+ * space rather than one per page.
+ */
+static void binder_free_page_range(struct binder_proc *proc,
+				   void *start, void *end,
+				   struct vm_area_struct *vma)
+{
+	void *page_addr;
+	struct page **page;
+
+	if (start < proc->buffer + proc->resident_size)
+		start = proc->buffer + proc->resident_size;
+	if (end <= start)
+		return;
+
+	if (vma)
+		zap_page_range(vma, (uintptr_t)start + proc->user_buffer_offset,
+			       end - start, NULL);
+	unmap_kernel_range((unsigned long)start, end - start);
+
+	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
+		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
+		__free_page(*page);
+		*page = NULL;
+	}
+}
+
 static int binder_update_page_range(struct binder_proc *proc, int allocate,
 				    void *start, void *end,
 				    struct vm_area_struct *vma)
@@ -654,6 +981,8 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		struct page **page_array_ptr;
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 
+		if (page_addr < proc->buffer + proc->resident_size)
+			continue;
 		BUG_ON(*page);
 		*page = alloc_page(GFP_KERNEL | __GFP_ZERO);
 		if (*page == NULL) {
@@ -688,21 +1017,13 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	}
 	return 0;
 
-free_range:
-	for (page_addr = end - PAGE_SIZE; page_addr >= start;
-	     page_addr -= PAGE_SIZE) {
-		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
-		if (vma)
-			zap_page_range(vma, (uintptr_t)page_addr +
-				proc->user_buffer_offset, PAGE_SIZE, NULL);
 err_vm_insert_page_failed:
-		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
 err_map_kernel_failed:
-		__free_page(*page);
-		*page = NULL;
+	page_addr += PAGE_SIZE;
 err_alloc_page_failed:
-		;
-	}
+	end = page_addr;
+free_range:
+	binder_free_page_range(proc, start, end, vma);
 err_no_vma:
 	if (mm) {
 		up_write(&mm->mmap_sem);
@@ -711,9 +1032,11 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+static struct binder_buffer *binder_alloc_buf_locked(struct binder_proc *proc,
+						     size_t data_size,
+						     size_t offsets_size,
+						     size_t extra_buffers_size,
+						     int is_async)
 {
 	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -732,11 +1055,14 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	size = ALIGN(data_size, sizeof(void *)) +
 		ALIGN(offsets_size, sizeof(void *));
 
-	if (size < data_size || size < offsets_size) {
+	if (size < data_size || size < offsets_size ||
+	    size + extra_buffers_size < size) {
 		binder_user_error("binder: %d: got transaction with invalid "
-			"size %zd-%zd\n", proc->pid, data_size, offsets_size);
+			"size %zd-%zd-%zd\n", proc->pid, data_size,
+			offsets_size, extra_buffers_size);
 		return NULL;
 	}
+	size += extra_buffers_size;
 
 	if (is_async &&
 	    proc->free_async_space < size + sizeof(struct binder_buffer)) {
@@ -805,6 +1131,69 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		     "%p\n", proc->pid, size, buffer);
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
+	buffer->extra_buffers_size = extra_buffers_size;
+	buffer->async_transaction = is_async;
+	buffer->allow_user_free = 0;
+	buffer->transaction = NULL;
+	buffer->target_node = NULL;
+	if (is_async) {
+		proc->free_async_space -= size + sizeof(struct binder_buffer);
+		binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
+			     "binder: %d: binder_alloc_buf size %zd "
+			     "async free %zd\n", proc->pid, size,
+			     proc->free_async_space);
+	}
+
+	return buffer;
+}
+
+static int binder_size_class(size_t size)
+{
+	int class;
+
+	for (class = 0; class < BINDER_SIZE_CLASSES; class++)
+		if (size <= (1U << (BINDER_SIZE_CLASS_MIN_SHIFT + class)))
+			return class;
+	return -1;
+}
+
+static struct binder_buffer *binder_alloc_buf_class(struct binder_proc *proc,
+						    int class, size_t data_size,
+						    size_t offsets_size,
+						    size_t extra_buffers_size,
+						    int is_async)
+{
+	struct binder_buffer *buffer;
+	size_t size = ALIGN(data_size, sizeof(void *)) +
+		ALIGN(offsets_size, sizeof(void *)) + extra_buffers_size;
+
+	if (proc->vma == NULL)
+		return NULL;
+
+	if (is_async &&
+	    proc->free_async_space < size + sizeof(struct binder_buffer)) {
+		binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+			     "binder: %d: binder_alloc_buf size %zd"
+			     "failed, no async space left\n", proc->pid, size);
+		return NULL;
+	}
+
+	if (proc->size_cache_count[class]) {
+		buffer = proc->size_cache[class]
+				[--proc->size_cache_count[class]];
+		BUG_ON(!buffer->cached || buffer->free);
+		buffer->cached = 0;
+	} else {
+		buffer = binder_alloc_buf_locked(proc,
+			1U << (BINDER_SIZE_CLASS_MIN_SHIFT + class), 0, 0, 0);
+		if (buffer == NULL)
+			return NULL;
+		buffer->size_class = class + 1;
+	}
+
+	buffer->data_size = data_size;
+	buffer->offsets_size = offsets_size;
+	buffer->extra_buffers_size = extra_buffers_size;
 	buffer->async_transaction = is_async;
 	if (is_async) {
 		proc->free_async_space -= size + sizeof(struct binder_buffer);
@@ -813,7 +1202,101 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 			     "async free %zd\n", proc->pid, size,
 			     proc->free_async_space);
 	}
+	return buffer;
+}
+
+static size_t binder_async_size(struct binder_buffer *buffer)
+{
+	return ALIGN(buffer->data_size, sizeof(void *)) +
+		ALIGN(buffer->offsets_size, sizeof(void *)) +
+		buffer->extra_buffers_size + sizeof(struct binder_buffer);
+}
+
+static struct binder_async_sender *
+binder_get_async_sender(struct binder_proc *proc, int pid)
+{
+	struct binder_async_sender *sender;
+
+	list_for_each_entry(sender, &proc->async_senders, entry)
+		if (sender->pid == pid)
+			return sender;
+
+	sender = kzalloc(sizeof(*sender), GFP_KERNEL);
+	if (sender == NULL)
+		return NULL;
+	sender->pid = pid;
+	list_add_tail(&sender->entry, &proc->async_senders);
+	return sender;
+}
+
+/*
+ * Oneway buffers are also charged to the sending proc, which may hold
+ * at most async_sender_quota_percent of the target's async space, so a
+ * single chatty sender cannot lock every other client out of it.
+ */
+static bool binder_async_quota_ok(struct binder_proc *proc,
+				  struct binder_async_sender *sender,
+				  size_t size)
+{
+	size_t quota = proc->buffer_size / 2 / 100 *
+		min(binder_async_sender_quota, 100U);
+
+	size += sizeof(struct binder_buffer);
+	if (size <= proc->free_async_space && sender->used + size <= quota)
+		return true;
+
+	sender->stalls++;
+	proc->async_stalls++;
+	binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
+		     "binder: %d: async alloc size %zd from %d stalled, "
+		     "sender holds %zd of %zd, %zd free\n", proc->pid, size,
+		     sender->pid, sender->used, quota, proc->free_async_space);
+	return false;
+}
+
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size,
+					      size_t extra_buffers_size,
+					      int is_async, int sender_pid)
+{
+	struct binder_buffer *buffer;
+	struct binder_async_sender *sender = NULL;
+	bool overflow;
+	size_t size;
+	int class;
 
+	size = ALIGN(data_size, sizeof(void *)) +
+		ALIGN(offsets_size, sizeof(void *));
+	overflow = size < data_size || size < offsets_size ||
+		size + extra_buffers_size < size;
+	/* an overflowed size is rejected by binder_alloc_buf_locked() */
+	class = overflow ? -1 : binder_size_class(size + extra_buffers_size);
+
+	mutex_lock(&proc->alloc_lock);
+	if (is_async) {
+		sender = binder_get_async_sender(proc, sender_pid);
+		if (sender == NULL ||
+		    (!overflow &&
+		     !binder_async_quota_ok(proc, sender,
+					    size + extra_buffers_size))) {
+			mutex_unlock(&proc->alloc_lock);
+			return NULL;
+		}
+	}
+	if (class >= 0)
+		buffer = binder_alloc_buf_class(proc, class, data_size,
+						offsets_size,
+						extra_buffers_size, is_async);
+	else
+		buffer = binder_alloc_buf_locked(proc, data_size, offsets_size,
+						 extra_buffers_size, is_async);
+	if (buffer) {
+		buffer->async_sender = sender;
+		if (sender)
+			sender->used += binder_async_size(buffer);
+	}
+	mutex_unlock(&proc->alloc_lock);
 	return buffer;
 }
 
@@ -874,15 +1357,16 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
-static void binder_free_buf(struct binder_proc *proc,
-			    struct binder_buffer *buffer)
+static void binder_free_buf_locked(struct binder_proc *proc,
+				   struct binder_buffer *buffer)
 {
 	size_t size, buffer_size;
 
 	buffer_size = binder_buffer_size(proc, buffer);
 
 	size = ALIGN(buffer->data_size, sizeof(void *)) +
-		ALIGN(buffer->offsets_size, sizeof(void *));
+		ALIGN(buffer->offsets_size, sizeof(void *)) +
+		buffer->extra_buffers_size;
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: binder_free_buf %p size %zd buffer"
@@ -929,6 +1413,85 @@ static void binder_free_buf(struct binder_proc *proc,
 	binder_insert_free_buffer(proc, buffer);
 }
 
+/*
+ * Return a size class buffer to its cache, or hand it back to the
+ * general allocator, with the class footprint, when the cache is full
+ * or the mapping is gone.
+ */
+static void binder_free_buf_class(struct binder_proc *proc,
+				  struct binder_buffer *buffer)
+{
+	int class = buffer->size_class - 1;
+
+	BUG_ON(buffer->free || buffer->cached);
+	BUG_ON(buffer->transaction != NULL);
+
+	if (buffer->async_transaction) {
+		proc->free_async_space +=
+			ALIGN(buffer->data_size, sizeof(void *)) +
+			ALIGN(buffer->offsets_size, sizeof(void *)) +
+			buffer->extra_buffers_size +
+			sizeof(struct binder_buffer);
+		binder_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
+			     "binder: %d: binder_free_buf async free %zd\n",
+			     proc->pid, proc->free_async_space);
+	}
+	buffer->async_transaction = 0;
+	buffer->allow_user_free = 0;
+	buffer->target_node = NULL;
+
+	if (proc->vma &&
+	    proc->size_cache_count[class] < BINDER_SIZE_CACHE_DEPTH) {
+		buffer->cached = 1;
+		proc->size_cache[class][proc->size_cache_count[class]++] =
+			buffer;
+		return;
+	}
+
+	buffer->size_class = 0;
+	buffer->data_size = 1U << (BINDER_SIZE_CLASS_MIN_SHIFT + class);
+	buffer->offsets_size = 0;
+	buffer->extra_buffers_size = 0;
+	binder_free_buf_locked(proc, buffer);
+}
+
+static void binder_free_buf(struct binder_proc *proc,
+			    struct binder_buffer *buffer)
+{
+	mutex_lock(&proc->alloc_lock);
+	if (buffer->async_transaction && buffer->async_sender) {
+		buffer->async_sender->used -= binder_async_size(buffer);
+		buffer->async_sender = NULL;
+	}
+	if (buffer->size_class)
+		binder_free_buf_class(proc, buffer);
+	else
+		binder_free_buf_locked(proc, buffer);
+	mutex_unlock(&proc->alloc_lock);
+}
+
+static void binder_drain_size_cache(struct binder_proc *proc)
+{
+	struct binder_buffer *buffer;
+	int class;
+
+	mutex_lock(&proc->alloc_lock);
+	for (class = 0; class < BINDER_SIZE_CLASSES; class++) {
+		while (proc->size_cache_count[class]) {
+			buffer = proc->size_cache[class]
+					[--proc->size_cache_count[class]];
+			buffer->cached = 0;
+			buffer->size_class = 0;
+			buffer->data_size = 1U <<
+				(BINDER_SIZE_CLASS_MIN_SHIFT + class);
+			buffer->offsets_size = 0;
+			buffer->extra_buffers_size = 0;
+			binder_free_buf_locked(proc, buffer);
+		}
+	}
+	mutex_unlock(&proc->alloc_lock);
+}
+
 static struct binder_node *binder_get_node(struct binder_proc *proc,
 					   void __user *ptr)
 {
@@ -974,6 +1537,7 @@ static struct binder_node *binder_new_node(struct binder_proc *proc,
 	binder_stats_created(BINDER_STAT_NODE);
 	rb_link_node(&node->rb_node, parent, p);
 	rb_insert_color(&node->rb_node, &proc->nodes);
+	binder_proc_count(proc, &proc->counters.nodes, 1);
 	node->debug_id = ++binder_last_id;
 	node->proc = proc;
 	node->ptr = ptr;
@@ -1041,7 +1605,7 @@ static int binder_dec_node(struct binder_node *node, int strong, int internal)
 	if (node->proc && (node->has_strong_ref || node->has_weak_ref)) {
 		if (list_empty(&node->work.entry)) {
 			list_add_tail(&node->work.entry, &node->proc->todo);
-			wake_up_interruptible(&node->proc->wait);
+			binder_wakeup_proc(node->proc);
 		}
 	} else {
 		if (hlist_empty(&node->refs) && !node->local_strong_refs &&
@@ -1049,6 +1613,8 @@ static int binder_dec_node(struct binder_node *node, int strong, int internal)
 			list_del_init(&node->work.entry);
 			if (node->proc) {
 				rb_erase(&node->rb_node, &node->proc->nodes);
+				binder_proc_count(node->proc,
+						  &node->proc->counters.nodes, -1);
 				binder_debug(BINDER_DEBUG_INTERNAL_REFS,
 					     "binder: refless node %d deleted\n",
 					     node->debug_id);
@@ -1070,58 +1636,52 @@ static int binder_dec_node(struct binder_node *node, int strong, int internal)
 static struct binder_ref *binder_get_ref(struct binder_proc *proc,
 					 uint32_t desc)
 {
-	struct rb_node *n = proc->refs_by_desc.rb_node;
-	struct binder_ref *ref;
-
-	while (n) {
-		ref = rb_entry(n, struct binder_ref, rb_node_desc);
-
-		if (desc < ref->desc)
-			n = n->rb_left;
-		else if (desc > ref->desc)
-			n = n->rb_right;
-		else
-			return ref;
-	}
-	return NULL;
+	if (desc > INT_MAX)
+		return NULL;
+	return idr_find(&proc->ref_descs, desc);
 }
 
 static struct binder_ref *binder_get_ref_for_node(struct binder_proc *proc,
 						  struct binder_node *node)
 {
-	struct rb_node *n;
-	struct rb_node **p = &proc->refs_by_node.rb_node;
+	struct hlist_head *head;
+	struct hlist_node *pos;
+	struct rb_node **p;
 	struct rb_node *parent = NULL;
 	struct binder_ref *ref, *new_ref;
+	int desc, ret;
 
-	while (*p) {
-		parent = *p;
-		ref = rb_entry(parent, struct binder_ref, rb_node_node);
-
-		if (node < ref->node)
-			p = &(*p)->rb_left;
-		else if (node > ref->node)
-			p = &(*p)->rb_right;
-		else
+	head = &proc->refs_by_node[hash_ptr(node, BINDER_REF_HASH_BITS)];
+	hlist_for_each_entry(ref, pos, head, node_hash)
+		if (ref->node == node)
 			return ref;
-	}
+
 	new_ref = kzalloc(sizeof(*ref), GFP_KERNEL);
 	if (new_ref == NULL)
 		return NULL;
+
+	/* lowest free descriptor; 0 is only handed out for the context mgr */
+	do {
+		if (!idr_pre_get(&proc->ref_descs, GFP_KERNEL)) {
+			kfree(new_ref);
+			return NULL;
+		}
+		ret = idr_get_new_above(&proc->ref_descs, new_ref,
+					node == binder_context_mgr_node ? 0 : 1,
+					&desc);
+	} while (ret == -EAGAIN);
+	if (ret) {
+		kfree(new_ref);
+		return NULL;
+	}
+
 	binder_stats_created(BINDER_STAT_REF);
+	binder_proc_count(proc, &proc->counters.refs, 1);
 	new_ref->debug_id = ++binder_last_id;
 	new_ref->proc = proc;
 	new_ref->node = node;
-	rb_link_node(&new_ref->rb_node_node, parent, p);
-	rb_insert_color(&new_ref->rb_node_node, &proc->refs_by_node);
-
-	new_ref->desc = (node == binder_context_mgr_node) ? 0 : 1;
-	for (n = rb_first(&proc->refs_by_desc); n != NULL; n = rb_next(n)) {
-		ref = rb_entry(n, struct binder_ref, rb_node_desc);
-		if (ref->desc > new_ref->desc)
-			break;
-		new_ref->desc = ref->desc + 1;
-	}
+	new_ref->desc = desc;
+	hlist_add_head(&new_ref->node_hash, head);
 
 	p = &proc->refs_by_desc.rb_node;
 	while (*p) {
@@ -1161,7 +1721,8 @@ static void binder_delete_ref(struct binder_ref *ref)
 		     ref->desc, ref->node->debug_id);
 
 	rb_erase(&ref->rb_node_desc, &ref->proc->refs_by_desc);
-	rb_erase(&ref->rb_node_node, &ref->proc->refs_by_node);
+	idr_remove(&ref->proc->ref_descs, ref->desc);
+	hlist_del(&ref->node_hash);
 	if (ref->strong)
 		binder_dec_node(ref->node, 1, 1);
 	hlist_del(&ref->node_entry);
@@ -1175,6 +1736,7 @@ static void binder_delete_ref(struct binder_ref *ref)
 		kfree(ref->death);
 		binder_stats_deleted(BINDER_STAT_DEATH);
 	}
+	binder_proc_count(ref->proc, &ref->proc->counters.refs, -1);
 	kfree(ref);
 	binder_stats_deleted(BINDER_STAT_REF);
 }
@@ -1234,6 +1796,56 @@ static int binder_dec_ref(struct binder_ref *ref, int strong)
 	return 0;
 }
 
+static void binder_proc_inc_tmpref(struct binder_proc *proc)
+{
+	proc->tmp_ref++;
+}
+
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	BUG_ON(proc->tmp_ref <= 0);
+	if (--proc->tmp_ref == 0 && proc->release_pending) {
+		proc->release_pending = 0;
+		binder_defer_work(proc, BINDER_DEFERRED_RELEASE);
+	}
+}
+
+/*
+ * Wake one idle looper for work queued on proc->todo. The most recently
+ * idle thread is picked, as its stack and caches are the most likely to
+ * still be hot, and it is taken off waiting_threads so the next wakeup
+ * goes to another thread. Pollers sleep on proc->wait and are only
+ * woken when no looper is idle.
+ */
+static void binder_wakeup_proc(struct binder_proc *proc)
+{
+	struct binder_thread *thread;
+
+	if (list_empty(&proc->waiting_threads)) {
+		wake_up_interruptible(&proc->wait);
+		return;
+	}
+	thread = list_first_entry(&proc->waiting_threads, struct binder_thread,
+				  waiting_thread_node);
+	list_del_init(&thread->waiting_thread_node);
+	proc->ready_threads--;
+	wake_up_interruptible(&thread->wait);
+}
+
+/*
+ * Oneway transactions queued to proc->todo by one BINDER_WRITE_READ
+ * share a single wakeup, issued when the write is done or when the
+ * thread moves on to a different target. Must be called before
+ * binder_lock is dropped, since the pending proc is not pinned.
+ */
+static void binder_flush_wakeup(struct binder_thread *thread)
+{
+	if (thread->pending_wake) {
+		binder_wakeup_proc(thread->pending_wake);
+		thread->pending_wake = NULL;
+	}
+}
+
 static void binder_pop_transaction(struct binder_thread *target_thread,
 				   struct binder_transaction *t)
 {
@@ -1373,6 +1985,10 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 				task_close_fd(proc, fp->handle);
 			break;
 
+		case BINDER_TYPE_PTR:
+			/* segments live in the buffer itself */
+			break;
+
 		default:
 			printk(KERN_ERR "binder: transaction release %d bad "
 			       "object type %lx\n", debug_id, fp->type);
@@ -1381,10 +1997,116 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+/*
+ * Copy the segments referenced by BINDER_TYPE_PTR objects into the
+ * extra buffers area of @buffer and point the objects at the copies as
+ * seen from @target_proc. Runs without binder_lock and only touches the
+ * not yet queued buffer. Objects at bad offsets are left for the
+ * translation loop in binder_transaction() to reject.
+ */
+static int binder_copy_sg_segments(struct binder_proc *proc,
+				   struct binder_thread *thread,
+				   struct binder_proc *target_proc,
+				   struct binder_buffer *buffer)
+{
+	size_t *offp, *off_end;
+	uint8_t *sg_next, *sg_end;
+
+	BUILD_BUG_ON(sizeof(struct binder_buffer_object) !=
+		     sizeof(struct flat_binder_object));
+
+	offp = (size_t *)(buffer->data +
+			  ALIGN(buffer->data_size, sizeof(void *)));
+	off_end = (void *)offp + buffer->offsets_size;
+	sg_next = (uint8_t *)offp + ALIGN(buffer->offsets_size, sizeof(void *));
+	sg_end = sg_next + buffer->extra_buffers_size;
+
+	for (; offp < off_end; offp++) {
+		struct binder_buffer_object *bp;
+		size_t len;
+
+		if (*offp > buffer->data_size - sizeof(*bp) ||
+		    buffer->data_size < sizeof(*bp) ||
+		    !IS_ALIGNED(*offp, sizeof(void *)))
+			continue;
+		bp = (struct binder_buffer_object *)(buffer->data + *offp);
+		if (bp->type != BINDER_TYPE_PTR)
+			continue;
+
+		len = ALIGN(bp->length, sizeof(void *));
+		if (bp->flags || len < bp->length || len > sg_end - sg_next) {
+			binder_user_error("binder: %d:%d got transaction with "
+				"invalid buffer object, length %zd, %zd "
+				"left\n", proc->pid, thread->pid, bp->length,
+				(size_t)(sg_end - sg_next));
+			return -EINVAL;
+		}
+		if (copy_from_user(sg_next, bp->buffer, bp->length)) {
+			binder_user_error("binder: %d:%d got transaction with "
+				"invalid buffer object ptr\n",
+				proc->pid, thread->pid);
+			return -EFAULT;
+		}
+		binder_debug(BINDER_DEBUG_TRANSACTION,
+			     "        buffer %p size %zd -> %p\n",
+			     bp->buffer, bp->length,
+			     sg_next + target_proc->user_buffer_offset);
+		bp->buffer = sg_next + target_proc->user_buffer_offset;
+		sg_next += len;
+	}
+	return 0;
+}
+
+/*
+ * File objects of one transaction waiting to be installed in the target.
+ * Queued objects have their handle set to -1 until installed, so the
+ * error path in binder_transaction_buffer_release() cannot close an fd
+ * of the target that the transaction never created.
+ */
+#define BINDER_FD_BATCH 16
+
+struct binder_fd_batch {
+	int count;
+	struct flat_binder_object *fp[BINDER_FD_BATCH];
+	struct file *file[BINDER_FD_BATCH];
+	long src_fd[BINDER_FD_BATCH];
+};
+
+static int binder_fd_batch_flush(struct binder_proc *target_proc,
+				 struct binder_fd_batch *batch)
+{
+	int fd[BINDER_FD_BATCH];
+	int i, ret;
+
+	if (!batch->count)
+		return 0;
+	ret = task_install_fds(target_proc, batch->file, fd, batch->count,
+			       O_CLOEXEC);
+	for (i = 0; i < batch->count; i++) {
+		if (ret) {
+			fput(batch->file[i]);
+			continue;
+		}
+		binder_debug(BINDER_DEBUG_TRANSACTION,
+			     "        fd %ld -> %d\n", batch->src_fd[i], fd[i]);
+		batch->fp[i]->handle = fd[i];
+	}
+	batch->count = 0;
+	return ret;
+}
+
+static void binder_fd_batch_discard(struct binder_fd_batch *batch)
+{
+	while (batch->count)
+		fput(batch->file[--batch->count]);
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
-			       struct binder_transaction_data *tr, int reply)
+			       struct binder_transaction_data *tr, int reply,
+			       size_t extra_buffers_size)
 {
+	struct binder_fd_batch fds;
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
 	size_t *offp, *off_end;
@@ -1397,6 +2119,7 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
 
+	fds.count = 0;
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
 	e->from_proc = proc->pid;
@@ -1414,7 +2137,7 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_set_priority(in_reply_to->saved_priority, false);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad transaction stack,"
@@ -1448,6 +2171,10 @@ static void binder_transaction(struct binder_proc *proc,
 			goto err_dead_binder;
 		}
 		target_proc = target_thread->proc;
+		if (target_proc->is_dead) {
+			return_error = BR_DEAD_REPLY;
+			goto err_dead_binder;
+		}
 	} else {
 		if (tr->target.handle) {
 			struct binder_ref *ref;
@@ -1469,7 +2196,7 @@ static void binder_transaction(struct binder_proc *proc,
 		}
 		e->to_node = target_node->debug_id;
 		target_proc = target_node->proc;
-		if (target_proc == NULL) {
+		if (target_proc == NULL || target_proc->is_dead) {
 			return_error = BR_DEAD_REPLY;
 			goto err_dead_binder;
 		}
@@ -1487,21 +2214,8 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error = BR_FAILED_REPLY;
 				goto err_bad_call_stack;
 			}
-			while (tmp) {
-				if (tmp->from && tmp->from->proc == target_proc)
-					target_thread = tmp->from;
-				tmp = tmp->from_parent;
-			}
 		}
 	}
-	if (target_thread) {
-		e->to_thread = target_thread->pid;
-		target_list = &target_thread->todo;
-		target_wait = &target_thread->wait;
-	} else {
-		target_list = &target_proc->todo;
-		target_wait = &target_proc->wait;
-	}
 	e->to_proc = target_proc->pid;
 
 	/* TODO: reuse incoming transaction for reply */
@@ -1545,37 +2259,85 @@ static void binder_transaction(struct binder_proc *proc,
 		t->from = NULL;
 	t->sender_euid = proc->tsk->cred->euid;
 	t->to_proc = target_proc;
-	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
+	t->priority = binder_task_priority(current);
+
+	/*
+	 * Allocating the target buffer may fault in and map pages, and
+	 * the payload copy may fault on the sender's memory. Neither needs
+	 * the object graph, so do both without binder_lock. The pin keeps
+	 * target_proc, its nodes and its allocator alive meanwhile;
+	 * threads are not pinned and are looked up again afterwards.
+	 */
+	if (thread->pending_wake != target_proc)
+		binder_flush_wakeup(thread);
+	binder_proc_inc_tmpref(target_proc);
+	binder_lock_release();
+
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
-		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
+		tr->offsets_size, extra_buffers_size,
+		!reply && (t->flags & TF_ONE_WAY), proc->pid);
 	if (t->buffer == NULL) {
+		binder_lock_acquire();
 		return_error = BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
 	}
-	t->buffer->allow_user_free = 0;
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
-	t->buffer->target_node = target_node;
-	if (target_node)
-		binder_inc_node(target_node, 1, 0, NULL);
 
 	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
 
 	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer, tr->data_size)) {
+		binder_lock_acquire();
 		binder_user_error("binder: %d:%d got transaction with invalid "
 			"data ptr\n", proc->pid, thread->pid);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
 	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size)) {
+		binder_lock_acquire();
 		binder_user_error("binder: %d:%d got transaction with invalid "
 			"offsets ptr\n", proc->pid, thread->pid);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
+	if (IS_ALIGNED(tr->offsets_size, sizeof(size_t)) &&
+	    binder_copy_sg_segments(proc, thread, target_proc, t->buffer)) {
+		binder_lock_acquire();
+		return_error = BR_FAILED_REPLY;
+		goto err_copy_data_failed;
+	}
+
+	binder_lock_acquire();
+	t->buffer->target_node = target_node;
+	if (target_node)
+		binder_inc_node(target_node, 1, 0, NULL);
+
+	if (reply) {
+		/* binder_free_thread() clears from if the caller exited */
+		if (in_reply_to->from != target_thread) {
+			return_error = BR_DEAD_REPLY;
+			goto err_dead_target_thread;
+		}
+	} else if (!(tr->flags & TF_ONE_WAY) && thread->transaction_stack) {
+		struct binder_transaction *tmp;
+		tmp = thread->transaction_stack;
+		while (tmp) {
+			if (tmp->from && tmp->from->proc == target_proc)
+				target_thread = tmp->from;
+			tmp = tmp->from_parent;
+		}
+	}
+	if (target_thread) {
+		e->to_thread = target_thread->pid;
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
+	}
+	t->to_thread = target_thread;
 	if (!IS_ALIGNED(tr->offsets_size, sizeof(size_t))) {
 		binder_user_error("binder: %d:%d got transaction with "
 			"invalid offsets size, %zd\n",
@@ -1608,6 +2370,8 @@ static void binder_transaction(struct binder_proc *proc,
 					goto err_binder_new_node_failed;
 				}
 				node->min_priority = fp->flags & FLAT_BINDER_FLAG_PRIORITY_MASK;
+				node->sched_policy = (fp->flags & FLAT_BINDER_FLAG_SCHED_POLICY_MASK) >>
+					FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT;
 				node->accept_fds = !!(fp->flags & FLAT_BINDER_FLAG_ACCEPTS_FDS);
 			}
 			if (fp->cookie != node->cookie) {
@@ -1616,6 +2380,7 @@ static void binder_transaction(struct binder_proc *proc,
 					proc->pid, thread->pid,
 					fp->binder, node->debug_id,
 					fp->cookie, node->cookie);
+				return_error = BR_FAILED_REPLY;
 				goto err_binder_get_ref_for_node_failed;
 			}
 			ref = binder_get_ref_for_node(target_proc, node);
@@ -1676,7 +2441,6 @@ static void binder_transaction(struct binder_proc *proc,
 		} break;
 
 		case BINDER_TYPE_FD: {
-			int target_fd;
 			struct file *file;
 
 			if (reply) {
@@ -1700,19 +2464,22 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error = BR_FAILED_REPLY;
 				goto err_fget_failed;
 			}
-			target_fd = task_get_unused_fd_flags(target_proc, O_CLOEXEC);
-			if (target_fd < 0) {
-				fput(file);
+			fds.fp[fds.count] = fp;
+			fds.file[fds.count] = file;
+			fds.src_fd[fds.count] = fp->handle;
+			fds.count++;
+			fp->handle = -1;
+			if (fds.count == BINDER_FD_BATCH &&
+			    binder_fd_batch_flush(target_proc, &fds)) {
 				return_error = BR_FAILED_REPLY;
 				goto err_get_unused_fd_failed;
 			}
-			task_fd_install(target_proc, target_fd, file);
-			binder_debug(BINDER_DEBUG_TRANSACTION,
-				     "        fd %ld -> %d\n", fp->handle, target_fd);
-			/* TODO: fput? */
-			fp->handle = target_fd;
 		} break;
 
+		case BINDER_TYPE_PTR:
+			/* copied by binder_copy_sg_segments() */
+			break;
+
 		default:
 			binder_user_error("binder: %d:%d got transactio"
 				"n with invalid object type, %lx\n",
@@ -1721,8 +2488,17 @@ static void binder_transaction(struct binder_proc *proc,
 			goto err_bad_object_type;
 		}
 	}
+	if (binder_fd_batch_flush(target_proc, &fds)) {
+		return_error = BR_FAILED_REPLY;
+		goto err_get_unused_fd_failed;
+	}
+	t->start_time = ktime_get();
 	if (reply) {
 		BUG_ON(t->buffer->async_transaction != 0);
+		if (in_reply_to->buffer && in_reply_to->buffer->target_node)
+			in_reply_to->buffer->target_node->stat_service_ns +=
+				ktime_to_ns(ktime_sub(t->start_time,
+						in_reply_to->delivered_time));
 		binder_pop_transaction(target_thread, in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -1738,12 +2514,33 @@ static void binder_transaction(struct binder_proc *proc,
 		} else
 			target_node->has_async_transaction = 1;
 	}
+	if (target_node) {
+		target_node->stat_transactions++;
+		target_node->stat_bytes += tr->data_size + tr->offsets_size +
+			extra_buffers_size;
+	}
+	trace_binder_transaction(reply, t, target_node);
+	write_seqcount_begin(&target_proc->counters_seq);
+	if (reply)
+		target_proc->counters.replies++;
+	else {
+		target_proc->counters.transactions++;
+		if (t->flags & TF_ONE_WAY)
+			target_proc->counters.oneway++;
+	}
+	write_seqcount_end(&target_proc->counters_seq);
+	binder_proc_count(proc, &proc->counters.sent, 1);
 	t->work.type = BINDER_WORK_TRANSACTION;
 	list_add_tail(&t->work.entry, target_list);
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
 	list_add_tail(&tcomplete->entry, &thread->todo);
-	if (target_wait)
+	if (target_wait == &target_proc->wait && (t->flags & TF_ONE_WAY))
+		thread->pending_wake = target_proc;
+	else if (target_wait == &target_proc->wait)
+		binder_wakeup_proc(target_proc);
+	else if (target_wait)
 		wake_up_interruptible(target_wait);
+	binder_proc_dec_tmpref(target_proc);
 	return;
 
 err_get_unused_fd_failed:
@@ -1754,11 +2551,14 @@ err_binder_get_ref_failed:
 err_binder_new_node_failed:
 err_bad_object_type:
 err_bad_offset:
+err_dead_target_thread:
 err_copy_data_failed:
+	binder_fd_batch_discard(&fds);
 	binder_transaction_buffer_release(target_proc, t->buffer, offp);
 	t->buffer->transaction = NULL;
 	binder_free_buf(target_proc, t->buffer);
 err_binder_alloc_buf_failed:
+	binder_proc_dec_tmpref(target_proc);
 	kfree(tcomplete);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 err_alloc_tcomplete_failed:
@@ -1939,20 +2739,25 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				return -EFAULT;
 			ptr += sizeof(void *);
 
+			mutex_lock(&proc->alloc_lock);
 			buffer = binder_buffer_lookup(proc, data_ptr);
 			if (buffer == NULL) {
+				mutex_unlock(&proc->alloc_lock);
 				binder_user_error("binder: %d:%d "
 					"BC_FREE_BUFFER u%p no match\n",
 					proc->pid, thread->pid, data_ptr);
 				break;
 			}
 			if (!buffer->allow_user_free) {
+				mutex_unlock(&proc->alloc_lock);
 				binder_user_error("binder: %d:%d "
 					"BC_FREE_BUFFER u%p matched "
 					"unreturned buffer\n",
 					proc->pid, thread->pid, data_ptr);
 				break;
 			}
+			buffer->allow_user_free = 0;
+			mutex_unlock(&proc->alloc_lock);
 			binder_debug(BINDER_DEBUG_FREE_BUFFER,
 				     "binder: %d:%d BC_FREE_BUFFER u%p found buffer %d for %s transaction\n",
 				     proc->pid, thread->pid, data_ptr, buffer->debug_id,
@@ -1966,8 +2771,16 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				BUG_ON(!buffer->target_node->has_async_transaction);
 				if (list_empty(&buffer->target_node->async_todo))
 					buffer->target_node->has_async_transaction = 0;
-				else
-					list_move_tail(buffer->target_node->async_todo.next, &thread->todo);
+				else {
+					/*
+					 * Requeue behind the work of other
+					 * nodes rather than on this thread,
+					 * so async traffic is served round
+					 * robin across nodes.
+					 */
+					list_move_tail(buffer->target_node->async_todo.next, &proc->todo);
+					binder_wakeup_proc(proc);
+				}
 			}
 			binder_transaction_buffer_release(proc, buffer, NULL);
 			binder_free_buf(proc, buffer);
@@ -1981,7 +2794,20 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (copy_from_user(&tr, ptr, sizeof(tr)))
 				return -EFAULT;
 			ptr += sizeof(tr);
-			binder_transaction(proc, thread, &tr, cmd == BC_REPLY);
+			binder_transaction(proc, thread, &tr, cmd == BC_REPLY, 0);
+			break;
+		}
+
+		case BC_TRANSACTION_SG:
+		case BC_REPLY_SG: {
+			struct binder_transaction_data_sg tr;
+
+			if (copy_from_user(&tr, ptr, sizeof(tr)))
+				return -EFAULT;
+			ptr += sizeof(tr);
+			binder_transaction(proc, thread, &tr.transaction_data,
+					   cmd == BC_REPLY_SG,
+					   ALIGN(tr.buffers_size, sizeof(void *)));
 			break;
 		}
 
@@ -2089,7 +2915,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 						list_add_tail(&ref->death->work.entry, &thread->todo);
 					} else {
 						list_add_tail(&ref->death->work.entry, &proc->todo);
-						wake_up_interruptible(&proc->wait);
+						binder_wakeup_proc(proc);
 					}
 				}
 			} else {
@@ -2119,7 +2945,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 						list_add_tail(&death->work.entry, &thread->todo);
 					} else {
 						list_add_tail(&death->work.entry, &proc->todo);
-						wake_up_interruptible(&proc->wait);
+						binder_wakeup_proc(proc);
 					}
 				} else {
 					BUG_ON(death->work.type != BINDER_WORK_DEAD_BINDER);
@@ -2159,7 +2985,7 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 					list_add_tail(&death->work.entry, &thread->todo);
 				} else {
 					list_add_tail(&death->work.entry, &proc->todo);
-					wake_up_interruptible(&proc->wait);
+					binder_wakeup_proc(proc);
 				}
 			}
 		} break;
@@ -2236,9 +3062,11 @@ retry:
 
 
 	thread->looper |= BINDER_LOOPER_STATE_WAITING;
-	if (wait_for_proc_work)
+	if (wait_for_proc_work && !non_block) {
+		list_add(&thread->waiting_thread_node, &proc->waiting_threads);
 		proc->ready_threads++;
-	mutex_unlock(&binder_lock);
+	}
+	binder_lock_release();
 	if (wait_for_proc_work) {
 		if (!(thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 					BINDER_LOOPER_STATE_ENTERED))) {
@@ -2249,12 +3077,14 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
-		binder_set_nice(proc->default_priority);
+		binder_set_priority(proc->default_priority, false);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
 		} else
-			ret = wait_event_interruptible_exclusive(proc->wait, binder_has_proc_work(proc, thread));
+			ret = wait_event_interruptible(thread->wait,
+				binder_has_proc_work(proc, thread) ||
+				list_empty(&thread->waiting_thread_node));
 	} else {
 		if (non_block) {
 			if (!binder_has_thread_work(thread))
@@ -2262,9 +3092,12 @@ retry:
 		} else
 			ret = wait_event_interruptible(thread->wait, binder_has_thread_work(thread));
 	}
-	mutex_lock(&binder_lock);
-	if (wait_for_proc_work)
+	binder_lock_acquire();
+	trace_binder_wakeup(thread, wait_for_proc_work, ret);
+	if (!list_empty(&thread->waiting_thread_node)) {
+		list_del_init(&thread->waiting_thread_node);
 		proc->ready_threads--;
+	}
 	thread->looper &= ~BINDER_LOOPER_STATE_WAITING;
 
 	if (ret)
@@ -2275,6 +3108,7 @@ retry:
 		struct binder_transaction_data tr;
 		struct binder_work *w;
 		struct binder_transaction *t = NULL;
+		bool more;
 
 		if (!list_empty(&thread->todo))
 			w = list_first_entry(&thread->todo, struct binder_work, entry);
@@ -2358,6 +3192,8 @@ retry:
 						     proc->pid, thread->pid, node->debug_id,
 						     node->ptr, node->cookie);
 					rb_erase(&node->rb_node, &proc->nodes);
+					binder_proc_count(proc,
+						&proc->counters.nodes, -1);
 					kfree(node);
 					binder_stats_deleted(BINDER_STAT_NODE);
 				} else {
@@ -2410,15 +3246,19 @@ retry:
 		BUG_ON(t->buffer == NULL);
 		if (t->buffer->target_node) {
 			struct binder_node *target_node = t->buffer->target_node;
+			struct binder_priority node_prio;
+
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
+			node_prio = binder_node_min_priority(target_node);
+			t->saved_priority = binder_task_priority(current);
+			if (!(t->flags & TF_ONE_WAY) &&
+			    binder_priority_higher(t->priority, node_prio))
+				binder_set_priority(t->priority, true);
 			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+				 binder_priority_higher(node_prio,
+							t->saved_priority))
+				binder_set_priority(node_prio, true);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = NULL;
@@ -2464,6 +3304,14 @@ retry:
 			     t->buffer->data_size, t->buffer->offsets_size,
 			     tr.data.ptr.buffer, tr.data.ptr.offsets);
 
+		t->delivered_time = ktime_get();
+		trace_binder_transaction_received(t, cmd,
+			ktime_to_ns(ktime_sub(t->delivered_time, t->start_time)));
+
+		/* oneway work needs no reply, so more can follow */
+		more = proc->batch_read && cmd == BR_TRANSACTION &&
+			(t->flags & TF_ONE_WAY);
+
 		list_del(&t->work.entry);
 		t->buffer->allow_user_free = 1;
 		if (cmd == BR_TRANSACTION && !(t->flags & TF_ONE_WAY)) {
@@ -2475,7 +3323,8 @@ retry:
 			kfree(t);
 			binder_stats_deleted(BINDER_STAT_TRANSACTION);
 		}
-		break;
+		if (!more)
+			break;
 	}
 
 done:
@@ -2543,10 +3392,12 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 		if (thread == NULL)
 			return NULL;
 		binder_stats_created(BINDER_STAT_THREAD);
+		binder_proc_count(proc, &proc->counters.threads, 1);
 		thread->proc = proc;
 		thread->pid = current->pid;
 		init_waitqueue_head(&thread->wait);
 		INIT_LIST_HEAD(&thread->todo);
+		INIT_LIST_HEAD(&thread->waiting_thread_node);
 		rb_link_node(&thread->rb_node, parent, p);
 		rb_insert_color(&thread->rb_node, &proc->threads);
 		thread->looper |= BINDER_LOOPER_STATE_NEED_RETURN;
@@ -2564,6 +3415,10 @@ static int binder_free_thread(struct binder_proc *proc,
 	int active_transactions = 0;
 
 	rb_erase(&thread->rb_node, &proc->threads);
+	if (!list_empty(&thread->waiting_thread_node)) {
+		list_del_init(&thread->waiting_thread_node);
+		proc->ready_threads--;
+	}
 	t = thread->transaction_stack;
 	if (t && t->to_thread == thread)
 		send_reply = t;
@@ -2592,6 +3447,7 @@ static int binder_free_thread(struct binder_proc *proc,
 	if (send_reply)
 		binder_send_failed_reply(send_reply, BR_DEAD_REPLY);
 	binder_release_work(&thread->todo);
+	binder_proc_count(proc, &proc->counters.threads, -1);
 	kfree(thread);
 	binder_stats_deleted(BINDER_STAT_THREAD);
 	return active_transactions;
@@ -2604,12 +3460,12 @@ static unsigned int binder_poll(struct file *filp,
 	struct binder_thread *thread = NULL;
 	int wait_for_proc_work;
 
-	mutex_lock(&binder_lock);
+	binder_lock_acquire();
 	thread = binder_get_thread(proc);
 
 	wait_for_proc_work = thread->transaction_stack == NULL &&
 		list_empty(&thread->todo) && thread->return_error == BR_OK;
-	mutex_unlock(&binder_lock);
+	binder_lock_release();
 
 	if (wait_for_proc_work) {
 		if (binder_has_proc_work(proc, thread))
@@ -2641,7 +3497,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	if (ret)
 		return ret;
 
-	mutex_lock(&binder_lock);
+	binder_lock_acquire();
 	thread = binder_get_thread(proc);
 	if (thread == NULL) {
 		ret = -ENOMEM;
@@ -2666,6 +3522,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 		if (bwr.write_size > 0) {
 			ret = binder_thread_write(proc, thread, (void __user *)bwr.write_buffer, bwr.write_size, &bwr.write_consumed);
+			binder_flush_wakeup(thread);
 			if (ret < 0) {
 				bwr.read_consumed = 0;
 				if (copy_to_user(ubuf, &bwr, sizeof(bwr)))
@@ -2676,7 +3533,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		if (bwr.read_size > 0) {
 			ret = binder_thread_read(proc, thread, (void __user *)bwr.read_buffer, bwr.read_size, &bwr.read_consumed, filp->f_flags & O_NONBLOCK);
 			if (!list_empty(&proc->todo))
-				wake_up_interruptible(&proc->wait);
+				binder_wakeup_proc(proc);
 			if (ret < 0) {
 				if (copy_to_user(ubuf, &bwr, sizeof(bwr)))
 					ret = -EFAULT;
@@ -2693,6 +3550,16 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		}
 		break;
 	}
+	case BINDER_SET_BATCH_READ: {
+		int enable;
+
+		if (get_user(enable, (int __user *)ubuf)) {
+			ret = -EINVAL;
+			goto err;
+		}
+		proc->batch_read = !!enable;
+		break;
+	}
 	case BINDER_SET_MAX_THREADS:
 		if (copy_from_user(&proc->max_threads, ubuf, sizeof(proc->max_threads))) {
 			ret = -EINVAL;
@@ -2750,7 +3617,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 err:
 	if (thread)
 		thread->looper &= ~BINDER_LOOPER_STATE_NEED_RETURN;
-	mutex_unlock(&binder_lock);
+	binder_lock_release();
 	wait_event_interruptible(binder_user_error_wait, binder_stop_on_user_error < 2);
 	if (ret && ret != -ERESTARTSYS)
 		printk(KERN_INFO "binder: %d:%d ioctl %x %lx returned %d\n", proc->pid, current->pid, cmd, arg, ret);
@@ -2792,6 +3659,7 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	struct binder_proc *proc = filp->private_data;
 	const char *failure_string;
 	struct binder_buffer *buffer;
+	size_t resident_size;
 
 	if ((vma->vm_end - vma->vm_start) > SZ_4M)
 		vma->vm_end = vma->vm_start + SZ_4M;
@@ -2845,11 +3713,20 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	vma->vm_ops = &binder_vm_ops;
 	vma->vm_private_data = proc;
 
-	if (binder_update_page_range(proc, 1, proc->buffer, proc->buffer + PAGE_SIZE, vma)) {
+	resident_size = PAGE_ALIGN(binder_resident_kb * SZ_1K);
+	if (resident_size < PAGE_SIZE)
+		resident_size = PAGE_SIZE;
+	if (resident_size > proc->buffer_size)
+		resident_size = proc->buffer_size;
+
+	mutex_lock(&proc->alloc_lock);
+	if (binder_update_page_range(proc, 1, proc->buffer, proc->buffer + resident_size, vma)) {
+		mutex_unlock(&proc->alloc_lock);
 		ret = -ENOMEM;
 		failure_string = "alloc small buf";
 		goto err_alloc_small_buf_failed;
 	}
+	proc->resident_size = resident_size;
 	buffer = proc->buffer;
 	INIT_LIST_HEAD(&proc->buffers);
 	list_add(&buffer->entry, &proc->buffers);
@@ -2860,6 +3737,7 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	proc->files = get_files_struct(proc->tsk);
 	proc->vma = vma;
 	proc->vma_vm_mm = vma->vm_mm;
+	mutex_unlock(&proc->alloc_lock);
 
 	/*printk(KERN_INFO "binder_mmap: %d %lx-%lx maps %p\n",
 		 proc->pid, vma->vm_start, vma->vm_end, proc->buffer);*/
@@ -2895,14 +3773,21 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
-	proc->default_priority = task_nice(current);
-	mutex_lock(&binder_lock);
+	INIT_LIST_HEAD(&proc->waiting_threads);
+	INIT_LIST_HEAD(&proc->async_senders);
+	idr_init(&proc->ref_descs);
+	mutex_init(&proc->alloc_lock);
+	seqcount_init(&proc->counters_seq);
+	proc->default_priority = binder_task_priority(current);
+	proc->pid = current->group_leader->pid;
+	binder_lock_acquire();
 	binder_stats_created(BINDER_STAT_PROC);
+	mutex_lock(&binder_procs_lock);
 	hlist_add_head(&proc->proc_node, &binder_procs);
-	proc->pid = current->group_leader->pid;
+	mutex_unlock(&binder_procs_lock);
 	INIT_LIST_HEAD(&proc->delivered_death);
 	filp->private_data = proc;
-	mutex_unlock(&binder_lock);
+	binder_lock_release();
 
 	if (binder_debugfs_dir_entry_proc) {
 		char strbuf[11];
@@ -2951,37 +3836,33 @@ static int binder_release(struct inode *nodp, struct file *filp)
 	return 0;
 }
 
-static void binder_deferred_release(struct binder_proc *proc)
+/*
+ * Tear down up to BINDER_RELEASE_CHUNK objects of a dead proc. Returns
+ * nonzero once only the lock-free part of the teardown is left. Called
+ * with binder_lock held.
+ */
+static int binder_release_chunk(struct binder_proc *proc)
 {
 	struct hlist_node *pos;
 	struct binder_transaction *t;
 	struct rb_node *n;
-	int threads, nodes, incoming_refs, outgoing_refs, buffers, active_transactions, page_count;
-
-	BUG_ON(proc->vma);
-	BUG_ON(proc->files);
-
-	hlist_del(&proc->proc_node);
-	if (binder_context_mgr_node && binder_context_mgr_node->proc == proc) {
-		binder_debug(BINDER_DEBUG_DEAD_BINDER,
-			     "binder_release: %d context_mgr_node gone\n",
-			     proc->pid);
-		binder_context_mgr_node = NULL;
-	}
+	int budget = BINDER_RELEASE_CHUNK;
 
-	threads = 0;
-	active_transactions = 0;
 	while ((n = rb_first(&proc->threads))) {
 		struct binder_thread *thread = rb_entry(n, struct binder_thread, rb_node);
-		threads++;
-		active_transactions += binder_free_thread(proc, thread);
+
+		if (!budget--)
+			return 0;
+		proc->released.threads++;
+		proc->released.active_transactions +=
+			binder_free_thread(proc, thread);
 	}
-	nodes = 0;
-	incoming_refs = 0;
 	while ((n = rb_first(&proc->nodes))) {
 		struct binder_node *node = rb_entry(n, struct binder_node, rb_node);
 
-		nodes++;
+		if (!budget--)
+			return 0;
+		proc->released.nodes++;
 		rb_erase(&node->rb_node, &proc->nodes);
 		list_del_init(&node->work.entry);
 		if (hlist_empty(&node->refs)) {
@@ -2997,13 +3878,13 @@ static void binder_deferred_release(struct binder_proc *proc)
 			hlist_add_head(&node->dead_node, &binder_dead_nodes);
 
 			hlist_for_each_entry(ref, pos, &node->refs, node_entry) {
-				incoming_refs++;
+				proc->released.incoming_refs++;
 				if (ref->death) {
 					death++;
 					if (list_empty(&ref->death->work.entry)) {
 						ref->death->work.type = BINDER_WORK_DEAD_BINDER;
 						list_add_tail(&ref->death->work.entry, &ref->proc->todo);
-						wake_up_interruptible(&ref->proc->wait);
+						binder_wakeup_proc(ref->proc);
 					} else
 						BUG();
 				}
@@ -3011,22 +3892,27 @@ static void binder_deferred_release(struct binder_proc *proc)
 			binder_debug(BINDER_DEBUG_DEAD_BINDER,
 				     "binder: node %d now dead, "
 				     "refs %d, death %d\n", node->debug_id,
-				     incoming_refs, death);
+				     proc->released.incoming_refs, death);
 		}
 	}
-	outgoing_refs = 0;
 	while ((n = rb_first(&proc->refs_by_desc))) {
 		struct binder_ref *ref = rb_entry(n, struct binder_ref,
 						  rb_node_desc);
-		outgoing_refs++;
+
+		if (!budget--)
+			return 0;
+		proc->released.outgoing_refs++;
 		binder_delete_ref(ref);
 	}
 	binder_release_work(&proc->todo);
-	buffers = 0;
+	binder_drain_size_cache(proc);
 
 	while ((n = rb_first(&proc->allocated_buffers))) {
 		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
 							rb_node);
+
+		if (!budget--)
+			return 0;
 		t = buffer->transaction;
 		if (t) {
 			t->buffer = NULL;
@@ -3037,10 +3923,35 @@ static void binder_deferred_release(struct binder_proc *proc)
 			/*BUG();*/
 		}
 		binder_free_buf(proc, buffer);
-		buffers++;
+		proc->released.buffers++;
 	}
-
+	idr_destroy(&proc->ref_descs);
 	binder_stats_deleted(BINDER_STAT_PROC);
+	return 1;
+}
+
+static void binder_release_work_func(struct work_struct *work)
+{
+	struct binder_proc *proc = container_of(work, struct binder_proc,
+						release_work);
+	int page_count, done;
+
+	do {
+		binder_lock_acquire();
+		done = binder_release_chunk(proc);
+		binder_lock_release();
+		cond_resched();
+	} while (!done);
+
+	/* Nothing can reach proc any more */
+	while (!list_empty(&proc->async_senders)) {
+		struct binder_async_sender *sender;
+
+		sender = list_first_entry(&proc->async_senders,
+					  struct binder_async_sender, entry);
+		list_del(&sender->entry);
+		kfree(sender);
+	}
 
 	page_count = 0;
 	if (proc->pages) {
@@ -3069,12 +3980,50 @@ static void binder_deferred_release(struct binder_proc *proc)
 		     "binder_release: %d threads %d, nodes %d (ref %d), "
 		     "refs %d, active transactions %d, buffers %d, "
 		     "pages %d\n",
-		     proc->pid, threads, nodes, incoming_refs, outgoing_refs,
-		     active_transactions, buffers, page_count);
+		     proc->pid, proc->released.threads, proc->released.nodes,
+		     proc->released.incoming_refs,
+		     proc->released.outgoing_refs,
+		     proc->released.active_transactions,
+		     proc->released.buffers, page_count);
 
 	kfree(proc);
 }
 
+/*
+ * Unlink a proc whose file has been released and hand the teardown to
+ * binder_release_workqueue, which does it in chunks so that the death of
+ * a large process does not hold binder_lock for the whole teardown.
+ * Once is_dead is set no new transaction can pin or target the proc.
+ */
+static void binder_deferred_release(struct binder_proc *proc)
+{
+	if (proc->tmp_ref) {
+		/* binder_proc_dec_tmpref() requeues the release */
+		binder_debug(BINDER_DEBUG_OPEN_CLOSE,
+			     "binder_release: %d pinned, deferring\n",
+			     proc->pid);
+		proc->release_pending = 1;
+		return;
+	}
+
+	BUG_ON(proc->vma);
+	BUG_ON(proc->files);
+
+	mutex_lock(&binder_procs_lock);
+	hlist_del(&proc->proc_node);
+	mutex_unlock(&binder_procs_lock);
+	if (binder_context_mgr_node && binder_context_mgr_node->proc == proc) {
+		binder_debug(BINDER_DEBUG_DEAD_BINDER,
+			     "binder_release: %d context_mgr_node gone\n",
+			     proc->pid);
+		binder_context_mgr_node = NULL;
+	}
+
+	proc->is_dead = 1;
+	INIT_WORK(&proc->release_work, binder_release_work_func);
+	queue_work(binder_release_workqueue, &proc->release_work);
+}
+
 static void binder_deferred_func(struct work_struct *work)
 {
 	struct binder_proc *proc;
@@ -3082,7 +4031,7 @@ static void binder_deferred_func(struct work_struct *work)
 
 	int defer;
 	do {
-		mutex_lock(&binder_lock);
+		binder_lock_acquire();
 		mutex_lock(&binder_deferred_lock);
 		if (!hlist_empty(&binder_deferred_list)) {
 			proc = hlist_entry(binder_deferred_list.first,
@@ -3107,9 +4056,9 @@ static void binder_deferred_func(struct work_struct *work)
 			binder_deferred_flush(proc);
 
 		if (defer & BINDER_DEFERRED_RELEASE)
-			binder_deferred_release(proc); /* frees proc */
+			binder_deferred_release(proc); /* queues teardown unless pinned */
 
-		mutex_unlock(&binder_lock);
+		binder_lock_release();
 		if (files)
 			put_files_struct(files);
 	} while (proc);
@@ -3133,13 +4082,14 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 				     struct binder_transaction *t)
 {
 	seq_printf(m,
-		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %ld r%d",
+		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %d:%d r%d",
 		   prefix, t->debug_id, t,
 		   t->from ? t->from->proc->pid : 0,
 		   t->from ? t->from->pid : 0,
 		   t->to_proc ? t->to_proc->pid : 0,
 		   t->to_thread ? t->to_thread->pid : 0,
-		   t->code, t->flags, t->priority, t->need_reply);
+		   t->code, t->flags, t->priority.sched_policy,
+		   t->priority.prio, t->need_reply);
 	if (t->buffer == NULL) {
 		seq_puts(m, " buffer free\n");
 		return;
@@ -3250,6 +4200,10 @@ static void print_binder_node(struct seq_file *m, struct binder_node *node)
 		hlist_for_each_entry(ref, pos, &node->refs, node_entry)
 			seq_printf(m, " %d", ref->proc->pid);
 	}
+	if (node->stat_transactions)
+		seq_printf(m, " tx %lu bytes %llu svc %lluus",
+			   node->stat_transactions, node->stat_bytes,
+			   div_u64(node->stat_service_ns, NSEC_PER_USEC));
 	seq_puts(m, "\n");
 	list_for_each_entry(w, &node->async_todo, entry)
 		print_binder_work(m, "    ",
@@ -3290,9 +4244,14 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
-	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
-		print_binder_buffer(m, "  buffer",
-				    rb_entry(n, struct binder_buffer, rb_node));
+	mutex_lock(&proc->alloc_lock);
+	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n)) {
+		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
+							rb_node);
+		if (!buffer->cached)
+			print_binder_buffer(m, "  buffer", buffer);
+	}
+	mutex_unlock(&proc->alloc_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3341,7 +4300,9 @@ static const char *binder_command_strings[] = {
 	"BC_EXIT_LOOPER",
 	"BC_REQUEST_DEATH_NOTIFICATION",
 	"BC_CLEAR_DEATH_NOTIFICATION",
-	"BC_DEAD_BINDER_DONE"
+	"BC_DEAD_BINDER_DONE",
+	"BC_TRANSACTION_SG",
+	"BC_REPLY_SG"
 };
 
 static const char *binder_objstat_strings[] = {
@@ -3391,6 +4352,7 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 static void print_binder_proc_stats(struct seq_file *m,
 				    struct binder_proc *proc)
 {
+	struct binder_async_sender *sender;
 	struct binder_work *w;
 	struct rb_node *n;
 	int count, strong, weak;
@@ -3422,9 +4384,20 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
 	count = 0;
+	mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
-		count++;
+		if (!rb_entry(n, struct binder_buffer, rb_node)->cached)
+			count++;
 	seq_printf(m, "  buffers: %d\n", count);
+	seq_printf(m, "  cached buffers: %d %d %d %d\n",
+		   proc->size_cache_count[0], proc->size_cache_count[1],
+		   proc->size_cache_count[2], proc->size_cache_count[3]);
+	seq_printf(m, "  async stalls: %lu\n", proc->async_stalls);
+	list_for_each_entry(sender, &proc->async_senders, entry)
+		if (sender->used || sender->stalls)
+			seq_printf(m, "    async sender %d: used %zd stalls %lu\n",
+				   sender->pid, sender->used, sender->stalls);
+	mutex_unlock(&proc->alloc_lock);
 
 	count = 0;
 	list_for_each_entry(w, &proc->todo, entry) {
@@ -3450,7 +4423,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock_acquire();
 
 	seq_puts(m, "binder state:\n");
 
@@ -3462,7 +4435,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_lock_release();
 	return 0;
 }
 
@@ -3473,7 +4446,7 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock_acquire();
 
 	seq_puts(m, "binder stats:\n");
 
@@ -3482,7 +4455,7 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc_stats(m, proc);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_lock_release();
 	return 0;
 }
 
@@ -3493,13 +4466,13 @@ static int binder_transactions_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock_acquire();
 
 	seq_puts(m, "binder transactions:\n");
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 0);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_lock_release();
 	return 0;
 }
 
@@ -3509,13 +4482,92 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock_acquire();
 	seq_puts(m, "binder proc state:\n");
 	print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_lock_release();
+	return 0;
+}
+
+static void binder_stats_summary_fill(struct binder_proc *proc,
+				      struct binder_stats_summary_proc *rec)
+{
+	struct binder_proc_counters c;
+	unsigned seq;
+
+	do {
+		seq = read_seqcount_begin(&proc->counters_seq);
+		c = proc->counters;
+	} while (read_seqcount_retry(&proc->counters_seq, seq));
+
+	rec->pid = proc->pid;
+	rec->threads = c.threads;
+	rec->ready_threads = ACCESS_ONCE(proc->ready_threads);
+	rec->requested_threads_started =
+		ACCESS_ONCE(proc->requested_threads_started);
+	rec->max_threads = ACCESS_ONCE(proc->max_threads);
+	rec->nodes = c.nodes;
+	rec->refs = c.refs;
+	rec->free_async_space = ACCESS_ONCE(proc->free_async_space);
+	rec->transactions = c.transactions;
+	rec->oneway = c.oneway;
+	rec->replies = c.replies;
+	rec->sent = c.sent;
+}
+
+/*
+ * Binary per-proc summary for periodic collectors. Unlike state and
+ * stats this never takes binder_lock, only binder_procs_lock, which is
+ * held for list membership changes alone.
+ */
+static int binder_stats_summary_show(struct seq_file *m, void *unused)
+{
+	struct binder_stats_summary_header hdr = {
+		.version = BINDER_STATS_SUMMARY_VERSION,
+		.record_size = sizeof(struct binder_stats_summary_proc),
+	};
+	struct binder_stats_summary_proc rec;
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+
+	mutex_lock(&binder_procs_lock);
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
+		hdr.nr_procs++;
+	seq_write(m, &hdr, sizeof(hdr));
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		binder_stats_summary_fill(proc, &rec);
+		seq_write(m, &rec, sizeof(rec));
+	}
+	mutex_unlock(&binder_procs_lock);
+	return 0;
+}
+
+#ifdef CONFIG_ANDROID_BINDER_LOCK_STATS
+/*
+ * Totals since boot; readers diff two snapshots. The snapshot is taken
+ * with the bare mutex so that reading the file is not accounted.
+ */
+static int binder_lock_stats_show(struct seq_file *m, void *unused)
+{
+	u64 acquired, contended, wait_ns, hold_ns, max_hold_ns;
+
+	mutex_lock(&binder_lock);
+	acquired = binder_lock_stats.acquired;
+	contended = binder_lock_stats.contended;
+	wait_ns = binder_lock_stats.wait_ns;
+	hold_ns = binder_lock_stats.hold_ns;
+	max_hold_ns = binder_lock_stats.max_hold_ns;
+	mutex_unlock(&binder_lock);
+
+	seq_printf(m, "acquired: %llu\n", acquired);
+	seq_printf(m, "contended: %llu\n", contended);
+	seq_printf(m, "wait_ns: %llu\n", wait_ns);
+	seq_printf(m, "hold_ns: %llu\n", hold_ns);
+	seq_printf(m, "max_hold_ns: %llu\n", max_hold_ns);
 	return 0;
 }
+#endif
 
 static void print_binder_transaction_log_entry(struct seq_file *m,
 					struct binder_transaction_log_entry *e)
@@ -3560,8 +4612,12 @@ static struct miscdevice binder_miscdev = {
 
 BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
+BINDER_DEBUG_ENTRY(stats_summary);
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
+#ifdef CONFIG_ANDROID_BINDER_LOCK_STATS
+BINDER_DEBUG_ENTRY(lock_stats);
+#endif
 
 static int __init binder_init(void)
 {
@@ -3570,6 +4626,13 @@ static int __init binder_init(void)
 	binder_deferred_workqueue = create_singlethread_workqueue("binder");
 	if (!binder_deferred_workqueue)
 		return -ENOMEM;
+	binder_release_workqueue = alloc_workqueue("binder_release",
+						   WQ_UNBOUND | WQ_MEM_RECLAIM,
+						   0);
+	if (!binder_release_workqueue) {
+		destroy_workqueue(binder_deferred_workqueue);
+		return -ENOMEM;
+	}
 
 	binder_debugfs_dir_entry_root = debugfs_create_dir("binder", NULL);
 	if (binder_debugfs_dir_entry_root)
@@ -3587,6 +4650,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    NULL,
 				    &binder_stats_fops);
+		debugfs_create_file("stats_summary",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_stats_summary_fops);
 		debugfs_create_file("transactions",
 				    S_IRUGO,
 				    binder_debugfs_dir_entry_root,
@@ -3602,6 +4670,13 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+#ifdef CONFIG_ANDROID_BINDER_LOCK_STATS
+		debugfs_create_file("lock_stats",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_lock_stats_fops);
+#endif
 	}
 	return ret;
 }
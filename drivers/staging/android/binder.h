@@ -32,11 +32,19 @@ enum {
 	BINDER_TYPE_HANDLE	= B_PACK_CHARS('s', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_WEAK_HANDLE	= B_PACK_CHARS('w', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_FD		= B_PACK_CHARS('f', 'd', '*', B_TYPE_LARGE),
+	BINDER_TYPE_PTR		= B_PACK_CHARS('p', 't', '*', B_TYPE_LARGE),
 };
 
 enum {
 	FLAT_BINDER_FLAG_PRIORITY_MASK = 0xff,
 	FLAT_BINDER_FLAG_ACCEPTS_FDS = 0x100,
+	/*
+	 * Scheduling policy of the node's minimum priority. With
+	 * SCHED_FIFO or SCHED_RR the priority bits hold an RT priority
+	 * (1..99) instead of a nice value.
+	 */
+	FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT = 9,
+	FLAT_BINDER_FLAG_SCHED_POLICY_MASK = 3U << 9,
 };
 
 /*
@@ -61,6 +69,21 @@ struct flat_binder_object {
 	void			*cookie;
 };
 
+/*
+ * A BINDER_TYPE_PTR object references a segment of the sender's memory
+ * instead of carrying it inline. The driver copies the segment straight
+ * into the extra buffers area of the target's transaction buffer and
+ * rewrites 'buffer' to the segment's address in the receiving process.
+ * It occupies the same space as a flat_binder_object in the data, and
+ * is only accepted in BC_TRANSACTION_SG and BC_REPLY_SG.
+ */
+struct binder_buffer_object {
+	unsigned long		type;
+	unsigned long		flags;		/* must be zero */
+	void			*buffer;	/* segment address */
+	size_t			length;		/* segment length */
+};
+
 /*
  * On 64-bit platforms where user code may run in 32-bits the driver must
  * translate the buffer (and local binder) addresses apropriately.
@@ -81,6 +104,37 @@ struct binder_version {
 	signed long	protocol_version;
 };
 
+/*
+ * Records returned by the debugfs file binder/stats_summary: one
+ * binder_stats_summary_header followed by nr_procs
+ * binder_stats_summary_proc records. The file is built without taking
+ * the driver's transaction lock and is cheap enough to poll. Counters are
+ * 32-bit totals since the process opened the driver and wrap.
+ */
+#define BINDER_STATS_SUMMARY_VERSION	1
+
+struct binder_stats_summary_header {
+	uint32_t	version;
+	uint32_t	record_size;	/* sizeof(binder_stats_summary_proc) */
+	uint32_t	nr_procs;
+	uint32_t	reserved;
+};
+
+struct binder_stats_summary_proc {
+	int32_t		pid;
+	uint32_t	threads;
+	uint32_t	ready_threads;
+	uint32_t	requested_threads_started;
+	uint32_t	max_threads;
+	uint32_t	nodes;
+	uint32_t	refs;
+	uint32_t	free_async_space;
+	uint32_t	transactions;	/* received, excluding replies */
+	uint32_t	oneway;		/* subset of transactions */
+	uint32_t	replies;	/* received */
+	uint32_t	sent;		/* transactions and replies sent */
+};
+
 /* This is the current protocol version. */
 #define BINDER_CURRENT_PROTOCOL_VERSION 7
 
@@ -91,6 +145,11 @@ struct binder_version {
 #define	BINDER_SET_CONTEXT_MGR		_IOW('b', 7, int)
 #define	BINDER_THREAD_EXIT		_IOW('b', 8, int)
 #define BINDER_VERSION			_IOWR('b', 9, struct binder_version)
+/*
+ * Non-zero lets one BINDER_WRITE_READ return every queued oneway
+ * BR_TRANSACTION that fits in the read buffer, instead of one per call.
+ */
+#define BINDER_SET_BATCH_READ		_IOW('b', 10, int)
 
 /*
  * NOTE: Two special error codes you should check for when calling
@@ -147,6 +206,16 @@ struct binder_transaction_data {
 	} data;
 };
 
+/*
+ * buffers_size is the room to reserve after the offsets for the
+ * segments of all BINDER_TYPE_PTR objects, each rounded up to
+ * sizeof(void *).
+ */
+struct binder_transaction_data_sg {
+	struct binder_transaction_data	transaction_data;
+	size_t				buffers_size;
+};
+
 struct binder_ptr_cookie {
 	void *ptr;
 	void *cookie;
@@ -324,6 +393,13 @@ enum BinderDriverCommandProtocol {
 	/*
 	 * void *: cookie
 	 */
+
+	BC_TRANSACTION_SG = _IOW('c', 17, struct binder_transaction_data_sg),
+	BC_REPLY_SG = _IOW('c', 18, struct binder_transaction_data_sg),
+	/*
+	 * binder_transaction_data_sg: the sent command, with room for
+	 * BINDER_TYPE_PTR segments.
+	 */
 };
 
 #endif /* _LINUX_BINDER_H */
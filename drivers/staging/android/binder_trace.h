@@ -0,0 +1,104 @@
+/*
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM binder
+
+#if !defined(_BINDER_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _BINDER_TRACE_H
+
+#include <linux/tracepoint.h>
+
+struct binder_transaction;
+struct binder_node;
+struct binder_proc;
+struct binder_thread;
+
+/* BC_TRANSACTION or BC_REPLY queued to the target */
+TRACE_EVENT(binder_transaction,
+	TP_PROTO(bool reply, struct binder_transaction *t,
+		 struct binder_node *target_node),
+	TP_ARGS(reply, t, target_node),
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, target_node)
+		__field(int, to_proc)
+		__field(int, to_thread)
+		__field(int, reply)
+		__field(unsigned int, code)
+		__field(unsigned int, flags)
+		__field(size_t, size)
+	),
+	TP_fast_assign(
+		__entry->debug_id = t->debug_id;
+		__entry->target_node = target_node ? target_node->debug_id : 0;
+		__entry->to_proc = t->to_proc->pid;
+		__entry->to_thread = t->to_thread ? t->to_thread->pid : 0;
+		__entry->reply = reply;
+		__entry->code = t->code;
+		__entry->flags = t->flags;
+		__entry->size = t->buffer->data_size;
+	),
+	TP_printk("transaction=%d dest_node=%d dest_proc=%d dest_thread=%d "
+		  "reply=%d flags=0x%x code=0x%x size=%zd",
+		  __entry->debug_id, __entry->target_node,
+		  __entry->to_proc, __entry->to_thread,
+		  __entry->reply, __entry->flags, __entry->code,
+		  __entry->size)
+);
+
+/* A thread sleeping in binder_thread_read() woke up */
+TRACE_EVENT(binder_wakeup,
+	TP_PROTO(struct binder_thread *thread, bool proc_work, int ret),
+	TP_ARGS(thread, proc_work, ret),
+	TP_STRUCT__entry(
+		__field(int, proc)
+		__field(int, thread)
+		__field(int, proc_work)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__entry->proc = thread->proc->pid;
+		__entry->thread = thread->pid;
+		__entry->proc_work = proc_work;
+		__entry->ret = ret;
+	),
+	TP_printk("proc=%d thread=%d proc_work=%d ret=%d",
+		  __entry->proc, __entry->thread, __entry->proc_work,
+		  __entry->ret)
+);
+
+/* BR_TRANSACTION or BR_REPLY handed to userspace */
+TRACE_EVENT(binder_transaction_received,
+	TP_PROTO(struct binder_transaction *t, uint32_t cmd, s64 queued_ns),
+	TP_ARGS(t, cmd, queued_ns),
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, reply)
+		__field(s64, queued_ns)
+	),
+	TP_fast_assign(
+		__entry->debug_id = t->debug_id;
+		__entry->reply = cmd == BR_REPLY;
+		__entry->queued_ns = queued_ns;
+	),
+	TP_printk("transaction=%d reply=%d queued=%lldns",
+		  __entry->debug_id, __entry->reply, __entry->queued_ns)
+);
+
+#endif /* _BINDER_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_PATH .
+#define TRACE_INCLUDE_FILE binder_trace
+#include <trace/define_trace.h>
@@ -25,10 +25,76 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/percpu.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
 
+/* Bytes of per-CPU staging space per log */
+#define LOGGER_STAGING_SIZE	(16*1024)
+
+/* Limits for LOGGER_SET_LOG_BUF_SIZE */
+#define LOGGER_MIN_SIZE		(64*1024)
+#define LOGGER_MAX_SIZE		(16*1024*1024)
+
+/*
+ * Once a log is full, a UID holding more than this share of it has its new
+ * entries dropped instead of evicting other UIDs' history. UID 0 is exempt.
+ * Zero disables the quota.
+ */
+static unsigned int logger_uid_quota_percent;
+module_param_named(uid_quota_percent, logger_uid_quota_percent, uint,
+		   S_IWUSR | S_IRUGO);
+
+#define LOGGER_UID_HASH_BITS	4
+
+/*
+ * struct logger_uid_usage - bytes of a log's ring held by one UID's entries
+ * Protected by log->mutex.
+ */
+struct logger_uid_usage {
+	struct hlist_node	node;
+	uid_t			uid;
+	size_t			bytes;
+	unsigned long		dropped;	/* entries dropped over quota */
+};
+
+/*
+ * struct logger_staging - a CPU's staging area for one log
+ *
+ * Writers append whole entries here under 'lock', which is only contended
+ * by a merge. logger_merge() moves them into the ring under log->mutex.
+ * 'merge_end' and 'merge_pos' belong to the merge and are protected by
+ * log->mutex.
+ */
+struct logger_staging {
+	spinlock_t		lock;
+	unsigned char		*buf;
+	size_t			used;
+	size_t			merge_end;
+	size_t			merge_pos;
+};
+
+/*
+ * struct logger_staged - an entry in a staging area. Entries are padded to
+ * a multiple of 4 bytes.
+ */
+struct logger_staged {
+	u32			seq;	/* position in the log's write order */
+	struct logger_entry	hdr;
+	char			msg[0];
+};
+
+#define staged_size(len) \
+	ALIGN(sizeof(struct logger_staged) + (len), 4)
+
 /*
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  *
@@ -45,6 +111,13 @@ struct logger_log {
 	size_t			w_off;	/* current write head offset */
 	size_t			head;	/* new readers start here */
 	size_t			size;	/* size of the log */
+	struct logger_staging __percpu *staging; /* unmerged writes */
+	atomic_t		seq;	/* last sequence number handed out */
+	struct work_struct	merge_work;
+	struct logger_mmap_header *mmap_hdr; /* first page of an mmap */
+	spinlock_t		mmap_lock; /* buffer and size vs. mmap */
+	int			mmap_count; /* live mappings, -1 while resizing */
+	struct hlist_head	uid_usage[1 << LOGGER_UID_HASH_BITS];
 };
 
 /*
@@ -59,6 +132,11 @@ struct logger_reader {
 	size_t			r_off;	/* current read head offset */
 	bool			r_all;	/* reader can read all entries */
 	int			r_ver;	/* reader ABI version */
+	bool			r_batch; /* read() returns many entries */
+	size_t			poll_bytes; /* see LOGGER_SET_POLL_THRESHOLD */
+	unsigned int		poll_ms;
+	unsigned long		pending_since; /* jiffies, 0 if not pending */
+	struct timer_list	poll_timer; /* wakes poll after poll_ms */
 };
 
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
@@ -215,6 +293,19 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 	return count + get_user_hdr_len(reader->r_ver);
 }
 
+/*
+ * logger_unread - bytes between the reader's offset and the write head
+ *
+ * Caller must hold log->mutex.
+ */
+static size_t logger_unread(struct logger_log *log,
+			    struct logger_reader *reader)
+{
+	if (log->w_off >= reader->r_off)
+		return log->w_off - reader->r_off;
+	return (log->size - reader->r_off) + log->w_off;
+}
+
 /*
  * get_next_entry_by_uid - Starting at 'off', returns an offset into
  * 'log->buffer' which contains the first entry readable by 'euid'
@@ -239,6 +330,8 @@ static size_t get_next_entry_by_uid(struct logger_log *log,
 	return off;
 }
 
+static void logger_merge(struct logger_log *log);
+
 /*
  * logger_read - our log's read() method
  *
@@ -246,7 +339,8 @@ static size_t get_next_entry_by_uid(struct logger_log *log,
  *
  *	- O_NONBLOCK works
  *	- If there are no log entries to read, blocks until log is written to
- *	- Atomically reads exactly one log entry
+ *	- Atomically reads exactly one log entry, or in batch mode as many
+ *	  whole entries as fit in 'buf'
  *
  * Will set errno to EINVAL if read
  * buffer is insufficient to hold next entry.
@@ -265,6 +359,7 @@ start:
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
+		logger_merge(log);
 		ret = (log->w_off == reader->r_off);
 		mutex_unlock(&log->mutex);
 		if (!ret)
@@ -310,6 +405,29 @@ start:
 	/* get exactly one entry from the log */
 	ret = do_read_log_to_user(log, reader, buf, ret);
 
+	while (reader->r_batch && ret > 0) {
+		ssize_t len, nr;
+
+		if (!reader->r_all)
+			reader->r_off = get_next_entry_by_uid(log,
+				reader->r_off, current_euid());
+		if (log->w_off == reader->r_off)
+			break;
+
+		len = get_user_hdr_len(reader->r_ver) +
+			get_entry_msg_len(log, reader->r_off);
+		if (count - ret < len)
+			break;
+
+		/* a fault leaves r_off on this entry; return what we have */
+		nr = do_read_log_to_user(log, reader, buf + ret, len);
+		if (nr < 0)
+			break;
+		ret += nr;
+	}
+	if (log->w_off == reader->r_off)
+		reader->pending_since = 0;
+
 out:
 	mutex_unlock(&log->mutex);
 
@@ -365,6 +483,102 @@ static inline int is_between(size_t a, size_t b, size_t c)
 	return 0;
 }
 
+/*
+ * logger_uid_usage - find, and if 'create' allocate, the usage of 'uid'
+ *
+ * Caller must hold log->mutex.
+ */
+static struct logger_uid_usage *logger_uid_usage(struct logger_log *log,
+						 uid_t uid, bool create)
+{
+	struct hlist_head *bucket;
+	struct logger_uid_usage *usage;
+	struct hlist_node *pos;
+
+	bucket = &log->uid_usage[hash_32(uid, LOGGER_UID_HASH_BITS)];
+	hlist_for_each_entry(usage, pos, bucket, node)
+		if (usage->uid == uid)
+			return usage;
+
+	if (!create)
+		return NULL;
+
+	usage = kzalloc(sizeof(*usage), GFP_KERNEL);
+	if (usage) {
+		usage->uid = uid;
+		hlist_add_head(&usage->node, bucket);
+	}
+	return usage;
+}
+
+static void logger_uid_uncharge(struct logger_log *log, uid_t uid, size_t len)
+{
+	struct logger_uid_usage *usage = logger_uid_usage(log, uid, false);
+
+	if (usage)
+		usage->bytes -= min(usage->bytes, len);
+}
+
+/*
+ * logger_over_quota - would writing 'len' bytes for 'uid' evict older
+ * entries while 'uid' already holds more than its share of the log?
+ *
+ * Caller must hold log->mutex.
+ */
+static bool logger_over_quota(struct logger_log *log, uid_t uid, size_t len)
+{
+	struct logger_uid_usage *usage;
+	size_t quota;
+
+	if (!logger_uid_quota_percent || !uid)
+		return false;
+	if (!is_between(log->w_off, logger_offset(log, log->w_off + len),
+			log->head))
+		return false;
+
+	quota = log->size / 100 * logger_uid_quota_percent;
+	usage = logger_uid_usage(log, uid, true);
+	if (!usage || usage->bytes + len <= quota)
+		return false;
+
+	usage->dropped++;
+	return true;
+}
+
+static void logger_uid_reset(struct logger_log *log)
+{
+	struct logger_uid_usage *usage;
+	struct hlist_node *pos;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(log->uid_usage); i++)
+		hlist_for_each_entry(usage, pos, &log->uid_usage[i], node)
+			usage->bytes = 0;
+}
+
+/*
+ * advance_head - drop the entries at the head of the log until at least
+ * 'len' bytes are free, and uncharge their UIDs.
+ *
+ * Caller must hold log->mutex.
+ */
+static void advance_head(struct logger_log *log, size_t len)
+{
+	size_t count = 0;
+
+	do {
+		struct logger_entry scratch;
+		struct logger_entry *entry;
+		size_t nr;
+
+		entry = get_entry_header(log, log->head, &scratch);
+		nr = sizeof(struct logger_entry) + entry->len;
+		logger_uid_uncharge(log, entry->euid, nr);
+		log->head = logger_offset(log, log->head + nr);
+		count += nr;
+	} while (count < len);
+}
+
 /*
  * fix_up_readers - walk the list of all readers and "fix up" any who were
  * lapped by the writer; also do the same for the default "start head".
@@ -380,7 +594,7 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 	struct logger_reader *reader;
 
 	if (is_between(old, new, log->head))
-		log->head = get_next_entry(log, log->head, len);
+		advance_head(log, len);
 
 	list_for_each_entry(reader, &log->readers, list)
 		if (is_between(old, new, reader->r_off))
@@ -407,50 +621,193 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 }
 
 /*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
+ * logger_mmap_begin/logger_mmap_end - bracket ring updates for mmap readers
  *
  * The caller needs to hold log->mutex.
+ */
+static void logger_mmap_begin(struct logger_log *log)
+{
+	log->mmap_hdr->seq++;
+	smp_wmb();
+}
+
+static void logger_mmap_end(struct logger_log *log)
+{
+	log->mmap_hdr->w_off = log->w_off;
+	log->mmap_hdr->head = log->head;
+	smp_wmb();
+	log->mmap_hdr->seq++;
+}
+
+/*
+ * logger_merge - move every staged entry into the ring, in sequence order
  *
- * Returns 'count' on success, negative error code on failure.
+ * Only entries numbered up to the sequence counter as read on entry are
+ * merged. A writer takes its CPU's staging lock before it is numbered and
+ * drops it once the entry is complete, so by the time the merge has taken
+ * each CPU's lock all of those entries are complete and none numbered
+ * later can be needed to keep the ring in order.
+ *
+ * The caller needs to hold log->mutex.
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
+static void logger_merge(struct logger_log *log)
 {
-	size_t len;
+	u32 limit = atomic_read(&log->seq);
+	bool merged = false;
+	int cpu;
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
+	for_each_possible_cpu(cpu) {
+		struct logger_staging *st = per_cpu_ptr(log->staging, cpu);
 
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
-			/*
-			 * Note that by not updating w_off, this abandons the
-			 * portion of the new entry that *was* successfully
-			 * copied, just above.  This is intentional to avoid
-			 * message corruption from missing fragments.
-			 */
-			return -EFAULT;
+		spin_lock(&st->lock);
+		st->merge_end = st->used;
+		spin_unlock(&st->lock);
+		st->merge_pos = 0;
+	}
 
-	log->w_off = logger_offset(log, log->w_off + count);
+	while (1) {
+		struct logger_staging *next = NULL;
+		struct logger_staged *e, *first = NULL;
+		struct logger_uid_usage *usage;
+		size_t len;
+
+		for_each_possible_cpu(cpu) {
+			struct logger_staging *st = per_cpu_ptr(log->staging,
+								cpu);
+
+			if (st->merge_pos == st->merge_end)
+				continue;
+			e = (struct logger_staged *)(st->buf + st->merge_pos);
+			if ((s32)(e->seq - limit) > 0)
+				continue;
+			if (!first || (s32)(e->seq - first->seq) < 0) {
+				first = e;
+				next = st;
+			}
+		}
+		if (!first)
+			break;
+		if (!merged) {
+			logger_mmap_begin(log);
+			merged = true;
+		}
+
+		next->merge_pos += staged_size(first->hdr.len);
+		len = sizeof(struct logger_entry) + first->hdr.len;
+		if (logger_over_quota(log, first->hdr.euid, len))
+			continue;
+
+		/*
+		 * Fix up any readers, pulling them forward to the first
+		 * readable entry after (what will be) the new write offset.
+		 */
+		fix_up_readers(log, len);
+		do_write_log(log, &first->hdr, sizeof(struct logger_entry));
+		do_write_log(log, first->msg, first->hdr.len);
+		usage = logger_uid_usage(log, first->hdr.euid, true);
+		if (usage)
+			usage->bytes += len;
+	}
+	if (merged)
+		logger_mmap_end(log);
+
+	for_each_possible_cpu(cpu) {
+		struct logger_staging *st = per_cpu_ptr(log->staging, cpu);
+
+		if (!st->merge_pos)
+			continue;
+		spin_lock(&st->lock);
+		st->used -= st->merge_pos;
+		memmove(st->buf, st->buf + st->merge_pos, st->used);
+		spin_unlock(&st->lock);
+	}
+}
+
+static void logger_merge_work(struct work_struct *work)
+{
+	struct logger_log *log = container_of(work, struct logger_log,
+					      merge_work);
+
+	mutex_lock(&log->mutex);
+	logger_merge(log);
+	mutex_unlock(&log->mutex);
+}
+
+/*
+ * logger_stage - append one entry to the current CPU's staging area
+ *
+ * The payload comes from 'kbuf' if it is set and from the user iovec
+ * otherwise; user memory is copied with page faults disabled. Returns 0 on
+ * success, -ENOSPC if the staging area is full and -EFAULT if the user
+ * copy would have faulted.
+ */
+static int logger_stage(struct logger_log *log, struct logger_entry *header,
+			const void *kbuf, const struct iovec *iov,
+			unsigned long nr_segs)
+{
+	size_t need = staged_size(header->len);
+	struct logger_staging *st;
+	struct logger_staged *e;
+	int ret = 0;
+
+	st = get_cpu_ptr(log->staging);
+	spin_lock(&st->lock);
+	if (st->used + need > LOGGER_STAGING_SIZE) {
+		ret = -ENOSPC;
+		goto out;
+	}
 
-	return count;
+	e = (struct logger_staged *)(st->buf + st->used);
+	if (kbuf)
+		memcpy(e->msg, kbuf, header->len);
+	else {
+		size_t done = 0;
+
+		pagefault_disable();
+		while (nr_segs-- > 0 && done < header->len) {
+			size_t len = min_t(size_t, iov->iov_len,
+					   header->len - done);
+
+			if (__copy_from_user_inatomic(e->msg + done,
+						      iov->iov_base, len)) {
+				ret = -EFAULT;
+				break;
+			}
+			iov++;
+			done += len;
+		}
+		pagefault_enable();
+		if (ret)
+			goto out;
+	}
+
+	e->hdr = *header;
+	e->seq = atomic_inc_return(&log->seq);
+	st->used += need;
+out:
+	spin_unlock(&st->lock);
+	put_cpu_ptr(log->staging);
+	return ret;
 }
 
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
  * them above all else.
+ *
+ * Entries are staged on the writer's CPU and merged into the ring by
+ * readers or by merge_work, so writers do not take log->mutex unless
+ * their CPU's staging area is full.
  */
 ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
 	struct logger_entry header;
 	struct timespec now;
-	ssize_t ret = 0;
+	void *kbuf = NULL;
+	unsigned long seg;
+	int ret;
 
 	now = current_kernel_time();
 
@@ -466,47 +823,55 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
-
-	while (nr_segs-- > 0) {
-		size_t len;
-		ssize_t nr;
-
-		/* figure out how much of this vector we can keep */
-		len = min_t(size_t, iov->iov_len, header.len - ret);
+	for (seg = 0; seg < nr_segs; seg++)
+		if (unlikely(!access_ok(VERIFY_READ, iov[seg].iov_base,
+					iov[seg].iov_len)))
+			return -EFAULT;
 
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
+	while ((ret = logger_stage(log, &header, kbuf, iov, nr_segs))) {
+		if (ret == -EFAULT && !kbuf) {
+			/* payload not resident: fault it in outside the lock */
+			size_t done = 0;
+
+			kbuf = kmalloc(header.len, GFP_KERNEL);
+			if (!kbuf)
+				return -ENOMEM;
+			for (seg = 0; seg < nr_segs && done < header.len; seg++) {
+				size_t len = min_t(size_t, iov[seg].iov_len,
+						   header.len - done);
+
+				if (copy_from_user(kbuf + done,
+						   iov[seg].iov_base, len)) {
+					kfree(kbuf);
+					return -EFAULT;
+				}
+				done += len;
+			}
+		} else if (ret == -ENOSPC) {
+			mutex_lock(&log->mutex);
+			logger_merge(log);
 			mutex_unlock(&log->mutex);
-			return nr;
 		}
-
-		iov++;
-		ret += nr;
 	}
+	kfree(kbuf);
 
-	mutex_unlock(&log->mutex);
+	schedule_work(&log->merge_work);
 
 	/* wake up any blocked readers */
 	wake_up_interruptible(&log->wq);
 
-	return ret;
+	return header.len;
 }
 
 static struct logger_log *get_log_from_minor(int);
 
+static void logger_poll_timeout(unsigned long data)
+{
+	struct logger_reader *reader = (struct logger_reader *) data;
+
+	wake_up_interruptible(&reader->log->wq);
+}
+
 /*
  * logger_open - the log's open() file operation
  *
@@ -534,12 +899,19 @@ static int logger_open(struct inode *inode, struct file *file)
 
 		reader->log = log;
 		reader->r_ver = 1;
+		reader->r_batch = false;
+		reader->poll_bytes = 0;
+		reader->poll_ms = 0;
+		reader->pending_since = 0;
+		setup_timer(&reader->poll_timer, logger_poll_timeout,
+			    (unsigned long) reader);
 		reader->r_all = in_egroup_p(inode->i_gid) ||
 			capable(CAP_SYSLOG);
 
 		INIT_LIST_HEAD(&reader->list);
 
 		mutex_lock(&log->mutex);
+		logger_merge(log);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
 		mutex_unlock(&log->mutex);
@@ -566,12 +938,41 @@ static int logger_release(struct inode *ignored, struct file *file)
 		list_del(&reader->list);
 		mutex_unlock(&log->mutex);
 
+		del_timer_sync(&reader->poll_timer);
 		kfree(reader);
 	}
 
 	return 0;
 }
 
+/*
+ * logger_poll_ready - has enough unread data been queued, or queued for long
+ * enough, to report the log readable? Arms the reader's timer the first time
+ * unread data is seen below the byte threshold.
+ *
+ * Caller must hold log->mutex.
+ */
+static bool logger_poll_ready(struct logger_log *log,
+			      struct logger_reader *reader)
+{
+	if (!reader->poll_bytes ||
+	    logger_unread(log, reader) >= reader->poll_bytes)
+		return true;
+	if (!reader->poll_ms)
+		return false;
+
+	if (!reader->pending_since) {
+		reader->pending_since = jiffies ? jiffies : 1;
+		mod_timer(&reader->poll_timer,
+			  reader->pending_since +
+			  msecs_to_jiffies(reader->poll_ms));
+		return false;
+	}
+
+	return time_after_eq(jiffies, reader->pending_since +
+			     msecs_to_jiffies(reader->poll_ms));
+}
+
 /*
  * logger_poll - the log's poll file operation, for poll/select/epoll
  *
@@ -596,27 +997,195 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
+	logger_merge(log);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
 
-	if (log->w_off != reader->r_off)
+	if (log->w_off != reader->r_off && logger_poll_ready(log, reader))
 		ret |= POLLIN | POLLRDNORM;
 	mutex_unlock(&log->mutex);
 
 	return ret;
 }
 
+static void logger_vma_open(struct vm_area_struct *vma)
+{
+	struct logger_log *log = vma->vm_private_data;
+
+	spin_lock(&log->mmap_lock);
+	log->mmap_count++;
+	spin_unlock(&log->mmap_lock);
+}
+
+static void logger_vma_close(struct vm_area_struct *vma)
+{
+	struct logger_log *log = vma->vm_private_data;
+
+	spin_lock(&log->mmap_lock);
+	log->mmap_count--;
+	spin_unlock(&log->mmap_lock);
+}
+
+static const struct vm_operations_struct logger_vm_ops = {
+	.open = logger_vma_open,
+	.close = logger_vma_close,
+};
+
+/*
+ * logger_mmap - map the header page and the ring read-only, for readers
+ * allowed to see every entry
+ *
+ * This runs under mmap_sem and so cannot take log->mutex; counting the
+ * mapping under mmap_lock keeps logger_resize() away instead.
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_reader *reader;
+	struct logger_log *log;
+	unsigned char *buffer;
+	unsigned long addr;
+	size_t off, size;
+	int ret;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+
+	reader = file->private_data;
+	log = reader->log;
+	if (!reader->r_all)
+		return -EPERM;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	spin_lock(&log->mmap_lock);
+	buffer = log->buffer;
+	size = log->size;
+	if (log->mmap_count < 0) {
+		spin_unlock(&log->mmap_lock);
+		return -EBUSY;
+	}
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start != PAGE_SIZE + size) {
+		spin_unlock(&log->mmap_lock);
+		return -EINVAL;
+	}
+	log->mmap_count++;
+	spin_unlock(&log->mmap_lock);
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTEXPAND | VM_RESERVED;
+	vma->vm_private_data = log;
+	vma->vm_ops = &logger_vm_ops;
+
+	addr = vma->vm_start;
+	ret = vm_insert_page(vma, addr, virt_to_page(log->mmap_hdr));
+	for (off = 0; !ret && off < size; off += PAGE_SIZE) {
+		addr += PAGE_SIZE;
+		ret = vm_insert_page(vma, addr, vmalloc_to_page(buffer + off));
+	}
+
+	/* ->close is not called for a failed mmap */
+	if (ret)
+		logger_vma_close(vma);
+
+	return ret;
+}
+
+/*
+ * logger_resize - replace the ring of 'log' with a 'size' byte one, keeping
+ * the newest entries that fit and every reader's position among them
+ *
+ * Caller must hold log->mutex.
+ */
+static long logger_resize(struct logger_log *log, size_t size)
+{
+	struct logger_reader *reader;
+	unsigned char *buffer, *old;
+	size_t used, len;
+
+	if (!is_power_of_2(size) || size < LOGGER_MIN_SIZE ||
+	    size > LOGGER_MAX_SIZE)
+		return -EINVAL;
+
+	buffer = vmalloc(size);
+	if (!buffer)
+		return -ENOMEM;
+
+	/* a negative count keeps new mappings out until we are done */
+	spin_lock(&log->mmap_lock);
+	if (log->mmap_count) {
+		spin_unlock(&log->mmap_lock);
+		vfree(buffer);
+		return -EBUSY;
+	}
+	log->mmap_count = -1;
+	spin_unlock(&log->mmap_lock);
+
+	logger_mmap_begin(log);
+
+	/* drop the oldest entries until the rest fits with room to spare */
+	used = logger_offset(log, log->w_off - log->head);
+	if (used >= size)
+		advance_head(log, used - size + 1);
+	used = logger_offset(log, log->w_off - log->head);
+
+	len = min(used, log->size - log->head);
+	memcpy(buffer, log->buffer + log->head, len);
+	memcpy(buffer + len, log->buffer, used - len);
+
+	list_for_each_entry(reader, &log->readers, list) {
+		size_t dist = logger_offset(log, reader->r_off - log->head);
+
+		/* readers in the dropped part move to the new head */
+		reader->r_off = dist <= used ? dist : 0;
+	}
+
+	old = log->buffer;
+	spin_lock(&log->mmap_lock);
+	log->buffer = buffer;
+	log->size = size;
+	log->mmap_count = 0;
+	spin_unlock(&log->mmap_lock);
+	log->head = 0;
+	log->w_off = used;
+	log->mmap_hdr->size = size;
+	logger_mmap_end(log);
+	vfree(old);
+
+	return 0;
+}
+
 static long logger_set_version(struct logger_reader *reader, void __user *arg)
 {
 	int version;
+	bool batch;
 	if (copy_from_user(&version, arg, sizeof(int)))
 		return -EFAULT;
 
+	batch = !!(version & LOGGER_VERSION_BATCH_READ);
+	version &= ~LOGGER_VERSION_BATCH_READ;
 	if ((version < 1) || (version > 2))
 		return -EINVAL;
 
 	reader->r_ver = version;
+	reader->r_batch = batch;
+	return 0;
+}
+
+static long logger_set_poll_threshold(struct logger_reader *reader,
+				      void __user *arg)
+{
+	struct logger_poll_threshold thresh;
+
+	if (copy_from_user(&thresh, arg, sizeof(thresh)))
+		return -EFAULT;
+
+	if (thresh.bytes > reader->log->size)
+		return -EINVAL;
+
+	reader->poll_bytes = thresh.bytes;
+	reader->poll_ms = thresh.ms;
+	reader->pending_since = 0;
 	return 0;
 }
 
@@ -628,6 +1197,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	void __user *argp = (void __user *) arg;
 
 	mutex_lock(&log->mutex);
+	logger_merge(log);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -639,10 +1209,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		reader = file->private_data;
-		if (log->w_off >= reader->r_off)
-			ret = log->w_off - reader->r_off;
-		else
-			ret = (log->size - reader->r_off) + log->w_off;
+		ret = logger_unread(log, reader);
 		break;
 	case LOGGER_GET_NEXT_ENTRY_LEN:
 		if (!(file->f_mode & FMODE_READ)) {
@@ -668,7 +1235,10 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 		list_for_each_entry(reader, &log->readers, list)
 			reader->r_off = log->w_off;
+		logger_mmap_begin(log);
 		log->head = log->w_off;
+		logger_mmap_end(log);
+		logger_uid_reset(log);
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -687,6 +1257,21 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		reader = file->private_data;
 		ret = logger_set_version(reader, argp);
 		break;
+	case LOGGER_SET_POLL_THRESHOLD:
+		if (!(file->f_mode & FMODE_READ)) {
+			ret = -EBADF;
+			break;
+		}
+		reader = file->private_data;
+		ret = logger_set_poll_threshold(reader, argp);
+		break;
+	case LOGGER_SET_LOG_BUF_SIZE:
+		if (!capable(CAP_SYSLOG)) {
+			ret = -EPERM;
+			break;
+		}
+		ret = logger_resize(log, arg);
+		break;
 	}
 
 	mutex_unlock(&log->mutex);
@@ -699,6 +1284,7 @@ static const struct file_operations logger_fops = {
 	.read = logger_read,
 	.aio_write = logger_aio_write,
 	.poll = logger_poll,
+	.mmap = logger_mmap,
 	.unlocked_ioctl = logger_ioctl,
 	.compat_ioctl = logger_ioctl,
 	.open = logger_open,
@@ -706,14 +1292,13 @@ static const struct file_operations logger_fops = {
 };
 
 /*
- * Defines a log structure with name 'NAME' and a size of 'SIZE' bytes, which
- * must be a power of two, and greater than
- * (LOGGER_ENTRY_MAX_PAYLOAD + sizeof(struct logger_entry)).
+ * Defines a log structure with name 'NAME' and an initial size of 'SIZE'
+ * bytes, which must be a power of two between LOGGER_MIN_SIZE and
+ * LOGGER_MAX_SIZE. The ring is vmalloc()ed by init_log() and can be resized
+ * with LOGGER_SET_LOG_BUF_SIZE.
  */
 #define DEFINE_LOGGER_DEVICE(VAR, NAME, SIZE) \
-static unsigned char _buf_ ## VAR[SIZE]; \
 static struct logger_log VAR = { \
-	.buffer = _buf_ ## VAR, \
 	.misc = { \
 		.minor = MISC_DYNAMIC_MINOR, \
 		.name = NAME, \
@@ -726,6 +1311,9 @@ static struct logger_log VAR = { \
 	.w_off = 0, \
 	.head = 0, \
 	.size = SIZE, \
+	.seq = ATOMIC_INIT(0), \
+	.merge_work = __WORK_INITIALIZER(VAR .merge_work, logger_merge_work), \
+	.mmap_lock = __SPIN_LOCK_UNLOCKED(VAR .mmap_lock), \
 };
 
 DEFINE_LOGGER_DEVICE(log_main, LOGGER_LOG_MAIN, 256*1024)
@@ -748,7 +1336,29 @@ static struct logger_log *get_log_from_minor(int minor)
 
 static int __init init_log(struct logger_log *log)
 {
-	int ret;
+	int ret, cpu;
+
+	log->buffer = vmalloc(log->size);
+	if (!log->buffer)
+		return -ENOMEM;
+
+	log->mmap_hdr = (void *) get_zeroed_page(GFP_KERNEL);
+	if (!log->mmap_hdr)
+		return -ENOMEM;
+	log->mmap_hdr->version = LOGGER_MMAP_VERSION;
+	log->mmap_hdr->size = log->size;
+
+	log->staging = alloc_percpu(struct logger_staging);
+	if (!log->staging)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu) {
+		struct logger_staging *st = per_cpu_ptr(log->staging, cpu);
+
+		spin_lock_init(&st->lock);
+		st->buf = kmalloc(LOGGER_STAGING_SIZE, GFP_KERNEL);
+		if (!st->buf)
+			return -ENOMEM;
+	}
 
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
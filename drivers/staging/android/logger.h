@@ -51,6 +51,25 @@ struct logger_entry {
 	char		msg[0];		/* the entry's payload */
 };
 
+/*
+ * A reader allowed to read every entry may mmap() a log read-only: the
+ * first page holds this header, and the ring itself follows it, 'size'
+ * bytes long. Around every update of the ring the driver makes 'seq' odd,
+ * and then even again once 'w_off' and 'head' are current. A collector
+ * copies from its offset up to 'w_off' and re-reads 'seq'. If 'seq'
+ * changed, the copy may have been overwritten by the writer and must be
+ * checked against the new 'w_off'.
+ */
+#define LOGGER_MMAP_VERSION	1
+
+struct logger_mmap_header {
+	__u32		version;	/* LOGGER_MMAP_VERSION */
+	__u32		size;		/* size of the ring */
+	__u32		seq;
+	__u32		w_off;		/* write head offset into the ring */
+	__u32		head;		/* oldest entry in the ring */
+};
+
 #define LOGGER_LOG_RADIO	"log_radio"	/* radio-related messages */
 #define LOGGER_LOG_EVENTS	"log_events"	/* system/hardware events */
 #define LOGGER_LOG_SYSTEM	"log_system"	/* system/framework messages */
@@ -58,6 +77,23 @@ struct logger_entry {
 
 #define LOGGER_ENTRY_MAX_PAYLOAD	4076
 
+/*
+ * OR'd into the version passed to LOGGER_SET_VERSION: each read() then
+ * returns as many whole entries as fit in the buffer instead of one.
+ */
+#define LOGGER_VERSION_BATCH_READ	0x100
+
+/*
+ * Argument of LOGGER_SET_POLL_THRESHOLD: poll() reports the log readable
+ * once 'bytes' unread bytes have accumulated, or once unread data has been
+ * pending for 'ms' milliseconds; zero 'ms' means no time limit. Zero
+ * 'bytes' restores the default of reporting any unread data.
+ */
+struct logger_poll_threshold {
+	__u32		bytes;
+	__u32		ms;
+};
+
 #define __LOGGERIO	0xAE
 
 #define LOGGER_GET_LOG_BUF_SIZE		_IO(__LOGGERIO, 1) /* size of log */
@@ -66,5 +102,8 @@ struct logger_entry {
 #define LOGGER_FLUSH_LOG		_IO(__LOGGERIO, 4) /* flush log */
 #define LOGGER_GET_VERSION		_IO(__LOGGERIO, 5) /* abi version */
 #define LOGGER_SET_VERSION		_IO(__LOGGERIO, 6) /* abi version */
+#define LOGGER_SET_POLL_THRESHOLD	_IOW(__LOGGERIO, 7, \
+					     struct logger_poll_threshold)
+#define LOGGER_SET_LOG_BUF_SIZE		_IO(__LOGGERIO, 8) /* resize log */
 
 #endif /* _LINUX_LOGGER_H */
@@ -17,6 +17,13 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * /dev/lowmemorykiller reports a reclaim pressure level of "low", "medium"
+ * or "critical", computed from the ratio of pages reclaimed to pages
+ * scanned over each window of pressure_window scanned pages.  It polls
+ * readable whenever a window completes, so userspace can trim caches or
+ * kill before the thresholds above are reached.  The in-kernel kill is
+ * kept as a fallback.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  *
  * This software is licensed under the terms of the GNU General Public
@@ -37,6 +44,24 @@
 #include <linux/sched.h>
 #include <linux/rcupdate.h>
 #include <linux/notifier.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/bitmap.h>
+#include <linux/spinlock.h>
+#include <linux/rculist_nulls.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/fs.h>
+#include <linux/vmstat.h>
+#include <linux/swap.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <trace/events/oom.h>
+#include <trace/events/sched.h>
+
+#define CREATE_TRACE_POINTS
+#include "lowmemorykiller_trace.h"
 
 static uint32_t lowmem_debug_level = 2;
 static int lowmem_adj[6] = {
@@ -55,6 +80,30 @@ static int lowmem_minfree[6] = {
 static int lowmem_minfree_size = 4;
 
 static unsigned long lowmem_deathpending_timeout;
+static ktime_t lowmem_crossed;
+
+/*
+ * The most recent victim, so that its exit can be timed and can end the
+ * deathpending wait early, and cumulative kill statistics.  Both are
+ * protected by lowmem_lock.
+ */
+static struct {
+	struct signal_struct *sig;
+	pid_t pid;
+	int tasksize;
+	long free_at_kill;
+	ktime_t kill_time;
+} lowmem_pending;
+
+static struct {
+	unsigned long kills;
+	unsigned long deferred;
+	unsigned long exited;
+	u64 kill_latency_ns;
+	u64 exit_latency_ns;
+	unsigned long estimated_pages;
+	long freed_pages;
+} lowmem_stats;
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -62,20 +111,453 @@ static unsigned long lowmem_deathpending_timeout;
 			printk(x);			\
 	} while (0)
 
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+/*
+ * Every thread group is tracked by a lowmem_proc that sits on the bucket
+ * for its current oom_score_adj, so that victim selection only has to
+ * look at the buckets at or above the minimum adj for the current free
+ * memory level, starting with the highest.  Buckets are indexed by
+ * OOM_SCORE_ADJ_MAX - oom_score_adj and a bit is set in lowmem_nonempty
+ * for each bucket that has entries.
+ *
+ * The buckets are kept up to date from the sched_process_fork,
+ * sched_process_exit and oom_score_adj_update tracepoints.  The last of
+ * these runs under the task's siglock, so lowmem_lock is taken with
+ * interrupts disabled and nothing that takes task_lock() may nest inside
+ * it.  The shrinker therefore walks the buckets under RCU only; a
+ * lowmem_proc can move to another bucket under a walker, so the buckets
+ * are nulls lists terminated by their own index and a walk that ends on
+ * the wrong one is restarted.
+ *
+ * If the tracepoints cannot be registered, or an entry cannot be
+ * allocated at fork time, lowmem_tracking is cleared and the shrinker
+ * falls back to scanning every process.
+ */
+#define LOWMEM_NR_BUCKETS	(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+#define LOWMEM_HASH_BITS	6
+
+struct lowmem_proc {
+	struct hlist_nulls_node node;
+	struct hlist_node hash;
+	struct signal_struct *sig;
+	struct pid *pid;
+	int bucket;
+	struct rcu_head rcu;
+};
+
+static DEFINE_SPINLOCK(lowmem_lock);
+static struct hlist_nulls_head lowmem_buckets[LOWMEM_NR_BUCKETS];
+static DECLARE_BITMAP(lowmem_nonempty, LOWMEM_NR_BUCKETS);
+static struct hlist_head lowmem_hash[1 << LOWMEM_HASH_BITS];
+static struct kmem_cache *lowmem_proc_cache;
+static bool lowmem_tracking;
+
+static int lowmem_bucket(int oom_score_adj)
+{
+	return OOM_SCORE_ADJ_MAX - oom_score_adj;
+}
+
+static struct lowmem_proc *lowmem_proc_lookup(struct signal_struct *sig)
+{
+	struct lowmem_proc *lp;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(lp, pos,
+			     &lowmem_hash[hash_ptr(sig, LOWMEM_HASH_BITS)],
+			     hash)
+		if (lp->sig == sig)
+			return lp;
+	return NULL;
+}
+
+static void lowmem_proc_link(struct lowmem_proc *lp, int bucket)
+{
+	lp->bucket = bucket;
+	hlist_nulls_add_head_rcu(&lp->node, &lowmem_buckets[bucket]);
+	set_bit(bucket, lowmem_nonempty);
+}
+
+static void lowmem_proc_unlink(struct lowmem_proc *lp)
+{
+	hlist_nulls_del_rcu(&lp->node);
+	if (hlist_nulls_empty(&lowmem_buckets[lp->bucket]))
+		clear_bit(lp->bucket, lowmem_nonempty);
+}
+
+static void lowmem_proc_free_rcu(struct rcu_head *head)
+{
+	struct lowmem_proc *lp = container_of(head, struct lowmem_proc, rcu);
+
+	put_pid(lp->pid);
+	kmem_cache_free(lowmem_proc_cache, lp);
+}
+
+/*
+ * Start tracking the thread group led by @tsk.  Called with lowmem_lock
+ * held; returns -ENOMEM if no entry could be allocated.
+ */
+static int lowmem_proc_add(struct task_struct *tsk)
+{
+	struct signal_struct *sig = tsk->signal;
+	struct lowmem_proc *lp;
+
+	if (!atomic_read(&sig->live) || lowmem_proc_lookup(sig))
+		return 0;
+
+	lp = kmem_cache_alloc(lowmem_proc_cache, GFP_ATOMIC);
+	if (!lp)
+		return -ENOMEM;
+	lp->sig = sig;
+	lp->pid = get_pid(task_tgid(tsk));
+	hlist_add_head(&lp->hash,
+		       &lowmem_hash[hash_ptr(sig, LOWMEM_HASH_BITS)]);
+	lowmem_proc_link(lp, lowmem_bucket(sig->oom_score_adj));
+	return 0;
+}
+
+static void lowmem_proc_del(struct lowmem_proc *lp)
+{
+	hlist_del(&lp->hash);
+	lowmem_proc_unlink(lp);
+	call_rcu(&lp->rcu, lowmem_proc_free_rcu);
+}
+
+static void lowmem_tracking_failed(void)
+{
+	if (lowmem_tracking)
+		pr_warn("lowmemorykiller: out of memory tracking processes, falling back to full scans\n");
+	lowmem_tracking = false;
+}
+
+static void lowmem_fork_probe(void *data, struct task_struct *parent,
+			      struct task_struct *child)
+{
+	unsigned long flags;
+
+	if (!thread_group_leader(child))
+		return;
+
+	spin_lock_irqsave(&lowmem_lock, flags);
+	if (lowmem_proc_add(child))
+		lowmem_tracking_failed();
+	spin_unlock_irqrestore(&lowmem_lock, flags);
+}
+
+static void lowmem_exit_probe(void *data, struct task_struct *tsk)
 {
+	struct lowmem_proc *lp;
+	unsigned long flags;
+	pid_t pid = 0;
+	int tasksize = 0;
+	long freed = 0;
+	s64 latency = 0;
+
+	/* Only the last thread of the group to exit drops the entry. */
+	if (atomic_read(&tsk->signal->live))
+		return;
+
+	spin_lock_irqsave(&lowmem_lock, flags);
+	lp = lowmem_proc_lookup(tsk->signal);
+	if (lp)
+		lowmem_proc_del(lp);
+	if (lowmem_pending.sig == tsk->signal) {
+		pid = lowmem_pending.pid;
+		tasksize = lowmem_pending.tasksize;
+		freed = global_page_state(NR_FREE_PAGES) -
+			lowmem_pending.free_at_kill;
+		latency = ktime_to_ns(ktime_sub(ktime_get(),
+						lowmem_pending.kill_time));
+		lowmem_pending.sig = NULL;
+		lowmem_stats.exited++;
+		lowmem_stats.exit_latency_ns += latency;
+		lowmem_stats.freed_pages += freed;
+		/* Let the next kill proceed without waiting out the timeout. */
+		lowmem_deathpending_timeout = jiffies - 1;
+	}
+	spin_unlock_irqrestore(&lowmem_lock, flags);
+
+	if (pid)
+		trace_lowmemory_victim_exit(pid, tasksize, freed, latency);
+}
+
+static void lowmem_adj_probe(void *data, struct task_struct *tsk)
+{
+	struct lowmem_proc *lp;
+	unsigned long flags;
+	int bucket;
+
+	spin_lock_irqsave(&lowmem_lock, flags);
+	lp = lowmem_proc_lookup(tsk->signal);
+	bucket = lowmem_bucket(tsk->signal->oom_score_adj);
+	if (lp && lp->bucket != bucket) {
+		lowmem_proc_unlink(lp);
+		lowmem_proc_link(lp, bucket);
+	}
+	spin_unlock_irqrestore(&lowmem_lock, flags);
+}
+
+struct lowmem_victim {
+	struct task_struct *task;
+	int tasksize;
+	int oom_score_adj;
+};
+
+/*
+ * Consider @tsk as a victim for a kill at @min_score_adj.  Called under
+ * rcu_read_lock(); returns -EBUSY if a previous victim is still dying.
+ */
+static int lowmem_consider(struct task_struct *tsk, int min_score_adj,
+			   struct lowmem_victim *v)
+{
+	struct task_struct *p;
+	int oom_score_adj;
+	int tasksize;
+
+	if (tsk->flags & PF_KTHREAD)
+		return 0;
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return 0;
+
+	if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
+	    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+		task_unlock(p);
+		return -EBUSY;
+	}
+	oom_score_adj = p->signal->oom_score_adj;
+	if (oom_score_adj < min_score_adj) {
+		task_unlock(p);
+		return 0;
+	}
+	tasksize = get_mm_rss(p->mm);
+	task_unlock(p);
+	if (tasksize <= 0)
+		return 0;
+	if (v->task) {
+		if (oom_score_adj < v->oom_score_adj)
+			return 0;
+		if (oom_score_adj == v->oom_score_adj &&
+		    tasksize <= v->tasksize)
+			return 0;
+	}
+	v->task = p;
+	v->tasksize = tasksize;
+	v->oom_score_adj = oom_score_adj;
+	lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
+		     p->pid, p->comm, oom_score_adj, tasksize);
+	return 0;
+}
+
+static int lowmem_select_all(int min_score_adj, struct lowmem_victim *v)
+{
+	struct task_struct *tsk;
+
+	for_each_process(tsk) {
+		if (lowmem_consider(tsk, min_score_adj, v))
+			return -EBUSY;
+	}
+	return 0;
+}
+
+/*
+ * Walk the buckets from the highest oom_score_adj down to @min_score_adj
+ * and stop at the first one that yields a victim.
+ */
+static int lowmem_select_buckets(int min_score_adj, struct lowmem_victim *v)
+{
+	int nr = lowmem_bucket(min_score_adj) + 1;
+	struct lowmem_proc *lp;
+	struct hlist_nulls_node *pos;
 	struct task_struct *tsk;
-	struct task_struct *selected = NULL;
+	int bucket;
+
+	for_each_set_bit(bucket, lowmem_nonempty, nr) {
+restart:
+		hlist_nulls_for_each_entry_rcu(lp, pos,
+					       &lowmem_buckets[bucket], node) {
+			tsk = pid_task(lp->pid, PIDTYPE_PID);
+			if (tsk && lowmem_consider(tsk, min_score_adj, v))
+				return -EBUSY;
+		}
+		if (get_nulls_value(pos) != bucket)
+			goto restart;
+		if (v->task)
+			break;
+	}
+	return 0;
+}
+
+enum lowmem_pressure_level {
+	LOWMEM_PRESSURE_LOW,
+	LOWMEM_PRESSURE_MEDIUM,
+	LOWMEM_PRESSURE_CRITICAL,
+};
+
+static const char * const lowmem_pressure_names[] = {
+	[LOWMEM_PRESSURE_LOW]		= "low",
+	[LOWMEM_PRESSURE_MEDIUM]	= "medium",
+	[LOWMEM_PRESSURE_CRITICAL]	= "critical",
+};
+
+static unsigned int lowmem_pressure_window = SWAP_CLUSTER_MAX * 16;
+static unsigned int lowmem_pressure_medium = 60;
+static unsigned int lowmem_pressure_critical = 95;
+
+static DEFINE_SPINLOCK(lowmem_pressure_lock);
+static DECLARE_WAIT_QUEUE_HEAD(lowmem_pressure_wait);
+static unsigned long lowmem_pressure_scanned;
+static unsigned long lowmem_pressure_reclaimed;
+static unsigned int lowmem_pressure;
+static enum lowmem_pressure_level lowmem_pressure_level;
+static atomic_t lowmem_pressure_seq = ATOMIC_INIT(0);
+
+#ifdef CONFIG_VM_EVENT_COUNTERS
+/* The per-zone items of each reclaim event are contiguous. */
+#define LOWMEM_NR_ZONE_EVENTS	(PGSCAN_DIRECT_MOVABLE - PGSCAN_KSWAPD_MOVABLE)
+
+static unsigned long lowmem_sum_events(int last)
+{
+	unsigned long sum = 0;
+	int first = last - 2 * LOWMEM_NR_ZONE_EVENTS + 1;
+	int cpu;
+	int i;
+
+	for_each_online_cpu(cpu) {
+		struct vm_event_state *this = &per_cpu(vm_event_states, cpu);
+
+		for (i = first; i <= last; i++)
+			sum += this->event[i];
+	}
+	return sum;
+}
+
+/*
+ * Sample the kswapd and direct reclaim counters and, once a full window
+ * of pages has been scanned since the last sample, turn the fraction
+ * that could not be reclaimed into a pressure level and wake pollers.
+ * Called from the shrinker, i.e. only while reclaim is running.
+ */
+static void lowmem_pressure_update(void)
+{
+	unsigned long scanned, reclaimed;
+	unsigned long delta_scanned, delta_reclaimed;
+	unsigned int pressure;
+
+	if (!spin_trylock(&lowmem_pressure_lock))
+		return;
+
+	scanned = lowmem_sum_events(PGSCAN_DIRECT_MOVABLE);
+	reclaimed = lowmem_sum_events(PGSTEAL_DIRECT_MOVABLE);
+	delta_scanned = scanned - lowmem_pressure_scanned;
+	delta_reclaimed = reclaimed - lowmem_pressure_reclaimed;
+	if (!lowmem_pressure_window ||
+	    delta_scanned < lowmem_pressure_window) {
+		spin_unlock(&lowmem_pressure_lock);
+		return;
+	}
+	lowmem_pressure_scanned = scanned;
+	lowmem_pressure_reclaimed = reclaimed;
+
+	if (delta_reclaimed >= delta_scanned)
+		pressure = 0;
+	else
+		pressure = 100 - delta_reclaimed * 100 / delta_scanned;
+	lowmem_pressure = pressure;
+	if (pressure >= lowmem_pressure_critical)
+		lowmem_pressure_level = LOWMEM_PRESSURE_CRITICAL;
+	else if (pressure >= lowmem_pressure_medium)
+		lowmem_pressure_level = LOWMEM_PRESSURE_MEDIUM;
+	else
+		lowmem_pressure_level = LOWMEM_PRESSURE_LOW;
+	atomic_inc(&lowmem_pressure_seq);
+	spin_unlock(&lowmem_pressure_lock);
+
+	lowmem_print(4, "lowmem pressure %u, %s\n", pressure,
+		     lowmem_pressure_names[lowmem_pressure_level]);
+	wake_up_interruptible(&lowmem_pressure_wait);
+}
+#else
+static void lowmem_pressure_update(void)
+{
+}
+#endif
+
+static int lowmem_pressure_open(struct inode *inode, struct file *file)
+{
+	int ret = nonseekable_open(inode, file);
+
+	if (ret)
+		return ret;
+	file->private_data = (void *)(long)atomic_read(&lowmem_pressure_seq);
+	return 0;
+}
+
+/*
+ * Each read returns the level and pressure of the most recent window
+ * and marks it as seen, so that poll only fires for newer windows.
+ */
+static ssize_t lowmem_pressure_read(struct file *file, char __user *buf,
+				    size_t count, loff_t *pos)
+{
+	char tmp[32];
+	int len;
+	int seq;
+
+	spin_lock(&lowmem_pressure_lock);
+	seq = atomic_read(&lowmem_pressure_seq);
+	len = scnprintf(tmp, sizeof(tmp), "%s %u\n",
+			lowmem_pressure_names[lowmem_pressure_level],
+			lowmem_pressure);
+	spin_unlock(&lowmem_pressure_lock);
+
+	if (count < len)
+		return -EINVAL;
+	if (copy_to_user(buf, tmp, len))
+		return -EFAULT;
+	file->private_data = (void *)(long)seq;
+	return len;
+}
+
+static unsigned int lowmem_pressure_poll(struct file *file, poll_table *wait)
+{
+	int seen = (long)file->private_data;
+
+	poll_wait(file, &lowmem_pressure_wait, wait);
+	if (atomic_read(&lowmem_pressure_seq) != seen)
+		return POLLIN | POLLRDNORM | POLLPRI;
+	return 0;
+}
+
+static const struct file_operations lowmem_pressure_fops = {
+	.owner = THIS_MODULE,
+	.open = lowmem_pressure_open,
+	.read = lowmem_pressure_read,
+	.poll = lowmem_pressure_poll,
+	.llseek = no_llseek,
+};
+
+static struct miscdevice lowmem_pressure_misc = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "lowmemorykiller",
+	.fops = &lowmem_pressure_fops,
+};
+
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	struct lowmem_victim victim = { NULL };
 	int rem = 0;
-	int tasksize;
 	int i;
 	int min_score_adj = OOM_SCORE_ADJ_MAX + 1;
-	int selected_tasksize = 0;
-	int selected_oom_score_adj;
 	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free = global_page_state(NR_FREE_PAGES);
 	int other_file = global_page_state(NR_FILE_PAGES) -
 						global_page_state(NR_SHMEM);
+	unsigned long flags;
+	ktime_t now;
+	s64 latency;
+	int ret;
+
+	lowmem_pressure_update();
 
 	if (lowmem_adj_size < array_size)
 		array_size = lowmem_adj_size;
@@ -96,61 +578,58 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		global_page_state(NR_ACTIVE_FILE) +
 		global_page_state(NR_INACTIVE_ANON) +
 		global_page_state(NR_INACTIVE_FILE);
+	if (min_score_adj == OOM_SCORE_ADJ_MAX + 1)
+		lowmem_crossed = ktime_set(0, 0);
+	else if (!lowmem_crossed.tv64)
+		lowmem_crossed = ktime_get();
 	if (sc->nr_to_scan <= 0 || min_score_adj == OOM_SCORE_ADJ_MAX + 1) {
 		lowmem_print(5, "lowmem_shrink %lu, %x, return %d\n",
 			     sc->nr_to_scan, sc->gfp_mask, rem);
 		return rem;
 	}
-	selected_oom_score_adj = min_score_adj;
+	if (min_score_adj < OOM_SCORE_ADJ_MIN)
+		min_score_adj = OOM_SCORE_ADJ_MIN;
 
 	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		int oom_score_adj;
-
-		if (tsk->flags & PF_KTHREAD)
-			continue;
-
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
-
-		if (test_tsk_thread_flag(p, TIF_MEMDIE) &&
-		    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			task_unlock(p);
-			rcu_read_unlock();
-			return 0;
-		}
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select %d (%s), adj %d, size %d, to kill\n",
-			     p->pid, p->comm, oom_score_adj, tasksize);
+	if (lowmem_tracking)
+		ret = lowmem_select_buckets(min_score_adj, &victim);
+	else
+		ret = lowmem_select_all(min_score_adj, &victim);
+	if (ret) {
+		rcu_read_unlock();
+		spin_lock_irqsave(&lowmem_lock, flags);
+		lowmem_stats.deferred++;
+		spin_unlock_irqrestore(&lowmem_lock, flags);
+		trace_lowmemory_deferred(min_score_adj, other_free, other_file);
+		return 0;
 	}
-	if (selected) {
+	if (victim.task) {
 		lowmem_print(1, "send sigkill to %d (%s), adj %d, size %d\n",
-			     selected->pid, selected->comm,
-			     selected_oom_score_adj, selected_tasksize);
+			     victim.task->pid, victim.task->comm,
+			     victim.oom_score_adj, victim.tasksize);
+		now = ktime_get();
+		latency = lowmem_crossed.tv64 ?
+			ktime_to_ns(ktime_sub(now, lowmem_crossed)) : 0;
+		lowmem_crossed = ktime_set(0, 0);
+
+		spin_lock_irqsave(&lowmem_lock, flags);
+		lowmem_pending.sig = victim.task->signal;
+		lowmem_pending.pid = victim.task->tgid;
+		lowmem_pending.tasksize = victim.tasksize;
+		lowmem_pending.free_at_kill = other_free;
+		lowmem_pending.kill_time = now;
+		lowmem_stats.kills++;
+		lowmem_stats.kill_latency_ns += latency;
+		lowmem_stats.estimated_pages += victim.tasksize;
 		lowmem_deathpending_timeout = jiffies + HZ;
-		send_sig(SIGKILL, selected, 0);
-		set_tsk_thread_flag(selected, TIF_MEMDIE);
-		rem -= selected_tasksize;
+		spin_unlock_irqrestore(&lowmem_lock, flags);
+
+		trace_lowmemory_kill(victim.task, victim.oom_score_adj,
+				     victim.tasksize, min_score_adj,
+				     other_free, other_file, latency);
+		send_sig(SIGKILL, victim.task, 0);
+		set_tsk_thread_flag(victim.task, TIF_MEMDIE);
+		rem -= victim.tasksize;
 	}
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     sc->nr_to_scan, sc->gfp_mask, rem);
@@ -158,20 +637,133 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	return rem;
 }
 
+static int lowmem_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned long flags;
+	typeof(lowmem_stats) stats;
+
+	spin_lock_irqsave(&lowmem_lock, flags);
+	stats = lowmem_stats;
+	spin_unlock_irqrestore(&lowmem_lock, flags);
+
+	seq_printf(m, "kills: %lu\n", stats.kills);
+	seq_printf(m, "deferred: %lu\n", stats.deferred);
+	seq_printf(m, "victims exited: %lu\n", stats.exited);
+	seq_printf(m, "kill latency ns: %llu\n", stats.kill_latency_ns);
+	seq_printf(m, "exit latency ns: %llu\n", stats.exit_latency_ns);
+	seq_printf(m, "estimated pages: %lu\n", stats.estimated_pages);
+	seq_printf(m, "freed pages: %ld\n", stats.freed_pages);
+	return 0;
+}
+
+static int lowmem_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lowmem_stats_show, NULL);
+}
+
+static const struct file_operations lowmem_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = lowmem_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *lowmem_debugfs_entry;
+
 static struct shrinker lowmem_shrinker = {
 	.shrink = lowmem_shrink,
 	.seeks = DEFAULT_SEEKS * 16
 };
 
+static void lowmem_untrack(void)
+{
+	unregister_trace_oom_score_adj_update(lowmem_adj_probe, NULL);
+	unregister_trace_sched_process_exit(lowmem_exit_probe, NULL);
+	unregister_trace_sched_process_fork(lowmem_fork_probe, NULL);
+	tracepoint_synchronize_unregister();
+}
+
+/*
+ * Hook the tracepoints first so that no fork or exit is missed, then
+ * add every thread group that already exists.
+ */
+static int lowmem_track(void)
+{
+	struct task_struct *tsk;
+	unsigned long flags;
+	int i;
+	int ret;
+
+	for (i = 0; i < LOWMEM_NR_BUCKETS; i++)
+		INIT_HLIST_NULLS_HEAD(&lowmem_buckets[i], i);
+
+	lowmem_proc_cache = KMEM_CACHE(lowmem_proc, 0);
+	if (!lowmem_proc_cache)
+		return -ENOMEM;
+
+	ret = register_trace_sched_process_fork(lowmem_fork_probe, NULL);
+	if (!ret)
+		ret = register_trace_sched_process_exit(lowmem_exit_probe, NULL);
+	if (!ret)
+		ret = register_trace_oom_score_adj_update(lowmem_adj_probe,
+							  NULL);
+	if (ret) {
+		lowmem_untrack();
+		return ret;
+	}
+
+	lowmem_tracking = true;
+	rcu_read_lock();
+	spin_lock_irqsave(&lowmem_lock, flags);
+	for_each_process(tsk) {
+		if (lowmem_proc_add(tsk)) {
+			lowmem_tracking_failed();
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&lowmem_lock, flags);
+	rcu_read_unlock();
+	return 0;
+}
+
 static int __init lowmem_init(void)
 {
+	int ret = lowmem_track();
+
+	if (ret)
+		pr_warn("lowmemorykiller: cannot track processes (%d), using full scans\n",
+			ret);
+	if (misc_register(&lowmem_pressure_misc))
+		pr_err("lowmemorykiller: failed to register misc device\n");
+	lowmem_debugfs_entry = debugfs_create_file("lowmemorykiller", S_IRUGO,
+						   NULL, NULL,
+						   &lowmem_stats_fops);
 	register_shrinker(&lowmem_shrinker);
 	return 0;
 }
 
 static void __exit lowmem_exit(void)
 {
+	struct lowmem_proc *lp;
+	struct hlist_node *pos, *n;
+	unsigned long flags;
+	int i;
+
 	unregister_shrinker(&lowmem_shrinker);
+	misc_deregister(&lowmem_pressure_misc);
+	debugfs_remove(lowmem_debugfs_entry);
+	if (!lowmem_proc_cache)
+		return;
+
+	lowmem_untrack();
+	spin_lock_irqsave(&lowmem_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(lowmem_hash); i++)
+		hlist_for_each_entry_safe(lp, pos, n, &lowmem_hash[i], hash)
+			lowmem_proc_del(lp);
+	spin_unlock_irqrestore(&lowmem_lock, flags);
+	rcu_barrier();
+	kmem_cache_destroy(lowmem_proc_cache);
 }
 
 module_param_named(cost, lowmem_shrinker.seeks, int, S_IRUGO | S_IWUSR);
@@ -179,6 +771,12 @@ module_param_array_named(adj, lowmem_adj, int, &lowmem_adj_size,
 			 S_IRUGO | S_IWUSR);
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
+module_param_named(pressure_window, lowmem_pressure_window, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_medium, lowmem_pressure_medium, uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(pressure_critical, lowmem_pressure_critical, uint,
+		   S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
 
 module_init(lowmem_init);
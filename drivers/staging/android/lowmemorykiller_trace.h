@@ -0,0 +1,102 @@
+/*
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lowmemorykiller
+
+#if !defined(_LOWMEMORYKILLER_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _LOWMEMORYKILLER_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/* SIGKILL sent; latency is measured from the threshold crossing */
+TRACE_EVENT(lowmemory_kill,
+	TP_PROTO(struct task_struct *p, int oom_score_adj, int tasksize,
+		 int min_score_adj, int other_free, int other_file,
+		 s64 latency_ns),
+	TP_ARGS(p, oom_score_adj, tasksize, min_score_adj, other_free,
+		other_file, latency_ns),
+	TP_STRUCT__entry(
+		__field(pid_t, pid)
+		__array(char, comm, TASK_COMM_LEN)
+		__field(int, oom_score_adj)
+		__field(int, tasksize)
+		__field(int, min_score_adj)
+		__field(int, other_free)
+		__field(int, other_file)
+		__field(s64, latency_ns)
+	),
+	TP_fast_assign(
+		__entry->pid = p->pid;
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->oom_score_adj = oom_score_adj;
+		__entry->tasksize = tasksize;
+		__entry->min_score_adj = min_score_adj;
+		__entry->other_free = other_free;
+		__entry->other_file = other_file;
+		__entry->latency_ns = latency_ns;
+	),
+	TP_printk("pid=%d comm=%s adj=%d size=%d min_adj=%d free=%d file=%d "
+		  "latency=%lldns",
+		  __entry->pid, __entry->comm, __entry->oom_score_adj,
+		  __entry->tasksize, __entry->min_score_adj,
+		  __entry->other_free, __entry->other_file,
+		  __entry->latency_ns)
+);
+
+/* The last thread of a victim exited and its mm was released */
+TRACE_EVENT(lowmemory_victim_exit,
+	TP_PROTO(pid_t pid, int tasksize, long freed, s64 latency_ns),
+	TP_ARGS(pid, tasksize, freed, latency_ns),
+	TP_STRUCT__entry(
+		__field(pid_t, pid)
+		__field(int, tasksize)
+		__field(long, freed)
+		__field(s64, latency_ns)
+	),
+	TP_fast_assign(
+		__entry->pid = pid;
+		__entry->tasksize = tasksize;
+		__entry->freed = freed;
+		__entry->latency_ns = latency_ns;
+	),
+	TP_printk("pid=%d size=%d freed=%ld latency=%lldns",
+		  __entry->pid, __entry->tasksize, __entry->freed,
+		  __entry->latency_ns)
+);
+
+/* A kill was skipped because a previous victim is still dying */
+TRACE_EVENT(lowmemory_deferred,
+	TP_PROTO(int min_score_adj, int other_free, int other_file),
+	TP_ARGS(min_score_adj, other_free, other_file),
+	TP_STRUCT__entry(
+		__field(int, min_score_adj)
+		__field(int, other_free)
+		__field(int, other_file)
+	),
+	TP_fast_assign(
+		__entry->min_score_adj = min_score_adj;
+		__entry->other_free = other_free;
+		__entry->other_file = other_file;
+	),
+	TP_printk("min_adj=%d free=%d file=%d",
+		  __entry->min_score_adj, __entry->other_free,
+		  __entry->other_file)
+);
+
+#endif /* _LOWMEMORYKILLER_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_PATH .
+#define TRACE_INCLUDE_FILE lowmemorykiller_trace
+#include <trace/define_trace.h>
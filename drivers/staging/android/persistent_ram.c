@@ -19,8 +19,12 @@
 #include <linux/init.h>
 #include <linux/io.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #include <linux/memblock.h>
+#include <linux/notifier.h>
 #include <linux/persistent_ram.h>
+#include <linux/reboot.h>
+#include <linux/rculist.h>
 #include <linux/rslib.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
@@ -36,6 +40,20 @@ struct persistent_ram_buffer {
 
 static __devinitdata LIST_HEAD(persistent_ram_list);
 
+/*
+ * With deferred ECC, a write only copies the data and marks the ecc
+ * blocks it touched in ecc_dirty.  The parity is computed later from
+ * ecc_timer, which is armed from an irq_work because a console write may
+ * come from any context.  The panic and reboot notifiers flush every
+ * zone and switch it back to encoding on each write, so nothing printed
+ * after that point is left without parity.
+ */
+#define PERSISTENT_RAM_ECC_DELAY	(HZ / 10)
+#define PERSISTENT_RAM_ECC_HEADER	0
+#define PERSISTENT_RAM_ECC_BUSY		1
+
+static LIST_HEAD(persistent_ram_ecc_zones);
+
 static inline size_t buffer_size(struct persistent_ram_zone *prz)
 {
 	return atomic_read(&prz->buffer->size);
@@ -118,6 +136,15 @@ static void notrace persistent_ram_update_ecc(struct persistent_ram_zone *prz,
 	if (!prz->ecc)
 		return;
 
+	if (prz->ecc_deferred) {
+		unsigned int first = start / ecc_block_size;
+		unsigned int last = (start + count - 1) / ecc_block_size;
+
+		for (; first <= last; first++)
+			set_bit(first, prz->ecc_dirty);
+		return;
+	}
+
 	block = buffer->data + (start & ~(ecc_block_size - 1));
 	par = prz->par_buffer + (start / ecc_block_size) * prz->ecc_size;
 
@@ -130,6 +157,8 @@ static void notrace persistent_ram_update_ecc(struct persistent_ram_zone *prz,
 	} while (block < buffer->data + start + count);
 }
 
+static void persistent_ram_ecc_kick(struct persistent_ram_zone *prz);
+
 static void persistent_ram_update_header_ecc(struct persistent_ram_zone *prz)
 {
 	struct persistent_ram_buffer *buffer = prz->buffer;
@@ -137,10 +166,139 @@ static void persistent_ram_update_header_ecc(struct persistent_ram_zone *prz)
 	if (!prz->ecc)
 		return;
 
+	if (prz->ecc_deferred) {
+		set_bit(PERSISTENT_RAM_ECC_HEADER, &prz->ecc_flags);
+		persistent_ram_ecc_kick(prz);
+		return;
+	}
+
 	persistent_ram_encode_rs8(prz, (uint8_t *)buffer, sizeof(*buffer),
 				  prz->par_header);
 }
 
+static void notrace __persistent_ram_flush_ecc(struct persistent_ram_zone *prz)
+{
+	struct persistent_ram_buffer *buffer = prz->buffer;
+	int ecc_blocks = DIV_ROUND_UP(prz->buffer_size, prz->ecc_block_size);
+	uint8_t *block;
+	int size;
+	int i;
+
+	for_each_set_bit(i, prz->ecc_dirty, ecc_blocks) {
+		if (!test_and_clear_bit(i, prz->ecc_dirty))
+			continue;
+		block = buffer->data + i * prz->ecc_block_size;
+		size = prz->ecc_block_size;
+		if (block + size > buffer->data + prz->buffer_size)
+			size = buffer->data + prz->buffer_size - block;
+		persistent_ram_encode_rs8(prz, block, size,
+					  prz->par_buffer + i * prz->ecc_size);
+	}
+	if (test_and_clear_bit(PERSISTENT_RAM_ECC_HEADER, &prz->ecc_flags))
+		persistent_ram_encode_rs8(prz, (uint8_t *)buffer,
+					  sizeof(*buffer), prz->par_header);
+	mb();
+}
+
+/**
+ * persistent_ram_flush_ecc - encode every block written since the last flush
+ * @prz: zone to flush
+ *
+ * Only one flush runs at a time; a flush that finds another in progress
+ * returns, since the running one will pick up its blocks.
+ */
+void notrace persistent_ram_flush_ecc(struct persistent_ram_zone *prz)
+{
+	if (!prz->ecc_deferred)
+		return;
+	if (test_and_set_bit(PERSISTENT_RAM_ECC_BUSY, &prz->ecc_flags))
+		return;
+	__persistent_ram_flush_ecc(prz);
+	clear_bit(PERSISTENT_RAM_ECC_BUSY, &prz->ecc_flags);
+}
+
+#ifdef CONFIG_IRQ_WORK
+static void notrace persistent_ram_ecc_kick(struct persistent_ram_zone *prz)
+{
+	irq_work_queue(&prz->ecc_irq_work);
+}
+
+static void persistent_ram_ecc_timer(unsigned long data)
+{
+	persistent_ram_flush_ecc((struct persistent_ram_zone *)data);
+}
+
+static void persistent_ram_ecc_irq_work(struct irq_work *work)
+{
+	struct persistent_ram_zone *prz =
+		container_of(work, struct persistent_ram_zone, ecc_irq_work);
+
+	if (!timer_pending(&prz->ecc_timer))
+		mod_timer(&prz->ecc_timer, jiffies + PERSISTENT_RAM_ECC_DELAY);
+}
+
+/*
+ * Flush and go back to synchronous encoding.  The flush runs even if a
+ * timer flush was interrupted on another cpu, which may never resume.
+ */
+static int persistent_ram_ecc_notify(struct notifier_block *nb,
+	unsigned long event, void *unused)
+{
+	struct persistent_ram_zone *prz;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(prz, &persistent_ram_ecc_zones, ecc_node) {
+		if (!prz->ecc_deferred)
+			continue;
+		prz->ecc_deferred = false;
+		smp_mb();
+		__persistent_ram_flush_ecc(prz);
+	}
+	rcu_read_unlock();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block persistent_ram_panic_nb = {
+	.notifier_call = persistent_ram_ecc_notify,
+};
+
+static struct notifier_block persistent_ram_reboot_nb = {
+	.notifier_call = persistent_ram_ecc_notify,
+};
+
+static void persistent_ram_init_ecc_deferred(struct persistent_ram_zone *prz,
+	int ecc_blocks)
+{
+	static bool registered;
+
+	prz->ecc_dirty = kzalloc(BITS_TO_LONGS(ecc_blocks) * sizeof(long),
+				 GFP_KERNEL);
+	if (!prz->ecc_dirty)
+		return;
+
+	init_irq_work(&prz->ecc_irq_work, persistent_ram_ecc_irq_work);
+	setup_timer(&prz->ecc_timer, persistent_ram_ecc_timer,
+		    (unsigned long)prz);
+	list_add_tail_rcu(&prz->ecc_node, &persistent_ram_ecc_zones);
+	if (!registered) {
+		atomic_notifier_chain_register(&panic_notifier_list,
+					       &persistent_ram_panic_nb);
+		register_reboot_notifier(&persistent_ram_reboot_nb);
+		registered = true;
+	}
+	prz->ecc_deferred = true;
+}
+#else
+static inline void persistent_ram_ecc_kick(struct persistent_ram_zone *prz)
+{
+}
+
+static void persistent_ram_init_ecc_deferred(struct persistent_ram_zone *prz,
+	int ecc_blocks)
+{
+}
+#endif
+
 static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
 {
 	struct persistent_ram_buffer *buffer = prz->buffer;
@@ -213,6 +371,8 @@ static int persistent_ram_init_ecc(struct persistent_ram_zone *prz,
 	prz->corrected_bytes = 0;
 	prz->bad_blocks = 0;
 
+	persistent_ram_init_ecc_deferred(prz, ecc_blocks);
+
 	numerr = persistent_ram_decode_rs8(prz, buffer, sizeof(*buffer),
 					   prz->par_header);
 	if (numerr > 0) {
@@ -319,7 +479,7 @@ void persistent_ram_free_old(struct persistent_ram_zone *prz)
 }
 
 static int persistent_ram_buffer_map(phys_addr_t start, phys_addr_t size,
-		struct persistent_ram_zone *prz)
+		struct persistent_ram_zone *prz, bool ecc)
 {
 	struct page **pages;
 	phys_addr_t page_start;
@@ -330,7 +490,15 @@ static int persistent_ram_buffer_map(phys_addr_t start, phys_addr_t size,
 	page_start = start - offset_in_page(start);
 	page_count = DIV_ROUND_UP(size + offset_in_page(start), PAGE_SIZE);
 
-	prot = pgprot_noncached(PAGE_KERNEL);
+	/*
+	 * Zones with deferred ECC are written with plain memcpy and flushed
+	 * with a barrier, so they can use write-combining; the rest stay
+	 * uncached so every record lands at once.
+	 */
+	if (ecc && IS_ENABLED(CONFIG_IRQ_WORK))
+		prot = pgprot_writecombine(PAGE_KERNEL);
+	else
+		prot = pgprot_noncached(PAGE_KERNEL);
 
 	pages = kmalloc(sizeof(struct page *) * page_count, GFP_KERNEL);
 	if (!pages) {
@@ -357,20 +525,27 @@ static int persistent_ram_buffer_map(phys_addr_t start, phys_addr_t size,
 }
 
 static int __devinit persistent_ram_buffer_init(const char *name,
-		struct persistent_ram_zone *prz)
+		struct persistent_ram_zone *prz, bool ecc,
+		unsigned int index, unsigned int count)
 {
 	int i;
 	struct persistent_ram *ram;
 	struct persistent_ram_descriptor *desc;
 	phys_addr_t start;
+	phys_addr_t size;
 
 	list_for_each_entry(ram, &persistent_ram_list, node) {
 		start = ram->start;
 		for (i = 0; i < ram->num_descs; i++) {
 			desc = &ram->descs[i];
-			if (!strcmp(desc->name, name))
-				return persistent_ram_buffer_map(start,
-						desc->size, prz);
+			if (!strcmp(desc->name, name)) {
+				size = div_u64(desc->size, count) & ~7ULL;
+				if (size <= sizeof(struct persistent_ram_buffer))
+					return -EINVAL;
+				return persistent_ram_buffer_map(
+						start + index * size,
+						size, prz, ecc);
+			}
 			start += desc->size;
 		}
 	}
@@ -379,7 +554,8 @@ static int __devinit persistent_ram_buffer_init(const char *name,
 }
 
 static  __devinit
-struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
+struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc,
+		unsigned int index, unsigned int count)
 {
 	struct persistent_ram_zone *prz;
 	int ret = -ENOMEM;
@@ -392,7 +568,7 @@ struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
 
 	INIT_LIST_HEAD(&prz->node);
 
-	ret = persistent_ram_buffer_init(dev_name(dev), prz);
+	ret = persistent_ram_buffer_init(dev_name(dev), prz, ecc, index, count);
 	if (ret) {
 		pr_err("persistent_ram: failed to initialize buffer\n");
 		goto err;
@@ -433,7 +609,26 @@ err:
 struct persistent_ram_zone * __devinit
 persistent_ram_init_ringbuffer(struct device *dev, bool ecc)
 {
-	return __persistent_ram_init(dev, ecc);
+	return __persistent_ram_init(dev, ecc, 0, 1);
+}
+
+/**
+ * persistent_ram_init_ringbuffer_part - map one part of a split zone
+ * @dev: device whose name selects the persistent_ram descriptor
+ * @ecc: protect the part with ECC
+ * @index: part to map, from 0 to @count - 1
+ * @count: number of equal parts the descriptor is split into
+ *
+ * Each part is an independent ring with its own header, so that, for
+ * example, one cpu's records cannot overwrite another's.
+ */
+struct persistent_ram_zone * __devinit
+persistent_ram_init_ringbuffer_part(struct device *dev, bool ecc,
+		unsigned int index, unsigned int count)
+{
+	if (!count || index >= count)
+		return ERR_PTR(-EINVAL);
+	return __persistent_ram_init(dev, ecc, index, count);
 }
 
 int __init persistent_ram_early_init(struct persistent_ram *ram)
@@ -22,7 +22,13 @@
 #include <linux/string.h>
 #include <linux/uaccess.h>
 #include <linux/io.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 #include "ram_console.h"
+#include "trace_persistent.h"
 
 static struct persistent_ram_zone *ram_console_zone;
 static const char *bootinfo;
@@ -177,4 +183,227 @@ static int __init ram_console_late_init(void)
 }
 
 late_initcall(ram_console_late_init);
+
+#ifdef CONFIG_PERSISTENT_TRACER
+/*
+ * /proc/last_trace decodes the per-cpu records left by the persistent
+ * tracer into one list ordered by time.  Records that precede the first
+ * timestamp in their zone cannot be placed and are listed first.
+ */
+struct last_trace_entry {
+	u64 time;
+	unsigned long ip;
+	unsigned long parent;
+	u32 seq;
+	u16 cpu;
+	u8 timed;
+	u8 raw;
+};
+
+static DEFINE_MUTEX(last_trace_lock);
+static struct last_trace_entry *last_trace;
+static size_t last_trace_count;
+
+static int last_trace_cmp(const void *a, const void *b)
+{
+	const struct last_trace_entry *x = a, *y = b;
+
+	if (x->timed != y->timed)
+		return x->timed ? 1 : -1;
+	if (x->timed && x->time != y->time)
+		return x->time < y->time ? -1 : 1;
+	if (x->cpu != y->cpu)
+		return x->cpu < y->cpu ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static size_t last_trace_decode_zone(unsigned int cpu,
+				     struct last_trace_entry *e)
+{
+	const struct persistent_trace_record *rec;
+	const void *data;
+	size_t size = persistent_trace_old(cpu, &data);
+	size_t n = size / sizeof(*rec);
+	struct last_trace_entry *start = e;
+	u64 time = 0;
+	u32 hi = 0;
+	bool timed = false;
+	bool hi_valid = false;
+	u32 delta;
+	size_t i;
+
+	rec = data + size % sizeof(*rec);
+	for (i = 0; i < n; i++, rec++) {
+		if ((rec->ip & PERSISTENT_TRACE_ESC) == PERSISTENT_TRACE_ESC) {
+			switch (rec->ip >> PERSISTENT_TRACE_OFF_BITS) {
+			case PERSISTENT_TRACE_TIME_HI:
+				hi = rec->parent;
+				hi_valid = true;
+				continue;
+			case PERSISTENT_TRACE_TIME_LO:
+				if (hi_valid) {
+					time = (u64)hi << 32 | rec->parent;
+					timed = true;
+				}
+				hi_valid = false;
+				continue;
+			case PERSISTENT_TRACE_RAW:
+				e->ip = rec->parent;
+				e->parent = 0;
+				e->raw = 1;
+				break;
+			default:
+				hi_valid = false;
+				continue;
+			}
+		} else {
+			delta = (rec->ip >> PERSISTENT_TRACE_OFF_BITS) <<
+				PERSISTENT_TRACE_HALF_BITS |
+				rec->parent >> PERSISTENT_TRACE_OFF_BITS;
+			time += delta;
+			e->ip = persistent_trace_addr(rec->ip);
+			if ((rec->parent & PERSISTENT_TRACE_ESC) ==
+			    PERSISTENT_TRACE_ESC)
+				e->parent = 0;
+			else
+				e->parent = persistent_trace_addr(rec->parent);
+			e->raw = 0;
+		}
+		hi_valid = false;
+		e->time = time << PERSISTENT_TRACE_TIME_SHIFT;
+		e->timed = timed;
+		e->cpu = cpu;
+		e->seq = e - start;
+		e++;
+	}
+	return e - start;
+}
+
+/* Decode on first open; the result is kept until reboot. */
+static int last_trace_decode(void)
+{
+	unsigned int nr_zones = persistent_trace_nr_zones();
+	const void *data;
+	size_t total = 0;
+	size_t count = 0;
+	unsigned int i;
+	int ret = 0;
+
+	mutex_lock(&last_trace_lock);
+	if (last_trace)
+		goto out;
+
+	for (i = 0; i < nr_zones; i++)
+		total += persistent_trace_old(i, &data) /
+			sizeof(struct persistent_trace_record);
+	if (!total) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	last_trace = vmalloc(total * sizeof(*last_trace));
+	if (!last_trace) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < nr_zones; i++)
+		count += last_trace_decode_zone(i, last_trace + count);
+	sort(last_trace, count, sizeof(*last_trace), last_trace_cmp, NULL);
+	last_trace_count = count;
+out:
+	mutex_unlock(&last_trace_lock);
+	return ret;
+}
+
+static void *last_trace_seq_start(struct seq_file *s, loff_t *pos)
+{
+	return *pos < last_trace_count ? &last_trace[*pos] : NULL;
+}
+
+static void *last_trace_seq_next(struct seq_file *s, void *v, loff_t *pos)
+{
+	(*pos)++;
+	return last_trace_seq_start(s, pos);
+}
+
+static void last_trace_seq_stop(struct seq_file *s, void *v)
+{
+}
+
+static int last_trace_seq_show(struct seq_file *s, void *v)
+{
+	struct last_trace_entry *e = v;
+	unsigned long rem_nsec;
+	u64 ts = e->time;
+
+	if (e->timed) {
+		rem_nsec = do_div(ts, 1000000000);
+		seq_printf(s, "[%5lu.%06lu] ", (unsigned long)ts,
+			   rem_nsec / 1000);
+	} else {
+		seq_printf(s, "[      ?     ] ");
+	}
+
+	if (e->parent)
+		seq_printf(s, "%u %08lx  %08lx  %pf <- %pF\n", e->cpu,
+			   e->ip, e->parent, (void *)e->ip,
+			   (void *)e->parent);
+	else
+		seq_printf(s, "%u %08lx  ?         %pf%s\n", e->cpu, e->ip,
+			   (void *)e->ip, e->raw ? " (time approximate)" : "");
+	return 0;
+}
+
+static const struct seq_operations last_trace_seq_ops = {
+	.start = last_trace_seq_start,
+	.next = last_trace_seq_next,
+	.stop = last_trace_seq_stop,
+	.show = last_trace_seq_show,
+};
+
+static int last_trace_open(struct inode *inode, struct file *file)
+{
+	int ret;
+
+	if (dmesg_restrict && !capable(CAP_SYSLOG))
+		return -EPERM;
+
+	ret = last_trace_decode();
+	if (ret)
+		return ret;
+	return seq_open(file, &last_trace_seq_ops);
+}
+
+static const struct file_operations last_trace_file_ops = {
+	.owner = THIS_MODULE,
+	.open = last_trace_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = seq_release,
+};
+
+static int __init ram_console_last_trace_init(void)
+{
+	struct proc_dir_entry *entry;
+	const void *data;
+	unsigned int i;
+
+	for (i = 0; i < persistent_trace_nr_zones(); i++)
+		if (persistent_trace_old(i, &data))
+			break;
+	if (i == persistent_trace_nr_zones())
+		return 0;
+
+	entry = create_proc_entry("last_trace", S_IFREG | S_IRUGO, NULL);
+	if (!entry) {
+		printk(KERN_ERR "ram_console: failed to create last_trace\n");
+		return 0;
+	}
+
+	entry->proc_fops = &last_trace_file_ops;
+	return 0;
+}
+
+late_initcall(ram_console_last_trace_init);
+#endif
 postcore_initcall(ram_console_module_init);
@@ -12,26 +12,29 @@
  *
  */
 
-#include <linux/debugfs.h>
 #include <linux/errno.h>
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/io.h>
 #include <linux/persistent_ram.h>
 #include <linux/platform_device.h>
-#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/trace_clock.h>
+
+#include "trace_persistent.h"
 
 #include "../../../kernel/trace/trace.h"
 
-struct persistent_trace_record {
-	unsigned long ip;
-	unsigned long parent_ip;
+struct persistent_trace_cpu {
+	u64 last;
+	unsigned int until_sync;
 };
 
 #define REC_SIZE sizeof(struct persistent_trace_record)
 
-static struct persistent_ram_zone *persistent_trace;
+static struct persistent_ram_zone **persistent_trace;
+static unsigned int persistent_trace_zones;
+static DEFINE_PER_CPU(struct persistent_trace_cpu, persistent_trace_cpu);
 
 static int persistent_trace_enabled;
 
@@ -73,12 +76,51 @@ static void persistent_trace_start(struct trace_array *tr)
 	tracing_reset_online_cpus(tr);
 }
 
+static void notrace persistent_trace_write(unsigned long ip,
+	unsigned long parent_ip, int cpu)
+{
+	struct persistent_ram_zone *prz = persistent_trace[cpu];
+	struct persistent_trace_cpu *pc = &per_cpu(persistent_trace_cpu, cpu);
+	struct persistent_trace_record rec[2];
+	u64 now = trace_clock_local() >> PERSISTENT_TRACE_TIME_SHIFT;
+	u64 delta = now - pc->last;
+	u32 off = persistent_trace_off(ip);
+
+	if (unlikely(off == PERSISTENT_TRACE_ESC)) {
+		rec[0].ip = PERSISTENT_TRACE_ESC |
+			(PERSISTENT_TRACE_RAW << PERSISTENT_TRACE_OFF_BITS);
+		rec[0].parent = ip;
+		persistent_ram_write(prz, rec, REC_SIZE);
+		return;
+	}
+
+	if (!pc->until_sync || delta > PERSISTENT_TRACE_DELTA_MAX) {
+		rec[0].ip = PERSISTENT_TRACE_ESC |
+			(PERSISTENT_TRACE_TIME_HI << PERSISTENT_TRACE_OFF_BITS);
+		rec[0].parent = now >> 32;
+		rec[1].ip = PERSISTENT_TRACE_ESC |
+			(PERSISTENT_TRACE_TIME_LO << PERSISTENT_TRACE_OFF_BITS);
+		rec[1].parent = now;
+		persistent_ram_write(prz, rec, 2 * REC_SIZE);
+		pc->until_sync = PERSISTENT_TRACE_SYNC;
+		delta = 0;
+	}
+	pc->last = now;
+	pc->until_sync--;
+
+	rec[0].ip = off | (delta >> PERSISTENT_TRACE_HALF_BITS) <<
+		PERSISTENT_TRACE_OFF_BITS;
+	rec[0].parent = persistent_trace_off(parent_ip) |
+		(delta & ((1U << PERSISTENT_TRACE_HALF_BITS) - 1)) <<
+		PERSISTENT_TRACE_OFF_BITS;
+	persistent_ram_write(prz, rec, REC_SIZE);
+}
+
 static void persistent_trace_call(unsigned long ip, unsigned long parent_ip)
 {
 	struct trace_array *tr = persistent_trace_array;
 	struct trace_array_cpu *data;
 	long disabled;
-	struct persistent_trace_record rec;
 	unsigned long flags;
 	int cpu;
 
@@ -98,12 +140,8 @@ static void persistent_trace_call(unsigned long ip, unsigned long parent_ip)
 	data = tr->data[cpu];
 	disabled = atomic_inc_return(&data->disabled);
 
-	if (likely(disabled == 1)) {
-		rec.ip = ip;
-		rec.parent_ip = parent_ip;
-		rec.ip |= cpu;
-		persistent_ram_write(persistent_trace, &rec, sizeof(rec));
-	}
+	if (likely(disabled == 1))
+		persistent_trace_write(ip, parent_ip, cpu);
 
 	atomic_dec(&data->disabled);
 	local_irq_restore(flags);
@@ -122,109 +160,61 @@ static struct tracer persistent_tracer __read_mostly = {
 	.wait_pipe	= poll_wait_pipe,
 };
 
-struct persistent_trace_seq_data {
-	const void *ptr;
-	size_t off;
-	size_t size;
-};
-
-void *persistent_trace_seq_start(struct seq_file *s, loff_t *pos)
-{
-	struct persistent_trace_seq_data *data;
-
-	data = kzalloc(sizeof(*data), GFP_KERNEL);
-	if (!data)
-		return NULL;
-
-	data->ptr = persistent_ram_old(persistent_trace);
-	data->size = persistent_ram_old_size(persistent_trace);
-	data->off = data->size % REC_SIZE;
-
-	data->off += *pos * REC_SIZE;
-
-	if (data->off + REC_SIZE > data->size) {
-		kfree(data);
-		return NULL;
-	}
-
-	return data;
-
-}
-void persistent_trace_seq_stop(struct seq_file *s, void *v)
-{
-	kfree(v);
-}
-
-void *persistent_trace_seq_next(struct seq_file *s, void *v, loff_t *pos)
-{
-	struct persistent_trace_seq_data *data = v;
-
-	data->off += REC_SIZE;
-
-	if (data->off + REC_SIZE > data->size)
-		return NULL;
-
-	(*pos)++;
-
-	return data;
-}
-
-int persistent_trace_seq_show(struct seq_file *s, void *v)
+/**
+ * persistent_trace_nr_zones - number of per-cpu zones
+ */
+unsigned int persistent_trace_nr_zones(void)
 {
-	struct persistent_trace_seq_data *data = v;
-	struct persistent_trace_record *rec;
-
-	rec = (struct persistent_trace_record *)(data->ptr + data->off);
-
-	seq_printf(s, "%ld %08lx  %08lx  %pf <- %pF\n",
-		rec->ip & 3, rec->ip, rec->parent_ip,
-		(void *)rec->ip, (void *)rec->parent_ip);
-
-	return 0;
+	return persistent_trace_zones;
 }
 
-static const struct seq_operations persistent_trace_seq_ops = {
-	.start = persistent_trace_seq_start,
-	.next = persistent_trace_seq_next,
-	.stop = persistent_trace_seq_stop,
-	.show = persistent_trace_seq_show,
-};
-
-static int persistent_trace_old_open(struct inode *inode, struct file *file)
+/**
+ * persistent_trace_old - records left in a zone by the previous boot
+ * @zone: zone, i.e. cpu, to return
+ * @data: set to the oldest surviving byte
+ *
+ * Returns the size in bytes, which need not be a multiple of the record
+ * size; the newest record ends at @data + size.
+ */
+size_t persistent_trace_old(unsigned int zone, const void **data)
 {
-	return seq_open(file, &persistent_trace_seq_ops);
+	if (zone >= persistent_trace_zones) {
+		*data = NULL;
+		return 0;
+	}
+	*data = persistent_ram_old(persistent_trace[zone]);
+	return persistent_ram_old_size(persistent_trace[zone]);
 }
 
-static const struct file_operations persistent_trace_old_fops = {
-	.open		= persistent_trace_old_open,
-	.read		= seq_read,
-	.llseek		= seq_lseek,
-	.release	= seq_release,
-};
-
 static int __devinit persistent_trace_probe(struct platform_device *pdev)
 {
-	struct dentry *d;
+	struct persistent_ram_zone *prz;
+	unsigned int i;
 	int ret;
 
-	persistent_trace = persistent_ram_init_ringbuffer(&pdev->dev, false);
-	if (IS_ERR(persistent_trace)) {
-		pr_err("persistent_trace: failed to init ringbuffer: %ld\n",
-				PTR_ERR(persistent_trace));
-		return PTR_ERR(persistent_trace);
+	persistent_trace = kcalloc(nr_cpu_ids, sizeof(*persistent_trace),
+				   GFP_KERNEL);
+	if (!persistent_trace)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_cpu_ids; i++) {
+		prz = persistent_ram_init_ringbuffer_part(&pdev->dev, false,
+							  i, nr_cpu_ids);
+		if (IS_ERR(prz)) {
+			pr_err("persistent_trace: failed to init ringbuffer %u: %ld\n",
+					i, PTR_ERR(prz));
+			kfree(persistent_trace);
+			persistent_trace = NULL;
+			return PTR_ERR(prz);
+		}
+		persistent_trace[i] = prz;
 	}
+	persistent_trace_zones = nr_cpu_ids;
 
 	ret = register_tracer(&persistent_tracer);
 	if (ret)
 		pr_err("persistent_trace: failed to register tracer");
 
-	if (persistent_ram_old_size(persistent_trace) > 0) {
-		d = debugfs_create_file("persistent_trace", S_IRUGO, NULL,
-			NULL, &persistent_trace_old_fops);
-		if (IS_ERR_OR_NULL(d))
-			pr_err("persistent_trace: failed to create old file\n");
-	}
-
 	return 0;
 }
 
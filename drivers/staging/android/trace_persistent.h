@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2012 Google, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef _TRACE_PERSISTENT_H
+#define _TRACE_PERSISTENT_H
+
+#include <linux/types.h>
+#include <asm/sections.h>
+
+/*
+ * Each cpu has its own zone of 8-byte records.  A function record holds
+ * the callee and the caller as half-word offsets from
+ * PERSISTENT_TRACE_BASE in the low 26 bits of each word, and the time
+ * since the previous record, in units of 1 << PERSISTENT_TRACE_TIME_SHIFT
+ * ns, split over the top 6 bits of both words.  A caller offset of
+ * PERSISTENT_TRACE_ESC means the caller was out of range.
+ *
+ * A callee offset of PERSISTENT_TRACE_ESC marks an escape record.  Its
+ * kind is in the top bits of the first word and its payload is the whole
+ * second word.  TIME_HI followed by TIME_LO gives the absolute time of
+ * the next record; one is written every PERSISTENT_TRACE_SYNC records and
+ * whenever the delta overflows, so decoding can start anywhere in the
+ * ring.  RAW holds a callee that is out of range and has the same time
+ * as the record before it.
+ *
+ * Offsets are only meaningful to the kernel image that wrote them.
+ */
+struct persistent_trace_record {
+	u32 ip;
+	u32 parent;
+};
+
+#define PERSISTENT_TRACE_BASE		((unsigned long)_stext - (32UL << 20))
+#define PERSISTENT_TRACE_OFF_BITS	26
+#define PERSISTENT_TRACE_ESC		((1U << PERSISTENT_TRACE_OFF_BITS) - 1)
+#define PERSISTENT_TRACE_HALF_BITS	(32 - PERSISTENT_TRACE_OFF_BITS)
+#define PERSISTENT_TRACE_DELTA_MAX	((1U << (2 * PERSISTENT_TRACE_HALF_BITS)) - 1)
+#define PERSISTENT_TRACE_TIME_SHIFT	10
+#define PERSISTENT_TRACE_SYNC		64
+
+enum persistent_trace_escape {
+	PERSISTENT_TRACE_TIME_HI = 1,
+	PERSISTENT_TRACE_TIME_LO,
+	PERSISTENT_TRACE_RAW,
+};
+
+static inline u32 persistent_trace_off(unsigned long addr)
+{
+	unsigned long off = (addr - PERSISTENT_TRACE_BASE) >> 1;
+
+	return off < PERSISTENT_TRACE_ESC ? off : PERSISTENT_TRACE_ESC;
+}
+
+static inline unsigned long persistent_trace_addr(u32 word)
+{
+	return PERSISTENT_TRACE_BASE +
+		((unsigned long)(word & PERSISTENT_TRACE_ESC) << 1);
+}
+
+unsigned int persistent_trace_nr_zones(void);
+size_t persistent_trace_old(unsigned int zone, const void **data);
+
+#endif /* _TRACE_PERSISTENT_H */
@@ -34,6 +34,17 @@ struct omap_crtc {
 	/* if there is a pending flip, these will be non-null: */
 	struct drm_pending_vblank_event *event;
 	struct drm_framebuffer *old_fb;
+
+	/* pending atomic flip, valid while flip_busy: */
+	bool flip_busy;
+	int flip_num;
+	struct drm_plane *flip_planes[OMAP_ATOMIC_MAX_PLANES];
+	struct drm_framebuffer *flip_fbs[OMAP_ATOMIC_MAX_PLANES];
+	struct drm_omap_plane_state flip_states[OMAP_ATOMIC_MAX_PLANES];
+	/* fbs still being rendered to, plus one while the flip is queued */
+	atomic_t flip_pending;
+	struct work_struct flip_work;
+	wait_queue_head_t flip_wait;
 };
 
 static void omap_crtc_gamma_set(struct drm_crtc *crtc,
@@ -182,7 +193,7 @@ static int omap_crtc_page_flip_locked(struct drm_crtc *crtc,
 
 	DBG("%d -> %d", crtc->fb ? crtc->fb->base.id : -1, fb->base.id);
 
-	if (omap_crtc->event) {
+	if (omap_crtc->event || omap_crtc->flip_busy) {
 		dev_err(dev->dev, "already a pending flip\n");
 		return -EINVAL;
 	}
@@ -197,6 +208,135 @@ static int omap_crtc_page_flip_locked(struct drm_crtc *crtc,
 	return 0;
 }
 
+/* apply all planes of an atomic flip, once their fbs are rendered */
+static void atomic_flip_worker(struct work_struct *work)
+{
+	struct omap_crtc *omap_crtc =
+			container_of(work, struct omap_crtc, flip_work);
+	struct drm_crtc *crtc = &omap_crtc->base;
+	struct omap_overlay_manager *mgr;
+	int i;
+
+	for (i = 0; i < omap_crtc->flip_num; i++) {
+		struct drm_omap_plane_state *st = &omap_crtc->flip_states[i];
+
+		if (!omap_crtc->flip_fbs[i])
+			continue;
+
+		WARN_ON(omap_plane_stage(omap_crtc->flip_planes[i], crtc,
+				omap_crtc->flip_fbs[i], st->crtc_x, st->crtc_y,
+				st->crtc_w, st->crtc_h, st->src_x, st->src_y,
+				st->src_w, st->src_h));
+	}
+
+	/* one apply, so all overlays change on the same GO */
+	mgr = omap_plane_get_manager(omap_crtc->plane);
+	if (mgr && mgr->apply(mgr))
+		dev_err(crtc->dev->dev, "could not apply settings\n");
+
+	for (i = 0; i < omap_crtc->flip_num; i++) {
+		struct drm_plane *plane = omap_crtc->flip_planes[i];
+
+		if (omap_crtc->flip_fbs[i])
+			WARN_ON(omap_plane_staged(plane));
+		else
+			WARN_ON(omap_plane_dpms(plane, DRM_MODE_DPMS_OFF));
+	}
+
+	if (omap_crtc->event)
+		omap_plane_on_endwin(omap_crtc->plane, vblank_cb, crtc);
+
+	omap_crtc->flip_busy = false;
+	wake_up_all(&omap_crtc->flip_wait);
+}
+
+static void atomic_flip_cb(void *arg)
+{
+	struct drm_crtc *crtc = arg;
+	struct omap_crtc *omap_crtc = to_omap_crtc(crtc);
+	struct omap_drm_private *priv = crtc->dev->dev_private;
+
+	/* omapdss can sleep, and we may be called with the sync lock held */
+	if (atomic_dec_and_test(&omap_crtc->flip_pending))
+		queue_work(priv->wq, &omap_crtc->flip_work);
+}
+
+/*
+ * Queue an atomic update of several planes of the crtc, to be applied
+ * once rendering to all the new fbs has completed.  A NULL fb disables
+ * the plane.  Call with mode_config.mutex held.
+ */
+int omap_crtc_atomic_flip(struct drm_crtc *crtc, struct drm_plane **planes,
+		struct drm_framebuffer **fbs,
+		struct drm_omap_plane_state *states, int n,
+		struct drm_pending_vblank_event *event)
+{
+	struct drm_device *dev = crtc->dev;
+	struct omap_crtc *omap_crtc = to_omap_crtc(crtc);
+	int i;
+
+	if (n > OMAP_ATOMIC_MAX_PLANES)
+		return -EINVAL;
+
+	for (i = 0; i < n; i++)
+		if (planes[i] != omap_crtc->plane &&
+				!(planes[i]->possible_crtcs &
+					(1 << omap_crtc->id)))
+			return -EINVAL;
+
+	if (omap_crtc->event || omap_crtc->flip_busy) {
+		dev_err(dev->dev, "already a pending flip\n");
+		return -EBUSY;
+	}
+
+	omap_crtc->flip_busy = true;
+	omap_crtc->flip_num = n;
+	omap_crtc->event = event;
+	for (i = 0; i < n; i++) {
+		omap_crtc->flip_planes[i] = planes[i];
+		omap_crtc->flip_fbs[i] = fbs[i];
+		omap_crtc->flip_states[i] = states[i];
+		if (planes[i] == omap_crtc->plane)
+			crtc->fb = fbs[i];
+	}
+
+	atomic_set(&omap_crtc->flip_pending, 1);
+	for (i = 0; i < n; i++) {
+		if (!fbs[i])
+			continue;
+		atomic_inc(&omap_crtc->flip_pending);
+		omap_gem_op_async(omap_framebuffer_bo(fbs[i], 0),
+				OMAP_GEM_READ, atomic_flip_cb, crtc);
+	}
+	atomic_flip_cb(crtc);
+
+	return 0;
+}
+
+/* wait for a queued atomic flip to be applied and latched by the hw */
+int omap_crtc_atomic_wait(struct drm_crtc *crtc)
+{
+	struct omap_crtc *omap_crtc = to_omap_crtc(crtc);
+	struct omap_overlay_manager *mgr;
+	int ret;
+
+	ret = wait_event_interruptible(omap_crtc->flip_wait,
+			!omap_crtc->flip_busy);
+	if (ret)
+		return ret;
+
+	mgr = omap_plane_get_manager(omap_crtc->plane);
+	if (!mgr)
+		return 0;
+
+	return mgr->wait_for_go(mgr);
+}
+
+struct drm_plane *omap_crtc_plane(struct drm_crtc *crtc)
+{
+	return to_omap_crtc(crtc)->plane;
+}
+
 static const struct drm_crtc_funcs omap_crtc_funcs = {
 	.gamma_set = omap_crtc_gamma_set,
 	.set_config = drm_crtc_helper_set_config,
@@ -234,6 +374,8 @@ struct drm_crtc *omap_crtc_init(struct drm_device *dev,
 	omap_crtc->plane->crtc = crtc;
 	omap_crtc->name = ovl->name;
 	omap_crtc->id = id;
+	INIT_WORK(&omap_crtc->flip_work, atomic_flip_worker);
+	init_waitqueue_head(&omap_crtc->flip_wait);
 
 	drm_crtc_init(dev, crtc, &omap_crtc_funcs);
 	drm_crtc_helper_add(crtc, &omap_crtc_helper_funcs);
@@ -59,12 +59,12 @@
 #define DMM_IRQSTAT_ERR_UPD_DATA	(1<<6)
 #define DMM_IRQSTAT_ERR_LUT_MISS	(1<<7)
 
-#define DMM_IRQSTAT_ERR_MASK	(DMM_IRQ_STAT_ERR_INV_DSC | \
-				DMM_IRQ_STAT_ERR_INV_DATA | \
-				DMM_IRQ_STAT_ERR_UPD_AREA | \
-				DMM_IRQ_STAT_ERR_UPD_CTRL | \
-				DMM_IRQ_STAT_ERR_UPD_DATA | \
-				DMM_IRQ_STAT_ERR_LUT_MISS)
+#define DMM_IRQSTAT_ERR_MASK	(DMM_IRQSTAT_ERR_INV_DSC | \
+				DMM_IRQSTAT_ERR_INV_DATA | \
+				DMM_IRQSTAT_ERR_UPD_AREA | \
+				DMM_IRQSTAT_ERR_UPD_CTRL | \
+				DMM_IRQSTAT_ERR_UPD_DATA | \
+				DMM_IRQSTAT_ERR_LUT_MISS)
 
 #define DMM_PATSTATUS_READY		(1<<0)
 #define DMM_PATSTATUS_VALID		(1<<1)
@@ -123,6 +123,9 @@ struct pat {
 */
 #define OMAP5_LUT_OFFSET	128
 
+/* Shadow LUT value no PAT entry holds, forces the entry to be programmed */
+#define DMM_LUT_INVALID		0xffffffff
+
 struct dmm;
 
 struct dmm_txn {
@@ -133,6 +136,8 @@ struct dmm_txn {
 	dma_addr_t current_pa;
 
 	struct pat *last_pat;
+	/* added to the Y coordinates of all the areas of the txn */
+	uint32_t y_offset;
 };
 
 struct refill_engine {
@@ -151,6 +156,14 @@ struct refill_engine {
 
 	wait_queue_head_t wait_for_refill;
 
+	/*
+	 * set while a refill that was not waited for is running; the engine
+	 * is returned to the idle list from the IRQ handler then
+	 */
+	bool async;
+	void (*done_cb)(void *data, int err);
+	void *done_data;
+
 	struct list_head idle_node;
 };
 
@@ -31,6 +31,7 @@
 #include <linux/list.h>
 #include <linux/semaphore.h>
 #include <linux/debugfs.h>
+#include <linux/shrinker.h>
 
 #include "omap_dmm_tiler.h"
 #include "omap_dmm_priv.h"
@@ -44,6 +45,17 @@ static struct dmm *omap_dmm;
 /* global spinlock for protecting lists */
 static DEFINE_SPINLOCK(list_lock);
 
+/*
+ * Released 2D blocks kept reserved for reuse by an identical request.
+ * Protected by list_lock; oldest blocks are at the head.
+ */
+static LIST_HEAD(recycle_head);
+static unsigned int recycle_count;
+static unsigned int recycle_max;
+
+/* protects the idle engine list, also taken from the IRQ handler */
+static DEFINE_SPINLOCK(engine_lock);
+
 /* Geometry table */
 #define GEOM(xshift, yshift, bytes_per_pixel) { \
 		.x_shft = (xshift), \
@@ -139,6 +151,64 @@ static int wait_status(struct refill_engine *engine, uint32_t wait_mask)
 	return 0;
 }
 
+/*
+ * The shadow LUT is updated as the txn is built.  If the refill fails, mark
+ * the entries it was to program as unknown, so that they are programmed
+ * again next time.
+ */
+static void dmm_txn_invalidate(struct refill_engine *engine)
+{
+	struct dmm_txn *txn = &engine->txn;
+	struct pat *pat = (struct pat *)engine->refill_va;
+	int x, y;
+
+	if (!txn->last_pat)
+		return;
+
+	while (true) {
+		u32 *lut = engine->tcm->lut + (pat->area.y0 - txn->y_offset) *
+				omap_dmm->lut_width;
+
+		for (y = pat->area.y0; y <= pat->area.y1;
+				y++, lut += omap_dmm->lut_width)
+			for (x = pat->area.x0; x <= pat->area.x1; x++)
+				lut[x] = DMM_LUT_INVALID;
+
+		if (pat == txn->last_pat)
+			break;
+		pat = (struct pat *)(engine->refill_va +
+				(pat->next_pa - engine->refill_pa));
+	}
+}
+
+/* return an engine to the idle list, at the tail to rotate the engines */
+static void release_engine(struct refill_engine *engine)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&engine_lock, flags);
+	list_add_tail(&engine->idle_node, &engine->dmm->idle_head);
+	spin_unlock_irqrestore(&engine_lock, flags);
+
+	up(&engine->dmm->engine_sem);
+}
+
+/* complete an asynchronous refill: release the engine and notify */
+static void async_done(struct refill_engine *engine, int err)
+{
+	void (*cb)(void *data, int err) = engine->done_cb;
+	void *data = engine->done_data;
+
+	engine->async = false;
+	engine->done_cb = NULL;
+	if (err)
+		dmm_txn_invalidate(engine);
+	release_engine(engine);
+
+	if (cb)
+		cb(data, err);
+}
+
 static irqreturn_t omap_dmm_irq_handler(int irq, void *arg)
 {
 	struct dmm *dmm = arg;
@@ -149,8 +219,15 @@ static irqreturn_t omap_dmm_irq_handler(int irq, void *arg)
 	writel(status, dmm->base + DMM_PAT_IRQSTATUS);
 
 	for (i = 0; i < dmm->num_engines; i++) {
-		if (status & DMM_IRQSTAT_LST)
-			wake_up_interruptible(&dmm->engines[i].wait_for_refill);
+		struct refill_engine *engine = &dmm->engines[i];
+		/* LUT misses are only advisory */
+		u32 err = status & DMM_IRQSTAT_ERR_MASK &
+						~DMM_IRQSTAT_ERR_LUT_MISS;
+
+		if (engine->async && (err || (status & DMM_IRQSTAT_LST)))
+			async_done(engine, err ? -EFAULT : 0);
+		else if (status & DMM_IRQSTAT_LST)
+			wake_up_interruptible(&engine->wait_for_refill);
 
 		status >>= 8;
 	}
@@ -165,17 +242,18 @@ static struct dmm_txn *dmm_txn_init(struct dmm *dmm, struct tcm *tcm)
 {
 	struct dmm_txn *txn = NULL;
 	struct refill_engine *engine = NULL;
+	unsigned long flags;
 
 	down(&dmm->engine_sem);
 
 	/* grab an idle engine */
-	spin_lock(&list_lock);
+	spin_lock_irqsave(&engine_lock, flags);
 	if (!list_empty(&dmm->idle_head)) {
 		engine = list_entry(dmm->idle_head.next, struct refill_engine,
 					idle_node);
 		list_del(&engine->idle_node);
 	}
-	spin_unlock(&list_lock);
+	spin_unlock_irqrestore(&engine_lock, flags);
 
 	BUG_ON(!engine);
 
@@ -183,15 +261,35 @@ static struct dmm_txn *dmm_txn_init(struct dmm *dmm, struct tcm *tcm)
 	engine->tcm = tcm;
 	txn->engine_handle = engine;
 	txn->last_pat = NULL;
+	txn->y_offset = 0;
 	txn->current_va = engine->refill_va;
 	txn->current_pa = engine->refill_pa;
 
 	return txn;
 }
 
+/* the physical address PAT entry i of an area is to be programmed with */
+static u32 pat_entry(struct dmm *dmm, struct mem_info *mem, uint32_t npages,
+		uint32_t roll, int i)
+{
+	int n = i + roll;
+
+	if (n >= npages)
+		n -= npages;
+	if (!mem)
+		return dmm->dummy_pa;
+	if (mem->type == MEMTYPE_PAGES)
+		return (mem->pages && mem->pages[n]) ?
+			page_to_phys(mem->pages[n]) : dmm->dummy_pa;
+	return mem->phys_addrs ? mem->phys_addrs[n] : dmm->dummy_pa;
+}
+
 /**
  * Add region to DMM transaction.  If pages or pages[i] is NULL, then the
  * corresponding slot is cleared (ie. dummy_pa is programmed)
+ *
+ * Only the bounding box of the entries that differ from the shadow LUT is
+ * programmed, and nothing at all if the area is already set up this way.
  */
 static int dmm_txn_append(struct dmm_txn *txn, struct pat_area *area,
 		struct mem_info *mem, uint32_t npages, uint32_t roll,
@@ -201,68 +299,84 @@ static int dmm_txn_append(struct dmm_txn *txn, struct pat_area *area,
 	uint32_t *data;
 	struct pat *pat;
 	struct refill_engine *engine = txn->engine_handle;
+	struct dmm *dmm = engine->dmm;
 	int columns = (1 + area->x1 - area->x0);
 	int rows = (1 + area->y1 - area->y0);
-	int i = columns*rows;
+	int x0 = columns, x1 = -1, y0 = rows, y1 = -1;
+	int x, y, w, h;
 	u32 *lut = engine->tcm->lut + (area->y0 * omap_dmm->lut_width) +
 			area->x0;
 
+	for (y = 0; y < rows; y++) {
+		u32 *row = lut + y * omap_dmm->lut_width;
+
+		for (x = 0; x < columns; x++) {
+			if (row[x] == pat_entry(dmm, mem, npages, roll,
+						y * columns + x))
+				continue;
+			x0 = min(x0, x);
+			x1 = max(x1, x);
+			y0 = min(y0, y);
+			y1 = max(y1, y);
+		}
+	}
+
+	if (y1 < 0)
+		return 0;
+
+	w = 1 + x1 - x0;
+	h = 1 + y1 - y0;
+
 	pat = alloc_dma(txn, sizeof(struct pat), &pat_pa);
 
 	if (txn->last_pat)
 		txn->last_pat->next_pa = (uint32_t)pat_pa;
 
-	pat->area = *area;
-
-	pat->area.y0 += y_offset;
-	pat->area.y1 += y_offset;
+	pat->area = (struct pat_area){
+			.x0 = area->x0 + x0, .y0 = area->y0 + y0 + y_offset,
+			.x1 = area->x0 + x1, .y1 = area->y0 + y1 + y_offset,
+		};
 
 	pat->ctrl = (struct pat_ctrl){
 			.start = 1,
 			.lut_id = 0,
 		};
 
-	data = alloc_dma(txn, 4*i, &pat->data_pa);
-
-	while (i--) {
-		int n = i + roll;
-		if (n >= npages)
-			n -= npages;
-		if (!mem)
-			data[i] = engine->dmm->dummy_pa;
-		else{
-			if (mem->type == MEMTYPE_PAGES) {
-				data[i] = (mem->pages && mem->pages[n]) ?
-					page_to_phys(mem->pages[n]) :
-					engine->dmm->dummy_pa;
-			} else {
-				data[i] = mem->phys_addrs ? mem->phys_addrs[n] :
-						engine->dmm->dummy_pa;
-			}
-		}
-	}
+	data = alloc_dma(txn, 4 * w * h, &pat->data_pa);
+
+	for (y = 0; y < h; y++) {
+		u32 *row = lut + (y0 + y) * omap_dmm->lut_width + x0;
 
-	for (i = 0; i < rows; i++, lut += omap_dmm->lut_width)
-		memcpy(lut, &data[i*columns], columns * sizeof(u32));
+		for (x = 0; x < w; x++)
+			data[y * w + x] = row[x] = pat_entry(dmm, mem, npages,
+					roll, (y0 + y) * columns + x0 + x);
+	}
 
 	txn->last_pat = pat;
+	txn->y_offset = y_offset;
 
 	return 0;
 }
 
 /**
- * Commit the DMM transaction.
+ * Commit the DMM transaction.  If wait is false, the refill runs in the
+ * background and cb, if any, is called with its result from the IRQ
+ * handler.  The engine stays busy until then, so that its refill buffer is
+ * not reused while the hardware still reads it.
  */
-static int dmm_txn_commit(struct dmm_txn *txn, bool wait)
+static int dmm_txn_commit(struct dmm_txn *txn, bool wait,
+		void (*cb)(void *data, int err), void *data)
 {
 	int ret = 0;
 	struct refill_engine *engine = txn->engine_handle;
 	struct dmm *dmm = engine->dmm;
 
+	/* every area was already programmed this way */
 	if (!txn->last_pat) {
-		dev_err(engine->dmm->dev, "need at least one txn\n");
-		ret = -EINVAL;
-		goto cleanup;
+		release_engine(engine);
+		if (cb)
+			cb(data, 0);
+		return 0;
 	}
 
 	txn->last_pat->next_pa = 0;
@@ -277,25 +391,33 @@ static int dmm_txn_commit(struct dmm_txn *txn, bool wait)
 		goto cleanup;
 	}
 
+	if (!wait) {
+		engine->done_cb = cb;
+		engine->done_data = data;
+		engine->async = true;
+		wmb();
+	}
+
 	/* kick reload */
 	writel(engine->refill_pa,
 		dmm->base + reg[PAT_DESCR][engine->id]);
 
-	if (wait) {
-		if (wait_event_interruptible_timeout(engine->wait_for_refill,
-				wait_status(engine, DMM_PATSTATUS_READY) == 0,
-				msecs_to_jiffies(1)) <= 0) {
-			dev_err(dmm->dev, "timed out waiting for done\n");
-			ret = -ETIMEDOUT;
-		}
+	if (!wait)
+		return 0;
+
+	if (wait_event_interruptible_timeout(engine->wait_for_refill,
+			wait_status(engine, DMM_PATSTATUS_READY) == 0,
+			msecs_to_jiffies(1)) <= 0) {
+		dev_err(dmm->dev, "timed out waiting for done\n");
+		ret = -ETIMEDOUT;
 	}
 
 cleanup:
-	spin_lock(&list_lock);
-	list_add(&engine->idle_node, &dmm->idle_head);
-	spin_unlock(&list_lock);
-
-	up(&omap_dmm->engine_sem);
+	if (ret)
+		dmm_txn_invalidate(engine);
+	release_engine(engine);
+	if (ret && cb)
+		cb(data, ret);
 	return ret;
 }
 
@@ -303,7 +425,8 @@ cleanup:
  * DMM programming
  */
 static int fill(struct tcm_area *area, struct mem_info *mem, uint32_t npages,
-		uint32_t roll, bool wait)
+		uint32_t roll, bool wait, void (*cb)(void *data, int err),
+		void *data)
 {
 	int ret = 0;
 	struct tcm_area slice, area_s;
@@ -331,7 +454,7 @@ static int fill(struct tcm_area *area, struct mem_info *mem, uint32_t npages,
 		roll += tcm_sizeof(slice);
 	}
 
-	ret = dmm_txn_commit(txn, wait);
+	ret = dmm_txn_commit(txn, wait, cb, data);
 
 fail:
 	return ret;
@@ -352,7 +475,7 @@ int tiler_pin(struct tiler_block *block, struct page **pages,
 	mem.type = MEMTYPE_PAGES;
 	mem.pages = pages;
 
-	ret = fill(&block->area, &mem, npages, roll, wait);
+	ret = fill(&block->area, &mem, npages, roll, wait, NULL, NULL);
 
 	if (ret)
 		tiler_unpin(block);
@@ -363,7 +486,8 @@ EXPORT_SYMBOL(tiler_pin);
 
 int tiler_unpin(struct tiler_block *block)
 {
-	return fill(&block->area, NULL, 0, 0, false);
+	block->views_valid = false;
+	return fill(&block->area, NULL, 0, 0, false, NULL, NULL);
 }
 EXPORT_SYMBOL(tiler_unpin);
 
@@ -376,18 +500,170 @@ int tiler_pin_phys(struct tiler_block *block, u32 *phys_addrs,
 	mem.type = MEMTYPE_CARVEOUT;
 	mem.phys_addrs = phys_addrs;
 
-	ret = fill(&block->area, &mem, num_pages, 0, true);
+	ret = fill(&block->area, &mem, num_pages, 0, true, NULL, NULL);
 	return ret;
 }
 EXPORT_SYMBOL(tiler_pin_phys);
 
+/*
+ * Same as tiler_pin_phys(), but returns as soon as the refill is started.
+ * cb is called from interrupt context once the PAT is programmed, or with
+ * the error if the refill failed, including when this returns an error.
+ * Refills are spread across all refill engines, so several can run at the
+ * same time.
+ */
+int tiler_pin_phys_async(struct tiler_block *block, u32 *phys_addrs,
+		u32 num_pages, void (*cb)(void *data, int err), void *data)
+{
+	struct mem_info mem;
+
+	mem.type = MEMTYPE_CARVEOUT;
+	mem.phys_addrs = phys_addrs;
+
+	return fill(&block->area, &mem, num_pages, 0, false, cb, data);
+}
+EXPORT_SYMBOL(tiler_pin_phys_async);
+
+/*
+ * Pin several 2D blocks in a single refill, e.g. the Y and UV planes of an
+ * NV12 buffer.  The blocks must share a container.
+ */
+int tiler_pin_phys_multi(struct tiler_block **blocks, u32 **phys_addrs,
+		u32 *num_pages, int n)
+{
+	struct dmm_txn *txn;
+	struct mem_info mem;
+	int i, ret;
+
+	/* the refill buffer has room for TILER_PIN_MAX descriptors */
+	if (n < 1 || n > TILER_PIN_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < n; i++)
+		if (!blocks[i]->area.is2d ||
+		    blocks[i]->area.tcm != blocks[0]->area.tcm)
+			return -EINVAL;
+
+	txn = dmm_txn_init(omap_dmm, blocks[0]->area.tcm);
+	if (IS_ERR_OR_NULL(txn))
+		return PTR_ERR(txn);
+
+	mem.type = MEMTYPE_CARVEOUT;
+	for (i = 0; i < n; i++) {
+		struct tcm_area *area = &blocks[i]->area;
+		struct pat_area p_area = {
+				.x0 = area->p0.x, .y0 = area->p0.y,
+				.x1 = area->p1.x, .y1 = area->p1.y,
+		};
+
+		mem.phys_addrs = phys_addrs[i];
+		ret = dmm_txn_append(txn, &p_area, &mem, num_pages[i], 0, 0);
+		if (ret)
+			return ret;
+	}
+
+	return dmm_txn_commit(txn, true, NULL, NULL);
+}
+EXPORT_SYMBOL(tiler_pin_phys_multi);
+
 /*
  * Reserve/release
  */
-struct tiler_block *tiler_reserve_2d(enum tiler_fmt fmt, uint16_t w,
+
+static int release_block(struct tiler_block *block)
+{
+	int ret = tcm_free(&block->area);
+
+	if (block->area.tcm)
+		dev_err(omap_dmm->dev, "failed to release block\n");
+
+	spin_lock(&list_lock);
+	list_del(&block->alloc_node);
+	spin_unlock(&list_lock);
+
+	kfree(block);
+	return ret;
+}
+
+static struct tiler_block *recycle_get(enum tiler_fmt fmt, uint16_t w,
 		uint16_t h, uint16_t align)
 {
 	struct tiler_block *block;
+
+	spin_lock(&list_lock);
+	list_for_each_entry(block, &recycle_head, recycle_node) {
+		if (block->fmt == fmt && block->width == w &&
+		    block->height == h && block->align == align) {
+			list_del(&block->recycle_node);
+			recycle_count--;
+			spin_unlock(&list_lock);
+			return block;
+		}
+	}
+	spin_unlock(&list_lock);
+
+	return NULL;
+}
+
+/* release up to n of the oldest recycled blocks, returns the number freed */
+static unsigned int recycle_drain(unsigned int n)
+{
+	struct tiler_block *block;
+	unsigned int freed;
+
+	for (freed = 0; freed < n; freed++) {
+		spin_lock(&list_lock);
+		if (list_empty(&recycle_head)) {
+			spin_unlock(&list_lock);
+			break;
+		}
+		block = list_first_entry(&recycle_head, struct tiler_block,
+					recycle_node);
+		list_del(&block->recycle_node);
+		recycle_count--;
+		spin_unlock(&list_lock);
+
+		release_block(block);
+	}
+
+	return freed;
+}
+
+static int recycle_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	if (sc->nr_to_scan)
+		recycle_drain(sc->nr_to_scan);
+
+	return recycle_count;
+}
+
+static struct shrinker recycle_shrinker = {
+	.shrink = recycle_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+/*
+ * Keep up to n released 2D blocks reserved so that the next tiler_reserve_2d()
+ * with the same format, size and alignment does not have to search the
+ * container.  0 disables recycling.
+ */
+void tiler_set_recycle_size(unsigned int n)
+{
+	unsigned int excess;
+
+	spin_lock(&list_lock);
+	recycle_max = n;
+	excess = recycle_count > n ? recycle_count - n : 0;
+	spin_unlock(&list_lock);
+
+	recycle_drain(excess);
+}
+EXPORT_SYMBOL(tiler_set_recycle_size);
+
+struct tiler_block *tiler_reserve_2d(enum tiler_fmt fmt, uint16_t w,
+		uint16_t h, uint16_t align)
+{
+	struct tiler_block *block, *recycled;
 	u32 min_align = 128;
 	int ret;
 	size_t slot_bytes;
@@ -415,12 +691,24 @@ struct tiler_block *tiler_reserve_2d(enum tiler_fmt fmt, uint16_t w,
 	align = ALIGN(align, min_align);
 	align /= slot_bytes;
 
+	/* reuse an identical recycled block if there is one */
+	recycled = recycle_get(fmt, w, h, align);
+	if (recycled) {
+		kfree(block);
+		return recycled;
+	}
+	block->align = align;
+
 	/* convert width/height to slots */
 	w = DIV_ROUND_UP(w, geom[fmt].slot_w);
 	h = DIV_ROUND_UP(h, geom[fmt].slot_h);
 
 	ret = tcm_reserve_2d(containers[fmt], w, h, align, -1, slot_bytes,
 			&block->area);
+	/* recycled blocks may be what is filling up the container */
+	if (ret && recycle_drain(UINT_MAX))
+		ret = tcm_reserve_2d(containers[fmt], w, h, align, -1,
+				slot_bytes, &block->area);
 	if (ret) {
 		kfree(block);
 		return ERR_PTR(-ENOMEM);
@@ -465,19 +753,30 @@ EXPORT_SYMBOL(tiler_reserve_1d);
 /* note: if you have pin'd pages, you should have already unpin'd first! */
 int tiler_release(struct tiler_block *block)
 {
-	int ret = tcm_free(&block->area);
-
-	if (block->area.tcm)
-		dev_err(omap_dmm->dev, "failed to release block\n");
+	return release_block(block);
+}
+EXPORT_SYMBOL(tiler_release);
 
-	spin_lock(&list_lock);
-	list_del(&block->alloc_node);
-	spin_unlock(&list_lock);
+/*
+ * Same as tiler_release(), but 2D blocks stay reserved in the recycle pool
+ * while it has room.  The block must be unpinned.
+ */
+int tiler_recycle(struct tiler_block *block)
+{
+	if (block->fmt != TILFMT_PAGE) {
+		spin_lock(&list_lock);
+		if (recycle_count < recycle_max) {
+			list_add_tail(&block->recycle_node, &recycle_head);
+			recycle_count++;
+			spin_unlock(&list_lock);
+			return 0;
+		}
+		spin_unlock(&list_lock);
+	}
 
-	kfree(block);
-	return ret;
+	return tiler_release(block);
 }
-EXPORT_SYMBOL(tiler_release);
+EXPORT_SYMBOL(tiler_recycle);
 
 /*
  * Utils
@@ -751,14 +1050,74 @@ int tilview_flip(struct tiler_view_t *view, bool flip_x, bool flip_y)
 }
 EXPORT_SYMBOL(tilview_flip);
 
+/*
+ * Compute all orientations of a view at once, indexed by TILER_ORIENT().
+ * Each entry matches tilview_rotate(rotation * 90) followed by
+ * tilview_flip(mirror, false); the mirrored views reuse the rotated ones.
+ */
+int tilview_orientations(const struct tiler_view_t *view,
+		struct tiler_view_t views[TILER_NUM_ORIENT])
+{
+	int r, ret;
+
+	for (r = 0; r < 4; r++) {
+		views[r] = *view;
+		ret = tilview_rotate(&views[r], r * 90);
+		if (ret)
+			return ret;
+
+		views[r + 4] = views[r];
+		ret = tilview_flip(&views[r + 4], true, false);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+EXPORT_SYMBOL(tilview_orientations);
+
+/*
+ * Get the full-block view in the given orientation.  The orientations are
+ * computed on first use and cached in the block until it is unpinned.
+ */
+int tilview_get_orient(struct tiler_view_t *view, struct tiler_block *blk,
+		int rotation, bool mirror)
+{
+	struct tiler_view_t natural;
+	int ret;
+
+	if (rotation % 90)
+		return -EINVAL;
+
+	if (!blk->views_valid) {
+		tilview_get(&natural, blk);
+		ret = tilview_orientations(&natural, blk->views);
+		if (ret)
+			return ret;
+
+		/* publish views[] before the flag for lockless readers */
+		smp_wmb();
+		blk->views_valid = true;
+	} else {
+		smp_rmb();
+	}
+
+	*view = blk->views[TILER_ORIENT(rotation / 90, mirror)];
+	return 0;
+}
+EXPORT_SYMBOL(tilview_get_orient);
+
 static int omap_dmm_remove(struct platform_device *dev)
 {
 	struct tiler_block *block, *_block;
 	int i;
 
 	if (omap_dmm) {
-		/* free all area regions */
+		unregister_shrinker(&recycle_shrinker);
+
+		/* free all area regions, recycled blocks are on the list too */
 		spin_lock(&list_lock);
+		INIT_LIST_HEAD(&recycle_head);
+		recycle_count = 0;
 		list_for_each_entry_safe(block, _block, &omap_dmm->alloc_head,
 					alloc_node) {
 			list_del(&block->alloc_node);
@@ -810,6 +1169,8 @@ static int omap_dmm_probe(struct platform_device *dev)
 	INIT_LIST_HEAD(&omap_dmm->alloc_head);
 	INIT_LIST_HEAD(&omap_dmm->idle_head);
 
+	register_shrinker(&recycle_shrinker);
+
 	/* lookup hwmod data - base address and irq */
 	mem = platform_get_resource(dev, IORESOURCE_MEM, 0);
 	if (!mem) {
@@ -980,18 +1341,19 @@ static int omap_dmm_probe(struct platform_device *dev)
 		.p1.y = omap_dmm->container_height - 1,
 	};
 
+	/* the PAT is in an unknown state, program every entry */
 	for (i = 0; i < lut_table_size; i++)
-		omap_dmm->lut[i] = omap_dmm->dummy_pa;
+		omap_dmm->lut[i] = DMM_LUT_INVALID;
 
 	/* initialize all LUTs to dummy page entries */
-	if (fill(&area, NULL, 0, 0, true))
+	if (fill(&area, NULL, 0, 0, true, NULL, NULL))
 		dev_err(omap_dmm->dev, "refill failed");
 
 	if (cpu_is_omap54xx()) {
 		area.tcm = omap_dmm->tcm[1];
 		area.is2d = false;
 
-		if (fill(&area, NULL, 0, 0, true))
+		if (fill(&area, NULL, 0, 0, true, NULL, NULL))
 			dev_err(omap_dmm->dev, "refill failed");
 	}
 
@@ -1167,10 +1529,21 @@ int tiler_map_show(struct seq_file *s, void *arg)
 		spin_unlock_irqrestore(&list_lock, flags);
 
 		if (s) {
+			struct tcm_stats st;
+
 			seq_printf(s, "CONTAINER %d DUMP BEGIN\n", lut_idx);
 			for (i = 0; i < 128; i++)
 				seq_printf(s, "%03d:%s\n", i, map[i]);
 			seq_printf(s, "CONTAINER %d DUMP END\n", lut_idx);
+
+			/* share of free space outside the largest free area */
+			if (!tcm_stats(omap_dmm->tcm[lut_idx], &st) && st.free)
+				seq_printf(s, "CONTAINER %d: %u free slots, "
+					"largest free %ux%u, "
+					"fragmentation %u%%\n", lut_idx,
+					st.free, st.max_w, st.max_h,
+					100 - st.max_w * st.max_h * 100 /
+								st.free);
 		} else {
 			dev_dbg(omap_dmm->dev, "CONTAINER %d DUMP_BEGIN\n",
 				lut_idx);
@@ -1222,14 +1595,18 @@ static int omap_dmm_resume(struct device *dev)
 		area.is2d = (cpu_is_omap54xx() && i) ? false : true;
 
 		for (j = 0; j < number_slots; j++) {
-			if (area.tcm->lut[j] != omap_dmm->dummy_pa)
+			if (area.tcm->lut[j] != omap_dmm->dummy_pa &&
+			    area.tcm->lut[j] != DMM_LUT_INVALID)
 				mem.pages[j] = phys_to_page(area.tcm->lut[j]);
 			else
 				mem.pages[j] = NULL;
+			/* the PAT was lost, program every entry */
+			area.tcm->lut[j] = DMM_LUT_INVALID;
 		}
 
 		if (fill(&area, &mem, omap_dmm->container_width *
-				omap_dmm->container_height, 0, true))
+				omap_dmm->container_height, 0, true,
+				NULL, NULL))
 			dev_err(omap_dmm->dev, "refill failed");
 	}
 
@@ -35,8 +35,23 @@ struct pat_area {
 	u32 y1:8;
 };
 
+/* rotation (0..3 quarters) and horizontal mirror of a tiler view */
+#define TILER_NUM_ORIENT	8
+#define TILER_ORIENT(rotation, mirror)	(((rotation) & 3) | ((mirror) ? 4 : 0))
+
+/* tiler (image/video frame) view */
+struct tiler_view_t {
+	uint32_t tsptr;		/* tiler space addr */
+	uint32_t width;		/* width */
+	uint32_t height;	/* height */
+	uint32_t bpp;		/* bytes per pixel */
+	int h_inc;		/* horizontal increment */
+	int v_inc;		/* vertical increment */
+};
+
 struct tiler_block {
 	struct list_head alloc_node;	/* node for global block list */
+	struct list_head recycle_node;	/* node for recycle pool */
 	struct tcm_area area;		/* area */
 	enum tiler_fmt fmt;		/* format */
 	uint32_t width;
@@ -44,6 +59,9 @@ struct tiler_block {
 	uint32_t stride;		/* 2D: length of one line in pages
 					   1D: length of buffer rounded to
 						PAGE_SIZE */
+	uint16_t align;			/* 2D: alignment in slots */
+	bool views_valid;		/* views[] computed since last unpin */
+	struct tiler_view_t views[TILER_NUM_ORIENT]; /* by TILER_ORIENT() */
 };
 
 /* bits representing the same slot in DMM-TILER hw-block */
@@ -59,6 +77,9 @@ struct tiler_block {
 #define TILER_WIDTH             (1 << (CONT_WIDTH_BITS - SLOT_WIDTH_BITS))
 #define TILER_HEIGHT            (1 << (CONT_HEIGHT_BITS - SLOT_HEIGHT_BITS))
 
+/* maximum number of blocks for tiler_pin_phys_multi() */
+#define TILER_PIN_MAX		3
+
 /* tiler space addressing bitfields */
 #define MASK_XY_FLIP		(1 << 31)
 #define MASK_Y_INVERT		(1 << 30)
@@ -94,6 +115,10 @@ int tiler_map_show(struct seq_file *s, void *arg);
 int tiler_pin(struct tiler_block *block, struct page **pages,
 		uint32_t npages, uint32_t roll, bool wait);
 int tiler_pin_phys(struct tiler_block *block, u32 *phys_addrs, u32 num_pages);
+int tiler_pin_phys_async(struct tiler_block *block, u32 *phys_addrs,
+		u32 num_pages, void (*cb)(void *data, int err), void *data);
+int tiler_pin_phys_multi(struct tiler_block **blocks, u32 **phys_addrs,
+		u32 *num_pages, int n);
 int tiler_unpin(struct tiler_block *block);
 
 /* reserve/release */
@@ -101,6 +126,8 @@ struct tiler_block *tiler_reserve_2d(enum tiler_fmt fmt, uint16_t w, uint16_t h,
 				uint16_t align);
 struct tiler_block *tiler_reserve_1d(size_t size);
 int tiler_release(struct tiler_block *block);
+int tiler_recycle(struct tiler_block *block);
+void tiler_set_recycle_size(unsigned int n);
 
 /* utilities */
 dma_addr_t tiler_ssptr(struct tiler_block *block);
@@ -112,15 +139,6 @@ bool dmm_is_initialized(void);
 
 
 /* rotation */
-/* tiler (image/video frame) view */
-struct tiler_view_t {
-	uint32_t tsptr;		/* tiler space addr */
-	uint32_t width;		/* width */
-	uint32_t height;	/* height */
-	uint32_t bpp;		/* bytes per pixel */
-	int h_inc;		/* horizontal increment */
-	int v_inc;		/* vertical increment */
-};
 
 bool is_tiler_addr(uint32_t phys);
 int tiler_get_fmt(uint32_t phys, enum tiler_fmt *fmt);
@@ -130,6 +148,10 @@ int tilview_crop(struct tiler_view_t *view, u32 left, u32 top, u32 width,
 		u32 height);
 int tilview_rotate(struct tiler_view_t *view, int rotation);
 int tilview_flip(struct tiler_view_t *view, bool flip_x, bool flip_y);
+int tilview_orientations(const struct tiler_view_t *view,
+		struct tiler_view_t views[TILER_NUM_ORIENT]);
+int tilview_get_orient(struct tiler_view_t *view, struct tiler_block *blk,
+		int rotation, bool mirror);
 
 extern struct platform_driver omap_dmm_driver;
 
@@ -99,6 +99,37 @@ struct drm_omap_gem_info {
 	uint32_t __pad;
 };
 
+/* maximum planes in one atomic flip, one per overlay */
+#define OMAP_ATOMIC_MAX_PLANES		4
+
+/* flags for drm_omap_atomic_flip */
+#define OMAP_ATOMIC_EVENT		0x01	/* send DRM_EVENT_FLIP_COMPLETE */
+#define OMAP_ATOMIC_NONBLOCK		0x02	/* don't wait for the flip */
+
+struct drm_omap_plane_state {
+	uint32_t plane_id;		/* plane, or 0 for the CRTC's own */
+	uint32_t fb_id;			/* framebuffer, or 0 to disable */
+	int32_t crtc_x, crtc_y;		/* position on the CRTC */
+	uint32_t crtc_w, crtc_h;
+	uint32_t src_x, src_y;		/* source rectangle in Q16 */
+	uint32_t src_w, src_h;
+};
+
+/*
+ * Update the CRTC's own plane and any overlay planes on it at once: all new
+ * framebuffers and positions are applied to the manager together, once the
+ * rendering to each framebuffer has completed.  Planes that get disabled,
+ * or enabled from disabled, change state only after the rest is applied.
+ */
+struct drm_omap_atomic_flip {
+	uint32_t crtc_id;		/* (in) */
+	uint32_t flags;			/* mask of OMAP_ATOMIC_* (in) */
+	uint64_t user_data;		/* returned in the event (in) */
+	uint32_t num_planes;		/* (in) */
+	uint32_t __pad;
+	struct drm_omap_plane_state planes[OMAP_ATOMIC_MAX_PLANES];
+};
+
 #define DRM_OMAP_GET_PARAM		0x00
 #define DRM_OMAP_SET_PARAM		0x01
 /* placeholder for plugin-api
@@ -108,7 +139,8 @@ struct drm_omap_gem_info {
 #define DRM_OMAP_GEM_CPU_PREP		0x04
 #define DRM_OMAP_GEM_CPU_FINI		0x05
 #define DRM_OMAP_GEM_INFO		0x06
-#define DRM_OMAP_NUM_IOCTLS		0x07
+#define DRM_OMAP_ATOMIC_FLIP		0x07
+#define DRM_OMAP_NUM_IOCTLS		0x08
 
 #define DRM_IOCTL_OMAP_GET_PARAM	DRM_IOWR(DRM_COMMAND_BASE + DRM_OMAP_GET_PARAM, struct drm_omap_param)
 #define DRM_IOCTL_OMAP_SET_PARAM	DRM_IOW (DRM_COMMAND_BASE + DRM_OMAP_SET_PARAM, struct drm_omap_param)
@@ -119,5 +151,6 @@ struct drm_omap_gem_info {
 #define DRM_IOCTL_OMAP_GEM_CPU_PREP	DRM_IOW (DRM_COMMAND_BASE + DRM_OMAP_GEM_CPU_PREP, struct drm_omap_gem_cpu_prep)
 #define DRM_IOCTL_OMAP_GEM_CPU_FINI	DRM_IOW (DRM_COMMAND_BASE + DRM_OMAP_GEM_CPU_FINI, struct drm_omap_gem_cpu_fini)
 #define DRM_IOCTL_OMAP_GEM_INFO		DRM_IOWR(DRM_COMMAND_BASE + DRM_OMAP_GEM_INFO, struct drm_omap_gem_info)
+#define DRM_IOCTL_OMAP_ATOMIC_FLIP	DRM_IOW (DRM_COMMAND_BASE + DRM_OMAP_ATOMIC_FLIP, struct drm_omap_atomic_flip)
 
 #endif /* __OMAP_DRM_H__ */
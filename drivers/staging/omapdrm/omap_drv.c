@@ -531,6 +531,117 @@ static int ioctl_gem_info(struct drm_device *dev, void *data,
 	return ret;
 }
 
+static int ioctl_atomic_flip(struct drm_device *dev, void *data,
+		struct drm_file *file_priv)
+{
+	struct drm_omap_atomic_flip *args = data;
+	struct drm_plane *planes[OMAP_ATOMIC_MAX_PLANES];
+	struct drm_framebuffer *fbs[OMAP_ATOMIC_MAX_PLANES];
+	struct drm_pending_vblank_event *e = NULL;
+	struct drm_mode_object *obj;
+	struct drm_crtc *crtc;
+	unsigned long flags;
+	int i, ret = -EINVAL;
+
+	DBG("%p:%p: crtc=%d, planes=%d, flags=%x", dev, file_priv,
+			args->crtc_id, args->num_planes, args->flags);
+
+	if (args->flags & ~(OMAP_ATOMIC_EVENT | OMAP_ATOMIC_NONBLOCK) ||
+	    !args->num_planes || args->num_planes > OMAP_ATOMIC_MAX_PLANES)
+		return -EINVAL;
+
+	mutex_lock(&dev->mode_config.mutex);
+
+	obj = drm_mode_object_find(dev, args->crtc_id, DRM_MODE_OBJECT_CRTC);
+	if (!obj)
+		goto out;
+	crtc = obj_to_crtc(obj);
+
+	if (!crtc->fb) {
+		/* not modeset yet, or unbound by a hotplug */
+		ret = -EBUSY;
+		goto out;
+	}
+
+	for (i = 0; i < args->num_planes; i++) {
+		struct drm_omap_plane_state *st = &args->planes[i];
+		int j;
+
+		if (st->plane_id) {
+			obj = drm_mode_object_find(dev, st->plane_id,
+					DRM_MODE_OBJECT_PLANE);
+			if (!obj)
+				goto out;
+			planes[i] = obj_to_plane(obj);
+		} else {
+			planes[i] = omap_crtc_plane(crtc);
+		}
+
+		for (j = 0; j < i; j++)
+			if (planes[j] == planes[i])
+				goto out;
+
+		fbs[i] = NULL;
+		if (st->fb_id) {
+			obj = drm_mode_object_find(dev, st->fb_id,
+					DRM_MODE_OBJECT_FB);
+			if (!obj)
+				goto out;
+			fbs[i] = obj_to_fb(obj);
+		} else if (planes[i] == omap_crtc_plane(crtc)) {
+			/* the CRTC itself is disabled thru modeset */
+			goto out;
+		}
+	}
+
+	if (args->flags & OMAP_ATOMIC_EVENT) {
+		ret = -ENOMEM;
+		spin_lock_irqsave(&dev->event_lock, flags);
+		if (file_priv->event_space < sizeof e->event) {
+			spin_unlock_irqrestore(&dev->event_lock, flags);
+			goto out;
+		}
+		file_priv->event_space -= sizeof e->event;
+		spin_unlock_irqrestore(&dev->event_lock, flags);
+
+		e = kzalloc(sizeof *e, GFP_KERNEL);
+		if (e == NULL) {
+			spin_lock_irqsave(&dev->event_lock, flags);
+			file_priv->event_space += sizeof e->event;
+			spin_unlock_irqrestore(&dev->event_lock, flags);
+			goto out;
+		}
+
+		e->event.base.type = DRM_EVENT_FLIP_COMPLETE;
+		e->event.base.length = sizeof e->event;
+		e->event.user_data = args->user_data;
+		e->base.event = &e->event.base;
+		e->base.file_priv = file_priv;
+		e->base.destroy =
+			(void (*) (struct drm_pending_event *)) kfree;
+	}
+
+	ret = omap_crtc_atomic_flip(crtc, planes, fbs, args->planes,
+			args->num_planes, e);
+	if (ret && e) {
+		spin_lock_irqsave(&dev->event_lock, flags);
+		file_priv->event_space += sizeof e->event;
+		spin_unlock_irqrestore(&dev->event_lock, flags);
+		kfree(e);
+	}
+
+	mutex_unlock(&dev->mode_config.mutex);
+
+	if (!ret && !(args->flags & OMAP_ATOMIC_NONBLOCK))
+		ret = omap_crtc_atomic_wait(crtc);
+
+	return ret;
+
+out:
+	mutex_unlock(&dev->mode_config.mutex);
+	return ret;
+}
+
 struct drm_ioctl_desc ioctls[DRM_COMMAND_END - DRM_COMMAND_BASE] = {
 	DRM_IOCTL_DEF_DRV(OMAP_GET_PARAM, ioctl_get_param, DRM_UNLOCKED|DRM_AUTH),
 	DRM_IOCTL_DEF_DRV(OMAP_SET_PARAM, ioctl_set_param, DRM_UNLOCKED|DRM_AUTH|DRM_MASTER|DRM_ROOT_ONLY),
@@ -538,6 +649,7 @@ struct drm_ioctl_desc ioctls[DRM_COMMAND_END - DRM_COMMAND_BASE] = {
 	DRM_IOCTL_DEF_DRV(OMAP_GEM_CPU_PREP, ioctl_gem_cpu_prep, DRM_UNLOCKED|DRM_AUTH),
 	DRM_IOCTL_DEF_DRV(OMAP_GEM_CPU_FINI, ioctl_gem_cpu_fini, DRM_UNLOCKED|DRM_AUTH),
 	DRM_IOCTL_DEF_DRV(OMAP_GEM_INFO, ioctl_gem_info, DRM_UNLOCKED|DRM_AUTH),
+	DRM_IOCTL_DEF_DRV(OMAP_ATOMIC_FLIP, ioctl_atomic_flip, DRM_UNLOCKED|DRM_AUTH|DRM_MASTER),
 };
 
 /*
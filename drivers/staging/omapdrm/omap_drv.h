@@ -74,6 +74,12 @@ void omap_fbdev_free(struct drm_device *dev);
 
 struct drm_crtc *omap_crtc_init(struct drm_device *dev,
 		struct omap_overlay *ovl, int id);
+struct drm_plane *omap_crtc_plane(struct drm_crtc *crtc);
+int omap_crtc_atomic_flip(struct drm_crtc *crtc, struct drm_plane **planes,
+		struct drm_framebuffer **fbs,
+		struct drm_omap_plane_state *states, int n,
+		struct drm_pending_vblank_event *event);
+int omap_crtc_atomic_wait(struct drm_crtc *crtc);
 
 struct drm_plane *omap_plane_init(struct drm_device *dev,
 		struct omap_overlay *ovl, unsigned int possible_crtcs,
@@ -85,6 +91,14 @@ int omap_plane_mode_set(struct drm_plane *plane,
 		unsigned int crtc_w, unsigned int crtc_h,
 		uint32_t src_x, uint32_t src_y,
 		uint32_t src_w, uint32_t src_h);
+int omap_plane_stage(struct drm_plane *plane,
+		struct drm_crtc *crtc, struct drm_framebuffer *fb,
+		int crtc_x, int crtc_y,
+		unsigned int crtc_w, unsigned int crtc_h,
+		uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h);
+int omap_plane_staged(struct drm_plane *plane);
+struct omap_overlay_manager *omap_plane_get_manager(struct drm_plane *plane);
 void omap_plane_on_endwin(struct drm_plane *plane,
 		void (*fxn)(void *), void *arg);
 
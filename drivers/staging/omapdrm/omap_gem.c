@@ -116,6 +116,18 @@ struct omap_gem_object {
 		uint32_t read_pending;
 		uint32_t read_complete;
 	} *sync;
+
+	/** protects sync and waiters */
+	spinlock_t sync_lock;
+
+	/** omap_gem_sync_waiter's for this object */
+	struct list_head waiters;
+
+	/** node in sync_objs while there are waiters */
+	struct list_head sync_node;
+
+	/** 2d mmap faults, usergart regions prefetched and evictions */
+	uint32_t fault_cnt, prefetch_cnt, evict_cnt;
 };
 
 static int get_pages(struct drm_gem_object *obj, struct page ***pages);
@@ -133,6 +145,21 @@ static uint64_t mmap_offset(struct drm_gem_object *obj);
  * for later..
  */
 #define NUM_USERGART_ENTRIES 2
+#define MAX_USERGART_ENTRIES 32
+
+/* entries per 8, 16 and 32 bit container */
+static int usergart_entries[3] = {
+	NUM_USERGART_ENTRIES, NUM_USERGART_ENTRIES, NUM_USERGART_ENTRIES
+};
+MODULE_PARM_DESC(usergart_entries,
+		"usergart entries for 8,16,32 bit tiled mmaps (default 2,2,2)");
+module_param_array(usergart_entries, int, NULL, 0444);
+
+static bool usergart_prefetch = true;
+MODULE_PARM_DESC(usergart_prefetch,
+		"Map the next slot row of a 2d buffer on fault (default 'y')");
+module_param(usergart_prefetch, bool, 0644);
+
 struct usergart_entry {
 	struct tiler_block *block;	/* the reserved tiler block */
 	dma_addr_t paddr;
@@ -141,7 +168,8 @@ struct usergart_entry {
 					   mapped in */
 };
 static struct {
-	struct usergart_entry entry[NUM_USERGART_ENTRIES];
+	struct usergart_entry *entry;
+	int num_entries;
 	int height;				/* height in rows */
 	int height_shift;		/* ilog2(height in rows) */
 	int slot_shift;			/* ilog2(width per slot) */
@@ -172,6 +200,7 @@ static void evict_entry(struct drm_gem_object *obj,
 		}
 	}
 
+	to_omap_bo(obj)->evict_cnt++;
 	entry->obj = NULL;
 }
 
@@ -187,7 +216,7 @@ static void evict(struct drm_gem_object *obj)
 		if (!usergart)
 			return;
 
-		for (i = 0; i < NUM_USERGART_ENTRIES; i++) {
+		for (i = 0; i < usergart[fmt].num_entries; i++) {
 			struct usergart_entry *entry = &usergart[fmt].entry[i];
 			if (entry->obj == obj)
 				evict_entry(obj, fmt, entry);
@@ -207,8 +236,6 @@ static inline bool is_shmem(struct drm_gem_object *obj)
 	return obj->filp != NULL;
 }
 
-static DEFINE_SPINLOCK(sync_lock);
-
 /** ensure backing pages are allocated */
 static int omap_gem_attach_pages(struct drm_gem_object *obj)
 {
@@ -343,15 +370,32 @@ static int fault_1d(struct drm_gem_object *obj,
 }
 
 /* Special handling for the case of faulting in 2d tiled buffers */
-static int fault_2d(struct drm_gem_object *obj,
-		struct vm_area_struct *vma, struct vm_fault *vmf)
+
+/* is the usergart region starting at obj_pgoff already mapped for obj? */
+static bool usergart_mapped(struct drm_gem_object *obj, enum tiler_fmt fmt,
+		pgoff_t obj_pgoff)
+{
+	int i;
+
+	for (i = 0; i < usergart[fmt].num_entries; i++) {
+		struct usergart_entry *entry = &usergart[fmt].entry[i];
+		if (entry->obj == obj && entry->obj_pgoff == obj_pgoff)
+			return true;
+	}
+
+	return false;
+}
+
+/* map the slot row (or 4kb wide part of it) containing pgoff */
+static int fault_2d_row(struct drm_gem_object *obj,
+		struct vm_area_struct *vma, pgoff_t pgoff, bool prefetch)
 {
 	struct omap_gem_object *omap_obj = to_omap_bo(obj);
 	struct usergart_entry *entry;
 	enum tiler_fmt fmt = gem2fmt(omap_obj->flags);
 	struct page *pages[64];  /* XXX is this too much to have on stack? */
 	unsigned long pfn;
-	pgoff_t pgoff, base_pgoff;
+	pgoff_t base_pgoff, obj_pgoff;
 	void __user *vaddr;
 	int i, ret, slots;
 
@@ -371,10 +415,6 @@ static int fault_2d(struct drm_gem_object *obj,
 	 */
 	const int m = 1 + ((omap_obj->width << fmt) / PAGE_SIZE);
 
-	/* We don't use vmf->pgoff since that has the fake offset: */
-	pgoff = ((unsigned long)vmf->virtual_address -
-			vma->vm_start) >> PAGE_SHIFT;
-
 	/*
 	 * Actual address we start mapping at is rounded down to previous slot
 	 * boundary in the y direction:
@@ -384,7 +424,15 @@ static int fault_2d(struct drm_gem_object *obj,
 	/* figure out buffer width in slots */
 	slots = omap_obj->width >> usergart[fmt].slot_shift;
 
-	vaddr = vmf->virtual_address - ((pgoff - base_pgoff) << PAGE_SHIFT);
+	vaddr = (void __user *)(vma->vm_start + (base_pgoff << PAGE_SHIFT));
+
+	obj_pgoff = base_pgoff;
+	if (m > 1)
+		obj_pgoff += pgoff % m;
+
+	/* a prefetch may already have mapped this region */
+	if (usergart_mapped(obj, fmt, obj_pgoff))
+		return 0;
 
 	entry = &usergart[fmt].entry[usergart[fmt].last];
 
@@ -393,7 +441,7 @@ static int fault_2d(struct drm_gem_object *obj,
 		evict_entry(entry->obj, fmt, entry);
 
 	entry->obj = obj;
-	entry->obj_pgoff = base_pgoff;
+	entry->obj_pgoff = obj_pgoff;
 
 	/* now convert base_pgoff to phys offset from virt offset: */
 	base_pgoff = (base_pgoff >> n_shift) * slots;
@@ -401,7 +449,6 @@ static int fault_2d(struct drm_gem_object *obj,
 	/* for wider-than 4k.. figure out which part of the slot-row we want: */
 	if (m > 1) {
 		int off = pgoff % m;
-		entry->obj_pgoff += off;
 		base_pgoff /= m;
 		slots = min(slots - (off << n_shift), n);
 		base_pgoff += off << n_shift;
@@ -423,13 +470,13 @@ static int fault_2d(struct drm_gem_object *obj,
 	ret = tiler_pin(entry->block, pages, ARRAY_SIZE(pages), 0, true);
 	if (ret) {
 		dev_err(obj->dev->dev, "failed to pin: %d\n", ret);
+		entry->obj = NULL;
 		return ret;
 	}
 
 	pfn = entry->paddr >> PAGE_SHIFT;
 
-	VERB("Inserting %p pfn %lx, pa %lx", vmf->virtual_address,
-			pfn, pfn << PAGE_SHIFT);
+	VERB("Inserting %p pfn %lx, pa %lx", vaddr, pfn, pfn << PAGE_SHIFT);
 
 	for (i = n; i > 0; i--) {
 		vm_insert_mixed(vma, (unsigned long)vaddr, pfn);
@@ -437,8 +484,72 @@ static int fault_2d(struct drm_gem_object *obj,
 		vaddr += PAGE_SIZE * m;
 	}
 
+	if (prefetch)
+		omap_obj->prefetch_cnt++;
+
 	/* simple round-robin: */
-	usergart[fmt].last = (usergart[fmt].last + 1) % NUM_USERGART_ENTRIES;
+	usergart[fmt].last = (usergart[fmt].last + 1) %
+			usergart[fmt].num_entries;
+
+	return 0;
+}
+
+/*
+ * Page offset of the region a linear CPU access reaches after the one
+ * containing pgoff: the next 4kb wide part of the same slot row for
+ * buffers wider than a page, otherwise the next slot row.  Returns -1 past
+ * the end of the buffer.
+ */
+static long next_2d_row(struct omap_gem_object *omap_obj, enum tiler_fmt fmt,
+		pgoff_t pgoff)
+{
+	const int n_shift = usergart[fmt].height_shift;
+	const int m = 1 + ((omap_obj->width << fmt) / PAGE_SIZE);
+	const int slots = omap_obj->width >> usergart[fmt].slot_shift;
+	pgoff_t row = pgoff / (m << n_shift);
+	int off = pgoff % m;
+
+	if (m > 1 && ((off + 1) << n_shift) < slots)
+		return row * (m << n_shift) + off + 1;
+
+	row++;
+	if ((row << n_shift) >= omap_obj->height)
+		return -1;
+
+	return row * (m << n_shift);
+}
+
+static int fault_2d(struct drm_gem_object *obj,
+		struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	struct omap_gem_object *omap_obj = to_omap_bo(obj);
+	enum tiler_fmt fmt = gem2fmt(omap_obj->flags);
+	pgoff_t pgoff;
+	long next;
+	int ret;
+
+	/* We don't use vmf->pgoff since that has the fake offset: */
+	pgoff = ((unsigned long)vmf->virtual_address -
+			vma->vm_start) >> PAGE_SHIFT;
+
+	omap_obj->fault_cnt++;
+
+	ret = fault_2d_row(obj, vma, pgoff, false);
+	if (ret)
+		return ret;
+
+	/*
+	 * Map the region a linear reader or writer touches next as well, so
+	 * that it does not fault again.  This needs a second entry, otherwise
+	 * the prefetch would evict the region just mapped.
+	 */
+	if (!usergart_prefetch || usergart[fmt].num_entries < 2)
+		return 0;
+
+	next = next_2d_row(omap_obj, fmt, pgoff);
+	if (next >= 0 && vma->vm_start + ((next + 1) << PAGE_SHIFT) <=
+			vma->vm_end)
+		fault_2d_row(obj, vma, next, true);
 
 	return 0;
 }
@@ -827,6 +938,9 @@ void omap_gem_describe(struct drm_gem_object *obj, struct seq_file *m)
 					area->p0.x, area->p0.y,
 					area->p1.x, area->p1.y);
 		}
+		seq_printf(m, " faults %u prefetched %u evicted %u",
+				omap_obj->fault_cnt, omap_obj->prefetch_cnt,
+				omap_obj->evict_cnt);
 	} else {
 		seq_printf(m, " %d", obj->size);
 	}
@@ -853,6 +967,13 @@ void omap_gem_describe_objects(struct list_head *list, struct seq_file *m)
 #endif
 
 /* Buffer Synchronization:
+ *
+ * Each object keeps its own list of waiters, protected by the object's
+ * sync_lock, so starting or finishing an op only takes that lock and only
+ * looks at waiters of that object.  Objects with waiters are also on the
+ * sync_objs list, which omap_gem_op_update() walks since the GPU can
+ * update the completion counts behind our back.  Lock order is
+ * sync_objs_lock, then the object's sync_lock.
  */
 
 struct omap_gem_sync_waiter {
@@ -860,17 +981,18 @@ struct omap_gem_sync_waiter {
 	struct omap_gem_object *omap_obj;
 	enum omap_gem_op op;
 	uint32_t read_target, write_target;
-	/* notify called w/ sync_lock held */
+	/* notify called w/ the object's sync_lock held */
 	void (*notify)(void *arg);
 	void *arg;
 };
 
-/* list of omap_gem_sync_waiter.. the notify fxn gets called back when
- * the read and/or write target count is achieved which can call a user
- * callback (ex. to kick 3d and/or 2d), wakeup blocked task (prep for
- * cpu access), etc.
+/* list of objects w/ omap_gem_sync_waiter's.. the notify fxn gets called
+ * back when the read and/or write target count is achieved which can call
+ * a user callback (ex. to kick 3d and/or 2d), wakeup blocked task (prep
+ * for cpu access), etc.
  */
-static LIST_HEAD(waiters);
+static LIST_HEAD(sync_objs);
+static DEFINE_SPINLOCK(sync_objs_lock);
 
 static inline bool is_waiting(struct omap_gem_sync_waiter *waiter)
 {
@@ -892,10 +1014,11 @@ static inline bool is_waiting(struct omap_gem_sync_waiter *waiter)
 	} while (0)
 
 
-static void sync_op_update(void)
+/* call w/ omap_obj->sync_lock held */
+static void sync_op_update(struct omap_gem_object *omap_obj)
 {
 	struct omap_gem_sync_waiter *waiter, *n;
-	list_for_each_entry_safe(waiter, n, &waiters, list) {
+	list_for_each_entry_safe(waiter, n, &omap_obj->waiters, list) {
 		if (!is_waiting(waiter)) {
 			list_del(&waiter->list);
 			SYNC("notify: %p", waiter);
@@ -905,13 +1028,34 @@ static void sync_op_update(void)
 	}
 }
 
+/* queue a waiter on its object, returns false if it need not wait */
+static bool sync_add_waiter(struct omap_gem_sync_waiter *waiter)
+{
+	struct omap_gem_object *omap_obj = waiter->omap_obj;
+	bool waiting;
+
+	spin_lock(&sync_objs_lock);
+	spin_lock(&omap_obj->sync_lock);
+	waiting = is_waiting(waiter);
+	if (waiting) {
+		SYNC("waited: %p", waiter);
+		list_add_tail(&waiter->list, &omap_obj->waiters);
+		if (list_empty(&omap_obj->sync_node))
+			list_add_tail(&omap_obj->sync_node, &sync_objs);
+	}
+	spin_unlock(&omap_obj->sync_lock);
+	spin_unlock(&sync_objs_lock);
+
+	return waiting;
+}
+
 static inline int sync_op(struct drm_gem_object *obj,
 		enum omap_gem_op op, bool start)
 {
 	struct omap_gem_object *omap_obj = to_omap_bo(obj);
 	int ret = 0;
 
-	spin_lock(&sync_lock);
+	spin_lock(&omap_obj->sync_lock);
 
 	if (!omap_obj->sync) {
 		omap_obj->sync = kzalloc(sizeof(*omap_obj->sync), GFP_ATOMIC);
@@ -931,27 +1075,34 @@ static inline int sync_op(struct drm_gem_object *obj,
 			omap_obj->sync->read_complete++;
 		if (op & OMAP_GEM_WRITE)
 			omap_obj->sync->write_complete++;
-		sync_op_update();
+		sync_op_update(omap_obj);
 	}
 
 unlock:
-	spin_unlock(&sync_lock);
+	spin_unlock(&omap_obj->sync_lock);
 
 	return ret;
 }
 
 /* it is a bit lame to handle updates in this sort of polling way, but
  * in case of PVR, the GPU can directly update read/write complete
- * values, and not really tell us which ones it updated.. this also
- * means that sync_lock is not quite sufficient.  So we'll need to
- * do something a bit better when it comes time to add support for
- * separate 2d hw..
+ * values, and not really tell us which ones it updated.. so check every
+ * object that has someone waiting on it, and drop the ones that no
+ * longer do.
  */
 void omap_gem_op_update(void)
 {
-	spin_lock(&sync_lock);
-	sync_op_update();
-	spin_unlock(&sync_lock);
+	struct omap_gem_object *omap_obj, *n;
+
+	spin_lock(&sync_objs_lock);
+	list_for_each_entry_safe(omap_obj, n, &sync_objs, sync_node) {
+		spin_lock(&omap_obj->sync_lock);
+		sync_op_update(omap_obj);
+		if (list_empty(&omap_obj->waiters))
+			list_del_init(&omap_obj->sync_node);
+		spin_unlock(&omap_obj->sync_lock);
+	}
+	spin_unlock(&sync_objs_lock);
 }
 
 /* mark the start of read and/or write operation */
@@ -965,13 +1116,16 @@ int omap_gem_op_finish(struct drm_gem_object *obj, enum omap_gem_op op)
 	return sync_op(obj, op, false);
 }
 
-static DECLARE_WAIT_QUEUE_HEAD(sync_event);
+struct sync_wait {
+	wait_queue_head_t wq;
+	bool done;
+};
 
 static void sync_notify(void *arg)
 {
-	struct task_struct **waiter_task = arg;
-	*waiter_task = NULL;
-	wake_up_all(&sync_event);
+	struct sync_wait *wait = arg;
+	wait->done = true;
+	wake_up(&wait->wq);
 }
 
 int omap_gem_op_sync(struct drm_gem_object *obj, enum omap_gem_op op)
@@ -979,7 +1133,7 @@ int omap_gem_op_sync(struct drm_gem_object *obj, enum omap_gem_op op)
 	struct omap_gem_object *omap_obj = to_omap_bo(obj);
 	int ret = 0;
 	if (omap_obj->sync) {
-		struct task_struct *waiter_task = current;
+		struct sync_wait wait = { .done = false };
 		struct omap_gem_sync_waiter *waiter =
 				kzalloc(sizeof(*waiter), GFP_KERNEL);
 
@@ -987,32 +1141,28 @@ int omap_gem_op_sync(struct drm_gem_object *obj, enum omap_gem_op op)
 			return -ENOMEM;
 		}
 
+		init_waitqueue_head(&wait.wq);
+
 		waiter->omap_obj = omap_obj;
 		waiter->op = op;
 		waiter->read_target = omap_obj->sync->read_pending;
 		waiter->write_target = omap_obj->sync->write_pending;
 		waiter->notify = sync_notify;
-		waiter->arg = &waiter_task;
-
-		spin_lock(&sync_lock);
-		if (is_waiting(waiter)) {
-			SYNC("waited: %p", waiter);
-			list_add_tail(&waiter->list, &waiters);
-			spin_unlock(&sync_lock);
-			ret = wait_event_interruptible(sync_event,
-					(waiter_task == NULL));
-			spin_lock(&sync_lock);
-			if (waiter_task) {
+		waiter->arg = &wait;
+
+		if (sync_add_waiter(waiter)) {
+			ret = wait_event_interruptible(wait.wq, wait.done);
+			spin_lock(&omap_obj->sync_lock);
+			if (!wait.done) {
 				SYNC("interrupted: %p", waiter);
 				/* we were interrupted */
 				list_del(&waiter->list);
-				waiter_task = NULL;
 			} else {
 				/* freed in sync_op_update() */
 				waiter = NULL;
 			}
+			spin_unlock(&omap_obj->sync_lock);
 		}
-		spin_unlock(&sync_lock);
 
 		if (waiter) {
 			kfree(waiter);
@@ -1025,8 +1175,8 @@ int omap_gem_op_sync(struct drm_gem_object *obj, enum omap_gem_op op)
  * is currently blocked..  fxn() can be called from any context
  *
  * (TODO for now fxn is called back from whichever context calls
- * omap_gem_op_update().. but this could be better defined later
- * if needed)
+ * omap_gem_op_finish() or omap_gem_op_update().. but this could be
+ * better defined later if needed)
  *
  * TODO more code in common w/ _sync()..
  */
@@ -1049,15 +1199,10 @@ int omap_gem_op_async(struct drm_gem_object *obj, enum omap_gem_op op,
 		waiter->notify = fxn;
 		waiter->arg = arg;
 
-		spin_lock(&sync_lock);
-		if (is_waiting(waiter)) {
-			SYNC("waited: %p", waiter);
-			list_add_tail(&waiter->list, &waiters);
-			spin_unlock(&sync_lock);
+		if (sync_add_waiter(waiter))
 			return 0;
-		}
 
-		spin_unlock(&sync_lock);
+		kfree(waiter);
 	}
 
 	/* no waiting.. */
@@ -1076,7 +1221,7 @@ int omap_gem_set_sync_object(struct drm_gem_object *obj, void *syncobj)
 	struct omap_gem_object *omap_obj = to_omap_bo(obj);
 	int ret = 0;
 
-	spin_lock(&sync_lock);
+	spin_lock(&omap_obj->sync_lock);
 
 	if ((omap_obj->flags & OMAP_BO_EXT_SYNC) && !syncobj) {
 		/* clearing a previously set syncobj */
@@ -1099,7 +1244,7 @@ int omap_gem_set_sync_object(struct drm_gem_object *obj, void *syncobj)
 	}
 
 unlock:
-	spin_unlock(&sync_lock);
+	spin_unlock(&omap_obj->sync_lock);
 	return ret;
 }
 
@@ -1144,6 +1289,12 @@ void omap_gem_free_object(struct drm_gem_object *obj)
 		}
 	}
 
+	/* nobody should be waiting on an object that is going away */
+	spin_lock(&sync_objs_lock);
+	WARN_ON(!list_empty(&omap_obj->waiters));
+	list_del(&omap_obj->sync_node);
+	spin_unlock(&sync_objs_lock);
+
 	/* don't free externally allocated syncobj */
 	if (!(omap_obj->flags & OMAP_BO_EXT_SYNC)) {
 		kfree(omap_obj->sync);
@@ -1224,6 +1375,10 @@ struct drm_gem_object *omap_gem_new(struct drm_device *dev,
 
 	list_add(&omap_obj->mm_list, &priv->obj_list);
 
+	spin_lock_init(&omap_obj->sync_lock);
+	INIT_LIST_HEAD(&omap_obj->waiters);
+	INIT_LIST_HEAD(&omap_obj->sync_node);
+
 	obj = &omap_obj->base;
 
 	if ((flags & OMAP_BO_SCANOUT) && !priv->has_dmm) {
@@ -1295,7 +1450,16 @@ void omap_gem_init(struct drm_device *dev)
 		usergart[i].height = h;
 		usergart[i].height_shift = ilog2(h);
 		usergart[i].slot_shift = ilog2((PAGE_SIZE / h) >> i);
-		for (j = 0; j < NUM_USERGART_ENTRIES; j++) {
+		usergart[i].num_entries = clamp(usergart_entries[i], 1,
+						MAX_USERGART_ENTRIES);
+		usergart[i].entry = kcalloc(usergart[i].num_entries,
+				sizeof(*usergart[i].entry), GFP_KERNEL);
+		if (!usergart[i].entry) {
+			dev_err(dev->dev, "could not allocate usergart\n");
+			usergart[i].num_entries = 0;
+			return;
+		}
+		for (j = 0; j < usergart[i].num_entries; j++) {
 			struct usergart_entry *entry = &usergart[i].entry[j];
 			struct tiler_block *block =
 					tiler_reserve_2d(fmts[i], w, h,
@@ -1325,5 +1489,10 @@ void omap_gem_deinit(struct drm_device *dev)
 	/* I believe we can rely on there being no more outstanding GEM
 	 * objects which could depend on usergart/dmm at this point.
 	 */
+	if (usergart) {
+		int i;
+		for (i = 0; i < 3; i++)
+			kfree(usergart[i].entry);
+	}
 	kfree(usergart);
 }
@@ -129,8 +129,8 @@ static void install_irq(struct drm_plane *plane)
 	WARN_ON(ret == -EBUSY);
 }
 
-/* push changes down to dss2 */
-static int commit(struct drm_plane *plane)
+/* push overlay info down to dss2, without applying it to the manager */
+static int set_info(struct drm_plane *plane)
 {
 	struct drm_device *dev = plane->dev;
 	struct omap_plane *omap_plane = to_omap_plane(plane);
@@ -159,19 +159,18 @@ static int commit(struct drm_plane *plane)
 	omap_plane->pending_num_unpins = 0;
 	mutex_unlock(&omap_plane->unpin_mutex);
 
-	/* our encoder doesn't necessarily get a commit() after this, in
-	 * particular in the dpms() and mode_set_base() cases, so force the
-	 * manager to update:
-	 *
-	 * could this be in the encoder somehow?
-	 */
-	if (ovl->manager) {
-		ret = ovl->manager->apply(ovl->manager);
-		if (ret) {
-			dev_err(dev->dev, "could not apply settings\n");
-			return ret;
-		}
+	return 0;
+}
 
+/* once the manager is applied: unpin the old fb after scanout, flush */
+static void applied(struct drm_plane *plane)
+{
+	struct drm_device *dev = plane->dev;
+	struct omap_plane *omap_plane = to_omap_plane(plane);
+	struct omap_overlay *ovl = omap_plane->ovl;
+	struct omap_overlay_info *info = &omap_plane->info;
+
+	if (ovl->manager) {
 		/*
 		 * NOTE: really this should be atomic w/ mgr->apply() but
 		 * omapdss does not expose such an API
@@ -189,6 +188,35 @@ static int commit(struct drm_plane *plane)
 		omap_framebuffer_flush(plane->fb, info->pos_x, info->pos_y,
 				info->out_width, info->out_height);
 	}
+}
+
+/* push changes down to dss2 */
+static int commit(struct drm_plane *plane)
+{
+	struct drm_device *dev = plane->dev;
+	struct omap_plane *omap_plane = to_omap_plane(plane);
+	struct omap_overlay *ovl = omap_plane->ovl;
+	int ret;
+
+	ret = set_info(plane);
+	if (ret)
+		return ret;
+
+	/* our encoder doesn't necessarily get a commit() after this, in
+	 * particular in the dpms() and mode_set_base() cases, so force the
+	 * manager to update:
+	 *
+	 * could this be in the encoder somehow?
+	 */
+	if (ovl->manager) {
+		ret = ovl->manager->apply(ovl->manager);
+		if (ret) {
+			dev_err(dev->dev, "could not apply settings\n");
+			return ret;
+		}
+	}
+
+	applied(plane);
 
 	return 0;
 }
@@ -345,6 +373,43 @@ int omap_plane_mode_set(struct drm_plane *plane,
 	return 0;
 }
 
+/*
+ * Like omap_plane_mode_set(), but also pushes the new state down to the
+ * overlay without applying the manager, so that the caller can apply
+ * several planes at once.  omap_plane_staged() must be called after the
+ * manager is applied.
+ */
+int omap_plane_stage(struct drm_plane *plane,
+		struct drm_crtc *crtc, struct drm_framebuffer *fb,
+		int crtc_x, int crtc_y,
+		unsigned int crtc_w, unsigned int crtc_h,
+		uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	omap_plane_mode_set(plane, crtc, fb, crtc_x, crtc_y, crtc_w, crtc_h,
+			src_x, src_y, src_w, src_h);
+	return set_info(plane);
+}
+
+/* finish a staged update, enabling the overlay if it is not yet */
+int omap_plane_staged(struct drm_plane *plane)
+{
+	struct omap_overlay *ovl = to_omap_plane(plane)->ovl;
+
+	applied(plane);
+
+	if (ovl->is_enabled(ovl))
+		return 0;
+
+	return ovl->enable(ovl);
+}
+
+/* manager the plane is currently connected to, if any */
+struct omap_overlay_manager *omap_plane_get_manager(struct drm_plane *plane)
+{
+	return to_omap_plane(plane)->ovl->manager;
+}
+
 static int omap_plane_update(struct drm_plane *plane,
 		struct drm_crtc *crtc, struct drm_framebuffer *fb,
 		int crtc_x, int crtc_y,
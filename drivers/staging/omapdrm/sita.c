@@ -25,6 +25,14 @@
 #include <linux/slab.h>
 #include "tcm.h"
 
+/*
+ * 2D blocks of up to this many slots are small: they are packed from the
+ * top-right corner, while larger ones go from the top-left, so that small
+ * blocks do not break up the space needed for full size frames.  1D blocks
+ * grow from the bottom-right.
+ */
+#define SITA_SMALL_2D_SLOTS	64
+
 static unsigned long mask[8];
 /*
  * pos		position in bitmap
@@ -159,6 +167,55 @@ int l2r_t2b(uint16_t w, uint16_t h, uint16_t a, int16_t offset,
 	return (area_free) ? 0 : -ENOMEM;
 }
 
+/*
+ * w = width in slots
+ * h = height in slots
+ * a = align in slots (0 or 1 is unaligned)
+ * pos = position in bitmap for buffer
+ * map = bitmap ptr
+ * num_bits = size of bitmap
+ * stride = bits in one row of container
+ *
+ * Finds the top-most, then right-most free area.  On a collision the scan
+ * moves left past the left-most occupied slot that was hit, as no position
+ * overlapping it can be free either.
+ */
+static int r2l_t2b(uint16_t w, uint16_t h, uint16_t a, unsigned long *pos,
+		unsigned long *map, size_t num_bits, size_t stride)
+{
+	unsigned long y, i, row, bit;
+	long x, hit;
+
+	a = a ? : 1;
+
+	for (y = 0; (y + h) * stride <= num_bits; y++) {
+		x = rounddown((long)stride - w, a);
+		while (x >= 0) {
+			hit = -1;
+			row = y * stride + x;
+			for (i = 0; i < h; i++, row += stride) {
+				bit = find_next_bit(map, row + w, row);
+				if (bit < row + w &&
+				    (hit < 0 || bit - row + x < hit))
+					hit = bit - row + x;
+			}
+
+			if (hit < 0) {
+				*pos = y * stride + x;
+				for (i = 0; i < h; i++)
+					bitmap_set(map, *pos + i * stride, w);
+				return 0;
+			}
+
+			x = hit - w;
+			if (x >= 0)
+				x = rounddown(x, a);
+		}
+	}
+
+	return -ENOMEM;
+}
+
 static s32 sita_reserve_1d(struct tcm *tcm, u32 num_slots,
 			   struct tcm_area *area)
 {
@@ -186,8 +243,12 @@ static s32 sita_reserve_2d(struct tcm *tcm, u16 h, u16 w, u16 align,
 	int ret;
 
 	spin_lock(&(tcm->lock));
-	ret = l2r_t2b(w, h, align, offset, &pos, slot_bytes, tcm->bitmap,
-			tcm->map_size, tcm->width);
+	if (offset <= 0 && (u32)w * h <= SITA_SMALL_2D_SLOTS)
+		ret = r2l_t2b(w, h, align, &pos, tcm->bitmap, tcm->map_size,
+				tcm->width);
+	else
+		ret = l2r_t2b(w, h, align, offset, &pos, slot_bytes,
+				tcm->bitmap, tcm->map_size, tcm->width);
 
 	if (!ret) {
 		area->p0.x = pos % tcm->width;
@@ -225,6 +286,59 @@ static s32 sita_free(struct tcm *tcm, struct tcm_area *area)
 	return 0;
 }
 
+/*
+ * Count the free slots and find the largest free rectangle, keeping the
+ * height of free slots above each column of the current row and taking
+ * the largest rectangle under that histogram.
+ */
+static s32 sita_stats(struct tcm *tcm, struct tcm_stats *stats)
+{
+	u16 *height, *stack;
+	u32 best = 0;
+	unsigned long x, y, pos;
+
+	height = kcalloc(2 * (tcm->width + 1), sizeof(*height), GFP_KERNEL);
+	if (!height)
+		return -ENOMEM;
+	stack = height + tcm->width + 1;
+
+	stats->free = 0;
+	stats->max_w = stats->max_h = 0;
+
+	spin_lock(&(tcm->lock));
+	for (y = 0, pos = 0; y < tcm->height; y++) {
+		int top = 0;
+
+		for (x = 0; x < tcm->width; x++, pos++) {
+			if (test_bit(pos, tcm->bitmap)) {
+				height[x] = 0;
+			} else {
+				height[x]++;
+				stats->free++;
+			}
+		}
+
+		/* height[width] is a 0 sentinel that empties the stack */
+		for (x = 0; x <= tcm->width; x++) {
+			while (top && height[stack[top - 1]] >= height[x]) {
+				u16 h = height[stack[--top]];
+				u16 w = top ? x - stack[top - 1] - 1 : x;
+
+				if ((u32)w * h > best) {
+					best = (u32)w * h;
+					stats->max_w = w;
+					stats->max_h = h;
+				}
+			}
+			stack[top++] = x;
+		}
+	}
+	spin_unlock(&(tcm->lock));
+
+	kfree(height);
+	return 0;
+}
+
 struct tcm *sita_init(u16 width, u16 height)
 {
 	struct tcm *tcm;
@@ -244,6 +358,7 @@ struct tcm *sita_init(u16 width, u16 height)
 	tcm->reserve_1d = sita_reserve_1d;
 	tcm->free = sita_free;
 	tcm->deinit = sita_deinit;
+	tcm->stats = sita_stats;
 
 	spin_lock_init(&tcm->lock);
 	tcm->bitmap = (unsigned long *)(tcm + 1);
@@ -47,6 +47,12 @@ struct tcm_pt {
 	u16 y;
 };
 
+/* container usage, see tcm_stats() */
+struct tcm_stats {
+	u32 free;		/* free slots */
+	u16 max_w, max_h;	/* largest free rectangle */
+};
+
 /* 1d or 2d area */
 struct tcm_area {
 	bool is2d;		/* whether area is 1d or 2d */
@@ -71,6 +77,7 @@ struct tcm {
 	s32 (*reserve_1d)(struct tcm *tcm, u32 slots, struct tcm_area *area);
 	s32 (*free)(struct tcm *tcm, struct tcm_area *area);
 	void (*deinit)(struct tcm *tcm);
+	s32 (*stats)(struct tcm *tcm, struct tcm_stats *stats);
 };
 
 /*=============================================================================
@@ -178,6 +185,22 @@ static inline s32 tcm_reserve_1d(struct tcm *tcm, u32 slots,
 	return res;
 }
 
+/**
+ * Get the free space and the largest free rectangle of a container, to
+ * tell how fragmented it is.  This scans the whole container, so it is
+ * meant for debugging only.
+ *
+ * @param tcm		Pointer to container manager.
+ * @param stats		Pointer to where the statistics should be stored.
+ *
+ * @return 0 on success.  Non-0 error code on failure.  Some error codes:
+ *	   -ENODEV: invalid manager or not supported.
+ */
+static inline s32 tcm_stats(struct tcm *tcm, struct tcm_stats *stats)
+{
+	return (tcm && tcm->stats) ? tcm->stats(tcm, stats) : -ENODEV;
+}
+
 /**
  * Free a previously reserved area from the container.
  *
@@ -26,6 +26,8 @@
 #include <linux/types.h>
 #include <linux/suspend.h>
 #include <linux/debugfs.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
 
 #include <linux/thermal_framework.h>
 
@@ -58,6 +60,16 @@
 				   ? 125 : 250)
 #define AVERAGE_NUMBER 20
 
+/*
+ * PI cooling defaults. The output is the percentage of cooling asked from
+ * the domain cooling devices; gains are in thousandths of a percent per
+ * degree C (proportional) and per degree C and second (integral).
+ */
+#define OMAP_PI_TARGET_TEMP	(OMAP_ALERT_TEMP - HYSTERESIS_VALUE)
+#define OMAP_PI_KP		2000
+#define OMAP_PI_KI		500
+#define OMAP_PI_MAX_COOLING	100
+
 
 enum governor_instances {
 	OMAP_GOV_CPU_INSTANCE,
@@ -68,16 +80,14 @@ enum governor_instances {
 #define OMAP_THERMAL_ZONE_NAME_SZ	10
 struct omap_thermal_zone {
 	char name[OMAP_THERMAL_ZONE_NAME_SZ];
-	unsigned int cooling_increment;
 	int temp_lower;
 	int temp_upper;
 	int update_rate;
 	int average_rate;
 };
-#define OMAP_THERMAL_ZONE(n, i, l, u, r, a)		\
+#define OMAP_THERMAL_ZONE(n, l, u, r, a)		\
 {							\
 	.name				= n,		\
-	.cooling_increment		= (i),		\
 	.temp_lower			= (l),		\
 	.temp_upper			= (u),		\
 	.update_rate			= (r),		\
@@ -100,6 +110,7 @@ struct omap_governor {
 	int sensor_temp;
 	int absolute_delta;
 	int average_period;
+	bool polling;
 	int avg_gov_sensor_temp;
 	int avg_is_valid;
 	int omap_gradient_slope;
@@ -107,6 +118,11 @@ struct omap_governor {
 	int alert_threshold;
 	int panic_threshold;
 	int prev_zone;
+	int pi_target;
+	u32 pi_kp;
+	u32 pi_ki;
+	int pi_integral;
+	unsigned long pi_last;
 	bool enable_debug_print;
 	int sensor_temp_table[AVERAGE_NUMBER];
 	struct delayed_work average_gov_sensor_work;
@@ -115,19 +131,19 @@ struct omap_governor {
 
 /* Initial set of thersholds for different thermal zones */
 static struct omap_thermal_zone omap_thermal_init_zones[] __initdata = {
-	OMAP_THERMAL_ZONE("safe", 0, OMAP_SAFE_TEMP, OMAP_MONITOR_TEMP,
-			FAST_TEMP_DEFAULT_MONITORING_RATE,
+	OMAP_THERMAL_ZONE("safe", OMAP_SAFE_TEMP, OMAP_MONITOR_TEMP,
+			NORMAL_TEMP_MONITORING_RATE,
 			NORMAL_TEMP_MONITORING_RATE),
-	OMAP_THERMAL_ZONE("monitor", 0,
+	OMAP_THERMAL_ZONE("monitor",
 			OMAP_MONITOR_TEMP - HYSTERESIS_VALUE, OMAP_ALERT_TEMP,
 			FAST_TEMP_DEFAULT_MONITORING_RATE,
 			FAST_TEMP_DEFAULT_MONITORING_RATE),
-	OMAP_THERMAL_ZONE("alert", 0,
+	OMAP_THERMAL_ZONE("alert",
 			OMAP_ALERT_TEMP - HYSTERESIS_VALUE,
 			OMAP_PANIC_DEFAULT_TEMP,
 			FAST_TEMP_DEFAULT_MONITORING_RATE,
 			FAST_TEMP_DEFAULT_MONITORING_RATE),
-	OMAP_THERMAL_ZONE("panic", 1,
+	OMAP_THERMAL_ZONE("panic",
 			OMAP_PANIC_DEFAULT_TEMP - HYSTERESIS_VALUE,
 			OMAP_FATAL_DEFAULT_TEMP,
 			FAST_TEMP_DEFAULT_MONITORING_RATE,
@@ -155,7 +171,9 @@ static struct omap_governor *omap_gov_instance[OMAP_GOV_MAX_INSTANCE];
  * Note: The "offset" is defined in milli-celsius degrees.
  *
  * Next the hot spot temperature is then compared to thresholds to determine
- * the proper zone.
+ * the proper zone.  Zones only decide the sensor thresholds and sampling
+ * rates; the amount of cooling is set by a proportional-integral loop
+ * around a target hot spot temperature (see omap_pi_cooling()).
  *
  * There are 5 zones identified:
  *
@@ -165,16 +183,18 @@ static struct omap_governor *omap_gov_instance[OMAP_GOV_MAX_INSTANCE];
  *
  * PANIC_ZONE: This zone indicates a near fatal temperature is approaching
  * and should impart all neccessary cooling agent to bring the temperature
- * down to an acceptable level.
+ * down to an acceptable level.  The loop output is saturated here.
  *
  * ALERT_ZONE: This zone indicates that die is at a level that may need more
  * agressive cooling agents to keep or lower the temperature.
  *
  * MONITOR_ZONE: This zone is used as a monitoring zone and may or may not use
- * cooling agents to hold the current temperature.
+ * cooling agents to hold the current temperature.  The temperature is
+ * sampled fast enough from here on for the loop to settle at its target.
  *
  * SAFE_ZONE: This zone is optimal thermal zone.  It allows the device to
- * run at max levels without imparting any cooling agent strategies.
+ * run at max levels without imparting any cooling agent strategies.  The
+ * loop integral is cleared.
  *
  * NO_ACTION: Means just that.  There was no action taken based on the current
  * temperature sent in.
@@ -278,27 +298,11 @@ static signed hotspot_temp_to_sensor_temp(struct omap_governor *omap_gov,
 }
 
 static int omap_enter_zone(struct omap_governor *omap_gov,
-				struct omap_thermal_zone *zone,
-				bool set_cooling_level,
-				struct list_head *cooling_list, int cpu_temp)
+				struct omap_thermal_zone *zone, int cpu_temp)
 {
 	int temp_upper;
 	int temp_lower;
 
-	if (list_empty(cooling_list)) {
-		pr_err("%s: No Cooling devices registered\n",
-			__func__);
-		return -ENODEV;
-	}
-
-	if (set_cooling_level) {
-		if (zone->cooling_increment)
-			omap_gov->cooling_level += zone->cooling_increment;
-		else
-			omap_gov->cooling_level = 0;
-		thermal_device_call_all(cooling_list, cool_device,
-						omap_gov->cooling_level);
-	}
 	temp_lower = hotspot_temp_to_sensor_temp(omap_gov, zone->temp_lower);
 	temp_upper = hotspot_temp_to_sensor_temp(omap_gov, zone->temp_upper);
 	thermal_device_call(omap_gov->temp_sensor, set_temp_thresh, temp_lower,
@@ -309,14 +313,86 @@ static int omap_enter_zone(struct omap_governor *omap_gov,
 	omap_gov->hotspot_temp_lower = temp_lower;
 	omap_gov->hotspot_temp_upper = temp_upper;
 
-	/* PCB sensor inputs are required only for CPU domain */
-	if ((!strcmp(omap_gov->thermal_fw.domain_name, "cpu")) &&
-		omap_gov->pcb_sensor_available)
-		omap_gov->average_period = zone->average_rate;
+	/*
+	 * The averaging work also samples the domain for the cooling loop,
+	 * so every domain follows the zone rate, not only the PCB one.
+	 * Far from the trip points the sensor threshold interrupts are
+	 * enough: polling stops in the safe zone and the next t_hot event
+	 * starts it again. The average is dropped meanwhile as it would be
+	 * stale by then.
+	 */
+	omap_gov->average_period = zone->average_rate;
+	if (zone == &omap_gov->omap_thermal_zones[SAFE_ZONE - 1]) {
+		if (omap_gov->polling) {
+			memset(omap_gov->sensor_temp_table, 0,
+				sizeof(omap_gov->sensor_temp_table));
+			omap_gov->avg_is_valid = 0;
+		}
+		omap_gov->polling = false;
+	} else if (!omap_gov->polling) {
+		omap_gov->polling = true;
+		schedule_delayed_work(&omap_gov->average_gov_sensor_work,
+			msecs_to_jiffies(omap_gov->average_period));
+	}
 
 	return 0;
 }
 
+/**
+ * omap_pi_cooling() - Run one step of the cooling loop
+ *
+ * @zone:	The zone the hot spot temperature is in
+ * @cpu_temp:	The current hot spot temperature
+ *
+ * The loop output is the percentage of cooling every cooling device of the
+ * domain is asked for.  Handing all of them the same percentage splits the
+ * power budget in proportion to what each one can give back, so the CPU
+ * and the GPU/IVA agents of a domain are throttled together instead of one
+ * after the other.  The integral is clamped to what it takes to saturate
+ * the output and is not grown while saturated, so it unwinds as soon as
+ * the die is back under target.  The panic zone forces full cooling but
+ * keeps integrating, so the loop takes over again with a fitting level.
+ *
+ * Returns the new cooling level.
+ */
+static int omap_pi_cooling(struct omap_governor *omap_gov, int zone,
+							int cpu_temp)
+{
+	int error = cpu_temp - omap_gov->pi_target;
+	int limit = INT_MAX;
+	unsigned int dt;
+	s64 out;
+
+	dt = jiffies_to_msecs(jiffies - omap_gov->pi_last);
+	omap_gov->pi_last = jiffies;
+	dt = clamp_t(unsigned int, dt, 1, NORMAL_TEMP_MONITORING_RATE);
+
+	if (omap_gov->pi_ki)
+		limit = div_u64((u64)OMAP_PI_MAX_COOLING * 1000000,
+							omap_gov->pi_ki);
+
+	if (zone == SAFE_ZONE) {
+		omap_gov->pi_integral = 0;
+		return 0;
+	}
+
+	out = div_s64((s64)omap_gov->pi_kp * error +
+		(s64)omap_gov->pi_ki * omap_gov->pi_integral, 1000000);
+	if (error < 0 || out < OMAP_PI_MAX_COOLING) {
+		s64 integral = omap_gov->pi_integral +
+					div_s64((s64)error * dt, 1000);
+
+		omap_gov->pi_integral = clamp_t(s64, integral, 0, limit);
+		out = div_s64((s64)omap_gov->pi_kp * error +
+			(s64)omap_gov->pi_ki * omap_gov->pi_integral, 1000000);
+	}
+
+	if (zone == PANIC_ZONE)
+		return OMAP_PI_MAX_COOLING;
+
+	return clamp_t(s64, out, 0, OMAP_PI_MAX_COOLING);
+}
+
 /**
  * omap_fatal_zone() - Shut-down the system to ensure OMAP Junction
  *			temperature decreases enough
@@ -335,8 +411,13 @@ static void omap_fatal_zone(int cpu_temp)
 static int omap_thermal_manager(struct omap_governor *omap_gov,
 				struct list_head *cooling_list, int temp)
 {
-	int cpu_temp, zone = NO_ACTION;
-	bool set_cooling_level = true;
+	int cpu_temp, cooling_level, zone = NO_ACTION;
+
+	if (list_empty(cooling_list)) {
+		pr_err("%s: No Cooling devices registered\n",
+			__func__);
+		return -ENODEV;
+	}
 
 	cpu_temp = convert_omap_sensor_temp_to_hotspot_temp(omap_gov, temp);
 	if (cpu_temp >= OMAP_FATAL_TEMP) {
@@ -357,7 +438,6 @@ static int omap_thermal_manager(struct omap_governor *omap_gov,
 		zone = PANIC_ZONE;
 	} else if (cpu_temp < (omap_gov->panic_threshold - HYSTERESIS_VALUE)) {
 		if (cpu_temp >= omap_gov->alert_threshold) {
-			set_cooling_level = omap_gov->panic_zone_reached == 0;
 			zone = ALERT_ZONE;
 		} else if (cpu_temp < (omap_gov->alert_threshold -
 						HYSTERESIS_VALUE)) {
@@ -387,7 +467,6 @@ static int omap_thermal_manager(struct omap_governor *omap_gov,
 		 * this includes the case where :
 		 * (OMAP_PANIC_TEMP - HYSTERESIS_VALUE) <= T < OMAP_PANIC_TEMP
 		 */
-		set_cooling_level = omap_gov->panic_zone_reached == 0;
 		zone = ALERT_ZONE;
 	}
 
@@ -408,8 +487,14 @@ static int omap_thermal_manager(struct omap_governor *omap_gov,
 			omap_gov->prev_zone = zone;
 		}
 
-		omap_enter_zone(omap_gov, therm_zone,
-				set_cooling_level, cooling_list, cpu_temp);
+		cooling_level = omap_pi_cooling(omap_gov, zone, cpu_temp);
+		if (cooling_level != omap_gov->cooling_level) {
+			omap_gov->cooling_level = cooling_level;
+			thermal_device_call_all(cooling_list, cool_device,
+							cooling_level);
+		}
+
+		omap_enter_zone(omap_gov, therm_zone, cpu_temp);
 	}
 
 	return zone;
@@ -475,8 +560,9 @@ static void average_sensor_delayed_work_fn(struct work_struct *work)
 
 	average_on_die_temperature(omap_gov);
 
-	schedule_delayed_work(&omap_gov->average_gov_sensor_work,
-		msecs_to_jiffies(omap_gov->average_period));
+	if (omap_gov->polling)
+		schedule_delayed_work(&omap_gov->average_gov_sensor_work,
+			msecs_to_jiffies(omap_gov->average_period));
 }
 
 static int omap_process_temp(struct thermal_dev *gov,
@@ -663,6 +749,21 @@ static int omap_gov_register_debug_entries(struct thermal_dev *gov,
 			S_IRUGO | S_IWUSR, d, omap_gov,
 			&omap_die_gov_panic_fops);
 
+	(void) debugfs_create_file("pi_integral",
+			S_IRUGO, d, &(omap_gov->pi_integral),
+			&omap_die_gov_fops);
+
+	/* Cooling loop target and gains */
+	(void) debugfs_create_file("pi_target",
+			S_IRUGO | S_IWUSR, d, &(omap_gov->pi_target),
+			&omap_die_gov_rw_fops);
+	(void) debugfs_create_file("pi_kp",
+			S_IRUGO | S_IWUSR, d, &(omap_gov->pi_kp),
+			&omap_die_gov_rw_fops);
+	(void) debugfs_create_file("pi_ki",
+			S_IRUGO | S_IWUSR, d, &(omap_gov->pi_ki),
+			&omap_die_gov_rw_fops);
+
 	/* Flag to enable the Debug Zone Prints */
 	(void) debugfs_create_file("enable_debug_print",
 			S_IRUGO | S_IWUSR, d, &(omap_gov->enable_debug_print),
@@ -707,6 +808,10 @@ static int __init omap_governor_init(void)
 		omap_gov_instance[i]->enable_debug_print = false;
 		omap_gov_instance[i]->alert_threshold = OMAP_ALERT_TEMP;
 		omap_gov_instance[i]->panic_threshold = OMAP_PANIC_TEMP;
+		omap_gov_instance[i]->pi_target = OMAP_PI_TARGET_TEMP;
+		omap_gov_instance[i]->pi_kp = OMAP_PI_KP;
+		omap_gov_instance[i]->pi_ki = OMAP_PI_KI;
+		omap_gov_instance[i]->pi_last = jiffies;
 
 		INIT_DELAYED_WORK(&omap_gov_instance[i]->
 					average_gov_sensor_work,
@@ -773,16 +878,15 @@ static int __init omap_governor_init(void)
 	for (i = 0; i < OMAP_GOV_MAX_INSTANCE; i++) {
 		t_zone = omap_gov_instance[i]->omap_thermal_zones;
 
-		t_zone[ALERT_ZONE].temp_upper = OMAP_PANIC_TEMP;
-		t_zone[PANIC_ZONE].temp_lower = OMAP_FATAL_TEMP -
+		t_zone[ALERT_ZONE - 1].temp_upper = OMAP_PANIC_TEMP;
+		t_zone[PANIC_ZONE - 1].temp_lower = OMAP_PANIC_TEMP -
 							HYSTERESIS_VALUE;
-		t_zone[PANIC_ZONE].temp_upper = OMAP_FATAL_TEMP;
+		t_zone[PANIC_ZONE - 1].temp_upper = OMAP_FATAL_TEMP;
 
-		for (zone = 0; zone <= MAX_NO_MON_ZONES; zone++) {
+		/* The safe zone keeps the slow rates, polling is off there */
+		for (zone = SAFE_ZONE; zone < MAX_NO_MON_ZONES; zone++) {
 			t_zone[zone].update_rate = FAST_TEMP_MONITORING_RATE;
-			if (zone != SAFE_ZONE)
-				t_zone[zone].average_rate =
-						FAST_TEMP_MONITORING_RATE;
+			t_zone[zone].average_rate = FAST_TEMP_MONITORING_RATE;
 		}
 	}
 
@@ -17,10 +17,13 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/err.h>
 #include <linux/io.h>
+#include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/thermal_framework.h>
@@ -29,10 +32,17 @@
 
 #define MAX_SENSOR_NAME 50
 
+/*
+ * Every TALERT report and every temperature request from the governors
+ * wakes the sensor up; they are counted from stats_start on.
+ */
 struct omap5_thermal_data {
 	struct thermal_dev therm_fw;
 	struct omap_bandgap *bg_ptr;
 	struct work_struct report_temperature_work;
+	u32 irq_reports;
+	u32 polls;
+	unsigned long stats_start;
 };
 
 static void report_temperature_delayed_work_fn(struct work_struct *work)
@@ -74,6 +84,7 @@ static int omap_bandgap_report_temp(struct thermal_dev *tdev)
 	}
 
 	therm_data = container_of(tdev, struct omap5_thermal_data, therm_fw);
+	therm_data->polls++;
 
 	ret = omap_bandgap_read_temperature(therm_data->bg_ptr, tdev->sen_id,
 								&temp);
@@ -201,12 +212,58 @@ int omap_bandgap_report_offset(struct thermal_dev *tdev, const char *rel_name)
 	return therm_data->therm_fw.constant_offset;
 }
 
+#ifdef CONFIG_THERMAL_FRAMEWORK_DEBUG
+static int wakeups_per_hour_get(void *data, u64 *val)
+{
+	struct omap5_thermal_data *therm_data = data;
+	unsigned long elapsed = jiffies - therm_data->stats_start;
+
+	*val = div64_u64((u64)(therm_data->irq_reports + therm_data->polls) *
+			 3600 * HZ, max(elapsed, 1UL));
+
+	return 0;
+}
+
+/* Any write restarts the accounting */
+static int wakeups_per_hour_set(void *data, u64 val)
+{
+	struct omap5_thermal_data *therm_data = data;
+
+	therm_data->irq_reports = 0;
+	therm_data->polls = 0;
+	therm_data->stats_start = jiffies;
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(wakeups_per_hour_fops, wakeups_per_hour_get,
+			wakeups_per_hour_set, "%llu\n");
+
+static int omap_bandgap_register_debug_entries(struct thermal_dev *tdev,
+					       struct dentry *d)
+{
+	struct omap5_thermal_data *therm_data;
+
+	therm_data = container_of(tdev, struct omap5_thermal_data, therm_fw);
+
+	(void) debugfs_create_u32("irq_reports", S_IRUGO, d,
+				  &therm_data->irq_reports);
+	(void) debugfs_create_u32("polls", S_IRUGO, d, &therm_data->polls);
+	(void) debugfs_create_file("wakeups_per_hour", S_IRUGO | S_IWUSR, d,
+				   therm_data, &wakeups_per_hour_fops);
+
+	return 0;
+}
+#endif
+
 static struct thermal_dev_ops omap_sensor_ops = {
 	.report_temp = omap_bandgap_report_temp,
 	.set_temp_thresh = omap_bandgap_set_temp_thresh,
 	.set_temp_report_rate = omap_bandgap_set_measuring_rate,
 	.init_slope = omap_bandgap_report_slope,
-	.init_offset = omap_bandgap_report_offset
+	.init_offset = omap_bandgap_report_offset,
+#ifdef CONFIG_THERMAL_FRAMEWORK_DEBUG
+	.register_debug_entries = omap_bandgap_register_debug_entries,
+#endif
 };
 
 int omap5_thermal_report_temperature(struct omap_bandgap *bg_ptr, int id)
@@ -225,6 +282,7 @@ int omap5_thermal_report_temperature(struct omap_bandgap *bg_ptr, int id)
 		return -EINVAL;
 	}
 
+	therm_data->irq_reports++;
 	schedule_work(&therm_data->report_temperature_work);
 	/*
 	 * TODO: Add support to cancel the scheduled work to
@@ -280,6 +338,7 @@ int omap5_thermal_expose_sensor(struct omap_bandgap *bg_ptr, int id,
 	}
 
 	data->bg_ptr = bg_ptr;
+	data->stats_start = jiffies;
 
 	/* Init deferred work to report temperature */
 	INIT_WORK(&data->report_temperature_work,
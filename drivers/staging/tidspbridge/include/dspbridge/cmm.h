@@ -327,7 +327,7 @@ extern int cmm_xlator_info(struct cmm_xlatorobject *xlator,
  *     Valid address on success, else NULL.
  *  Requires:
  *      paddr != NULL
- *      xtype >= CMM_VA2PA) && (xtype <= CMM_DSPPA2PA)
+ *      xtype >= CMM_VA2PA) && (xtype <= CMM_KVA2VA)
  *  Ensures:
  *
  */
@@ -96,6 +96,8 @@ enum cmm_xlatetype {
 	CMM_VA2DSPPA = 2,	/* Va to DSP Pa */
 	CMM_PA2DSPPA = 3,	/* GPP Pa to DSP Pa */
 	CMM_DSPPA2PA = 4,	/* DSP Pa to GPP Pa */
+	CMM_VA2KVA = 5,		/* Va to kernel Va of the SM segment */
+	CMM_KVA2VA = 6,		/* Kernel Va of the SM segment to Va */
 };
 
 struct cmm_object;
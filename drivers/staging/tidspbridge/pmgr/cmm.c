@@ -869,6 +869,27 @@ void *cmm_xlator_translate(struct cmm_xlatorobject *xlator, void *paddr,
 	if (!allocator)
 		goto loop_cont;
 
+	if (xtype == CMM_VA2KVA) {
+		/* Kernel Va = VM base + offset of the Gpp Pa in the segment */
+		dw_addr_xlate = (u32) cmm_xlator_translate(xlator, paddr,
+							   CMM_VA2PA);
+		if (dw_addr_xlate < allocator->shm_base ||
+		    dw_addr_xlate >= allocator->shm_base + allocator->sm_size)
+			dw_addr_xlate = 0;	/* not an SM buffer */
+		else
+			dw_addr_xlate = allocator->vm_base +
+			    dw_addr_xlate - allocator->shm_base;
+		goto loop_cont;
+	} else if (xtype == CMM_KVA2VA) {
+		dw_offset = (u8 *) paddr - (u8 *) allocator->vm_base;
+		if (dw_offset >= allocator->sm_size)
+			goto loop_cont;
+		dw_addr_xlate = (u32) cmm_xlator_translate(xlator,
+				(void *)(allocator->shm_base + dw_offset),
+				CMM_PA2VA);
+		goto loop_cont;
+	}
+
 	if ((xtype == CMM_VA2DSPPA) || (xtype == CMM_VA2PA) ||
 	    (xtype == CMM_PA2VA)) {
 		if (xtype == CMM_PA2VA) {
@@ -17,6 +17,8 @@
  */
 
 #include <linux/types.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 /*  ----------------------------------- Host OS */
 #include <dspbridge/host_os.h>
@@ -55,6 +57,7 @@ struct strm_mgr {
 	struct chnl_mgr *chnl_mgr;	/* Channel manager */
 	/* Function interface to Bridge driver */
 	struct bridge_drv_interface *intf_fxns;
+	struct dentry *debugfs;	/* Per-stream throughput counters */
 };
 
 /*
@@ -79,10 +82,24 @@ struct strm_object {
 	u32 buf_alignment;	/* Alignment for stream bufs */
 	/* Stream's SM address translator */
 	struct cmm_xlatorobject *xlator;
+	/* Throughput counters, protected by stats_lock */
+	struct list_head link;	/* Entry in strm_list */
+	spinlock_t stats_lock;
+	u32 bufs_issued;
+	u32 bufs_direct;	/* SM bufs issued without a bounce buffer */
+	u32 bufs_reclaimed;
+	u64 bytes_reclaimed;
+	unsigned long first_issue;	/* jiffies */
+	unsigned long last_reclaim;	/* jiffies */
 };
 
+/* All open streams, for debugfs */
+static LIST_HEAD(strm_list);
+static DEFINE_MUTEX(strm_list_lock);
+
 /*  ----------------------------------- Function Prototypes */
 static int delete_strm(struct strm_object *stream_obj);
+static const struct file_operations strm_debugfs_fops;
 
 /*
  *  ======== strm_allocate_buffer ========
@@ -200,10 +217,14 @@ int strm_create(struct strm_mgr **strm_man,
 		}
 	}
 
-	if (!status)
+	if (!status) {
+		strm_mgr_obj->debugfs = debugfs_create_file("dsp_streams",
+						S_IRUGO, NULL, strm_mgr_obj,
+						&strm_debugfs_fops);
 		*strm_man = strm_mgr_obj;
-	else
+	} else {
 		kfree(strm_mgr_obj);
+	}
 
 	return status;
 }
@@ -215,6 +236,8 @@ int strm_create(struct strm_mgr **strm_man,
  */
 void strm_delete(struct strm_mgr *strm_mgr_obj)
 {
+	if (strm_mgr_obj)
+		debugfs_remove(strm_mgr_obj->debugfs);
 	kfree(strm_mgr_obj);
 }
 
@@ -336,6 +359,29 @@ int strm_idle(struct strm_object *stream_obj, bool flush_data)
 	return status;
 }
 
+/*
+ *  ======== strm_sm_kbuf ========
+ *  Purpose:
+ *      Kernel address of a buffer allocated from the stream's SM segment.
+ *      That memory is already mapped into the DSP MMU and into the kernel,
+ *      so the channel moves data between it and the SM channel buffer
+ *      directly instead of bouncing it through a kmalloc'd copy of the
+ *      user buffer.
+ */
+static u8 *strm_sm_kbuf(struct strm_object *stream_obj, u8 *pbuf,
+			u32 ul_buf_size)
+{
+	u8 *kbuf, *kend;
+
+	kbuf = cmm_xlator_translate(stream_obj->xlator, pbuf, CMM_VA2KVA);
+	kend = cmm_xlator_translate(stream_obj->xlator,
+				    pbuf + ul_buf_size - 1, CMM_VA2KVA);
+	if (!kbuf || kend != kbuf + ul_buf_size - 1)
+		return NULL;
+
+	return kbuf;
+}
+
 /*
  *  ======== strm_issue ========
  *  Purpose:
@@ -347,6 +393,7 @@ int strm_issue(struct strm_object *stream_obj, u8 *pbuf, u32 ul_bytes,
 	struct bridge_drv_interface *intf_fxns;
 	int status = 0;
 	void *tmp_buf = NULL;
+	u8 *kbuf = NULL;
 
 	if (!stream_obj) {
 		status = -EFAULT;
@@ -361,15 +408,27 @@ int strm_issue(struct strm_object *stream_obj, u8 *pbuf, u32 ul_bytes,
 				status = -ESRCH;
 
 		}
+		if (!status && stream_obj->segment_id != 0 &&
+		    stream_obj->strm_mode == STRMMODE_PROCCOPY && ul_buf_size)
+			kbuf = strm_sm_kbuf(stream_obj, pbuf, ul_buf_size);
 		if (!status) {
 			status = (*intf_fxns->chnl_add_io_req)
-			    (stream_obj->chnl_obj, pbuf, ul_bytes, ul_buf_size,
-			     (u32) tmp_buf, dw_arg);
+			    (stream_obj->chnl_obj, kbuf ? kbuf : pbuf,
+			     ul_bytes, ul_buf_size, (u32) tmp_buf, dw_arg);
 		}
 		if (status == -EIO)
 			status = -ENOSR;
 	}
 
+	if (!status) {
+		spin_lock(&stream_obj->stats_lock);
+		if (!stream_obj->bufs_issued++)
+			stream_obj->first_issue = jiffies;
+		if (kbuf)
+			stream_obj->bufs_direct++;
+		spin_unlock(&stream_obj->stats_lock);
+	}
+
 	dev_dbg(bridge, "%s: stream_obj: %p pbuf: %p ul_bytes: 0x%x dw_arg:"
 		" 0x%x status: 0x%x\n", __func__, stream_obj, pbuf,
 		ul_bytes, dw_arg, status);
@@ -414,6 +473,8 @@ int strm_open(struct node_object *hnode, u32 dir, u32 index,
 			status = -ENOMEM;
 		} else {
 			strm_obj->strm_mgr_obj = strm_mgr_obj;
+			INIT_LIST_HEAD(&strm_obj->link);
+			spin_lock_init(&strm_obj->stats_lock);
 			strm_obj->dir = dir;
 			strm_obj->strm_state = STREAM_IDLE;
 			strm_obj->user_event = pattr->user_event;
@@ -504,10 +565,14 @@ func_cont:
 	if (!status) {
 		status = drv_proc_insert_strm_res_element(strm_obj,
 							&stream_res, pr_ctxt);
-		if (status)
+		if (status) {
 			delete_strm(strm_obj);
-		else
+		} else {
 			*strmres = (struct strm_res_object *)stream_res;
+			mutex_lock(&strm_list_lock);
+			list_add_tail(&strm_obj->link, &strm_list);
+			mutex_unlock(&strm_list_lock);
+		}
 	} else {
 		(void)delete_strm(strm_obj);
 	}
@@ -583,7 +648,25 @@ int strm_reclaim(struct strm_object *stream_obj, u8 ** buf_ptr,
 
 			chnl_ioc_obj.buf = tmp_buf;
 		}
+		/* Hand SM buffers issued by kernel address back to the user */
+		if (stream_obj->segment_id != 0 &&
+		    stream_obj->strm_mode == STRMMODE_PROCCOPY &&
+		    chnl_ioc_obj.buf >= (void *)PAGE_OFFSET) {
+			tmp_buf = cmm_xlator_translate(stream_obj->xlator,
+						       chnl_ioc_obj.buf,
+						       CMM_KVA2VA);
+			if (tmp_buf != NULL)
+				chnl_ioc_obj.buf = tmp_buf;
+		}
 		*buf_ptr = chnl_ioc_obj.buf;
+
+		if (!status) {
+			spin_lock(&stream_obj->stats_lock);
+			stream_obj->bufs_reclaimed++;
+			stream_obj->bytes_reclaimed += *nbytes;
+			stream_obj->last_reclaim = jiffies;
+			spin_unlock(&stream_obj->stats_lock);
+		}
 	}
 func_end:
 	dev_dbg(bridge, "%s: stream_obj: %p buf_ptr: %p nbytes: %p "
@@ -716,6 +799,9 @@ static int delete_strm(struct strm_object *stream_obj)
 	int status = 0;
 
 	if (stream_obj) {
+		mutex_lock(&strm_list_lock);
+		list_del(&stream_obj->link);
+		mutex_unlock(&strm_list_lock);
 		if (stream_obj->chnl_obj) {
 			intf_fxns = stream_obj->strm_mgr_obj->intf_fxns;
 			/* Channel close can fail only if the channel handle
@@ -731,3 +817,57 @@ static int delete_strm(struct strm_object *stream_obj)
 	}
 	return status;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int strm_debugfs_show(struct seq_file *s, void *unused)
+{
+	struct strm_mgr *strm_mgr_obj = s->private;
+	struct strm_object *stream_obj;
+	struct chnl_info chnl_info_obj;
+	u32 issued, direct, reclaimed;
+	unsigned long elapsed;
+	u64 bytes, rate;
+
+	seq_printf(s, "%4s %4s %10s %10s %10s %12s %10s\n", "chnl", "dir",
+		   "issued", "direct", "reclaimed", "bytes", "KiB/s");
+
+	mutex_lock(&strm_list_lock);
+	list_for_each_entry(stream_obj, &strm_list, link) {
+		if (stream_obj->strm_mgr_obj != strm_mgr_obj)
+			continue;
+		if ((*strm_mgr_obj->intf_fxns->chnl_get_info)
+				(stream_obj->chnl_obj, &chnl_info_obj))
+			continue;
+
+		spin_lock(&stream_obj->stats_lock);
+		issued = stream_obj->bufs_issued;
+		direct = stream_obj->bufs_direct;
+		reclaimed = stream_obj->bufs_reclaimed;
+		bytes = stream_obj->bytes_reclaimed;
+		elapsed = stream_obj->last_reclaim - stream_obj->first_issue;
+		spin_unlock(&stream_obj->stats_lock);
+
+		rate = elapsed ? div_u64(bytes * HZ, elapsed) >> 10 : 0;
+
+		seq_printf(s, "%4u %4s %10u %10u %10u %12llu %10llu\n",
+			   chnl_info_obj.cnhl_id,
+			   stream_obj->dir == DSP_TONODE ? "out" : "in",
+			   issued, direct, reclaimed, bytes, rate);
+	}
+	mutex_unlock(&strm_list_lock);
+
+	return 0;
+}
+
+static int strm_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, strm_debugfs_show, inode->i_private);
+}
+
+static const struct file_operations strm_debugfs_fops = {
+	.open		= strm_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
@@ -31,6 +31,7 @@
 #include <linux/math64.h>
 #include <linux/crypto.h>
 #include <linux/string.h>
+#include <linux/jhash.h>
 #include "tmem.h"
 
 #include "../zsmalloc/zsmalloc.h"
@@ -60,8 +61,19 @@
 
 MODULE_LICENSE("GPL");
 
+/* per-pool counters, cleared when the pool id is handed out again */
+struct zcache_pool_stats {
+	unsigned long puts;
+	unsigned long rejected;	/* puts turned into flushes by policy */
+	unsigned long gets;
+	unsigned long hits;
+	unsigned long flushes;	/* pages found by a flush */
+	unsigned long evicted;	/* pages dropped by the shrinker */
+};
+
 struct zcache_client {
 	struct tmem_pool *tmem_pools[MAX_POOLS_PER_CLIENT];
+	struct zcache_pool_stats stats[MAX_POOLS_PER_CLIENT];
 	struct zs_pool *zspool;
 	bool allocated;
 	atomic_t refcount;
@@ -83,6 +95,14 @@ static inline bool is_local_client(struct zcache_client *cli)
 	return cli == &zcache_host;
 }
 
+static inline struct zcache_pool_stats *zcache_pool_stats(
+						struct tmem_pool *pool)
+{
+	struct zcache_client *cli = pool->client;
+
+	return &cli->stats[pool->pool_id];
+}
+
 /* crypto API for zcache  */
 #define ZCACHE_COMP_NAME_SZ CRYPTO_MAX_ALG_NAME
 static char zcache_comp_name[ZCACHE_COMP_NAME_SZ];
@@ -511,6 +531,7 @@ static void zbud_evict_zbpg(struct zbud_page *zbpg)
 		pool = zcache_get_pool_by_id(client_id[i], pool_id[i]);
 		if (pool != NULL) {
 			tmem_flush_page(pool, &oid[i], index[i]);
+			zcache_pool_stats(pool)->evicted++;
 			zcache_put_pool(pool);
 		}
 	}
@@ -1413,6 +1434,96 @@ static struct notifier_block zcache_cpu_notifier_block = {
 	.notifier_call = zcache_cpu_notifier
 };
 
+/*
+ * Put policy.  Cleancache and frontswap puts can be switched off separately
+ * at runtime; gets and flushes keep working so nothing stored goes stale.
+ *
+ * A clean page is put when it leaves the page cache and can only be put
+ * again after it was read back in, so a second put of the same page within
+ * a short while means it is being reused.  The ghost table keeps a hash of
+ * the recently put pages to tell.  Updates are not locked, a lost one only
+ * costs a single wrong decision.
+ *
+ * zcache_admission is 0 to compress every cleancache put, 1 to take only
+ * reused pages, 2 (default) to filter only while fewer than
+ * zcache_admit_reuse_percent of the puts in the last window were reuses.
+ */
+#define ZCACHE_GHOST_BITS	12
+#define ZCACHE_ADMIT_WINDOW	1024
+
+enum {
+	ZCACHE_ADMIT_ALL,
+	ZCACHE_ADMIT_REUSED,
+	ZCACHE_ADMIT_ADAPTIVE,
+};
+
+static unsigned int zcache_cleancache_enabled = 1;
+static unsigned int zcache_frontswap_enabled = 1;
+static unsigned int zcache_admission = ZCACHE_ADMIT_ADAPTIVE;
+static unsigned int zcache_admit_reuse_percent = 10;
+
+static u32 zcache_ghost[1 << ZCACHE_GHOST_BITS];
+static bool zcache_admit_filtering;
+static unsigned long zcache_admit_window_puts;
+static unsigned long zcache_admit_window_reused;
+static unsigned long zcache_ghost_hits;
+
+static bool zcache_ghost_check(struct tmem_pool *pool, struct tmem_oid *oidp,
+				uint32_t index)
+{
+	u32 h = jhash2((u32 *)oidp, sizeof(*oidp) / sizeof(u32),
+			index ^ (pool->pool_id << 24)) | 1;
+	u32 *slot = &zcache_ghost[h >> (32 - ZCACHE_GHOST_BITS)];
+
+	if (*slot == h)
+		return true;
+	*slot = h;
+	return false;
+}
+
+static bool zcache_admit(struct tmem_pool *pool, struct tmem_oid *oidp,
+				uint32_t index)
+{
+	bool reused = zcache_ghost_check(pool, oidp, index);
+
+	if (reused) {
+		zcache_ghost_hits++;
+		zcache_admit_window_reused++;
+	}
+	if (++zcache_admit_window_puts >= ZCACHE_ADMIT_WINDOW) {
+		zcache_admit_filtering = zcache_admit_window_reused * 100 <
+			zcache_admit_window_puts * zcache_admit_reuse_percent;
+		zcache_admit_window_puts = 0;
+		zcache_admit_window_reused = 0;
+	}
+
+	switch (zcache_admission) {
+	case ZCACHE_ADMIT_ALL:
+		return true;
+	case ZCACHE_ADMIT_REUSED:
+		return reused;
+	default:
+		return reused || !zcache_admit_filtering;
+	}
+}
+
+static bool zcache_put_admitted(struct tmem_pool *pool,
+				struct tmem_oid *oidp, uint32_t index)
+{
+	struct zcache_pool_stats *stats = zcache_pool_stats(pool);
+	bool ret;
+
+	stats->puts++;
+	if (is_ephemeral(pool))
+		ret = zcache_cleancache_enabled &&
+		      zcache_admit(pool, oidp, index);
+	else
+		ret = zcache_frontswap_enabled;
+	if (!ret)
+		stats->rejected++;
+	return ret;
+}
+
 #ifdef CONFIG_SYSFS
 #define ZCACHE_SYSFS_RO(_name) \
 	static ssize_t zcache_##_name##_show(struct kobject *kobj, \
@@ -1447,6 +1558,55 @@ static struct notifier_block zcache_cpu_notifier_block = {
 		.show = zcache_##_name##_show, \
 	}
 
+/* unsigned int tunables, 0 to _max */
+#define ZCACHE_SYSFS_RW(_name, _max) \
+	static ssize_t zcache_##_name##_show(struct kobject *kobj, \
+				struct kobj_attribute *attr, char *buf) \
+	{ \
+		return sprintf(buf, "%u\n", zcache_##_name); \
+	} \
+	static ssize_t zcache_##_name##_store(struct kobject *kobj, \
+				struct kobj_attribute *attr, \
+				const char *buf, size_t count) \
+	{ \
+		unsigned long val; \
+		int err; \
+		if (!capable(CAP_SYS_ADMIN)) \
+			return -EPERM; \
+		err = kstrtoul(buf, 10, &val); \
+		if (err || val > (_max)) \
+			return -EINVAL; \
+		zcache_##_name = val; \
+		return count; \
+	} \
+	static struct kobj_attribute zcache_##_name##_attr = { \
+		.attr = { .name = __stringify(_name), .mode = 0644 }, \
+		.show = zcache_##_name##_show, \
+		.store = zcache_##_name##_store, \
+	}
+
+static int pool_stats_show(char *buf)
+{
+	struct tmem_pool *pool;
+	struct zcache_pool_stats *st;
+	char *p = buf;
+	int i;
+
+	p += sprintf(p, "pool type puts rejected gets hits flushes evicted\n");
+	for (i = 0; i < MAX_POOLS_PER_CLIENT; i++) {
+		pool = zcache_get_pool_by_id(LOCAL_CLIENT, i);
+		if (pool == NULL)
+			continue;
+		st = zcache_pool_stats(pool);
+		p += sprintf(p, "%d %s %lu %lu %lu %lu %lu %lu\n", i,
+			is_ephemeral(pool) ? "eph" : "pers", st->puts,
+			st->rejected, st->gets, st->hits, st->flushes,
+			st->evicted);
+		zcache_put_pool(pool);
+	}
+	return p - buf;
+}
+
 ZCACHE_SYSFS_RO(curr_obj_count_max);
 ZCACHE_SYSFS_RO(curr_objnode_count_max);
 ZCACHE_SYSFS_RO(flush_total);
@@ -1468,6 +1628,11 @@ ZCACHE_SYSFS_RO(failed_alloc);
 ZCACHE_SYSFS_RO(put_to_flush);
 ZCACHE_SYSFS_RO(compress_poor);
 ZCACHE_SYSFS_RO(mean_compress_poor);
+ZCACHE_SYSFS_RO(ghost_hits);
+ZCACHE_SYSFS_RW(cleancache_enabled, 1);
+ZCACHE_SYSFS_RW(frontswap_enabled, 1);
+ZCACHE_SYSFS_RW(admission, ZCACHE_ADMIT_ADAPTIVE);
+ZCACHE_SYSFS_RW(admit_reuse_percent, 100);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_raw_pages);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_zpages);
 ZCACHE_SYSFS_RO_ATOMIC(curr_obj_count);
@@ -1480,6 +1645,7 @@ ZCACHE_SYSFS_RO_CUSTOM(zv_curr_dist_counts,
 			zv_curr_dist_counts_show);
 ZCACHE_SYSFS_RO_CUSTOM(zv_cumul_dist_counts,
 			zv_cumul_dist_counts_show);
+ZCACHE_SYSFS_RO_CUSTOM(pool_stats, pool_stats_show);
 
 static struct attribute *zcache_attrs[] = {
 	&zcache_curr_obj_count_attr.attr,
@@ -1514,6 +1680,12 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_zv_max_zsize_attr.attr,
 	&zcache_zv_max_mean_zsize_attr.attr,
 	&zcache_zv_page_count_policy_percent_attr.attr,
+	&zcache_pool_stats_attr.attr,
+	&zcache_ghost_hits_attr.attr,
+	&zcache_cleancache_enabled_attr.attr,
+	&zcache_frontswap_enabled_attr.attr,
+	&zcache_admission_attr.attr,
+	&zcache_admit_reuse_percent_attr.attr,
 	NULL,
 };
 
@@ -1572,7 +1744,8 @@ static int zcache_put_page(int cli_id, int pool_id, struct tmem_oid *oidp,
 	pool = zcache_get_pool_by_id(cli_id, pool_id);
 	if (unlikely(pool == NULL))
 		goto out;
-	if (!zcache_freeze && zcache_do_preload(pool) == 0) {
+	if (!zcache_freeze && zcache_put_admitted(pool, oidp, index) &&
+	    zcache_do_preload(pool) == 0) {
 		/* preload does preempt_disable on success */
 		ret = tmem_put(pool, oidp, index, (char *)(page),
 				PAGE_SIZE, 0, is_ephemeral(pool));
@@ -1606,9 +1779,14 @@ static int zcache_get_page(int cli_id, int pool_id, struct tmem_oid *oidp,
 	local_irq_save(flags);
 	pool = zcache_get_pool_by_id(cli_id, pool_id);
 	if (likely(pool != NULL)) {
+		struct zcache_pool_stats *stats = zcache_pool_stats(pool);
+
 		if (atomic_read(&pool->obj_count) > 0)
 			ret = tmem_get(pool, oidp, index, (char *)(page),
 					&size, 0, is_ephemeral(pool));
+		stats->gets++;
+		if (ret >= 0)
+			stats->hits++;
 		zcache_put_pool(pool);
 	}
 	local_irq_restore(flags);
@@ -1628,6 +1806,8 @@ static int zcache_flush_page(int cli_id, int pool_id,
 	if (likely(pool != NULL)) {
 		if (atomic_read(&pool->obj_count) > 0)
 			ret = tmem_flush_page(pool, oidp, index);
+		if (ret >= 0)
+			zcache_pool_stats(pool)->flushes++;
 		zcache_put_pool(pool);
 	}
 	if (ret >= 0)
@@ -1721,6 +1901,7 @@ static int zcache_new_pool(uint16_t cli_id, uint32_t flags)
 	atomic_set(&pool->refcount, 0);
 	pool->client = cli;
 	pool->pool_id = poolid;
+	memset(&cli->stats[poolid], 0, sizeof(cli->stats[poolid]));
 	tmem_new_pool(pool, flags);
 	cli->tmem_pools[poolid] = pool;
 	pr_info("zcache: created %s tmem pool, id=%d, client=%d\n",
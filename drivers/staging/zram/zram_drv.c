@@ -30,6 +30,7 @@
 #include <linux/highmem.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
+#include <linux/percpu.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 
@@ -42,14 +43,37 @@ struct zram *zram_devices;
 /* Module params (documentation at end) */
 static unsigned int num_devices;
 
-static void zram_stat_inc(u32 *v)
+static const struct zram_backend zram_lzo = {
+	.name = "lzo",
+	.workmem_size = LZO1X_MEM_COMPRESS,
+	.compress = lzo1x_1_compress,
+	.decompress = lzo1x_decompress_safe,
+};
+
+static const struct zram_backend zram_same = {
+	.name = "same",
+};
+
+/* The first one is the default */
+const struct zram_backend *zram_backends[] = {
+	&zram_lzo,
+	&zram_same,
+	NULL,
+};
+
+/* Writers to different slots run concurrently, so these need the lock too */
+static void zram_stat_inc(struct zram *zram, u32 *v)
 {
+	spin_lock(&zram->stat64_lock);
 	*v = *v + 1;
+	spin_unlock(&zram->stat64_lock);
 }
 
-static void zram_stat_dec(u32 *v)
+static void zram_stat_dec(struct zram *zram, u32 *v)
 {
+	spin_lock(&zram->stat64_lock);
 	*v = *v - 1;
+	spin_unlock(&zram->stat64_lock);
 }
 
 static void zram_stat64_add(struct zram *zram, u64 *v, u64 inc)
@@ -89,21 +113,164 @@ static void zram_clear_flag(struct zram *zram, u32 index,
 	zram->table[index].flags &= ~BIT(flag);
 }
 
-static int page_zero_filled(void *ptr)
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != page[0])
 			return 0;
 	}
 
+	*element = page[0];
 	return 1;
 }
 
+/* I/O is sector aligned, so the fill pattern stays word aligned */
+static void fill_same(void *ptr, unsigned long element, unsigned int len)
+{
+	unsigned long *p = ptr;
+	unsigned int i;
+
+	for (i = 0; i < len / sizeof(*p); i++)
+		p[i] = element;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static inline bool zram_has_bd(struct zram *zram)
+{
+	return zram->bdev != NULL;
+}
+
+static void zram_bd_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+/* Synchronous one page I/O on the backing device */
+static int zram_bd_rw(struct zram *zram, struct page *page, unsigned long blk,
+		      int rw)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_bdev = zram->bdev;
+	bio->bi_end_io = zram_bd_end_io;
+	bio->bi_private = &done;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	submit_bio(rw | REQ_SYNC, bio);
+	wait_for_completion(&done);
+
+	ret = test_bit(BIO_UPTODATE, &bio->bi_flags) ? 0 : -EIO;
+	bio_put(bio);
+
+	if (rw == READ)
+		zram_stat64_inc(zram, &zram->stats.bd_reads);
+	else
+		zram_stat64_inc(zram, &zram->stats.bd_writes);
+
+	return ret;
+}
+
+static int zram_bd_write_page(struct zram *zram, struct page *page,
+			      unsigned long *blk)
+{
+	unsigned long b;
+	int ret;
+
+	do {
+		b = find_next_zero_bit(zram->bd_bitmap, zram->bd_pages, 1);
+		if (b >= zram->bd_pages)
+			return -ENOSPC;
+	} while (test_and_set_bit(b, zram->bd_bitmap));
+
+	ret = zram_bd_rw(zram, page, b, WRITE);
+	if (ret) {
+		clear_bit(b, zram->bd_bitmap);
+		return ret;
+	}
+
+	*blk = b;
+	return 0;
+}
+
+/* Read a written back page into @mem, which need not be page backed */
+static int zram_bd_read(struct zram *zram, unsigned long blk, void *mem,
+			int offset, int len)
+{
+	struct page *page;
+	void *src;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bd_rw(zram, page, blk, READ);
+	if (!ret) {
+		src = kmap_atomic(page);
+		memcpy(mem, src + offset, len);
+		kunmap_atomic(src);
+	}
+	__free_page(page);
+
+	return ret;
+}
+
+static void zram_bd_free(struct zram *zram, unsigned long blk)
+{
+	clear_bit(blk, zram->bd_bitmap);
+	zram_stat_dec(zram, &zram->stats.pages_wb);
+}
+
+/* Point an empty slot at the block its page was written to */
+static void zram_bd_set_slot(struct zram *zram, u32 index, unsigned long blk)
+{
+	zram_set_flag(zram, index, ZRAM_WB);
+	zram->table[index].element = blk;
+	zram_stat_inc(zram, &zram->stats.pages_wb);
+}
+#else
+static inline bool zram_has_bd(struct zram *zram)
+{
+	return false;
+}
+
+static inline int zram_bd_write_page(struct zram *zram, struct page *page,
+				     unsigned long *blk)
+{
+	return -ENODEV;
+}
+
+static inline int zram_bd_read(struct zram *zram, unsigned long blk,
+			       void *mem, int offset, int len)
+{
+	return -ENODEV;
+}
+
+static inline void zram_bd_free(struct zram *zram, unsigned long blk)
+{
+}
+
+static inline void zram_bd_set_slot(struct zram *zram, u32 index,
+				    unsigned long blk)
+{
+}
+#endif
+
 static void zram_set_disksize(struct zram *zram, size_t totalram_bytes)
 {
 	if (!zram->disksize) {
@@ -137,46 +304,57 @@ static void zram_free_page(struct zram *zram, size_t index)
 {
 	void *handle = zram->table[index].handle;
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(zram, index, ZRAM_ZERO)) {
-			zram_clear_flag(zram, index, ZRAM_ZERO);
-			zram_stat_dec(&zram->stats.pages_zero);
-		}
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_clear_flag(zram, index, ZRAM_WB);
+		zram_bd_free(zram, zram->table[index].element);
+		zram->table[index].element = 0;
+		return;
+	}
+
+	/*
+	 * No memory is allocated for same filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_clear_flag(zram, index, ZRAM_SAME);
+		zram_stat_dec(zram, &zram->stats.pages_same);
+		zram->table[index].element = 0;
 		return;
 	}
 
+	if (unlikely(!handle))
+		return;
+
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
 		__free_page(handle);
 		zram_clear_flag(zram, index, ZRAM_UNCOMPRESSED);
-		zram_stat_dec(&zram->stats.pages_expand);
+		zram_stat_dec(zram, &zram->stats.pages_expand);
 		goto out;
 	}
 
 	zs_free(zram->mem_pool, handle);
 
 	if (zram->table[index].size <= PAGE_SIZE / 2)
-		zram_stat_dec(&zram->stats.good_compress);
+		zram_stat_dec(zram, &zram->stats.good_compress);
 
 out:
 	zram_stat64_sub(zram, &zram->stats.compr_size,
 			zram->table[index].size);
-	zram_stat_dec(&zram->stats.pages_stored);
+	zram_stat_dec(zram, &zram->stats.pages_stored);
 
 	zram->table[index].handle = NULL;
 	zram->table[index].size = 0;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
+	fill_same(user_mem + bvec->bv_offset, element, bvec->bv_len);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
@@ -203,6 +381,33 @@ static inline int is_partial_io(struct bio_vec *bvec)
 	return bvec->bv_len != PAGE_SIZE;
 }
 
+static int handle_wb_page(struct zram *zram, struct bio_vec *bvec,
+			  u32 index, int offset)
+{
+	struct page *page = bvec->bv_page;
+	unsigned char *user_mem, *mem;
+	int ret;
+
+	mem = kmalloc(bvec->bv_len, GFP_NOIO);
+	if (!mem)
+		return -ENOMEM;
+
+	ret = zram_bd_read(zram, zram->table[index].element, mem, offset,
+			   bvec->bv_len);
+	if (!ret) {
+		user_mem = kmap_atomic(page);
+		memcpy(user_mem + bvec->bv_offset, mem, bvec->bv_len);
+		kunmap_atomic(user_mem);
+		flush_dcache_page(page);
+	} else {
+		pr_err("Backing device read failed! page=%u\n", index);
+		zram_stat64_inc(zram, &zram->stats.failed_reads);
+	}
+	kfree(mem);
+
+	return ret;
+}
+
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
@@ -214,16 +419,19 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 
 	page = bvec->bv_page;
 
-	if (zram_test_flag(zram, index, ZRAM_ZERO)) {
-		handle_zero_page(bvec);
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		handle_same_page(bvec, zram->table[index].element);
 		return 0;
 	}
 
+	if (unlikely(zram_test_flag(zram, index, ZRAM_WB)))
+		return handle_wb_page(zram, bvec, index, offset);
+
 	/* Requested page is not present in compressed area */
 	if (unlikely(!zram->table[index].handle)) {
 		pr_debug("Read before write: sector=%lu, size=%u",
 			 (ulong)(bio->bi_sector), bio->bi_size);
-		handle_zero_page(bvec);
+		handle_same_page(bvec, 0);
 		return 0;
 	}
 
@@ -249,9 +457,9 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 
 	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    uncmem, &clen);
+	ret = zram->backend->decompress(cmem + sizeof(*zheader),
+					zram->table[index].size,
+					uncmem, &clen);
 
 	if (is_partial_io(bvec)) {
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
@@ -281,24 +489,33 @@ static int zram_read_before_write(struct zram *zram, char *mem, u32 index)
 	struct zobj_header *zheader;
 	unsigned char *cmem;
 
-	if (zram_test_flag(zram, index, ZRAM_ZERO) ||
-	    !zram->table[index].handle) {
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		fill_same(mem, zram->table[index].element, PAGE_SIZE);
+		return 0;
+	}
+
+	if (!zram->table[index].handle) {
 		memset(mem, 0, PAGE_SIZE);
 		return 0;
 	}
 
-	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
+	if (unlikely(zram_test_flag(zram, index, ZRAM_WB)))
+		return zram_bd_read(zram, zram->table[index].element, mem, 0,
+				    PAGE_SIZE);
 
 	/* Page is stored uncompressed since it's incompressible */
 	if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED))) {
+		cmem = kmap_atomic(zram->table[index].handle);
 		memcpy(mem, cmem, PAGE_SIZE);
 		kunmap_atomic(cmem);
 		return 0;
 	}
 
-	ret = lzo1x_decompress_safe(cmem + sizeof(*zheader),
-				    zram->table[index].size,
-				    mem, &clen);
+	cmem = zs_map_object(zram->mem_pool, zram->table[index].handle);
+
+	ret = zram->backend->decompress(cmem + sizeof(*zheader),
+					zram->table[index].size,
+					mem, &clen);
 	zs_unmap_object(zram->mem_pool, zram->table[index].handle);
 
 	/* Should NEVER happen. Return bio error if it does. */
@@ -321,9 +538,10 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	struct zobj_header *zheader;
 	struct page *page, *page_store;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
+	struct zram_comp *comp = NULL;
+	unsigned long element, blk;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
@@ -348,7 +566,8 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	 * with this sector now.
 	 */
 	if (zram->table[index].handle ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
+	    zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_WB))
 		zram_free_page(zram, index);
 
 	user_mem = kmap_atomic(page);
@@ -359,18 +578,29 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	else
 		uncmem = user_mem;
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		kunmap_atomic(user_mem);
 		if (is_partial_io(bvec))
 			kfree(uncmem);
-		zram_stat_inc(&zram->stats.pages_zero);
-		zram_set_flag(zram, index, ZRAM_ZERO);
+		zram_stat_inc(zram, &zram->stats.pages_same);
+		zram_set_flag(zram, index, ZRAM_SAME);
+		zram->table[index].element = element;
 		ret = 0;
 		goto out;
 	}
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       zram->compress_workmem);
+	if (zram->backend->compress) {
+		comp = per_cpu_ptr(zram->comp, raw_smp_processor_id());
+		mutex_lock(&comp->lock);
+		src = comp->buffer;
+		ret = zram->backend->compress(uncmem, PAGE_SIZE, src, &clen,
+					      comp->workmem);
+	} else {
+		/* store as is, see below */
+		src = NULL;
+		clen = PAGE_SIZE;
+		ret = 0;
+	}
 
 	kunmap_atomic(user_mem);
 	if (is_partial_io(bvec))
@@ -387,6 +617,22 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	 * errors which has side effect of hanging the system.
 	 */
 	if (unlikely(clen > max_zpage_size)) {
+		/* the compressed copy is not needed any more */
+		if (comp) {
+			mutex_unlock(&comp->lock);
+			comp = NULL;
+		}
+
+		/* swap I/O is always full pages, that is what matters here */
+		if (zram_has_bd(zram) && !is_partial_io(bvec)) {
+			ret = zram_bd_write_page(zram, page, &blk);
+			if (!ret) {
+				zram_bd_set_slot(zram, index, blk);
+				return 0;
+			}
+			/* backing device full or failing, keep it in RAM */
+		}
+
 		clen = PAGE_SIZE;
 		page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
 		if (unlikely(!page_store)) {
@@ -398,7 +644,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 		store_offset = 0;
 		zram_set_flag(zram, index, ZRAM_UNCOMPRESSED);
-		zram_stat_inc(&zram->stats.pages_expand);
+		zram_stat_inc(zram, &zram->stats.pages_expand);
 		handle = page_store;
 		src = kmap_atomic(page);
 		cmem = kmap_atomic(page_store);
@@ -415,14 +661,12 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	cmem = zs_map_object(zram->mem_pool, handle);
 
 memstore:
-#if 0
 	/* Back-reference needed for memory defragmentation */
 	if (!zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)) {
 		zheader = (struct zobj_header *)cmem;
 		zheader->table_idx = index;
 		cmem += sizeof(*zheader);
 	}
-#endif
 
 	memcpy(cmem, src, clen);
 
@@ -433,18 +677,23 @@ memstore:
 		zs_unmap_object(zram->mem_pool, handle);
 	}
 
+	if (comp)
+		mutex_unlock(&comp->lock);
+
 	zram->table[index].handle = handle;
 	zram->table[index].size = clen;
 
 	/* Update stats */
 	zram_stat64_add(zram, &zram->stats.compr_size, clen);
-	zram_stat_inc(&zram->stats.pages_stored);
+	zram_stat_inc(zram, &zram->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
-		zram_stat_inc(&zram->stats.good_compress);
+		zram_stat_inc(zram, &zram->stats.good_compress);
 
 	return 0;
 
 out:
+	if (comp)
+		mutex_unlock(&comp->lock);
 	if (ret)
 		zram_stat64_inc(zram, &zram->stats.failed_writes);
 	return ret;
@@ -453,16 +702,19 @@ out:
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, struct bio *bio, int rw)
 {
+	struct rw_semaphore *lock = &zram->slot_lock[index % ZRAM_SLOT_LOCKS];
 	int ret;
 
 	if (rw == READ) {
-		down_read(&zram->lock);
+		down_read(lock);
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
-		up_read(&zram->lock);
+		/* other readers can only be clearing the same bit */
+		zram_clear_flag(zram, index, ZRAM_IDLE);
+		up_read(lock);
 	} else {
-		down_write(&zram->lock);
+		down_write(lock);
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
+		up_write(lock);
 	}
 
 	return ret;
@@ -577,23 +829,65 @@ error:
 	bio_io_error(bio);
 }
 
+static void zram_comp_destroy(struct zram *zram)
+{
+	int cpu;
+
+	if (!zram->comp)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct zram_comp *comp = per_cpu_ptr(zram->comp, cpu);
+
+		kfree(comp->workmem);
+		free_pages((unsigned long)comp->buffer, 1);
+	}
+	free_percpu(zram->comp);
+	zram->comp = NULL;
+}
+
+static int zram_comp_create(struct zram *zram)
+{
+	int cpu;
+
+	if (!zram->backend->compress)
+		return 0;
+
+	zram->comp = alloc_percpu(struct zram_comp);
+	if (!zram->comp)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct zram_comp *comp = per_cpu_ptr(zram->comp, cpu);
+
+		mutex_init(&comp->lock);
+		comp->workmem = kzalloc(zram->backend->workmem_size,
+					GFP_KERNEL);
+		comp->buffer =
+			(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+		if (!comp->workmem || !comp->buffer)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
 void __zram_reset_device(struct zram *zram)
 {
 	size_t index;
 
+	if (zram->init_done)
+		unregister_shrinker(&zram->shrinker);
 	zram->init_done = 0;
 
 	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
-
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	zram_comp_destroy(zram);
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		void *handle = zram->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_WB))
 			continue;
 
 		if (unlikely(zram_test_flag(zram, index, ZRAM_UNCOMPRESSED)))
@@ -605,6 +899,12 @@ void __zram_reset_device(struct zram *zram)
 	vfree(zram->table);
 	zram->table = NULL;
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* the backing device stays attached, only its contents go */
+	if (zram->bd_bitmap)
+		bitmap_zero(zram->bd_bitmap, zram->bd_pages);
+#endif
+
 	zs_destroy_pool(zram->mem_pool);
 	zram->mem_pool = NULL;
 
@@ -614,6 +914,241 @@ void __zram_reset_device(struct zram *zram)
 	zram->disksize = 0;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Caller holds init_lock and checked that the device is not initialized */
+int zram_bd_attach(struct zram *zram, const char *path)
+{
+	struct block_device *bdev;
+	unsigned long pages;
+	int ret;
+
+	bdev = blkdev_get_by_path(path, FMODE_READ | FMODE_WRITE | FMODE_EXCL,
+				  zram);
+	if (IS_ERR(bdev))
+		return PTR_ERR(bdev);
+
+	ret = set_blocksize(bdev, PAGE_SIZE);
+	if (ret)
+		goto err;
+
+	pages = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	if (pages < 2) {
+		ret = -EINVAL;
+		goto err;
+	}
+
+	zram->bd_bitmap = vzalloc(BITS_TO_LONGS(pages) * sizeof(long));
+	if (!zram->bd_bitmap) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	zram->bdev = bdev;
+	zram->bd_pages = pages;
+	pr_info("%s: backing device %s, %lu pages\n", zram->disk->disk_name,
+		path, pages);
+	return 0;
+
+err:
+	blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	return ret;
+}
+
+void zram_bd_detach(struct zram *zram)
+{
+	if (!zram->bdev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	vfree(zram->bd_bitmap);
+	zram->bd_bitmap = NULL;
+	zram->bdev = NULL;
+	zram->bd_pages = 0;
+}
+
+/*
+ * Mark every page held in RAM idle.  Any access clears the mark, so what is
+ * still idle at the next zram_writeback() call was not touched in between.
+ */
+void zram_mark_idle(struct zram *zram)
+{
+	size_t index;
+
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		struct rw_semaphore *lock =
+			&zram->slot_lock[index % ZRAM_SLOT_LOCKS];
+
+		down_write(lock);
+		if (zram->table[index].handle &&
+		    !zram_test_flag(zram, index, ZRAM_SAME) &&
+		    !zram_test_flag(zram, index, ZRAM_WB))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+		up_write(lock);
+	}
+}
+
+/* Move idle pages, or with @huge the incompressible ones, to the bdev */
+int zram_writeback(struct zram *zram, bool huge)
+{
+	enum zram_pageflags flag = huge ? ZRAM_UNCOMPRESSED : ZRAM_IDLE;
+	struct page *page;
+	unsigned long blk;
+	size_t index;
+	void *mem;
+	int ret = 0;
+
+	if (!zram->bdev)
+		return -ENODEV;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		struct rw_semaphore *lock =
+			&zram->slot_lock[index % ZRAM_SLOT_LOCKS];
+
+		down_write(lock);
+		if (!zram->table[index].handle ||
+		    zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_WB) ||
+		    !zram_test_flag(zram, index, flag))
+			goto next;
+
+		mem = kmap(page);
+		ret = zram_read_before_write(zram, mem, index);
+		kunmap(page);
+		if (ret)
+			goto next;
+
+		ret = zram_bd_write_page(zram, page, &blk);
+		if (ret) {
+			up_write(lock);
+			break;
+		}
+
+		zram_free_page(zram, index);
+		zram_bd_set_slot(zram, index, blk);
+next:
+		up_write(lock);
+		cond_resched();
+	}
+
+	__free_page(page);
+	return ret;
+}
+#endif
+
+struct zram_compact_ctx {
+	struct zram *zram;
+	void *buffer;		/* two objects cannot be mapped at once */
+};
+
+/* zs_move_fn for zram: reallocate the object behind @handle */
+static int zram_move_object(void *priv, void *handle)
+{
+	struct zram_compact_ctx *ctx = priv;
+	struct zram *zram = ctx->zram;
+	struct rw_semaphore *lock;
+	struct zobj_header *zheader;
+	void *new, *cmem;
+	size_t size;
+	u32 index;
+
+	zheader = zs_map_object(zram->mem_pool, handle);
+	index = zheader->table_idx;
+	zs_unmap_object(zram->mem_pool, handle);
+
+	if (index >= zram->disksize >> PAGE_SHIFT)
+		return 0;
+
+	/* a slot under I/O is not worth waiting for */
+	lock = &zram->slot_lock[index % ZRAM_SLOT_LOCKS];
+	if (!down_write_trylock(lock))
+		return 0;
+
+	if (zram->table[index].handle != handle ||
+	    zram_test_flag(zram, index, ZRAM_UNCOMPRESSED) ||
+	    zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_WB)) {
+		up_write(lock);
+		return 0;
+	}
+
+	size = zram->table[index].size + sizeof(*zheader);
+	new = zs_malloc(zram->mem_pool, size);
+	if (!new) {
+		up_write(lock);
+		return -ENOMEM;
+	}
+
+	cmem = zs_map_object(zram->mem_pool, handle);
+	memcpy(ctx->buffer, cmem, size);
+	zs_unmap_object(zram->mem_pool, handle);
+	cmem = zs_map_object(zram->mem_pool, new);
+	memcpy(cmem, ctx->buffer, size);
+	zs_unmap_object(zram->mem_pool, new);
+
+	/* the slot may have been freed by swap meanwhile */
+	spin_lock(&zram->notify_lock);
+	if (zram->table[index].handle == handle) {
+		zram->table[index].handle = new;
+		new = handle;
+	}
+	spin_unlock(&zram->notify_lock);
+	up_write(lock);
+
+	zs_free(zram->mem_pool, new);
+	return 0;
+}
+
+/*
+ * Move objects out of sparsely used zspages and free those.  Caller holds
+ * init_lock and checked that the device is initialized.  Returns the number
+ * of pages freed.
+ */
+unsigned long zram_compact(struct zram *zram)
+{
+	struct zram_compact_ctx ctx = { .zram = zram };
+	unsigned long freed;
+
+	ctx.buffer = kmalloc(PAGE_SIZE, GFP_NOIO);
+	if (!ctx.buffer)
+		return 0;
+
+	freed = zs_compact(zram->mem_pool, zram_move_object, &ctx);
+	kfree(ctx.buffer);
+
+	return freed;
+}
+
+static int zram_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct zram *zram = container_of(shrinker, struct zram, shrinker);
+	int ret;
+
+	/* reset unregisters the shrinker with init_lock held */
+	if (!down_read_trylock(&zram->init_lock))
+		return sc->nr_to_scan ? -1 : 0;
+
+	if (!zram->init_done) {
+		ret = 0;
+	} else if (!sc->nr_to_scan) {
+		ret = min_t(unsigned long, INT_MAX,
+			    zs_get_compactable_pages(zram->mem_pool));
+	} else if (!(sc->gfp_mask & __GFP_IO)) {
+		/* the allocation may come from our own write path */
+		ret = -1;
+	} else {
+		zram_compact(zram);
+		ret = min_t(unsigned long, INT_MAX,
+			    zs_get_compactable_pages(zram->mem_pool));
+	}
+
+	up_read(&zram->init_lock);
+	return ret;
+}
+
 void zram_reset_device(struct zram *zram)
 {
 	down_write(&zram->init_lock);
@@ -635,18 +1170,9 @@ int zram_init_device(struct zram *zram)
 
 	zram_set_disksize(zram, totalram_pages << PAGE_SHIFT);
 
-	zram->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!zram->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail_no_table;
-	}
-
-	zram->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
+	ret = zram_comp_create(zram);
+	if (ret) {
+		pr_err("Error allocating compressor buffers!\n");
 		goto fail_no_table;
 	}
 
@@ -663,13 +1189,18 @@ int zram_init_device(struct zram *zram)
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
-	zram->mem_pool = zs_create_pool("zram", GFP_NOIO | __GFP_HIGHMEM);
+	zram->mem_pool = zs_create_pool(zram->disk->disk_name,
+					GFP_NOIO | __GFP_HIGHMEM);
 	if (!zram->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
 		goto fail;
 	}
 
+	zram->shrinker.shrink = zram_shrink;
+	zram->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&zram->shrinker);
+
 	zram->init_done = 1;
 	up_write(&zram->init_lock);
 
@@ -692,7 +1223,9 @@ static void zram_slot_free_notify(struct block_device *bdev,
 	struct zram *zram;
 
 	zram = bdev->bd_disk->private_data;
+	spin_lock(&zram->notify_lock);
 	zram_free_page(zram, index);
+	spin_unlock(&zram->notify_lock);
 	zram_stat64_inc(zram, &zram->stats.notify_free);
 }
 
@@ -704,10 +1237,14 @@ static const struct block_device_operations zram_devops = {
 static int create_device(struct zram *zram, int device_id)
 {
 	int ret = 0;
+	int i;
 
-	init_rwsem(&zram->lock);
+	for (i = 0; i < ZRAM_SLOT_LOCKS; i++)
+		init_rwsem(&zram->slot_lock[i]);
 	init_rwsem(&zram->init_lock);
 	spin_lock_init(&zram->stat64_lock);
+	spin_lock_init(&zram->notify_lock);
+	zram->backend = zram_backends[0];
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -770,6 +1307,10 @@ static void destroy_device(struct zram *zram)
 	sysfs_remove_group(&disk_to_dev(zram->disk)->kobj,
 			&zram_disk_attr_group);
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+	zram_bd_detach(zram);
+#endif
+
 	if (zram->disk) {
 		del_gendisk(zram->disk);
 		put_disk(zram->disk);
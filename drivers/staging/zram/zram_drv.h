@@ -17,6 +17,7 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/mm.h>
 
 #include "../zsmalloc/zsmalloc.h"
 
@@ -33,9 +34,7 @@ static const unsigned max_num_devices = 32;
  * object. This is required to support memory defragmentation.
  */
 struct zobj_header {
-#if 0
 	u32 table_idx;
-#endif
 };
 
 /*-- Configurable parameters */
@@ -66,13 +65,22 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 #define ZRAM_SECTOR_PER_LOGICAL_BLOCK	\
 	(1 << (ZRAM_LOGICAL_BLOCK_SHIFT - SECTOR_SHIFT))
 
+/* Table entries are locked in stripes, slot n uses lock n % ZRAM_SLOT_LOCKS */
+#define ZRAM_SLOT_LOCKS		64
+
 /* Flags for zram pages (table[page_no].flags) */
 enum zram_pageflags {
 	/* Page is stored uncompressed */
 	ZRAM_UNCOMPRESSED,
 
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO,
+	/* Page is filled with one repeated word, kept in table.element */
+	ZRAM_SAME,
+
+	/* Page lives on the backing device, table.element is the block */
+	ZRAM_WB,
+
+	/* Page was not accessed since it was last marked idle */
+	ZRAM_IDLE,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -81,7 +89,10 @@ enum zram_pageflags {
 
 /* Allocated for each disk page */
 struct table {
-	void *handle;
+	union {
+		void *handle;
+		unsigned long element;	/* ZRAM_SAME fill word, ZRAM_WB block */
+	};
 	u16 size;	/* object size (excluding header) */
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
@@ -95,20 +106,51 @@ struct zram_stats {
 	u64 failed_writes;	/* can happen when memory is too low */
 	u64 invalid_io;		/* non-page-aligned I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
-	u32 pages_zero;		/* no. of zero filled pages */
+	u32 pages_same;		/* no. of same filled pages, zero included */
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	u32 pages_wb;		/* no. of pages on the backing device */
+	u64 bd_reads;		/* pages read back from it */
+	u64 bd_writes;		/* pages written to it */
+#endif
+};
+
+/*
+ * Compression algorithm of a device, selected through sysfs before the device
+ * is initialized.  Both callbacks return 0 on success.  A backend without
+ * ->compress keeps only same filled pages small and stores the rest as is.
+ */
+struct zram_backend {
+	const char *name;
+	size_t workmem_size;
+	int (*compress)(const unsigned char *src, size_t src_len,
+			unsigned char *dst, size_t *dst_len, void *wrkmem);
+	int (*decompress)(const unsigned char *src, size_t src_len,
+			  unsigned char *dst, size_t *dst_len);
+};
+
+/* Compressor state, one per cpu so that writers compress in parallel */
+struct zram_comp {
+	struct mutex lock;	/* a writer may be migrated while using it */
+	void *workmem;
+	void *buffer;
 };
 
 struct zram {
 	struct zs_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	const struct zram_backend *backend;
+	struct zram_comp __percpu *comp;
 	struct table *table;
-	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
+	spinlock_t stat64_lock;	/* protect stats */
+	/*
+	 * swap_slot_free_notify runs in atomic context and cannot take the
+	 * slot locks, so compaction swaps handles under this lock instead.
+	 */
+	spinlock_t notify_lock;
+	/* protect table entries against concurrent read and writes */
+	struct rw_semaphore slot_lock[ZRAM_SLOT_LOCKS];
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -121,9 +163,16 @@ struct zram {
 	u64 disksize;	/* bytes */
 
 	struct zram_stats stats;
+	struct shrinker shrinker;	/* compacts mem_pool on memory pressure */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct block_device *bdev;
+	unsigned long bd_pages;		/* size of bdev, block 0 is unused */
+	unsigned long *bd_bitmap;	/* blocks in use */
+#endif
 };
 
 extern struct zram *zram_devices;
+extern const struct zram_backend *zram_backends[];
 unsigned int zram_get_num_devices(void);
 #ifdef CONFIG_SYSFS
 extern struct attribute_group zram_disk_attr_group;
@@ -131,5 +180,13 @@ extern struct attribute_group zram_disk_attr_group;
 
 extern int zram_init_device(struct zram *zram);
 extern void __zram_reset_device(struct zram *zram);
+extern unsigned long zram_compact(struct zram *zram);
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+extern int zram_bd_attach(struct zram *zram, const char *path);
+extern void zram_bd_detach(struct zram *zram);
+extern void zram_mark_idle(struct zram *zram);
+extern int zram_writeback(struct zram *zram, bool huge);
+#endif
 
 #endif
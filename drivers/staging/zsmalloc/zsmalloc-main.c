@@ -17,9 +17,11 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/bitops.h>
+#include <linux/debugfs.h>
 #include <linux/errno.h>
 #include <linux/highmem.h>
 #include <linux/init.h>
+#include <linux/seq_file.h>
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <asm/tlbflush.h>
@@ -43,6 +45,10 @@
 /* per-cpu VM mapping areas for zspage accesses that cross page boundaries */
 static DEFINE_PER_CPU(struct mapping_area, zs_map_area);
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *zs_debugfs_root;
+#endif
+
 static int is_first_page(struct page *page)
 {
 	return test_bit(PG_private, &page->flags);
@@ -155,6 +161,10 @@ static enum fullness_group fix_fullness_group(struct zs_pool *pool,
 	BUG_ON(!is_first_page(page));
 
 	get_zspage_mapping(page, &class_idx, &currfg);
+	/* zs_compact() puts it back, and frees it if it became empty */
+	if (currfg == ZS_ISOLATED)
+		return ZS_ISOLATED;
+
 	newfg = get_fullness_group(page);
 	if (newfg == currfg)
 		goto out;
@@ -457,6 +467,92 @@ static struct notifier_block zs_cpu_nb = {
 	.notifier_call = zs_cpu_notifier
 };
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * One line per size class in use.  The columns after "zspages" split the
+ * zspages by how full they are, so the waste of a class shows up as zspages
+ * sitting in the low buckets.
+ */
+static int zs_classes_show(struct seq_file *s, void *unused)
+{
+	struct zs_pool *pool = s->private;
+	int i;
+
+	seq_printf(s, "%5s %5s %4s %8s %8s %8s %6s %6s %6s %6s %6s %9s\n",
+		   "class", "size", "objs", "zspages", "inuse", "wasted",
+		   "<25%", "<50%", "<75%", "<100%", "full", "compacted");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+		unsigned long hist[4] = { 0 }, zspages, listed = 0, wasted;
+		struct page *page;
+		int fg;
+
+		spin_lock(&class->lock);
+		zspages = div_u64(class->pages_allocated, class->zspage_order);
+		if (!zspages) {
+			spin_unlock(&class->lock);
+			continue;
+		}
+		for (fg = 0; fg < _ZS_NR_FULLNESS_GROUPS; fg++) {
+			struct page *head = class->fullness_list[fg];
+
+			if (!head)
+				continue;
+			page = head;
+			do {
+				hist[page->inuse * 4 / page->objects]++;
+				listed++;
+				page = list_entry(page->lru.next, struct page,
+						  lru);
+			} while (page != head);
+		}
+		wasted = (zspages * class->objs_per_zspage -
+			  class->objs_inuse) * class->size;
+		seq_printf(s, "%5u %5d %4d %8lu %8lu %8lu %6lu %6lu %6lu %6lu "
+			   "%6lu %9llu\n", class->index, class->size,
+			   class->objs_per_zspage, zspages, class->objs_inuse,
+			   wasted >> 10, hist[0], hist[1], hist[2], hist[3],
+			   zspages - listed, class->pages_compacted);
+		spin_unlock(&class->lock);
+	}
+
+	return 0;
+}
+
+static int zs_classes_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_classes_show, inode->i_private);
+}
+
+static const struct file_operations zs_classes_fops = {
+	.open		= zs_classes_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void zs_pool_debugfs_create(struct zs_pool *pool)
+{
+	if (!zs_debugfs_root)
+		return;
+
+	/* a second pool of the same name simply goes without */
+	pool->debugfs_dentry = debugfs_create_dir(pool->name, zs_debugfs_root);
+	if (pool->debugfs_dentry)
+		debugfs_create_file("classes", S_IRUGO, pool->debugfs_dentry,
+				    pool, &zs_classes_fops);
+}
+
+static void zs_pool_debugfs_destroy(struct zs_pool *pool)
+{
+	debugfs_remove_recursive(pool->debugfs_dentry);
+}
+#else
+static inline void zs_pool_debugfs_create(struct zs_pool *pool) {}
+static inline void zs_pool_debugfs_destroy(struct zs_pool *pool) {}
+#endif
+
 static void zs_exit(void)
 {
 	int cpu;
@@ -464,12 +560,19 @@ static void zs_exit(void)
 	for_each_online_cpu(cpu)
 		zs_cpu_notifier(NULL, CPU_DEAD, (void *)(long)cpu);
 	unregister_cpu_notifier(&zs_cpu_nb);
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove_recursive(zs_debugfs_root);
+#endif
 }
 
 static int zs_init(void)
 {
 	int cpu, ret;
 
+#ifdef CONFIG_DEBUG_FS
+	zs_debugfs_root = debugfs_create_dir("zsmalloc", NULL);
+#endif
+
 	register_cpu_notifier(&zs_cpu_nb);
 	for_each_online_cpu(cpu) {
 		ret = zs_cpu_notifier(NULL, CPU_UP_PREPARE, (void *)(long)cpu);
@@ -508,11 +611,13 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 		class->index = i;
 		spin_lock_init(&class->lock);
 		class->zspage_order = get_zspage_order(size);
-
+		class->objs_per_zspage = class->zspage_order * PAGE_SIZE /
+					 size;
 	}
 
 	pool->flags = flags;
 	pool->name = name;
+	zs_pool_debugfs_create(pool);
 
 	return pool;
 }
@@ -534,6 +639,7 @@ void zs_destroy_pool(struct zs_pool *pool)
 			}
 		}
 	}
+	zs_pool_debugfs_destroy(pool);
 	kfree(pool);
 }
 EXPORT_SYMBOL_GPL(zs_destroy_pool);
@@ -593,6 +699,7 @@ void *zs_malloc(struct zs_pool *pool, size_t size)
 	kunmap_atomic(link);
 
 	first_page->inuse++;
+	class->objs_inuse++;
 	/* Now move the zspage to another fullness group, if required */
 	fix_fullness_group(pool, first_page);
 	spin_unlock(&class->lock);
@@ -631,6 +738,7 @@ void zs_free(struct zs_pool *pool, void *obj)
 	first_page->freelist = obj;
 
 	first_page->inuse--;
+	class->objs_inuse--;
 	fullness = fix_fullness_group(pool, first_page);
 
 	if (fullness == ZS_EMPTY)
@@ -725,6 +833,179 @@ u64 zs_get_total_size_bytes(struct zs_pool *pool)
 }
 EXPORT_SYMBOL_GPL(zs_get_total_size_bytes);
 
+/* Position of an object within its zspage, counting from 0 */
+static unsigned int obj_zspage_index(struct page *first_page,
+				     struct page *page, unsigned long obj_idx,
+				     int class_size)
+{
+	struct page *p = first_page;
+	unsigned int nr = 0;
+
+	while (p != page) {
+		p = get_next_page(p);
+		nr++;
+	}
+
+	return (nr * PAGE_SIZE + obj_idx_to_offset(page, obj_idx, class_size)) /
+		class_size;
+}
+
+/*
+ * Collect the handles of the objects allocated in @first_page, by elimination
+ * of the ones on its freelist.  Called with the class lock held.
+ */
+static int zs_live_objects(struct size_class *class, struct page *first_page,
+			   unsigned long *free_map, void **handles)
+{
+	struct page *page;
+	unsigned long obj_idx, off;
+	void *obj;
+	int nr = 0;
+
+	bitmap_zero(free_map, class->objs_per_zspage);
+	for (obj = first_page->freelist; obj; ) {
+		struct link_free *link;
+
+		obj_handle_to_location(obj, &page, &obj_idx);
+		set_bit(obj_zspage_index(first_page, page, obj_idx,
+					 class->size), free_map);
+
+		off = obj_idx_to_offset(page, obj_idx, class->size);
+		link = (struct link_free *)((unsigned char *)kmap_atomic(page)
+					    + off);
+		obj = link->next;
+		kunmap_atomic(link);
+	}
+
+	for (page = first_page; page; page = get_next_page(page)) {
+		for (obj_idx = 0; ; obj_idx++) {
+			unsigned int i;
+
+			off = obj_idx_to_offset(page, obj_idx, class->size);
+			if (off >= PAGE_SIZE)
+				break;
+			i = obj_zspage_index(first_page, page, obj_idx,
+					     class->size);
+			if (i >= first_page->objects)
+				break;
+			if (!test_bit(i, free_map))
+				handles[nr++] = obj_location_to_handle(page,
+								       obj_idx);
+		}
+	}
+
+	return nr;
+}
+
+/*
+ * Emptying @first_page only pays off if the other zspages of the class can
+ * take its objects without the pool growing.
+ */
+static bool zs_can_compact(struct size_class *class, struct page *first_page)
+{
+	unsigned long capacity, free;
+
+	capacity = div_u64(class->pages_allocated, class->zspage_order) *
+		   class->objs_per_zspage;
+	free = capacity - class->objs_inuse -
+	       (first_page->objects - first_page->inuse);
+
+	return free >= first_page->inuse;
+}
+
+static unsigned long zs_compact_class(struct size_class *class,
+				      zs_move_fn move, void *priv,
+				      unsigned long *free_map, void **handles,
+				      int *err)
+{
+	unsigned long freed = 0;
+	struct page *first_page;
+	enum fullness_group fg;
+	int i, nr;
+
+	while (!*err) {
+		spin_lock(&class->lock);
+		first_page = class->fullness_list[ZS_ALMOST_EMPTY];
+		if (!first_page || !zs_can_compact(class, first_page)) {
+			spin_unlock(&class->lock);
+			break;
+		}
+		remove_zspage(first_page, class, ZS_ALMOST_EMPTY);
+		set_zspage_mapping(first_page, class->index, ZS_ISOLATED);
+		nr = zs_live_objects(class, first_page, free_map, handles);
+		spin_unlock(&class->lock);
+
+		/* nobody allocates from it now, so the handles stay valid */
+		for (i = 0; i < nr && !*err; i++)
+			*err = move(priv, handles[i]);
+
+		spin_lock(&class->lock);
+		fg = get_fullness_group(first_page);
+		if (fg == ZS_EMPTY) {
+			class->pages_allocated -= class->zspage_order;
+			class->pages_compacted += class->zspage_order;
+		} else {
+			insert_zspage(first_page, class, fg);
+		}
+		set_zspage_mapping(first_page, class->index, fg);
+		spin_unlock(&class->lock);
+
+		/* busy objects stayed behind, do not pick it again */
+		if (fg != ZS_EMPTY)
+			break;
+
+		free_zspage(first_page);
+		freed += class->zspage_order;
+		cond_resched();
+	}
+
+	return freed;
+}
+
+unsigned long zs_compact(struct zs_pool *pool, zs_move_fn move, void *priv)
+{
+	unsigned int max_objs = ZS_MAX_PAGES_PER_ZSPAGE * PAGE_SIZE /
+				ZS_MIN_ALLOC_SIZE;
+	unsigned long freed = 0;
+	unsigned long *free_map;
+	void **handles;
+	int i, err = 0;
+
+	free_map = kmalloc(BITS_TO_LONGS(max_objs) * sizeof(long), GFP_KERNEL);
+	handles = kmalloc(max_objs * sizeof(*handles), GFP_KERNEL);
+	if (!free_map || !handles)
+		goto out;
+
+	for (i = 0; i < ZS_SIZE_CLASSES && !err; i++)
+		freed += zs_compact_class(&pool->size_class[i], move, priv,
+					  free_map, handles, &err);
+out:
+	kfree(handles);
+	kfree(free_map);
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+/* Pages that a perfect compaction would give back */
+unsigned long zs_get_compactable_pages(struct zs_pool *pool)
+{
+	unsigned long pages = 0;
+	int i;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+		unsigned long zspages, used;
+
+		zspages = div_u64(class->pages_allocated, class->zspage_order);
+		used = DIV_ROUND_UP(class->objs_inuse, class->objs_per_zspage);
+		if (zspages > used)
+			pages += (zspages - used) * class->zspage_order;
+	}
+
+	return pages;
+}
+EXPORT_SYMBOL_GPL(zs_get_compactable_pages);
+
 module_init(zs_init);
 module_exit(zs_exit);
 
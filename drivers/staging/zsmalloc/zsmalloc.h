@@ -28,4 +28,16 @@ void zs_unmap_object(struct zs_pool *pool, void *handle);
 
 u64 zs_get_total_size_bytes(struct zs_pool *pool);
 
+/*
+ * Handles are object locations, so zsmalloc cannot move objects by itself.
+ * zs_compact() isolates sparse zspages and calls @move for each live object
+ * on them.  The owner reallocates the object (zs_malloc, copy, update its
+ * reference, zs_free the old handle) and returns 0, or returns 0 as well if
+ * the handle is no longer its own or is busy.  Any error stops compaction.
+ * Returns the number of pages freed.
+ */
+typedef int (*zs_move_fn)(void *priv, void *handle);
+unsigned long zs_compact(struct zs_pool *pool, zs_move_fn move, void *priv);
+unsigned long zs_get_compactable_pages(struct zs_pool *pool);
+
 #endif
@@ -90,7 +90,8 @@ enum fullness_group {
 	_ZS_NR_FULLNESS_GROUPS,
 
 	ZS_EMPTY,
-	ZS_FULL
+	ZS_FULL,
+	ZS_ISOLATED	/* being emptied by zs_compact(), on no list */
 };
 
 /*
@@ -125,11 +126,14 @@ struct size_class {
 
 	/* Number of PAGE_SIZE sized pages to combine to form a 'zspage' */
 	int zspage_order;
+	int objs_per_zspage;
 
 	spinlock_t lock;
 
 	/* stats */
 	u64 pages_allocated;
+	unsigned long objs_inuse;
+	u64 pages_compacted;
 
 	struct page *fullness_list[_ZS_NR_FULLNESS_GROUPS];
 };
@@ -150,6 +154,8 @@ struct zs_pool {
 
 	gfp_t flags;	/* allocation flags used when growing pool */
 	const char *name;
+
+	struct dentry *debugfs_dentry;
 };
 
 #endif
@@ -153,6 +153,8 @@ static void serial_omap_stop_rxdma(struct uart_omap_port *up)
 	if (up->uart_dma.rx_dma_used) {
 		del_timer(&up->uart_dma.rx_timer);
 		omap_stop_dma(up->uart_dma.rx_dma_channel);
+		omap_dma_unlink_lch(up->uart_dma.rx_dma_channel,
+				    up->uart_dma.rx_dma_channel);
 		omap_free_dma(up->uart_dma.rx_dma_channel);
 		up->uart_dma.rx_dma_channel = OMAP_UART_DMA_CH_FREE;
 		up->uart_dma.rx_dma_used = false;
@@ -1282,55 +1284,98 @@ static int serial_omap_resume(struct device *dev)
 }
 #endif
 
+/*
+ * Hand the bytes between two DMA positions over to the tty layer. What the
+ * flip buffers can't take is lost, and accounted as a buffer overrun.
+ */
+static unsigned int serial_omap_rxdma_push(struct uart_omap_port *up,
+		unsigned int from, unsigned int to)
+{
+	struct tty_struct *tty = up->port.state->port.tty;
+	unsigned int count = to - from;
+	int copied;
+
+	if (!count)
+		return 0;
+
+	copied = tty_insert_flip_string(tty, up->uart_dma.rx_buf +
+			(from - up->uart_dma.rx_buf_dma_phys), count);
+	up->port.icount.rx += copied;
+	if (copied < count)
+		up->port.icount.buf_overrun += count - copied;
+
+	return count;
+}
+
+/*
+ * The RX channel loops over its buffer, in two halves: flush whatever it
+ * wrote since the last call, wrapping around the end of the buffer.
+ * Called with the rx_lock held, returns the number of bytes received.
+ */
+static unsigned int serial_omap_rxdma_flush(struct uart_omap_port *up)
+{
+	struct uart_omap_dma *dma = &up->uart_dma;
+	unsigned int start = dma->rx_buf_dma_phys;
+	unsigned int end = start + dma->rx_buf_size;
+	unsigned int pos, count = 0;
+
+	pos = omap_get_dma_dst_pos(dma->rx_dma_channel);
+	if (pos < start || pos > end)
+		return 0;
+
+	/* the FIFO overflowed while waiting for the DMA */
+	if (serial_in(up, UART_LSR) & UART_LSR_OE) {
+		up->port.icount.overrun++;
+		tty_insert_flip_char(up->port.state->port.tty, 0, TTY_OVERRUN);
+	}
+
+	if (pos < dma->prev_rx_dma_pos) {
+		count += serial_omap_rxdma_push(up, dma->prev_rx_dma_pos, end);
+		dma->prev_rx_dma_pos = start;
+	}
+	count += serial_omap_rxdma_push(up, dma->prev_rx_dma_pos, pos);
+	dma->prev_rx_dma_pos = (pos == end) ? start : pos;
+
+	if (count)
+		tty_flip_buffer_push(up->port.state->port.tty);
+	return count;
+}
+
+/*
+ * Flush the partially filled half of the RX buffer, and go back to
+ * interrupt driven reception once the line has been idle for rx_timeout.
+ */
 static void serial_omap_rxdma_poll(unsigned long uart_no)
 {
 	struct uart_omap_port *up = ui[uart_no];
-	unsigned int curr_dma_pos, curr_transmitted_size;
-	int ret = 0;
+	unsigned long flags;
 
-	curr_dma_pos = omap_get_dma_dst_pos(up->uart_dma.rx_dma_channel);
-	if ((curr_dma_pos == up->uart_dma.prev_rx_dma_pos) ||
-			     (curr_dma_pos == 0)) {
-		if (jiffies_to_msecs(jiffies - up->port_activity) <
+	spin_lock_irqsave(&up->uart_dma.rx_lock, flags);
+	if (serial_omap_rxdma_flush(up)) {
+		up->port_activity = jiffies;
+	} else if (jiffies_to_msecs(jiffies - up->port_activity) >=
 						up->uart_dma.rx_timeout) {
-			mod_timer(&up->uart_dma.rx_timer, jiffies +
-				usecs_to_jiffies(up->uart_dma.rx_poll_rate));
-		} else {
-			serial_omap_stop_rxdma(up);
-			up->ier |= (UART_IER_RDI | UART_IER_RLSI);
-			serial_out(up, UART_IER, up->ier);
-		}
+		serial_omap_stop_rxdma(up);
+		up->ier |= (UART_IER_RDI | UART_IER_RLSI);
+		serial_out(up, UART_IER, up->ier);
+		spin_unlock_irqrestore(&up->uart_dma.rx_lock, flags);
 		return;
 	}
 
-	curr_transmitted_size = curr_dma_pos -
-					up->uart_dma.prev_rx_dma_pos;
-	up->port.icount.rx += curr_transmitted_size;
-	tty_insert_flip_string(up->port.state->port.tty,
-			up->uart_dma.rx_buf +
-			(up->uart_dma.prev_rx_dma_pos -
-			up->uart_dma.rx_buf_dma_phys),
-			curr_transmitted_size);
-	tty_flip_buffer_push(up->port.state->port.tty);
-	up->uart_dma.prev_rx_dma_pos = curr_dma_pos;
-	if (up->uart_dma.rx_buf_size +
-			up->uart_dma.rx_buf_dma_phys == curr_dma_pos) {
-		ret = serial_omap_start_rxdma(up);
-		if (ret < 0) {
-			serial_omap_stop_rxdma(up);
-			up->ier |= (UART_IER_RDI | UART_IER_RLSI);
-			serial_out(up, UART_IER, up->ier);
-		}
-	} else  {
-		mod_timer(&up->uart_dma.rx_timer, jiffies +
+	mod_timer(&up->uart_dma.rx_timer, jiffies +
 			usecs_to_jiffies(up->uart_dma.rx_poll_rate));
-	}
-	up->port_activity = jiffies;
+	spin_unlock_irqrestore(&up->uart_dma.rx_lock, flags);
 }
 
+/* A half of the RX buffer is full, flush it while the other one fills */
 static void uart_rx_dma_callback(int lch, u16 ch_status, void *data)
 {
-	return;
+	struct uart_omap_port *up = data;
+
+	spin_lock(&up->uart_dma.rx_lock);
+	if (up->uart_dma.rx_dma_used && serial_omap_rxdma_flush(up))
+		up->port_activity = jiffies;
+	spin_unlock(&up->uart_dma.rx_lock);
 }
 
 static int serial_omap_start_rxdma(struct uart_omap_port *up)
@@ -1352,11 +1397,20 @@ static int serial_omap_start_rxdma(struct uart_omap_port *up)
 		omap_set_dma_dest_params(up->uart_dma.rx_dma_channel, 0,
 				OMAP_DMA_AMODE_POST_INC,
 				up->uart_dma.rx_buf_dma_phys, 0, 0);
+		/*
+		 * Ping-pong over the two halves of the buffer: the channel is
+		 * linked to itself so that it never stops, and a frame
+		 * interrupt flushes each half as soon as it is full.
+		 */
 		omap_set_dma_transfer_params(up->uart_dma.rx_dma_channel,
 				OMAP_DMA_DATA_TYPE_S8,
-				up->uart_dma.rx_buf_size, 1,
+				up->uart_dma.rx_buf_size / 2, 2,
 				OMAP_DMA_SYNC_ELEMENT,
 				up->uart_dma.uart_dma_rx, 0);
+		omap_dma_link_lch(up->uart_dma.rx_dma_channel,
+				  up->uart_dma.rx_dma_channel);
+		omap_enable_dma_irq(up->uart_dma.rx_dma_channel,
+				    OMAP_DMA_FRAME_IRQ);
 	}
 	up->uart_dma.prev_rx_dma_pos = up->uart_dma.rx_buf_dma_phys;
 	/* FIXME: Cache maintenance needed here? */
@@ -63,6 +63,10 @@ static char *maximum_speed = "super";
 module_param(maximum_speed, charp, 0);
 MODULE_PARM_DESC(maximum_speed, "Maximum supported speed.");
 
+static unsigned int imod_interval;
+module_param(imod_interval, uint, 0);
+MODULE_PARM_DESC(imod_interval, "Minimum time between interrupts, in usecs.");
+
 /* -------------------------------------------------------------------------- */
 
 #define DWC3_DEVS_POSSIBLE	32
@@ -590,6 +594,8 @@ static int __devinit dwc3_probe(struct platform_device *pdev)
 	else
 		dwc->maximum_speed = DWC3_DCFG_SUPERSPEED;
 
+	dwc->imod_interval = imod_interval;
+
 	if (of_get_property(node, "tx-fifo-resize", NULL))
 		dwc->needs_fifo_resize = true;
 
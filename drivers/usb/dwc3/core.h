@@ -46,6 +46,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/mm.h>
 #include <linux/debugfs.h>
+#include <linux/hrtimer.h>
 
 #include <linux/usb/ch9.h>
 #include <linux/usb/gadget.h>
@@ -75,6 +76,7 @@
 #define DWC3_DEVICE_EVENT_CMD_CMPL		10
 #define DWC3_DEVICE_EVENT_OVERFLOW		11
 
+#define DWC3_GEVNTSIZ_INTMASK	(1 << 31)
 #define DWC3_GEVNTCOUNT_MASK	0xfffc
 #define DWC3_GSNPSID_MASK	0xffff0000
 #define DWC3_GSNPSREV_MASK	0xffff
@@ -431,6 +433,7 @@ struct dwc3_ep {
 #define DWC3_EP_BUSY		(1 << 4)
 #define DWC3_EP_PENDING_REQUEST	(1 << 5)
 #define DWC3_EP_MISSED_ISOC	(1 << 6)
+#define DWC3_EP_COMPLETED	(1 << 7)   /* requests given back this IRQ */
 
 	/* This last one is specific to EP0 */
 #define DWC3_EP0_DIR_IN		(1 << 31)
@@ -654,6 +657,8 @@ struct dwc3_scratchpad_array {
  * @mem: points to start of memory which is used for this struct.
  * @hwparams: copy of hwparams registers
  * @root: debugfs root folder pointer
+ * @imod_interval: minimum time between interrupts in usecs, 0 for none
+ * @imod_timer: unmasks the event buffers once imod_interval is over
  */
 struct dwc3 {
 	struct usb_phy		*usb2_phy;
@@ -731,6 +736,9 @@ struct dwc3 {
 	struct dwc3_context_regs context;
 	struct dentry		*root;
 
+	u32			imod_interval;
+	struct hrtimer		imod_timer;
+
 	u8			test_mode;
 	u8			test_mode_nr;
 	bool		is_connected:1;
@@ -694,6 +694,13 @@ int __devinit dwc3_debugfs_init(struct dwc3 *dwc)
 		goto err1;
 	}
 
+	file = debugfs_create_u32("imod_interval", S_IRUGO | S_IWUSR, root,
+			&dwc->imod_interval);
+	if (!file) {
+		ret = -ENOMEM;
+		goto err1;
+	}
+
 	return 0;
 
 err1:
@@ -822,6 +822,12 @@ static void dwc3_prepare_one_trb(struct dwc3_ep *dep,
 	trb->ctrl |= DWC3_TRB_CTRL_HWO;
 }
 
+/* number of TRBs a request takes, sg requests use one per entry */
+static unsigned dwc3_request_trbs(struct dwc3_request *req)
+{
+	return req->request.num_mapped_sgs ? req->request.num_mapped_sgs : 1;
+}
+
 /*
  * dwc3_prepare_trbs - setup TRBs from requests
  * @dep: endpoint for which requests are being prepared
@@ -886,6 +892,20 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 	list_for_each_entry_safe(req, n, &dep->request_list, list) {
 		unsigned	length;
 		dma_addr_t	dma;
+		unsigned	trbs = dwc3_request_trbs(req);
+
+		/*
+		 * Requests are only ever queued whole. One that doesn't fit
+		 * waits for the next transfer, so the request before it has
+		 * to end this one.
+		 */
+		if (trbs > trbs_left)
+			break;
+		trbs_left -= trbs;
+
+		if (list_is_last(&req->list, &dep->request_list) ||
+				dwc3_request_trbs(n) > trbs_left)
+			last_one = 1;
 
 		if (req->request.num_mapped_sgs > 0) {
 			struct usb_request *request = &req->request;
@@ -895,47 +915,33 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 
 			for_each_sg(sg, s, request->num_mapped_sgs, i) {
 				unsigned chain = true;
+				unsigned last = false;
 
 				length = sg_dma_len(s);
 				dma = sg_dma_address(s);
 
 				if (i == (request->num_mapped_sgs - 1) ||
 						sg_is_last(s)) {
-					last_one = true;
+					last = last_one;
 					chain = false;
 				}
 
-				trbs_left--;
-				if (!trbs_left)
-					last_one = true;
-
-				if (last_one)
-					chain = false;
-
 				dwc3_prepare_one_trb(dep, req, dma, length,
-						last_one, chain);
+						last, chain);
 
-				if (last_one)
+				if (!chain)
 					break;
 			}
 		} else {
 			dma = req->request.dma;
 			length = req->request.length;
-			trbs_left--;
-
-			if (!trbs_left)
-				last_one = 1;
-
-			/* Is this the last request? */
-			if (list_is_last(&req->list, &dep->request_list))
-				last_one = 1;
 
 			dwc3_prepare_one_trb(dep, req, dma, length,
 					last_one, false);
-
-			if (last_one)
-				break;
 		}
+
+		if (last_one)
+			break;
 	}
 }
 
@@ -1069,6 +1075,21 @@ static int __dwc3_gadget_ep_queue(struct dwc3_ep *dep, struct dwc3_request *req)
 	if (ret)
 		return ret;
 
+	/*
+	 * A request is never split across transfers, so its sg list has to
+	 * fit the ring. The TRBs of an isoc request could straddle the link
+	 * TRB, which completion does not handle, so no sg there.
+	 */
+	if (req->request.num_mapped_sgs > DWC3_TRB_NUM - 1 ||
+			(req->request.num_mapped_sgs &&
+			 usb_endpoint_xfer_isoc(dep->endpoint.desc))) {
+		dev_err(dwc->dev, "%s: can't queue %d sg entries\n",
+				dep->name, req->request.num_mapped_sgs);
+		usb_gadget_unmap_request(&dwc->gadget, &req->request,
+				dep->direction);
+		return -EINVAL;
+	}
+
 	list_add_tail(&req->list, &dep->request_list);
 
 	/*
@@ -1722,8 +1743,10 @@ static int dwc3_cleanup_done_reqs(struct dwc3 *dwc, struct dwc3_ep *dep,
 	struct dwc3_request	*req;
 	struct dwc3_trb		*trb;
 	unsigned int		count;
+	unsigned int		residue;
 	unsigned int		s_pkt = 0;
 	unsigned int		trb_status;
+	unsigned int		i;
 
 	do {
 		req = next_request(&dep->req_queued);
@@ -1732,39 +1755,47 @@ static int dwc3_cleanup_done_reqs(struct dwc3 *dwc, struct dwc3_ep *dep,
 			return 1;
 		}
 
-		trb = req->trb;
-
-		if ((trb->ctrl & DWC3_TRB_CTRL_HWO) && status != -ESHUTDOWN)
-			/*
-			 * We continue despite the error. There is not much we
-			 * can do. If we don't clean it up we loop forever. If
-			 * we skip the TRB then it gets overwritten after a
-			 * while since we use them in a ring buffer. A BUG()
-			 * would help. Lets hope that if this occurs, someone
-			 * fixes the root cause instead of looking away :)
-			 */
-			dev_err(dwc->dev, "%s's TRB (%p) still owned by HW\n",
-					dep->name, req->trb);
-		count = trb->size & DWC3_TRB_SIZE_MASK;
-
-		if (dep->direction) {
-			if (count) {
-				trb_status = DWC3_TRB_SIZE_TRBSTS(trb->size);
-				if (trb_status == DWC3_TRBSTS_MISSED_ISOC) {
-					dev_dbg(dwc->dev, "incomplete IN transfer %s\n",
-							dep->name);
-					dep->current_uf = event->parameters &
-						~(dep->interval - 1);
-					dep->flags |= DWC3_EP_MISSED_ISOC;
-				} else {
-					dev_err(dwc->dev, "incomplete IN transfer %s\n",
-							dep->name);
-					status = -ECONNRESET;
+		/* sg requests own consecutive TRBs, req->trb is the first */
+		count = 0;
+		for (i = 0; i < dwc3_request_trbs(req); i++) {
+			trb = req->trb + i;
+
+			if ((trb->ctrl & DWC3_TRB_CTRL_HWO) &&
+					status != -ESHUTDOWN)
+				/*
+				 * We continue despite the error. There is not
+				 * much we can do. If we don't clean it up we
+				 * loop forever. If we skip the TRB then it gets
+				 * overwritten after a while since we use them
+				 * in a ring buffer. A BUG() would help. Lets
+				 * hope that if this occurs, someone fixes the
+				 * root cause instead of looking away :)
+				 */
+				dev_err(dwc->dev, "%s's TRB (%p) still owned by HW\n",
+						dep->name, trb);
+			residue = trb->size & DWC3_TRB_SIZE_MASK;
+			count += residue;
+
+			if (dep->direction) {
+				if (residue) {
+					trb_status = DWC3_TRB_SIZE_TRBSTS(trb->size);
+					if (trb_status == DWC3_TRBSTS_MISSED_ISOC) {
+						dev_dbg(dwc->dev, "incomplete IN transfer %s\n",
+								dep->name);
+						dep->current_uf = event->parameters &
+							~(dep->interval - 1);
+						dep->flags |= DWC3_EP_MISSED_ISOC;
+					} else {
+						dev_err(dwc->dev, "incomplete IN transfer %s\n",
+								dep->name);
+						status = -ECONNRESET;
+					}
 				}
+			} else {
+				if (residue &&
+					(event->status & DEPEVT_STATUS_SHORT))
+					s_pkt = 1;
 			}
-		} else {
-			if (count && (event->status & DEPEVT_STATUS_SHORT))
-				s_pkt = 1;
 		}
 
 		/*
@@ -1806,6 +1837,7 @@ static void dwc3_endpoint_transfer_complete(struct dwc3 *dwc,
 	clean_busy = dwc3_cleanup_done_reqs(dwc, dep, event, status);
 	if (clean_busy)
 		dep->flags &= ~DWC3_EP_BUSY;
+	dep->flags |= DWC3_EP_COMPLETED;
 
 	/*
 	 * WORKAROUND: This is the 2nd half of U1/U2 -> U0 workaround.
@@ -2451,6 +2483,61 @@ static irqreturn_t dwc3_process_event_buf(struct dwc3 *dwc, u32 buf)
 	return IRQ_HANDLED;
 }
 
+/* let function drivers finish the requests this interrupt gave back */
+static void dwc3_gadget_complete_batches(struct dwc3 *dwc)
+{
+	struct dwc3_ep		*dep;
+	int			i;
+
+	for (i = 2; i < DWC3_ENDPOINTS_NUM; i++) {
+		dep = dwc->eps[i];
+		if (!dep || !(dep->flags & DWC3_EP_COMPLETED))
+			continue;
+
+		dep->flags &= ~DWC3_EP_COMPLETED;
+		if (!dep->endpoint.complete_batch)
+			continue;
+
+		spin_unlock(&dwc->lock);
+		dep->endpoint.complete_batch(&dep->endpoint);
+		spin_lock(&dwc->lock);
+	}
+}
+
+static void dwc3_mask_event_irqs(struct dwc3 *dwc, bool mask)
+{
+	u32			reg;
+	int			i;
+
+	for (i = 0; i < dwc->num_event_buffers; i++) {
+		reg = dwc3_readl(dwc->regs, DWC3_GEVNTSIZ(i));
+		if (mask)
+			reg |= DWC3_GEVNTSIZ_INTMASK;
+		else
+			reg &= ~DWC3_GEVNTSIZ_INTMASK;
+		dwc3_writel(dwc->regs, DWC3_GEVNTSIZ(i), reg);
+	}
+}
+
+/*
+ * Interrupt moderation. These cores predate the DEV_IMOD register, so
+ * the event buffers stay masked for imod_interval after each interrupt;
+ * events keep being written meanwhile and the next interrupt, raised as
+ * soon as they are unmasked, handles all of them.
+ */
+static enum hrtimer_restart dwc3_imod_timer(struct hrtimer *timer)
+{
+	struct dwc3		*dwc = container_of(timer, struct dwc3,
+						imod_timer);
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dwc->lock, flags);
+	dwc3_mask_event_irqs(dwc, false);
+	spin_unlock_irqrestore(&dwc->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
 static irqreturn_t dwc3_interrupt(int irq, void *_dwc)
 {
 	struct dwc3			*dwc = _dwc;
@@ -2467,6 +2554,15 @@ static irqreturn_t dwc3_interrupt(int irq, void *_dwc)
 			ret = status;
 	}
 
+	dwc3_gadget_complete_batches(dwc);
+
+	if (ret == IRQ_HANDLED && dwc->imod_interval) {
+		dwc3_mask_event_irqs(dwc, true);
+		hrtimer_start(&dwc->imod_timer,
+				ns_to_ktime(dwc->imod_interval * NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+	}
+
 	spin_unlock(&dwc->lock);
 
 	return ret;
@@ -2540,6 +2636,7 @@ int __devinit dwc3_gadget_init(struct dwc3 *dwc)
 	dwc->gadget.speed		= USB_SPEED_UNKNOWN;
 	dwc->gadget.dev.parent		= dwc->dev;
 	dwc->gadget.sg_supported	= true;
+	dwc->gadget.batched_completion	= true;
 
 	dma_set_coherent_mask(&dwc->gadget.dev, dwc->dev->coherent_dma_mask);
 
@@ -2557,6 +2654,9 @@ int __devinit dwc3_gadget_init(struct dwc3 *dwc)
 	if (ret)
 		goto err4;
 
+	hrtimer_init(&dwc->imod_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dwc->imod_timer.function = dwc3_imod_timer;
+
 	irq = platform_get_irq(to_platform_device(dwc->dev), 0);
 
 	ret = request_irq(irq, dwc3_interrupt, IRQF_SHARED,
@@ -2646,6 +2746,7 @@ void dwc3_gadget_exit(struct dwc3 *dwc)
 
 	dwc3_writel(dwc->regs, DWC3_DEVTEN, 0x00);
 	free_irq(irq, dwc);
+	hrtimer_cancel(&dwc->imod_timer);
 
 	dwc3_gadget_free_endpoints(dwc);
 
@@ -438,12 +438,26 @@ static int mtp_function_ctrlrequest(struct android_usb_function *f,
 	return mtp_ctrlrequest(cdev, c);
 }
 
+static ssize_t mtp_transfer_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	return mtp_transfer_stats(buf);
+}
+
+static DEVICE_ATTR(transfer_stats, S_IRUGO, mtp_transfer_stats_show, NULL);
+
+static struct device_attribute *mtp_function_attributes[] = {
+	&dev_attr_transfer_stats,
+	NULL
+};
+
 static struct android_usb_function mtp_function = {
 	.name		= "mtp",
 	.init		= mtp_function_init,
 	.cleanup	= mtp_function_cleanup,
 	.bind_config	= mtp_function_bind_config,
 	.ctrlrequest	= mtp_function_ctrlrequest,
+	.attributes	= mtp_function_attributes,
 };
 
 /* PTP function is same as MTP with slightly different interface descriptor */
@@ -452,6 +466,7 @@ static struct android_usb_function ptp_function = {
 	.init		= ptp_function_init,
 	.cleanup	= ptp_function_cleanup,
 	.bind_config	= ptp_function_bind_config,
+	.attributes	= mtp_function_attributes,
 };
 
 
@@ -30,6 +30,11 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/scatterlist.h>
+#include <linux/vmalloc.h>
+#include <linux/highmem.h>
+#include <linux/pagemap.h>
+#include <linux/ktime.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -37,6 +42,9 @@
 #include <linux/usb/f_mtp.h>
 
 #define MTP_BULK_BUFFER_SIZE       16384
+/* file transfer requests, built from pages when the UDC can do sg */
+#define MTP_SG_BUFFER_SIZE         (64 * 1024)
+#define MTP_SG_PAGES               (MTP_SG_BUFFER_SIZE / PAGE_SIZE)
 #define INTR_BUFFER_SIZE           28
 
 /* String IDs */
@@ -110,6 +118,31 @@ struct mtp_dev {
 	int xfer_result;
 
 	int zlp_maxpacket;
+
+	/* largest transfer the tx and rx requests can carry */
+	int tx_buf_size;
+	int rx_buf_size;
+
+	/* completed file transfers, for the transfer_stats attribute */
+	struct mtp_xfer_stats {
+		unsigned long files;
+		unsigned long zero_copy;
+		u64 bytes;
+		u64 time_ns;
+		u64 cpu_ns;
+	} send_stats, receive_stats;
+};
+
+/* request->context of page-backed requests, request->buf maps the pages */
+struct mtp_sg_buf {
+	struct page *pages[MTP_SG_PAGES];
+	/*
+	 * page cache pages a zero-copy request points at, held until it
+	 * completes. The data header takes one more sg entry in front.
+	 */
+	struct page *file_pages[MTP_SG_PAGES];
+	int n_file_pages;
+	struct scatterlist sg[MTP_SG_PAGES + 1];
 };
 
 static struct usb_interface_descriptor mtp_interface_desc = {
@@ -344,6 +377,7 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 		return NULL;
 
 	/* now allocate buffers for the requests */
+	req->context = NULL;
 	req->buf = kmalloc(buffer_size, GFP_KERNEL);
 	if (!req->buf) {
 		usb_ep_free_request(ep, req);
@@ -355,12 +389,235 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 
 static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
 {
+	struct mtp_sg_buf *sb;
+	int i;
+
 	if (req) {
-		kfree(req->buf);
+		sb = req->context;
+		if (sb) {
+			for (i = 0; i < sb->n_file_pages; i++)
+				page_cache_release(sb->file_pages[i]);
+			if (req->buf)
+				vunmap(req->buf);
+			for (i = 0; i < MTP_SG_PAGES; i++)
+				if (sb->pages[i])
+					__free_page(sb->pages[i]);
+			kfree(sb);
+		} else {
+			kfree(req->buf);
+		}
 		usb_ep_free_request(ep, req);
 	}
 }
 
+/*
+ * A MTP_SG_BUFFER_SIZE request backed by single pages, so it needs no
+ * high order allocation. The pages are mapped contiguously at req->buf
+ * for vfs_read() and go to the UDC as an sg list.
+ */
+static struct usb_request *mtp_sg_request_new(struct usb_ep *ep)
+{
+	struct usb_request *req = usb_ep_alloc_request(ep, GFP_KERNEL);
+	struct mtp_sg_buf *sb;
+	int i;
+
+	if (!req)
+		return NULL;
+
+	sb = kzalloc(sizeof(*sb), GFP_KERNEL);
+	if (!sb)
+		goto fail;
+	req->context = sb;
+	req->buf = NULL;
+
+	for (i = 0; i < MTP_SG_PAGES; i++) {
+		sb->pages[i] = alloc_page(GFP_KERNEL);
+		if (!sb->pages[i])
+			goto fail;
+	}
+
+	req->buf = vmap(sb->pages, MTP_SG_PAGES, VM_MAP, PAGE_KERNEL);
+	if (!req->buf)
+		goto fail;
+
+	return req;
+
+fail:
+	mtp_request_free(req, ep);
+	return NULL;
+}
+
+/*
+ * Set the length of a request about to be queued. For page-backed ones
+ * also build the sg list covering it and write back what the CPU put
+ * in through the vmap alias.
+ */
+static void mtp_req_set_length(struct usb_request *req, unsigned length)
+{
+	struct mtp_sg_buf *sb = req->context;
+	unsigned left = length;
+	unsigned n, len;
+	int i;
+
+	req->length = length;
+	if (!sb)
+		return;
+
+	/* a zero length packet still needs an entry */
+	n = length ? DIV_ROUND_UP(length, PAGE_SIZE) : 1;
+	sg_init_table(sb->sg, n);
+	for (i = 0; i < n; i++) {
+		len = min_t(unsigned, left, PAGE_SIZE);
+		sg_set_page(&sb->sg[i], sb->pages[i], len, 0);
+		left -= len;
+	}
+	req->sg = sb->sg;
+	req->num_sgs = n;
+
+	flush_kernel_vmap_range(req->buf, length);
+}
+
+/* drop the page cache pages a zero-copy request was sent from */
+static void mtp_req_put_file_pages(struct usb_request *req)
+{
+	struct mtp_sg_buf *sb = req->context;
+
+	if (!sb)
+		return;
+	while (sb->n_file_pages)
+		page_cache_release(sb->file_pages[--sb->n_file_pages]);
+}
+
+/*
+ * Look up an uptodate page cache page of @filp, reading it and kicking
+ * readahead for the @nr_pages the transfer still needs as the normal
+ * read path would.
+ */
+static struct page *mtp_get_file_page(struct file *filp, pgoff_t index,
+				      unsigned long nr_pages)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct page *page;
+
+	page = find_get_page(mapping, index);
+	if (!page) {
+		page_cache_sync_readahead(mapping, &filp->f_ra, filp,
+					  index, nr_pages);
+		page = find_get_page(mapping, index);
+	}
+	if (page && PageReadahead(page))
+		page_cache_async_readahead(mapping, &filp->f_ra, filp,
+					   page, index, nr_pages);
+	if (page && PageUptodate(page))
+		return page;
+	if (page)
+		page_cache_release(page);
+
+	return read_mapping_page(mapping, index, filp);
+}
+
+/*
+ * Point a page-backed tx request straight at the page cache pages
+ * holding up to @len bytes of @filp at *@offset, behind @hdr_size header
+ * bytes already in req->buf, instead of copying them in with vfs_read().
+ * A chunk never spans more than MTP_SG_PAGES pages, so it may come out
+ * shorter than asked. Returns the number of file bytes in the request,
+ * 0 at end of file, or a negative errno.
+ */
+static int mtp_req_map_file(struct usb_request *req, struct file *filp,
+			    loff_t *offset, int len, int hdr_size,
+			    int64_t left)
+{
+	struct mtp_sg_buf *sb = req->context;
+	loff_t size = i_size_read(filp->f_mapping->host);
+	unsigned poff = *offset & ~PAGE_CACHE_MASK;
+	pgoff_t index = *offset >> PAGE_CACHE_SHIFT;
+	unsigned long nr_pages;
+	struct page *page;
+	int n = 0, done = 0, chunk;
+
+	if (*offset >= size)
+		len = 0;
+	else if (len > size - *offset)
+		len = size - *offset;
+	len = min_t(int, len, MTP_SG_BUFFER_SIZE - poff);
+	if (!len && !hdr_size) {
+		mtp_req_set_length(req, 0);
+		return 0;
+	}
+
+	sg_init_table(sb->sg, ARRAY_SIZE(sb->sg));
+	if (hdr_size) {
+		flush_kernel_vmap_range(req->buf, hdr_size);
+		sg_set_page(&sb->sg[n++], sb->pages[0], hdr_size, 0);
+	}
+
+	while (done < len) {
+		nr_pages = (poff + left + PAGE_CACHE_SIZE - 1) >>
+						PAGE_CACHE_SHIFT;
+		page = mtp_get_file_page(filp, index, nr_pages);
+		if (IS_ERR(page)) {
+			mtp_req_put_file_pages(req);
+			return PTR_ERR(page);
+		}
+		sb->file_pages[sb->n_file_pages++] = page;
+
+		chunk = min_t(int, len - done, PAGE_CACHE_SIZE - poff);
+		sg_set_page(&sb->sg[n++], page, chunk, poff);
+		done += chunk;
+		left -= chunk;
+		poff = 0;
+		index++;
+	}
+	sg_mark_end(&sb->sg[n - 1]);
+
+	req->sg = sb->sg;
+	req->num_sgs = n;
+	req->length = hdr_size + done;
+	*offset += done;
+
+	return done;
+}
+
+static void mtp_account_xfer(struct mtp_xfer_stats *stats, int64_t bytes,
+			     ktime_t start, u64 cpu_start, bool zero_copy)
+{
+	stats->files++;
+	if (zero_copy)
+		stats->zero_copy++;
+	stats->bytes += bytes;
+	stats->time_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	stats->cpu_ns += current->se.sum_exec_runtime - cpu_start;
+}
+
+static int mtp_print_xfer_stats(char *buf, int size, const char *dir,
+				struct mtp_xfer_stats *stats)
+{
+	u64 time_us = div_u64(stats->time_ns, NSEC_PER_USEC);
+	u64 cpu_us = div_u64(stats->cpu_ns, NSEC_PER_USEC);
+
+	return scnprintf(buf, size,
+		"%s: files %lu zero_copy %lu bytes %llu %llu kB/s %llu cpu us/MB\n",
+		dir, stats->files, stats->zero_copy, stats->bytes,
+		time_us ? div64_u64(stats->bytes * 1000, time_us) : 0ULL,
+		stats->bytes ? div64_u64(cpu_us << 20, stats->bytes) : 0ULL);
+}
+
+/* file transfer totals since the function was set up, for android.c */
+static ssize_t mtp_transfer_stats(char *buf)
+{
+	struct mtp_dev *dev = _mtp_dev;
+	int n;
+
+	if (!dev)
+		return -ENODEV;
+
+	n = mtp_print_xfer_stats(buf, PAGE_SIZE, "send", &dev->send_stats);
+	n += mtp_print_xfer_stats(buf + n, PAGE_SIZE - n, "receive",
+				  &dev->receive_stats);
+	return n;
+}
+
 static inline int mtp_lock(atomic_t *excl)
 {
 	if (atomic_inc_return(excl) == 1) {
@@ -412,6 +669,7 @@ static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
+	mtp_req_put_file_pages(req);
 	mtp_req_put(dev, &dev->tx_idle, req);
 
 	wake_up(&dev->write_wq);
@@ -488,16 +746,38 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	ep->driver_data = dev;		/* claim the endpoint */
 	dev->ep_intr = ep;
 
+	/*
+	 * With sg support file data goes out in MTP_SG_BUFFER_SIZE requests
+	 * made of single pages. Received data is written to the file from
+	 * the request, so rx just gets larger buffers when memory allows.
+	 */
+	dev->tx_buf_size = cdev->gadget->sg_supported ?
+				MTP_SG_BUFFER_SIZE : MTP_BULK_BUFFER_SIZE;
+	dev->rx_buf_size = MTP_SG_BUFFER_SIZE;
+
 	/* now allocate requests for our endpoints */
 	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
+		if (cdev->gadget->sg_supported)
+			req = mtp_sg_request_new(dev->ep_in);
+		else
+			req = mtp_request_new(dev->ep_in,
+					      MTP_BULK_BUFFER_SIZE);
 		if (!req)
 			goto fail;
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
 	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
+		req = mtp_request_new(dev->ep_out, dev->rx_buf_size);
+		if (!req && dev->rx_buf_size > MTP_BULK_BUFFER_SIZE) {
+			/* fall back to small buffers for all of them */
+			while (--i >= 0) {
+				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
+			dev->rx_buf_size = MTP_BULK_BUFFER_SIZE;
+			continue;
+		}
 		if (!req)
 			goto fail;
 		req->complete = mtp_complete_out;
@@ -665,7 +945,7 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		req->length = xfer;
+		mtp_req_set_length(req, xfer);
 		ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
 		if (ret < 0) {
 			DBG(cdev, "mtp_write: xfer error %d\n", ret);
@@ -708,6 +988,9 @@ static void send_file_work(struct work_struct *data)
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
+	bool zero_copy;
+	ktime_t start = ktime_get();
+	u64 cpu_start = current->se.sum_exec_runtime;
 
 	/* read our parameters */
 	smp_rmb();
@@ -715,6 +998,14 @@ static void send_file_work(struct work_struct *data)
 	offset = dev->xfer_file_offset;
 	count = dev->xfer_file_length;
 
+	/*
+	 * With page-backed requests regular files go out of the page cache
+	 * as they are, other files are still copied in.
+	 */
+	zero_copy = dev->tx_buf_size == MTP_SG_BUFFER_SIZE &&
+		    S_ISREG(filp->f_mapping->host->i_mode) &&
+		    filp->f_mapping->a_ops->readpage;
+
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
 	if (dev->xfer_send_header) {
@@ -749,8 +1040,8 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_buf_size)
+			xfer = dev->tx_buf_size;
 		else
 			xfer = count;
 
@@ -764,8 +1055,13 @@ static void send_file_work(struct work_struct *data)
 					__cpu_to_le32(dev->xfer_transaction_id);
 		}
 
-		ret = vfs_read(filp, req->buf + hdr_size, xfer - hdr_size,
-								&offset);
+		if (zero_copy)
+			ret = mtp_req_map_file(req, filp, &offset,
+					xfer - hdr_size, hdr_size,
+					count - hdr_size);
+		else
+			ret = vfs_read(filp, req->buf + hdr_size,
+					xfer - hdr_size, &offset);
 		if (ret < 0) {
 			r = ret;
 			break;
@@ -773,10 +1069,12 @@ static void send_file_work(struct work_struct *data)
 		xfer = ret + hdr_size;
 		hdr_size = 0;
 
-		req->length = xfer;
+		if (!zero_copy)
+			mtp_req_set_length(req, xfer);
 		ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
 		if (ret < 0) {
 			DBG(cdev, "send_file_work: xfer error %d\n", ret);
+			mtp_req_put_file_pages(req);
 			dev->state = STATE_ERROR;
 			r = -EIO;
 			break;
@@ -791,6 +1089,10 @@ static void send_file_work(struct work_struct *data)
 	if (req)
 		mtp_req_put(dev, &dev->tx_idle, req);
 
+	if (!r)
+		mtp_account_xfer(&dev->send_stats, dev->xfer_file_length,
+				 start, cpu_start, zero_copy);
+
 	DBG(cdev, "send_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -810,6 +1112,9 @@ static void receive_file_work(struct work_struct *data)
 	int ret, cur_buf = 0;
 	int r = 0;
 	unsigned int rem = 0;
+	ktime_t start = ktime_get();
+	u64 cpu_start = current->se.sum_exec_runtime;
+	int64_t received = 0;
 
 	/* read our parameters */
 	smp_rmb();
@@ -825,8 +1130,8 @@ static void receive_file_work(struct work_struct *data)
 			read_req = dev->rx_req[cur_buf];
 			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
 
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
+			read_req->length = (count > dev->rx_buf_size
+					? dev->rx_buf_size : count);
 
 			/* Pass maxpacket length for RX(out) case:
 			   buffer size is large enough to accomodate */
@@ -854,6 +1159,7 @@ static void receive_file_work(struct work_struct *data)
 				dev->state = STATE_ERROR;
 				break;
 			}
+			received += ret;
 			write_req = NULL;
 		}
 
@@ -886,6 +1192,10 @@ static void receive_file_work(struct work_struct *data)
 		}
 	}
 
+	if (!r)
+		mtp_account_xfer(&dev->receive_stats, received, start,
+				 cpu_start, false);
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -267,9 +267,35 @@ enomem:
 	return retval;
 }
 
+/* pass the unwrapped frames up, or drop them all if unwrap failed */
+static void rx_frames_deliver(struct eth_dev *dev, int status)
+{
+	struct sk_buff	*skb;
+
+	while ((skb = skb_dequeue(&dev->rx_frames))) {
+		if (status < 0
+				|| ETH_HLEN > skb->len
+				|| skb->len > ETH_FRAME_LEN) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx length %d\n", skb->len);
+			dev_kfree_skb_any(skb);
+			continue;
+		}
+		skb->protocol = eth_type_trans(skb, dev->net);
+		dev->net->stats.rx_packets++;
+		dev->net->stats.rx_bytes += skb->len;
+
+		/* no buffer copies needed, unless hardware can't
+		 * use skb buffers.
+		 */
+		netif_rx(skb);
+	}
+}
+
 static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context, *skb2;
+	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
 
@@ -297,28 +323,11 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 		}
 		skb = NULL;
 
-		skb2 = skb_dequeue(&dev->rx_frames);
-		while (skb2) {
-			if (status < 0
-					|| ETH_HLEN > skb2->len
-					|| skb2->len > ETH_FRAME_LEN) {
-				dev->net->stats.rx_errors++;
-				dev->net->stats.rx_length_errors++;
-				DBG(dev, "rx length %d\n", skb2->len);
-				dev_kfree_skb_any(skb2);
-				goto next_frame;
-			}
-			skb2->protocol = eth_type_trans(skb2, dev->net);
-			dev->net->stats.rx_packets++;
-			dev->net->stats.rx_bytes += skb2->len;
-
-			/* no buffer copies needed, unless hardware can't
-			 * use skb buffers.
-			 */
-			status = netif_rx(skb2);
-next_frame:
-			skb2 = skb_dequeue(&dev->rx_frames);
-		}
+		/* with batched completion the frames of every request
+		 * completed by this interrupt go up together
+		 */
+		if (status < 0 || !ep->complete_batch)
+			rx_frames_deliver(dev, status);
 		break;
 
 	/* software-driven interface shutdown */
@@ -477,7 +486,23 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	dev_kfree_skb_any(skb);
 
 	atomic_dec(&dev->tx_qlen);
-	if (netif_carrier_ok(dev->net))
+	if (!ep->complete_batch && netif_carrier_ok(dev->net))
+		netif_wake_queue(dev->net);
+}
+
+static void rx_complete_batch(struct usb_ep *ep)
+{
+	struct eth_dev	*dev = ep->driver_data;
+
+	if (dev)
+		rx_frames_deliver(dev, 0);
+}
+
+static void tx_complete_batch(struct usb_ep *ep)
+{
+	struct eth_dev	*dev = ep->driver_data;
+
+	if (dev && netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
 
@@ -909,6 +934,11 @@ struct net_device *gether_connect(struct gether *link)
 		result = alloc_requests(dev, link, qlen(dev->gadget));
 
 	if (result == 0) {
+		if (dev->gadget->batched_completion) {
+			link->in_ep->complete_batch = tx_complete_batch;
+			link->out_ep->complete_batch = rx_complete_batch;
+		}
+
 		dev->zlp = link->is_zlp_ok;
 		DBG(dev, "qlen %d\n", qlen(dev->gadget));
 
@@ -1005,6 +1035,10 @@ void gether_disconnect(struct gether *link)
 	link->out_ep->driver_data = NULL;
 	link->out_ep->desc = NULL;
 
+	link->in_ep->complete_batch = NULL;
+	link->out_ep->complete_batch = NULL;
+	skb_queue_purge(&dev->rx_frames);
+
 	/* finish forgetting about this USB link episode */
 	dev->header_len = 0;
 	dev->unwrap = NULL;
@@ -199,6 +199,7 @@ static int ehci_hcd_omap_probe(struct platform_device *pdev)
 
 	pm_runtime_enable(dev);
 	pm_runtime_get_sync(dev);
+	device_enable_async_suspend(dev);
 
 	/*
 	 * An undocumented "feature" in the OMAP3 EHCI controller,
@@ -1813,6 +1813,7 @@ allocate_instance(struct device *dev,
 	INIT_LIST_HEAD(&musb->control);
 	INIT_LIST_HEAD(&musb->in_bulk);
 	INIT_LIST_HEAD(&musb->out_bulk);
+	musb->ep_stats_start = jiffies;
 
 	hcd->uses_new_polling = 1;
 	hcd->has_tt = 1;
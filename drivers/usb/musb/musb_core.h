@@ -231,6 +231,15 @@ struct musb_platform_ops {
 				dma_addr_t *dma_addr, u32 *len);
 };
 
+/* host side traffic through one direction of a hardware endpoint */
+struct musb_ep_stats {
+	unsigned long		urbs;
+	u64			bytes;
+	unsigned long		nak_timeouts;	/* RX NAK limit hits */
+	unsigned long		rotations;	/* switched to another qh */
+	unsigned long		dma_reclaims;	/* idle channel taken over */
+};
+
 /*
  * struct musb_hw_ep - endpoint hardware (bidirectional)
  *
@@ -276,6 +285,9 @@ struct musb_hw_ep {
 	u8			rx_reinit;
 	u8			tx_reinit;
 
+	struct musb_ep_stats	tx_stats;
+	struct musb_ep_stats	rx_stats;
+
 	/* peripheral side */
 	struct musb_ep		ep_in;			/* TX */
 	struct musb_ep		ep_out;			/* RX */
@@ -350,6 +362,9 @@ struct musb {
 	struct list_head	in_bulk;	/* of musb_qh */
 	struct list_head	out_bulk;	/* of musb_qh */
 
+	/* when the per endpoint host stats were last cleared, in jiffies */
+	unsigned long		ep_stats_start;
+
 	struct timer_list	otg_timer;
 	struct notifier_block	nb;
 
@@ -235,6 +235,82 @@ static const struct file_operations musb_test_mode_fops = {
 	.release		= single_release,
 };
 
+static void musb_ep_stats_print(struct seq_file *s, struct musb_hw_ep *hw_ep,
+		const char *dir, struct musb_ep_stats *stats,
+		struct dma_channel *dma, unsigned long ms)
+{
+	if (!stats->urbs && !dma)
+		return;
+
+	seq_printf(s, "ep%-2d %s: urbs %lu bytes %llu %llu kB/s "
+			"naks %lu rotations %lu dma %s reclaims %lu\n",
+			hw_ep->epnum, dir, stats->urbs, stats->bytes,
+			ms ? div_u64(stats->bytes, ms) : 0ULL,
+			stats->nak_timeouts, stats->rotations,
+			dma ? "yes" : "no", stats->dma_reclaims);
+}
+
+static int musb_ep_stats_show(struct seq_file *s, void *unused)
+{
+	struct musb		*musb = s->private;
+	struct musb_hw_ep	*hw_ep;
+	unsigned long		flags;
+	unsigned long		ms;
+	unsigned		i;
+
+	spin_lock_irqsave(&musb->lock, flags);
+
+	ms = jiffies_to_msecs(jiffies - musb->ep_stats_start);
+	seq_printf(s, "since %lu ms\n", ms);
+
+	for (i = 1; i < musb->nr_endpoints; i++) {
+		hw_ep = musb->endpoints + i;
+		musb_ep_stats_print(s, hw_ep, "tx", &hw_ep->tx_stats,
+				hw_ep->tx_channel, ms);
+		musb_ep_stats_print(s, hw_ep, "rx", &hw_ep->rx_stats,
+				hw_ep->rx_channel, ms);
+	}
+
+	spin_unlock_irqrestore(&musb->lock, flags);
+
+	return 0;
+}
+
+static int musb_ep_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, musb_ep_stats_show, inode->i_private);
+}
+
+/* any write clears the counters */
+static ssize_t musb_ep_stats_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file		*s = file->private_data;
+	struct musb		*musb = s->private;
+	unsigned long		flags;
+	unsigned		i;
+
+	spin_lock_irqsave(&musb->lock, flags);
+	for (i = 0; i < musb->nr_endpoints; i++) {
+		memset(&musb->endpoints[i].tx_stats, 0,
+				sizeof(struct musb_ep_stats));
+		memset(&musb->endpoints[i].rx_stats, 0,
+				sizeof(struct musb_ep_stats));
+	}
+	musb->ep_stats_start = jiffies;
+	spin_unlock_irqrestore(&musb->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations musb_ep_stats_fops = {
+	.open			= musb_ep_stats_open,
+	.write			= musb_ep_stats_write,
+	.read			= seq_read,
+	.llseek			= seq_lseek,
+	.release		= single_release,
+};
+
 int __devinit musb_init_debugfs(struct musb *musb)
 {
 	struct dentry		*root;
@@ -261,6 +337,13 @@ int __devinit musb_init_debugfs(struct musb *musb)
 		goto err1;
 	}
 
+	file = debugfs_create_file("ep_stats", S_IRUGO | S_IWUSR,
+			root, musb, &musb_ep_stats_fops);
+	if (!file) {
+		ret = -ENOMEM;
+		goto err1;
+	}
+
 	musb_debugfs_root = root;
 
 	return 0;
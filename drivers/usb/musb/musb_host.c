@@ -46,6 +46,19 @@
 #include "musb_core.h"
 #include "musb_host.h"
 
+/*
+ * NAK limit for bulk IN endpoints sharing the bulk hardware endpoint,
+ * as 2^(n-1) microframes (high speed) or frames (full speed). A lower
+ * limit rotates to the next qh sooner, when a device has nothing to
+ * send, at some cost in interrupts.
+ */
+static unsigned bulk_nak_hs = 8;
+module_param(bulk_nak_hs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(bulk_nak_hs, "multiplexed bulk RX NAK limit, high speed");
+
+static unsigned bulk_nak_fs = 4;
+module_param(bulk_nak_fs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(bulk_nak_fs, "multiplexed bulk RX NAK limit, full speed");
 
 /* MUSB HOST status 22-mar-2006
  *
@@ -349,11 +362,15 @@ static void musb_advance_schedule(struct musb *musb, struct urb *urb,
 {
 	struct musb_qh		*qh = musb_ep_get_qh(hw_ep, is_in);
 	struct musb_hw_ep	*ep = qh->hw_ep;
+	struct musb_ep_stats	*stats = is_in ? &ep->rx_stats : &ep->tx_stats;
 	int			ready = qh->is_ready;
 	int			status;
 
 	status = (urb->status == -EINPROGRESS) ? 0 : urb->status;
 
+	stats->urbs++;
+	stats->bytes += urb->actual_length;
+
 	/* save toggle eagerly, for paranoia */
 	switch (qh->type) {
 	case USB_ENDPOINT_XFER_BULK:
@@ -410,6 +427,27 @@ static void musb_advance_schedule(struct musb *musb, struct urb *urb,
 			qh = NULL;
 			break;
 		}
+	} else if (qh->mux == 1 && qh->type == USB_ENDPOINT_XFER_BULK) {
+		struct list_head	*head = is_in ?
+					&musb->in_bulk : &musb->out_bulk;
+		struct musb_qh		*next_qh;
+
+		/* round robin between the endpoints sharing the hardware,
+		 * one URB each, so a busy one can't starve the others
+		 */
+		if (!list_is_singular(head)) {
+			next_qh = list_entry(qh->ring.next,
+					struct musb_qh, ring);
+			if (next_qh->is_ready) {
+				list_move_tail(&qh->ring, head);
+				qh = next_qh;
+				if (is_in)
+					ep->rx_reinit = 1;
+				else
+					ep->tx_reinit = 1;
+				stats->rotations++;
+			}
+		}
 	}
 
 	if (qh != NULL && qh->is_ready) {
@@ -667,6 +705,43 @@ static bool musb_tx_dma_program(struct dma_controller *dma,
 	return true;
 }
 
+/*
+ * DMA channels stay with the hardware endpoint that first used them, so
+ * a busy endpoint doesn't pay for channel setup on every transfer. When
+ * they have all been handed out, take one back from an endpoint with
+ * nothing scheduled in that direction.
+ */
+static struct dma_channel *musb_reclaim_dma_channel(struct musb *musb,
+		struct musb_hw_ep *hw_ep, int is_out)
+{
+	struct dma_controller	*c = musb->dma_controller;
+	struct musb_hw_ep	*ep;
+	struct dma_channel	**channel;
+	int			epnum;
+
+	for (epnum = 1, ep = musb->endpoints + 1;
+			epnum < musb->nr_endpoints;
+			epnum++, ep++) {
+		if (ep == hw_ep || musb_ep_get_qh(ep, !is_out))
+			continue;
+
+		channel = is_out ? &ep->tx_channel : &ep->rx_channel;
+		if (!*channel || (*channel)->status != MUSB_DMA_STATUS_FREE)
+			continue;
+
+		c->channel_release(*channel);
+		*channel = NULL;
+		if (is_out)
+			hw_ep->tx_stats.dma_reclaims++;
+		else
+			hw_ep->rx_stats.dma_reclaims++;
+
+		return c->channel_alloc(c, hw_ep, is_out);
+	}
+
+	return NULL;
+}
+
 /*
  * Program an HDRC endpoint as per the given URB
  * Context: irqs blocked, controller lock held
@@ -701,6 +776,9 @@ static void musb_ep_program(struct musb *musb, u8 epnum,
 		if (!dma_channel) {
 			dma_channel = dma_controller->channel_alloc(
 					dma_controller, hw_ep, is_out);
+			if (!dma_channel)
+				dma_channel = musb_reclaim_dma_channel(musb,
+						hw_ep, is_out);
 			if (is_out)
 				hw_ep->tx_channel = dma_channel;
 			else
@@ -1404,6 +1482,7 @@ static void musb_bulk_rx_nak_timeout(struct musb *musb, struct musb_hw_ep *ep)
 
 		/* move cur_qh to end of queue */
 		list_move_tail(&cur_qh->ring, &musb->in_bulk);
+		ep->rx_stats.rotations++;
 
 		/* get the next qh from musb->in_bulk */
 		next_qh = first_qh(&musb->in_bulk);
@@ -1487,6 +1566,7 @@ void musb_host_rx(struct musb *musb, u8 epnum)
 			 * reads posted at all times, which will starve
 			 * other devices without this logic.
 			 */
+			hw_ep->rx_stats.nak_timeouts++;
 			if (usb_pipebulk(urb->pipe)
 					&& qh->mux == 1
 					&& !list_is_singular(&musb->in_bulk)) {
@@ -1857,12 +1937,13 @@ static int musb_schedule(
 		 * multiplexed.  This scheme doen't work in high speed to full
 		 * speed scenario as NAK interrupts are not coming from a
 		 * full speed device connected to a high speed device.
-		 * NAK timeout interval is 8 (128 uframe or 16ms) for HS and
-		 * 4 (8 frame or 8ms) for FS device.
+		 * NAK timeout interval defaults to 8 (128 uframe or 16ms) for
+		 * HS and 4 (8 frame or 8ms) for FS device.
 		 */
 		if (is_in && qh->dev)
-			qh->intv_reg =
-				(USB_SPEED_HIGH == qh->dev->speed) ? 8 : 4;
+			qh->intv_reg = clamp_t(unsigned,
+				(USB_SPEED_HIGH == qh->dev->speed) ?
+					bulk_nak_hs : bulk_nak_fs, 2, 16);
 		goto success;
 	} else if (best_end < 0) {
 		return -ENOSPC;
@@ -520,6 +520,8 @@ static int __devinit omap2430_probe(struct platform_device *pdev)
 	}
 
 	pm_runtime_enable(&pdev->dev);
+	device_enable_async_suspend(&pdev->dev);
+	device_enable_async_suspend(&musb->dev);
 
 	ret = platform_device_add(musb);
 	if (ret) {
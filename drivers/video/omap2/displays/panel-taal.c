@@ -961,6 +961,7 @@ static int taal_probe(struct omap_dss_device *dssdev)
 	dssdev->panel.config = OMAP_DSS_LCD_TFT;
 	dssdev->panel.timings = panel_config->timings;
 	dssdev->panel.dsi_pix_fmt = OMAP_DSS_DSI_FMT_RGB888;
+	dssdev->caps |= OMAP_DSS_DISPLAY_CAP_PARTIAL_UPDATE;
 
 	td = kzalloc(sizeof(*td), GFP_KERNEL);
 	if (!td) {
@@ -1441,10 +1442,12 @@ static int taal_update(struct omap_dss_device *dssdev,
 		goto err;
 	}
 
+	r = omap_dsi_prepare_update(dssdev, &x, &y, &w, &h);
+	if (r)
+		goto err;
+
 	/* XXX no need to send this every frame, but dsi break if not done */
-	r = taal_set_update_window(td, 0, 0,
-			td->panel_config->timings.x_res,
-			td->panel_config->timings.y_res);
+	r = taal_set_update_window(td, x, y, w, h);
 	if (r)
 		goto err;
 
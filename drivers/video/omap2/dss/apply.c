@@ -21,6 +21,7 @@
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/jiffies.h>
+#include <linux/completion.h>
 #include <linux/ratelimit.h>
 #include <linux/seq_file.h>
 
@@ -80,6 +81,14 @@ struct ovl_priv_data {
 	bool info_dirty;
 	struct omap_overlay_info info;
 
+	/*
+	 * info as last written to DISPC, before dispc_ovl_setup() adjusted
+	 * it, and whether info only differs from it in buffer addresses
+	 */
+	bool prog_valid;
+	struct omap_overlay_info prog_info;
+	bool addr_only;
+
 	/* callback data for the last 3 states */
 	struct callback_states cb;
 	/* overlay's channel in DISPC */
@@ -108,6 +117,8 @@ struct mgr_priv_data {
 
 	bool info_dirty;
 	struct omap_overlay_manager_info info;
+	/* only the callback changed, DISPC registers are up to date */
+	bool cb_only;
 
 	bool shadow_info_dirty;
 
@@ -592,6 +603,17 @@ static void dss_ovl_write_regs(struct omap_overlay *ovl)
 
 	oi = &op->info;
 
+	if (op->addr_only &&
+	    !dispc_ovl_set_addr(ovl->id, oi->paddr, oi->p_uv_addr)) {
+		op->prog_info.paddr = oi->paddr;
+		op->prog_info.p_uv_addr = oi->p_uv_addr;
+		goto done;
+	}
+
+	/* dispc_ovl_setup() modifies oi, so keep what we were asked for */
+	op->prog_info = *oi;
+	op->prog_valid = false;
+
 	replication = dss_use_replication(ovl->manager->device, oi->color_mode);
 
 	ilace = ovl->manager->device->type == OMAP_DISPLAY_TYPE_VENC;
@@ -614,7 +636,9 @@ static void dss_ovl_write_regs(struct omap_overlay *ovl)
 		dss_ovl_configure_cb(&op->cb, ovl->id, op->enabled);
 		return;
 	}
+	op->prog_valid = true;
 
+done:
 	mp = get_mgr_priv(ovl->manager);
 
 	op->info_dirty = false;
@@ -674,7 +698,8 @@ static void dss_mgr_write_regs(struct omap_overlay_manager *mgr)
 	}
 
 	if (mp->info_dirty) {
-		dispc_mgr_setup(mgr->id, &mp->info);
+		if (!mp->cb_only)
+			dispc_mgr_setup(mgr->id, &mp->info);
 		mp->info_dirty = false;
 		if (mp->updating) {
 			dss_ovl_configure_cb(&mp->cb, mgr->id, used_ovls);
@@ -1106,6 +1131,7 @@ int dss_mgr_blank(struct omap_overlay_manager *mgr,
 
 		op->user_info_dirty = false;
 		op->info_dirty = true;
+		op->addr_only = false;
 		op->enabled = false;
 		spin_unlock_irqrestore(&data_lock, flags);
 	}
@@ -1120,6 +1146,7 @@ int dss_mgr_blank(struct omap_overlay_manager *mgr,
 	mp->cb.info.fn = NULL;
 	mp->user_info.cb.fn = NULL;
 	mp->info_dirty = true;
+	mp->cb_only = false;
 	mp->user_info_dirty = false;
 
 	/*
@@ -1199,15 +1226,58 @@ int omap_dss_manager_unregister_callback(struct omap_overlay_manager *mgr,
 	return r;
 }
 
+void omap_dss_get_error_counts(struct omapdss_error_counts *c)
+{
+	dispc_get_error_counts(&c->underflows, &c->sync_lost);
+}
+
+/* compare overlay infos, ignoring callbacks and optionally addresses */
+static bool dss_ovl_info_equal(const struct omap_overlay_info *a,
+		const struct omap_overlay_info *b, bool cmp_addr)
+{
+	struct omap_overlay_info t = *b;
+
+	t.cb = a->cb;
+	if (!cmp_addr) {
+		t.paddr = a->paddr;
+		t.p_uv_addr = a->p_uv_addr;
+	}
+	return !memcmp(a, &t, sizeof(t));
+}
+
+static bool dss_mgr_info_equal(const struct omap_overlay_manager_info *a,
+		const struct omap_overlay_manager_info *b)
+{
+	struct omap_overlay_manager_info t = *b;
+
+	t.cb = a->cb;
+	return !memcmp(a, &t, sizeof(t));
+}
+
 static void omap_dss_mgr_apply_ovl(struct omap_overlay *ovl)
 {
 	struct ovl_priv_data *op;
+	bool same_layout;
 
 	op = get_ovl_priv(ovl);
 
 	if (!op->user_info_dirty)
 		return;
 
+	/*
+	 * Diff against what is in DISPC: skip unchanged overlays that have
+	 * no callback to deliver, and only rewrite the base addresses of
+	 * ones that just flipped to a new buffer.
+	 */
+	same_layout = op->enabled && op->prog_valid && !op->info_dirty &&
+		dss_ovl_info_equal(&op->prog_info, &op->user_info, false);
+	if (same_layout && !op->user_info.cb.fn &&
+	    dss_ovl_info_equal(&op->prog_info, &op->user_info, true)) {
+		op->user_info_dirty = false;
+		return;
+	}
+	op->addr_only = same_layout;
+
 	/* complete unconfigured info */
 	dss_ovl_cb(&op->cb.info, ovl->id,
 		   DSS_COMPLETION_ECLIPSED_CACHE);
@@ -1229,6 +1299,10 @@ static void omap_dss_mgr_apply_mgr(struct omap_overlay_manager *mgr)
 	if (!mp->user_info_dirty)
 		return;
 
+	/* the callback is new for every composition, but registers aren't */
+	mp->cb_only = mp->enabled && !mp->info_dirty &&
+		dss_mgr_info_equal(&mp->info, &mp->user_info);
+
 	/* complete unconfigured info */
 	dss_ovl_cb(&mp->cb.info, mgr->id,
 		   DSS_COMPLETION_ECLIPSED_CACHE);
@@ -1297,17 +1371,15 @@ int omap_dss_wb_mgr_apply(struct omap_overlay_manager *mgr,
 		return -EINVAL;
 	}
 
+	/* mem2mem mode not supported as of now */
+	if (wb->info.enabled && (wb->info.source >= OMAP_WB_GFX ||
+				 wb->info.mode != OMAP_WB_CAPTURE_MODE))
+		return -EINVAL;
+
 	spin_lock_irqsave(&data_lock, flags);
 	wbc = &dss_data.writeback_cache;
 
 	if (wb && wb->info.enabled) {
-		/* mem2mem mode not supported as of now */
-		if (wb->info.source >= OMAP_WB_GFX)
-			return -EINVAL;
-		/* if source is an overlay, mode cannot be capture */
-		if ((wb->info.source >= OMAP_WB_GFX) &&
-			(wb->info.mode != OMAP_WB_MEM2MEM_MODE))
-			return -EINVAL;
 		wbc->enabled = true;
 		wbc->mode = wb->info.mode;
 		wbc->color_mode = wb->info.dss_mode;
@@ -1351,6 +1423,111 @@ int omap_dss_wb_mgr_apply(struct omap_overlay_manager *mgr,
 	return 0;
 }
 
+#define DSS_WB_M2M_TIMEOUT_MS	100
+
+static void dss_wb_m2m_irq_handler(void *data, u32 mask)
+{
+	complete(data);
+}
+
+/*
+ * Run one memory-to-memory writeback pass: ovl, which must not be in use,
+ * fetches the buffer described by info, and writeback stores it scaled,
+ * converted and rotated as described by wb_info.  As the overlay feeds
+ * writeback directly, no blending takes place.  Blocks until the pass is
+ * done, using the writeback pipeline exclusively meanwhile.
+ */
+int omap_dss_wb_m2m(struct omap_writeback *wb, struct omap_overlay *ovl,
+		struct omap_overlay_info *info,
+		struct omap_writeback_info *wb_info)
+{
+	struct ovl_priv_data *op = get_ovl_priv(ovl);
+	struct writeback_cache_data *wbc = &dss_data.writeback_cache;
+	struct writeback_cache_data m2m = {
+		.enabled = true,
+		.mode = OMAP_WB_MEM2MEM_MODE,
+		.source = OMAP_WB_GFX + ovl->id,
+		.capturemode = OMAP_WB_CAPTURE_ALL,
+		.paddr = wb_info->paddr,
+		.p_uv_addr = wb_info->p_uv_addr,
+		.width = wb_info->width,
+		.height = wb_info->height,
+		.out_width = wb_info->out_width,
+		.out_height = wb_info->out_height,
+		.color_mode = wb_info->dss_mode,
+		.input_color_mode = info->color_mode,
+		.rotation = wb_info->rotation,
+		.rotation_type = wb_info->rotation_type,
+		.burst_size = BURST_SIZE_X8,
+		.fifo_high = 0x10,
+		.fifo_low = 0x8,
+	};
+	/* dispc_ovl_setup() adjusts the info it is given */
+	struct omap_overlay_info oi = *info;
+	DECLARE_COMPLETION_ONSTACK(done);
+	u16 x_decim, y_decim;
+	bool five_taps = true;
+	unsigned long flags;
+	int r;
+
+	if (!dss_has_feature(FEAT_WB))
+		return -ENODEV;
+
+	mutex_lock(&apply_lock);
+
+	spin_lock_irqsave(&data_lock, flags);
+	r = op->enabled || op->enabling || wbc->enabled ? -EBUSY : 0;
+	/* registers will no longer match what apply last programmed */
+	op->prog_valid = false;
+	spin_unlock_irqrestore(&data_lock, flags);
+	if (r)
+		goto err_busy;
+
+	r = dispc_runtime_get();
+	if (r)
+		goto err_busy;
+
+	r = omap_dispc_register_isr(dss_wb_m2m_irq_handler, &done,
+			DISPC_IRQ_FRAMEDONEWB);
+	if (r)
+		goto err_isr;
+
+	spin_lock_irqsave(&data_lock, flags);
+	r = dispc_scaling_decision(ovl->id, &oi, op->channel,
+			&x_decim, &y_decim, &five_taps);
+	r = r ? : dispc_ovl_setup(ovl->id, &oi, false, false,
+			x_decim, y_decim, five_taps);
+	r = r ? : dispc_setup_wb(&m2m);
+	if (!r) {
+		dispc_ovl_set_channel_out_wb(ovl->id);
+		/* in mem2mem mode enabling writeback starts the pass */
+		dispc_ovl_enable(ovl->id, true);
+		dispc_ovl_enable(OMAP_DSS_WB, true);
+	}
+	spin_unlock_irqrestore(&data_lock, flags);
+
+	if (!r) {
+		if (!wait_for_completion_timeout(&done,
+				msecs_to_jiffies(DSS_WB_M2M_TIMEOUT_MS))) {
+			DSSERR("timeout waiting for mem2mem writeback\n");
+			r = -ETIMEDOUT;
+		}
+		spin_lock_irqsave(&data_lock, flags);
+		dispc_ovl_enable(OMAP_DSS_WB, false);
+		dispc_ovl_enable(ovl->id, false);
+		dispc_ovl_set_channel_out(ovl->id, op->channel);
+		spin_unlock_irqrestore(&data_lock, flags);
+	}
+
+	omap_dispc_unregister_isr(dss_wb_m2m_irq_handler, &done,
+			DISPC_IRQ_FRAMEDONEWB);
+err_isr:
+	dispc_runtime_put();
+err_busy:
+	mutex_unlock(&apply_lock);
+	return r;
+}
+
 #ifdef CONFIG_DEBUG_FS
 static void seq_print_cb(struct seq_file *s, struct omapdss_ovl_cb *cb)
 {
@@ -1438,15 +1615,19 @@ static void dss_ovl_setup_fifo(struct omap_overlay *ovl,
 {
 	struct ovl_priv_data *op = get_ovl_priv(ovl);
 	struct omap_dss_device *dssdev;
-	u32 fifo_low, fifo_high;
+	u32 fifo_low, fifo_high, fetch_rate;
 
 	if (!op->enabled && !op->enabling)
 		return;
 
 	dssdev = ovl->manager->device;
 
+	/* size the thresholds for the info about to be programmed */
+	fetch_rate = dssdev ? dispc_ovl_fetch_rate(&op->info,
+				dssdev->panel.timings.pixel_clock) : 0;
+
 	dispc_ovl_compute_fifo_thresholds(ovl->id, &fifo_low, &fifo_high,
-			use_fifo_merge, ovl_manual_update(ovl));
+			use_fifo_merge, ovl_manual_update(ovl), fetch_rate);
 
 	dss_apply_ovl_fifo_thresholds(ovl, fifo_low, fifo_high);
 }
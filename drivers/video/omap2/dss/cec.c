@@ -28,6 +28,10 @@
 #include <linux/mm.h>
 #include <linux/completion.h>
 #include <linux/miscdevice.h>
+#include <linux/list.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <video/omapdss.h>
 #include <linux/switch.h>
 #include <video/cec.h>
@@ -51,11 +55,37 @@
 
 #define HDMI_CORE_CEC_TIMEOUT 200
 
+/* frames waiting to be sent, on all files */
+#define CEC_TX_QUEUE_LEN	16
+/* events waiting to be read, per file */
+#define CEC_EVENT_RING_LEN	32
+/* frames drained from the RX FIFO per interrupt */
+#define CEC_RX_BURST		8
+
 static struct cec_worker_data {
 	struct delayed_work dwork;
 	atomic_t state;
 } cec_work;
 
+/*
+ * An open cec device.  Its events are a ring of CEC_EVENT_RING_LEN, the
+ * oldest event is dropped when a new one does not fit.
+ */
+struct cec_file {
+	struct list_head node;
+	wait_queue_head_t wait;
+	struct cec_event events[CEC_EVENT_RING_LEN];
+	unsigned int head, tail;
+	unsigned int dropped;
+	bool rx_events;
+};
+
+struct cec_tx_entry {
+	struct list_head node;
+	struct cec_file *file;
+	struct cec_tx_req req;
+};
+
 static struct cec_t {
 	struct cec_rx_data rx_data;
 	struct switch_dev rx_switch;
@@ -70,6 +100,16 @@ static struct cec_t {
 	int power_on;
 	int route_ui_cmds;
 	bool cec_rx_data_valid;
+
+	/* async transmit and event delivery, under ev_lock */
+	spinlock_t ev_lock;
+	struct list_head files;
+	struct list_head tx_queue;
+	struct cec_tx_entry *tx_current;
+	struct work_struct tx_work;
+	unsigned int tx_pending;
+	unsigned int tx_id;
+	int rx_listeners;
 } cec;
 
 static int cec_request_dss(void)
@@ -229,10 +269,121 @@ int cec_enable_ui_event(int enable)
 }
 EXPORT_SYMBOL(cec_enable_ui_event);
 
+/* under ev_lock */
+static void cec_post_event(struct cec_file *f, const struct cec_event *ev)
+{
+	if (f->head - f->tail == CEC_EVENT_RING_LEN) {
+		f->tail++;
+		f->dropped++;
+	}
+	f->events[f->head++ % CEC_EVENT_RING_LEN] = *ev;
+	wake_up_interruptible(&f->wait);
+}
+
+static void cec_post_rx(const struct cec_rx_data *rx)
+{
+	struct cec_event ev = {
+		.type = CEC_EVENT_RX,
+		.rx = *rx,
+	};
+	struct cec_file *f;
+
+	spin_lock_irq(&cec.ev_lock);
+	list_for_each_entry(f, &cec.files, node)
+		if (f->rx_events)
+			cec_post_event(f, &ev);
+	spin_unlock_irq(&cec.ev_lock);
+}
+
+/*
+ * Sends the queued frames one at a time.  A frame can take hundreds of ms
+ * with its retries, but only this worker waits for it.
+ */
+static void cec_tx_worker(struct work_struct *work)
+{
+	struct cec_tx_entry *entry;
+	struct cec_event ev;
+	int acked, r;
+
+	for (;;) {
+		spin_lock_irq(&cec.ev_lock);
+		if (list_empty(&cec.tx_queue)) {
+			spin_unlock_irq(&cec.ev_lock);
+			break;
+		}
+		entry = list_first_entry(&cec.tx_queue, struct cec_tx_entry,
+					 node);
+		list_del(&entry->node);
+		cec.tx_current = entry;
+		spin_unlock_irq(&cec.ev_lock);
+
+		acked = -1;
+		if (cec.power_on)
+			r = cec_transmit_cmd(&entry->req.data, &acked);
+		else
+			r = -ENODEV;
+
+		memset(&ev, 0, sizeof(ev));
+		ev.type = CEC_EVENT_TX_DONE;
+		ev.id = entry->req.id;
+		ev.status = r ? r : acked < 0 ? -ETIMEDOUT : acked;
+
+		spin_lock_irq(&cec.ev_lock);
+		if (entry->file)
+			cec_post_event(entry->file, &ev);
+		cec.tx_current = NULL;
+		cec.tx_pending--;
+		spin_unlock_irq(&cec.ev_lock);
+
+		kfree(entry);
+	}
+}
+
+static int cec_queue_tx(struct cec_file *f, struct cec_tx_req *req)
+{
+	struct cec_tx_entry *entry;
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return -ENOMEM;
+
+	spin_lock_irq(&cec.ev_lock);
+	if (cec.tx_pending >= CEC_TX_QUEUE_LEN) {
+		spin_unlock_irq(&cec.ev_lock);
+		kfree(entry);
+		return -EAGAIN;
+	}
+	req->id = ++cec.tx_id;
+	entry->req = *req;
+	entry->file = f;
+	list_add_tail(&entry->node, &cec.tx_queue);
+	cec.tx_pending++;
+	spin_unlock_irq(&cec.ev_lock);
+
+	queue_work(cec.my_workq, &cec.tx_work);
+	return 0;
+}
+
 static long cec_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
 {
+	struct cec_file *f = fd->private_data;
 	void __user *argp = (void __user *)arg;
 	int r;
+
+	if (cmd == CEC_RX_EVENTS) {
+		int enable;
+
+		if (get_user(enable, (int __user *)argp))
+			return -EFAULT;
+
+		spin_lock_irq(&cec.ev_lock);
+		if (f->rx_events != !!enable)
+			cec.rx_listeners += enable ? 1 : -1;
+		f->rx_events = !!enable;
+		spin_unlock_irq(&cec.ev_lock);
+		return 0;
+	}
+
 	if (cec.power_on == 0) {
 		pr_err("HDMI not connected ++\n");
 		return -EFAULT;
@@ -270,6 +421,19 @@ static long cec_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
 				sizeof(struct cec_rx_data));
 		return r == 0 ? 0 : -EFAULT;
 	}
+	case CEC_QUEUE_TX:
+	{
+		struct cec_tx_req req;
+
+		if (copy_from_user(&req, argp, sizeof(req)))
+			return -EFAULT;
+		r = cec_queue_tx(f, &req);
+		if (r)
+			return r;
+		if (put_user(req.id, &((struct cec_tx_req __user *)argp)->id))
+			return -EFAULT;
+		return 0;
+	}
 	case CEC_GET_PHY_ADDR:
 	{
 
@@ -288,20 +452,151 @@ static long cec_ioctl(struct file *fd, unsigned int cmd, unsigned long arg)
 * CEC driver init/exit
 ******************************************************************************/
 
+static int cec_open(struct inode *inode, struct file *fd)
+{
+	struct cec_file *f;
+
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	if (!f)
+		return -ENOMEM;
+
+	init_waitqueue_head(&f->wait);
+
+	spin_lock_irq(&cec.ev_lock);
+	list_add_tail(&f->node, &cec.files);
+	spin_unlock_irq(&cec.ev_lock);
+
+	fd->private_data = f;
+	return 0;
+}
+
+static int cec_release(struct inode *inode, struct file *fd)
+{
+	struct cec_file *f = fd->private_data;
+	struct cec_tx_entry *entry, *tmp;
+	LIST_HEAD(dropped);
+
+	spin_lock_irq(&cec.ev_lock);
+	list_del(&f->node);
+	if (f->rx_events)
+		cec.rx_listeners--;
+
+	/* frames not sent yet go away, the one being sent is not reported */
+	list_for_each_entry_safe(entry, tmp, &cec.tx_queue, node) {
+		if (entry->file != f)
+			continue;
+		list_move(&entry->node, &dropped);
+		cec.tx_pending--;
+	}
+	if (cec.tx_current && cec.tx_current->file == f)
+		cec.tx_current->file = NULL;
+	spin_unlock_irq(&cec.ev_lock);
+
+	list_for_each_entry_safe(entry, tmp, &dropped, node)
+		kfree(entry);
+	if (f->dropped)
+		pr_debug("cec: %u events dropped\n", f->dropped);
+	kfree(f);
+	return 0;
+}
+
+static ssize_t cec_read(struct file *fd, char __user *buf, size_t count,
+			loff_t *ppos)
+{
+	struct cec_file *f = fd->private_data;
+	struct cec_event ev;
+	ssize_t done = 0;
+	int r;
+
+	if (count < sizeof(ev))
+		return -EINVAL;
+
+	if (!(fd->f_flags & O_NONBLOCK)) {
+		r = wait_event_interruptible(f->wait, f->head != f->tail);
+		if (r)
+			return r;
+	}
+
+	while (count - done >= sizeof(ev)) {
+		spin_lock_irq(&cec.ev_lock);
+		if (f->head == f->tail) {
+			spin_unlock_irq(&cec.ev_lock);
+			break;
+		}
+		ev = f->events[f->tail++ % CEC_EVENT_RING_LEN];
+		spin_unlock_irq(&cec.ev_lock);
+
+		if (copy_to_user(buf + done, &ev, sizeof(ev)))
+			return done ? done : -EFAULT;
+		done += sizeof(ev);
+	}
+
+	return done ? done : -EAGAIN;
+}
+
+static unsigned int cec_poll(struct file *fd, poll_table *wait)
+{
+	struct cec_file *f = fd->private_data;
+
+	poll_wait(fd, &f->wait, wait);
+
+	return f->head != f->tail ? POLLIN | POLLRDNORM : 0;
+}
+
 static const struct file_operations cec_fops = {
 	.owner = THIS_MODULE,
+	.open = cec_open,
+	.release = cec_release,
+	.read = cec_read,
+	.poll = cec_poll,
 	.unlocked_ioctl = cec_ioctl,
 };
 
 static struct miscdevice mdev;
 
+/*
+ * With files listening to CEC_EVENT_RX, the RX FIFO is drained here and
+ * every frame goes to them, user control ones also to the keyboard driver.
+ */
+static void cec_rx_drain(void)
+{
+	struct cec_rx_data rx;
+	int i, r;
+
+	r = cec_request_dss();
+	if (r) {
+		pr_err("CEC no clocks\n");
+		return;
+	}
+
+	for (i = 0; i < CEC_RX_BURST; i++) {
+		mutex_lock(&cec.lock);
+		r = cec.hdmi_data.ops->cec_read_rx_cmd(&cec.hdmi_data, &rx);
+		mutex_unlock(&cec.lock);
+		if (r)
+			break;
+
+		if (cec.route_ui_cmds && cec.key_dev.key_event &&
+		    (rx.rx_cmd == cec_cmd_u_user_control_pressed ||
+		     rx.rx_cmd == cec_cmd_u_user_control_released))
+			cec.key_dev.key_event(rx.rx_operand[0],
+				rx.rx_cmd == cec_cmd_u_user_control_pressed);
+
+		cec_post_rx(&rx);
+	}
+
+	cec_release_dss();
+}
+
 static void cec_rx_worker(struct work_struct *work)
 {
 	int r;
 	char rx_cmd;
 
-	/*UI events should be sent to keyboard driver*/
-	if (cec.route_ui_cmds && cec.key_dev.key_event) {
+	if (cec.rx_listeners) {
+		cec_rx_drain();
+	} else if (cec.route_ui_cmds && cec.key_dev.key_event) {
+		/*UI events should be sent to keyboard driver*/
 		r = cec_request_dss();
 		if (r) {
 			pr_err("CEC no clocks\n");
@@ -426,6 +721,10 @@ static int __init cec_init(void)
 	cec.power_on = 0;
 	/* Set it to unregisterd device id */
 	cec.device_id = CEC_UNREGISTERED_DEVICE;
+	spin_lock_init(&cec.ev_lock);
+	INIT_LIST_HEAD(&cec.files);
+	INIT_LIST_HEAD(&cec.tx_queue);
+	INIT_WORK(&cec.tx_work, cec_tx_worker);
 	mdev.minor = MISC_DYNAMIC_MINOR;
 	mdev.name = "cec";
 	mdev.mode = 0666;
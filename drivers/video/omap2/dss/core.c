@@ -160,6 +160,8 @@ static int dss_initialize_debugfs(void)
 	debugfs_create_file("dispc_irq", S_IRUGO, dss_debugfs_dir,
 			&dispc_dump_irqs, &dss_debug_fops);
 #endif
+	debugfs_create_file("dispc_errors", S_IRUGO, dss_debugfs_dir,
+			&dispc_dump_errors, &dss_debug_fops);
 
 #if defined(CONFIG_OMAP2_DSS_DSI) && defined(CONFIG_OMAP2_DSS_COLLECT_IRQ_STATS)
 	dsi_create_debugfs_files_irq(dss_debugfs_dir, &dss_debug_fops);
@@ -243,6 +245,9 @@ static int omap_dss_probe(struct platform_device *pdev)
 			pdata->default_device = dssdev;
 	}
 
+	/* panels are resumed from here, nothing else waits on them */
+	device_enable_async_suspend(&pdev->dev);
+
 	return 0;
 
 err_register:
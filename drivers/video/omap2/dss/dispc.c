@@ -26,6 +26,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/vmalloc.h>
 #include <linux/export.h>
+#include <linux/moduleparam.h>
 #include <linux/clk.h>
 #include <linux/io.h>
 #include <linux/jiffies.h>
@@ -37,6 +38,8 @@
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
 #include <linux/ratelimit.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
 
 #include <plat/clock.h>
 #include "../../../drivers/staging/omapdrm/omap_dmm_tiler.h"
@@ -91,12 +94,46 @@ static struct {
 
 	u32	fifo_size[MAX_DSS_OVERLAYS];
 
+	/* base address offsets from the last dispc_ovl_setup() */
+	struct {
+		bool valid;
+		bool nv12;
+		unsigned offset0, offset1;
+	} ovl_ba[MAX_DSS_OVERLAYS];
+
+	/* last TILER orientation computed for each overlay and writeback */
+	struct dispc_tiler_orient {
+		bool valid;
+		u32 paddr, p_uv_addr;
+		u32 width, height;
+		u8 rotation;
+		bool mirror;
+		struct tiler_view_t view;
+		u32 uv_tsptr;
+	} ovl_orient[MAX_DSS_OVERLAYS], wb_orient;
+
 	spinlock_t irq_lock;
 	u32 irq_error_mask;
 	struct omap_dispc_isr_data registered_isr[DISPC_MAX_NR_ISRS];
 	u32 error_irqs;
 	struct work_struct error_work;
 
+	/* error recovery state, only touched by the error worker */
+	struct mutex err_lock;
+	bool fifo_safe[MAX_DSS_OVERLAYS];
+	unsigned long underflow_time[MAX_DSS_OVERLAYS];
+	unsigned long sync_lost_time[MAX_DSS_MANAGERS];
+	struct dispc_err_stats {
+		unsigned long window_start;
+		u32 underflows, sync_lost;
+		u32 last_underflows, last_sync_lost;
+		u32 total_underflows, total_sync_lost;
+		u32 fifo_raised, ovl_disabled;
+		u32 mgr_rearmed, output_restarts;
+		u32 recoveries;
+		u64 recovery_ns, recovery_max_ns;
+	} err_stats;
+
 	bool		ctx_valid;
 	u32		ctx[DISPC_SZ_REGS / sizeof(u32)];
 
@@ -848,6 +885,14 @@ void dispc_ovl_set_channel_out(enum omap_plane plane, enum omap_channel channel)
 	dispc_write_reg(DISPC_OVL_ATTRIBUTES(plane), val);
 }
 
+/* feed the overlay to writeback only, for mem2mem mode */
+void dispc_ovl_set_channel_out_wb(enum omap_plane plane)
+{
+	BUG_ON(plane == OMAP_DSS_WB || !dss_has_feature(FEAT_WB));
+
+	REG_FLD_MOD(DISPC_OVL_ATTRIBUTES(plane), 3, 31, 30);
+}
+
 static enum omap_channel dispc_ovl_get_channel_out(enum omap_plane plane)
 {
 	int shift;
@@ -1067,9 +1112,26 @@ void dispc_enable_fifomerge(bool enable)
 	REG_FLD_MOD(DISPC_CONFIG, enable ? 1 : 0, 14, 14);
 }
 
+/*
+ * Worst case time it takes DDR to start returning data for the overlay
+ * DMA when the interconnect is busy.  The FIFO low threshold is sized so
+ * it cannot drain in this time; 0 keeps thresholds at their maximum.
+ */
+static unsigned int fifo_latency_ns = 20000;
+module_param(fifo_latency_ns, uint, 0644);
+
+/* underflows or sync losts closer than this are handled as repeated */
+#define DISPC_ERR_WINDOW	HZ
+/* how long an overlay stays on safe thresholds after an underflow */
+#define DISPC_FIFO_SAFE_HOLD	(60 * HZ)
+
+/*
+ * fetch_rate is the number of bytes per microsecond the overlay consumes
+ * while scanning out a line, see dispc_ovl_fetch_rate(), or 0 if unknown.
+ */
 void dispc_ovl_compute_fifo_thresholds(enum omap_plane plane,
 		u32 *fifo_low, u32 *fifo_high, bool use_fifomerge,
-		bool manual_update)
+		bool manual_update, u32 fetch_rate)
 {
 	/*
 	 * All sizes are in bytes. Both the buffer and burst are made of
@@ -1077,7 +1139,8 @@ void dispc_ovl_compute_fifo_thresholds(enum omap_plane plane,
 	 */
 
 	unsigned buf_unit = dss_feat_get_buffer_size_unit();
-	unsigned ovl_fifo_size, total_fifo_size, burst_size;
+	unsigned ovl_fifo_size, total_fifo_size, burst_size, max_low;
+	u64 need;
 	int i;
 
 	burst_size = dispc_ovl_get_burst_size(plane);
@@ -1104,6 +1167,31 @@ void dispc_ovl_compute_fifo_thresholds(enum omap_plane plane,
 		*fifo_low = ovl_fifo_size - burst_size;
 		*fifo_high = total_fifo_size - buf_unit;
 	}
+
+	/*
+	 * An overlay that underflowed keeps refilling as early as possible
+	 * until it has been quiet for a while, see dispc_ovl_underflow().
+	 */
+	if (dispc.fifo_safe[plane] &&
+	    time_after(jiffies, dispc.underflow_time[plane] +
+				DISPC_FIFO_SAFE_HOLD))
+		dispc.fifo_safe[plane] = false;
+
+	if (manual_update || !fetch_rate || !fifo_latency_ns ||
+	    dispc.fifo_safe[plane])
+		return;
+
+	/*
+	 * Refill late enough to let DDR idle between bursts, but early
+	 * enough to survive the latency.  With fifomerge a single overlay
+	 * can use the combined fifo for that headroom.
+	 */
+	need = (u64)fetch_rate * fifo_latency_ns;
+	need = DIV_ROUND_UP_ULL(need, 1000) + burst_size;
+	need = roundup(need, buf_unit);
+	max_low = (use_fifomerge ? total_fifo_size : ovl_fifo_size) -
+		burst_size;
+	*fifo_low = clamp_t(u64, need, burst_size * 2, max_low);
 }
 
 static void dispc_ovl_set_fir(enum omap_plane plane,
@@ -1447,6 +1535,36 @@ static int color_mode_to_bpp(enum omap_color_mode color_mode)
 	}
 }
 
+/*
+ * Bytes per microsecond an overlay fetches while the display is scanning
+ * out one of its lines, from the input/output size ratio, pixel format
+ * and pixel clock in kHz.  Rotated TILER views cross a page for every
+ * pixel, which we model as doubling the bandwidth needed.
+ */
+u32 dispc_ovl_fetch_rate(const struct omap_overlay_info *oi,
+		unsigned long pclk_khz)
+{
+	u16 outw = oi->out_width ? : oi->width;
+	u16 outh = oi->out_height ? : oi->height;
+	u32 bpp;
+	u64 rate;
+
+	if (!oi->paddr || !oi->color_mode || !outw || !outh)
+		return 0;
+
+	/* NV12 also fetches a half-resolution UV plane */
+	bpp = oi->color_mode == OMAP_DSS_COLOR_NV12 ? 12 :
+		color_mode_to_bpp(oi->color_mode);
+
+	rate = (u64)pclk_khz * bpp * oi->width * oi->height;
+	rate = div_u64(rate, (u32)outw * outh * 8 * 1000);
+
+	if (oi->rotation_type == OMAP_DSS_ROT_TILER && (oi->rotation & 1))
+		rate *= 2;
+
+	return min_t(u64, rate, ~0U);
+}
+
 static s32 pixinc(int pixels, u8 ps)
 {
 	if (!cpu_is_omap44xx() && !cpu_is_omap54xx())
@@ -1454,6 +1572,44 @@ static s32 pixinc(int pixels, u8 ps)
 	return 1 + (pixels - 1) * ps;
 }
 
+/*
+ * Rotate and mirror the TILER views of a buffer.  The result is reused
+ * while the buffer and orientation stay the same, which is the common case
+ * from frame to frame.
+ */
+static const struct tiler_view_t *calc_tiler_orient(
+		struct dispc_tiler_orient *o, u32 paddr, u32 p_uv_addr,
+		u32 width, u32 height, u8 rotation, bool mirror)
+{
+	struct tiler_view_t view;
+
+	if (o->valid && o->paddr == paddr && o->p_uv_addr == p_uv_addr &&
+	    o->width == width && o->height == height &&
+	    o->rotation == rotation && o->mirror == mirror)
+		return &o->view;
+
+	tilview_create(&o->view, paddr, width, height);
+	tilview_rotate(&o->view, rotation * 90);
+	tilview_flip(&o->view, mirror, false);
+
+	o->uv_tsptr = 0;
+	if (p_uv_addr) {
+		tilview_create(&view, p_uv_addr, width / 2, height / 2);
+		tilview_rotate(&view, rotation * 90);
+		tilview_flip(&view, mirror, false);
+		o->uv_tsptr = view.tsptr;
+	}
+
+	o->paddr = paddr;
+	o->p_uv_addr = p_uv_addr;
+	o->width = width;
+	o->height = height;
+	o->rotation = rotation;
+	o->mirror = mirror;
+	o->valid = true;
+	return &o->view;
+}
+
 static void calc_tiler_row_rotation(struct tiler_view_t *view,
 		u16 width, int bpp, int y_decim,
 		s32 *row_inc, unsigned *offset1, bool ilace)
@@ -2033,6 +2189,8 @@ int dispc_ovl_setup(enum omap_plane plane, struct omap_overlay_info *oi,
 	DSSDBG("rot %d, mir %d, ", oi->rotation, oi->mirror);
 	DSSDBG("ilace %d chan %d repl %d\n", ilace, channel, replication);
 
+	dispc.ovl_ba[plane].valid = false;
+
 	if (oi->paddr == 0)
 		return -EINVAL;
 
@@ -2128,17 +2286,20 @@ int dispc_ovl_setup(enum omap_plane plane, struct omap_overlay_info *oi,
 	}
 
 	if (oi->rotation_type == OMAP_DSS_ROT_TILER) {
-		struct tiler_view_t view = {0};
+		struct tiler_view_t view;
 		u16 tiler_width = orig_width, tiler_height = orig_height;
 		int bpp = color_mode_to_bpp(oi->color_mode) / 8;
 		/* tiler needs 0-degree width & height */
 		if (oi->rotation & 1)
 			swap(tiler_width, tiler_height);
 
-		tilview_create(&view, oi->paddr, tiler_width, tiler_height);
-		tilview_rotate(&view, oi->rotation * 90);
-		tilview_flip(&view, oi->mirror, false);
+		view = *calc_tiler_orient(&dispc.ovl_orient[plane], oi->paddr,
+					  oi->p_uv_addr, tiler_width,
+					  tiler_height, oi->rotation,
+					  oi->mirror);
 		oi->paddr = view.tsptr;
+		if (oi->p_uv_addr)
+			oi->p_uv_addr = dispc.ovl_orient[plane].uv_tsptr;
 
 		/* we cannot do TB field interlaced in rotated view */
 		pix_inc = 1 + (x_decim - 1) * bpp * pixpg;
@@ -2146,14 +2307,6 @@ int dispc_ovl_setup(enum omap_plane plane, struct omap_overlay_info *oi,
 					y_decim, &row_inc, &offset1, ilace);
 		DSSDBG("w, h = %u %u\n", tiler_width, tiler_height);
 
-		if (oi->p_uv_addr) {
-			tilview_create(&view, oi->p_uv_addr, tiler_width / 2,
-					tiler_height / 2);
-			tilview_rotate(&view, oi->rotation * 90);
-			tilview_flip(&view, oi->mirror, false);
-			oi->p_uv_addr = view.tsptr;
-		}
-
 	} else if (oi->rotation_type == OMAP_DSS_ROT_DMA) {
 		calc_dma_rotation_offset(oi->rotation, oi->mirror,
 				oi->screen_width, oi->width, frame_height,
@@ -2237,6 +2390,34 @@ int dispc_ovl_setup(enum omap_plane plane, struct omap_overlay_info *oi,
 					omap_rev() == OMAP5432_REV_ES1_0))
 		dispc_enable_arbitration(plane, true);
 
+	/* TILER addresses depend on the view, not just on the offsets */
+	dispc.ovl_ba[plane].valid = oi->rotation_type != OMAP_DSS_ROT_TILER;
+	dispc.ovl_ba[plane].nv12 = oi->color_mode == OMAP_DSS_COLOR_NV12;
+	dispc.ovl_ba[plane].offset0 = offset0;
+	dispc.ovl_ba[plane].offset1 = offset1;
+
+	return 0;
+}
+
+/*
+ * Move an overlay to a new buffer with the same layout as the one last
+ * set up by dispc_ovl_setup(), only rewriting the base addresses.
+ */
+int dispc_ovl_set_addr(enum omap_plane plane, u32 paddr, u32 p_uv_addr)
+{
+	if (!dispc.ovl_ba[plane].valid || !paddr)
+		return -EINVAL;
+
+	dispc_ovl_set_ba0(plane, paddr + dispc.ovl_ba[plane].offset0);
+	dispc_ovl_set_ba1(plane, paddr + dispc.ovl_ba[plane].offset1);
+
+	if (dispc.ovl_ba[plane].nv12) {
+		dispc_ovl_set_ba0_uv(plane, p_uv_addr +
+				     dispc.ovl_ba[plane].offset0);
+		dispc_ovl_set_ba1_uv(plane, p_uv_addr +
+				     dispc.ovl_ba[plane].offset1);
+	}
+
 	return 0;
 }
 
@@ -2347,7 +2528,7 @@ int dispc_setup_wb(struct writeback_cache_data *wb)
 
 	pix_inc = 0x1;
 	if ((paddr >= 0x60000000) && (paddr <= 0x7fffffff)) {
-		struct tiler_view_t view = {0};
+		struct tiler_view_t view;
 		int bpp = color_mode_to_bpp(color_mode) / 8;
 
 		/* tiler needs 0-degree width & height */
@@ -2358,10 +2539,12 @@ int dispc_setup_wb(struct writeback_cache_data *wb)
 		    color_mode == OMAP_DSS_COLOR_UYVY)
 			tiler_width /= 2;
 
-		tilview_create(&view, paddr, tiler_width, tiler_height);
-		tilview_rotate(&view, rotation * 90);
-		tilview_flip(&view, mirror, false);
+		view = *calc_tiler_orient(&dispc.wb_orient, paddr, puv_addr,
+					  tiler_width, tiler_height, rotation,
+					  mirror);
 		paddr = view.tsptr;
+		if (puv_addr)
+			puv_addr = dispc.wb_orient.uv_tsptr;
 
 		/* we cannot do TB field interlaced in rotated view */
 		calc_tiler_row_rotation(&view, out_width*x_decim, bpp * pixpg,
@@ -2369,14 +2552,6 @@ int dispc_setup_wb(struct writeback_cache_data *wb)
 
 		DSSDBG("w, h = %ld,%ld\n", tiler_width, tiler_height);
 
-		if (puv_addr) {
-			tilview_create(&view, puv_addr, tiler_width / 2,
-					       tiler_height / 2);
-			tilview_rotate(&view, rotation * 90);
-			tilview_flip(&view, mirror, false);
-			puv_addr = view.tsptr;
-		}
-
 		DSSDBG("rotated addresses: 0x%0x, 0x%0x\n",
 						paddr, puv_addr);
 		/* set BURSTTYPE if rotation is non-zero */
@@ -3607,11 +3782,171 @@ static irqreturn_t omap_dispc_irq_handler(int irq, void *arg)
 	return IRQ_HANDLED;
 }
 
+/* close the one second window of the error counts if it is over */
+static void dispc_err_stats_roll(struct dispc_err_stats *st)
+{
+	unsigned long now = jiffies;
+
+	if (time_before(now, st->window_start + DISPC_ERR_WINDOW))
+		return;
+
+	if (time_before(now, st->window_start + 2 * DISPC_ERR_WINDOW)) {
+		st->last_underflows = st->underflows;
+		st->last_sync_lost = st->sync_lost;
+	} else {
+		st->last_underflows = 0;
+		st->last_sync_lost = 0;
+	}
+	st->underflows = 0;
+	st->sync_lost = 0;
+	st->window_start = now;
+}
+
+static void dispc_err_stats_recovered(struct dispc_err_stats *st,
+		ktime_t start)
+{
+	s64 delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	st->recoveries++;
+	st->recovery_ns += delta;
+	st->recovery_max_ns = max_t(u64, st->recovery_max_ns, delta);
+}
+
+void dispc_dump_errors(struct seq_file *s)
+{
+	struct dispc_err_stats st;
+	u64 avg_ns;
+
+	mutex_lock(&dispc.err_lock);
+	dispc_err_stats_roll(&dispc.err_stats);
+	st = dispc.err_stats;
+	mutex_unlock(&dispc.err_lock);
+
+	avg_ns = st.recoveries ? div_u64(st.recovery_ns, st.recoveries) : 0;
+
+	seq_printf(s, "%-20s %10s %10s\n", "", "last sec", "total");
+	seq_printf(s, "%-20s %10u %10u\n", "FIFO_UNDERFLOW",
+			st.last_underflows, st.total_underflows);
+	seq_printf(s, "%-20s %10u %10u\n", "SYNC_LOST",
+			st.last_sync_lost, st.total_sync_lost);
+	seq_printf(s, "fifo raised %u, overlay disabled %u\n",
+			st.fifo_raised, st.ovl_disabled);
+	seq_printf(s, "manager re-armed %u, output restarted %u\n",
+			st.mgr_rearmed, st.output_restarts);
+	seq_printf(s, "recovery time: avg %llu us, max %llu us\n",
+			div_u64(avg_ns, NSEC_PER_USEC),
+			div_u64(st.recovery_max_ns, NSEC_PER_USEC));
+}
+
+void dispc_get_error_counts(u32 *underflows, u32 *sync_lost)
+{
+	mutex_lock(&dispc.err_lock);
+	*underflows = dispc.err_stats.total_underflows;
+	*sync_lost = dispc.err_stats.total_sync_lost;
+	mutex_unlock(&dispc.err_lock);
+}
+
+/*
+ * A FIFO underflow is usually DDR being too busy to refill the overlay in
+ * time, not the overlay being misconfigured.  The first one only makes the
+ * overlay refill as early as its FIFO allows, keeping it on screen; the
+ * overlay is taken off only if it underflows again within a second anyway.
+ */
+static void dispc_ovl_underflow(struct omap_overlay *ovl)
+{
+	enum omap_plane plane = ovl->id;
+	bool repeated = time_before(jiffies, dispc.underflow_time[plane] +
+			DISPC_ERR_WINDOW);
+	u8 hi_start, hi_end;
+	u32 unit, low, high;
+
+	dispc.underflow_time[plane] = jiffies;
+
+	if (dispc.fifo_safe[plane] && repeated) {
+		DSSERR("FIFO UNDERFLOW on %s, disabling the overlay\n",
+				ovl->name);
+		dispc_ovl_enable(plane, false);
+		if (ovl->manager)
+			dispc_mgr_go(ovl->manager->id);
+		dispc.err_stats.ovl_disabled++;
+		return;
+	}
+
+	pr_warn_ratelimited("omapdss DISPC: FIFO UNDERFLOW on %s, raising its "
+			"FIFO threshold\n", ovl->name);
+
+	unit = dss_feat_get_buffer_size_unit();
+	dss_feat_get_reg_field(FEAT_REG_FIFOHIGHTHRESHOLD, &hi_start, &hi_end);
+	high = REG_GET(DISPC_OVL_FIFO_THRESHOLD(plane), hi_start, hi_end) *
+		unit;
+	low = min(dispc_ovl_get_fifo_size(plane) -
+			dispc_ovl_get_burst_size(plane), high - unit);
+
+	dispc.fifo_safe[plane] = true;
+	dispc_ovl_set_fifo_threshold(plane, low, high);
+	if (ovl->manager)
+		dispc_mgr_go(ovl->manager->id);
+	dispc.err_stats.fifo_raised++;
+}
+
+/*
+ * A SYNC_LOST is first recovered by re-arming only the manager that lost
+ * it, which resynchronizes the output without touching the display or the
+ * other pipelines.  If it comes back within a second, the output is
+ * restarted with its video overlays disabled.
+ */
+static void dispc_mgr_sync_lost(struct omap_overlay_manager *mgr)
+{
+	struct omap_dss_device *dssdev = mgr->device;
+	bool repeated = time_before(jiffies, dispc.sync_lost_time[mgr->id] +
+			DISPC_ERR_WINDOW);
+	bool enable;
+	int i;
+
+	dispc.sync_lost_time[mgr->id] = jiffies;
+
+	if (!repeated) {
+		pr_err_ratelimited("SYNC_LOST on channel %s, re-arming the "
+				"manager\n", mgr->name);
+		dispc_mgr_enable(mgr->id, false);
+		dispc_mgr_enable(mgr->id, true);
+		dispc.err_stats.mgr_rearmed++;
+		return;
+	}
+
+	pr_err_ratelimited("SYNC_LOST on channel %s, restarting"
+			" the output with video overlays "
+			"disabled\n", mgr->name);
+
+	enable = dssdev->state;
+
+	dssdev->sync_lost_error = true;
+	dssdev->driver->disable(dssdev);
+	dssdev->sync_lost_error = false;
+
+	for (i = 0; i < omap_dss_get_num_overlays(); ++i) {
+		struct omap_overlay *ovl;
+		ovl = omap_dss_get_overlay(i);
+		if (!ovl)
+			continue;
+		if (ovl->id != OMAP_DSS_GFX &&
+				ovl->manager == mgr)
+			dispc_ovl_enable(ovl->id, false);
+	}
+
+	dispc_mgr_go(mgr->id);
+	mdelay(50);
+	if (enable && dssdev->driver && dssdev->driver->enable)
+		dssdev->driver->enable(dssdev);
+	dispc.err_stats.output_restarts++;
+}
+
 static void dispc_error_worker(struct work_struct *work)
 {
 	int i;
 	u32 errors;
 	unsigned long flags;
+	ktime_t start;
 	static const unsigned fifo_underflow_bits[] = {
 		DISPC_IRQ_GFX_FIFO_UNDERFLOW,
 		DISPC_IRQ_VID1_FIFO_UNDERFLOW,
@@ -3632,6 +3967,9 @@ static void dispc_error_worker(struct work_struct *work)
 
 	dispc_runtime_get();
 
+	mutex_lock(&dispc.err_lock);
+	dispc_err_stats_roll(&dispc.err_stats);
+
 	for (i = 0; i < omap_dss_get_num_overlays(); ++i) {
 		struct omap_overlay *ovl;
 		unsigned bit;
@@ -3641,11 +3979,12 @@ static void dispc_error_worker(struct work_struct *work)
 		bit = fifo_underflow_bits[i];
 
 		if (bit & errors) {
-			DSSERR("FIFO UNDERFLOW on %s, disabling the overlay\n",
-					ovl->name);
-			dispc_ovl_enable(ovl->id, false);
-			dispc_mgr_go(ovl->manager->id);
-			mdelay(50);
+			dispc.err_stats.underflows++;
+			dispc.err_stats.total_underflows++;
+
+			start = ktime_get();
+			dispc_ovl_underflow(ovl);
+			dispc_err_stats_recovered(&dispc.err_stats, start);
 		}
 	}
 
@@ -3653,52 +3992,34 @@ static void dispc_error_worker(struct work_struct *work)
 		struct omap_overlay_manager *mgr;
 		unsigned bit;
 
+		bit = sync_lost_bits[i];
+		if (!(bit & errors))
+			continue;
+
+		dispc.err_stats.sync_lost++;
+		dispc.err_stats.total_sync_lost++;
+
 		mgr = omap_dss_get_overlay_manager(i);
 		if ((!mgr) || !mgr->device) {
 			DSSERR("mgr or device is NULL\n");
-			break;
+			continue;
 		}
 
 		if (!mgr->device->first_vsync) {
 			DSSERR("First SYNC_LOST.. ignoring\n");
-			break;
+			continue;
 		}
 
-		bit = sync_lost_bits[i];
-
-		if (bit & errors) {
-			struct omap_dss_device *dssdev = mgr->device;
-			bool enable;
-			if (dssdev && dssdev->state != OMAP_DSS_DISPLAY_ACTIVE)
-				break;
-
-			pr_err_ratelimited("SYNC_LOST on channel %s, restarting"
-					" the output with video overlays "
-					"disabled\n", mgr->name);
-
-			enable = dssdev->state;
-
-			mgr->device->sync_lost_error = true;
-			dssdev->driver->disable(dssdev);
-			mgr->device->sync_lost_error = false;
-
-			for (i = 0; i < omap_dss_get_num_overlays(); ++i) {
-				struct omap_overlay *ovl;
-				ovl = omap_dss_get_overlay(i);
-				if (!ovl)
-					continue;
-				if (ovl->id != OMAP_DSS_GFX &&
-						ovl->manager == mgr)
-					dispc_ovl_enable(ovl->id, false);
-			}
+		if (mgr->device->state != OMAP_DSS_DISPLAY_ACTIVE)
+			continue;
 
-			dispc_mgr_go(mgr->id);
-			mdelay(50);
-			if (enable && dssdev->driver && dssdev->driver->enable)
-				dssdev->driver->enable(dssdev);
-		}
+		start = ktime_get();
+		dispc_mgr_sync_lost(mgr);
+		dispc_err_stats_recovered(&dispc.err_stats, start);
 	}
 
+	mutex_unlock(&dispc.err_lock);
+
 	if (errors & DISPC_IRQ_OCP_ERR) {
 		DSSERR("OCP_ERR\n");
 		for (i = 0; i < omap_dss_get_num_overlay_managers(); ++i) {
@@ -3888,6 +4209,8 @@ static int omap_dispchw_probe(struct platform_device *pdev)
 #endif
 
 	INIT_WORK(&dispc.error_work, dispc_error_worker);
+	mutex_init(&dispc.err_lock);
+	dispc.err_stats.window_start = jiffies;
 
 	dispc_mem = platform_get_resource(dispc.pdev, IORESOURCE_MEM, 0);
 	if (!dispc_mem) {
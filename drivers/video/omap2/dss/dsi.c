@@ -285,6 +285,8 @@ struct dsi_data {
 	struct dsi_isr_tables isr_tables_copy;
 
 	int update_channel;
+	/* region set by omap_dsi_prepare_update(), 0 x 0 for full frame */
+	u16 update_w, update_h;
 #ifdef DEBUG
 	unsigned update_bytes;
 #endif
@@ -4427,6 +4429,36 @@ static void dsi_framedone_irq_callback(void *data, u32 mask)
 #endif
 }
 
+/*
+ * Limit the next omap_dsi_update() to a w x h region.  The panel driver
+ * must set the same window on the panel, and the overlays must already be
+ * positioned relative to x, y.  Called with the bus lock held.
+ */
+int omap_dsi_prepare_update(struct omap_dss_device *dssdev,
+		u16 *x, u16 *y, u16 *w, u16 *h)
+{
+	struct platform_device *dsidev = dsi_get_dsidev_from_dssdev(dssdev);
+	struct dsi_data *dsi = dsi_get_dsidrv_data(dsidev);
+	u16 dw, dh;
+
+	dssdev->driver->get_resolution(dssdev, &dw, &dh);
+
+	if (*x > dw || *y > dh)
+		return -EINVAL;
+
+	if (*x + *w > dw || *y + *h > dh)
+		return -EINVAL;
+
+	if (*w < 2 || *h == 0)
+		return -EINVAL;
+
+	dsi->update_w = *w;
+	dsi->update_h = *h;
+
+	return 0;
+}
+EXPORT_SYMBOL(omap_dsi_prepare_update);
+
 int omap_dsi_update(struct omap_dss_device *dssdev, int channel,
 		void (*callback)(int, void *), void *data)
 {
@@ -4441,7 +4473,16 @@ int omap_dsi_update(struct omap_dss_device *dssdev, int channel,
 	dsi->framedone_callback = callback;
 	dsi->framedone_data = data;
 
-	dssdev->driver->get_resolution(dssdev, &dw, &dh);
+	if (dsi->update_w) {
+		dw = dsi->update_w;
+		dh = dsi->update_h;
+		dsi->update_w = dsi->update_h = 0;
+	} else {
+		dssdev->driver->get_resolution(dssdev, &dw, &dh);
+	}
+
+	/* also restores the full size after a partial update */
+	dispc_mgr_set_lcd_size(dssdev->manager->id, dw, dh);
 
 #ifdef DEBUG
 	dsi->update_bytes = dw * dh *
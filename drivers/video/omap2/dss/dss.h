@@ -211,6 +211,9 @@ int omap_dss_mgr_apply(struct omap_overlay_manager *mgr);
 /* writeback apply */
 int omap_dss_wb_mgr_apply(struct omap_overlay_manager *mgr,
 		struct omap_writeback *wb);
+int omap_dss_wb_m2m(struct omap_writeback *wb, struct omap_overlay *ovl,
+		struct omap_overlay_info *info,
+		struct omap_writeback_info *wb_info);
 
 int dss_mgr_enable(struct omap_overlay_manager *mgr);
 void dss_mgr_disable(struct omap_overlay_manager *mgr);
@@ -435,6 +438,8 @@ int dispc_init_platform_driver(void);
 void dispc_uninit_platform_driver(void);
 void dispc_dump_clocks(struct seq_file *s);
 void dispc_dump_irqs(struct seq_file *s);
+void dispc_dump_errors(struct seq_file *s);
+void dispc_get_error_counts(u32 *underflows, u32 *sync_lost);
 void dispc_dump_regs(struct seq_file *s);
 void dispc_irq_handler(void);
 void dispc_fake_vsync_irq(void);
@@ -464,11 +469,15 @@ int dispc_calc_clock_rates(unsigned long dispc_fclk_rate,
 void dispc_ovl_set_fifo_threshold(enum omap_plane plane, u32 low, u32 high);
 void dispc_ovl_compute_fifo_thresholds(enum omap_plane plane,
 		u32 *fifo_low, u32 *fifo_high, bool use_fifomerge,
-		bool manual_update);
+		bool manual_update, u32 fetch_rate);
+u32 dispc_ovl_fetch_rate(const struct omap_overlay_info *oi,
+		unsigned long pclk_khz);
 int dispc_ovl_setup(enum omap_plane plane, struct omap_overlay_info *oi,
 		bool ilace, bool replication, int x_decim, int y_decim,
 		bool five_taps);
+int dispc_ovl_set_addr(enum omap_plane plane, u32 paddr, u32 p_uv_addr);
 int dispc_ovl_enable(enum omap_plane plane, bool enable);
+void dispc_ovl_set_channel_out_wb(enum omap_plane plane);
 void dispc_ovl_set_channel_out(enum omap_plane plane,
 		enum omap_channel channel);
 
@@ -1213,7 +1213,7 @@ wait_for_ack_nack:
 			nominal bit period is ~3 msec
 			delay of >= 3 bit period before next attempt
 			*/
-			mdelay(10);
+			usleep_range(10000, 11000);
 
 		} else {
 			/* Nacked ensure to clear the status */
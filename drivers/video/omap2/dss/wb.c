@@ -168,6 +168,7 @@ void dss_init_writeback(struct platform_device *pdev)
 	wb->check_wb = &dss_check_wb;
 	wb->set_wb_info = &omap_dss_wb_set_info;
 	wb->get_wb_info = &omap_dss_wb_get_info;
+	wb->m2m = &omap_dss_wb_m2m;
 	mutex_init(&wb->lock);
 
 	omap_dss_add_wb(wb);
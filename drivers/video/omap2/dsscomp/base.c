@@ -176,49 +176,44 @@ static int crop_to_rect(union rect *crop, union rect *win, union rect *vis,
 	return 0;
 }
 
-int set_dss_ovl_info(struct dss2_ovl_info *oi)
+/*
+ * Convert a dsscomp overlay configuration into DSS2 overlay info, clipped
+ * to the visible output rectangle, and positioned relative to its origin.
+ * Returns -ENOENT if the overlay is disabled or fully clipped (info is
+ * only partially updated then), and other negative values for invalid
+ * configurations.
+ */
+static int dss_ovl_info_from_cfg(struct dss2_ovl_info *oi,
+		struct omap_overlay_info *info, const struct dss2_rect_t *vis_r)
 {
-	struct omap_overlay_info info;
-	struct omap_overlay *ovl;
-	struct dss2_ovl_cfg *cfg;
+	struct dss2_ovl_cfg *cfg = &oi->cfg;
 	union rect crop, win, vis;
 	int c;
 	enum tiler_fmt fmt;
 
-	/* check overlay number */
-	if (!oi || oi->cfg.ix >= omap_dss_get_num_overlays())
-		return -EINVAL;
-	cfg = &oi->cfg;
-	ovl = omap_dss_get_overlay(cfg->ix);
-
-	/* just in case there are new fields, we get the current info */
-	ovl->get_overlay_info(ovl, &info);
-
 	if (!cfg->enabled)
-		goto done;
+		return -ENOENT;
 
 	/* copied params */
-	info.zorder = cfg->zorder;
+	info->zorder = cfg->zorder;
 
 	if (cfg->zonly)
-		goto done;
+		return -ENOENT;
 
-	info.global_alpha = cfg->global_alpha;
-	info.pre_mult_alpha = cfg->pre_mult_alpha;
-	info.rotation = cfg->rotation;
-	info.mirror = cfg->mirror;
-	info.color_mode = cfg->color_mode;
+	info->global_alpha = cfg->global_alpha;
+	info->pre_mult_alpha = cfg->pre_mult_alpha;
+	info->rotation = cfg->rotation;
+	info->mirror = cfg->mirror;
+	info->color_mode = cfg->color_mode;
 
 	/* crop to screen */
 	crop.r = cfg->crop;
 	win.r = cfg->win;
-	vis.x = vis.y = 0;
-	vis.w = ovl->manager->device->panel.timings.x_res;
-	vis.h = ovl->manager->device->panel.timings.y_res;
+	vis.r = *vis_r;
 
 	if (crop_to_rect(&crop, &win, &vis, cfg->rotation, cfg->mirror) ||
 								vis.w < 2)
-		goto done;
+		return -ENOENT;
 
 	/* adjust crop to UV pixel boundaries */
 	for (c = 0; c < (cfg->color_mode == OMAP_DSS_COLOR_NV12 ? 2 :
@@ -235,22 +230,23 @@ int set_dss_ovl_info(struct dss2_ovl_info *oi)
 		 */
 	}
 
-	info.width  = crop.w;
-	info.height = crop.h;
+	info->width  = crop.w;
+	info->height = crop.h;
 	if (cfg->rotation & 1)
 		/* DISPC uses swapped height/width for 90/270 degrees */
-		swap(info.width, info.height);
-	info.pos_x = win.x;
-	info.pos_y = win.y;
-	info.out_width = win.w;
-	info.out_height = win.h;
+		swap(info->width, info->height);
+	info->pos_x = win.x - vis.x;
+	info->pos_y = win.y - vis.y;
+	info->out_width = win.w;
+	info->out_height = win.h;
 
 	/* calculate addresses and cropping */
-	info.paddr = oi->ba;
-	info.p_uv_addr = (info.color_mode == OMAP_DSS_COLOR_NV12) ? oi->uv : 0;
+	info->paddr = oi->ba;
+	info->p_uv_addr = (info->color_mode == OMAP_DSS_COLOR_NV12) ?
+								oi->uv : 0;
 
 	/* check for TILER 2D buffer */
-	if (tiler_get_fmt(info.paddr, &fmt) && fmt >= TILFMT_8BIT &&
+	if (tiler_get_fmt(info->paddr, &fmt) && fmt >= TILFMT_8BIT &&
 			fmt <= TILFMT_32BIT) {
 		int bpp = 1 << (fmt - TILFMT_8BIT);
 		struct tiler_view_t t;
@@ -269,22 +265,22 @@ int set_dss_ovl_info(struct dss2_ovl_info *oi)
 		else if (cfg->color_mode == OMAP_DSS_COLOR_RGB24P)
 			bpp = 3;
 
-		tilview_create(&t, info.paddr, cfg->width, cfg->height);
-		info.paddr -= t.tsptr;
+		tilview_create(&t, info->paddr, cfg->width, cfg->height);
+		info->paddr -= t.tsptr;
 		tilview_crop(&t, 0, crop.y, cfg->width, crop.h);
-		info.paddr += t.tsptr + bpp * crop.x;
+		info->paddr += t.tsptr + bpp * crop.x;
 
-		info.rotation_type = OMAP_DSS_ROT_TILER;
-		info.screen_width = 0;
+		info->rotation_type = OMAP_DSS_ROT_TILER;
+		info->screen_width = 0;
 
 		/* for NV12 format also crop NV12 */
-		if (info.color_mode == OMAP_DSS_COLOR_NV12) {
-			tilview_create(&t, info.p_uv_addr,
+		if (info->color_mode == OMAP_DSS_COLOR_NV12) {
+			tilview_create(&t, info->p_uv_addr,
 					cfg->width >> 1, cfg->height >> 1);
-			info.p_uv_addr -= t.tsptr;
+			info->p_uv_addr -= t.tsptr;
 			tilview_crop(&t, 0, crop.y >> 1, cfg->width >> 1,
 								crop.h >> 1);
-			info.p_uv_addr += t.tsptr + bpp * crop.x;
+			info->p_uv_addr += t.tsptr + bpp * crop.x;
 		}
 	} else {
 		/* program tiler 1D as SDMA */
@@ -293,36 +289,36 @@ int set_dss_ovl_info(struct dss2_ovl_info *oi)
 		if (!bpp) {
 			pr_warn("invalid color format %u for ovl%d\n",
 						cfg->color_mode, cfg->ix);
-			goto done;
+			return -ENOENT;
 		}
 
-		info.screen_width = cfg->stride * 8 / (bpp == 12 ? 8 : bpp);
-		info.paddr += crop.x * (bpp / 8) + crop.y * cfg->stride;
+		info->screen_width = cfg->stride * 8 / (bpp == 12 ? 8 : bpp);
+		info->paddr += crop.x * (bpp / 8) + crop.y * cfg->stride;
 
 		/* for NV12 format also crop NV12 */
-		if (info.color_mode == OMAP_DSS_COLOR_NV12)
-			info.p_uv_addr += crop.x * (bpp / 8) +
+		if (info->color_mode == OMAP_DSS_COLOR_NV12)
+			info->p_uv_addr += crop.x * (bpp / 8) +
 				(crop.y >> 1) * cfg->stride;
 
 		/* no rotation on DMA buffer */
 		if (cfg->rotation & 3 || cfg->mirror)
 			return -EINVAL;
 
-		info.rotation_type = OMAP_DSS_ROT_DMA;
+		info->rotation_type = OMAP_DSS_ROT_DMA;
 	}
 
-	info.max_x_decim = cfg->decim.max_x ? : 255;
-	info.max_y_decim = cfg->decim.max_y ? : 255;
-	info.min_x_decim = cfg->decim.min_x ? : 1;
-	info.min_y_decim = cfg->decim.min_y ? : 1;
+	info->max_x_decim = cfg->decim.max_x ? : 255;
+	info->max_y_decim = cfg->decim.max_y ? : 255;
+	info->min_x_decim = cfg->decim.min_x ? : 1;
+	info->min_y_decim = cfg->decim.min_y ? : 1;
 #if 0
-	info.pic_height = cfg->height;
+	info->pic_height = cfg->height;
 
-	info.field = 0;
+	info->field = 0;
 	if (cfg->ilace & OMAP_DSS_ILACE_SEQ)
-		info.field |= OMAP_FLAG_IBUF;
+		info->field |= OMAP_FLAG_IBUF;
 	if (cfg->ilace & OMAP_DSS_ILACE_SWAP)
-		info.field |= OMAP_FLAG_ISWAP;
+		info->field |= OMAP_FLAG_ISWAP;
 	/*
 	 * Ignore OMAP_DSS_ILACE as there is no real support yet for
 	 * interlaced interleaved vs progressive buffers
@@ -331,14 +327,50 @@ int set_dss_ovl_info(struct dss2_ovl_info *oi)
 	    ovl->manager->device &&
 	    !strcmp(ovl->manager->device->name, "hdmi") &&
 	    is_hdmi_interlaced())
-		info.field |= OMAP_FLAG_IDEV;
+		info->field |= OMAP_FLAG_IDEV;
 
-	info.out_wb = 0;
+	info->out_wb = 0;
 #endif
 
-	info.cconv = cfg->cconv;
+	info->cconv = cfg->cconv;
+	return 0;
+}
+
+/*
+ * Set up an overlay from its dsscomp configuration.  If vis is given, the
+ * overlay is clipped to it for a partial update, and -ENOENT is returned
+ * without touching the overlay if it lies outside.  Otherwise it is
+ * clipped to the screen.
+ */
+int set_dss_ovl_info(struct dss2_ovl_info *oi, struct dss2_rect_t *vis)
+{
+	struct omap_overlay_info info;
+	struct omap_overlay *ovl;
+	struct omap_dss_device *dev;
+	struct dss2_rect_t screen = { 0 };
+	int r;
+
+	/* check overlay number */
+	if (!oi || oi->cfg.ix >= omap_dss_get_num_overlays())
+		return -EINVAL;
+	ovl = omap_dss_get_overlay(oi->cfg.ix);
+	dev = ovl->manager ? ovl->manager->device : NULL;
+
+	/* just in case there are new fields, we get the current info */
+	ovl->get_overlay_info(ovl, &info);
+
+	/* an unconnected overlay clips to nothing */
+	if (!vis && dev) {
+		screen.w = dev->panel.timings.x_res;
+		screen.h = dev->panel.timings.y_res;
+	}
+
+	r = dss_ovl_info_from_cfg(oi, &info, vis ? : &screen);
+	if (r == -ENOENT && vis && oi->cfg.enabled)
+		return r;
+	if (r && r != -ENOENT)
+		return r;
 
-done:
 	pr_debug("ovl%d: en=%d %x/%x ",	ovl->id, ovl->is_enabled(ovl),
 			info.paddr, info.p_uv_addr);
 	pr_debug("(%dx%d|%d) => ", info.width, info.height, info.screen_width);
@@ -426,6 +458,68 @@ done:
 	return wb->set_wb_info(wb, &info);
 }
 
+/*
+ * Copy one buffer through an idle overlay into writeback memory.  The
+ * overlay window, which must start at the origin, gives the size of the
+ * pass; writeback then scales it to its own window.
+ */
+int dsscomp_wb_copy(struct dsscomp_wb_copy_data *d)
+{
+	struct omap_overlay_info info;
+	struct omap_writeback_info wb_info;
+	struct omap_overlay *ovl;
+	struct omap_writeback *wb;
+	struct dss2_ovl_cfg *cfg = &d->wb.cfg;
+	struct dss2_rect_t vis = { 0 };
+	int r;
+
+	if (cfg->ix != OMAP_DSS_WB || !cfg->enabled ||
+	    d->ovl.cfg.ix >= omap_dss_get_num_overlays() ||
+	    d->ovl.cfg.ix == OMAP_DSS_WB || d->ovl.cfg.zonly ||
+	    d->ovl.cfg.win.x || d->ovl.cfg.win.y)
+		return -EINVAL;
+
+	wb = omap_dss_get_wb(0);
+	if (!wb || !wb->m2m)
+		return -ENODEV;
+	ovl = omap_dss_get_overlay(d->ovl.cfg.ix);
+
+	ovl->get_overlay_info(ovl, &info);
+	vis.w = d->ovl.cfg.win.w;
+	vis.h = d->ovl.cfg.win.h;
+	r = dss_ovl_info_from_cfg(&d->ovl, &info, &vis);
+	if (r)
+		return r == -ENOENT ? -EINVAL : r;
+
+	wb->get_wb_info(wb, &wb_info);
+	wb_info.enabled = true;
+	wb_info.source = OMAP_WB_GFX + ovl->id;
+	wb_info.capturemode = OMAP_WB_CAPTURE_ALL;
+	wb_info.mode = OMAP_WB_MEM2MEM_MODE;
+	wb_info.width = info.out_width;
+	wb_info.height = info.out_height;
+	wb_info.out_width = cfg->win.w;
+	wb_info.out_height = cfg->win.h;
+	wb_info.dss_mode = cfg->color_mode;
+	wb_info.paddr = d->wb.ba;
+	wb_info.p_uv_addr = wb_info.dss_mode == OMAP_DSS_COLOR_NV12 ?
+								d->wb.uv : 0;
+	wb_info.rotation = cfg->rotation;
+	if (wb_info.rotation & 1)
+		swap(wb_info.out_width, wb_info.out_height);
+	if (wb_info.paddr >= 0x60000000 && wb_info.paddr < 0x78000000)
+		wb_info.rotation_type = OMAP_DSS_ROT_TILER;
+	else
+		wb_info.rotation_type = OMAP_DSS_ROT_DMA;
+
+	pr_debug("wb copy: ovl%d %x (%dx%d) => %x (%dx%d) col=%x\n",
+		ovl->id, info.paddr, wb_info.width, wb_info.height,
+		wb_info.paddr, wb_info.out_width, wb_info.out_height,
+		wb_info.dss_mode);
+
+	return wb->m2m(wb, ovl, &info, &wb_info);
+}
+
 void swap_rb_in_ovl_info(struct dss2_ovl_info *oi)
 {
 	/* we need to swap YUV color matrix if we are swapping R and B */
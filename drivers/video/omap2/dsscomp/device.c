@@ -34,12 +34,16 @@
 #include <linux/uaccess.h>
 #include <linux/sched.h>
 #include <linux/syscalls.h>
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/notifier.h>
 
 #define MODULE_NAME_DSSCOMP	"dsscomp"
 
 #include <video/omapdss.h>
 #include <video/dsscomp.h>
 #include <plat/dsscomp.h>
+#include <plat/dmtimer_ts.h>
 #include "../../../drivers/staging/omapdrm/omap_dmm_tiler.h"
 #include "dsscomp.h"
 #include "../dss/dss_features.h"
@@ -202,6 +206,220 @@ static const struct file_operations sync_fops = {
 	.unlocked_ioctl = sync_ioctl,
 };
 
+/* per open file of /dev/dsscomp */
+struct dsscomp_file {
+	struct dsscomp_dev *cdev;
+	u32 vsync_mask;			/* managers reported */
+	u32 vsync_seen[MAX_MANAGERS];	/* last count read */
+};
+
+/* vsync state of each manager, updated from the DISPC interrupt */
+static struct dsscomp_vsync {
+	u32 users;		/* files listening, under vsync_mtx */
+	u32 count;
+	ktime_t stamp;
+} vsync[MAX_MANAGERS];
+static DEFINE_MUTEX(vsync_mtx);
+static DEFINE_SPINLOCK(vsync_lock);
+static DECLARE_WAIT_QUEUE_HEAD(vsync_wq);
+
+/* in-kernel listeners of the primary manager vsync, see below */
+static ATOMIC_NOTIFIER_HEAD(vsync_notifier);
+static struct dsscomp_dev *vsync_cdev;
+static bool vsync_notifier_user;
+
+/* primary display vsync stamps, latched by a timer if the board wires one */
+static struct omap_ts_event *vsync_ts;
+
+static void vsync_isr(void *data, u32 mask)
+{
+	struct dsscomp_vsync *v = data;
+	ktime_t now = v == vsync ? omap_ts_event_stamp(vsync_ts) : ktime_get();
+	u32 count;
+
+	spin_lock(&vsync_lock);
+	v->stamp = now;
+	count = ++v->count;
+	spin_unlock(&vsync_lock);
+
+	wake_up_interruptible_all(&vsync_wq);
+
+	if (v == vsync)
+		atomic_notifier_call_chain(&vsync_notifier, count, &now);
+}
+
+/* add or drop a listener of a manager vsync, under vsync_mtx and DISPC on */
+static int vsync_get(struct dsscomp_dev *cdev, u32 ch)
+{
+	u32 irq = dispc_mgr_get_vsync_irq(cdev->mgrs[ch]->id);
+	int r;
+
+	if (!vsync[ch].users) {
+		r = omap_dispc_register_isr(vsync_isr, vsync + ch, irq);
+		if (r)
+			return r;
+	}
+	vsync[ch].users++;
+	return 0;
+}
+
+static void vsync_put(struct dsscomp_dev *cdev, u32 ch)
+{
+	u32 irq = dispc_mgr_get_vsync_irq(cdev->mgrs[ch]->id);
+
+	if (!--vsync[ch].users)
+		omap_dispc_unregister_isr(vsync_isr, vsync + ch, irq);
+}
+
+static bool vsync_pending(struct dsscomp_file *f)
+{
+	unsigned long flags;
+	bool pending = false;
+	u32 ch;
+
+	spin_lock_irqsave(&vsync_lock, flags);
+	for (ch = 0; ch < MAX_MANAGERS; ch++)
+		if ((f->vsync_mask & (1 << ch)) &&
+		    vsync[ch].count != f->vsync_seen[ch])
+			pending = true;
+	spin_unlock_irqrestore(&vsync_lock, flags);
+
+	return pending;
+}
+
+static int vsync_get_events(struct dsscomp_file *f,
+			struct dsscomp_vsync_event *ev, int max)
+{
+	unsigned long flags;
+	int n = 0;
+	u32 ch;
+
+	spin_lock_irqsave(&vsync_lock, flags);
+	for (ch = 0; ch < MAX_MANAGERS && n < max; ch++) {
+		if (!(f->vsync_mask & (1 << ch)) ||
+		    vsync[ch].count == f->vsync_seen[ch])
+			continue;
+		f->vsync_seen[ch] = vsync[ch].count;
+		ev[n].ix = ch;
+		ev[n].count = vsync[ch].count;
+		ev[n].timestamp = ktime_to_ns(vsync[ch].stamp);
+		n++;
+	}
+	spin_unlock_irqrestore(&vsync_lock, flags);
+
+	return n;
+}
+
+/*
+ * Change the managers a file listens to, and (un)register the vsync
+ * interrupt of managers that gain their first or lose their last listener.
+ * The IRQ enable register is part of the saved DISPC context, so
+ * registrations persist across DSS runtime suspend.
+ */
+static int vsync_set_mask(struct dsscomp_dev *cdev, struct dsscomp_file *f,
+								u32 mask)
+{
+	unsigned long flags;
+	u32 ch, changed;
+	int r = 0;
+
+	if (mask & ~((1 << cdev->num_mgrs) - 1))
+		return -EINVAL;
+
+	mutex_lock(&vsync_mtx);
+	changed = mask ^ f->vsync_mask;
+	if (!changed)
+		goto done;
+
+	r = dispc_runtime_get();
+	if (r)
+		goto done;
+
+	for (ch = 0; ch < cdev->num_mgrs; ch++) {
+		if (!(changed & (1 << ch)))
+			continue;
+
+		if (mask & (1 << ch)) {
+			r = vsync_get(cdev, ch);
+			if (r) {
+				mask &= ~(1 << ch);
+				continue;
+			}
+			/* only report vsyncs from now on */
+			spin_lock_irqsave(&vsync_lock, flags);
+			f->vsync_seen[ch] = vsync[ch].count;
+			spin_unlock_irqrestore(&vsync_lock, flags);
+		} else {
+			vsync_put(cdev, ch);
+		}
+	}
+	f->vsync_mask = mask;
+
+	dispc_runtime_put();
+done:
+	mutex_unlock(&vsync_mtx);
+	return r;
+}
+
+/*
+ * Drivers that want to pace their work on the primary display, such as
+ * touchscreens delivering one input frame per displayed frame, can listen
+ * to its vsync. The notifier is called from the DISPC interrupt with the
+ * vsync count as action and a pointer to the ktime_t stamp as data.
+ */
+static int vsync_notifier_update(void)
+{
+	bool users = vsync_notifier.head != NULL;
+	int r = 0;
+
+	if (users == vsync_notifier_user)
+		return 0;
+
+	r = dispc_runtime_get();
+	if (r)
+		return r;
+
+	if (users)
+		r = vsync_get(vsync_cdev, 0);
+	else
+		vsync_put(vsync_cdev, 0);
+	if (!r)
+		vsync_notifier_user = users;
+
+	dispc_runtime_put();
+	return r;
+}
+
+int dsscomp_register_vsync_notifier(struct notifier_block *nb)
+{
+	int r;
+
+	mutex_lock(&vsync_mtx);
+	if (!vsync_cdev || !vsync_cdev->num_mgrs) {
+		r = -ENODEV;
+		goto done;
+	}
+
+	atomic_notifier_chain_register(&vsync_notifier, nb);
+	r = vsync_notifier_update();
+	if (r)
+		atomic_notifier_chain_unregister(&vsync_notifier, nb);
+done:
+	mutex_unlock(&vsync_mtx);
+	return r;
+}
+EXPORT_SYMBOL(dsscomp_register_vsync_notifier);
+
+void dsscomp_unregister_vsync_notifier(struct notifier_block *nb)
+{
+	mutex_lock(&vsync_mtx);
+	atomic_notifier_chain_unregister(&vsync_notifier, nb);
+	if (vsync_cdev)
+		vsync_notifier_update();
+	mutex_unlock(&vsync_mtx);
+}
+EXPORT_SYMBOL(dsscomp_unregister_vsync_notifier);
+
 static long setup_mgr(struct dsscomp_dev *cdev,
 					struct dsscomp_setup_mgr_data *d)
 {
@@ -549,8 +767,8 @@ static void fill_platform_info(struct dsscomp_dev *cdev)
 static long comp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	int r = 0;
-	struct miscdevice *dev = filp->private_data;
-	struct dsscomp_dev *cdev = container_of(dev, struct dsscomp_dev, dev);
+	struct dsscomp_file *f = filp->private_data;
+	struct dsscomp_dev *cdev = f->cdev;
 	void __user *ptr = (void __user *)arg;
 
 	union {
@@ -559,6 +777,9 @@ static long comp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 			struct dss2_ovl_info ovl[MAX_OVERLAYS];
 		} m;
 		struct dsscomp_setup_dispc_data dispc;
+		struct dsscomp_setup_dispc_fence_data fence;
+		struct dsscomp_queue_wb_data wb;
+		struct dsscomp_wb_copy_data copy;
 		struct dsscomp_display_info dis;
 		struct dsscomp_check_ovl_data chk;
 		struct dsscomp_setup_display_data sdis;
@@ -583,6 +804,24 @@ static long comp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		    dsscomp_gralloc_queue_ioctl(&u.dispc);
 		break;
 	}
+	case DSSCIOC_SETUP_DISPC_FENCE:
+	{
+		r = copy_from_user(&u.fence, ptr, sizeof(u.fence)) ? :
+		    dsscomp_gralloc_queue_fence_ioctl(&u.fence, ptr);
+		break;
+	}
+	case DSSCIOC_QUEUE_WB:
+	{
+		r = copy_from_user(&u.wb, ptr, sizeof(u.wb)) ? :
+		    dsscomp_gralloc_queue_wb_ioctl(&u.wb, ptr);
+		break;
+	}
+	case DSSCIOC_WB_COPY:
+	{
+		r = copy_from_user(&u.copy, ptr, sizeof(u.copy)) ? :
+		    dsscomp_wb_copy(&u.copy);
+		break;
+	}
 	case DSSCIOC_QUERY_DISPLAY:
 	{
 		struct dsscomp_display_info *dis = NULL;
@@ -613,6 +852,13 @@ static long comp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		    setup_display(cdev, &u.sdis);
 		break;
 	}
+	case DSSCIOC_SET_VSYNC:
+	{
+		u32 mask;
+		r = get_user(mask, (u32 __user *)ptr) ? :
+		    vsync_set_mask(cdev, f, mask);
+		break;
+	}
 	case DSSCIOC_QUERY_PLATFORM:
 	{
 		/* :TODO: for now refill platform info as it is dynamic */
@@ -625,15 +871,65 @@ static long comp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	return r;
 }
 
-/* must implement open for filp->private_data to be filled */
 static int comp_open(struct inode *inode, struct file *filp)
 {
+	/* misc_open() points private_data at our miscdevice */
+	struct miscdevice *dev = filp->private_data;
+	struct dsscomp_file *f = kzalloc(sizeof(*f), GFP_KERNEL);
+
+	if (!f)
+		return -ENOMEM;
+	f->cdev = container_of(dev, struct dsscomp_dev, dev);
+	filp->private_data = f;
+	return 0;
+}
+
+static int comp_release(struct inode *inode, struct file *filp)
+{
+	struct dsscomp_file *f = filp->private_data;
+
+	vsync_set_mask(f->cdev, f, 0);
+	kfree(f);
 	return 0;
 }
 
+static ssize_t comp_read(struct file *filp, char __user *buf, size_t count,
+								loff_t *off)
+{
+	struct dsscomp_file *f = filp->private_data;
+	struct dsscomp_vsync_event ev[MAX_MANAGERS];
+	int max = min_t(size_t, count / sizeof(*ev), ARRAY_SIZE(ev));
+	int n, r;
+
+	if (!max)
+		return -EINVAL;
+
+	while (!(n = vsync_get_events(f, ev, max))) {
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		r = wait_event_interruptible(vsync_wq, vsync_pending(f));
+		if (r)
+			return r;
+	}
+
+	return copy_to_user(buf, ev, n * sizeof(*ev)) ? -EFAULT :
+							n * sizeof(*ev);
+}
+
+static unsigned int comp_poll(struct file *filp, poll_table *wait)
+{
+	struct dsscomp_file *f = filp->private_data;
+
+	poll_wait(filp, &vsync_wq, wait);
+	return vsync_pending(f) ? POLLIN | POLLRDNORM : 0;
+}
+
 static const struct file_operations comp_fops = {
 	.owner		= THIS_MODULE,
 	.open		= comp_open,
+	.release	= comp_release,
+	.read		= comp_read,
+	.poll		= comp_poll,
 	.unlocked_ioctl = comp_ioctl,
 };
 
@@ -656,8 +952,25 @@ static const struct file_operations dsscomp_debug_fops = {
 	.release        = single_release,
 };
 
+/* writing anything to flip_stats starts a new measurement */
+static ssize_t dsscomp_flip_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	dsscomp_gralloc_reset_stats();
+	return count;
+}
+
+static const struct file_operations dsscomp_flip_stats_fops = {
+	.open           = dsscomp_debug_open,
+	.read           = seq_read,
+	.write          = dsscomp_flip_stats_write,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static int dsscomp_probe(struct platform_device *pdev)
 {
+	struct dsscomp_platform_data *pdata = pdev->dev.platform_data;
 	int ret;
 	struct dsscomp_dev *cdev = kzalloc(sizeof(*cdev), GFP_KERNEL);
 	if (!cdev) {
@@ -683,6 +996,9 @@ static int dsscomp_probe(struct platform_device *pdev)
 			cdev->dbgfs, dsscomp_dbg_comps, &dsscomp_debug_fops);
 		debugfs_create_file("gralloc", S_IRUGO,
 			cdev->dbgfs, dsscomp_dbg_gralloc, &dsscomp_debug_fops);
+		debugfs_create_file("flip_stats", S_IRUGO | S_IWUSR,
+			cdev->dbgfs, dsscomp_dbg_flip_stats,
+			&dsscomp_flip_stats_fops);
 #ifdef CONFIG_DSSCOMP_DEBUG_LOG
 		debugfs_create_file("log", S_IRUGO,
 			cdev->dbgfs, dsscomp_dbg_events, &dsscomp_debug_fops);
@@ -701,12 +1017,33 @@ static int dsscomp_probe(struct platform_device *pdev)
 	dsscomp_queue_init(cdev);
 	dsscomp_gralloc_init(cdev);
 
+	if (pdata && pdata->vsync_capture_timer) {
+		vsync_ts = omap_ts_event_get("dss_vsync",
+					     pdata->vsync_capture_timer);
+		if (IS_ERR(vsync_ts)) {
+			dev_warn(DEV(cdev), "vsync stamped at interrupt time\n");
+			vsync_ts = NULL;
+		}
+	}
+
+	mutex_lock(&vsync_mtx);
+	vsync_cdev = cdev;
+	mutex_unlock(&vsync_mtx);
+
 	return 0;
 }
 
 static int dsscomp_remove(struct platform_device *pdev)
 {
 	struct dsscomp_dev *cdev = platform_get_drvdata(pdev);
+
+	mutex_lock(&vsync_mtx);
+	vsync_cdev = NULL;
+	mutex_unlock(&vsync_mtx);
+
+	omap_ts_event_put(vsync_ts);
+	vsync_ts = NULL;
+
 	misc_deregister(&cdev->dev);
 	debugfs_remove_recursive(cdev->dbgfs);
 	dsscomp_queue_exit();
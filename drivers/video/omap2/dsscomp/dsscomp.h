@@ -137,16 +137,21 @@ void dsscomp_queue_exit(void);
 void dsscomp_gralloc_init(struct dsscomp_dev *cdev);
 void dsscomp_gralloc_exit(void);
 int dsscomp_gralloc_queue_ioctl(struct dsscomp_setup_dispc_data *d);
+int dsscomp_gralloc_queue_fence_ioctl(struct dsscomp_setup_dispc_fence_data *f,
+				      void __user *ptr);
+int dsscomp_gralloc_queue_wb_ioctl(struct dsscomp_queue_wb_data *w,
+				   void __user *ptr);
 int dsscomp_wait(struct dsscomp_sync_obj *sync, enum dsscomp_wait_phase phase,
 								int timeout);
 int dsscomp_state_notifier(struct notifier_block *nb,
 						unsigned long arg, void *ptr);
 
 /* basic operation - if not using queues */
-int set_dss_ovl_info(struct dss2_ovl_info *oi);
+int set_dss_ovl_info(struct dss2_ovl_info *oi, struct dss2_rect_t *vis);
 int set_dss_wb_info(struct dss2_ovl_info *oi,
 	enum omap_writeback_source src);
 int set_dss_mgr_info(struct dss2_mgr_info *mi, struct omapdss_ovl_cb *cb);
+int dsscomp_wb_copy(struct dsscomp_wb_copy_data *d);
 struct omap_overlay_manager *find_dss_mgr(int display_ix);
 void swap_rb_in_ovl_info(struct dss2_ovl_info *oi);
 void swap_rb_in_mgr_info(struct dss2_mgr_info *mi);
@@ -171,6 +176,8 @@ const char *dsscomp_get_color_name(enum omap_color_mode m);
 
 void dsscomp_dbg_comps(struct seq_file *s);
 void dsscomp_dbg_gralloc(struct seq_file *s);
+void dsscomp_dbg_flip_stats(struct seq_file *s);
+void dsscomp_gralloc_reset_stats(void);
 
 #define log_state_str(s) (\
 	(s) == DSSCOMP_STATE_ACTIVE		? "ACTIVE"	: \
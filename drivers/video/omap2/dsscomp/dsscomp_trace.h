@@ -0,0 +1,126 @@
+/*
+ * linux/drivers/video/omap2/dsscomp/dsscomp_trace.h
+ *
+ * DSS Composition flip pipeline tracepoints
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM dsscomp
+
+#if !defined(_DSSCOMP_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _DSSCOMP_TRACE_H
+
+#include <linux/tracepoint.h>
+#include "dsscomp.h"
+
+/* gralloc composition queued by user space */
+TRACE_EVENT(dsscomp_queue,
+	TP_PROTO(u32 sync_id, u32 num_mgrs, u32 num_ovls, bool skip),
+	TP_ARGS(sync_id, num_mgrs, num_ovls, skip),
+	TP_STRUCT__entry(
+		__field(u32, sync_id)
+		__field(u32, num_mgrs)
+		__field(u32, num_ovls)
+		__field(bool, skip)
+	),
+	TP_fast_assign(
+		__entry->sync_id = sync_id;
+		__entry->num_mgrs = num_mgrs;
+		__entry->num_ovls = num_ovls;
+		__entry->skip = skip;
+	),
+	TP_printk("sync_id=%08x mgrs=%u ovls=%u%s",
+		  __entry->sync_id, __entry->num_mgrs, __entry->num_ovls,
+		  __entry->skip ? " skipped" : "")
+);
+
+DECLARE_EVENT_CLASS(dsscomp_comp,
+	TP_PROTO(struct dsscomp *comp),
+	TP_ARGS(comp),
+	TP_STRUCT__entry(
+		__field(u32, sync_id)
+		__field(u32, mgr)
+		__field(u32, ovl_mask)
+	),
+	TP_fast_assign(
+		__entry->sync_id = comp->frm.sync_id;
+		__entry->mgr = comp->ix;
+		__entry->ovl_mask = comp->ovl_mask;
+	),
+	TP_printk("sync_id=%08x mgr=%u ovls=%x",
+		  __entry->sync_id, __entry->mgr, __entry->ovl_mask)
+);
+
+/* composition taken off the apply queue */
+DEFINE_EVENT(dsscomp_comp, dsscomp_apply,
+	TP_PROTO(struct dsscomp *comp),
+	TP_ARGS(comp)
+);
+
+/* composition freed, after it was replaced on screen or failed */
+DEFINE_EVENT(dsscomp_comp, dsscomp_release,
+	TP_PROTO(struct dsscomp *comp),
+	TP_ARGS(comp)
+);
+
+/* manager applied and GO bit set, or the error that prevented it */
+TRACE_EVENT(dsscomp_go,
+	TP_PROTO(struct dsscomp *comp, int r),
+	TP_ARGS(comp, r),
+	TP_STRUCT__entry(
+		__field(u32, sync_id)
+		__field(u32, mgr)
+		__field(int, r)
+	),
+	TP_fast_assign(
+		__entry->sync_id = comp->frm.sync_id;
+		__entry->mgr = comp->ix;
+		__entry->r = r;
+	),
+	TP_printk("sync_id=%08x mgr=%u r=%d",
+		  __entry->sync_id, __entry->mgr, __entry->r)
+);
+
+/* DSS2 completion callback: programmed on VSYNC, displayed, released */
+TRACE_EVENT(dsscomp_callback,
+	TP_PROTO(struct dsscomp *comp, int status),
+	TP_ARGS(comp, status),
+	TP_STRUCT__entry(
+		__field(u32, sync_id)
+		__field(u32, mgr)
+		__field(int, status)
+	),
+	TP_fast_assign(
+		__entry->sync_id = comp->frm.sync_id;
+		__entry->mgr = comp->ix;
+		__entry->status = status;
+	),
+	TP_printk("sync_id=%08x mgr=%u status=%s",
+		  __entry->sync_id, __entry->mgr,
+		  __print_symbolic(__entry->status,
+			{ DSS_COMPLETION_PROGRAMMED, "programmed" },
+			{ DSS_COMPLETION_DISPLAYED, "displayed" },
+			{ DSS_COMPLETION_CHANGED_SET, "changed_set" },
+			{ DSS_COMPLETION_CHANGED_CACHE, "changed_cache" },
+			{ DSS_COMPLETION_ECLIPSED_SET, "eclipsed_set" },
+			{ DSS_COMPLETION_ECLIPSED_CACHE, "eclipsed_cache" },
+			{ DSS_COMPLETION_ECLIPSED_SHADOW, "eclipsed_shadow" },
+			{ DSS_COMPLETION_TORN, "torn" }))
+);
+
+#endif /* _DSSCOMP_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_PATH .
+#define TRACE_INCLUDE_FILE dsscomp_trace
+#include <trace/define_trace.h>
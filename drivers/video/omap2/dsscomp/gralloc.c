@@ -23,10 +23,17 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/vmalloc.h>
+#include <linux/file.h>
+#include <linux/jhash.h>
+#include <linux/completion.h>
+#include <linux/module.h>
+#include <linux/workqueue.h>
+#include <linux/sw_sync.h>
 #include "../../../drivers/staging/omapdrm/omap_dmm_tiler.h"
 #include <video/dsscomp.h>
 #include <plat/dsscomp.h>
 #include "dsscomp.h"
+#include "dsscomp_trace.h"
 #include "tiler-utils.h"
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
@@ -34,16 +41,30 @@
 #endif
 static bool blanked;
 
-#define NUM_TILER1D_SLOTS 2
+#define NUM_TILER1D_SLOTS 4
 
+/*
+ * Released slots keep their pages pinned and go to the tail of
+ * free_slots, so the list is in LRU order.  A flip whose 1D page list
+ * hashes to the signature of a free slot takes that slot, and skips the
+ * PAT refill if the page list turns out to be identical; otherwise the
+ * least recently used slot is repinned.
+ */
 static struct tiler1d_slot {
 	struct list_head q;
 	struct tiler_block *block_handle;
 	u32 phys;
 	u32 size;
 	u32 *page_map;
+	u32 pinned;		/* pages currently in the PAT, 0 if none */
+	u32 sig;		/* jhash of page_map[0..pinned) */
 } slots[NUM_TILER1D_SLOTS];
 static struct list_head free_slots;
+static u32 slot_hits, slot_misses;
+
+static unsigned int tiler1d_slots = 2;
+module_param(tiler1d_slots, uint, S_IRUGO);
+MODULE_PARM_DESC(tiler1d_slots, "Number of TILER 1D slots for gralloc flips");
 static struct dsscomp_dev *cdev;
 static DEFINE_MUTEX(mtx);
 static struct semaphore free_slots_sem =
@@ -58,40 +79,350 @@ struct dsscomp_gralloc_t {
 	atomic_t refs;
 	bool early_callback;
 	bool programmed;
+
+	/* fence timeline value, 0 if the flip was queued without fences */
+	u32 fence_value;
+	/* writeback timeline value of the buffer captured into, or 0 */
+	u32 wb_value;
+	u32 ncomps;
+	u32 ndisplayed;
+	bool queued;
+
+	/* flip timing for flip_stats, frame_ns is 0 if not known */
+	ktime_t queued_at;
+	ktime_t programmed_at;
+	u32 frame_ns;
 };
 
 /* queued gralloc compositions */
 static LIST_HEAD(flip_queue);
 
+/*
+ * Timing of the flips that reached DSS since the last reset of the
+ * debugfs file dsscomp/flip_stats, protected by mtx.  The times are
+ * taken in the completion callbacks, which run from a workqueue, so
+ * queue-to-programmed includes its latency.  A flip first displayed more
+ * than a frame after it was programmed missed a vsync for every frame in
+ * between.  DISPC errors are counted from their totals at reset.
+ */
+static struct dsscomp_flip_stats {
+	ktime_t since;
+	u32 queued;
+	u32 programmed;
+	u32 displayed;
+	u32 dropped;		/* released without being displayed */
+	u32 missed_vsyncs;
+	u64 queue_ns, queue_max_ns;	/* queued to programmed */
+	u64 vsync_ns, vsync_max_ns;	/* programmed to first vsync */
+	struct omapdss_error_counts errors;
+} flip_stats;
+
+#ifdef CONFIG_SW_SYNC
+/*
+ * Fenced flips get consecutive values on two sw_sync timelines: the
+ * release timeline reaches a flip's value once the flip and all fenced
+ * flips before it are released, and the retire timeline once they have
+ * all been displayed.  Values are reserved in the ioctl, in queue order,
+ * and fence_queued tracks the last one whose flip reached flip_queue so
+ * that reserved but not yet queued flips are never signaled.  All of
+ * this except fence_reserved is protected by mtx.
+ */
+#define DSSCOMP_FENCE_TIMEOUT_MS	1000
+
+static struct sw_sync_timeline *release_timeline;
+static struct sw_sync_timeline *retire_timeline;
+static struct workqueue_struct *fence_wkq;
+static DEFINE_MUTEX(fence_mtx);
+static u32 fence_reserved;	/* protected by fence_mtx */
+static u32 fence_queued;
+static u32 release_signaled;
+static u32 retire_signaled;
+
+/*
+ * Writeback buffers queued with DSSCIOC_QUEUE_WB wait on wb_queue for
+ * the next flip on their display, and are only taken from the head so
+ * that the wb timeline is signaled in queue order.
+ */
+static struct sw_sync_timeline *wb_timeline;
+static LIST_HEAD(wb_queue);
+static u32 wb_reserved;		/* protected by fence_mtx */
+static u32 wb_signaled;
+
+struct dsscomp_wb_buf {
+	struct list_head q;
+	struct dss2_ovl_info wb;
+	u32 display_ix;
+	u32 value;
+};
+
+/* fenced flip waiting for its acquire fences */
+struct dsscomp_fence_flip {
+	struct work_struct work;
+	struct dsscomp_setup_dispc_data d;
+	struct tiler_pa_info *pas[MAX_OVERLAYS];
+	struct sync_fence *acquire[MAX_OVERLAYS];
+	u32 fence_value;
+};
+
+/* bring the timelines up to date with flip_queue, must hold mtx */
+static void dsscomp_fence_update(u32 *release_inc, u32 *retire_inc)
+{
+	struct dsscomp_gralloc_t *gsync;
+	u32 release_to = fence_queued, retire_to = fence_queued;
+	bool release_found = false;
+
+	list_for_each_entry(gsync, &flip_queue, q) {
+		if (!gsync->fence_value)
+			continue;
+		if (!release_found) {
+			release_to = gsync->fence_value - 1;
+			release_found = true;
+		}
+		if (!gsync->queued || gsync->ndisplayed < gsync->ncomps) {
+			retire_to = gsync->fence_value - 1;
+			break;
+		}
+	}
+
+	*release_inc = 0;
+	if ((s32)(release_to - release_signaled) > 0) {
+		*release_inc = release_to - release_signaled;
+		release_signaled = release_to;
+	}
+	*retire_inc = 0;
+	if ((s32)(retire_to - retire_signaled) > 0) {
+		*retire_inc = retire_to - retire_signaled;
+		retire_signaled = retire_to;
+	}
+}
+
+static void dsscomp_fence_signal(u32 release_inc, u32 retire_inc)
+{
+	if (release_inc)
+		sw_sync_timeline_inc(release_timeline, release_inc);
+	if (retire_inc)
+		sw_sync_timeline_inc(retire_timeline, retire_inc);
+}
+
+/* account for writeback buffers of completed flips, must hold mtx */
+static u32 dsscomp_wb_update(struct list_head *done)
+{
+	struct dsscomp_gralloc_t *gsync;
+	u32 wb_to = wb_signaled, wb_inc;
+
+	list_for_each_entry(gsync, done, q)
+		if (gsync->wb_value)
+			wb_to = gsync->wb_value;
+
+	wb_inc = (s32)(wb_to - wb_signaled) > 0 ? wb_to - wb_signaled : 0;
+	wb_signaled += wb_inc;
+	return wb_inc;
+}
+
+static void dsscomp_wb_signal(u32 wb_inc)
+{
+	if (wb_inc)
+		sw_sync_timeline_inc(wb_timeline, wb_inc);
+}
+
+/* capture comp into the writeback buffer at the head of wb_queue */
+static bool dsscomp_wb_attach(struct dsscomp *comp,
+			      struct dsscomp_gralloc_t *gsync)
+{
+	struct omap_dss_device *dev;
+	struct dsscomp_wb_buf *buf = NULL;
+	int r;
+
+	mutex_lock(&mtx);
+	if (!list_empty(&wb_queue)) {
+		buf = list_first_entry(&wb_queue, typeof(*buf), q);
+		if (buf->display_ix == comp->frm.mgr.ix)
+			list_del(&buf->q);
+		else
+			buf = NULL;
+	}
+	mutex_unlock(&mtx);
+	if (!buf)
+		return false;
+
+	/* writeback captures the whole output of the manager */
+	dev = cdev->displays[buf->display_ix];
+	buf->wb.cfg.ix = OMAP_DSS_WB;
+	buf->wb.cfg.mgr_ix = comp->ix;
+	buf->wb.cfg.enabled = true;
+	buf->wb.cfg.crop.x = buf->wb.cfg.crop.y = 0;
+	buf->wb.cfg.crop.w = dev->panel.timings.x_res;
+	buf->wb.cfg.crop.h = dev->panel.timings.y_res;
+
+	r = dsscomp_set_ovl(comp, &buf->wb);
+	if (r)
+		dev_warn(DEV(cdev), "failed to capture into wb buffer (%d)\n",
+			 r);
+
+	/* the buffer is released with the flip, even if it was not used */
+	mutex_lock(&mtx);
+	gsync->wb_value = buf->value;
+	mutex_unlock(&mtx);
+
+	kfree(buf);
+	return !r;
+}
+#else
+static inline void dsscomp_fence_update(u32 *release_inc, u32 *retire_inc)
+{
+	*release_inc = *retire_inc = 0;
+}
+
+static inline void dsscomp_fence_signal(u32 release_inc, u32 retire_inc)
+{
+}
+
+static inline u32 dsscomp_wb_update(struct list_head *done)
+{
+	return 0;
+}
+
+static inline void dsscomp_wb_signal(u32 wb_inc)
+{
+}
+
+static inline bool dsscomp_wb_attach(struct dsscomp *comp,
+				     struct dsscomp_gralloc_t *gsync)
+{
+	return false;
+}
+#endif
+
 static u32 ovl_use_mask[MAX_MANAGERS];
 
-static void unpin_tiler_blocks(struct list_head *slots)
+static void release_tiler_slots(struct list_head *slots)
 {
 	struct tiler1d_slot *slot;
 
-	/* unpin any tiler memory */
-	list_for_each_entry(slot, slots, q) {
-		tiler_unpin(slot->block_handle);
+	/* pages stay pinned so the slot can be reused as is */
+	list_for_each_entry(slot, slots, q)
 		up(&free_slots_sem);
+
+	/* free tiler slots, most recently used last */
+	list_splice_tail_init(slots, &free_slots);
+}
+
+/* number of pages an overlay takes up in a 1D slot */
+static u32 tiler1d_ovl_pages(struct dss2_ovl_info *oi)
+{
+	u32 size = oi->cfg.stride * oi->cfg.height;
+
+	if (oi->cfg.color_mode == OMAP_DSS_COLOR_NV12)
+		size += size >> 2;
+	return DIV_ROUND_UP(size, PAGE_SIZE);
+}
+
+/* guess the signature of the 1D page list this flip will use */
+static u32 tiler1d_flip_sig(struct dsscomp_setup_dispc_data *d,
+			    struct tiler_pa_info **pas)
+{
+	u32 sig = 0;
+	u32 i;
+
+	for (i = 0; i < d->num_ovls; i++) {
+		struct dss2_ovl_info *oi = d->ovls + i;
+
+		if (oi->addressing != OMAP_DSS_BUFADDR_DIRECT || !pas[i] ||
+		    !oi->cfg.enabled)
+			continue;
+		sig = jhash2(pas[i]->mem, tiler1d_ovl_pages(oi), sig);
 	}
+	return sig;
+}
+
+/* pick a free slot, preferring one already pinned with @sig, must hold mtx */
+static struct tiler1d_slot *tiler1d_get_slot(u32 sig)
+{
+	struct tiler1d_slot *slot;
+
+	list_for_each_entry(slot, &free_slots, q)
+		if (slot->pinned && slot->sig == sig)
+			return slot;
+	return list_first_entry(&free_slots, typeof(*slot), q);
+}
+
+/* background TILER 1D slot refill */
+struct tiler1d_pin {
+	struct completion done;
+	int err;
+};
+
+static void tiler1d_pin_done(void *data, int err)
+{
+	struct tiler1d_pin *pin = data;
+
+	pin->err = err;
+	complete(&pin->done);
+}
 
-	/* free tiler slots */
-	list_splice_init(slots, &free_slots);
+/* frame period of a display's current timings */
+static u32 dsscomp_frame_ns(struct omap_dss_device *dev)
+{
+	struct omap_video_timings *t = &dev->panel.timings;
+	u64 pixels = (u64) (t->x_res + t->hfp + t->hsw + t->hbp) *
+			   (t->y_res + t->vfp + t->vsw + t->vbp);
+
+	if (!t->pixel_clock)
+		return 0;
+	/* pixel_clock is in kHz */
+	return div_u64(pixels * USEC_PER_SEC, t->pixel_clock);
+}
+
+/* account the first programming and display of a flip, under mtx */
+static void dsscomp_flip_programmed(struct dsscomp_gralloc_t *gsync)
+{
+	u64 ns;
+
+	gsync->programmed_at = ktime_get();
+	ns = ktime_to_ns(ktime_sub(gsync->programmed_at, gsync->queued_at));
+	flip_stats.programmed++;
+	flip_stats.queue_ns += ns;
+	flip_stats.queue_max_ns = max(flip_stats.queue_max_ns, ns);
+}
+
+static void dsscomp_flip_displayed(struct dsscomp_gralloc_t *gsync)
+{
+	u64 ns;
+
+	if (!gsync->programmed_at.tv64)
+		return;
+	ns = ktime_to_ns(ktime_sub(ktime_get(), gsync->programmed_at));
+	flip_stats.displayed++;
+	flip_stats.vsync_ns += ns;
+	flip_stats.vsync_max_ns = max(flip_stats.vsync_max_ns, ns);
+	if (gsync->frame_ns)
+		flip_stats.missed_vsyncs += div_u64(ns, gsync->frame_ns);
 }
 
 static void dsscomp_gralloc_cb(void *data, int status)
 {
 	struct dsscomp_gralloc_t *gsync = data, *gsync_;
 	bool early_cbs = true;
+	u32 release_inc, retire_inc, wb_inc;
 	LIST_HEAD(done);
 
 	mutex_lock(&mtx);
 	if (gsync->early_callback && status == DSS_COMPLETION_PROGRAMMED)
 		gsync->programmed = true;
 
+	if (status == DSS_COMPLETION_PROGRAMMED &&
+	    !gsync->programmed_at.tv64)
+		dsscomp_flip_programmed(gsync);
+
+	if (status == DSS_COMPLETION_DISPLAYED) {
+		if (!gsync->ndisplayed)
+			dsscomp_flip_displayed(gsync);
+		gsync->ndisplayed++;
+	}
+
 	if (status & DSS_COMPLETION_RELEASED) {
 		if (atomic_dec_and_test(&gsync->refs))
-			unpin_tiler_blocks(&gsync->slots);
+			release_tiler_slots(&gsync->slots);
 
 		log_event(0, 0, gsync, "--refs=%d on %s",
 				atomic_read(&gsync->refs),
@@ -109,11 +440,19 @@ static void dsscomp_gralloc_cb(void *data, int status)
 		}
 		if (gsync->refs.counter && gsync->cb_fn)
 			break;
-		if (gsync->refs.counter == 0)
+		if (gsync->refs.counter == 0) {
+			if (gsync->ncomps && !gsync->ndisplayed)
+				flip_stats.dropped++;
 			list_move_tail(&gsync->q, &done);
+		}
 	}
+	dsscomp_fence_update(&release_inc, &retire_inc);
+	wb_inc = dsscomp_wb_update(&done);
 	mutex_unlock(&mtx);
 
+	dsscomp_fence_signal(release_inc, retire_inc);
+	dsscomp_wb_signal(wb_inc);
+
 	/* call back for completed composition with mutex unlocked */
 	list_for_each_entry_safe(gsync, gsync_, &done, q) {
 		if (debug & DEBUG_GRALLOC_PHASES)
@@ -128,16 +467,12 @@ static void dsscomp_gralloc_cb(void *data, int status)
 	}
 }
 
-/* This is just test code for now that does the setup + apply.
-   It still uses userspace virtual addresses, but maps non
-   TILER buffers into 1D */
-int dsscomp_gralloc_queue_ioctl(struct dsscomp_setup_dispc_data *d)
+/* convert virtual addresses to physical and get tiler pa infos */
+static void dsscomp_gralloc_map_user(struct dsscomp_setup_dispc_data *d,
+				     struct tiler_pa_info **pas)
 {
-	struct tiler_pa_info *pas[MAX_OVERLAYS];
-	s32 ret;
 	u32 i;
 
-	/* convert virtual addresses to physical and get tiler pa infos */
 	for (i = 0; i < d->num_ovls; i++) {
 		struct dss2_ovl_info *oi = d->ovls + i;
 		u32 addr = (u32) oi->address;
@@ -160,12 +495,262 @@ int dsscomp_gralloc_queue_ioctl(struct dsscomp_setup_dispc_data *d)
 				PAGE_ALIGN(oi->cfg.height * oi->cfg.stride +
 					(addr & ~PAGE_MASK)) >> PAGE_SHIFT);
 	}
+}
+
+static int __dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
+			struct tiler_pa_info **pas,
+			bool early_callback,
+			void (*cb_fn)(void *, int), void *cb_arg,
+			u32 fence_value);
+
+/* This is just test code for now that does the setup + apply.
+   It still uses userspace virtual addresses, but maps non
+   TILER buffers into 1D */
+int dsscomp_gralloc_queue_ioctl(struct dsscomp_setup_dispc_data *d)
+{
+	struct tiler_pa_info *pas[MAX_OVERLAYS];
+	s32 ret;
+	u32 i;
+
+	d->num_ovls = min_t(u16, d->num_ovls, ARRAY_SIZE(d->ovls));
+	dsscomp_gralloc_map_user(d, pas);
 	ret = dsscomp_gralloc_queue(d, pas, false, NULL, NULL);
 	for (i = 0; i < d->num_ovls; i++)
 		tiler_pa_free(pas[i]);
 	return ret;
 }
 
+#ifdef CONFIG_SW_SYNC
+static void dsscomp_fence_flip_work(struct work_struct *work)
+{
+	struct dsscomp_fence_flip *flip =
+		container_of(work, struct dsscomp_fence_flip, work);
+	struct dsscomp_setup_dispc_data *d = &flip->d;
+	int r;
+	u32 i;
+
+	/* wait for the producers; do not scan out an unfinished buffer */
+	for (i = 0; i < d->num_ovls; i++) {
+		if (!flip->acquire[i])
+			continue;
+		r = sync_fence_wait(flip->acquire[i], DSSCOMP_FENCE_TIMEOUT_MS);
+		if (r) {
+			dev_warn(DEV(cdev), "acquire fence for ovl%d failed "
+					"(%d)\n", d->ovls[i].cfg.ix, r);
+			d->ovls[i].cfg.enabled = false;
+		}
+		sync_fence_put(flip->acquire[i]);
+	}
+
+	__dsscomp_gralloc_queue(d, flip->pas, false, NULL, NULL,
+				flip->fence_value);
+
+	for (i = 0; i < d->num_ovls; i++)
+		tiler_pa_free(flip->pas[i]);
+	kfree(flip);
+}
+
+static struct sync_fence *dsscomp_fence_create(struct sw_sync_timeline *tl,
+					       const char *name, u32 value)
+{
+	struct sync_pt *pt = sw_sync_pt_create(tl, value);
+	struct sync_fence *fence;
+
+	if (!pt)
+		return NULL;
+	fence = sync_fence_create(name, pt);
+	if (!fence)
+		sync_pt_free(pt);
+	return fence;
+}
+
+/*
+ * Queue a flip that is applied from fence_wkq once its acquire fences
+ * have signaled, and return release and retire fences for it right away.
+ * User addresses are translated here, as the worker has no user context.
+ */
+int dsscomp_gralloc_queue_fence_ioctl(struct dsscomp_setup_dispc_fence_data *f,
+				      void __user *ptr)
+{
+	struct dsscomp_setup_dispc_fence_data __user *uf = ptr;
+	struct dsscomp_setup_dispc_data *d = &f->dispc;
+	struct sync_fence *release[MAX_OVERLAYS] = { NULL };
+	struct sync_fence *retire = NULL;
+	struct dsscomp_fence_flip *flip;
+	int r = 0;
+	u32 i;
+
+	if (!release_timeline || !retire_timeline || !fence_wkq)
+		return -ENODEV;
+
+	flip = kzalloc(sizeof(*flip), GFP_KERNEL);
+	if (!flip)
+		return -ENOMEM;
+	INIT_WORK(&flip->work, dsscomp_fence_flip_work);
+
+	d->num_ovls = min_t(u16, d->num_ovls, ARRAY_SIZE(d->ovls));
+	for (i = 0; i < ARRAY_SIZE(f->release_fence); i++)
+		f->release_fence[i] = -1;
+	f->retire_fence = -1;
+
+	for (i = 0; i < d->num_ovls; i++) {
+		if (f->acquire_fence[i] < 0)
+			continue;
+		flip->acquire[i] = sync_fence_fdget(f->acquire_fence[i]);
+		if (!flip->acquire[i]) {
+			r = -EINVAL;
+			goto err_acquire;
+		}
+	}
+
+	flip->d = *d;
+	dsscomp_gralloc_map_user(&flip->d, flip->pas);
+
+	mutex_lock(&fence_mtx);
+	if (!++fence_reserved)
+		++fence_reserved;
+	flip->fence_value = fence_reserved;
+
+	for (i = 0; i < d->num_ovls; i++) {
+		release[i] = dsscomp_fence_create(release_timeline,
+				"dsscomp-release", flip->fence_value);
+		f->release_fence[i] = get_unused_fd();
+		if (!release[i] || f->release_fence[i] < 0) {
+			r = -ENOMEM;
+			goto err_fences;
+		}
+	}
+	retire = dsscomp_fence_create(retire_timeline, "dsscomp-retire",
+				      flip->fence_value);
+	f->retire_fence = get_unused_fd();
+	if (!retire || f->retire_fence < 0) {
+		r = -ENOMEM;
+		goto err_fences;
+	}
+
+	if (copy_to_user(uf->release_fence, f->release_fence,
+			 sizeof(f->release_fence)) ||
+	    copy_to_user(&uf->retire_fence, &f->retire_fence,
+			 sizeof(f->retire_fence))) {
+		r = -EFAULT;
+		goto err_fences;
+	}
+
+	for (i = 0; i < d->num_ovls; i++)
+		sync_fence_install(release[i], f->release_fence[i]);
+	sync_fence_install(retire, f->retire_fence);
+
+	queue_work(fence_wkq, &flip->work);
+	mutex_unlock(&fence_mtx);
+	return 0;
+
+err_fences:
+	mutex_unlock(&fence_mtx);
+	for (i = 0; i < d->num_ovls; i++) {
+		if (release[i])
+			sync_fence_put(release[i]);
+		if (f->release_fence[i] >= 0)
+			put_unused_fd(f->release_fence[i]);
+	}
+	if (retire)
+		sync_fence_put(retire);
+	if (f->retire_fence >= 0)
+		put_unused_fd(f->retire_fence);
+	for (i = 0; i < d->num_ovls; i++)
+		tiler_pa_free(flip->pas[i]);
+err_acquire:
+	for (i = 0; i < d->num_ovls; i++)
+		if (flip->acquire[i])
+			sync_fence_put(flip->acquire[i]);
+	kfree(flip);
+	return r;
+}
+
+/*
+ * Queue a buffer for the next flip on its display to be captured into,
+ * and return a fence that signals once that flip has been released.
+ * The buffer may be written as soon as a flip is queued, so its acquire
+ * fence is waited on here.
+ */
+int dsscomp_gralloc_queue_wb_ioctl(struct dsscomp_queue_wb_data *w,
+				   void __user *ptr)
+{
+	struct dsscomp_queue_wb_data __user *uw = ptr;
+	struct dsscomp_wb_buf *buf;
+	struct sync_fence *release;
+	int r;
+
+	if (!wb_timeline || !cdev->wb_ovl)
+		return -ENODEV;
+	if (w->wb.cfg.ix != OMAP_DSS_WB || !w->wb.ba ||
+	    w->mgr_ix >= cdev->num_displays || !cdev->displays[w->mgr_ix])
+		return -EINVAL;
+
+	if (w->acquire_fence >= 0) {
+		struct sync_fence *acquire = sync_fence_fdget(w->acquire_fence);
+
+		if (!acquire)
+			return -EINVAL;
+		r = sync_fence_wait(acquire, DSSCOMP_FENCE_TIMEOUT_MS);
+		sync_fence_put(acquire);
+		if (r)
+			return r;
+	}
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	buf->wb = w->wb;
+	buf->display_ix = w->mgr_ix;
+
+	mutex_lock(&fence_mtx);
+	if (!++wb_reserved)
+		++wb_reserved;
+	buf->value = wb_reserved;
+
+	release = dsscomp_fence_create(wb_timeline, "dsscomp-wb", buf->value);
+	w->release_fence = get_unused_fd();
+	if (!release || w->release_fence < 0) {
+		r = -ENOMEM;
+		goto err;
+	}
+	if (copy_to_user(&uw->release_fence, &w->release_fence,
+			 sizeof(w->release_fence))) {
+		r = -EFAULT;
+		goto err;
+	}
+	sync_fence_install(release, w->release_fence);
+
+	mutex_lock(&mtx);
+	list_add_tail(&buf->q, &wb_queue);
+	mutex_unlock(&mtx);
+	mutex_unlock(&fence_mtx);
+	return 0;
+
+err:
+	/* nothing waits for this value, later buffers will signal past it */
+	mutex_unlock(&fence_mtx);
+	if (release)
+		sync_fence_put(release);
+	if (w->release_fence >= 0)
+		put_unused_fd(w->release_fence);
+	kfree(buf);
+	return r;
+}
+#else
+int dsscomp_gralloc_queue_fence_ioctl(struct dsscomp_setup_dispc_fence_data *f,
+				      void __user *ptr)
+{
+	return -EINVAL;
+}
+
+int dsscomp_gralloc_queue_wb_ioctl(struct dsscomp_queue_wb_data *w,
+				   void __user *ptr)
+{
+	return -EINVAL;
+}
+#endif
+
 static bool dsscomp_is_any_device_active(void)
 {
 	struct omap_dss_device *dssdev;
@@ -182,10 +767,11 @@ static bool dsscomp_is_any_device_active(void)
 	return false;
 }
 
-int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
+static int __dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 			struct tiler_pa_info **pas,
 			bool early_callback,
-			void (*cb_fn)(void *, int), void *cb_arg)
+			void (*cb_fn)(void *, int), void *cb_arg,
+			u32 fence_value)
 {
 	u32 i;
 	int r = 0;
@@ -198,6 +784,10 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 	u32 ovl_set_mask = 0;
 	struct tiler1d_slot *slot = NULL;
 	u32 slot_used = 0;
+	u32 slot_sig = 0;
+	bool slot_dirty = false;
+	struct tiler1d_pin pin;
+	bool pinning = false;
 #ifdef CONFIG_DEBUG_FS
 	u32 ms = ktime_to_ms(ktime_get());
 #endif
@@ -223,8 +813,14 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 	gsync->cb_fn = cb_fn;
 	gsync->refs.counter = 1;
 	gsync->early_callback = early_callback;
+	gsync->fence_value = fence_value;
+	gsync->queued_at = ktime_get();
 	INIT_LIST_HEAD(&gsync->slots);
 	list_add_tail(&gsync->q, &flip_queue);
+#ifdef CONFIG_SW_SYNC
+	if (fence_value)
+		fence_queued = fence_value;
+#endif
 	if (debug & DEBUG_GRALLOC_PHASES)
 		dev_info(DEV(cdev), "[%p] queuing flip\n", gsync);
 
@@ -244,6 +840,7 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 
 	d->num_mgrs = min_t(u16, d->num_mgrs, ARRAY_SIZE(d->mgrs));
 	d->num_ovls = min_t(u16, d->num_ovls, ARRAY_SIZE(d->ovls));
+	trace_dsscomp_queue(d->sync_id, d->num_mgrs, d->num_ovls, skip);
 
 	memset(comp, 0, sizeof(comp));
 	memset(ovl_new_use_mask, 0, sizeof(ovl_new_use_mask));
@@ -273,6 +870,8 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 		ch = mgr->id;
 		channels[i] = ch;
 		mgr_set_mask |= 1 << ch;
+		if (!gsync->frame_ns)
+			gsync->frame_ns = dsscomp_frame_ns(dev);
 
 		/* swap red & blue if requested */
 		if (d->mgrs[i].swap_rb)
@@ -293,6 +892,7 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 					mgr->name);
 			continue;
 		}
+		comp[ch]->frm.sync_id = d->sync_id;
 
 		/* set basic manager information for blanked managers */
 		if (!(mgr_set_mask & (1 << ch))) {
@@ -396,15 +996,12 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 				goto skip_buffer;
 			}
 			mutex_lock(&mtx);
-			slot = list_first_entry(&free_slots, typeof(*slot), q);
+			slot = tiler1d_get_slot(tiler1d_flip_sig(d, pas));
 			list_move(&slot->q, &gsync->slots);
 			mutex_unlock(&mtx);
 		}
 
-		size = oi->cfg.stride * oi->cfg.height;
-		if (oi->cfg.color_mode == OMAP_DSS_COLOR_NV12)
-			size += size >> 2;
-		size = DIV_ROUND_UP(size, PAGE_SIZE);
+		size = tiler1d_ovl_pages(oi);
 
 		if (slot_used + size > slot->size) {
 			dev_err(DEV(cdev), "tiler slot not big enough for "
@@ -418,8 +1015,14 @@ int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
 			(oi->ba & ~PAGE_MASK);
 		if (oi->cfg.color_mode == OMAP_DSS_COLOR_NV12)
 			oi->uv = oi->ba + oi->cfg.stride * oi->cfg.height;
-		memcpy(slot->page_map + slot_used, pas[i]->mem,
-		       sizeof(*slot->page_map) * size);
+		if (slot_dirty || slot_used + size > slot->pinned ||
+		    memcmp(slot->page_map + slot_used, pas[i]->mem,
+			   sizeof(*slot->page_map) * size)) {
+			memcpy(slot->page_map + slot_used, pas[i]->mem,
+			       sizeof(*slot->page_map) * size);
+			slot_dirty = true;
+		}
+		slot_sig = jhash2(pas[i]->mem, size, slot_sig);
 		slot_used += size;
 		goto skip_map1d;
 
@@ -438,15 +1041,44 @@ skip_map1d:
 			ovl_set_mask |= 1 << oi->cfg.ix;
 	}
 
-	if (slot && slot_used) {
-		r = tiler_pin_phys(slot->block_handle, slot->page_map,
-						slot_used);
+	if (slot && slot_used && !slot_dirty && slot_used == slot->pinned) {
+		/* same pages as last time, the PAT is already set up */
+		slot_hits++;
+	} else if (slot && slot_used) {
+		slot_misses++;
+		/* refill the PAT while the rest of the flip is set up */
+		init_completion(&pin.done);
+		r = tiler_pin_phys_async(slot->block_handle, slot->page_map,
+					slot_used, tiler1d_pin_done, &pin);
+		pinning = !r;
+		slot->pinned = r ? 0 : slot_used;
+		slot->sig = slot_sig;
 		if (r)
 			dev_err(DEV(cdev), "failed to pin %d pages into"
 				" %d-pg slots (%d)\n", slot_used,
 				tiler1d_slot_size(cdev) >> PAGE_SHIFT, r);
 	}
 
+	/* capture into a queued writeback buffer unless the flip does */
+	for (ch = 0; ch < MAX_MANAGERS; ch++) {
+		if (comp[ch] && !(ovl_set_mask & (1 << OMAP_DSS_WB)) &&
+		    dsscomp_wb_attach(comp[ch], gsync)) {
+			ovl_set_mask |= 1 << OMAP_DSS_WB;
+			ovl_new_use_mask[ch] |= 1 << OMAP_DSS_WB;
+		}
+	}
+
+	/* the slot must be mapped before any composition may be applied */
+	if (pinning) {
+		wait_for_completion(&pin.done);
+		r = pin.err;
+		if (r) {
+			slot->pinned = 0;
+			dev_err(DEV(cdev), "failed to refill %d-pg slot (%d)\n",
+				slot_used, r);
+		}
+	}
+
 	for (ch = 0; ch < MAX_MANAGERS; ch++) {
 		/* disable all overlays not specifically set from prior frame */
 		u32 mask = ovl_use_mask[ch] & ~ovl_set_mask;
@@ -455,10 +1087,12 @@ skip_map1d:
 			continue;
 
 		while (mask) {
+			/* writeback is only disabled from its own manager */
 			struct dss2_ovl_info oi = {
 				.cfg.zonly = true,
 				.cfg.enabled = false,
 				.cfg.ix = fls(mask) - 1,
+				.cfg.mgr_ix = ch,
 			};
 			dsscomp_set_ovl(comp[ch], &oi);
 			mask &= ~(1 << oi.cfg.ix);
@@ -468,6 +1102,9 @@ skip_map1d:
 		comp[ch]->extra_cb = dsscomp_gralloc_cb;
 		comp[ch]->extra_cb_data = gsync;
 		atomic_inc(&gsync->refs);
+		mutex_lock(&mtx);
+		gsync->ncomps++;
+		mutex_unlock(&mtx);
 		log_event(0, ms, gsync, "++refs=%d for [%p]",
 				atomic_read(&gsync->refs), (u32) comp[ch]);
 
@@ -478,6 +1115,12 @@ skip_map1d:
 			ovl_use_mask[ch] = ovl_new_use_mask[ch];
 	}
 skip_comp:
+	mutex_lock(&mtx);
+	gsync->queued = true;
+	if (gsync->ncomps)
+		flip_stats.queued++;
+	mutex_unlock(&mtx);
+
 	/* release sync object ref - this completes unapplied compositions */
 	dsscomp_gralloc_cb(gsync, DSS_COMPLETION_RELEASED);
 
@@ -485,6 +1128,15 @@ skip_comp:
 
 	return r;
 }
+
+int dsscomp_gralloc_queue(struct dsscomp_setup_dispc_data *d,
+			struct tiler_pa_info **pas,
+			bool early_callback,
+			void (*cb_fn)(void *, int), void *cb_arg)
+{
+	return __dsscomp_gralloc_queue(d, pas, early_callback, cb_fn, cb_arg,
+				       0);
+}
 EXPORT_SYMBOL(dsscomp_gralloc_queue);
 
 #ifdef CONFIG_EARLYSUSPEND
@@ -543,6 +1195,8 @@ void dsscomp_dbg_gralloc(struct seq_file *s)
 #endif
 
 	mutex_lock(&dbg_mtx);
+	seq_printf(s, "TILER1D SLOT REUSE: %u hits, %u misses\n\n",
+		   slot_hits, slot_misses);
 	seq_printf(s, "ACTIVE GRALLOC FLIPS\n\n");
 	list_for_each_entry(g, &flip_queue, q) {
 		char *sep = "";
@@ -599,6 +1253,49 @@ void dsscomp_dbg_gralloc(struct seq_file *s)
 #endif
 }
 
+void dsscomp_dbg_flip_stats(struct seq_file *s)
+{
+#ifdef CONFIG_DEBUG_FS
+	struct dsscomp_flip_stats st;
+	struct omapdss_error_counts errors;
+	u64 queue_avg_ns, vsync_avg_ns;
+
+	mutex_lock(&mtx);
+	st = flip_stats;
+	mutex_unlock(&mtx);
+	omap_dss_get_error_counts(&errors);
+
+	queue_avg_ns = st.programmed ? div_u64(st.queue_ns, st.programmed) : 0;
+	vsync_avg_ns = st.displayed ? div_u64(st.vsync_ns, st.displayed) : 0;
+
+	seq_printf(s, "since reset: %llu ms\n",
+		   div_u64(ktime_to_ns(ktime_sub(ktime_get(), st.since)),
+			   NSEC_PER_MSEC));
+	seq_printf(s, "flips: %u queued, %u programmed, %u displayed, "
+		   "%u dropped\n", st.queued, st.programmed, st.displayed,
+		   st.dropped);
+	seq_printf(s, "queue to programmed: avg %llu us, max %llu us\n",
+		   div_u64(queue_avg_ns, NSEC_PER_USEC),
+		   div_u64(st.queue_max_ns, NSEC_PER_USEC));
+	seq_printf(s, "programmed to vsync: avg %llu us, max %llu us\n",
+		   div_u64(vsync_avg_ns, NSEC_PER_USEC),
+		   div_u64(st.vsync_max_ns, NSEC_PER_USEC));
+	seq_printf(s, "missed vsyncs: %u\n", st.missed_vsyncs);
+	seq_printf(s, "FIFO underflows: %u, sync lost: %u\n",
+		   errors.underflows - st.errors.underflows,
+		   errors.sync_lost - st.errors.sync_lost);
+#endif
+}
+
+void dsscomp_gralloc_reset_stats(void)
+{
+	mutex_lock(&mtx);
+	memset(&flip_stats, 0, sizeof(flip_stats));
+	flip_stats.since = ktime_get();
+	omap_dss_get_error_counts(&flip_stats.errors);
+	mutex_unlock(&mtx);
+}
+
 void dsscomp_gralloc_init(struct dsscomp_dev *cdev_)
 {
 	int i;
@@ -617,7 +1314,9 @@ void dsscomp_gralloc_init(struct dsscomp_dev *cdev_)
 
 	if (!free_slots.next) {
 		INIT_LIST_HEAD(&free_slots);
-		for (i = 0; i < NUM_TILER1D_SLOTS; i++) {
+		tiler1d_slots = clamp_t(unsigned int, tiler1d_slots, 1,
+					NUM_TILER1D_SLOTS);
+		for (i = 0; i < tiler1d_slots; i++) {
 			struct tiler_block *block_handle =
 				tiler_reserve_1d(tiler1d_slot_size(cdev_));
 			if (IS_ERR_OR_NULL(block_handle)) {
@@ -641,6 +1340,20 @@ void dsscomp_gralloc_init(struct dsscomp_dev *cdev_)
 		if (!i)
 			ZERO(free_slots);
 	}
+
+#ifdef CONFIG_SW_SYNC
+	mutex_lock(&fence_mtx);
+	if (!fence_wkq && !release_timeline) {
+		release_timeline = sw_sync_timeline_create("dsscomp-release");
+		retire_timeline = sw_sync_timeline_create("dsscomp-retire");
+		wb_timeline = sw_sync_timeline_create("dsscomp-wb");
+		fence_wkq = alloc_ordered_workqueue("dsscomp_fence", 0);
+		if (!release_timeline || !retire_timeline || !wb_timeline ||
+		    !fence_wkq)
+			pr_err("could not set up dsscomp fences\n");
+	}
+	mutex_unlock(&fence_mtx);
+#endif
 }
 
 void dsscomp_gralloc_exit(void)
@@ -656,4 +1369,24 @@ void dsscomp_gralloc_exit(void)
 		tiler_unpin(slot->block_handle);
 	}
 	INIT_LIST_HEAD(&free_slots);
+
+#ifdef CONFIG_SW_SYNC
+	if (fence_wkq)
+		destroy_workqueue(fence_wkq);
+	if (release_timeline)
+		sync_timeline_destroy(&release_timeline->obj);
+	if (retire_timeline)
+		sync_timeline_destroy(&retire_timeline->obj);
+	if (wb_timeline)
+		sync_timeline_destroy(&wb_timeline->obj);
+	fence_wkq = NULL;
+	release_timeline = retire_timeline = wb_timeline = NULL;
+
+	while (!list_empty(&wb_queue)) {
+		struct dsscomp_wb_buf *buf =
+			list_first_entry(&wb_queue, typeof(*buf), q);
+		list_del(&buf->q);
+		kfree(buf);
+	}
+#endif
 }
@@ -20,6 +20,7 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/module.h>
 #include <linux/vmalloc.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
@@ -32,6 +33,10 @@
 #include <linux/debugfs.h>
 
 #include "dsscomp.h"
+
+#define CREATE_TRACE_POINTS
+#include "dsscomp_trace.h"
+
 /* queue state */
 
 static DEFINE_MUTEX(mtx);
@@ -48,8 +53,21 @@ static struct {
 	u32 ovl_mask;			/* overlays used on this display */
 	struct maskref ovl_qmask;	/* overlays queued to this display */
 	bool blanking;
+
+	struct dsscomp *last;		/* last composition queued for apply */
+	u32 superseded;			/* compositions dropped as stale */
 } mgrq[MAX_MANAGERS];
 
+/*
+ * Managers in mailbox mode only program the latest queued composition:
+ * a composition that is still waiting to be applied when a newer one is
+ * queued behind it is released without being programmed, as long as the
+ * newer one sets every overlay the older one touches.
+ */
+static u32 mailbox_mgrs;
+module_param(mailbox_mgrs, uint, 0644);
+MODULE_PARM_DESC(mailbox_mgrs, "Mask of managers that skip stale compositions");
+
 static struct workqueue_struct *cb_wkq;		/* callback work queue */
 static struct dsscomp_dev *cdev;
 
@@ -371,6 +389,7 @@ void dsscomp_drop(struct dsscomp *comp)
 	if (comp->state < DSSCOMP_STATE_PROGRAMMED)
 		maskref_decmask(&mgrq[comp->ix].ovl_qmask, comp->ovl_mask);
 	comp->state = 0;
+	trace_dsscomp_release(comp);
 
 	if (debug & DEBUG_COMPOSITIONS)
 		dev_info(DEV(cdev), "[%p] released\n", comp);
@@ -437,6 +456,8 @@ static u32 dsscomp_mgr_callback(void *data, int id, int status)
 {
 	struct dsscomp *comp = data;
 
+	trace_dsscomp_callback(comp, status);
+
 	if (status == DSS_COMPLETION_PROGRAMMED ||
 	    (status == DSS_COMPLETION_DISPLAYED &&
 	     comp->state != DSSCOMP_STATE_DISPLAYED) ||
@@ -457,6 +478,34 @@ static inline bool dssdev_manually_updated(struct omap_dss_device *dev)
 	return dev->caps & OMAP_DSS_DISPLAY_CAP_MANUAL_UPDATE;
 }
 
+/*
+ * Return the update region if only part of a manually updated display is
+ * to be pushed, so that the overlays can be clipped to it.  z-order only
+ * changes keep old positions, so they always update the whole screen.
+ */
+static struct dss2_rect_t *dsscomp_partial_win(struct dsscomp *comp,
+					struct omap_dss_device *dssdev)
+{
+	struct dsscomp_setup_mgr_data *d = &comp->frm;
+	u32 oix;
+
+	if (!(d->mode & DSSCOMP_SETUP_MODE_DISPLAY) ||
+	    !(dssdev->caps & OMAP_DSS_DISPLAY_CAP_PARTIAL_UPDATE) ||
+	    !dssdev->driver->update)
+		return NULL;
+
+	if (!d->win.x && !d->win.y &&
+	    d->win.w == dssdev->panel.timings.x_res &&
+	    d->win.h == dssdev->panel.timings.y_res)
+		return NULL;
+
+	for (oix = 0; oix < d->num_ovls; oix++)
+		if (comp->ovls[oix].cfg.zonly)
+			return NULL;
+
+	return &d->win;
+}
+
 /* apply composition */
 /* at this point the composition is not on any queue */
 static int dsscomp_apply(struct dsscomp *comp)
@@ -472,6 +521,7 @@ static int dsscomp_apply(struct dsscomp *comp)
 	bool cb_programmed = false;
 	struct omap_writeback *wb = cdev->wb_ovl;
 	bool wb_apply = false;
+	struct dss2_rect_t *partial;
 
 	struct omapdss_ovl_cb cb = {
 		.fn = dsscomp_mgr_callback,
@@ -481,6 +531,7 @@ static int dsscomp_apply(struct dsscomp *comp)
 	};
 
 	BUG_ON(comp->state != DSSCOMP_STATE_APPLYING);
+	trace_dsscomp_apply(comp);
 
 	/* check if the display is valid and used */
 	r = -ENODEV;
@@ -499,6 +550,12 @@ static int dsscomp_apply(struct dsscomp *comp)
 
 	dump_comp_info(cdev, d, "apply");
 
+	if (!d->win.w && !d->win.x)
+		d->win.w = dssdev->panel.timings.x_res - d->win.x;
+	if (!d->win.h && !d->win.y)
+		d->win.h = dssdev->panel.timings.y_res - d->win.y;
+	partial = dsscomp_partial_win(comp, dssdev);
+
 	r = 0;
 	dmask = 0;
 	for (oix = 0; oix < comp->frm.num_ovls; oix++) {
@@ -546,7 +603,13 @@ static int dsscomp_apply(struct dsscomp *comp)
 					goto skip_ovl_set;
 			}
 
-			r = set_dss_ovl_info(oi);
+			r = set_dss_ovl_info(oi, partial);
+			/* not part of this partial update */
+			if (r == -ENOENT) {
+				oi->cfg.enabled = false;
+				dmask |= 1 << oi->cfg.ix;
+				r = 0;
+			}
 		}
 skip_ovl_set:
 		if (r && comp->must_apply) {
@@ -554,7 +617,7 @@ skip_ovl_set:
 					comp, oi->cfg.ix, r);
 			oi->cfg.enabled = false;
 			dmask |= 1 << oi->cfg.ix;
-			set_dss_ovl_info(oi);
+			set_dss_ovl_info(oi, NULL);
 		}
 	}
 
@@ -618,11 +681,6 @@ skip_ovl_set:
 	comp->state = DSSCOMP_STATE_APPLIED;
 	log_state(comp, dsscomp_apply, 0);
 
-	if (!d->win.w && !d->win.x)
-		d->win.w = dssdev->panel.timings.x_res - d->win.x;
-	if (!d->win.h && !d->win.y)
-		d->win.h = dssdev->panel.timings.y_res - d->win.y;
-
 	mutex_lock(&mtx);
 	if (mgrq[comp->ix].blanking) {
 		pr_info_ratelimited("ignoring apply mgr(%s) while blanking\n",
@@ -660,6 +718,7 @@ skip_ovl_set:
 		}
 	}
 	mutex_unlock(&mtx);
+	trace_dsscomp_go(comp, r);
 
 	/*
 	 * TRICKY: try to unregister callback to see if callbacks have
@@ -720,13 +779,45 @@ int dsscomp_state_notifier(struct notifier_block *nb,
 }
 
 
+/* check if a newer composition makes this one obsolete, must hold mtx */
+static bool dsscomp_superseded(struct dsscomp *comp)
+{
+	struct dsscomp *last = mgrq[comp->ix].last;
+
+	if (last == comp) {
+		mgrq[comp->ix].last = NULL;
+		return false;
+	}
+
+	/*
+	 * last is still queued behind us on the same single-threaded
+	 * apply queue, so it cannot have been released yet.
+	 */
+	return last && (mailbox_mgrs & (1 << comp->ix)) &&
+		!(comp->ovl_mask & ~last->ovl_mask);
+}
+
 static void dsscomp_do_apply(struct work_struct *work)
 {
 	struct dsscomp_apply_work *wk = container_of(work, typeof(*wk), work);
-	/* complete compositions that failed to apply */
-	if (dsscomp_apply(wk->comp))
-		dsscomp_mgr_callback(wk->comp, -1, DSS_COMPLETION_ECLIPSED_SET);
+	struct dsscomp *comp = wk->comp;
+	bool superseded;
+
 	kfree(wk);
+
+	mutex_lock(&mtx);
+	superseded = dsscomp_superseded(comp);
+	if (superseded) {
+		mgrq[comp->ix].superseded++;
+		log_state(comp, dsscomp_do_apply, DSS_COMPLETION_ECLIPSED_SET);
+		if (debug & DEBUG_PHASES)
+			dev_info(DEV(cdev), "[%p] superseded\n", comp);
+	}
+	mutex_unlock(&mtx);
+
+	/* complete compositions that are stale or failed to apply */
+	if (superseded || dsscomp_apply(comp))
+		dsscomp_mgr_callback(comp, -1, DSS_COMPLETION_ECLIPSED_SET);
 }
 
 int dsscomp_delayed_apply(struct dsscomp *comp)
@@ -740,6 +831,7 @@ int dsscomp_delayed_apply(struct dsscomp *comp)
 
 	BUG_ON(comp->state != DSSCOMP_STATE_ACTIVE);
 	comp->state = DSSCOMP_STATE_APPLYING;
+	mgrq[comp->ix].last = comp;
 	log_state(comp, dsscomp_delayed_apply, 0);
 
 	if (debug & DEBUG_PHASES)
@@ -825,7 +917,8 @@ void dsscomp_dbg_comps(struct seq_file *s)
 	mutex_lock(&dbg_mtx);
 	for (i = 0; i < cdev->num_mgrs; i++) {
 		struct omap_overlay_manager *mgr = cdev->mgrs[i];
-		seq_printf(s, "ACTIVE COMPOSITIONS on %s\n\n", mgr->name);
+		seq_printf(s, "ACTIVE COMPOSITIONS on %s (%u superseded)\n\n",
+			   mgr->name, mgrq[i].superseded);
 		list_for_each_entry(c, &dbg_comps, dbg_q) {
 			struct dss2_mgr_info *mi = &c->frm.mgr;
 			if (mi->ix < cdev->num_displays &&
@@ -28,6 +28,7 @@
 #include <linux/omapfb.h>
 #include <linux/vmalloc.h>
 #include <linux/export.h>
+#include <linux/slab.h>
 
 #include <video/omapdss.h>
 #include <plat/vrfb.h>
@@ -278,11 +279,94 @@ static int omapfb_query_mem(struct fb_info *fbi, struct omapfb_mem_info *mi)
 	return 0;
 }
 
+static void omapfb_restore_overlays(struct omapfb2_device *fbdev,
+		struct omap_overlay_manager *mgr,
+		struct omap_overlay_info *saved, bool *clipped)
+{
+	int i;
+
+	for (i = 0; i < fbdev->num_overlays; i++)
+		if (clipped[i])
+			fbdev->overlays[i]->set_overlay_info(fbdev->overlays[i],
+					&saved[i]);
+	if (mgr)
+		mgr->apply(mgr);
+}
+
+/*
+ * Clip the enabled overlays of mgr to the update window and position them
+ * relative to its origin, saving their old info to saved[].  Only unscaled
+ * and unrotated overlays of packed formats are clipped, by moving their
+ * base address.  Returns false, with no overlay changed, if an overlay
+ * cannot be clipped or lies outside the window.
+ */
+static bool omapfb_clip_overlays(struct omapfb2_device *fbdev,
+		struct omap_overlay_manager *mgr,
+		struct omap_overlay_info *saved, bool *clipped,
+		u16 x, u16 y, u16 w, u16 h)
+{
+	struct omap_overlay_info info;
+	struct fb_var_screeninfo var;
+	struct omap_overlay *ovl;
+	u16 x1, y1, x2, y2;
+	int i;
+
+	for (i = 0; i < fbdev->num_overlays; i++) {
+		ovl = fbdev->overlays[i];
+		clipped[i] = false;
+		if (ovl->manager != mgr || !ovl->is_enabled(ovl))
+			continue;
+
+		ovl->get_overlay_info(ovl, &saved[i]);
+		info = saved[i];
+
+		if (info.rotation || info.mirror ||
+		    info.rotation_type == OMAP_DSS_ROT_TILER ||
+		    (info.out_width && info.out_width != info.width) ||
+		    (info.out_height && info.out_height != info.height) ||
+		    info.color_mode == OMAP_DSS_COLOR_NV12 ||
+		    dss_mode_to_fb_mode(info.color_mode, &var))
+			goto undo;
+
+		x1 = max(x, info.pos_x);
+		y1 = max(y, info.pos_y);
+		x2 = min(x + w, info.pos_x + info.width);
+		y2 = min(y + h, info.pos_y + info.height);
+		if (x1 >= x2 || y1 >= y2)
+			goto undo;
+
+		info.paddr += ((y1 - info.pos_y) * info.screen_width +
+			       x1 - info.pos_x) * var.bits_per_pixel / 8;
+		info.pos_x = x1 - x;
+		info.pos_y = y1 - y;
+		info.width = info.out_width = x2 - x1;
+		info.height = info.out_height = y2 - y1;
+
+		if (ovl->set_overlay_info(ovl, &info))
+			goto undo;
+		clipped[i] = true;
+	}
+
+	return true;
+undo:
+	while (i < fbdev->num_overlays)
+		clipped[i++] = false;
+	omapfb_restore_overlays(fbdev, NULL, saved, clipped);
+	return false;
+}
+
 static int omapfb_update_window_nolock(struct fb_info *fbi,
 		u32 x, u32 y, u32 w, u32 h)
 {
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+	struct omapfb2_device *fbdev = ofbi->fbdev;
 	struct omap_dss_device *display = fb2display(fbi);
+	struct omap_overlay_manager *mgr;
+	struct omap_overlay_info *saved = NULL;
+	bool clipped[ARRAY_SIZE(fbdev->overlays)];
+	bool partial;
 	u16 dw, dh;
+	int r;
 
 	if (!display)
 		return 0;
@@ -295,7 +379,113 @@ static int omapfb_update_window_nolock(struct fb_info *fbi,
 	if (x + w > dw || y + h > dh)
 		return -EINVAL;
 
-	return display->driver->update(display, x, y, w, h);
+	mgr = display->manager;
+	partial = (display->caps & OMAP_DSS_DISPLAY_CAP_PARTIAL_UPDATE) &&
+		mgr && (x || y || w != dw || h != dh);
+
+	if (partial) {
+		/* YUV macropixels, and the DSI minimum width of 2 */
+		if (x & 1) {
+			x--;
+			w++;
+		}
+		if (w & 1)
+			w = min_t(u32, w + 1, dw - x);
+
+		saved = kcalloc(fbdev->num_overlays, sizeof(*saved),
+				GFP_KERNEL);
+		partial = saved && omapfb_clip_overlays(fbdev, mgr, saved,
+				clipped, x, y, w, h);
+	}
+
+	if (partial && mgr->apply(mgr)) {
+		omapfb_restore_overlays(fbdev, mgr, saved, clipped);
+		partial = false;
+	}
+
+	if (!partial) {
+		x = y = 0;
+		w = dw;
+		h = dh;
+	}
+
+	r = display->driver->update(display, x, y, w, h);
+
+	/* the update has latched the clipped info, restore it for the next */
+	if (partial)
+		omapfb_restore_overlays(fbdev, mgr, saved, clipped);
+	kfree(saved);
+
+	return r;
+}
+
+/*
+ * Push the bounding box of the damaged rectangles to the display, after
+ * writing it back from the CPU caches for cached mappings.  The damage is
+ * in framebuffer coordinates and is moved to the window of the first
+ * overlay; scaled or rotated overlays have their whole window updated.
+ */
+static int omapfb_damage(struct fb_info *fbi, struct omapfb_damage *dmg)
+{
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+	struct fb_var_screeninfo *var = &fbi->var;
+	struct omap_overlay_info info;
+	struct omap_overlay *ovl;
+	u32 x1 = ~0, y1 = ~0, x2 = 0, y2 = 0;
+	u32 ow, oh;
+	int i;
+
+	if (dmg->num_rects == 0 || dmg->num_rects > OMAPFB_MAX_DAMAGE_RECTS)
+		return -EINVAL;
+
+	for (i = 0; i < dmg->num_rects; i++) {
+		struct omapfb_rect *rect = &dmg->rects[i];
+
+		if (!rect->width || !rect->height ||
+		    rect->x >= var->xres_virtual ||
+		    rect->width > var->xres_virtual - rect->x ||
+		    rect->y >= var->yres_virtual ||
+		    rect->height > var->yres_virtual - rect->y)
+			return -EINVAL;
+
+		x1 = min(x1, rect->x);
+		y1 = min(y1, rect->y);
+		x2 = max(x2, rect->x + rect->width);
+		y2 = max(y2, rect->y + rect->height);
+	}
+
+	if (ofbi->mmap_cached)
+		omapfb_flush_mmap(fbi, y1 * fbi->fix.line_length,
+				(y2 - y1) * fbi->fix.line_length);
+
+	if (ofbi->num_overlays == 0)
+		return 0;
+
+	ovl = ofbi->overlays[0];
+	if (!ovl->is_enabled(ovl) || !ovl->manager ||
+	    ovl->manager->device != fb2display(fbi))
+		return 0;
+
+	ovl->get_overlay_info(ovl, &info);
+	ow = info.out_width ? info.out_width : info.width;
+	oh = info.out_height ? info.out_height : info.height;
+
+	if (info.rotation || info.mirror || ow != info.width ||
+	    oh != info.height)
+		return omapfb_update_window_nolock(fbi, info.pos_x, info.pos_y,
+				ow, oh);
+
+	/* clip to the visible part of the framebuffer */
+	x1 = max(x1, var->xoffset);
+	y1 = max(y1, var->yoffset);
+	x2 = min(x2, var->xoffset + info.width);
+	y2 = min(y2, var->yoffset + info.height);
+	if (x1 >= x2 || y1 >= y2)
+		return 0;
+
+	return omapfb_update_window_nolock(fbi,
+			info.pos_x + x1 - var->xoffset,
+			info.pos_y + y1 - var->yoffset, x2 - x1, y2 - y1);
 }
 
 /* This function is exported for SGX driver use */
@@ -604,6 +794,7 @@ int omapfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 	union {
 		struct omapfb_update_window_old	uwnd_o;
 		struct omapfb_update_window	uwnd;
+		struct omapfb_damage		damage;
 		struct omapfb_plane_info	plane_info;
 		struct omapfb_caps		caps;
 		struct omapfb_mem_info          mem_info;
@@ -667,6 +858,22 @@ int omapfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg)
 				p.uwnd.width, p.uwnd.height);
 		break;
 
+	case OMAPFB_DAMAGE:
+		DBG("ioctl DAMAGE\n");
+		if (!display || !display->driver->update) {
+			r = -EINVAL;
+			break;
+		}
+
+		if (copy_from_user(&p.damage, (void __user *)arg,
+					sizeof(p.damage))) {
+			r = -EFAULT;
+			break;
+		}
+
+		r = omapfb_damage(fbi, &p.damage);
+		break;
+
 	case OMAPFB_SETUP_PLANE:
 		DBG("ioctl SETUP_PLANE\n");
 		if (copy_from_user(&p.plane_info, (void __user *)arg,
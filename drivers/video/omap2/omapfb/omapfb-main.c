@@ -35,6 +35,8 @@
 #include <plat/vram.h>
 #include <plat/vrfb.h>
 
+#include <asm/cacheflush.h>
+
 #include "omapfb.h"
 
 #define MODULE_NAME     "omapfb"
@@ -1250,7 +1252,8 @@ static int omapfb_mmap(struct fb_info *fbi, struct vm_area_struct *vma)
 
 	vma->vm_pgoff = off >> PAGE_SHIFT;
 	vma->vm_flags |= VM_IO | VM_RESERVED;
-	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	if (!ofbi->mmap_cached)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
 	vma->vm_ops = &mmap_user_ops;
 	vma->vm_private_data = rg;
 	if (io_remap_pfn_range(vma, vma->vm_start, off >> PAGE_SHIFT,
@@ -1273,6 +1276,45 @@ static int omapfb_mmap(struct fb_info *fbi, struct vm_area_struct *vma)
 	return r;
 }
 
+/*
+ * Write back the CPU caches over bytes [offset, offset + len) of the
+ * framebuffer, for the cached mappings of the calling process.  Mappings
+ * made by other processes are not flushed.
+ */
+void omapfb_flush_mmap(struct fb_info *fbi, unsigned long offset,
+		unsigned long len)
+{
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	unsigned long paddr;
+
+	if (!mm || !len)
+		return;
+
+	paddr = omapfb_get_region_paddr(ofbi) + offset;
+
+	down_read(&mm->mmap_sem);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		unsigned long pstart, start, end;
+
+		if (vma->vm_ops != &mmap_user_ops ||
+		    vma->vm_private_data != ofbi->region)
+			continue;
+
+		pstart = vma->vm_pgoff << PAGE_SHIFT;
+		start = max(paddr, pstart);
+		end = min(paddr + len, pstart + vma->vm_end - vma->vm_start);
+		if (start >= end)
+			continue;
+
+		dmac_flush_range((void *)(vma->vm_start + start - pstart),
+				 (void *)(vma->vm_start + end - pstart));
+		outer_flush_range(start, end);
+	}
+	up_read(&mm->mmap_sem);
+}
+
 /* Store a single color palette entry into a pseudo palette or the hardware
  * palette if one is available. For now we support only 16bpp and thus store
  * the entry only to the pseudo palette.
@@ -500,6 +500,59 @@ out:
 	return r;
 }
 
+static ssize_t show_mmap_cached(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", ofbi->mmap_cached);
+}
+
+/*
+ * Map the framebuffer cached instead of write-combined to user space.
+ * Writers then have to pass what they changed to OMAPFB_DAMAGE, which
+ * writes it back from the caches before updating the display.
+ */
+static ssize_t store_mmap_cached(struct device *dev,
+		struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct omapfb_info *ofbi = FB2OFB(fbi);
+	struct omapfb2_mem_region *rg;
+	bool cached;
+	int r;
+
+	r = strtobool(buf, &cached);
+	if (r)
+		return r;
+
+	if (!lock_fb_info(fbi))
+		return -ENODEV;
+
+	rg = ofbi->region;
+
+	down_write_nested(&rg->lock, rg->id);
+	atomic_inc(&rg->lock_count);
+
+	/* existing mappings keep their attributes */
+	if (cached != ofbi->mmap_cached && atomic_read(&rg->map_count)) {
+		r = -EBUSY;
+		goto out;
+	}
+
+	ofbi->mmap_cached = cached;
+	r = count;
+out:
+	atomic_dec(&rg->lock_count);
+	up_write(&rg->lock);
+
+	unlock_fb_info(fbi);
+
+	return r;
+}
+
 static ssize_t show_phys(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -562,6 +615,8 @@ static struct device_attribute omapfb_attrs[] = {
 	__ATTR(phys_addr, S_IRUGO, show_phys, NULL),
 	__ATTR(virt_addr, S_IRUGO, show_virt, NULL),
 	__ATTR(update_mode, S_IRUGO | S_IWUSR, show_upd_mode, store_upd_mode),
+	__ATTR(mmap_cached, S_IRUGO | S_IWUSR, show_mmap_cached,
+			store_mmap_cached),
 };
 
 int omapfb_create_sysfs(struct omapfb2_device *fbdev)
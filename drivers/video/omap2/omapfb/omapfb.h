@@ -71,6 +71,7 @@ struct omapfb_info {
 	enum omap_dss_rotation_type rotation_type;
 	u8 rotation[OMAPFB_MAX_OVL_PER_FB];
 	bool mirror;
+	bool mmap_cached;	/* user mappings cached, flushed on damage */
 };
 
 struct omapfb_display_data {
@@ -135,6 +136,8 @@ int omapfb_ioctl(struct fb_info *fbi, unsigned int cmd, unsigned long arg);
 
 int omapfb_update_window(struct fb_info *fbi,
 		u32 x, u32 y, u32 w, u32 h);
+void omapfb_flush_mmap(struct fb_info *fbi, unsigned long offset,
+		unsigned long len);
 
 int dss_mode_to_fb_mode(enum omap_color_mode dssmode,
 			struct fb_var_screeninfo *var);
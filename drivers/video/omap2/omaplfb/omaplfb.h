@@ -38,6 +38,8 @@
 #include <linux/string.h>
 #include <linux/notifier.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
 #include <plat/sgx_omaplfb.h>
 
 #ifdef CONFIG_ION_OMAP
@@ -149,6 +151,10 @@ typedef struct OMAPLFB_FBINFO_TAG
 	IMG_UINT            uiBltFBsByteStride;
 	/* Buffer used to clear the screen */
 	void                *pvClearBuffer;
+	/* Flips queued to dsscomp once their asynchronous blits complete */
+	struct workqueue_struct *psBltWorkQueue;
+	/* The number of such flips not yet queued to dsscomp */
+	OMAPLFB_ATOMIC_INT  sBltFlipsPending;
 #endif
 	IMG_UINT32          uiBytesPerPixel;
 }OMAPLFB_FBINFO;
@@ -302,6 +308,7 @@ void OMAPLFBAtomicIntDeInit(OMAPLFB_ATOMIC_INT *psAtomic);
 void OMAPLFBAtomicIntSet(OMAPLFB_ATOMIC_INT *psAtomic, int iVal);
 int OMAPLFBAtomicIntRead(OMAPLFB_ATOMIC_INT *psAtomic);
 void OMAPLFBAtomicIntInc(OMAPLFB_ATOMIC_INT *psAtomic);
+void OMAPLFBAtomicIntDec(OMAPLFB_ATOMIC_INT *psAtomic);
 IMG_UINT32 GetVramStart(OMAPLFB_DEVINFO *psDevInfo);
 unsigned long GetVramFBSize(OMAPLFB_DEVINFO *psDevInfo);
 unsigned long GetVramFBTotalSize(struct fb_info *psLINFBInfo);
@@ -311,13 +318,24 @@ struct sgx_omaplfb_config *GetFBPlatConfig(int fbidx);
 int meminfo_idx_valid(unsigned int meminfo_ix, int num_meminfos);
 #endif
 
+/*
+ * Tracks the blits of one flip submitted to GC320 asynchronously, sDone is
+ * completed once the last one has finished
+ */
+typedef struct OMAPLFB_BLT_SYNC_TAG
+{
+	atomic_t		iPending;
+	struct completion	sDone;
+} OMAPLFB_BLT_SYNC;
+
 /* Blt stubs implemented when CONFIG_GCBV is enabled */
 IMG_BOOL OMAPLFBInitBlt(void);
 OMAPLFB_ERROR OMAPLFBInitBltFBs(OMAPLFB_DEVINFO *psDevInfo);
 void OMAPLFBDeInitBltFBs(OMAPLFB_DEVINFO *psDevInfo);
 void OMAPLFBGetBltFBsBvHndl(OMAPLFB_FBINFO *psPVRFBInfo, IMG_UINTPTR_T *ppPhysAddr);
 void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos,
-		    struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos);
+		    struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos,
+		    OMAPLFB_BLT_SYNC *psSync);
 
 #if defined(DEBUG)
 void OMAPLFBPrintInfo(OMAPLFB_DEVINFO *psDevInfo);
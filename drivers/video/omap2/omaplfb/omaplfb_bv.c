@@ -151,6 +151,20 @@ static OMAPLFB_ERROR InitBltFBsCommon(OMAPLFB_DEVINFO *psDevInfo)
 		return OMAPLFB_ERROR_INIT_FAILURE;
 	}
 
+	/*
+	 * Ordered, so flips waiting on GC320 reach dsscomp in the order they
+	 * were issued. Without it the blits are done synchronously.
+	 */
+	OMAPLFBAtomicIntInit(&psPVRFBInfo->sBltFlipsPending, 0);
+	psPVRFBInfo->psBltWorkQueue = alloc_ordered_workqueue(DEVNAME "_bv",
+							       WQ_MEM_RECLAIM);
+	if (!psPVRFBInfo->psBltWorkQueue)
+	{
+		printk(KERN_WARNING DRIVER_PREFIX
+			": %s: Could not create blit workqueue, "
+			"blits will be synchronous\n", __func__);
+	}
+
 	/* Freeing of resources is handled in deinit code */
 	return OMAPLFB_OK;
 }
@@ -394,7 +408,30 @@ static void OMAPLFBSetNV12Params(struct bvsurfgeom *geom, struct bvbuffdesc *des
 	geom->virtstride = (desc->length * 2) / (geom->height * 3);
 }
 
-void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos)
+static void OMAPLFBBltSyncPut(OMAPLFB_BLT_SYNC *psSync)
+{
+	if (atomic_dec_and_test(&psSync->iPending))
+	{
+		complete(&psSync->sDone);
+	}
+}
+
+static void OMAPLFBBltCallback(struct bvcallbackerror *err,
+			       unsigned long callbackdata)
+{
+	if (err)
+	{
+		printk(KERN_ERR "%s: async blit failed %d (%s)\n",
+			__func__, err->error, err->errdesc ? : "");
+	}
+	OMAPLFBBltSyncPut((OMAPLFB_BLT_SYNC *)callbackdata);
+}
+
+/*
+ * With psSync the blits are only queued to GC320 and psSync->sDone is
+ * completed once they have all finished, otherwise they are done on return
+ */
+void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos, OMAPLFB_BLT_SYNC *psSync)
 {
 	struct rgz_blt_entry *entry_list;
 	struct bventry *bv_entry = &gsBvInterface;
@@ -403,6 +440,14 @@ void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struc
 	int j;
 	void* lastBatch = NULL;
 	unsigned int batchFlags;
+	IMG_BOOL bAsync;
+
+	if (psSync)
+	{
+		/* Held until all the blits are submitted */
+		atomic_set(&psSync->iPending, 1);
+		init_completion(&psSync->sDone);
+	}
 
 	/* DSS pipes are setup up to this point, we can begin blitting here */
 	entry_list = (struct rgz_blt_entry *) (blit_data->rgz_blts);
@@ -515,16 +560,40 @@ void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struc
 			entry->bp.batch = NULL;
 		}
 
+		/*
+		 * Only a blit that executes gets a completion callback, the
+		 * ones that begin or continue a batch run with its end
+		 */
+		bAsync = psSync && (batchFlags == 0 ||
+				    batchFlags == BVFLAG_BATCH_END);
+		if (bAsync)
+		{
+			entry->bp.flags |= BVFLAG_ASYNC;
+			entry->bp.callbackfn = OMAPLFBBltCallback;
+			entry->bp.callbackdata = (unsigned long)psSync;
+			atomic_inc(&psSync->iPending);
+		}
+
 		bv_error = bv_entry->bv_blt(&entry->bp);
 		if (bv_error)
+		{
 			printk(KERN_ERR "%s: blit failed %d\n",
 					__func__, bv_error);
+			/* No callback for a blit that was not queued */
+			if (bAsync)
+				OMAPLFBBltSyncPut(psSync);
+		}
 
 		if (batchFlags == BVFLAG_BATCH_BEGIN) {
 			/* cache the batch handle */
 			lastBatch = entry->bp.batch;
 		}
 	}
+
+	if (psSync)
+	{
+		OMAPLFBBltSyncPut(psSync);
+	}
 }
 
 OMAPLFB_ERROR OMAPLFBInitBltFBs(OMAPLFB_DEVINFO *psDevInfo)
@@ -543,6 +612,13 @@ void OMAPLFBDeInitBltFBs(OMAPLFB_DEVINFO *psDevInfo)
 		return;
 	}
 
+	/* Let the flips still waiting on GC320 reach dsscomp first */
+	if (psPVRFBInfo->psBltWorkQueue)
+	{
+		destroy_workqueue(psPVRFBInfo->psBltWorkQueue);
+		psPVRFBInfo->psBltWorkQueue = NULL;
+	}
+
 	if (psPVRFBInfo->pvClearBuffer) {
 		kfree(psPVRFBInfo->pvClearBuffer);
 		psPVRFBInfo->pvClearBuffer = NULL;
@@ -764,7 +764,7 @@ void OMAPLFBGetBltFBsBvHndl(OMAPLFB_FBINFO *psPVRFBInfo, IMG_UINTPTR_T *ppPhysAd
 	*ppPhysAddr = 0;
 }
 
-void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos)
+void OMAPLFBDoBlits(OMAPLFB_DEVINFO *psDevInfo, PDC_MEM_INFO *ppsMemInfos, struct omap_hwc_blit_data *blit_data, IMG_UINT32 ui32NumMemInfos, OMAPLFB_BLT_SYNC *psSync)
 {
 }
 #endif /* CONFIG_GCBV */
@@ -911,6 +911,49 @@ int meminfo_idx_valid(unsigned int meminfo_ix, int num_meminfos)
 	return 1;
 }
 
+/*
+ * A flip whose blits were queued to GC320 without waiting for them. It is
+ * handed to dsscomp from the blit workqueue once they complete, so SGX can
+ * go on with the next frame meanwhile. Any flip issued while one of these
+ * is pending goes the same way to keep the flips in order.
+ */
+typedef struct OMAPLFB_BLT_FLIP_TAG
+{
+	struct work_struct		sWork;
+	IMG_HANDLE			hCmdCookie;
+	OMAPLFB_DEVINFO			*psDevInfo;
+	struct dsscomp_setup_dispc_data	*psDssData;
+	struct tiler_pa_info		*apsTilerPAs[5];
+	/* Tiler mappings to release once queued */
+	struct tiler_pa_info		*apsTilerInfos[5];
+	OMAPLFB_BLT_SYNC		sSync;
+} OMAPLFB_BLT_FLIP;
+
+static void OMAPLFBBltFlipWork(struct work_struct *psWork)
+{
+	OMAPLFB_BLT_FLIP *psFlip = container_of(psWork, OMAPLFB_BLT_FLIP, sWork);
+	OMAPLFB_FBINFO *psPVRFBInfo = &psFlip->psDevInfo->sFBInfo;
+	IMG_UINT32 i;
+
+	/* The blit FB must be complete before DSS scans it out */
+	wait_for_completion(&psFlip->sSync.sDone);
+
+	if (psFlip->psDssData->num_ovls == 0)
+		dsscomp_proxy_cmdcomplete((void *)psFlip->hCmdCookie, IMG_TRUE);
+	else
+		dsscomp_gralloc_queue(psFlip->psDssData, psFlip->apsTilerPAs,
+				      false, dsscomp_proxy_cmdcomplete,
+				      (void *)psFlip->hCmdCookie);
+
+	for (i = 0; i < ARRAY_SIZE(psFlip->apsTilerInfos); i++)
+	{
+		tiler_pa_free(psFlip->apsTilerInfos[i]);
+	}
+
+	OMAPLFBAtomicIntDec(&psPVRFBInfo->sBltFlipsPending);
+	kfree(psFlip);
+}
+
 static IMG_BOOL ProcessFlipV2(IMG_HANDLE hCmdCookie,
                               OMAPLFB_DEVINFO *psDevInfo,
                               PDC_MEM_INFO *ppsMemInfos,
@@ -934,6 +977,7 @@ static IMG_BOOL ProcessFlipV2(IMG_HANDLE hCmdCookie,
 	struct dsscomp_setup_dispc_data *psDssData = &(psHwcData->dsscomp_data);
 	int iMemIdx = 0;
 	int iUseBltFB;
+	OMAPLFB_FBINFO *psPVRFBInfo;
 #ifdef CONFIG_DRM_OMAP_DMM_TILER
 	enum tiler_fmt fmt;
 #endif
@@ -1098,9 +1142,49 @@ static IMG_BOOL ProcessFlipV2(IMG_HANDLE hCmdCookie,
 		apsTilerPAs[i] = asMemInfo[ix].psTilerInfo;
 	}
 
+	psPVRFBInfo = &psDevInfo->sFBInfo;
+	if (psPVRFBInfo->psBltWorkQueue &&
+	    (rgz_items > 0 || OMAPLFBAtomicIntRead(&psPVRFBInfo->sBltFlipsPending)))
+	{
+		OMAPLFB_BLT_FLIP *psFlip = kzalloc(sizeof(*psFlip), GFP_KERNEL);
+
+		if (psFlip)
+		{
+			INIT_WORK(&psFlip->sWork, OMAPLFBBltFlipWork);
+			psFlip->hCmdCookie = hCmdCookie;
+			psFlip->psDevInfo = psDevInfo;
+			psFlip->psDssData = psDssData;
+			memcpy(psFlip->apsTilerPAs, apsTilerPAs, sizeof(apsTilerPAs));
+			for (i = 0; i < ARRAY_SIZE(asMemInfo); i++)
+			{
+				psFlip->apsTilerInfos[i] = asMemInfo[i].psTilerInfo;
+			}
+
+			if (rgz_items > 0)
+			{
+				OMAPLFBDoBlits(psDevInfo, ppsMemInfos, &psHwcData->blit_data,
+					       ui32NumMemInfos, &psFlip->sSync);
+			}
+			else
+			{
+				atomic_set(&psFlip->sSync.iPending, 0);
+				init_completion(&psFlip->sSync.sDone);
+				complete(&psFlip->sSync.sDone);
+			}
+
+			OMAPLFBAtomicIntInc(&psPVRFBInfo->sBltFlipsPending);
+			queue_work(psPVRFBInfo->psBltWorkQueue, &psFlip->sWork);
+			return IMG_TRUE;
+		}
+
+		/* Out of memory, wait for the pending flips and blit in line */
+		flush_workqueue(psPVRFBInfo->psBltWorkQueue);
+	}
+
 	if (rgz_items > 0)
 	{
-		OMAPLFBDoBlits(psDevInfo, ppsMemInfos, &psHwcData->blit_data, ui32NumMemInfos);
+		OMAPLFBDoBlits(psDevInfo, ppsMemInfos, &psHwcData->blit_data,
+			       ui32NumMemInfos, NULL);
 	}
 
 	if (psDssData->num_ovls == 0)
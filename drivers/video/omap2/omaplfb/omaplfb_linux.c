@@ -199,6 +199,11 @@ void OMAPLFBAtomicIntInc(OMAPLFB_ATOMIC_INT *psAtomic)
 	atomic_inc(psAtomic);
 }
 
+void OMAPLFBAtomicIntDec(OMAPLFB_ATOMIC_INT *psAtomic)
+{
+	atomic_dec(psAtomic);
+}
+
 #if !defined(CONFIG_OMAPLFB)
 OMAPLFB_ERROR OMAPLFBGetLibFuncAddr (char *szFunctionName, PFN_DC_GET_PVRJTABLE *ppfnFuncTable)
 {
@@ -1126,6 +1126,21 @@ struct ext4_super_block {
 #define EXT4_MF_MNTDIR_SAMPLED	0x0001
 #define EXT4_MF_FS_ABORTED	0x0002	/* Fatal error detected */
 
+/*
+ * fsync() latency of one process, as a log2 histogram in microseconds
+ */
+#define EXT4_FSYNC_HIST_TASKS	16
+#define EXT4_FSYNC_HIST_BUCKETS	20
+
+struct ext4_fsync_hist {
+	pid_t tgid;
+	char comm[TASK_COMM_LEN];
+	unsigned long count;
+	u64 total_us;
+	u32 max_us;
+	unsigned long buckets[EXT4_FSYNC_HIST_BUCKETS];
+};
+
 /*
  * fourth extended-fs super-block data in memory
  */
@@ -1265,6 +1280,11 @@ struct ext4_sb_info {
 
 	/* record the last minlen when FITRIM is called. */
 	atomic_t s_last_trim_minblks;
+
+	/* Longest an fsync commit may wait for other fsyncers, 0 = never */
+	unsigned int s_fsync_batch_us;
+	spinlock_t s_fsync_hist_lock;
+	struct ext4_fsync_hist s_fsync_hist[EXT4_FSYNC_HIST_TASKS];
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -1840,6 +1860,7 @@ extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 
 /* fsync.c */
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
+extern const struct file_operations ext4_fsync_hist_fops;
 extern int ext4_flush_completed_IO(struct inode *);
 
 /* hash.c */
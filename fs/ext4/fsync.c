@@ -22,12 +22,16 @@
  * we can depend on generic_block_fdatasync() to sync the data blocks.
  */
 
+#include <linux/module.h>
 #include <linux/time.h>
 #include <linux/fs.h>
 #include <linux/sched.h>
 #include <linux/writeback.h>
 #include <linux/jbd2.h>
 #include <linux/blkdev.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
+#include <linux/proc_fs.h>
 
 #include "ext4.h"
 #include "ext4_jbd2.h"
@@ -191,6 +195,79 @@ static int __sync_inode(struct inode *inode, int datasync)
 	return ret;
 }
 
+/*
+ * Account one fsync() to the calling process. The table keeps the
+ * busiest EXT4_FSYNC_HIST_TASKS processes; a newcomer replaces the entry
+ * with the fewest fsyncs.
+ */
+static void ext4_fsync_account(struct ext4_sb_info *sbi, ktime_t start)
+{
+	struct ext4_fsync_hist *h, *victim = NULL;
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), start));
+	int b = min_t(int, ilog2(us + 1), EXT4_FSYNC_HIST_BUCKETS - 1);
+	pid_t tgid = current->tgid;
+
+	spin_lock(&sbi->s_fsync_hist_lock);
+	for (h = sbi->s_fsync_hist;
+	     h < sbi->s_fsync_hist + EXT4_FSYNC_HIST_TASKS; h++) {
+		if (h->tgid == tgid)
+			break;
+		if (!victim || h->count < victim->count)
+			victim = h;
+	}
+	if (h == sbi->s_fsync_hist + EXT4_FSYNC_HIST_TASKS) {
+		h = victim;
+		memset(h, 0, sizeof(*h));
+		h->tgid = tgid;
+		get_task_comm(h->comm, current->group_leader);
+	}
+	h->count++;
+	h->total_us += us;
+	if (us > h->max_us)
+		h->max_us = us;
+	h->buckets[b]++;
+	spin_unlock(&sbi->s_fsync_hist_lock);
+}
+
+static int ext4_fsync_hist_show(struct seq_file *seq, void *v)
+{
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_fsync_hist *h, copy;
+	int i, b;
+
+	seq_puts(seq, "# tgid comm count avg_us max_us, then bucket N"
+		 " counting fsyncs under 2^(N+1) us (the last is open ended)\n");
+	for (i = 0; i < EXT4_FSYNC_HIST_TASKS; i++) {
+		h = &sbi->s_fsync_hist[i];
+		spin_lock(&sbi->s_fsync_hist_lock);
+		copy = *h;
+		spin_unlock(&sbi->s_fsync_hist_lock);
+		if (!copy.count)
+			continue;
+		seq_printf(seq, "%d %s %lu %llu %u", copy.tgid, copy.comm,
+			   copy.count, div_u64(copy.total_us, copy.count),
+			   copy.max_us);
+		for (b = 0; b < EXT4_FSYNC_HIST_BUCKETS; b++)
+			seq_printf(seq, " %lu", copy.buckets[b]);
+		seq_putc(seq, '\n');
+	}
+	return 0;
+}
+
+static int ext4_fsync_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_fsync_hist_show, PDE(inode)->data);
+}
+
+const struct file_operations ext4_fsync_hist_fops = {
+	.owner = THIS_MODULE,
+	.open = ext4_fsync_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 /*
  * akpm: A new design for ext4_sync_file().
  *
@@ -209,10 +286,12 @@ int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 {
 	struct inode *inode = file->f_mapping->host;
 	struct ext4_inode_info *ei = EXT4_I(inode);
-	journal_t *journal = EXT4_SB(inode->i_sb)->s_journal;
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	journal_t *journal = sbi->s_journal;
 	int ret;
 	tid_t commit_tid;
 	bool needs_barrier = false;
+	ktime_t fsync_start = ktime_get();
 
 	J_ASSERT(ext4_journal_current_handle() == NULL);
 
@@ -260,12 +339,14 @@ int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 	if (journal->j_flags & JBD2_BARRIER &&
 	    !jbd2_trans_will_send_data_barrier(journal, commit_tid))
 		needs_barrier = true;
-	jbd2_log_start_commit(journal, commit_tid);
+	jbd2_log_start_commit_batched(journal, commit_tid,
+				      sbi->s_fsync_batch_us);
 	ret = jbd2_log_wait_commit(journal, commit_tid);
 	if (needs_barrier)
 		blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL);
  out:
 	mutex_unlock(&inode->i_mutex);
+	ext4_fsync_account(sbi, fsync_start);
 	trace_ext4_sync_file_exit(inode, ret);
 	return ret;
 }
@@ -44,6 +44,7 @@
 #include <linux/backing-dev.h>
 #include <linux/bitops.h>
 #include <linux/ratelimit.h>
+#include <linux/hrtimer.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/jbd2.h>
@@ -81,6 +82,7 @@ EXPORT_SYMBOL(jbd2_journal_ack_err);
 EXPORT_SYMBOL(jbd2_journal_clear_err);
 EXPORT_SYMBOL(jbd2_log_wait_commit);
 EXPORT_SYMBOL(jbd2_log_start_commit);
+EXPORT_SYMBOL(jbd2_log_start_commit_batched);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
 EXPORT_SYMBOL(jbd2_journal_wipe);
@@ -517,6 +519,59 @@ int jbd2_log_start_commit(journal_t *journal, tid_t tid)
 	return ret;
 }
 
+/**
+ * int jbd2_log_start_commit_batched() - start a commit on behalf of fsync()
+ * @journal: journal to commit
+ * @tid: transaction the caller needs on disk
+ * @max_delay_us: upper bound on how long the commit may be held back
+ *
+ * When different tasks are fsyncing close together, hold the commit of
+ * the running transaction back for up to the average commit time, so
+ * that the other fsyncers can join it rather than each paying for its
+ * own commit. The delay never exceeds @max_delay_us. As with sync
+ * handles in jbd2_journal_stop(), a single task issuing a stream of
+ * fsyncs is never delayed. The commit is always started, so durability
+ * is unchanged; only its start time moves.
+ */
+int jbd2_log_start_commit_batched(journal_t *journal, tid_t tid,
+				  unsigned int max_delay_us)
+{
+	pid_t pid = current->pid;
+	u64 now, window, commit_time, trans_time = 0;
+	int concurrent;
+
+	if (!max_delay_us)
+		return jbd2_log_start_commit(journal, tid);
+
+	now = ktime_to_ns(ktime_get());
+	window = 1000ULL * max_delay_us;
+
+	read_lock(&journal->j_state_lock);
+	commit_time = min_t(u64, journal->j_average_commit_time, window);
+	concurrent = journal->j_last_fsync_pid != pid &&
+		now - journal->j_last_fsync_time < commit_time + window &&
+		journal->j_running_transaction &&
+		journal->j_running_transaction->t_tid == tid &&
+		!tid_geq(journal->j_commit_request, tid);
+	if (concurrent)
+		trans_time = now - ktime_to_ns(
+			journal->j_running_transaction->t_start_time);
+	read_unlock(&journal->j_state_lock);
+
+	journal->j_last_fsync_pid = pid;
+	journal->j_last_fsync_time = now;
+
+	if (concurrent && trans_time < commit_time) {
+		ktime_t expires = ns_to_ktime(now + commit_time - trans_time);
+
+		journal->j_fsync_batched++;
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+	}
+
+	return jbd2_log_start_commit(journal, tid);
+}
+
 /*
  * Force and wait upon a commit if the calling process is not within
  * transaction.  This is used for forcing out undo-protected data which contains
@@ -875,6 +930,8 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    jiffies_to_msecs(s->stats->run.rs_logging / s->stats->ts_tid));
 	seq_printf(seq, "  %lluus average transaction commit time\n",
 		   div_u64(s->journal->j_average_commit_time, 1000));
+	seq_printf(seq, "  %lu fsync commits held back for batching\n",
+		   s->journal->j_fsync_batched);
 	seq_printf(seq, "  %lu handles per transaction\n",
 	    s->stats->run.rs_handle_count / s->stats->ts_tid);
 	seq_printf(seq, "  %lu blocks per transaction\n",
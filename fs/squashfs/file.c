@@ -46,6 +46,7 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/pagemap.h>
+#include <linux/highmem.h>
 #include <linux/mutex.h>
 
 #include "squashfs_fs.h"
@@ -371,6 +372,100 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/* every page of a block stays kmapped while it decompresses */
+#define SQUASHFS_DIRECT_MAX_PAGES	64
+
+/*
+ * Decompress a datablock straight into the page cache pages it covers,
+ * rather than into the read_page cache and copying from there.  Pages
+ * that could not be grabbed, or are already up to date, get their share
+ * of the block decompressed into a scratch page instead.  @bytes is the
+ * decompressed size of the block.  Unless an error is returned, all the
+ * pages are unlocked, @target included.  -ENOMEM tells the caller to use
+ * the read_page cache instead.
+ */
+static int squashfs_readpage_block(struct page *target, u64 block, int bsize,
+	int bytes)
+{
+	struct inode *inode = target->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target->index & ~mask;
+	int i, avail, res = -ENOMEM, pages = (bytes + PAGE_CACHE_SIZE - 1) >>
+		PAGE_CACHE_SHIFT;
+	struct page **page;
+	void **pageaddr, *scratch = NULL;
+
+	page = kcalloc(pages, sizeof(*page), GFP_KERNEL);
+	pageaddr = kcalloc(pages, sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	for (i = 0; i < pages; i++) {
+		if (start_index + i == target->index) {
+			page[i] = target;
+			continue;
+		}
+
+		page[i] = grab_cache_page_nowait(target->mapping,
+			start_index + i);
+		if (page[i] && PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+		}
+
+		if (page[i] == NULL && scratch == NULL) {
+			scratch = kmalloc(PAGE_CACHE_SIZE, GFP_KERNEL);
+			if (scratch == NULL)
+				goto release;
+		}
+	}
+
+	for (i = 0; i < pages; i++)
+		pageaddr[i] = page[i] ? kmap(page[i]) : scratch;
+
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		msblk->block_size, pages);
+	if (res < 0) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		res = -EIO;
+	}
+
+	for (i = 0; i < pages; i++) {
+		if (page[i] == NULL)
+			continue;
+
+		if (res >= 0) {
+			avail = clamp_t(int, res - i * PAGE_CACHE_SIZE, 0,
+				PAGE_CACHE_SIZE);
+			memset(pageaddr[i] + avail, 0, PAGE_CACHE_SIZE - avail);
+		}
+		kunmap(page[i]);
+		if (res >= 0) {
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		}
+	}
+
+release:
+	for (i = 0; i < pages; i++) {
+		if (page[i] == NULL || (page[i] == target && res < 0))
+			continue;
+		unlock_page(page[i]);
+		if (page[i] != target)
+			page_cache_release(page[i]);
+	}
+
+out:
+	kfree(scratch);
+	kfree(pageaddr);
+	kfree(page);
+	return res < 0 ? res : 0;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -403,15 +498,25 @@ static int squashfs_readpage(struct file *file, struct page *page)
 		if (bsize < 0)
 			goto error_out;
 
+		bytes = index == file_end ?
+			(i_size_read(inode) & (msblk->block_size - 1)) :
+			 msblk->block_size;
+
 		if (bsize == 0) { /* hole */
-			bytes = index == file_end ?
-				(i_size_read(inode) & (msblk->block_size - 1)) :
-				 msblk->block_size;
 			sparse = 1;
 		} else {
 			/*
 			 * Read and decompress datablock.
 			 */
+			if (bytes <= SQUASHFS_DIRECT_MAX_PAGES * PAGE_CACHE_SIZE) {
+				int res = squashfs_readpage_block(page, block,
+					bsize, bytes);
+				if (res == 0)
+					return 0;
+				if (res != -ENOMEM)
+					goto error_out;
+			}
+
 			buffer = squashfs_get_datablock(inode->i_sb,
 								block, bsize);
 			if (buffer->error) {
@@ -2891,6 +2891,7 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 	int min_erased;
 	int erased_chunks;
 	int checkpt_block_adjust;
+	int topup;
 
 	if (dev->param.gc_control && (dev->param.gc_control(dev) & 1) == 0)
 		return YAFFS_OK;
@@ -2914,6 +2915,10 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 		erased_chunks =
 		    dev->n_erased_blocks * dev->param.chunks_per_block;
 
+		/* Background gc below its target hunts for the dirtiest block */
+		topup = background && dev->n_erased_blocks <
+		    min_erased + dev->param.bg_reserve_blocks;
+
 		/* If we need a block soon then do aggressive gc. */
 		if (dev->n_erased_blocks < min_erased)
 			aggressive = 1;
@@ -2944,7 +2949,8 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 		}
 		if (dev->gc_block < 1) {
 			dev->gc_block =
-			    yaffs_find_gc_block(dev, aggressive, background);
+			    yaffs_find_gc_block(dev, aggressive || topup,
+						background);
 			dev->gc_chunk = 0;
 			dev->n_clean_ups = 0;
 		}
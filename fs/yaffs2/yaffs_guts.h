@@ -504,6 +504,10 @@ struct yaffs_param {
 	int end_block;		/* End block we're allowed to use */
 	int n_reserved_blocks;	/* We want this tuneable so that we can reduce */
 	/* reserved blocks on NOR and RAM. */
+	int bg_reserve_blocks;	/* Erased blocks, on top of the reserve, that
+				 * background gc tries to keep in hand so that
+				 * writers don't have to gc inline.
+				 */
 
 	int n_caches;		/* If <= 0, then short op caching is disabled, else
 				 * the number of short op caches (don't use too many).
@@ -547,6 +551,11 @@ struct yaffs_param {
 	int (*query_block_fn) (struct yaffs_dev * dev, int block_no,
 			       enum yaffs_block_state * state,
 			       u32 * seq_number);
+	/* Optional: read the tags of a whole block in one go. Used by the
+	 * mount scan, returns YAFFS_FAIL if it can't do it right now.
+	 */
+	int (*read_block_tags_fn) (struct yaffs_dev * dev, int block_no,
+				   struct yaffs_ext_tags * tags);
 #endif
 
 	/* The remove_obj_fn function must be supplied by OS flavours that
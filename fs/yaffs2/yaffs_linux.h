@@ -28,11 +28,23 @@ struct yaffs_linux_context {
 	u8 *spare_buffer;	/* For mtdif2 use. Don't know the size of the buffer
 				 * at compile time so we have to allocate it.
 				 */
+	u8 *scan_oob_buffer;	/* Block's worth of spare, only while mounting */
 	struct list_head search_contexts;
 	void (*put_super_fn) (struct super_block * sb);
 
 	struct task_struct *readdir_process;
 	unsigned mount_id;
+
+	unsigned mount_ms;	/* Time yaffs_guts_initialise() took */
+	unsigned long dirty_since;	/* When the checkpoint went stale */
+	u32 bg_last_writes;	/* n_page_writes at the last bg pass */
+	u32 bg_checkpoints;	/* Checkpoints written by the bg thread */
+
+	/* Writers that had to garbage collect inline */
+	u32 n_writes;
+	u32 n_write_stalls;
+	u64 write_stall_us;
+	u32 write_stall_max_us;
 };
 
 #define yaffs_dev_to_lc(dev) ((struct yaffs_linux_context *)((dev)->os_context))
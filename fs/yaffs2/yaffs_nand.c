@@ -81,6 +81,37 @@ int yaffs_wr_chunk_tags_nand(struct yaffs_dev *dev,
 		return yaffs_tags_compat_wr(dev, nand_chunk, buffer, tags);
 }
 
+/*
+ * Read the tags of every chunk in a block into tags[], which must have
+ * room for chunks_per_block entries. Fails if the driver can't do it, in
+ * which case the caller reads the chunks one at a time.
+ */
+int yaffs_rd_block_tags_nand(struct yaffs_dev *dev, int block_no,
+			     struct yaffs_ext_tags *tags)
+{
+	struct yaffs_block_info *bi;
+	int result;
+	int i;
+
+	if (!dev->param.read_block_tags_fn)
+		return YAFFS_FAIL;
+
+	result = dev->param.read_block_tags_fn(dev,
+					       block_no - dev->block_offset,
+					       tags);
+	if (result != YAFFS_OK)
+		return result;
+
+	dev->n_page_reads += dev->param.chunks_per_block;
+
+	bi = yaffs_get_block_info(dev, block_no);
+	for (i = 0; i < dev->param.chunks_per_block; i++)
+		if (tags[i].ecc_result > YAFFS_ECC_RESULT_NO_ERROR)
+			yaffs_handle_chunk_error(dev, bi);
+
+	return YAFFS_OK;
+}
+
 int yaffs_mark_bad(struct yaffs_dev *dev, int block_no)
 {
 	block_no -= dev->block_offset;
@@ -24,6 +24,9 @@ int yaffs_wr_chunk_tags_nand(struct yaffs_dev *dev,
 			     int nand_chunk,
 			     const u8 * buffer, struct yaffs_ext_tags *tags);
 
+int yaffs_rd_block_tags_nand(struct yaffs_dev *dev, int block_no,
+			     struct yaffs_ext_tags *tags);
+
 int yaffs_mark_bad(struct yaffs_dev *dev, int block_no);
 
 int yaffs_query_init_block_state(struct yaffs_dev *dev,
@@ -97,6 +97,10 @@ unsigned int yaffs_wr_attempts = YAFFS_WR_ATTEMPTS;
 unsigned int yaffs_auto_checkpoint = 1;
 unsigned int yaffs_gc_control = 1;
 unsigned int yaffs_bg_enable = 1;
+/* Seconds the checkpoint may stay stale before the bg thread rewrites it */
+unsigned int yaffs_checkpoint_interval = 60;
+/* Erased blocks background gc keeps spare, picked up at mount time */
+unsigned int yaffs_bg_reserve = 8;
 
 /* Module Parameters */
 module_param(yaffs_trace_mask, uint, 0644);
@@ -104,6 +108,8 @@ module_param(yaffs_wr_attempts, uint, 0644);
 module_param(yaffs_auto_checkpoint, uint, 0644);
 module_param(yaffs_gc_control, uint, 0644);
 module_param(yaffs_bg_enable, uint, 0644);
+module_param(yaffs_checkpoint_interval, uint, 0644);
+module_param(yaffs_bg_reserve, uint, 0644);
 
 
 #define yaffs_inode_to_obj_lv(iptr) ((iptr)->i_private)
@@ -1193,6 +1199,36 @@ static int yaffs_readpage(struct file *f, struct page *pg)
 
 /* writepage inspired by/stolen from smbfs */
 
+/*
+ * yaffs_wr_file() for the vfs write paths. Writes that had to garbage
+ * collect inline, because the background thread did not keep up, are
+ * counted as stalls together with how long they took.
+ * Called with the gross lock held.
+ */
+static int yaffs_timed_wr_file(struct yaffs_obj *obj, const u8 *buf,
+			       loff_t offset, int n_bytes)
+{
+	struct yaffs_dev *dev = obj->my_dev;
+	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
+	u32 fg_gcs = dev->n_gc_blocks - dev->bg_gcs;
+	ktime_t start = ktime_get();
+	unsigned us;
+	int n_written;
+
+	n_written = yaffs_wr_file(obj, buf, offset, n_bytes, 0);
+
+	context->n_writes++;
+	if (dev->n_gc_blocks - dev->bg_gcs != fg_gcs) {
+		us = ktime_to_us(ktime_sub(ktime_get(), start));
+		context->n_write_stalls++;
+		context->write_stall_us += us;
+		if (us > context->write_stall_max_us)
+			context->write_stall_max_us = us;
+	}
+
+	return n_written;
+}
+
 static int yaffs_writepage(struct page *page, struct writeback_control *wbc)
 {
 	struct yaffs_dev *dev;
@@ -1253,8 +1289,9 @@ static int yaffs_writepage(struct page *page, struct writeback_control *wbc)
 		"writepag0: obj = %05x, ino = %05x",
 		(int)obj->variant.file_variant.file_size, (int)inode->i_size);
 
-	n_written = yaffs_wr_file(obj, buffer,
-				  page->index << PAGE_CACHE_SHIFT, n_bytes, 0);
+	n_written = yaffs_timed_wr_file(obj, buffer,
+					page->index << PAGE_CACHE_SHIFT,
+					n_bytes);
 
 	yaffs_touch_super(dev);
 
@@ -1398,7 +1435,7 @@ static ssize_t yaffs_file_write(struct file *f, const char *buf, size_t n,
 			"yaffs_file_write about to write writing %u(%x) bytes to object %d at %d(%x)",
 			(unsigned)n, (unsigned)n, obj->obj_id, ipos, ipos);
 
-	n_written = yaffs_wr_file(obj, buf, ipos, n, 0);
+	n_written = yaffs_timed_wr_file(obj, (const u8 *)buf, ipos, n);
 
 	yaffs_touch_super(dev);
 
@@ -1560,6 +1597,9 @@ static unsigned yaffs_bg_gc_urgency(struct yaffs_dev *dev)
 		return 0;
 	else if (scattered < (dev->param.chunks_per_block * 2))
 		return 0;
+	else if (dev->n_erased_blocks <
+		 dev->param.n_reserved_blocks + dev->param.bg_reserve_blocks)
+		return 1;
 	else if (erased_chunks > dev->n_free_chunks / 2)
 		return 0;
 	else if (erased_chunks > dev->n_free_chunks / 4)
@@ -1598,6 +1638,50 @@ static int yaffs_do_sync_fs(struct super_block *sb, int request_checkpoint)
 	return 0;
 }
 
+/*
+ * Write a checkpoint from the background thread so that an unclean
+ * shutdown does not cost a full scan on the next mount. Only done once
+ * the checkpoint has been stale for yaffs_checkpoint_interval seconds and
+ * nothing was written since the last pass, so busy periods don't keep
+ * throwing checkpoints away. Called with the gross lock held.
+ */
+static void yaffs_bg_checkpoint(struct yaffs_dev *dev, unsigned long now)
+{
+	struct yaffs_linux_context *context = yaffs_dev_to_lc(dev);
+	u32 writes = dev->n_page_writes;
+	int idle = (writes == context->bg_last_writes);
+
+	context->bg_last_writes = writes;
+
+	if (dev->is_checkpointed) {
+		context->dirty_since = 0;
+		return;
+	}
+
+	if (!context->dirty_since) {
+		context->dirty_since = now;
+		return;
+	}
+
+	if (!yaffs_checkpoint_interval || !yaffs_auto_checkpoint ||
+	    dev->param.skip_checkpt_wr || !idle ||
+	    yaffs_bg_gc_urgency(dev) ||
+	    time_before(now, context->dirty_since +
+			yaffs_checkpoint_interval * HZ))
+		return;
+
+	yaffs_trace(YAFFS_TRACE_BACKGROUND | YAFFS_TRACE_CHECKPOINT,
+		"yaffs_background: writing checkpoint");
+
+	yaffs_flush_super(context->super, 1);
+	if (dev->is_checkpointed) {
+		context->super->s_dirt = 0;
+		context->bg_checkpoints++;
+		context->dirty_since = 0;
+	}
+	context->bg_last_writes = dev->n_page_writes;
+}
+
 /*
  * yaffs background thread functions .
  * yaffs_bg_thread_fn() the thread function
@@ -1668,6 +1752,9 @@ static int yaffs_bg_thread_fn(void *data)
 				next_gc = next_dir_update;
                         }
 		}
+
+		if (yaffs_bg_enable)
+			yaffs_bg_checkpoint(dev, now);
 		yaffs_gross_unlock(dev);
 		expires = next_dir_update;
 		if (time_before(next_gc, expires))
@@ -2026,6 +2113,7 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	struct yaffs_options options;
 
 	unsigned mount_id;
+	unsigned long mount_start;
 	int found;
 	struct yaffs_linux_context *context_iterator;
 	struct list_head *l;
@@ -2215,6 +2303,7 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	param->chunks_per_block = YAFFS_CHUNKS_PER_BLOCK;
 	param->total_bytes_per_chunk = YAFFS_BYTES_PER_CHUNK;
 	param->n_reserved_blocks = 5;
+	param->bg_reserve_blocks = yaffs_bg_reserve;
 	param->n_caches = (options.no_cache) ? 0 : 10;
 	param->inband_tags = options.inband_tags;
 
@@ -2262,6 +2351,7 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 		param->read_chunk_tags_fn = nandmtd2_read_chunk_tags;
 		param->bad_block_fn = nandmtd2_mark_block_bad;
 		param->query_block_fn = nandmtd2_query_block;
+		param->read_block_tags_fn = nandmtd2_read_block_tags;
 		yaffs_dev_to_lc(dev)->spare_buffer = 
 		                kmalloc(mtd->oobsize, GFP_NOFS);
 		param->is_yaffs2 = 1;
@@ -2324,11 +2414,25 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 
 	yaffs_gross_lock(dev);
 
+	/* Lets the scan read tags a block at a time, freed once mounted */
+	if (yaffs_version == 2 && !param->inband_tags)
+		context->scan_oob_buffer =
+		    kmalloc(param->chunks_per_block * mtd->oobavail, GFP_NOFS);
+
+	mount_start = jiffies;
 	err = yaffs_guts_initialise(dev);
+	context->mount_ms = jiffies_to_msecs(jiffies - mount_start);
+
+	kfree(context->scan_oob_buffer);
+	context->scan_oob_buffer = NULL;
 
 	yaffs_trace(YAFFS_TRACE_OS,
 		"yaffs_read_super: guts initialised %s",
 		(err == YAFFS_OK) ? "OK" : "FAILED");
+	yaffs_trace(YAFFS_TRACE_MOUNT,
+		"yaffs_read_super: mount took %u ms, %s",
+		context->mount_ms,
+		dev->is_checkpointed ? "checkpoint restored" : "scanned");
 
 	if (err == YAFFS_OK)
 		yaffs_bg_start(dev);
@@ -2440,6 +2544,8 @@ static char *yaffs_dump_dev_part0(char *buf, struct yaffs_dev *dev)
 	buf += sprintf(buf, "n_caches.............. %d\n", param->n_caches);
 	buf += sprintf(buf, "n_reserved_blocks..... %d\n",
 			param->n_reserved_blocks);
+	buf += sprintf(buf, "bg_reserve_blocks..... %d\n",
+			param->bg_reserve_blocks);
 	buf += sprintf(buf, "always_check_erased... %d\n",
 			param->always_check_erased);
 
@@ -2492,6 +2598,18 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 	    sprintf(buf, "n_unlinked_files...... %u\n", dev->n_unlinked_files);
 	buf += sprintf(buf, "refresh_count......... %u\n", dev->refresh_count);
 	buf += sprintf(buf, "n_bg_deletions........ %u\n", dev->n_bg_deletions);
+	buf += sprintf(buf, "mount_ms.............. %u\n",
+		       yaffs_dev_to_lc(dev)->mount_ms);
+	buf += sprintf(buf, "bg_checkpoints........ %u\n",
+		       yaffs_dev_to_lc(dev)->bg_checkpoints);
+	buf += sprintf(buf, "n_writes.............. %u\n",
+		       yaffs_dev_to_lc(dev)->n_writes);
+	buf += sprintf(buf, "n_write_stalls........ %u\n",
+		       yaffs_dev_to_lc(dev)->n_write_stalls);
+	buf += sprintf(buf, "write_stall_us........ %llu\n",
+		       (unsigned long long)yaffs_dev_to_lc(dev)->write_stall_us);
+	buf += sprintf(buf, "write_stall_max_us.... %u\n",
+		       yaffs_dev_to_lc(dev)->write_stall_max_us);
 
 	return buf;
 }
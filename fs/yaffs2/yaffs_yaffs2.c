@@ -986,6 +986,8 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 	struct yaffs_block_index *block_index = NULL;
 	int alt_block_index = 0;
+	struct yaffs_ext_tags *block_tags = NULL;
+	int have_block_tags;
 
 	yaffs_trace(YAFFS_TRACE_SCAN,
 		"yaffs2_scan_backwards starts  intstartblk %d intendblk %d...",
@@ -1009,6 +1011,11 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 		return YAFFS_FAIL;
 	}
 
+	/* Pull in a block's worth of tags at a time if the driver can */
+	if (dev->param.read_block_tags_fn)
+		block_tags = kmalloc(dev->param.chunks_per_block *
+				     sizeof(struct yaffs_ext_tags), GFP_NOFS);
+
 	dev->blocks_in_checkpt = 0;
 
 	chunk_data = yaffs_get_temp_buffer(dev, __LINE__);
@@ -1102,6 +1109,9 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 		deleted = 0;
 
+		have_block_tags = block_tags &&
+		    yaffs_rd_block_tags_nand(dev, blk, block_tags) == YAFFS_OK;
+
 		/* For each chunk in each block that needs scanning.... */
 		found_chunks = 0;
 		for (c = dev->param.chunks_per_block - 1;
@@ -1114,8 +1124,13 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 
 			chunk = blk * dev->param.chunks_per_block + c;
 
-			result = yaffs_rd_chunk_tags_nand(dev, chunk, NULL,
-							  &tags);
+			if (have_block_tags) {
+				tags = block_tags[c];
+				result = YAFFS_OK;
+			} else {
+				result = yaffs_rd_chunk_tags_nand(dev, chunk,
+								  NULL, &tags);
+			}
 
 			/* Let's have a good look at this chunk... */
 
@@ -1580,6 +1595,8 @@ int yaffs2_scan_backwards(struct yaffs_dev *dev)
 	else
 		kfree(block_index);
 
+	kfree(block_tags);
+
 	/* Ok, we've done all the scanning.
 	 * Fix up the hard link chains.
 	 * We should now have scanned all the objects, now it's time to add these
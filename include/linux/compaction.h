@@ -25,6 +25,11 @@ extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			bool sync);
 extern int compact_pgdat(pg_data_t *pgdat, int order);
 extern unsigned long compaction_suitable(struct zone *zone, int order);
+extern int compaction_register_target(unsigned int order,
+			unsigned long nr_blocks);
+extern void compaction_unregister_target(unsigned int order,
+			unsigned long nr_blocks);
+extern void wakeup_kcompactd(void);
 
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
@@ -79,6 +84,21 @@ static inline unsigned long compaction_suitable(struct zone *zone, int order)
 	return COMPACT_SKIPPED;
 }
 
+static inline int compaction_register_target(unsigned int order,
+			unsigned long nr_blocks)
+{
+	return 0;
+}
+
+static inline void compaction_unregister_target(unsigned int order,
+			unsigned long nr_blocks)
+{
+}
+
+static inline void wakeup_kcompactd(void)
+{
+}
+
 static inline void defer_compaction(struct zone *zone, int order)
 {
 }
@@ -157,6 +157,21 @@ extern int cpuidle_wrap_enter(struct cpuidle_device *dev,
 				int (*enter)(struct cpuidle_device *dev,
 					struct cpuidle_driver *drv, int index));
 extern int cpuidle_play_dead(void);
+extern struct cpuidle_state *cpuidle_get_cur_state(int cpu);
+
+/**
+ * cpuidle_cur_exit_latency - exit latency of the state @cpu idles in
+ * @cpu: the cpu to look at
+ *
+ * Returns 0 while @cpu is not inside a cpuidle state. The value is racy
+ * and only meant as a placement hint.
+ */
+static inline unsigned int cpuidle_cur_exit_latency(int cpu)
+{
+	struct cpuidle_state *state = cpuidle_get_cur_state(cpu);
+
+	return state ? state->exit_latency : 0;
+}
 
 #else
 static inline void disable_cpuidle(void) { }
@@ -180,6 +195,9 @@ static inline int cpuidle_wrap_enter(struct cpuidle_device *dev,
 					struct cpuidle_driver *drv, int index))
 { return -ENODEV; }
 static inline int cpuidle_play_dead(void) {return -ENODEV; }
+static inline struct cpuidle_state *cpuidle_get_cur_state(int cpu)
+{ return NULL; }
+static inline unsigned int cpuidle_cur_exit_latency(int cpu) { return 0; }
 
 #endif
 
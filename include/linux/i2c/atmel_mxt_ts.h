@@ -15,6 +15,8 @@
 
 #include <linux/types.h>
 
+struct notifier_block;
+
 /* Orient */
 #define MXT_NORMAL		0x0
 #define MXT_DIAGONAL		0x1
@@ -39,6 +41,13 @@ struct mxt_platform_data {
 	unsigned int voltage;
 	unsigned char orient;
 	unsigned long irqflags;
+
+	/*
+	 * Optional display vsync source: when set, touch frames can be
+	 * delivered on vsync instead of as soon as they are read.
+	 */
+	int (*register_vsync)(struct notifier_block *nb);
+	void (*unregister_vsync)(struct notifier_block *nb);
 };
 
 #endif /* __LINUX_ATMEL_MXT_TS_H */
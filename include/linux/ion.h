@@ -27,6 +27,9 @@ struct ion_handle;
  * @ION_HEAP_TYPE_CARVEOUT:	 memory allocated from a prereserved
  * 				 carveout heap, allocations are physically
  * 				 contiguous
+ * @ION_HEAP_TYPE_CMA:		 memory allocated from a CMA area, the
+ * 				 pages serve movable allocations while
+ * 				 they are not used by ion
  * @ION_NUM_HEAPS:		 helper for iterating over heaps, a bit mask
  * 				 is used to identify the heaps, so only 32
  * 				 total heap types are supported
@@ -35,6 +38,7 @@ enum ion_heap_type {
 	ION_HEAP_TYPE_SYSTEM,
 	ION_HEAP_TYPE_SYSTEM_CONTIG,
 	ION_HEAP_TYPE_CARVEOUT,
+	ION_HEAP_TYPE_CMA,
 	ION_HEAP_TYPE_CUSTOM, /* must be last so device specific heaps always
 				 are at the end of this enum */
 	ION_NUM_HEAPS = 16,
@@ -43,6 +47,7 @@ enum ion_heap_type {
 #define ION_HEAP_SYSTEM_MASK		(1 << ION_HEAP_TYPE_SYSTEM)
 #define ION_HEAP_SYSTEM_CONTIG_MASK	(1 << ION_HEAP_TYPE_SYSTEM_CONTIG)
 #define ION_HEAP_CARVEOUT_MASK		(1 << ION_HEAP_TYPE_CARVEOUT)
+#define ION_HEAP_CMA_MASK		(1 << ION_HEAP_TYPE_CMA)
 
 /**
  * heap flags - the lower 16 bits are used by core ion, the upper 16
@@ -77,6 +82,8 @@ struct ion_buffer;
  * @name:	used for debug purposes
  * @base:	base address of heap in physical memory if applicable
  * @size:	size of the heap in bytes if applicable
+ * @flags:	ION_HEAP_FLAG_* behaviour flags for the heap
+ * @priv:	heap type specific platform data
  *
  * Provided by the board file.
  */
@@ -86,17 +93,62 @@ struct ion_platform_heap {
 	const char *name;
 	ion_phys_addr_t base;
 	size_t size;
+	unsigned long flags;
+	void *priv;
 };
 
+/**
+ * heap behaviour flags, passed in struct ion_platform_heap
+ */
+#define ION_HEAP_FLAG_DEFER_FREE (1 << 0)	/* buffers are freed from a
+						   background thread instead
+						   of the releasing thread */
+#define ION_HEAP_FLAG_SIZE_CLASS (1 << 1)	/* carveout heaps place each
+						   allocation naturally aligned
+						   to its size class, buddy
+						   style, instead of first
+						   fit */
+
+/**
+ * struct ion_alloc_policy - how to serve allocations for one use case
+ * @heap_mask:	allocations requesting exactly this heap mask use the policy
+ * @preferred:	id of the heap to try first
+ * @fallback:	id of the heap to try when @preferred fails, or
+ *		ION_POLICY_NO_FALLBACK
+ * @flags:	ION_POLICY_* flags
+ *
+ * Without a policy ion_alloc() tries every heap in the mask in id order.
+ */
+struct ion_alloc_policy {
+	unsigned int heap_mask;
+	unsigned int preferred;
+	unsigned int fallback;
+	unsigned int flags;
+};
+
+#define ION_POLICY_NO_FALLBACK	(~0U)
+
+#define ION_POLICY_RECLAIM	(1 << 0)	/* drain the preferred heap's
+						   deferred frees and retry
+						   before falling back */
+#define ION_POLICY_FAST_FAIL	(1 << 1)	/* skip the preferred heap
+						   while it can't have grown
+						   since it last failed an
+						   allocation this large */
+
 /**
  * struct ion_platform_data - array of platform heaps passed from board file
  * @nr:		number of structures in the array
+ * @nr_policies: number of entries in @policies
+ * @policies:	allocation policies, may be NULL
  * @heaps:	array of platform_heap structions
  *
  * Provided by the board file in the form of platform data to a platform device.
  */
 struct ion_platform_data {
 	int nr;
+	int nr_policies;
+	struct ion_alloc_policy *policies;
 	struct ion_platform_heap heaps[];
 };
 
@@ -293,6 +345,38 @@ struct ion_cached_user_buf_data {
 	size_t size;
 };
 
+/**
+ * struct ion_sync_range - a byte range of a shared buffer to sync
+ * @fd:		file descriptor obtained from ION_IOC_SHARE or ION_IOC_MAP
+ * @dir:	ION_SYNC_FOR_DEVICE, ION_SYNC_FOR_CPU or ION_SYNC_BIDIRECTIONAL
+ * @offset:	offset in bytes of the range from the start of the buffer
+ * @length:	length of the range in bytes
+ */
+struct ion_sync_range {
+	int fd;
+	unsigned int dir;
+	size_t offset;
+	size_t length;
+};
+
+#define ION_SYNC_FOR_DEVICE	0	/* clean cpu caches before device
+					   reads the range */
+#define ION_SYNC_FOR_CPU	1	/* invalidate cpu caches after the
+					   device wrote the range */
+#define ION_SYNC_BIDIRECTIONAL	2	/* clean and invalidate */
+
+/**
+ * struct ion_sync_ranges_data - a vector of ranges to sync in one call
+ * @ranges:	userspace pointer to an array of struct ion_sync_range
+ * @count:	number of entries in @ranges, at most ION_SYNC_RANGES_MAX
+ */
+struct ion_sync_ranges_data {
+	struct ion_sync_range *ranges;
+	unsigned int count;
+};
+
+#define ION_SYNC_RANGES_MAX	64
+
 /**
  * struct ion_custom_data - metadata passed to/from userspace for a custom ioctl
  * @cmd:	the custom ioctl function to call
@@ -377,4 +461,16 @@ struct ion_custom_data {
 #define ION_IOC_INVAL_CACHED	_IOWR(ION_IOC_MAGIC, 9, \
 					struct ion_cached_user_buf_data)
 
+/**
+ * DOC: ION_IOC_SYNC_RANGES - cache maintenance on parts of shared buffers
+ *
+ * Takes an ion_sync_ranges_data struct pointing to an array of
+ * ion_sync_range.  Only the pages covered by each range get cache
+ * maintenance, so a ROI or a single plane of a multi-plane buffer can be
+ * synced without touching the rest.  When the ranges add up to more than
+ * a full cache flush costs, the whole cache is flushed once instead.
+ */
+#define ION_IOC_SYNC_RANGES	_IOWR(ION_IOC_MAGIC, 10, \
+					struct ion_sync_ranges_data)
+
 #endif /* _LINUX_ION_H */
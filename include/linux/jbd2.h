@@ -920,6 +920,15 @@ struct journal_s
 	u32			j_min_batch_time;
 	u32			j_max_batch_time;
 
+	/*
+	 * last task to ask for an fsync commit and when (ns), used to tell
+	 * concurrent fsyncers from a single one, and the number of fsync
+	 * commits held back so that others could join them
+	 */
+	pid_t			j_last_fsync_pid;
+	u64			j_last_fsync_time;
+	unsigned long		j_fsync_batched;
+
 	/* This function is called when a transaction is closed */
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
@@ -1173,6 +1182,8 @@ extern void	jbd2_clear_buffer_revoked_flags(journal_t *journal);
 
 int __jbd2_log_space_left(journal_t *); /* Called with journal locked */
 int jbd2_log_start_commit(journal_t *journal, tid_t tid);
+int jbd2_log_start_commit_batched(journal_t *journal, tid_t tid,
+				  unsigned int max_delay_us);
 int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_journal_force_commit_nested(journal_t *journal);
@@ -43,11 +43,37 @@ struct omap_ion_tiler_alloc_data {
 	u32 token;
 };
 
+/**
+ * struct omap_ion_tiler_alloc_nv12_data - metadata for an NV12 allocation
+ * @planes:	planes[0] describes the 8-bit Y plane and is filled in by
+ *		userspace like for OMAP_ION_TILER_ALLOC; planes[1] is the
+ *		16-bit UV plane and is filled in entirely by the kernel
+ *
+ * Provided by userspace as an argument to the OMAP_ION_TILER_ALLOC_NV12 ioctl
+ */
+struct omap_ion_tiler_alloc_nv12_data {
+	struct omap_ion_tiler_alloc_data planes[2];
+};
+
 #ifdef __KERNEL__
+/**
+ * struct omap_ion_tiler_heap_data - board data for OMAP_ION_HEAP_TYPE_TILER
+ * @recycle_blocks:	number of freed 2D buffers whose TILER area is kept
+ *			reserved for the next allocation of the same format
+ *			and size; these are dropped under memory pressure
+ *
+ * Passed as the priv field of struct ion_platform_heap.
+ */
+struct omap_ion_tiler_heap_data {
+	unsigned int recycle_blocks;
+};
+
 int omap_ion_tiler_alloc(struct ion_client *client,
 			 struct omap_ion_tiler_alloc_data *data);
 int omap_ion_nonsecure_tiler_alloc(struct ion_client *client,
 			 struct omap_ion_tiler_alloc_data *data);
+int omap_ion_tiler_alloc_nv12(struct ion_client *client,
+			 struct omap_ion_tiler_alloc_nv12_data *data);
 /* given a handle in the tiler, return a list of tiler pages that back it */
 int omap_tiler_pages(struct ion_client *client, struct ion_handle *handle,
 		     int *n, u32 **tiler_pages);
@@ -70,6 +96,7 @@ enum {
 
 enum {
 	OMAP_ION_TILER_ALLOC,
+	OMAP_ION_TILER_ALLOC_NV12,
 };
 
 /**
@@ -92,6 +119,7 @@ enum {
 	OMAP_ION_HEAP_TILER,
 	OMAP_ION_HEAP_SECURE_INPUT,
 	OMAP_ION_HEAP_NONSECURE_TILER,
+	OMAP_ION_HEAP_CMA,
 };
 
 #endif /* _LINUX_ION_H */
@@ -59,6 +59,7 @@
 #define OMAPFB_SET_TEARSYNC	OMAP_IOW(62, struct omapfb_tearsync_info)
 #define OMAPFB_GET_DISPLAY_INFO	OMAP_IOR(63, struct omapfb_display_info)
 #define OMAPFB_ENABLEVSYNC	OMAP_IOW(64, int)
+#define OMAPFB_DAMAGE		OMAP_IOW(65, struct omapfb_damage)
 
 #define OMAPFB_CAPS_GENERIC_MASK	0x00000fff
 #define OMAPFB_CAPS_LCDC_MASK		0x00fff000
@@ -123,6 +124,20 @@ struct omapfb_update_window_old {
 	__u32 format;
 };
 
+#define OMAPFB_MAX_DAMAGE_RECTS	16
+
+struct omapfb_rect {
+	__u32 x, y;
+	__u32 width, height;
+};
+
+/* rectangles of the virtual framebuffer written since the last update */
+struct omapfb_damage {
+	__u32 num_rects;
+	__u32 reserved[3];
+	struct omapfb_rect rects[OMAPFB_MAX_DAMAGE_RECTS];
+};
+
 enum omapfb_plane {
 	OMAPFB_PLANE_GFX = 0,
 	OMAPFB_PLANE_VID1,
@@ -16,8 +16,10 @@
 #define __LINUX_PERSISTENT_RAM_H__
 
 #include <linux/device.h>
+#include <linux/irq_work.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/timer.h>
 #include <linux/types.h>
 
 struct persistent_ram_buffer;
@@ -55,6 +57,14 @@ struct persistent_ram_zone {
 	int ecc_symsize;
 	int ecc_poly;
 
+	/* Deferred ECC: dirty blocks are encoded from a timer */
+	bool ecc_deferred;
+	unsigned long *ecc_dirty;
+	unsigned long ecc_flags;
+	struct irq_work ecc_irq_work;
+	struct timer_list ecc_timer;
+	struct list_head ecc_node;
+
 	char *old_log;
 	size_t old_log_size;
 	size_t old_log_footer_size;
@@ -65,6 +75,9 @@ int persistent_ram_early_init(struct persistent_ram *ram);
 
 struct persistent_ram_zone *persistent_ram_init_ringbuffer(struct device *dev,
 		bool ecc);
+struct persistent_ram_zone *persistent_ram_init_ringbuffer_part(
+		struct device *dev, bool ecc, unsigned int index,
+		unsigned int count);
 
 int persistent_ram_write(struct persistent_ram_zone *prz, const void *s,
 	unsigned int count);
@@ -72,6 +85,7 @@ int persistent_ram_write(struct persistent_ram_zone *prz, const void *s,
 size_t persistent_ram_old_size(struct persistent_ram_zone *prz);
 void *persistent_ram_old(struct persistent_ram_zone *prz);
 void persistent_ram_free_old(struct persistent_ram_zone *prz);
+void persistent_ram_flush_ecc(struct persistent_ram_zone *prz);
 ssize_t persistent_ram_ecc_string(struct persistent_ram_zone *prz,
 	char *str, size_t len);
 
@@ -93,6 +93,20 @@ struct emif_custom_configs {
 	u32 temp_alert_poll_interval_ms;
 };
 
+/* Initiator classes the bandwidth can be broken down into */
+#define EMIF_MAX_INITIATORS				8
+
+/**
+ * struct emif_initiator - Initiator class for bandwidth measurement
+ * @name:		Name of the class, e.g. "mpu"
+ * @conn_id:		L3 connection id of the initiator, as seen by the
+ *			EMIF performance counter filter
+ */
+struct emif_initiator {
+	const char *name;
+	u8 conn_id;
+};
+
 /**
  * struct emif_platform_data - Platform data passed on EMIF platform
  *				device creation. Used by the driver.
@@ -113,6 +127,10 @@ struct emif_custom_configs {
  *			configurations done by the driver are ok. See
  *			documentation for 'struct emif_custom_configs' for
  *			more details
+ * @initiators:		Initiator classes for bandwidth measurement. Not
+ *			copied by the driver, must stay around. Can be NULL
+ * @num_initiators:	Number of entries in @initiators, at most
+ *			EMIF_MAX_INITIATORS
  */
 struct emif_platform_data {
 	u32 hw_caps;
@@ -123,7 +141,27 @@ struct emif_platform_data {
 	struct emif_custom_configs *custom_configs;
 	u32 ip_rev;
 	u32 phy_type;
+	const struct emif_initiator *initiators;
+	u32 num_initiators;
 };
+
+#if defined(CONFIG_TI_EMIF) || defined(CONFIG_TI_EMIF_MODULE)
+int emif_bw_monitor_get(void);
+void emif_bw_monitor_put(void);
+unsigned long emif_get_bandwidth(void);
+#else
+static inline int emif_bw_monitor_get(void)
+{
+	return -ENODEV;
+}
+static inline void emif_bw_monitor_put(void)
+{
+}
+static inline unsigned long emif_get_bandwidth(void)
+{
+	return 0;
+}
+#endif
 #endif /* __ASSEMBLY__ */
 
 #endif /* __LINUX_EMIF_H */
@@ -516,6 +516,9 @@ struct dev_pm_info {
 	struct completion	completion;
 	struct wakeup_source	*wakeup;
 	bool			wakeup_path:1;
+	u32			suspend_us;	/* Time in suspend callbacks */
+	u32			resume_us;	/* Time in resume callbacks */
+	u32			resume_done_us;	/* Resumed, from noirq start */
 #else
 	unsigned int		should_wakeup:1;
 #endif
@@ -39,6 +39,8 @@
 #include <linux/kref.h>
 #include <linux/klist.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
 #include <linux/virtio.h>
 #include <linux/completion.h>
 #include <linux/idr.h>
@@ -221,7 +223,7 @@ struct fw_rsc_devmem {
  * struct fw_rsc_trace - trace buffer declaration
  * @da: device address
  * @len: length (in bytes)
- * @reserved: reserved (must be zero)
+ * @flags: layout of the buffer, RPROC_TRACE_F_* (other bits must be zero)
  * @name: human-readable name of the trace buffer
  *
  * This resource entry provides the host information about a trace buffer
@@ -232,14 +234,35 @@ struct fw_rsc_devmem {
  *
  * After booting the remote processor, the trace buffers are exposed to the
  * user via debugfs entries (called trace0, trace1, etc..).
+ *
+ * If @flags has RPROC_TRACE_F_SEQ, the buffer starts with a struct
+ * fw_trace_hdr and its debugfs entry streams the log: reads block until
+ * the remote processor writes more, and report what it overwrote before
+ * it could be read.
  */
 struct fw_rsc_trace {
 	u32 da;
 	u32 len;
-	u32 reserved;
+	u32 flags;
 	u8 name[32];
 } __packed;
 
+#define RPROC_TRACE_F_SEQ	(1 << 0)
+
+/**
+ * struct fw_trace_hdr - header of a sequenced trace buffer
+ * @write_seq: running count of log bytes written by the remote processor
+ * @data: the log, a ring of (len - sizeof(struct fw_trace_hdr)) bytes
+ *
+ * Byte n of the log is stored at @data[n % ring size]. The remote processor
+ * updates @write_seq after writing the bytes it accounts for, and the ring
+ * size must be a power of two so the positions survive @write_seq wrapping.
+ */
+struct fw_trace_hdr {
+	u32 write_seq;
+	u8 data[0];
+} __packed;
+
 /**
  * struct fw_rsc_vdev_vring - vring descriptor entry
  * @da: device address
@@ -339,6 +362,7 @@ struct fw_rsc_custom {
  * @len: length, in bytes
  * @da: device address
  * @priv: associated data
+ * @flags: for trace buffers, the RPROC_TRACE_F_* layout flags
  * @node: list node
  */
 struct rproc_mem_entry {
@@ -347,10 +371,12 @@ struct rproc_mem_entry {
 	int len;
 	u32 da;
 	void *priv;
+	u32 flags;
 	struct list_head node;
 };
 
 struct rproc;
+struct rproc_fw_image;
 
 /**
  * struct rproc_ops - platform-specific device handlers
@@ -427,6 +453,45 @@ enum rproc_err {
 	RPROC_ERR_WATCHDOG	= 2,
 };
 
+/* idle gap history buckets, bucket n counts the gaps shorter than 2^n ms */
+#define RPROC_PM_HIST_BUCKETS	16
+
+/**
+ * struct rproc_pm_stats - runtime pm activity of a remote processor
+ * @lock: protects the idle gap history
+ * @last_busy: time of the last message to or from the remote processor
+ * @idle_hist: histogram of the idle gaps between messages
+ * @idle_cnt: number of gaps in @idle_hist, decays with the history
+ * @idle_total: number of idle gaps seen since boot
+ * @suspend_cnt: number of runtime suspends
+ * @suspend_us: total time spent suspending, in usecs
+ * @resume_cnt: number of runtime resumes
+ * @resume_us: total time spent resuming, in usecs
+ * @last_resume_us: latency of the last resume, in usecs
+ * @delay: autosuspend delay picked from the idle gap history, in msecs
+ * @applied: autosuspend delay the device currently uses, in msecs
+ * @break_even_ms: idle time one suspend/resume cycle is worth, on top of
+ *		   the measured resume latency
+ * @adaptive: pick the autosuspend delay from the idle gap history instead
+ *	      of always using @auto_suspend_timeout
+ */
+struct rproc_pm_stats {
+	spinlock_t lock;
+	ktime_t last_busy;
+	u32 idle_hist[RPROC_PM_HIST_BUCKETS];
+	u32 idle_cnt;
+	u32 idle_total;
+	u32 suspend_cnt;
+	u64 suspend_us;
+	u32 resume_cnt;
+	u64 resume_us;
+	u32 last_resume_us;
+	int delay;
+	int applied;
+	u32 break_even_ms;
+	u32 adaptive;
+};
+
 /**
  * struct rproc - represents a physical remote processor device
  * @node: klist node of this rproc object
@@ -458,6 +523,11 @@ enum rproc_err {
  * @auto_suspend_timeout: store the auto suspend timeout for a rproc in msecs
  * @need resume: if true a resume is needed in the system resume callback
  * @system_suspended: true if a system suspend has happened
+ * @rx_coalesce_us: how long to let notifications from the remote processor
+ *		    accumulate before processing them, 0 to process right away
+ * @fw_image: cached copy of the firmware image, so reboots after a crash
+ *	      or a shutdown don't have to go through request_firmware()
+ * @pm: runtime pm activity, used to adapt the autosuspend delay
  */
 struct rproc {
 	struct klist_node node;
@@ -490,6 +560,9 @@ struct rproc {
 	bool need_resume;
 	bool system_suspended;
 	char *fw_version;
+	u32 rx_coalesce_us;
+	struct rproc_fw_image *fw_image;
+	struct rproc_pm_stats pm;
 };
 
 /* we currently support only two vrings per rvdev */
@@ -525,6 +598,8 @@ struct rproc_vring {
  * @vring: the vrings for this vdev
  * @dfeatures: virtio device features
  * @gfeatures: virtio guest features
+ * @config: copy of the virtio config space from the vdev resource entry
+ * @config_len: size of @config
  */
 struct rproc_vdev {
 	struct list_head node;
@@ -533,6 +608,8 @@ struct rproc_vdev {
 	struct rproc_vring vring[RVDEV_NUM_VRINGS];
 	unsigned long dfeatures;
 	unsigned long gfeatures;
+	void *config;
+	u32 config_len;
 };
 
 struct rproc *rproc_get_by_name(const char *name);
@@ -41,9 +41,24 @@
 #include <linux/idr.h>
 #include <linux/kref.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 /* The feature bitmap for virtio rpmsg */
 #define VIRTIO_RPMSG_F_NS	0 /* RP supports name service notifications */
+#define VIRTIO_RPMSG_F_BUFS	1 /* RP sets buffer count and size in config */
+
+/**
+ * struct rpmsg_config - virtio config space of an rpmsg vdev
+ * @num_bufs: total number of buffers, half for rx and half for tx
+ * @buf_size: size of each buffer, including the rpmsg header
+ *
+ * Only valid if VIRTIO_RPMSG_F_BUFS is offered. Otherwise, or if the
+ * values are unusable, the bus falls back to its default layout.
+ */
+struct rpmsg_config {
+	u32 num_bufs;
+	u32 buf_size;
+} __packed;
 
 /**
  * struct rpmsg_hdr - common header for all rpmsg messages
@@ -65,6 +80,26 @@ struct rpmsg_hdr {
 	u8 data[0];
 } __packed;
 
+/**
+ * enum rpmsg_hdr_flags - rpmsg message flags
+ *
+ * @RPMSG_F_SHM: the payload is a &struct rpmsg_shm_ref, and the message data
+ * lives in the shared region registered on the receiving channel
+ */
+enum rpmsg_hdr_flags {
+	RPMSG_F_SHM		= 1 << 0,
+};
+
+/**
+ * struct rpmsg_shm_ref - reference to a message held in shared memory
+ * @da: device address of the message data
+ * @len: length of the message data (in bytes)
+ */
+struct rpmsg_shm_ref {
+	u32 da;
+	u32 len;
+} __packed;
+
 /**
  * struct rpmsg_ns_msg - dynamic name service announcement message
  * @name: name of remote service that is published
@@ -104,15 +139,20 @@ enum rpmsg_ns_flags {
  * @rbufs:	kernel address of rx buffers
  * @sbufs:	kernel address of tx buffers
  * @last_sbuf:	index of last tx buffer used
+ * @num_bufs:	total number of rx and tx buffers
+ * @buf_size:	size of each buffer, including the rpmsg header
  * @bufs_dma:	dma base addr of the buffers
  * @tx_lock:	protects svq, sbufs and sleepers, to allow concurrent senders.
  *		sending a message might require waking up a dozing remote
  *		processor, which involves sleeping, hence the mutex.
  * @rx_lock:	protects rvq, to allow concurrent receive threads.
+ * @rx_work:	continues draining rvq once a pass ran out of @rx_budget
+ * @rx_budget:	messages handled per rx pass before yielding
  * @endpoints:	idr of local endpoints, allows fast retrieval
  * @endpoints_lock: lock of the endpoints set
  * @sendq:	wait queue of sending contexts waiting for a tx buffers
  * @sleepers:	number of senders that are waiting for a tx buffer
+ * @tx_senders:	number of senders queueing tx buffers; the last one kicks
  * @ns_ept:	the bus's name service endpoint
  * @id:		unique system-wide index id for this vproc
  *
@@ -125,17 +165,34 @@ struct virtproc_info {
 	struct virtqueue *rvq, *svq;
 	void *rbufs, *sbufs;
 	int last_sbuf;
+	unsigned int num_bufs;
+	unsigned int buf_size;
 	dma_addr_t bufs_dma;
 	struct mutex tx_lock;
 	struct mutex rx_lock;
+	struct work_struct rx_work;
+	unsigned int rx_budget;
 	struct idr endpoints;
 	struct mutex endpoints_lock;
 	wait_queue_head_t sendq;
 	atomic_t sleepers;
+	atomic_t tx_senders;
 	struct rpmsg_endpoint *ns_ept;
 	int id;
 };
 
+/**
+ * struct rpmsg_shm - shared memory region registered on a channel
+ * @va: kernel address of the region
+ * @da: device address of the region, as seen by the remote processor
+ * @len: size of the region (in bytes)
+ */
+struct rpmsg_shm {
+	void *va;
+	u32 da;
+	u32 len;
+};
+
 /**
  * rpmsg_channel - devices that belong to the rpmsg bus are called channels
  * @vrp: the remote processor this channel belongs to
@@ -145,6 +202,7 @@ struct virtproc_info {
  * @dst: destination address
  * @ept: the rpmsg endpoint of this channel
  * @announce: if set, rpmsg will announce the creation/removal of this channel
+ * @shm: shared region for zero-copy messages, see rpmsg_shm_register()
  */
 struct rpmsg_channel {
 	struct virtproc_info *vrp;
@@ -154,6 +212,7 @@ struct rpmsg_channel {
 	u32 dst;
 	struct rpmsg_endpoint *ept;
 	bool announce;
+	struct rpmsg_shm shm;
 };
 
 typedef void (*rpmsg_rx_cb_t)(struct rpmsg_channel *, void *, int, void *, u32);
@@ -166,6 +225,9 @@ typedef void (*rpmsg_rx_cb_t)(struct rpmsg_channel *, void *, int, void *, u32);
  * @cb_lock: must be taken before accessing/changing @cb
  * @addr: local rpmsg address
  * @priv: private data for the driver's use
+ * @tx_msgs: number of messages sent from @addr
+ * @tx_bytes: number of payload bytes sent from @addr
+ * @tx_kicks: number of remote processor notifications raised by those sends
  *
  * In essence, an rpmsg endpoint represents a listener on the rpmsg bus, as
  * it binds an rpmsg address with an rx callback handler.
@@ -188,6 +250,21 @@ struct rpmsg_endpoint {
 	struct mutex cb_lock;
 	u32 addr;
 	void *priv;
+	atomic_t tx_msgs;
+	atomic_t tx_bytes;
+	atomic_t tx_kicks;
+};
+
+/**
+ * struct rpmsg_batch_msg - one message of an rpmsg_send_batch() call
+ * @dst: destination address
+ * @data: payload of message
+ * @len: length of payload
+ */
+struct rpmsg_batch_msg {
+	u32 dst;
+	void *data;
+	int len;
 };
 
 /**
@@ -215,6 +292,39 @@ struct rpmsg_endpoint *rpmsg_create_ept(struct rpmsg_channel *,
 				rpmsg_rx_cb_t cb, void *priv, u32 addr);
 int
 rpmsg_send_offchannel_raw(struct rpmsg_channel *, u32, u32, void *, int, bool);
+int rpmsg_send_batch(struct rpmsg_channel *rpdev, u32 src,
+			struct rpmsg_batch_msg *msgs, int num, bool wait);
+int rpmsg_get_max_payload(struct rpmsg_channel *rpdev);
+int rpmsg_shm_register(struct rpmsg_channel *rpdev, void *va, u32 da,
+							size_t len);
+void rpmsg_shm_unregister(struct rpmsg_channel *rpdev);
+int rpmsg_send_shm_offchannel(struct rpmsg_channel *rpdev, u32 src, u32 dst,
+					u32 offset, u32 len, bool wait);
+
+/**
+ * rpmsg_send_shm() - send a message held in the channel's shared region
+ * @rpdev: the rpmsg channel
+ * @offset: offset of the message data within the registered region
+ * @len: length of the message data
+ *
+ * Like rpmsg_send(), but only a reference to @len bytes at @offset of the
+ * region registered with rpmsg_shm_register() travels through the vring,
+ * so the payload is not limited by the rpmsg buffer size and is not copied.
+ *
+ * The caller must keep the data intact until the remote side is done with
+ * it, which is a matter of the protocol running on top of the channel.
+ *
+ * Can only be called from process context (for now).
+ *
+ * Returns 0 on success and an appropriate error value on failure.
+ */
+static inline
+int rpmsg_send_shm(struct rpmsg_channel *rpdev, u32 offset, u32 len)
+{
+	u32 src = rpdev->src, dst = rpdev->dst;
+
+	return rpmsg_send_shm_offchannel(rpdev, src, dst, offset, len, true);
+}
 
 /**
  * rpmsg_send() - send a message across to the remote processor
@@ -0,0 +1,79 @@
+/*
+ * Remote processor performance counters over rpmsg
+ *
+ * Copyright (C) 2012 Texas Instruments, Inc.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _LINUX_RPMSG_PERF_H
+#define _LINUX_RPMSG_PERF_H
+
+#include <linux/types.h>
+#include <linux/errno.h>
+
+#define RPMSG_PERF_VERSION	1
+#define RPMSG_PERF_NAME_LEN	16
+#define RPMSG_PERF_MAX_TASKS	8
+
+/**
+ * struct rpmsg_perf_ctrl - sent by the host when the channel shows up
+ * @version:	RPMSG_PERF_VERSION
+ * @period_ms:	requested push period, 0 stops the reports
+ */
+struct rpmsg_perf_ctrl {
+	u32 version;
+	u32 period_ms;
+} __packed;
+
+/**
+ * struct rpmsg_perf_task - cycles spent by one remote task
+ * @name:	task name, not necessarily NUL terminated
+ * @cycles:	cycles consumed during the period
+ */
+struct rpmsg_perf_task {
+	char name[RPMSG_PERF_NAME_LEN];
+	u32 cycles;
+} __packed;
+
+/**
+ * struct rpmsg_perf_msg - periodic report pushed by the remote processor
+ * @version:	RPMSG_PERF_VERSION
+ * @seq:	report number, gaps tell the host about lost reports
+ * @period_us:	length of the period covered by this report
+ * @load:	cpu load during the period, in per-mille
+ * @cycles:	total cycles counted during the period
+ * @icache_miss: instruction cache misses during the period
+ * @dcache_miss: data cache misses during the period
+ * @num_tasks:	number of entries in @tasks
+ * @tasks:	per-task cycles, the busiest ones first
+ */
+struct rpmsg_perf_msg {
+	u32 version;
+	u32 seq;
+	u32 period_us;
+	u32 load;
+	u32 cycles;
+	u32 icache_miss;
+	u32 dcache_miss;
+	u32 num_tasks;
+	struct rpmsg_perf_task tasks[0];
+} __packed;
+
+#if defined(CONFIG_RPMSG_PERF) || defined(CONFIG_RPMSG_PERF_MODULE)
+int rpmsg_perf_get_load(const char *name, unsigned int window);
+#else
+static inline int rpmsg_perf_get_load(const char *name, unsigned int window)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* _LINUX_RPMSG_PERF_H */
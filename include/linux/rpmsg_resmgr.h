@@ -33,6 +33,10 @@
 #ifndef _LINUX_RPMSG_RESMGR_H
 #define _LINUX_RPMSG_RESMGR_H
 
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+
 /*
  * enum rprm_action - RPMSG resource manager actions
  * @RPRM_CONNECT:	RESMGR channel creation.
@@ -196,6 +200,52 @@ struct rprm_ack {
 	char data[];
 } __packed;
 
+/**
+ * struct rprm_qos_req - one requester's contribution to a shared constraint
+ * @node:	link into the aggregator's request list
+ * @val:	value requested, only meaningful while @node is linked
+ */
+struct rprm_qos_req {
+	struct list_head node;
+	long val;
+};
+
+/**
+ * struct rprm_qos - aggregated constraint of one type on a shared target
+ * @reqs:	active requests
+ * @lock:	protects @reqs and @applied
+ * @type:	constraint type, decides the default and which value is tighter
+ * @dflt:	value applied when nobody asks for anything
+ * @applied:	value last programmed through @apply
+ * @relax:	deferred application of a looser value
+ * @apply:	callback programming the effective value into the hardware
+ * @data:	private data of @apply
+ *
+ * Frequency and bandwidth requests aggregate to their maximum, latency
+ * requests to their minimum. A tighter effective value is applied at once,
+ * a looser one only after it has been stable for the relax delay, so a
+ * requester toggling its constraint does not bounce the target.
+ */
+struct rprm_qos {
+	struct list_head reqs;
+	struct mutex lock;
+	enum rprm_constraint_type type;
+	long dflt;
+	long applied;
+	struct delayed_work relax;
+	int (*apply)(struct rprm_qos *qos, long val);
+	void *data;
+};
+
+static inline void rprm_qos_req_init(struct rprm_qos_req *req)
+{
+	INIT_LIST_HEAD(&req->node);
+}
+
 int rprm_resource_register(struct rprm_res *res);
 int rprm_resource_unregister(struct rprm_res *res);
+void rprm_qos_init(struct rprm_qos *qos, enum rprm_constraint_type type,
+		   int (*apply)(struct rprm_qos *qos, long val), void *data);
+int rprm_qos_update(struct rprm_qos *qos, struct rprm_qos_req *req, long val);
+void rprm_qos_exit(struct rprm_qos *qos);
 #endif /* _LINUX_RPMSG_RESMGR_H */
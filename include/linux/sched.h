@@ -1186,11 +1186,17 @@ struct sched_statistics {
 	u64			exec_max;
 	u64			slice_max;
 
+	u64			wakeup_start;
+	u64			wakeup_lat_max;
+	u64			wakeup_lat_count;
+	u64			wakeup_lat_sum;
+
 	u64			nr_migrations_cold;
 	u64			nr_failed_migrations_affine;
 	u64			nr_failed_migrations_running;
 	u64			nr_failed_migrations_hot;
 	u64			nr_forced_migrations;
+	u64			nr_failed_migrations_packed;
 
 	u64			nr_wakeups;
 	u64			nr_wakeups_sync;
@@ -1201,6 +1207,7 @@ struct sched_statistics {
 	u64			nr_wakeups_affine_attempts;
 	u64			nr_wakeups_passive;
 	u64			nr_wakeups_idle;
+	u64			nr_wakeups_packed;
 };
 #endif
 
@@ -2133,6 +2140,16 @@ extern int sched_setscheduler(struct task_struct *, int,
 extern int sched_setscheduler_nocheck(struct task_struct *, int,
 				      const struct sched_param *);
 extern struct task_struct *idle_task(int cpu);
+
+/*
+ * Called by CFS with the runqueue locked and interrupts off each time a
+ * task wakes up on @cpu, with the number of tasks then runnable there.
+ * Lets a cpufreq governor react to load before its next sample; the hook
+ * must not take the runqueue lock, i.e. it can't wake up tasks directly.
+ */
+typedef void (*sched_wakeup_hook_t)(int cpu, unsigned int nr_running);
+extern void sched_set_wakeup_hook(sched_wakeup_hook_t hook);
+
 /**
  * is_idle_task - is the specified task an idle task?
  * @p: the task in question.
@@ -158,6 +158,11 @@ struct usb_ep_ops {
  *	enabled and remains valid until the endpoint is disabled.
  * @comp_desc: In case of SuperSpeed support, this is the endpoint companion
  *	descriptor that is used to configure the endpoint
+ * @complete_batch: optionally set by the gadget driver.  Controllers that
+ *	report batched_completion call it from their interrupt handler once
+ *	they are done giving back a run of requests on this endpoint, so
+ *	work common to those requests can be done once; each request still
+ *	gets its own complete() call first.
  *
  * the bus controller driver lists all the general purpose endpoints in
  * gadget->ep_list.  the control endpoint (gadget->ep0) is not in that list,
@@ -176,6 +181,7 @@ struct usb_ep {
 	u8			address;
 	const struct usb_endpoint_descriptor	*desc;
 	const struct usb_ss_ep_comp_descriptor	*comp_desc;
+	void			(*complete_batch)(struct usb_ep *ep);
 };
 
 /*-------------------------------------------------------------------------*/
@@ -489,6 +495,7 @@ struct usb_gadget_ops {
  * @max_speed: Maximal speed the UDC can handle.  UDC must support this
  *      and all slower speeds.
  * @sg_supported: true if we can handle scatter-gather
+ * @batched_completion: true if we call usb_ep.complete_batch
  * @is_otg: True if the USB device port uses a Mini-AB jack, so that the
  *	gadget driver must provide a USB OTG descriptor.
  * @is_a_peripheral: False unless is_otg, the "A" end of a USB cable
@@ -530,6 +537,7 @@ struct usb_gadget {
 	enum usb_device_speed		speed;
 	enum usb_device_speed		max_speed;
 	unsigned			sg_supported:1;
+	unsigned			batched_completion:1;
 	unsigned			is_otg:1;
 	unsigned			is_a_peripheral:1;
 	unsigned			b_hnp_enable:1;
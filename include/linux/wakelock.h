@@ -18,6 +18,7 @@
 
 #include <linux/list.h>
 #include <linux/ktime.h>
+#include <linux/types.h>
 
 /* A wake_lock prevents the system from entering suspend or other low power
  * states when active. If the type is set to WAKE_LOCK_SUSPEND, the wake_lock
@@ -52,6 +53,35 @@ struct wake_lock {
 #endif
 };
 
+/* /proc/wakelocks_bin: one header, then header.num_entries entries */
+#define WAKELOCK_STATS_VERSION		1
+#define WAKELOCK_STATS_NAME_LEN		32
+
+struct wakelock_stats_header {
+	__u32	version;
+	__u32	entry_size;
+	__u32	num_entries;
+	__u32	reserved;
+	__u64	lock_calls;	/* wake_lock() and wake_lock_timeout() */
+	__u64	unlock_calls;
+	__u64	fast_calls;	/* completed without taking the list lock */
+	__u64	contended;	/* list lock was busy on the first try */
+	__u64	contended_ns;	/* time spent waiting for it */
+};
+
+struct wakelock_stats_entry {
+	char	name[WAKELOCK_STATS_NAME_LEN];
+	__u32	count;
+	__u32	expire_count;
+	__u32	wakeup_count;
+	__u32	active;
+	__s64	active_since_ns;
+	__s64	total_time_ns;
+	__s64	sleep_time_ns;
+	__s64	max_time_ns;
+	__s64	last_change_ns;
+};
+
 #ifdef CONFIG_HAS_WAKELOCK
 
 void wake_lock_init(struct wake_lock *lock, int type, const char *name);
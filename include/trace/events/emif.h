@@ -0,0 +1,43 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM emif
+
+#if !defined(_TRACE_EMIF_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_EMIF_H
+
+#include <linux/tracepoint.h>
+
+struct device;
+
+/*
+ * Bandwidth measured by an EMIF over the last sampling window: all
+ * accesses, plus the class performance counter 2 was set to count.
+ */
+TRACE_EVENT(emif_bandwidth,
+
+	TP_PROTO(struct device *dev, unsigned long total, const char *class,
+		 unsigned long bw),
+
+	TP_ARGS(dev, total, class, bw),
+
+	TP_STRUCT__entry(
+		__string(	name,		dev_name(dev)	)
+		__field(	unsigned long,	total		)
+		__string(	class,		class		)
+		__field(	unsigned long,	bw		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, dev_name(dev));
+		__entry->total = total;
+		__assign_str(class, class);
+		__entry->bw = bw;
+	),
+
+	TP_printk("%s total=%lu B/s %s=%lu B/s", __get_str(name),
+		  __entry->total, __get_str(class), __entry->bw)
+);
+
+#endif /* _TRACE_EMIF_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
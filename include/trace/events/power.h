@@ -254,6 +254,45 @@ DEFINE_EVENT(power_domain, power_domain_target,
 
 	TP_ARGS(name, state, cpu_id)
 );
+
+/*
+ * The hwmod events report how long an OMAP IP block took to enable or idle
+ */
+DECLARE_EVENT_CLASS(hwmod,
+
+	TP_PROTO(const char *name, unsigned int latency_us, int ret),
+
+	TP_ARGS(name, latency_us, ret),
+
+	TP_STRUCT__entry(
+		__string(       name,           name            )
+		__field(        u32,            latency_us      )
+		__field(        int,            ret             )
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->latency_us = latency_us;
+		__entry->ret = ret;
+	),
+
+	TP_printk("%s latency_us=%u ret=%d", __get_str(name),
+		__entry->latency_us, __entry->ret)
+);
+
+DEFINE_EVENT(hwmod, hwmod_enable,
+
+	TP_PROTO(const char *name, unsigned int latency_us, int ret),
+
+	TP_ARGS(name, latency_us, ret)
+);
+
+DEFINE_EVENT(hwmod, hwmod_idle,
+
+	TP_PROTO(const char *name, unsigned int latency_us, int ret),
+
+	TP_ARGS(name, latency_us, ret)
+);
 #endif /* _TRACE_POWER_H */
 
 /* This part must be outside protection */
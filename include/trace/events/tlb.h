@@ -0,0 +1,51 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM tlb
+
+#if !defined(_TRACE_TLB_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_TLB_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(tlb_flush_range_template,
+
+	TP_PROTO(unsigned long start, unsigned long end),
+
+	TP_ARGS(start, end),
+
+	TP_STRUCT__entry(
+		__field(unsigned long, start)
+		__field(unsigned long, pages)
+	),
+
+	TP_fast_assign(
+		__entry->start = start;
+		__entry->pages = (PAGE_ALIGN(end) - (start & PAGE_MASK)) >>
+				 PAGE_SHIFT;
+	),
+
+	TP_printk("start=%08lx pages=%lu",
+		__entry->start,
+		__entry->pages)
+);
+
+/* user range invalidated in the address space of one mm */
+DEFINE_EVENT(tlb_flush_range_template, tlb_flush_user_range,
+
+	TP_PROTO(unsigned long start, unsigned long end),
+
+	TP_ARGS(start, end)
+);
+
+/* kernel range (vmalloc, kmap, ...) invalidated on all cpus */
+DEFINE_EVENT(tlb_flush_range_template, tlb_flush_kernel_range,
+
+	TP_PROTO(unsigned long start, unsigned long end),
+
+	TP_ARGS(start, end)
+);
+
+#endif /* _TRACE_TLB_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
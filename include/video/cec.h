@@ -53,6 +53,31 @@ struct cec_rx_data {
 	char   rx_operand[15];
 };
 
+/*
+ * Frames queued with CEC_QUEUE_TX are sent in order while the caller goes
+ * on, each one completes with a CEC_EVENT_TX_DONE read() from the file that
+ * queued it.  @id is filled in by the driver and comes back in the event.
+ */
+struct cec_tx_req {
+	struct cec_tx_data data;
+	unsigned int id;
+};
+
+#define CEC_EVENT_TX_DONE	1
+#define CEC_EVENT_RX		2
+
+/*
+ * Read from the cec device, poll() tells when one is pending.  For
+ * CEC_EVENT_TX_DONE, @status is 1 if the frame was acked, 0 if it was
+ * nacked or a negative error; for CEC_EVENT_RX, @rx holds the frame.
+ */
+struct cec_event {
+	int type;
+	unsigned int id;
+	int status;
+	struct cec_rx_data rx;
+};
+
 #ifdef __KERNEL__
 int cec_read_rx_cmd(struct cec_rx_data *rx_data);
 int cec_transmit_cmd(struct cec_tx_data *data, int *cmd_acked);
@@ -228,5 +253,8 @@ enum cec_ui_command {
 #define CEC_RECV_CMD  _IOWR(CEC_IOCTL_MAGIC, 2, \
 				struct cec_rx_data)
 #define CEC_GET_PHY_ADDR _IOR(CEC_IOCTL_MAGIC, 3, int)
+#define CEC_QUEUE_TX	_IOWR(CEC_IOCTL_MAGIC, 4, struct cec_tx_req)
+/* non zero makes received frames CEC_EVENT_RX events of this file */
+#define CEC_RX_EVENTS	_IOW(CEC_IOCTL_MAGIC, 5, int)
 
 #endif /* _CEC_H_ */
@@ -589,11 +589,69 @@ struct dsscomp_setup_dispc_data {
 	struct dss2_ovl_info ovls[5]; /* up to 5 overlays to set up */
 };
 
+/*
+ * ioctl: DSSCIOC_SETUP_DISPC_FENCE, struct dsscomp_setup_dispc_fence_data
+ *
+ * Same as DSSCIOC_SETUP_DISPC, but the flip is queued without waiting
+ * for the buffers to be ready.  Set acquire_fence[i] to a sync fence fd
+ * that must signal before ovls[i] may be read, or to -1.  The fences are
+ * waited on by the driver before the composition is applied; flips are
+ * applied in the order they were queued.
+ *
+ * On return, release_fence[i] is a new fence fd for each of the num_ovls
+ * overlays that signals when the overlay's buffer is no longer used by
+ * this flip, and retire_fence is a new fence fd that signals once the
+ * flip has been displayed (or dropped).  The caller must close them.
+ *
+ * Returns 0 on success, non-0 on failure.
+ */
+struct dsscomp_setup_dispc_fence_data {
+	struct dsscomp_setup_dispc_data dispc;
+
+	__s32 acquire_fence[5];	/* in: fd per overlay, or -1 */
+	__s32 release_fence[5];	/* out: fd per overlay */
+	__s32 retire_fence;	/* out: fd for the whole flip */
+};
+
+/*
+ * ioctl: DSSCIOC_QUEUE_WB, struct dsscomp_queue_wb_data
+ *
+ * Queue a buffer for capturing the output of display mgr_ix through the
+ * writeback pipeline, e.g. for mirroring to a wireless display.  Buffers
+ * are filled in queue order, one by each following gralloc flip on the
+ * display that does not set up writeback itself.
+ *
+ * Requirements:
+ *	wb.cfg.ix must be OMAP_DSS_WB, and wb must describe the output:
+ *	color_mode, stride, win.w/win.h (output size) and rotation.
+ *	wb.ba (and wb.uv for NV12) are physical addresses of a contiguous
+ *	or TILER buffer.
+ *
+ * Set acquire_fence to a sync fence fd that must signal before the
+ * buffer may be written, or to -1.  On return release_fence is a new
+ * fence fd that signals once the frame has been captured into the buffer
+ * (or the capture was dropped).  The caller must close it.
+ *
+ * Returns 0 on success, non-0 on failure.
+ */
+struct dsscomp_queue_wb_data {
+	struct dss2_ovl_info wb;
+	__u32 mgr_ix;		/* display index (sysfs/display#) */
+	__s32 acquire_fence;	/* in: fd, or -1 */
+	__s32 release_fence;	/* out: fd */
+};
+
 /*
  * ioctl: DSSCIOC_WB_COPY, struct dsscomp_wb_copy_data
  *
+ * Fetches ovl through its (idle) pipeline and stores it into wb in one
+ * memory-to-memory writeback pass, scaling, rotating and color converting
+ * on the way.  Only one layer is read per pass; there is no blending.
+ *
  * Requirements:
  *	wb.ix must be OMAP_DSS_WB.
+ *	ovl must not be in use on a display, and ovl.win must start at 0,0.
+ *	ovl.win.w/h is the size of the pass, wb.win.w/h the stored size.
  *
  * Returns 0 on success (copy is completed), non-0 on failure.
  */
@@ -601,6 +659,27 @@ struct dsscomp_wb_copy_data {
 	struct dss2_ovl_info ovl, wb;
 };
 
+/*
+ * ioctl: DSSCIOC_SET_VSYNC, __u32 mask
+ *
+ * Selects the managers (bit n for manager n) whose vsyncs are reported on
+ * this file descriptor; 0 stops reporting.  The vsync interrupt is only
+ * enabled while some file descriptor listens to it.
+ *
+ * Each read() then returns one struct dsscomp_vsync_event for each
+ * selected manager that had a vsync since its last event was read,
+ * blocking unless O_NONBLOCK is set.  poll() reports POLLIN if an event
+ * is pending.  count increments on every vsync of the manager while it is
+ * reported to anyone, so gaps show missed frames.
+ *
+ * Returns 0 on success, non-0 error value on failure.
+ */
+struct dsscomp_vsync_event {
+	__u32 ix;		/* manager index */
+	__u32 count;		/* vsync counter */
+	__u64 timestamp;	/* CLOCK_MONOTONIC time of the vsync in ns */
+};
+
 /*
  * ioctl: DSSCIOC_QUERY_DISPLAY, struct dsscomp_display_info
  *
@@ -728,4 +807,8 @@ struct dsscomp_platform_info {
 #define DSSCIOC_SETUP_DISPLAY	\
 			_IOW('O', 134, struct dsscomp_setup_display_data)
 #define DSSCIOC_QUERY_PLATFORM	_IOR('O', 135, struct dsscomp_platform_info)
+#define DSSCIOC_SETUP_DISPC_FENCE \
+		_IOWR('O', 136, struct dsscomp_setup_dispc_fence_data)
+#define DSSCIOC_QUEUE_WB	_IOWR('O', 137, struct dsscomp_queue_wb_data)
+#define DSSCIOC_SET_VSYNC	_IOW('O', 138, __u32)
 #endif
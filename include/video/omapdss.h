@@ -54,6 +54,8 @@
 
 struct omap_dss_device;
 struct omap_overlay_manager;
+struct omap_overlay;
+struct omap_overlay_info;
 
 enum omap_display_type {
 	OMAP_DISPLAY_TYPE_NONE		= 0,
@@ -154,6 +156,11 @@ enum omap_dss_dsi_mode {
 enum omap_display_caps {
 	OMAP_DSS_DISPLAY_CAP_MANUAL_UPDATE	= 1 << 0,
 	OMAP_DSS_DISPLAY_CAP_TEAR_ELIM		= 1 << 1,
+	/*
+	 * driver->update() sends only the given rectangle, with the overlays
+	 * positioned relative to its top-left corner by the caller
+	 */
+	OMAP_DSS_DISPLAY_CAP_PARTIAL_UPDATE	= 1 << 2,
 };
 
 enum omap_dss_display_state {
@@ -494,6 +501,10 @@ struct omap_writeback {
 			struct omap_writeback_info *info);
 	void (*get_wb_info)(struct omap_writeback *wb,
 			struct omap_writeback_info *info);
+	/* one memory-to-memory pass from an unused overlay, blocks */
+	int (*m2m)(struct omap_writeback *wb, struct omap_overlay *ovl,
+			struct omap_overlay_info *info,
+			struct omap_writeback_info *wb_info);
 };
 
 
@@ -889,6 +900,8 @@ void omapdss_dsi_vc_enable_hs(struct omap_dss_device *dssdev, int channel,
 		bool enable);
 int omapdss_dsi_enable_te(struct omap_dss_device *dssdev, bool enable);
 
+int omap_dsi_prepare_update(struct omap_dss_device *dssdev,
+		u16 *x, u16 *y, u16 *w, u16 *h);
 int omap_dsi_update(struct omap_dss_device *dssdev, int channel,
 		void (*callback)(int, void *), void *data);
 int omap_dsi_request_vc(struct omap_dss_device *dssdev, int *channel);
@@ -925,6 +938,14 @@ int dispc_scaling_decision(enum omap_plane plane, struct omap_overlay_info *oi,
 int omap_dss_manager_unregister_callback(struct omap_overlay_manager *mgr,
 					 struct omapdss_ovl_cb *cb);
 
+/* errors DISPC has seen and recovered from since boot */
+struct omapdss_error_counts {
+	u32 underflows;		/* FIFO underflows of any overlay */
+	u32 sync_lost;		/* sync lost on any manager */
+};
+
+void omap_dss_get_error_counts(struct omapdss_error_counts *c);
+
 /* generic callback handling */
 static inline void dss_ovl_cb(struct omapdss_ovl_cb *cb, int id, int status)
 {
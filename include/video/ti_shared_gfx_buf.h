@@ -19,6 +19,7 @@
 #define _LINUX_TI_SHARED_GFX_BUF_H_
 
 #define TI_MAX_SUB_ALLOCS 4
+#define TI_GFX_BUF_MAX_BULK 32
 
 #define TI_DMM_2D_STRIDE_BYTES_ALIGN	 4096  /* Bytes */
 #define TI_DMM_1D_STRIDE_BYTES_ALIGN	  128  /* Bytes */
@@ -167,6 +168,23 @@ typedef struct ti_gfx_buf_req {
         ti_gfx_buf_plane_req_t planes[TI_MAX_SUB_ALLOCS];
 } ti_gfx_buf_req_t;
 
+/**
+ * ti_gfx_buf_bulk_req_t - allocation request for several identical buffers
+ *
+ * IN parameters:
+ * @num_bufs - number of buffers to allocate, up to TI_GFX_BUF_MAX_BULK
+ * @req - geometry shared by all the buffers, as for a single allocation
+ * @bufs - user pointer to an array of @num_bufs ti_gfx_buf_req_t
+ *
+ * OUT parameters:
+ * @bufs - name, sync_fd and planes of each allocated buffer
+ */
+typedef struct ti_gfx_buf_bulk_req {
+        __u32 num_bufs;
+        ti_gfx_buf_req_t req;
+        __u64 bufs;
+} ti_gfx_buf_bulk_req_t;
+
 /**
  * ti_gfx_buf_info_t - buffer info request
  *
@@ -211,6 +229,15 @@ typedef struct ti_gfx_buf_info {
  */
 #define TI_GFX_BUF_IOC_SYNC            _IOW(TI_GFX_BUF_IOC_MAGIC, 0, __s32)
 
+/**
+ * DOC: TI_GFX_BUF_IOC_ALLOC_BUFS - allocate several gfx_bufs at once
+ *
+ * Takes a ti_gfx_buf_bulk_req_t and allocates num_bufs buffers with the
+ * geometry of req.  Either all the buffers are allocated or none is.
+ */
+#define TI_GFX_BUF_IOC_ALLOC_BUFS      _IOWR(TI_GFX_BUF_IOC_MAGIC, 1, \
+        ti_gfx_buf_bulk_req_t)
+
 #ifdef __KERNEL__
 
 /**
@@ -278,6 +305,16 @@ static inline void ti_gfx_buf_waiter_init(struct ti_gfx_buf_waiter *waiter,
  */
 int ti_gfx_buf_create(void* buf_mgr_cxt, ti_gfx_buf_req_t* req_buf);
 
+/**
+ * ti_gfx_buf_create_bulk() - creates several identical omap graphics buffers
+ * @buf_mgr_cxt - context of the buffer manager to allocate from.
+ * @req_buf:	requested information shared by all the gfx buffers.
+ * @bufs:	array of @num_bufs, filled in with each created gfx buffer.
+ * @num_bufs:	number of gfx buffers to create.
+ */
+int ti_gfx_buf_create_bulk(void* buf_mgr_cxt, ti_gfx_buf_req_t* req_buf,
+                           ti_gfx_buf_req_t* bufs, unsigned int num_bufs);
+
 
 /**
  * ti_gfx_buf_fdget() - get a gfx buffer from an fd
@@ -13,10 +13,13 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/hrtimer.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -31,6 +34,10 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* Run the handlers of one level concurrently, levels stay ordered */
+static bool parallel = true;
+module_param(parallel, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
 static void early_suspend(struct work_struct *work);
@@ -45,6 +52,58 @@ enum {
 };
 static int state;
 
+static struct workqueue_struct *early_suspend_wq;
+static bool resuming;	/* direction of the current pass, early_suspend_lock */
+
+static void early_suspend_call(struct early_suspend *h)
+{
+	void (*fn)(struct early_suspend *h) = resuming ? h->resume : h->suspend;
+	ktime_t start = ktime_get();
+	u32 usecs;
+
+	fn(h);
+
+	usecs = ktime_us_delta(ktime_get(), start);
+	if (resuming)
+		h->resume_us = usecs;
+	else
+		h->suspend_us = usecs;
+	if (debug_mask & DEBUG_VERBOSE)
+		pr_info("%s: %pf took %u usecs\n",
+			resuming ? "late_resume" : "early_suspend", fn, usecs);
+}
+
+static void early_suspend_work_fn(struct work_struct *work)
+{
+	early_suspend_call(container_of(work, struct early_suspend, work));
+}
+
+/*
+ * Start @h, after waiting for the previous level to finish if @h opens a new
+ * one.  The caller flushes the last level.
+ */
+static void early_suspend_run(struct early_suspend *h, int *level)
+{
+	if (!(resuming ? h->resume : h->suspend))
+		return;
+
+	if (h->level != *level) {
+		if (early_suspend_wq)
+			flush_workqueue(early_suspend_wq);
+		*level = h->level;
+	}
+
+	if (debug_mask & DEBUG_VERBOSE)
+		pr_info("%s: calling %pf\n",
+			resuming ? "late_resume" : "early_suspend",
+			resuming ? h->resume : h->suspend);
+
+	if (parallel && early_suspend_wq)
+		queue_work(early_suspend_wq, &h->work);
+	else
+		early_suspend_call(h);
+}
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
@@ -56,6 +115,7 @@ void register_early_suspend(struct early_suspend *handler)
 		if (e->level > handler->level)
 			break;
 	}
+	INIT_WORK(&handler->work, early_suspend_work_fn);
 	list_add_tail(&handler->link, pos);
 	if ((state & SUSPENDED) && handler->suspend)
 		handler->suspend(handler);
@@ -76,6 +136,7 @@ static void early_suspend(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -94,13 +155,11 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
-	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("early_suspend: calling %pf\n", pos->suspend);
-			pos->suspend(pos);
-		}
-	}
+	resuming = false;
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		early_suspend_run(pos, &level);
+	if (early_suspend_wq)
+		flush_workqueue(early_suspend_wq);
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
@@ -119,6 +178,7 @@ static void late_resume(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -135,14 +195,11 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
-		if (pos->resume != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("late_resume: calling %pf\n", pos->resume);
-
-			pos->resume(pos);
-		}
-	}
+	resuming = true;
+	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
+		early_suspend_run(pos, &level);
+	if (early_suspend_wq)
+		flush_workqueue(early_suspend_wq);
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 abort:
@@ -185,3 +242,48 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_stats_show(struct seq_file *s, void *unused)
+{
+	struct early_suspend *pos;
+
+	seq_printf(s, "%5s %10s %10s  handler\n", "level", "suspend",
+		   "resume");
+	mutex_lock(&early_suspend_lock);
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(s, "%5d %10u %10u  %pf\n", pos->level,
+			   pos->suspend_us, pos->resume_us,
+			   pos->suspend ?: pos->resume);
+	mutex_unlock(&early_suspend_lock);
+
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, NULL);
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.open = early_suspend_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
+static int __init early_suspend_init(void)
+{
+	/* without it the handlers simply run one after the other */
+	early_suspend_wq = alloc_workqueue("early_suspend", WQ_UNBOUND, 0);
+	if (!early_suspend_wq)
+		pr_err("early_suspend: no workqueue, handlers run serially\n");
+
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("early_suspend", S_IRUGO, NULL, NULL,
+			    &early_suspend_stats_fops);
+#endif
+	return 0;
+}
+core_initcall(early_suspend_init);
@@ -21,6 +21,8 @@
 #include <linux/wakelock.h>
 #ifdef CONFIG_WAKELOCK_STAT
 #include <linux/proc_fs.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
 #endif
 #include "power.h"
 
@@ -60,6 +62,37 @@ static struct wake_lock deleted_wake_locks;
 static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
 
+/*
+ * Global call counters.  These are bumped on every lock/unlock, so they are
+ * kept per cpu and only summed when somebody reads the stats.
+ */
+struct wakelock_cpu_stats {
+	u64 lock_calls;
+	u64 unlock_calls;
+	u64 fast_calls;
+	u64 contended;
+	u64 contended_ns;
+};
+static DEFINE_PER_CPU(struct wakelock_cpu_stats, wakelock_cpu_stats);
+
+#define wakelock_stat_inc(field) this_cpu_inc(wakelock_cpu_stats.field)
+
+static void wakelock_stats_sum(struct wakelock_stats_header *h)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct wakelock_cpu_stats *st = &per_cpu(wakelock_cpu_stats,
+							 cpu);
+
+		h->lock_calls += st->lock_calls;
+		h->unlock_calls += st->unlock_calls;
+		h->fast_calls += st->fast_calls;
+		h->contended += st->contended;
+		h->contended_ns += st->contended_ns;
+	}
+}
+
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 {
 	struct timespec ts;
@@ -83,7 +116,9 @@ int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 }
 
 
-static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
+/* Caller must acquire the list_lock spinlock */
+static void wake_lock_stat_snapshot(struct wake_lock *lock,
+				    struct wakelock_stats_entry *e)
 {
 	int lock_count = lock->stat.count;
 	int expire_count = lock->stat.expire_count;
@@ -111,13 +146,28 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 			max_time = add_time;
 	}
 
+	strlcpy(e->name, lock->name, sizeof(e->name));
+	e->count = lock_count;
+	e->expire_count = expire_count;
+	e->wakeup_count = lock->stat.wakeup_count;
+	e->active = !!(lock->flags & WAKE_LOCK_ACTIVE);
+	e->active_since_ns = ktime_to_ns(active_time);
+	e->total_time_ns = ktime_to_ns(total_time);
+	e->sleep_time_ns = ktime_to_ns(prevent_suspend_time);
+	e->max_time_ns = ktime_to_ns(max_time);
+	e->last_change_ns = ktime_to_ns(lock->stat.last_time);
+}
+
+static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
+{
+	struct wakelock_stats_entry e;
+
+	wake_lock_stat_snapshot(lock, &e);
 	return seq_printf(m,
 		     "\"%s\"\t%d\t%d\t%d\t%lld\t%lld\t%lld\t%lld\t%lld\n",
-		     lock->name, lock_count, expire_count,
-		     lock->stat.wakeup_count, ktime_to_ns(active_time),
-		     ktime_to_ns(total_time),
-		     ktime_to_ns(prevent_suspend_time), ktime_to_ns(max_time),
-		     ktime_to_ns(lock->stat.last_time));
+		     lock->name, e.count, e.expire_count, e.wakeup_count,
+		     e.active_since_ns, e.total_time_ns, e.sleep_time_ns,
+		     e.max_time_ns, e.last_change_ns);
 }
 
 static int wakelock_stats_show(struct seq_file *m, void *unused)
@@ -141,6 +191,50 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+/*
+ * Same data as /proc/wakelocks in fixed size records, for collectors that
+ * poll often and do not want to parse text.  The entries are built under
+ * list_lock in a private buffer, and copied out once it is dropped.
+ */
+static int wakelock_stats_bin_show(struct seq_file *m, void *unused)
+{
+	struct wakelock_stats_header h = {
+		.version = WAKELOCK_STATS_VERSION,
+		.entry_size = sizeof(struct wakelock_stats_entry),
+	};
+	struct wakelock_stats_entry *e;
+	struct wake_lock *lock;
+	unsigned long irqflags;
+	unsigned int n, max;
+	int type;
+
+	wakelock_stats_sum(&h);
+
+	/* one more than fits, so a full table overflows and seq_read retries */
+	max = (m->size - sizeof(h)) / sizeof(*e) + 1;
+	e = kmalloc(max * sizeof(*e), GFP_KERNEL);
+	if (!e)
+		return -ENOMEM;
+
+	n = 0;
+	spin_lock_irqsave(&list_lock, irqflags);
+	list_for_each_entry(lock, &inactive_locks, link)
+		if (n < max)
+			wake_lock_stat_snapshot(lock, &e[n++]);
+	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++)
+		list_for_each_entry(lock, &active_wake_locks[type], link)
+			if (n < max)
+				wake_lock_stat_snapshot(lock, &e[n++]);
+	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	h.num_entries = n;
+	seq_write(m, &h, sizeof(h));
+	seq_write(m, e, n * sizeof(*e));
+	kfree(e);
+
+	return 0;
+}
+
 static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 {
 	ktime_t duration;
@@ -192,6 +286,21 @@ static void update_sleep_wait_stats_locked(int done)
 	}
 	last_sleep_time_update = now;
 }
+
+#define list_lock_irqsave(flags)					\
+	do {								\
+		if (!spin_trylock_irqsave(&list_lock, flags)) {		\
+			ktime_t __start = ktime_get();			\
+			spin_lock_irqsave(&list_lock, flags);		\
+			__this_cpu_inc(wakelock_cpu_stats.contended);	\
+			__this_cpu_add(wakelock_cpu_stats.contended_ns,	\
+				ktime_to_ns(ktime_sub(ktime_get(),	\
+						      __start)));	\
+		}							\
+	} while (0)
+#else
+#define wakelock_stat_inc(field) do { } while (0)
+#define list_lock_irqsave(flags) spin_lock_irqsave(&list_lock, flags)
 #endif
 
 
@@ -419,7 +528,23 @@ static void wake_lock_internal(
 	unsigned long irqflags;
 	long expire_in;
 
-	spin_lock_irqsave(&list_lock, irqflags);
+	wakelock_stat_inc(lock_calls);
+
+	/*
+	 * Re-locking a lock that is already held without a timeout changes
+	 * nothing: it is on its active list ahead of every expiring lock, and
+	 * the expire timer was stopped when it was first taken.  A racing
+	 * wake_unlock() makes this look like lock, then unlock.
+	 */
+	if (!has_timeout &&
+	    (ACCESS_ONCE(lock->flags) & (WAKE_LOCK_ACTIVE |
+					 WAKE_LOCK_AUTO_EXPIRE)) ==
+	    WAKE_LOCK_ACTIVE) {
+		wakelock_stat_inc(fast_calls);
+		return;
+	}
+
+	list_lock_irqsave(irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
@@ -503,7 +628,16 @@ void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
+
+	wakelock_stat_inc(unlock_calls);
+
+	/* Nothing to undo, and the suspend check already ran at its unlock */
+	if (!(ACCESS_ONCE(lock->flags) & WAKE_LOCK_ACTIVE)) {
+		wakelock_stat_inc(fast_calls);
+		return;
+	}
+
+	list_lock_irqsave(irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_unlock_stat_locked(lock, 0);
@@ -559,6 +693,19 @@ static const struct file_operations wakelock_stats_fops = {
 	.release = single_release,
 };
 
+static int wakelock_stats_bin_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakelock_stats_bin_show, NULL);
+}
+
+static const struct file_operations wakelock_stats_bin_fops = {
+	.owner = THIS_MODULE,
+	.open = wakelock_stats_bin_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __init wakelocks_init(void)
 {
 	int ret;
@@ -596,6 +743,7 @@ static int __init wakelocks_init(void)
 
 #ifdef CONFIG_WAKELOCK_STAT
 	proc_create("wakelocks", S_IRUGO, NULL, &wakelock_stats_fops);
+	proc_create("wakelocks_bin", S_IRUGO, NULL, &wakelock_stats_bin_fops);
 #endif
 
 	return 0;
@@ -617,6 +765,7 @@ err_platform_device_register:
 static void  __exit wakelocks_exit(void)
 {
 #ifdef CONFIG_WAKELOCK_STAT
+	remove_proc_entry("wakelocks_bin", NULL);
 	remove_proc_entry("wakelocks", NULL);
 #endif
 	destroy_workqueue(suspend_work_queue);
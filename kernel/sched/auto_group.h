@@ -54,7 +54,7 @@ autogroup_task_group(struct task_struct *p, struct task_group *tg)
 	return tg;
 }
 
-#ifdef CONFIG_SCHED_DEBUG
+#if defined(CONFIG_SCHED_DEBUG) || defined(CONFIG_SCHEDSTATS)
 static inline int autogroup_path(struct task_group *tg, char *buf, int buflen)
 {
 	return 0;
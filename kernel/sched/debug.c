@@ -437,6 +437,9 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	PN(se.statistics.wait_max);
 	PN(se.statistics.wait_sum);
 	P(se.statistics.wait_count);
+	PN(se.statistics.wakeup_lat_max);
+	PN(se.statistics.wakeup_lat_sum);
+	P(se.statistics.wakeup_lat_count);
 	PN(se.statistics.iowait_sum);
 	P(se.statistics.iowait_count);
 	P(se.nr_migrations);
@@ -445,6 +448,7 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.statistics.nr_failed_migrations_running);
 	P(se.statistics.nr_failed_migrations_hot);
 	P(se.statistics.nr_forced_migrations);
+	P(se.statistics.nr_failed_migrations_packed);
 	P(se.statistics.nr_wakeups);
 	P(se.statistics.nr_wakeups_sync);
 	P(se.statistics.nr_wakeups_migrate);
@@ -454,6 +458,7 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.statistics.nr_wakeups_affine_attempts);
 	P(se.statistics.nr_wakeups_passive);
 	P(se.statistics.nr_wakeups_idle);
+	P(se.statistics.nr_wakeups_packed);
 
 	{
 		u64 avg_atom, avg_per_cpu;
@@ -26,6 +26,8 @@
 #include <linux/slab.h>
 #include <linux/profile.h>
 #include <linux/interrupt.h>
+#include <linux/export.h>
+#include <linux/cpuidle.h>
 
 #include <trace/events/sched.h>
 
@@ -749,6 +751,20 @@ update_stats_wait_end(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	schedstat_set(se->statistics.wait_start, 0);
 }
 
+/*
+ * Time from a wakeup enqueue until the entity first gets the cpu; unlike
+ * wait_* this leaves out the waits after preemption.
+ */
+static inline void
+update_stats_wakeup_end(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+#ifdef CONFIG_SCHEDSTATS
+	sched_stat_wakeup_end(&se->statistics,
+			      entity_is_task(se) ? &cfs_rq->wakeup_lat : NULL,
+			      rq_of(cfs_rq)->clock);
+#endif
+}
+
 static inline void
 update_stats_dequeue(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
@@ -1103,6 +1119,7 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	if (flags & ENQUEUE_WAKEUP) {
 		place_entity(cfs_rq, se, 0);
 		enqueue_sleeper(cfs_rq, se);
+		schedstat_set(se->statistics.wakeup_start, rq_of(cfs_rq)->clock);
 	}
 
 	update_stats_enqueue(cfs_rq, se);
@@ -1263,6 +1280,7 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		__dequeue_entity(cfs_rq, se);
 	}
 
+	update_stats_wakeup_end(cfs_rq, se);
 	update_stats_curr_start(cfs_rq, se);
 	cfs_rq->curr = se;
 #ifdef CONFIG_SCHEDSTATS
@@ -2170,6 +2188,24 @@ static inline void hrtick_update(struct rq *rq)
 }
 #endif
 
+static sched_wakeup_hook_t sched_wakeup_hook __read_mostly;
+
+void sched_set_wakeup_hook(sched_wakeup_hook_t hook)
+{
+	rcu_assign_pointer(sched_wakeup_hook, hook);
+	/* make sure no runqueue is still calling the old hook */
+	synchronize_sched();
+}
+EXPORT_SYMBOL_GPL(sched_set_wakeup_hook);
+
+static inline void sched_wakeup_notify(struct rq *rq)
+{
+	sched_wakeup_hook_t hook = rcu_dereference_sched(sched_wakeup_hook);
+
+	if (hook)
+		hook(cpu_of(rq), rq->nr_running);
+}
+
 /*
  * The enqueue_task method is called before nr_running is
  * increased. Here we update the fair scheduling stats and
@@ -2180,6 +2216,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 {
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
+	int wakeup = flags & ENQUEUE_WAKEUP;
 
 	for_each_sched_entity(se) {
 		if (se->on_rq)
@@ -2214,6 +2251,9 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	if (!se)
 		inc_nr_running(rq);
 	hrtick_update(rq);
+
+	if (wakeup)
+		sched_wakeup_notify(rq);
 }
 
 static void set_next_buddy(struct sched_entity *se);
@@ -2629,6 +2669,48 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 	return idlest;
 }
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * Groups with less than a quarter of the default share are treated as
+ * background work that may be packed, see PACK_LOW_SHARES.
+ */
+static inline int task_low_shares(struct task_struct *p)
+{
+	return task_group(p)->shares < ROOT_TASK_GROUP_LOAD / 4;
+}
+#else
+static inline int task_low_shares(struct task_struct *p)
+{
+	return 0;
+}
+#endif
+
+/*
+ * The cpu low-share tasks from the cache domain of @cpu are packed on:
+ * the first cpu of the domain @p may run on. Returns -1 once that cpu
+ * has sched_nr_latency tasks, then normal placement applies again.
+ *
+ * Must be called with rcu_read_lock held.
+ */
+static int low_shares_pack_cpu(struct task_struct *p, int cpu)
+{
+	struct sched_domain *sd;
+	int pack_cpu;
+
+	sd = rcu_dereference(per_cpu(sd_llc, cpu));
+	if (!sd)
+		return -1;
+
+	pack_cpu = cpumask_first_and(sched_domain_span(sd), tsk_cpus_allowed(p));
+	if (pack_cpu >= nr_cpu_ids)
+		return -1;
+
+	if (cpu_rq(pack_cpu)->nr_running >= sched_nr_latency)
+		return -1;
+
+	return pack_cpu;
+}
+
 /*
  * Try and locate an idle CPU in the sched_domain.
  */
@@ -2638,7 +2720,8 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	int prev_cpu = task_cpu(p);
 	struct sched_domain *sd;
 	struct sched_group *sg;
-	int i;
+	unsigned int lat, best_lat;
+	int i, best_cpu;
 
 	/*
 	 * If the task is going to be woken-up on this cpu and if it is
@@ -2649,16 +2732,21 @@ static int select_idle_sibling(struct task_struct *p, int target)
 
 	/*
 	 * If the task is going to be woken-up on the cpu where it previously
-	 * ran and if it is currently idle, then it the right target.
+	 * ran and if it is currently idle, then it the right target, unless
+	 * it sits in a deep idle state and a shallower one may be around.
 	 */
-	if (target == prev_cpu && idle_cpu(prev_cpu))
+	if (target == prev_cpu && idle_cpu(prev_cpu) &&
+	    !(sched_feat(IDLE_SHALLOWEST) && cpuidle_cur_exit_latency(prev_cpu)))
 		return prev_cpu;
 
 	/*
-	 * Otherwise, iterate the domains and find an elegible idle cpu.
+	 * Otherwise, iterate the domains and find an elegible idle cpu,
+	 * the shallowest idle one of the first level that has any.
 	 */
 	sd = rcu_dereference(per_cpu(sd_llc, target));
 	for_each_lower_domain(sd) {
+		best_cpu = -1;
+		best_lat = UINT_MAX;
 		sg = sd->groups;
 		do {
 			if (!cpumask_intersects(sched_group_cpus(sg),
@@ -2670,12 +2758,28 @@ static int select_idle_sibling(struct task_struct *p, int target)
 					goto next;
 			}
 
-			target = cpumask_first_and(sched_group_cpus(sg),
-					tsk_cpus_allowed(p));
-			goto done;
+			if (!sched_feat(IDLE_SHALLOWEST)) {
+				target = cpumask_first_and(sched_group_cpus(sg),
+						tsk_cpus_allowed(p));
+				goto done;
+			}
+
+			for_each_cpu_and(i, sched_group_cpus(sg),
+					 tsk_cpus_allowed(p)) {
+				lat = cpuidle_cur_exit_latency(i);
+				if (lat < best_lat) {
+					best_lat = lat;
+					best_cpu = i;
+				}
+			}
 next:
 			sg = sg->next;
 		} while (sg != sd->groups);
+
+		if (best_cpu >= 0) {
+			target = best_cpu;
+			goto done;
+		}
 	}
 done:
 	return target;
@@ -2713,6 +2817,17 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 	}
 
 	rcu_read_lock();
+	if (sched_feat(PACK_LOW_SHARES) && (sd_flag & SD_BALANCE_WAKE) &&
+	    task_low_shares(p)) {
+		int pack_cpu = low_shares_pack_cpu(p, prev_cpu);
+
+		if (pack_cpu >= 0) {
+			schedstat_inc(p, se.statistics.nr_wakeups_packed);
+			new_cpu = pack_cpu;
+			goto unlock;
+		}
+	}
+
 	for_each_domain(cpu, tmp) {
 		if (!(tmp->flags & SD_LOAD_BALANCE))
 			continue;
@@ -3158,6 +3273,13 @@ int can_migrate_task(struct task_struct *p, struct lb_env *env)
 		return 0;
 	}
 
+	/* keep packed low-share tasks where they are, see PACK_LOW_SHARES */
+	if (sched_feat(PACK_LOW_SHARES) && task_low_shares(p) &&
+	    low_shares_pack_cpu(p, env->src_cpu) == env->src_cpu) {
+		schedstat_inc(p, se.statistics.nr_failed_migrations_packed);
+		return 0;
+	}
+
 	/*
 	 * Aggressive migration if:
 	 * 1) task is cache cold, or
@@ -66,6 +66,19 @@ SCHED_FEAT(NONTASK_POWER, true)
  */
 SCHED_FEAT(TTWU_QUEUE, true)
 
+/*
+ * Pack tasks of low-share groups (e.g. Android's bg_non_interactive)
+ * onto the first cpu of their cache domain while that cpu is not
+ * overloaded, keeping the other cpus free for foreground wakeups.
+ */
+SCHED_FEAT(PACK_LOW_SHARES, true)
+
+/*
+ * Among idle cpus, wake tasks on the one in the shallowest cpuidle
+ * state, e.g. WFI rather than OMAP4 MPUSS OFF.
+ */
+SCHED_FEAT(IDLE_SHALLOWEST, true)
+
 SCHED_FEAT(FORCE_SD_OVERLAP, false)
 SCHED_FEAT(RT_RUNTIME_SHARE, true)
 SCHED_FEAT(LB_MIN, false)
@@ -1156,8 +1156,10 @@ enqueue_task_rt(struct rq *rq, struct task_struct *p, int flags)
 {
 	struct sched_rt_entity *rt_se = &p->rt;
 
-	if (flags & ENQUEUE_WAKEUP)
+	if (flags & ENQUEUE_WAKEUP) {
 		rt_se->timeout = 0;
+		schedstat_set(p->se.statistics.wakeup_start, rq->clock);
+	}
 
 	enqueue_rt_entity(rt_se, flags & ENQUEUE_HEAD);
 
@@ -1364,6 +1366,9 @@ static struct task_struct *_pick_next_task_rt(struct rq *rq)
 
 	p = rt_task_of(rt_se);
 	p->se.exec_start = rq->clock_task;
+#ifdef CONFIG_SCHEDSTATS
+	sched_stat_wakeup_end(&p->se.statistics, &rq->rt.wakeup_lat, rq->clock);
+#endif
 
 	return p;
 }
@@ -198,6 +198,17 @@ struct cfs_bandwidth { };
 
 #endif	/* CONFIG_CGROUP_SCHED */
 
+/*
+ * log2 histogram of wakeup-to-run latency: bucket i counts latencies
+ * below 2^i units of 1024ns, the last bucket everything above.
+ */
+#define SCHED_LAT_BUCKETS	16
+#define SCHED_LAT_SHIFT		10
+
+struct sched_lat_hist {
+	unsigned int count[SCHED_LAT_BUCKETS];
+};
+
 /* CFS-related fields in a runqueue */
 struct cfs_rq {
 	struct load_weight load;
@@ -222,6 +233,11 @@ struct cfs_rq {
 	unsigned int nr_spread_over;
 #endif
 
+#ifdef CONFIG_SCHEDSTATS
+	/* wakeups of tasks of this group on this cpu */
+	struct sched_lat_hist wakeup_lat;
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct rq *rq;	/* cpu runqueue to which this cfs_rq is attached */
 
@@ -297,6 +313,10 @@ struct rt_rq {
 	int rt_throttled;
 	u64 rt_time;
 	u64 rt_runtime;
+#ifdef CONFIG_SCHEDSTATS
+	/* only kept on the root rt_rq, covers all rt tasks of the cpu */
+	struct sched_lat_hist wakeup_lat;
+#endif
 	/* Nests inside the rq lock: */
 	raw_spinlock_t rt_runtime_lock;
 
@@ -103,9 +103,96 @@ static const struct file_operations proc_schedstat_operations = {
 	.release = single_release,
 };
 
+#define SCHED_LAT_VERSION 1
+
+static void sched_lat_hist_show(struct seq_file *seq, const char *name,
+				struct sched_lat_hist *hist)
+{
+	int i;
+
+	seq_printf(seq, "%s", name);
+	for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+		seq_printf(seq, " %u", hist->count[i]);
+	seq_printf(seq, "\n");
+}
+
+static void sched_lat_hist_sum(struct sched_lat_hist *sum,
+			       struct sched_lat_hist *hist)
+{
+	int i;
+
+	for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+		sum->count[i] += hist->count[i];
+}
+
+/*
+ * One line of wakeup-to-run latency buckets for the rt class and one per
+ * task group, summed over all cpus.
+ */
+static int show_wakeup_latency(struct seq_file *seq, void *v)
+{
+	struct sched_lat_hist sum;
+	int cpu;
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	struct task_group *tg;
+	char *path = kmalloc(PATH_MAX, GFP_KERNEL);
+
+	if (path == NULL)
+		return -ENOMEM;
+#endif
+
+	seq_printf(seq, "version %d\n", SCHED_LAT_VERSION);
+	seq_printf(seq, "buckets %d shift %d\n", SCHED_LAT_BUCKETS,
+		   SCHED_LAT_SHIFT);
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu)
+		sched_lat_hist_sum(&sum, &cpu_rq(cpu)->rt.wakeup_lat);
+	sched_lat_hist_show(seq, "rt", &sum);
+
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	rcu_read_lock();
+	list_for_each_entry_rcu(tg, &task_groups, list) {
+		if (!autogroup_path(tg, path, PATH_MAX)) {
+			/* may be NULL if the cgroup isn't fully created yet */
+			if (!tg->css.cgroup)
+				continue;
+			cgroup_path(tg->css.cgroup, path, PATH_MAX);
+		}
+
+		memset(&sum, 0, sizeof(sum));
+		for_each_possible_cpu(cpu)
+			sched_lat_hist_sum(&sum, &tg->cfs_rq[cpu]->wakeup_lat);
+		sched_lat_hist_show(seq, path, &sum);
+	}
+	rcu_read_unlock();
+	kfree(path);
+#else
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu)
+		sched_lat_hist_sum(&sum, &cpu_rq(cpu)->cfs.wakeup_lat);
+	sched_lat_hist_show(seq, "/", &sum);
+#endif
+	return 0;
+}
+
+static int wakeup_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_wakeup_latency, NULL);
+}
+
+static const struct file_operations proc_wakeup_latency_operations = {
+	.open    = wakeup_latency_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
 static int __init proc_schedstat_init(void)
 {
 	proc_create("schedstat", 0, NULL, &proc_schedstat_operations);
+	proc_create("sched_wakeup_latency", 0, NULL,
+		    &proc_wakeup_latency_operations);
 	return 0;
 }
 module_init(proc_schedstat_init);
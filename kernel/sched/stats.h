@@ -29,6 +29,34 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 	if (rq)
 		rq->rq_sched_info.run_delay += delta;
 }
+
+/*
+ * A task woken at stats->wakeup_start got the cpu at @now: account the
+ * latency in its schedstats and in @hist, if given.
+ */
+static inline void
+sched_stat_wakeup_end(struct sched_statistics *stats,
+		      struct sched_lat_hist *hist, u64 now)
+{
+	s64 delta;
+
+	if (!stats->wakeup_start)
+		return;
+
+	/* may have been migrated to a runqueue with a clock behind ours */
+	delta = now - stats->wakeup_start;
+	stats->wakeup_start = 0;
+	if (delta < 0)
+		return;
+
+	stats->wakeup_lat_max = max_t(u64, stats->wakeup_lat_max, delta);
+	stats->wakeup_lat_sum += delta;
+	stats->wakeup_lat_count++;
+
+	if (hist)
+		hist->count[min_t(int, fls64(delta >> SCHED_LAT_SHIFT),
+				  SCHED_LAT_BUCKETS - 1)]++;
+}
 # define schedstat_inc(rq, field)	do { (rq)->field++; } while (0)
 # define schedstat_add(rq, field, amt)	do { (rq)->field += (amt); } while (0)
 # define schedstat_set(var, val)	do { var = (val); } while (0)
@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/export.h>
 #include "internal.h"
 
 #if defined CONFIG_COMPACTION || defined CONFIG_CMA
@@ -855,6 +858,163 @@ static int compact_nodes(void)
 	return COMPACT_COMPLETE;
 }
 
+/*
+ * Background compaction. Users of high-order pages register how many free
+ * blocks of an order they would like to find; kcompactd compacts
+ * asynchronously whenever a target is not met, so those allocations rarely
+ * need direct compaction.
+ */
+#define KCOMPACTD_INTERVAL	(10 * HZ)
+#define KCOMPACTD_MAX_PASSES	8
+
+static DEFINE_MUTEX(kcompactd_lock);
+static unsigned long kcompactd_target[MAX_ORDER];
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+static bool kcompactd_kicked;
+
+/* Free blocks of at least @order, larger ones counted as several */
+static unsigned long nr_free_blocks(int order)
+{
+	struct zone *zone;
+	unsigned long nr = 0;
+	int o;
+
+	for_each_populated_zone(zone)
+		for (o = order; o < MAX_ORDER; o++)
+			nr += zone->free_area[o].nr_free << (o - order);
+
+	return nr;
+}
+
+/* Highest registered order whose target isn't met, -1 if all are */
+static int kcompactd_order(void)
+{
+	int order;
+
+	for (order = MAX_ORDER - 1; order > 0; order--) {
+		unsigned long target = ACCESS_ONCE(kcompactd_target[order]);
+
+		if (target && nr_free_blocks(order) < target)
+			return order;
+	}
+
+	return -1;
+}
+
+static bool kcompactd_has_targets(void)
+{
+	int order;
+
+	for (order = 1; order < MAX_ORDER; order++)
+		if (ACCESS_ONCE(kcompactd_target[order]))
+			return true;
+
+	return false;
+}
+
+static int kcompactd(void *unused)
+{
+	set_freezable();
+	set_user_nice(current, 10);
+
+	while (!kthread_should_stop()) {
+		unsigned long before;
+		int order, pass, nid;
+
+		wait_event_freezable_timeout(kcompactd_wait,
+				kcompactd_kicked || kthread_should_stop(),
+				kcompactd_has_targets() ?
+				KCOMPACTD_INTERVAL : MAX_SCHEDULE_TIMEOUT);
+		kcompactd_kicked = false;
+
+		order = kcompactd_order();
+		if (order < 0)
+			continue;
+
+		lru_add_drain_all();
+
+		/* stop as soon as a pass doesn't make any progress */
+		for (pass = 0; pass < KCOMPACTD_MAX_PASSES; pass++) {
+			before = nr_free_blocks(order);
+			for_each_online_node(nid)
+				compact_pgdat(NODE_DATA(nid), order);
+
+			if (nr_free_blocks(order) <= before)
+				break;
+			order = kcompactd_order();
+			if (order < 0 || kthread_should_stop())
+				break;
+			cond_resched();
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * compaction_register_target - ask kcompactd to keep high-order blocks free
+ * @order: the order that is allocated, 1 to MAX_ORDER - 1
+ * @nr_blocks: number of free blocks of @order the caller would like around
+ *
+ * Targets of several callers for the same order add up.
+ */
+int compaction_register_target(unsigned int order, unsigned long nr_blocks)
+{
+	if (!order || order >= MAX_ORDER)
+		return -EINVAL;
+
+	mutex_lock(&kcompactd_lock);
+	kcompactd_target[order] += nr_blocks;
+	mutex_unlock(&kcompactd_lock);
+
+	wakeup_kcompactd();
+	return 0;
+}
+EXPORT_SYMBOL_GPL(compaction_register_target);
+
+/**
+ * compaction_unregister_target - drop a target set by compaction_register_target
+ * @order: order passed at registration
+ * @nr_blocks: count passed at registration
+ */
+void compaction_unregister_target(unsigned int order, unsigned long nr_blocks)
+{
+	if (!order || order >= MAX_ORDER)
+		return;
+
+	mutex_lock(&kcompactd_lock);
+	kcompactd_target[order] -= min(kcompactd_target[order], nr_blocks);
+	mutex_unlock(&kcompactd_lock);
+}
+EXPORT_SYMBOL_GPL(compaction_unregister_target);
+
+/**
+ * wakeup_kcompactd - recheck the compaction targets now
+ *
+ * Meant for callers that just had to fall back to smaller pages. Can be
+ * called from atomic context.
+ */
+void wakeup_kcompactd(void)
+{
+	kcompactd_kicked = true;
+	wake_up_interruptible(&kcompactd_wait);
+}
+EXPORT_SYMBOL_GPL(wakeup_kcompactd);
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(kcompactd, NULL, "kcompactd");
+	if (IS_ERR(task)) {
+		pr_err("Failed to start kcompactd\n");
+		return PTR_ERR(task);
+	}
+
+	return 0;
+}
+module_init(kcompactd_init);
+
 /* The written value is actually unused, all memory is compacted */
 int sysctl_compact_memory;
 
@@ -247,6 +247,11 @@ struct omap_aess_dma {
 
 
 int omap_aess_set_opp_processing(struct omap_aess *abe, u32 opp);
+/* scheduler slots per frame, and entries of the firmware task list */
+#define OMAP_AESS_DBG_SLOTS		25
+#define OMAP_AESS_DBG_TASKS		150
+
+int omap_aess_dbg_sample_task(struct omap_aess *abe, u32 *slot, u32 *task);
 int omap_aess_connect_debug_trace(struct omap_aess *abe,
 				 struct omap_aess_dma *dma2);
 
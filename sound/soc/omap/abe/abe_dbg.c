@@ -66,6 +66,7 @@
 #include "abe_dbg.h"
 #include "abe_mem.h"
 #include "abe_private.h"
+#include "abe_typedef.h"
 
 /**
  * omap_aess_dbg_reset
@@ -109,6 +110,39 @@ int omap_aess_connect_debug_trace(struct omap_aess *abe,
 }
 EXPORT_SYMBOL(omap_aess_connect_debug_trace);
 
+/**
+ * omap_aess_dbg_sample_task
+ * @abe: Pointer on abe handle
+ * @slot: returns the scheduler slot being executed
+ * @task: returns the index in the task list of the task being executed
+ *
+ * Samples the firmware scheduler state, sampled periodically this gives a
+ * statistical profile of the task network. Returns -EAGAIN when the
+ * firmware is not running a task of the list (idle or between two tasks).
+ * Words are read whole since the interconnect mishandles sub-word accesses.
+ */
+int omap_aess_dbg_sample_task(struct omap_aess *abe, u32 *slot, u32 *task)
+{
+	u32 current_task, slot_counter;
+
+	omap_abe_mem_read(abe, OMAP_ABE_DMEM, OMAP_ABE_D_PCURRENTTASK_ADDR,
+			  &current_task, sizeof(current_task));
+	omap_abe_mem_read(abe, OMAP_ABE_DMEM, OMAP_ABE_D_SLOTCOUNTER_ADDR,
+			  &slot_counter, sizeof(slot_counter));
+
+	*slot = (slot_counter & 0xffff) % OMAP_AESS_DBG_SLOTS;
+
+	current_task &= 0xffff;
+	if (current_task < OMAP_ABE_D_TASKSLIST_ADDR)
+		return -EAGAIN;
+	*task = (current_task - OMAP_ABE_D_TASKSLIST_ADDR) / sizeof(ABE_STask);
+	if (*task >= OMAP_AESS_DBG_TASKS)
+		return -EAGAIN;
+
+	return 0;
+}
+EXPORT_SYMBOL(omap_aess_dbg_sample_task);
+
 /**
  * omap_aess_set_debug_trace
  * @dbg: Pointer on abe debug handle
@@ -317,6 +317,7 @@ static int abe_remove(struct snd_soc_platform *platform)
 	struct omap_abe *abe = snd_soc_platform_get_drvdata(platform);
 
 	abe_cleanup_debugfs(abe);
+	abe_opp_exit(abe);
 	free_irq(abe->irq, (void *)abe);
 	abe_free_fw(abe);
 	pm_runtime_disable(abe->dev);
@@ -383,9 +384,7 @@ static int __devinit abe_engine_probe(struct platform_device *pdev)
 
 	abe->dev = &pdev->dev;
 	mutex_init(&abe->mutex);
-	mutex_init(&abe->opp.mutex);
-	mutex_init(&abe->opp.req_mutex);
-	INIT_LIST_HEAD(&abe->opp.req);
+	abe_opp_init(abe);
 
 	get_device(abe->dev);
 	abe->dev->dma_mask = &omap_abe_dmamask;
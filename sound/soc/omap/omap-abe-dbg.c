@@ -28,6 +28,8 @@
 #include <linux/pm_runtime.h>
 #include <linux/dma-mapping.h>
 #include <linux/debugfs.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
 
 #include <plat/dma.h>
 #include <plat/dma-44xx.h>
@@ -264,6 +266,214 @@ static const struct file_operations omap_abe_fops = {
 	.release = abe_release_data,
 };
 
+static ssize_t abe_read_opp_stats(struct file *file, char __user *user_buf,
+				  size_t count, loff_t *ppos)
+{
+	struct omap_abe *abe = file->private_data;
+	char buf[160];
+	int len;
+
+	mutex_lock(&abe->opp.mutex);
+	len = snprintf(buf, sizeof(buf),
+		"level: %d\nto OPP25: %u\nto OPP50: %u\nto OPP100: %u\n"
+		"deferred: %u\ncancelled: %u\nfailures: %u\n",
+		abe->opp.level,
+		abe->opp.transitions[OMAP_ABE_OPP_25],
+		abe->opp.transitions[OMAP_ABE_OPP_50],
+		abe->opp.transitions[OMAP_ABE_OPP_100],
+		abe->opp.deferred, abe->opp.cancelled, abe->opp.failures);
+	mutex_unlock(&abe->opp.mutex);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
+}
+
+static const struct file_operations omap_abe_opp_stats_fops = {
+	.open = simple_open,
+	.read = abe_read_opp_stats,
+	.llseek = default_llseek,
+};
+
+static ssize_t abe_read_reroute(struct file *file, char __user *user_buf,
+				size_t count, loff_t *ppos)
+{
+	struct omap_abe *abe = file->private_data;
+	char buf[96];
+	int len;
+
+	len = snprintf(buf, sizeof(buf),
+		"reroutes: %u\nlast: %u us\nmax: %u us\n",
+		abe->dai.reroutes, abe->dai.reroute_last_us,
+		abe->dai.reroute_max_us);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
+}
+
+static const struct file_operations omap_abe_reroute_fops = {
+	.open = simple_open,
+	.read = abe_read_reroute,
+	.llseek = default_llseek,
+};
+
+/* default sampling period of the task profiler */
+#define OMAP_ABE_PROFILE_US	20
+
+static enum hrtimer_restart abe_profile_sample(struct hrtimer *timer)
+{
+	struct omap_abe *abe = container_of(timer, struct omap_abe,
+					    debugfs.profile_timer);
+	struct omap_abe_debugfs *dbg = &abe->debugfs;
+	u32 slot, task;
+	int busy;
+
+	busy = !omap_aess_dbg_sample_task(abe->aess, &slot, &task);
+
+	spin_lock(&dbg->profile_lock);
+	dbg->profile_samples++;
+	dbg->profile_slot_total[slot]++;
+	if (busy) {
+		dbg->profile_slot_busy[slot]++;
+		dbg->profile_task[task]++;
+	}
+	spin_unlock(&dbg->profile_lock);
+
+	/* profile_us is writable, never let the timer spin */
+	hrtimer_forward_now(timer, ns_to_ktime(max_t(u32, dbg->profile_us, 5) *
+					       NSEC_PER_USEC));
+	return HRTIMER_RESTART;
+}
+
+static void abe_profile_reset(struct omap_abe *abe)
+{
+	struct omap_abe_debugfs *dbg = &abe->debugfs;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dbg->profile_lock, flags);
+	dbg->profile_samples = 0;
+	memset(dbg->profile_task, 0, sizeof(dbg->profile_task));
+	memset(dbg->profile_slot_total, 0, sizeof(dbg->profile_slot_total));
+	memset(dbg->profile_slot_busy, 0, sizeof(dbg->profile_slot_busy));
+	spin_unlock_irqrestore(&dbg->profile_lock, flags);
+}
+
+static void abe_profile_stop(struct omap_abe *abe)
+{
+	if (!abe->debugfs.profiling)
+		return;
+
+	hrtimer_cancel(&abe->debugfs.profile_timer);
+	omap_abe_pm_runtime_put_sync(abe);
+	abe->debugfs.profiling = 0;
+}
+
+static ssize_t abe_write_profile(struct file *file,
+				 const char __user *user_buf,
+				 size_t count, loff_t *ppos)
+{
+	struct omap_abe *abe = file->private_data;
+	char buf[8];
+	int ret = count;
+
+	if (count > sizeof(buf) - 1)
+		return -EINVAL;
+	if (copy_from_user(buf, user_buf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	mutex_lock(&abe->mutex);
+	if (!strncmp(buf, "start", 5)) {
+		/* the DMEM is only readable while the ABE is clocked */
+		if (!abe->debugfs.profiling) {
+			if (!abe->debugfs.profile_us)
+				abe->debugfs.profile_us = OMAP_ABE_PROFILE_US;
+			omap_abe_pm_runtime_get_sync(abe);
+			abe->debugfs.profiling = 1;
+			hrtimer_start(&abe->debugfs.profile_timer,
+				ns_to_ktime(abe->debugfs.profile_us *
+					    NSEC_PER_USEC), HRTIMER_MODE_REL);
+		}
+	} else if (!strncmp(buf, "stop", 4)) {
+		abe_profile_stop(abe);
+	} else if (!strncmp(buf, "reset", 5)) {
+		abe_profile_reset(abe);
+	} else {
+		ret = -EINVAL;
+	}
+	mutex_unlock(&abe->mutex);
+
+	return ret;
+}
+
+static ssize_t abe_read_profile(struct file *file, char __user *user_buf,
+				size_t count, loff_t *ppos)
+{
+	struct omap_abe *abe = file->private_data;
+	struct omap_abe_debugfs *dbg = &abe->debugfs;
+	u32 task[OMAP_AESS_DBG_TASKS];
+	u32 slot_total[OMAP_AESS_DBG_SLOTS], slot_busy[OMAP_AESS_DBG_SLOTS];
+	unsigned long flags, freq;
+	u32 samples;
+	size_t size = 8192;
+	char *buf;
+	int i, len, level;
+	ssize_t ret;
+
+	spin_lock_irqsave(&dbg->profile_lock, flags);
+	samples = dbg->profile_samples;
+	memcpy(task, dbg->profile_task, sizeof(task));
+	memcpy(slot_total, dbg->profile_slot_total, sizeof(slot_total));
+	memcpy(slot_busy, dbg->profile_slot_busy, sizeof(slot_busy));
+	spin_unlock_irqrestore(&dbg->profile_lock, flags);
+
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	/* samples are turned into cycles at the current ABE clock */
+	level = abe->opp.level;
+	freq = abe->opp.freqs[level >= 100 ? OMAP_ABE_OPP_100 :
+			      level >= 50 ? OMAP_ABE_OPP_50 : OMAP_ABE_OPP_25];
+
+	len = scnprintf(buf, size, "%s, %u samples every %u us, OPP%d %lu Hz\n",
+		       dbg->profiling ? "running" : "stopped", samples,
+		       dbg->profile_us, level, freq);
+	if (!samples)
+		goto out;
+
+	len += scnprintf(buf + len, size - len,
+			"\ntask  samples  MCPS  cycles/frame\n");
+	for (i = 0; i < OMAP_AESS_DBG_TASKS; i++) {
+		u64 cycles;
+
+		if (!task[i])
+			continue;
+		/* cycles per second, a frame is the 1ms scheduler period */
+		cycles = div_u64((u64)task[i] * freq, samples);
+		len += scnprintf(buf + len, size - len,
+				"%4d %8u %5llu.%llu %8llu\n", i, task[i],
+				div_u64(cycles, 1000000),
+				div_u64(cycles, 100000) % 10,
+				div_u64(cycles, 1000));
+	}
+
+	len += scnprintf(buf + len, size - len, "\nslot  busy\n");
+	for (i = 0; i < OMAP_AESS_DBG_SLOTS; i++)
+		len += scnprintf(buf + len, size - len, "%4d %4u%%\n", i,
+				slot_total[i] ?
+				slot_busy[i] * 100 / slot_total[i] : 0);
+out:
+	ret = simple_read_from_buffer(user_buf, count, ppos, buf,
+				      min_t(size_t, len, size));
+	kfree(buf);
+	return ret;
+}
+
+static const struct file_operations omap_abe_profile_fops = {
+	.open = simple_open,
+	.read = abe_read_profile,
+	.write = abe_write_profile,
+	.llseek = default_llseek,
+};
+
 void abe_init_debugfs(struct omap_abe *abe)
 {
 	abe->debugfs.d_root = debugfs_create_dir("omap-abe", NULL);
@@ -320,12 +530,45 @@ void abe_init_debugfs(struct omap_abe *abe)
 	if (!abe->debugfs.d_opp)
 		dev_err(abe->dev, "Failed to create OPP level debugfs file\n");
 
+	abe->debugfs.d_opp_stats = debugfs_create_file("opp_stats", 0444,
+						 abe->debugfs.d_root,
+						 abe, &omap_abe_opp_stats_fops);
+	if (!abe->debugfs.d_opp_stats)
+		dev_err(abe->dev, "Failed to create OPP stats debugfs file\n");
+
+	abe->debugfs.d_reroute = debugfs_create_file("reroute_stats", 0444,
+						 abe->debugfs.d_root,
+						 abe, &omap_abe_reroute_fops);
+	if (!abe->debugfs.d_reroute)
+		dev_err(abe->dev, "Failed to create reroute debugfs file\n");
+
+	spin_lock_init(&abe->debugfs.profile_lock);
+	hrtimer_init(&abe->debugfs.profile_timer, CLOCK_MONOTONIC,
+		     HRTIMER_MODE_REL);
+	abe->debugfs.profile_timer.function = abe_profile_sample;
+	abe->debugfs.profile_us = OMAP_ABE_PROFILE_US;
+
+	abe->debugfs.d_profile = debugfs_create_file("task_profile", 0644,
+						 abe->debugfs.d_root,
+						 abe, &omap_abe_profile_fops);
+	if (!abe->debugfs.d_profile)
+		dev_err(abe->dev, "Failed to create profile debugfs file\n");
+
+	abe->debugfs.d_profile_us = debugfs_create_u32("profile_us", 0644,
+						 abe->debugfs.d_root,
+						 &abe->debugfs.profile_us);
+	if (!abe->debugfs.d_profile_us)
+		dev_err(abe->dev, "Failed to create profile period debugfs file\n");
+
 	init_waitqueue_head(&abe->debugfs.wait);
 }
 
 void abe_cleanup_debugfs(struct omap_abe *abe)
 {
 	debugfs_remove_recursive(abe->debugfs.d_root);
+	mutex_lock(&abe->mutex);
+	abe_profile_stop(abe);
+	mutex_unlock(&abe->mutex);
 }
 
 #else
@@ -33,6 +33,33 @@
 
 #include "omap-abe-priv.h"
 
+/* a lower OPP has to be stable this long before the ABE scales down */
+#define OMAP_ABE_OPP_DOWN_DELAY_MS	250
+
+/*
+ * OPP masks use the ABE DSP DAPM convention, one bit per OPP index. An empty
+ * mask means nothing needs more than the lowest OPP.
+ */
+static int abe_opp_mask_to_level(u32 mask)
+{
+	if (!mask)
+		return 25;
+
+	return (1 << (fls(mask) - 1)) * 25;
+}
+
+static int abe_opp_level_to_index(int opp)
+{
+	switch (opp) {
+	case 25:
+		return OMAP_ABE_OPP_25;
+	case 50:
+		return OMAP_ABE_OPP_50;
+	default:
+		return OMAP_ABE_OPP_100;
+	}
+}
+
 static struct abe_opp_req *abe_opp_lookup_requested(struct omap_abe *abe,
 					struct device *dev)
 {
@@ -49,14 +76,12 @@ static struct abe_opp_req *abe_opp_lookup_requested(struct omap_abe *abe,
 static int abe_opp_get_requested(struct omap_abe *abe)
 {
 	struct abe_opp_req *req;
-	int opp = 0;
+	u32 mask = 0;
 
 	list_for_each_entry(req, &abe->opp.req, node)
-		opp |= req->opp;
+		mask |= req->opp;
 
-	opp = (1 << (fls(opp) - 1)) * 25;
-
-	return opp;
+	return abe_opp_mask_to_level(mask);
 }
 
 int abe_opp_init_initial_opp(struct omap_abe *abe)
@@ -128,7 +153,7 @@ int omap_abe_opp_new_request(struct snd_soc_platform *platform,
 			dev_name(dev));
 		abe->opp.req_count++;
 	} else
-		req->opp = opp;
+		req->opp = 1 << opp;
 
 	abe_opp_recalc_level(abe);
 
@@ -143,7 +168,7 @@ int omap_abe_opp_free_request(struct snd_soc_platform *platform,
 {
 	struct omap_abe *abe = snd_soc_platform_get_drvdata(platform);
 	struct abe_opp_req *req;
-	int ret;
+	int ret = 0;
 
 	mutex_lock(&abe->opp.req_mutex);
 
@@ -203,7 +228,7 @@ int abe_opp_set_level(struct omap_abe *abe, int opp)
 		switch (opp) {
 		case 25:
 			if (abe->device_scale) {
-				abe->device_scale(abe->dev,
+				ret = abe->device_scale(abe->dev,
 					abe->opp.freqs[OMAP_ABE_OPP_25]);
 				if (ret)
 					goto err_up_scale;
@@ -231,6 +256,8 @@ int abe_opp_set_level(struct omap_abe *abe, int opp)
 			break;
 		}
 	}
+	if (abe->opp.level != opp)
+		abe->opp.transitions[abe_opp_level_to_index(opp)]++;
 	abe->opp.level = opp;
 	dev_dbg(abe->dev, "opp: new OPP level is %d\n", opp);
 
@@ -252,42 +279,111 @@ err_down_scale:
 		break;
 	}
 	udelay(250);
+	abe->opp.failures++;
+	return ret;
 
 err_up_scale:
+	/* the clock did not move, the old processing network still fits */
 	dev_err(abe->dev, "opp: failed to scale to OPP%d\n", opp);
-	omap_aess_set_opp_processing(abe->aess, ABE_OPP100);
+	abe->opp.failures++;
 	return ret;
 }
 
-int abe_opp_recalc_level(struct omap_abe *abe)
+/* called with abe->opp.mutex held */
+static int abe_opp_calc_level(struct omap_abe *abe)
 {
-	int i, requested_opp, opp = 0;
-
-	mutex_lock(&abe->opp.mutex);
+	int i, requested_opp, opp;
+	u32 mask = 0;
 
 	/* now calculate OPP level based upon DAPM widget status */
 	for (i = 0; i < OMAP_ABE_NUM_WIDGETS; i++) {
 		if (abe->opp.widget[OMAP_ABE_WIDGET(i)]) {
 			dev_dbg(abe->dev, "opp: id %d = %d%%\n", i,
 					abe->opp.widget[OMAP_ABE_WIDGET(i)] * 25);
-			opp |= abe->opp.widget[OMAP_ABE_WIDGET(i)];
+			mask |= abe->opp.widget[OMAP_ABE_WIDGET(i)];
 		}
 	}
-	opp = (1 << (fls(opp) - 1)) * 25;
+	opp = abe_opp_mask_to_level(mask);
 
 	/* OPP requested outside ABE driver (e.g. McPDM) */
 	requested_opp = abe_opp_get_requested(abe);
 	dev_dbg(abe->dev, "opp: calculated %d requested %d selected %d\n",
 		opp, requested_opp, max(opp, requested_opp));
 
+	return max(opp, requested_opp);
+}
+
+static void abe_opp_apply_level(struct omap_abe *abe, int opp)
+{
 	omap_abe_pm_runtime_get_sync(abe);
-	abe_opp_set_level(abe, max(opp, requested_opp));
+	abe_opp_set_level(abe, opp);
 	omap_abe_pm_runtime_put_sync(abe);
+}
+
+static void abe_opp_down_work(struct work_struct *work)
+{
+	struct omap_abe *abe = container_of(to_delayed_work(work),
+					    struct omap_abe, opp.down_work);
+	int opp;
+
+	mutex_lock(&abe->mutex);
+	/* the last stream close already dropped the ABE to its lowest OPP */
+	if (!abe->active)
+		goto out;
+
+	mutex_lock(&abe->opp.req_mutex);
+	mutex_lock(&abe->opp.mutex);
+	opp = abe_opp_calc_level(abe);
+	if (opp < abe->opp.level)
+		abe_opp_apply_level(abe, opp);
+	mutex_unlock(&abe->opp.mutex);
+	mutex_unlock(&abe->opp.req_mutex);
+out:
+	mutex_unlock(&abe->mutex);
+}
+
+/*
+ * Scaling up is done at once since the new path needs the bandwidth before
+ * it starts. Scaling down is deferred so that streams and paths switched in
+ * quick succession (e.g. a key tone over a playback) do not bounce the ABE
+ * between two OPPs, each transition costing a firmware network switch.
+ */
+int abe_opp_recalc_level(struct omap_abe *abe)
+{
+	int opp;
+
+	mutex_lock(&abe->opp.mutex);
+
+	opp = abe_opp_calc_level(abe);
+	if (opp < abe->opp.level) {
+		if (!delayed_work_pending(&abe->opp.down_work))
+			abe->opp.deferred++;
+		schedule_delayed_work(&abe->opp.down_work,
+				msecs_to_jiffies(OMAP_ABE_OPP_DOWN_DELAY_MS));
+	} else {
+		if (cancel_delayed_work(&abe->opp.down_work))
+			abe->opp.cancelled++;
+		if (opp > abe->opp.level)
+			abe_opp_apply_level(abe, opp);
+	}
 
 	mutex_unlock(&abe->opp.mutex);
 	return 0;
 }
 
+void abe_opp_init(struct omap_abe *abe)
+{
+	mutex_init(&abe->opp.mutex);
+	mutex_init(&abe->opp.req_mutex);
+	INIT_LIST_HEAD(&abe->opp.req);
+	INIT_DELAYED_WORK(&abe->opp.down_work, abe_opp_down_work);
+}
+
+void abe_opp_exit(struct omap_abe *abe)
+{
+	cancel_delayed_work_sync(&abe->opp.down_work);
+}
+
 int abe_opp_stream_event(struct snd_soc_dapm_context *dapm, int event)
 {
 	struct snd_soc_platform *platform = dapm->platform;
@@ -24,6 +24,7 @@
  */
 
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
 #include <linux/pm_runtime.h>
 
 #include <plat/dma.h>
@@ -161,6 +162,42 @@ static int omap_abe_dl1_enabled(struct omap_abe *abe)
 	return dl1;
 }
 
+/*
+ * A BE joining the DL1 path while another DL1 BE is playing shares the
+ * DL1 and SDT gains with it. Muting them would ramp the running output
+ * down and back up, which is what is heard as a gap when switching
+ * between outputs, so the gains are left alone in that case.
+ */
+static int omap_abe_be_path_live(struct omap_abe *abe,
+		struct snd_soc_pcm_runtime *be, int stream)
+{
+	if (stream != SNDRV_PCM_STREAM_PLAYBACK)
+		return 0;
+
+	switch (be->dai_link->be_id) {
+	case OMAP_ABE_DAI_PDM_DL1:
+	case OMAP_ABE_DAI_BT_VX:
+	case OMAP_ABE_DAI_MM_FM:
+#if !defined(CONFIG_SND_OMAP_SOC_ABE_DL2)
+	case OMAP_ABE_DAI_PDM_DL2:
+#endif
+		return omap_abe_dl1_enabled(abe);
+	}
+
+	return 0;
+}
+
+/* account BE starts and stops done while the FE keeps running */
+static void omap_abe_reroute_done(struct omap_abe *abe, ktime_t start)
+{
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	abe->dai.reroutes++;
+	abe->dai.reroute_last_us = us;
+	if (us > abe->dai.reroute_max_us)
+		abe->dai.reroute_max_us = us;
+}
+
 static void mute_be(struct snd_soc_pcm_runtime *be,
 		struct snd_soc_dai *dai, int stream)
 {
@@ -637,10 +674,12 @@ static void capture_trigger(struct snd_pcm_substream *substream,
 		struct snd_soc_dai *dai, int cmd)
 {
 	struct snd_soc_pcm_runtime *fe = substream->private_data;
+	struct omap_abe *abe = snd_soc_dai_get_drvdata(dai);
 	struct snd_soc_dpcm_params *dpcm_params;
 	struct snd_pcm_substream *be_substream;
 	int stream = substream->stream;
 	enum snd_soc_dpcm_state state;
+	ktime_t start = ktime_get();
 
 	dev_dbg(fe->dev, "%s: %s %d\n", __func__, fe->cpu_dai->name, stream);
 
@@ -663,8 +702,9 @@ static void capture_trigger(struct snd_pcm_substream *substream,
 
 			be_substream = snd_soc_dpcm_get_substream(be, stream);
 
-			/* mute the BE port */
-			mute_be(be, dai, stream);
+			/* mute the BE port, unless it joins a live path */
+			if (!omap_abe_be_path_live(abe, be, stream))
+				mute_be(be, dai, stream);
 
 			/* enable the BE port */
 			enable_be_port(be, dai, stream);
@@ -757,16 +797,23 @@ static void capture_trigger(struct snd_pcm_substream *substream,
 	default:
 		break;
 	}
+
+	/* BE only update, i.e. a route change under a running FE */
+	if (!snd_soc_dpcm_fe_can_update(fe, stream) &&
+	    (cmd == SNDRV_PCM_TRIGGER_START || cmd == SNDRV_PCM_TRIGGER_STOP))
+		omap_abe_reroute_done(abe, start);
 }
 
 static void playback_trigger(struct snd_pcm_substream *substream,
 		struct snd_soc_dai *dai, int cmd)
 {
 	struct snd_soc_pcm_runtime *fe = substream->private_data;
+	struct omap_abe *abe = snd_soc_dai_get_drvdata(dai);
 	struct snd_soc_dpcm_params *dpcm_params;
 	struct snd_pcm_substream *be_substream;
 	int stream = substream->stream;
 	enum snd_soc_dpcm_state state;
+	ktime_t start = ktime_get();
 
 	dev_dbg(fe->dev, "%s: %s %d\n", __func__, fe->cpu_dai->name, stream);
 
@@ -790,8 +837,9 @@ static void playback_trigger(struct snd_pcm_substream *substream,
 
 			be_substream = snd_soc_dpcm_get_substream(be, stream);
 
-			/* mute BE port */
-			mute_be(be, dai, stream);
+			/* mute the BE port, unless it joins a live path */
+			if (!omap_abe_be_path_live(abe, be, stream))
+				mute_be(be, dai, stream);
 
 			/* enabled BE port */
 			enable_be_port(be, dai, stream);
@@ -884,6 +932,11 @@ static void playback_trigger(struct snd_pcm_substream *substream,
 	default:
 		break;
 	}
+
+	/* BE only update, i.e. a route change under a running FE */
+	if (!snd_soc_dpcm_fe_can_update(fe, stream) &&
+	    (cmd == SNDRV_PCM_TRIGGER_START || cmd == SNDRV_PCM_TRIGGER_STOP))
+		omap_abe_reroute_done(abe, start);
 }
 
 static int omap_abe_dai_startup(struct snd_pcm_substream *substream,
@@ -26,6 +26,8 @@
 
 #include <sound/soc.h>
 #include <linux/irqreturn.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
 
 #include "abe/abe.h"
 #include "abe/abe_gain.h"
@@ -255,6 +257,20 @@ struct omap_abe_debugfs {
 	struct dentry *d_circ;
 	struct dentry *d_elem_bytes;
 	struct dentry *d_opp;
+	struct dentry *d_opp_stats;
+	struct dentry *d_reroute;
+
+	/* statistical profile of the firmware task network */
+	struct hrtimer profile_timer;
+	spinlock_t profile_lock;
+	int profiling;
+	u32 profile_us;
+	u32 profile_samples;
+	u32 profile_task[OMAP_AESS_DBG_TASKS];
+	u32 profile_slot_total[OMAP_AESS_DBG_SLOTS];
+	u32 profile_slot_busy[OMAP_AESS_DBG_SLOTS];
+	struct dentry *d_profile;
+	struct dentry *d_profile_us;
 };
 
 struct omap_abe_dc_offset {
@@ -274,6 +290,15 @@ struct omap_abe_opp {
 	u32 widget[OMAP_ABE_NUM_DAPM_REG + 1];
 	struct list_head req;
 	int req_count;
+
+	/* lower levels are only applied once they have been stable */
+	struct delayed_work down_work;
+
+	/* statistics */
+	u32 transitions[OMAP_ABE_OPP_COUNT];
+	u32 deferred;
+	u32 cancelled;
+	u32 failures;
 };
 
 struct omap_abe_modem {
@@ -297,6 +322,11 @@ struct omap_abe_dai {
 	struct omap_abe_port *port[OMAP_ABE_MAX_PORT_ID + 1];
 	int num_active;
 	int num_suspended;
+
+	/* BE route changes applied under running FEs */
+	u32 reroutes;
+	u32 reroute_last_us;
+	u32 reroute_max_us;
 };
 
 struct omap_abe_mixer {
@@ -401,6 +431,8 @@ int abe_opp_recalc_level(struct omap_abe *abe);
 
 /* omap-abe-opp.c */
 int abe_opp_init_initial_opp(struct omap_abe *abe);
+void abe_opp_init(struct omap_abe *abe);
+void abe_opp_exit(struct omap_abe *abe);
 int abe_opp_set_level(struct omap_abe *abe, int opp);
 int abe_opp_stream_event(struct snd_soc_dapm_context *dapm, int event);
 
@@ -1489,6 +1489,9 @@ static __devinit int omap_abe_probe(struct platform_device *pdev)
 		return -ENOMEM;
 	snd_soc_card_set_drvdata(card, card_data);
 
+	/* ABE and twl6040 come back through the card, nothing depends on it */
+	device_enable_async_suspend(&pdev->dev);
+
 	ret = snd_soc_register_card(card);
 	if (ret)
 		dev_err(&pdev->dev, "snd_soc_register_card() failed: %d\n", ret);
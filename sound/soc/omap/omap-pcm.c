@@ -33,6 +33,15 @@
 #include <plat/dma.h>
 #include "omap-pcm.h"
 
+#if defined(CONFIG_ION_OMAP) || defined(CONFIG_ION_OMAP_MODULE)
+#include <linux/ion.h>
+#include <linux/omap_ion.h>
+#define OMAP_PCM_USE_ION
+#endif
+
+/* preallocated per stream, deeper buffers are allocated at hw_params time */
+#define OMAP_PCM_PREALLOC_BYTES		(128 * 1024)
+
 static const struct snd_pcm_hardware omap_pcm_hardware = {
 	.info			= SNDRV_PCM_INFO_MMAP |
 				  SNDRV_PCM_INFO_MMAP_VALID |
@@ -43,17 +52,21 @@ static const struct snd_pcm_hardware omap_pcm_hardware = {
 	.formats		= SNDRV_PCM_FMTBIT_S16_LE |
 				  SNDRV_PCM_FMTBIT_S32_LE,
 	.period_bytes_min	= 32,
-	.period_bytes_max	= 64 * 1024,
+	.period_bytes_max	= 512 * 1024,
 	.periods_min		= 2,
 	.periods_max		= 255,
-	.buffer_bytes_max	= 128 * 1024,
+	/* deep buffering: ~5s of 48kHz stereo S16_LE without a wakeup */
+	.buffer_bytes_max	= 1024 * 1024,
 };
 
 struct omap_runtime_data {
 	spinlock_t			lock;
 	struct omap_pcm_dma_data	*dma_data;
+	struct snd_dma_buffer		deep_buf;
+	struct snd_dma_buffer		ion_buf;
 	int				dma_ch;
 	int				period_index;
+	snd_pcm_uframes_t		pos;	/* last reported position */
 };
 
 static void omap_pcm_dma_irq(int ch, u16 stat, void *data)
@@ -95,6 +108,304 @@ static void omap_pcm_dma_irq(int ch, u16 stat, void *data)
 	snd_pcm_period_elapsed(substream);
 }
 
+static void omap_pcm_free_deep_buffer(struct snd_pcm_substream *substream)
+{
+	struct omap_runtime_data *prtd = substream->runtime->private_data;
+	struct snd_dma_buffer *buf = &prtd->deep_buf;
+
+	if (!buf->area)
+		return;
+
+	dma_free_writecombine(buf->dev.dev, buf->bytes, buf->area, buf->addr);
+	buf->area = NULL;
+}
+
+/*
+ * Buffers larger than the preallocated one are meant for deep buffered
+ * playback, where the stream runs with no period wakeups and the MPU only
+ * wakes up when the application refills several seconds of audio. They
+ * are allocated on demand rather than reserved for every stream.
+ */
+static int omap_pcm_set_buffer(struct snd_pcm_substream *substream,
+			       size_t bytes)
+{
+	struct omap_runtime_data *prtd = substream->runtime->private_data;
+	struct snd_dma_buffer *buf = &prtd->deep_buf;
+
+	if (bytes <= substream->dma_buffer.bytes) {
+		omap_pcm_free_deep_buffer(substream);
+		snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
+		return 0;
+	}
+
+	if (buf->area && buf->bytes >= bytes)
+		goto out;
+
+	omap_pcm_free_deep_buffer(substream);
+
+	buf->dev.type = SNDRV_DMA_TYPE_DEV;
+	buf->dev.dev = substream->pcm->card->dev;
+	buf->area = dma_alloc_writecombine(buf->dev.dev, PAGE_ALIGN(bytes),
+					   &buf->addr, GFP_KERNEL);
+	if (!buf->area)
+		return -ENOMEM;
+	buf->bytes = PAGE_ALIGN(bytes);
+
+out:
+	snd_pcm_set_runtime_buffer(substream, buf);
+	return 0;
+}
+
+#ifdef OMAP_PCM_USE_ION
+/*
+ * Streams can be pointed at an ION buffer that userspace already shares
+ * with another device, without a copy through the ALSA buffer: capture
+ * DMA writes the samples straight where the voice processing on a remote
+ * core reads them (e.g. handed to the IPU through omaprpc), playback DMA
+ * reads what a decoder wrote, for instance for HDMI. The buffer is passed
+ * as a dma-buf fd through the "Capture ION Buffer" or "Playback ION
+ * Buffer" PCM control while the stream is closed, -1 goes back to the
+ * ALSA buffer.
+ */
+struct omap_pcm_ion {
+	struct mutex		lock;
+	struct ion_client	*client;
+	struct ion_handle	*handle;
+	int			fd;
+};
+
+static int omap_pcm_ion_info(struct snd_kcontrol *kcontrol,
+			     struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = -1;
+	uinfo->value.integer.max = INT_MAX;
+	return 0;
+}
+
+static int omap_pcm_ion_get(struct snd_kcontrol *kcontrol,
+			    struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_pcm_substream *substream = snd_kcontrol_chip(kcontrol);
+	struct omap_pcm_ion *ion = substream->dma_buffer.private_data;
+
+	mutex_lock(&ion->lock);
+	ucontrol->value.integer.value[0] = ion->fd;
+	mutex_unlock(&ion->lock);
+	return 0;
+}
+
+static int omap_pcm_ion_put(struct snd_kcontrol *kcontrol,
+			    struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_pcm_substream *substream = snd_kcontrol_chip(kcontrol);
+	struct omap_pcm_ion *ion = substream->dma_buffer.private_data;
+	struct ion_handle *handle = NULL;
+	int fd = ucontrol->value.integer.value[0];
+	int ret = 1;
+
+	mutex_lock(&ion->lock);
+
+	/* the buffer can't be swapped under an open stream */
+	if (substream->runtime) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (fd >= 0) {
+		handle = ion_import_dma_buf(ion->client, fd);
+		if (IS_ERR_OR_NULL(handle)) {
+			ret = handle ? PTR_ERR(handle) : -EINVAL;
+			goto out;
+		}
+	}
+
+	if (ion->handle)
+		ion_free(ion->client, ion->handle);
+	ion->handle = handle;
+	ion->fd = handle ? fd : -1;
+
+out:
+	mutex_unlock(&ion->lock);
+	return ret;
+}
+
+static struct snd_kcontrol_new omap_pcm_ion_controls[] = {
+	[SNDRV_PCM_STREAM_PLAYBACK] = {
+		.iface	= SNDRV_CTL_ELEM_IFACE_PCM,
+		.name	= "Playback ION Buffer",
+		.info	= omap_pcm_ion_info,
+		.get	= omap_pcm_ion_get,
+		.put	= omap_pcm_ion_put,
+	},
+	[SNDRV_PCM_STREAM_CAPTURE] = {
+		.iface	= SNDRV_CTL_ELEM_IFACE_PCM,
+		.name	= "Capture ION Buffer",
+		.info	= omap_pcm_ion_info,
+		.get	= omap_pcm_ion_get,
+		.put	= omap_pcm_ion_put,
+	},
+};
+
+static bool omap_pcm_ion_attached(struct snd_pcm_substream *substream)
+{
+	struct omap_pcm_ion *ion = substream->dma_buffer.private_data;
+
+	return ion && ion->handle;
+}
+
+static int omap_pcm_ion_map(struct snd_pcm_substream *substream,
+			    size_t bytes)
+{
+	struct omap_runtime_data *prtd = substream->runtime->private_data;
+	struct omap_pcm_ion *ion = substream->dma_buffer.private_data;
+	struct snd_dma_buffer *buf = &prtd->ion_buf;
+	struct device *dev = substream->pcm->card->dev;
+	ion_phys_addr_t pa;
+	size_t len;
+	void *va;
+	int ret;
+
+	if (buf->area)
+		goto out;
+
+	mutex_lock(&ion->lock);
+
+	/* sDMA can only loop over a physically contiguous buffer */
+	ret = ion_phys(ion->client, ion->handle, &pa, &len);
+	if (ret) {
+		dev_err(dev, "ION buffer is not contiguous: %d\n", ret);
+		goto unlock;
+	}
+	if (pa & ~PAGE_MASK) {
+		dev_err(dev, "ION buffer is not page aligned\n");
+		ret = -EINVAL;
+		goto unlock;
+	}
+
+	va = ion_map_kernel(ion->client, ion->handle);
+	if (IS_ERR_OR_NULL(va)) {
+		ret = va ? PTR_ERR(va) : -ENOMEM;
+		goto unlock;
+	}
+
+	buf->dev.type = SNDRV_DMA_TYPE_DEV;
+	buf->dev.dev = dev;
+	buf->area = va;
+	buf->addr = pa;
+	buf->bytes = len;
+	buf->private_data = ion->handle;
+	mutex_unlock(&ion->lock);
+
+out:
+	if (bytes > buf->bytes) {
+		dev_err(dev, "ION buffer too small: %zu < %zu\n",
+			buf->bytes, bytes);
+		return -EINVAL;
+	}
+
+	snd_pcm_set_runtime_buffer(substream, buf);
+	return 0;
+
+unlock:
+	mutex_unlock(&ion->lock);
+	return ret;
+}
+
+static void omap_pcm_ion_unmap(struct snd_pcm_substream *substream)
+{
+	struct omap_runtime_data *prtd = substream->runtime->private_data;
+	struct omap_pcm_ion *ion = substream->dma_buffer.private_data;
+	struct snd_dma_buffer *buf = &prtd->ion_buf;
+
+	if (!buf->area)
+		return;
+
+	ion_unmap_kernel(ion->client, buf->private_data);
+	buf->area = NULL;
+}
+
+static void omap_pcm_ion_new(struct snd_pcm *pcm, int stream)
+{
+	struct snd_pcm_substream *substream = pcm->streams[stream].substream;
+	struct snd_kcontrol *kctl;
+	struct omap_pcm_ion *ion;
+	int ret;
+
+	if (IS_ERR_OR_NULL(omap_ion_device))
+		return;
+
+	ion = kzalloc(sizeof(*ion), GFP_KERNEL);
+	if (!ion)
+		return;
+
+	ion->client = ion_client_create(omap_ion_device,
+					1 << ION_HEAP_TYPE_CARVEOUT,
+					"omap-pcm");
+	if (IS_ERR_OR_NULL(ion->client))
+		goto free;
+	mutex_init(&ion->lock);
+	ion->fd = -1;
+	substream->dma_buffer.private_data = ion;
+
+	kctl = snd_ctl_new1(&omap_pcm_ion_controls[stream], substream);
+	if (!kctl)
+		goto destroy;
+	kctl->id.device = pcm->device;
+	ret = snd_ctl_add(pcm->card, kctl);
+	if (ret < 0)
+		goto destroy;
+
+	return;
+
+destroy:
+	substream->dma_buffer.private_data = NULL;
+	ion_client_destroy(ion->client);
+free:
+	dev_warn(pcm->card->dev, "no ION %s buffer support\n",
+		 stream == SNDRV_PCM_STREAM_CAPTURE ? "capture" : "playback");
+	kfree(ion);
+}
+
+static void omap_pcm_ion_free(struct snd_pcm_substream *substream)
+{
+	struct omap_pcm_ion *ion = substream->dma_buffer.private_data;
+
+	if (!ion)
+		return;
+
+	if (ion->handle)
+		ion_free(ion->client, ion->handle);
+	ion_client_destroy(ion->client);
+	kfree(ion);
+	substream->dma_buffer.private_data = NULL;
+}
+#else
+static inline bool omap_pcm_ion_attached(struct snd_pcm_substream *substream)
+{
+	return false;
+}
+
+static inline int omap_pcm_ion_map(struct snd_pcm_substream *substream,
+				   size_t bytes)
+{
+	return -ENODEV;
+}
+
+static inline void omap_pcm_ion_unmap(struct snd_pcm_substream *substream)
+{
+}
+
+static inline void omap_pcm_ion_new(struct snd_pcm *pcm, int stream)
+{
+}
+
+static inline void omap_pcm_ion_free(struct snd_pcm_substream *substream)
+{
+}
+#endif
+
 /* this may get called several times by oss emulation */
 static int omap_pcm_hw_params(struct snd_pcm_substream *substream,
 			      struct snd_pcm_hw_params *params)
@@ -113,14 +424,21 @@ static int omap_pcm_hw_params(struct snd_pcm_substream *substream,
 	if (!dma_data)
 		return 0;
 
-	snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
+	if (omap_pcm_ion_attached(substream))
+		err = omap_pcm_ion_map(substream, params_buffer_bytes(params));
+	else
+		err = omap_pcm_set_buffer(substream,
+					  params_buffer_bytes(params));
+	if (err)
+		return err;
 	runtime->dma_bytes = params_buffer_bytes(params);
 
 	if (prtd->dma_data)
 		return 0;
 	prtd->dma_data = dma_data;
-	err = omap_request_dma(dma_data->dma_req, dma_data->name,
-			       omap_pcm_dma_irq, substream, &prtd->dma_ch);
+	err = omap_request_dma_prio(dma_data->dma_req, dma_data->name,
+			       omap_pcm_dma_irq, substream, &prtd->dma_ch,
+			       OMAP_DMA_PRIO_RT);
 	if (!err) {
 		/*
 		 * Link channel with itself so DMA doesn't need any
@@ -145,6 +463,8 @@ static int omap_pcm_hw_free(struct snd_pcm_substream *substream)
 	prtd->dma_data = NULL;
 
 	snd_pcm_set_runtime_buffer(substream, NULL);
+	omap_pcm_free_deep_buffer(substream);
+	omap_pcm_ion_unmap(substream);
 
 	return 0;
 }
@@ -232,6 +552,7 @@ static int omap_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 	case SNDRV_PCM_TRIGGER_RESUME:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
 		prtd->period_index = 0;
+		prtd->pos = 0;
 		/* Configure McBSP internal buffer usage */
 		if (dma_data->set_threshold)
 			dma_data->set_threshold(substream);
@@ -258,7 +579,7 @@ static snd_pcm_uframes_t omap_pcm_pointer(struct snd_pcm_substream *substream)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct omap_runtime_data *prtd = runtime->private_data;
 	dma_addr_t ptr;
-	snd_pcm_uframes_t offset;
+	snd_pcm_uframes_t offset, back;
 
 	if (cpu_is_omap1510()) {
 		offset = prtd->period_index * runtime->period_size;
@@ -273,6 +594,20 @@ static snd_pcm_uframes_t omap_pcm_pointer(struct snd_pcm_substream *substream)
 	if (offset >= runtime->buffer_size)
 		offset = 0;
 
+	/*
+	 * With millisecond periods the pointer is polled far more often than
+	 * the period interrupt fires, and a read racing the channel restart
+	 * at the end of the buffer or the CSAC/CDAC erratum can return a
+	 * position slightly behind the previous one. Such a step back would
+	 * look like a buffer lap to the ALSA core and ruin the rate estimate
+	 * of low latency clients, so keep the previous position instead.
+	 */
+	back = (prtd->pos + runtime->buffer_size - offset) %
+		runtime->buffer_size;
+	if (back && back < runtime->period_size)
+		offset = prtd->pos;
+	prtd->pos = offset;
+
 	return offset;
 }
 
@@ -306,6 +641,8 @@ static int omap_pcm_close(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 
+	omap_pcm_free_deep_buffer(substream);
+	omap_pcm_ion_unmap(substream);
 	kfree(runtime->private_data);
 	return 0;
 }
@@ -314,6 +651,15 @@ static int omap_pcm_mmap(struct snd_pcm_substream *substream,
 	struct vm_area_struct *vma)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct omap_runtime_data *prtd = runtime->private_data;
+
+	if (prtd->ion_buf.area && runtime->dma_area == prtd->ion_buf.area) {
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+		return remap_pfn_range(vma, vma->vm_start,
+				       runtime->dma_addr >> PAGE_SHIFT,
+				       vma->vm_end - vma->vm_start,
+				       vma->vm_page_prot);
+	}
 
 	return dma_mmap_writecombine(substream->pcm->card->dev, vma,
 				     runtime->dma_area,
@@ -340,7 +686,7 @@ static int omap_pcm_preallocate_dma_buffer(struct snd_pcm *pcm,
 {
 	struct snd_pcm_substream *substream = pcm->streams[stream].substream;
 	struct snd_dma_buffer *buf = &substream->dma_buffer;
-	size_t size = omap_pcm_hardware.buffer_bytes_max;
+	size_t size = OMAP_PCM_PREALLOC_BYTES;
 
 	buf->dev.type = SNDRV_DMA_TYPE_DEV;
 	buf->dev.dev = pcm->card->dev;
@@ -365,6 +711,8 @@ static void omap_pcm_free_dma_buffers(struct snd_pcm *pcm)
 		if (!substream)
 			continue;
 
+		omap_pcm_ion_free(substream);
+
 		buf = &substream->dma_buffer;
 		if (!buf->area)
 			continue;
@@ -391,6 +739,7 @@ static int omap_pcm_new(struct snd_soc_pcm_runtime *rtd)
 			SNDRV_PCM_STREAM_PLAYBACK);
 		if (ret)
 			goto out;
+		omap_pcm_ion_new(pcm, SNDRV_PCM_STREAM_PLAYBACK);
 	}
 
 	if (pcm->streams[SNDRV_PCM_STREAM_CAPTURE].substream) {
@@ -398,6 +747,7 @@ static int omap_pcm_new(struct snd_soc_pcm_runtime *rtd)
 			SNDRV_PCM_STREAM_CAPTURE);
 		if (ret)
 			goto out;
+		omap_pcm_ion_new(pcm, SNDRV_PCM_STREAM_CAPTURE);
 	}
 
 out:
@@ -0,0 +1,743 @@
+/*
+ * binder_bench - binder IPC throughput and latency benchmark
+ *
+ * Copyright (C) 2012 Texas Instruments Incorporated - http://www.ti.com/
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * Drives /dev/binder directly, without libbinder, so that the numbers only
+ * contain the driver and the scheduler. The parent process becomes the
+ * context manager and only introduces the clients to the servers, so no
+ * other context manager may be running: stop servicemanager first.
+ *
+ * Workloads:
+ *   sync	round trips with a payload of -S bytes and an empty reply
+ *   oneway	a flood of one-way transactions of -S bytes
+ *   fd		round trips carrying a file descriptor
+ *   large	sync with a default payload of 128 KiB
+ *
+ * Client i talks to server i % servers, so "-c 8 -s 1" is the
+ * many-to-one case. With -C n every process is bound to cpus 0..n-1.
+ *
+ * If the kernel has CONFIG_ANDROID_BINDER_LOCK_STATS, the time spent
+ * under binder_lock during the run is read from debugfs and reported.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../../drivers/staging/android/binder.h"
+
+#define BB_MAP_SIZE		((1024 * 1024) - (4096 * 2))
+#define BB_MAX_SERVERS		64
+#define BB_LOCK_STATS		"/sys/kernel/debug/binder/lock_stats"
+
+enum {
+	BB_REGISTER = 1,	/* server to parent: its node, int id */
+	BB_LOOKUP,		/* client to parent: int id, reply: handle */
+	BB_PING,		/* client to server */
+};
+
+enum {
+	WL_SYNC,
+	WL_ONEWAY,
+	WL_FD,
+	WL_LARGE,
+};
+
+static const char * const workload_names[] = {
+	[WL_SYNC]	= "sync",
+	[WL_ONEWAY]	= "oneway",
+	[WL_FD]		= "fd",
+	[WL_LARGE]	= "large",
+};
+
+/* objects must be pointer aligned in the data, so the node comes first */
+struct bb_register {
+	struct flat_binder_object obj;
+	int id;
+};
+
+struct bb_client_result {
+	uint64_t end_ns;
+	unsigned long failed;
+	unsigned long throttled;
+};
+
+/* shared with all children, mapped before they are forked */
+struct bb_shared {
+	volatile int ready;
+	volatile int go;
+	uint64_t start_ns;
+	struct bb_client_result client[0];
+};
+
+struct bb_lock_stats {
+	unsigned long long acquired;
+	unsigned long long contended;
+	unsigned long long wait_ns;
+	unsigned long long hold_ns;
+	unsigned long long max_hold_ns;
+};
+
+static const char *device = "/dev/binder";
+static int workload = WL_SYNC;
+static int nr_clients = 1;
+static int nr_servers = 1;
+static int nr_threads = 1;
+static int iterations = 10000;
+static long payload = -1;
+static int nr_cpus;
+
+static struct bb_shared *shared;
+static uint32_t *samples;
+
+struct bb {
+	int fd;
+	void *map;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void die(const char *what)
+{
+	fprintf(stderr, "binder_bench: %s: %s\n", what, strerror(errno));
+	exit(1);
+}
+
+static void bind_cpus(void)
+{
+	cpu_set_t set;
+	int i;
+
+	if (!nr_cpus)
+		return;
+	CPU_ZERO(&set);
+	for (i = 0; i < nr_cpus; i++)
+		CPU_SET(i, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		die("sched_setaffinity");
+}
+
+static void bb_open(struct bb *b)
+{
+	struct binder_version vers;
+
+	b->fd = open(device, O_RDWR);
+	if (b->fd < 0)
+		die(device);
+	if (ioctl(b->fd, BINDER_VERSION, &vers) ||
+	    vers.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder_bench: protocol version mismatch\n");
+		exit(1);
+	}
+	b->map = mmap(NULL, BB_MAP_SIZE, PROT_READ, MAP_PRIVATE, b->fd, 0);
+	if (b->map == MAP_FAILED)
+		die("mmap");
+}
+
+static int bb_ioctl(struct bb *b, void *wbuf, size_t wsize,
+		    void *rbuf, size_t rsize, size_t *consumed)
+{
+	struct binder_write_read bwr;
+	int ret;
+
+	bwr.write_size = wsize;
+	bwr.write_consumed = 0;
+	bwr.write_buffer = (unsigned long)wbuf;
+	bwr.read_size = rsize;
+	bwr.read_consumed = 0;
+	bwr.read_buffer = (unsigned long)rbuf;
+	do {
+		ret = ioctl(b->fd, BINDER_WRITE_READ, &bwr);
+	} while (ret < 0 && errno == EINTR && !bwr.write_consumed &&
+		 !bwr.read_consumed);
+	if (consumed)
+		*consumed = bwr.read_consumed;
+	return ret;
+}
+
+/* appends a command and its argument to a write buffer */
+static size_t bb_put(void *buf, size_t pos, uint32_t cmd,
+		     const void *arg, size_t size)
+{
+	memcpy((char *)buf + pos, &cmd, sizeof(cmd));
+	memcpy((char *)buf + pos + sizeof(cmd), arg, size);
+	return pos + sizeof(cmd) + size;
+}
+
+static size_t bb_put_free(void *buf, size_t pos, const void *data)
+{
+	return bb_put(buf, pos, BC_FREE_BUFFER, &data, sizeof(data));
+}
+
+/* the reference the transaction buffer holds goes away with it */
+static size_t bb_put_acquire(void *buf, size_t pos, uint32_t handle)
+{
+	return bb_put(buf, pos, BC_ACQUIRE, &handle, sizeof(handle));
+}
+
+/* answers the reference count commands every node owner gets */
+static void bb_ref_cmd(struct bb *b, uint32_t cmd, void *arg)
+{
+	char wbuf[64];
+
+	if (cmd == BR_INCREFS)
+		bb_ioctl(b, wbuf, bb_put(wbuf, 0, BC_INCREFS_DONE, arg,
+			 sizeof(struct binder_ptr_cookie)), NULL, 0, NULL);
+	else if (cmd == BR_ACQUIRE)
+		bb_ioctl(b, wbuf, bb_put(wbuf, 0, BC_ACQUIRE_DONE, arg,
+			 sizeof(struct binder_ptr_cookie)), NULL, 0, NULL);
+}
+
+/*
+ * Sends a transaction and waits for its reply, or for the driver to
+ * accept it if it is one-way. On success a reply is copied to @reply
+ * and its buffer must be freed by the caller.
+ */
+static int bb_transact(struct bb *b, uint32_t handle, uint32_t code,
+		       uint32_t flags, const void *data, size_t size,
+		       const size_t *offsets, size_t nr_offsets,
+		       struct binder_transaction_data *reply)
+{
+	struct binder_transaction_data tr;
+	char wbuf[sizeof(uint32_t) + sizeof(tr)];
+	uint32_t rbuf[64];
+	size_t wsize, consumed, pos;
+	uint32_t cmd;
+
+	memset(&tr, 0, sizeof(tr));
+	tr.target.handle = handle;
+	tr.code = code;
+	tr.flags = flags;
+	tr.data_size = size;
+	tr.offsets_size = nr_offsets * sizeof(size_t);
+	tr.data.ptr.buffer = data;
+	tr.data.ptr.offsets = offsets;
+	wsize = bb_put(wbuf, 0, BC_TRANSACTION, &tr, sizeof(tr));
+
+	for (;;) {
+		if (bb_ioctl(b, wbuf, wsize, rbuf, sizeof(rbuf), &consumed))
+			return -1;
+		wsize = 0;
+
+		for (pos = 0; pos < consumed;) {
+			memcpy(&cmd, (char *)rbuf + pos, sizeof(cmd));
+			pos += sizeof(cmd);
+
+			switch (cmd) {
+			case BR_NOOP:
+				break;
+			case BR_TRANSACTION_COMPLETE:
+				if (flags & TF_ONE_WAY)
+					return 0;
+				break;
+			case BR_REPLY:
+				memcpy(reply, (char *)rbuf + pos, sizeof(*reply));
+				return 0;
+			case BR_INCREFS:
+			case BR_ACQUIRE:
+			case BR_RELEASE:
+			case BR_DECREFS:
+				bb_ref_cmd(b, cmd, (char *)rbuf + pos);
+				break;
+			case BR_DEAD_REPLY:
+			case BR_FAILED_REPLY:
+			case BR_ERROR:
+				errno = cmd == BR_FAILED_REPLY ? ENOSPC : EPIPE;
+				return -1;
+			default:
+				break;
+			}
+			pos += _IOC_SIZE(cmd);
+		}
+	}
+}
+
+static void bb_free(struct bb *b, const void *data)
+{
+	char wbuf[16];
+
+	bb_ioctl(b, wbuf, bb_put_free(wbuf, 0, data), NULL, 0, NULL);
+}
+
+/*
+ * Receives transactions until @done returns non-zero. @handle is called
+ * for every transaction and writes its commands, typically BC_FREE_BUFFER
+ * and a BC_REPLY, to the buffer it is given.
+ */
+static void bb_loop(struct bb *b,
+		    size_t (*handle)(struct binder_transaction_data *tr,
+				     void *wbuf),
+		    int (*done)(void))
+{
+	struct binder_transaction_data tr;
+	char wbuf[256];
+	uint32_t rbuf[128];
+	uint32_t cmd = BC_ENTER_LOOPER;
+	size_t consumed, pos, wsize;
+
+	bb_ioctl(b, &cmd, sizeof(cmd), NULL, 0, NULL);
+
+	while (!done()) {
+		if (bb_ioctl(b, NULL, 0, rbuf, sizeof(rbuf), &consumed)) {
+			if (errno == EINTR)
+				continue;
+			die("BINDER_WRITE_READ");
+		}
+
+		for (pos = 0; pos < consumed;) {
+			memcpy(&cmd, (char *)rbuf + pos, sizeof(cmd));
+			pos += sizeof(cmd);
+
+			switch (cmd) {
+			case BR_TRANSACTION:
+				memcpy(&tr, (char *)rbuf + pos, sizeof(tr));
+				wsize = handle(&tr, wbuf);
+				if (wsize)
+					bb_ioctl(b, wbuf, wsize, NULL, 0, NULL);
+				break;
+			case BR_INCREFS:
+			case BR_ACQUIRE:
+			case BR_RELEASE:
+			case BR_DECREFS:
+				bb_ref_cmd(b, cmd, (char *)rbuf + pos);
+				break;
+			default:
+				break;
+			}
+			pos += _IOC_SIZE(cmd);
+		}
+	}
+}
+
+static size_t bb_put_reply(void *wbuf, size_t pos, const void *data,
+			   size_t size, const size_t *offsets,
+			   size_t nr_offsets)
+{
+	struct binder_transaction_data tr;
+
+	memset(&tr, 0, sizeof(tr));
+	tr.data_size = size;
+	tr.offsets_size = nr_offsets * sizeof(size_t);
+	tr.data.ptr.buffer = data;
+	tr.data.ptr.offsets = offsets;
+	return bb_put(wbuf, pos, BC_REPLY, &tr, sizeof(tr));
+}
+
+/* parent: the context manager, a directory of the servers */
+
+static uint32_t server_handles[BB_MAX_SERVERS];
+static int registered, looked_up;
+
+static size_t parent_handle(struct binder_transaction_data *tr, void *wbuf)
+{
+	static struct flat_binder_object obj;
+	static const size_t offset;
+	const struct bb_register *reg = tr->data.ptr.buffer;
+	const int *id = tr->data.ptr.buffer;
+	size_t pos = 0;
+
+	switch (tr->code) {
+	case BB_REGISTER:
+		server_handles[reg->id] = reg->obj.handle;
+		pos = bb_put_acquire(wbuf, pos, reg->obj.handle);
+		pos = bb_put_free(wbuf, pos, tr->data.ptr.buffer);
+		registered++;
+		return bb_put_reply(wbuf, pos, NULL, 0, NULL, 0);
+	case BB_LOOKUP:
+		obj.type = BINDER_TYPE_HANDLE;
+		obj.handle = server_handles[*id];
+		pos = bb_put_free(wbuf, pos, tr->data.ptr.buffer);
+		looked_up++;
+		return bb_put_reply(wbuf, pos, &obj, sizeof(obj), &offset, 1);
+	}
+	pos = bb_put_free(wbuf, pos, tr->data.ptr.buffer);
+	return bb_put_reply(wbuf, pos, NULL, 0, NULL, 0);
+}
+
+static int servers_registered(void)
+{
+	return registered == nr_servers;
+}
+
+static int clients_looked_up(void)
+{
+	return looked_up == nr_clients;
+}
+
+/* server */
+
+static int never(void)
+{
+	return 0;
+}
+
+static size_t server_handle(struct binder_transaction_data *tr, void *wbuf)
+{
+	const struct flat_binder_object *obj;
+	size_t pos;
+
+	if (tr->offsets_size) {
+		obj = (const void *)((const char *)tr->data.ptr.buffer +
+				     ((const size_t *)tr->data.ptr.offsets)[0]);
+		if (obj->type == BINDER_TYPE_FD)
+			close(obj->handle);
+	}
+	pos = bb_put_free(wbuf, 0, tr->data.ptr.buffer);
+	if (tr->flags & TF_ONE_WAY)
+		return pos;
+	return bb_put_reply(wbuf, pos, NULL, 0, NULL, 0);
+}
+
+static void *server_thread(void *arg)
+{
+	bb_loop(arg, server_handle, never);
+	return NULL;
+}
+
+static void run_server(int id)
+{
+	struct binder_transaction_data reply;
+	struct bb_register msg;
+	const size_t offset = 0;
+	pthread_t thread;
+	struct bb b;
+	int i;
+
+	bind_cpus();
+	bb_open(&b);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.id = id;
+	msg.obj.type = BINDER_TYPE_BINDER;
+	msg.obj.flags = FLAT_BINDER_FLAG_ACCEPTS_FDS;
+	msg.obj.binder = (void *)(long)(id + 1);
+	msg.obj.cookie = msg.obj.binder;
+	if (bb_transact(&b, 0, BB_REGISTER, 0, &msg, sizeof(msg),
+			&offset, 1, &reply))
+		die("register");
+	bb_free(&b, reply.data.ptr.buffer);
+
+	for (i = 1; i < nr_threads; i++)
+		if (pthread_create(&thread, NULL, server_thread, &b))
+			die("pthread_create");
+	server_thread(&b);
+	exit(0);
+}
+
+/* client */
+
+static void run_client(int id)
+{
+	struct bb_client_result *res = &shared->client[id];
+	uint32_t *lat = samples + (size_t)id * iterations;
+	struct binder_transaction_data reply;
+	const struct flat_binder_object *obj;
+	struct flat_binder_object fd_obj;
+	const size_t offset = 0;
+	const void *data;
+	uint32_t handle;
+	char wbuf[64];
+	char *buf;
+	struct bb b;
+	uint64_t t;
+	size_t size;
+	int server = id % nr_servers;
+	int i, ret;
+
+	bind_cpus();
+
+	if (workload == WL_FD) {
+		memset(&fd_obj, 0, sizeof(fd_obj));
+		fd_obj.type = BINDER_TYPE_FD;
+		fd_obj.handle = open("/dev/null", O_RDONLY);
+		if (fd_obj.handle < 0)
+			die("/dev/null");
+		data = &fd_obj;
+		size = sizeof(fd_obj);
+	} else {
+		buf = calloc(1, payload ? payload : 1);
+		if (!buf)
+			die("calloc");
+		data = buf;
+		size = payload;
+	}
+
+	bb_open(&b);
+	if (bb_transact(&b, 0, BB_LOOKUP, 0, &server, sizeof(server),
+			NULL, 0, &reply))
+		die("lookup");
+	obj = reply.data.ptr.buffer;
+	handle = obj->handle;
+	bb_ioctl(&b, wbuf, bb_put_free(wbuf, bb_put_acquire(wbuf, 0, handle),
+		 reply.data.ptr.buffer), NULL, 0, NULL);
+
+	__sync_fetch_and_add(&shared->ready, 1);
+	while (!shared->go)
+		usleep(100);
+
+	for (i = 0; i < iterations; i++) {
+		t = now_ns();
+		if (workload == WL_ONEWAY) {
+			ret = bb_transact(&b, handle, BB_PING, TF_ONE_WAY,
+					  data, size, NULL, 0, NULL);
+			if (ret && errno == ENOSPC) {
+				/* the server's async space is full, retry */
+				res->throttled++;
+				sched_yield();
+				i--;
+				continue;
+			}
+		} else {
+			ret = bb_transact(&b, handle, BB_PING, 0, data, size,
+					  &offset, workload == WL_FD, &reply);
+			if (!ret)
+				bb_free(&b, reply.data.ptr.buffer);
+		}
+		lat[i] = now_ns() - t;
+		if (ret)
+			res->failed++;
+	}
+	res->end_ns = now_ns();
+	exit(0);
+}
+
+/* reporting */
+
+static int read_lock_stats(struct bb_lock_stats *s)
+{
+	char key[32];
+	unsigned long long val;
+	FILE *f;
+
+	f = fopen(BB_LOCK_STATS, "r");
+	if (!f)
+		return -1;
+	memset(s, 0, sizeof(*s));
+	while (fscanf(f, "%31[^:]: %llu\n", key, &val) == 2) {
+		if (!strcmp(key, "acquired"))
+			s->acquired = val;
+		else if (!strcmp(key, "contended"))
+			s->contended = val;
+		else if (!strcmp(key, "wait_ns"))
+			s->wait_ns = val;
+		else if (!strcmp(key, "hold_ns"))
+			s->hold_ns = val;
+		else if (!strcmp(key, "max_hold_ns"))
+			s->max_hold_ns = val;
+	}
+	fclose(f);
+	return 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const uint32_t *sorted, size_t n, int pct)
+{
+	size_t i = n * pct / 100;
+
+	if (i >= n)
+		i = n - 1;
+	return sorted[i] / 1000.0;
+}
+
+static void report(uint64_t end_ns, int have_lock, struct bb_lock_stats *l0,
+		   struct bb_lock_stats *l1)
+{
+	size_t n = (size_t)nr_clients * iterations;
+	unsigned long failed = 0, throttled = 0;
+	double secs = (end_ns - shared->start_ns) / 1e9;
+	int i;
+
+	for (i = 0; i < nr_clients; i++) {
+		failed += shared->client[i].failed;
+		throttled += shared->client[i].throttled;
+	}
+	qsort(samples, n, sizeof(*samples), cmp_u32);
+
+	printf("workload %s: %d clients, %d servers x %d threads, "
+	       "%d iterations, %ld bytes, cpus %d\n",
+	       workload_names[workload], nr_clients, nr_servers, nr_threads,
+	       iterations, payload, nr_cpus ? nr_cpus :
+	       (int)sysconf(_SC_NPROCESSORS_ONLN));
+	printf("  transactions: %zu in %.3f s, %.0f /s, failed %lu, "
+	       "throttled %lu\n", n, secs, n / secs, failed, throttled);
+	printf("  latency us: p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+	       percentile_us(samples, n, 50), percentile_us(samples, n, 90),
+	       percentile_us(samples, n, 99), samples[n - 1] / 1000.0);
+	if (!have_lock) {
+		printf("  binder_lock: no %s\n", BB_LOCK_STATS);
+		return;
+	}
+	printf("  binder_lock: held %.3f s (%.1f%% of run), waited %.3f s, "
+	       "%llu acquisitions, %llu contended, max hold %llu us\n",
+	       (l1->hold_ns - l0->hold_ns) / 1e9,
+	       100.0 * (l1->hold_ns - l0->hold_ns) / 1e9 / secs,
+	       (l1->wait_ns - l0->wait_ns) / 1e9,
+	       l1->acquired - l0->acquired, l1->contended - l0->contended,
+	       l1->max_hold_ns / 1000);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: binder_bench [-w sync|oneway|fd|large] [-c clients] "
+		"[-s servers]\n"
+		"                    [-t server threads] [-n iterations] "
+		"[-S payload bytes]\n"
+		"                    [-C cpus] [-d device]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct bb_lock_stats l0, l1;
+	pid_t servers[BB_MAX_SERVERS];
+	pid_t *clients;
+	size_t shared_size;
+	uint64_t end_ns = 0;
+	int have_lock;
+	struct bb b;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "w:c:s:t:n:S:C:d:")) != -1) {
+		switch (opt) {
+		case 'w':
+			for (i = 0; i < (int)(sizeof(workload_names) /
+					      sizeof(workload_names[0])); i++)
+				if (!strcmp(optarg, workload_names[i]))
+					break;
+			if (i == sizeof(workload_names) /
+				 sizeof(workload_names[0]))
+				usage();
+			workload = i;
+			break;
+		case 'c':
+			nr_clients = atoi(optarg);
+			break;
+		case 's':
+			nr_servers = atoi(optarg);
+			break;
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 'S':
+			payload = atol(optarg);
+			break;
+		case 'C':
+			nr_cpus = atoi(optarg);
+			break;
+		case 'd':
+			device = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (payload < 0)
+		payload = workload == WL_LARGE ? 128 * 1024 : 0;
+	if (workload == WL_FD)
+		payload = sizeof(struct flat_binder_object);
+	if (nr_clients < 1 || nr_servers < 1 || nr_servers > BB_MAX_SERVERS ||
+	    nr_threads < 1 || iterations < 1 || payload > BB_MAP_SIZE / 2)
+		usage();
+
+	shared_size = sizeof(*shared) +
+		      nr_clients * sizeof(struct bb_client_result);
+	shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	samples = mmap(NULL, (size_t)nr_clients * iterations *
+		       sizeof(*samples), PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED || samples == MAP_FAILED)
+		die("mmap");
+
+	bind_cpus();
+	bb_open(&b);
+	if (ioctl(b.fd, BINDER_SET_CONTEXT_MGR, 0)) {
+		if (errno == EBUSY)
+			fprintf(stderr, "binder_bench: there already is a "
+				"context manager, stop servicemanager\n");
+		die("BINDER_SET_CONTEXT_MGR");
+	}
+
+	/* children open their own binder, the parent's is not theirs */
+	for (i = 0; i < nr_servers; i++) {
+		servers[i] = fork();
+		if (servers[i] < 0)
+			die("fork");
+		if (!servers[i]) {
+			close(b.fd);
+			run_server(i);
+		}
+	}
+	bb_loop(&b, parent_handle, servers_registered);
+
+	clients = calloc(nr_clients, sizeof(*clients));
+	if (!clients)
+		die("calloc");
+	for (i = 0; i < nr_clients; i++) {
+		clients[i] = fork();
+		if (clients[i] < 0)
+			die("fork");
+		if (!clients[i]) {
+			close(b.fd);
+			run_client(i);
+		}
+	}
+	bb_loop(&b, parent_handle, clients_looked_up);
+	while (shared->ready < nr_clients)
+		usleep(100);
+
+	have_lock = !read_lock_stats(&l0);
+	shared->start_ns = now_ns();
+	__sync_synchronize();
+	shared->go = 1;
+
+	for (i = 0; i < nr_clients; i++)
+		waitpid(clients[i], NULL, 0);
+	for (i = 0; i < nr_clients; i++)
+		if (shared->client[i].end_ns > end_ns)
+			end_ns = shared->client[i].end_ns;
+	if (have_lock)
+		have_lock = !read_lock_stats(&l1);
+
+	for (i = 0; i < nr_servers; i++) {
+		kill(servers[i], SIGKILL);
+		waitpid(servers[i], NULL, 0);
+	}
+
+	report(end_ns, have_lock, &l0, &l1);
+	return 0;
+}
@@ -0,0 +1,60 @@
+#!/bin/sh
+#
+# Runs binder_bench on a target over adb, every workload on 1..N cpus.
+#
+#   make CROSS_COMPILE=arm-linux-gnueabi-
+#   ./binder_bench.sh [-s serial] [-n iterations] [-o results.txt]
+#
+# The Android framework and servicemanager are stopped for the run, since
+# the benchmark has to be the context manager, and started again after.
+# Lock statistics need CONFIG_ANDROID_BINDER_LOCK_STATS on the target.
+#
+
+ADB=adb
+ITERATIONS=10000
+OUT=binder_bench-$(date +%Y%m%d-%H%M%S).txt
+BIN=/data/local/tmp/binder_bench
+
+while getopts "s:n:o:" opt; do
+	case $opt in
+	s) ADB="adb -s $OPTARG" ;;
+	n) ITERATIONS=$OPTARG ;;
+	o) OUT=$OPTARG ;;
+	*) echo "usage: $0 [-s serial] [-n iterations] [-o file]"; exit 2 ;;
+	esac
+done
+
+cd "$(dirname "$0")" || exit 1
+[ -x binder_bench ] || { echo "build binder_bench first"; exit 1; }
+
+$ADB root >/dev/null && $ADB wait-for-device || exit 1
+$ADB push binder_bench $BIN >/dev/null || exit 1
+$ADB shell chmod 755 $BIN
+
+CPUS=$($ADB shell cat /sys/devices/system/cpu/online | tr -d '\r')
+NCPU=$((${CPUS##*-} + 1))
+
+$ADB shell "mount | grep -q debugfs || mount -t debugfs none /sys/kernel/debug"
+$ADB shell stop
+$ADB shell stop servicemanager
+sleep 2
+
+run() {
+	echo "# $*" | tee -a "$OUT"
+	$ADB shell $BIN -n $ITERATIONS "$@" | tr -d '\r' | tee -a "$OUT"
+}
+
+cpus=1
+while [ $cpus -le $NCPU ]; do
+	run -C $cpus -w sync -c $cpus -s $cpus
+	run -C $cpus -w oneway -c $cpus -s $cpus
+	# many-to-one: every client on one server
+	run -C $cpus -w sync -c $((cpus * 4)) -s 1 -t $cpus
+	run -C $cpus -w fd -c $cpus -s $cpus
+	run -C $cpus -w large -c $cpus -s $cpus
+	cpus=$((cpus + 1))
+done
+
+$ADB shell start servicemanager
+$ADB shell start
+echo "results in $OUT"
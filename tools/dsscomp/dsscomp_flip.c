@@ -0,0 +1,368 @@
+/*
+ * dsscomp_flip - DSS composition flip stress and frame timing benchmark
+ *
+ * Copyright (C) 2012 Texas Instruments Incorporated - http://www.ti.com/
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * Queues gralloc compositions through DSSCIOC_SETUP_DISPC, the path the
+ * hardware composer uses, paced by the vsync events of /dev/dsscomp.
+ * Overlays are ARGB32, either malloc'ed and mapped to TILER 1D by the
+ * driver for every flip, or TILER 2D buffers from ion, which are the
+ * only ones that can be rotated.
+ *
+ * The driver side of the measurement is debugfs dsscomp/flip_stats:
+ * queue-to-programmed and programmed-to-vsync times taken in the
+ * completion callbacks, missed vsyncs, dropped flips and the DISPC FIFO
+ * underflows and sync losts of the run. It is reset at the start and
+ * printed at the end, after what the tool saw itself.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/types.h>
+
+typedef uint32_t u32;
+#define __aligned(x)	__attribute__((aligned(x)))
+
+#include "../../include/video/dsscomp.h"
+#include "../../include/linux/ion.h"
+#include "../../include/linux/omap_ion.h"
+
+#define FLIP_STATS	"/sys/kernel/debug/dsscomp/flip_stats"
+#define MAX_BUFS	8
+
+struct buffer {
+	void *addr;
+	uint32_t stride;
+	size_t size;
+};
+
+static int display;
+static int nr_ovls = 1;
+static int src_w, src_h;
+static int scale = 100;
+static int rotation;
+static int use_tiler;
+static int fps;
+static int nr_flips = 600;
+static int nr_bufs = 3;
+
+static struct buffer bufs[4][MAX_BUFS];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void die(const char *what)
+{
+	fprintf(stderr, "dsscomp_flip: %s: %s\n", what, strerror(errno));
+	exit(1);
+}
+
+static void fill(struct buffer *b, uint32_t color)
+{
+	uint32_t *p;
+	int x, y;
+
+	for (y = 0; y < src_h; y++) {
+		p = (uint32_t *)((char *)b->addr + y * b->stride);
+		for (x = 0; x < src_w; x++)
+			p[x] = 0xff000000 | color;
+	}
+}
+
+static void alloc_1d(struct buffer *b)
+{
+	b->stride = src_w * 4;
+	b->size = (size_t)b->stride * src_h;
+	if (posix_memalign(&b->addr, 4096, b->size))
+		die("posix_memalign");
+}
+
+static void alloc_2d(int ion, struct buffer *b)
+{
+	struct omap_ion_tiler_alloc_data a = {
+		.w = src_w,
+		.h = src_h,
+		.fmt = TILER_PIXEL_FMT_32BIT,
+	};
+	struct ion_custom_data c = {
+		.cmd = OMAP_ION_TILER_ALLOC,
+		.arg = (unsigned long)&a,
+	};
+	struct ion_fd_data fd;
+
+	if (ioctl(ion, ION_IOC_CUSTOM, &c))
+		die("OMAP_ION_TILER_ALLOC");
+	fd.handle = a.handle;
+	if (ioctl(ion, ION_IOC_MAP, &fd))
+		die("ION_IOC_MAP");
+	b->stride = a.stride;
+	b->size = (size_t)a.stride * src_h;
+	b->addr = mmap(NULL, b->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		       fd.fd, 0);
+	if (b->addr == MAP_FAILED)
+		die("mmap");
+	close(fd.fd);
+}
+
+static void setup_ovl(struct dss2_ovl_info *oi, int i, struct buffer *b,
+		      const struct omap_video_timings *t)
+{
+	struct dss2_ovl_cfg *cfg = &oi->cfg;
+	int out_w = src_w, out_h = src_h;
+	int steps = nr_ovls > 1 ? nr_ovls - 1 : 1;
+
+	if (rotation & 1) {
+		out_w = src_h;
+		out_h = src_w;
+	}
+
+	memset(oi, 0, sizeof(*oi));
+	cfg->width = src_w;
+	cfg->height = src_h;
+	cfg->stride = b->stride;
+	cfg->color_mode = OMAP_DSS_COLOR_ARGB32;
+	cfg->global_alpha = 255;
+	cfg->rotation = rotation;
+	cfg->crop.w = src_w;
+	cfg->crop.h = src_h;
+	cfg->win.w = out_w * scale / 100;
+	cfg->win.h = out_h * scale / 100;
+	/* cascade the overlays; dsscomp crops what falls off the screen */
+	if ((int)cfg->win.w < t->x_res)
+		cfg->win.x = i * (t->x_res - (int)cfg->win.w) / steps;
+	if ((int)cfg->win.h < t->y_res)
+		cfg->win.y = i * (t->y_res - (int)cfg->win.h) / steps;
+	cfg->decim.min_x = cfg->decim.min_y = 1;
+	cfg->decim.max_x = cfg->decim.max_y = 255;
+	/* GFX cannot scale or rotate, so those use the video pipelines */
+	cfg->ix = scale != 100 || rotation ? i + 1 : i;
+	cfg->zorder = i;
+	cfg->enabled = 1;
+	cfg->mgr_ix = 0;
+	oi->addressing = OMAP_DSS_BUFADDR_DIRECT;
+	oi->address = b->addr;
+}
+
+static void flip_stats(const char *reset)
+{
+	char line[128];
+	FILE *f;
+
+	f = fopen(FLIP_STATS, reset ? "w" : "r");
+	if (!f) {
+		if (!reset)
+			printf("  driver: no %s\n", FLIP_STATS);
+		return;
+	}
+	if (reset)
+		fputs(reset, f);
+	else
+		while (fgets(line, sizeof(line), f))
+			printf("  driver: %s", line);
+	fclose(f);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: dsscomp_flip [-d display] [-o overlays] [-w width] "
+		"[-h height]\n"
+		"                    [-z scale %%] [-r rotation 0..3] [-t] "
+		"[-f flips/s]\n"
+		"                    [-n flips] [-b buffers per overlay]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct dsscomp_display_info info;
+	const struct omap_video_timings *t = &info.timings;
+	struct dsscomp_platform_info platform;
+	struct dsscomp_setup_dispc_data d;
+	struct dsscomp_vsync_event ev;
+	uint64_t *submit, start_ns, end_ns, frame_ns, submit_ns = 0;
+	uint32_t last_count = 0, vsyncs = 0, gaps = 0, mask;
+	int interval, flips = 0, failed = 0;
+	int fd, ion = -1, opt, i, j;
+	double refresh;
+
+	while ((opt = getopt(argc, argv, "d:o:w:h:z:r:tf:n:b:")) != -1) {
+		switch (opt) {
+		case 'd':
+			display = atoi(optarg);
+			break;
+		case 'o':
+			nr_ovls = atoi(optarg);
+			break;
+		case 'w':
+			src_w = atoi(optarg);
+			break;
+		case 'h':
+			src_h = atoi(optarg);
+			break;
+		case 'z':
+			scale = atoi(optarg);
+			break;
+		case 'r':
+			rotation = atoi(optarg);
+			break;
+		case 't':
+			use_tiler = 1;
+			break;
+		case 'f':
+			fps = atoi(optarg);
+			break;
+		case 'n':
+			nr_flips = atoi(optarg);
+			break;
+		case 'b':
+			nr_bufs = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (nr_ovls < 1 || nr_ovls > ((scale != 100 || rotation) ? 3 : 4) ||
+	    scale < 1 || rotation < 0 || rotation > 3 || fps < 0 ||
+	    nr_flips < 1 || nr_bufs < 1 || nr_bufs > MAX_BUFS)
+		usage();
+	if (rotation && !use_tiler) {
+		fprintf(stderr, "dsscomp_flip: rotation needs TILER 2D "
+			"buffers (-t)\n");
+		return 2;
+	}
+
+	fd = open("/dev/dsscomp", O_RDWR);
+	if (fd < 0)
+		die("/dev/dsscomp");
+
+	memset(&info, 0, sizeof(info));
+	info.ix = display;
+	if (ioctl(fd, DSSCIOC_QUERY_DISPLAY, &info))
+		die("DSSCIOC_QUERY_DISPLAY");
+	if (info.state != OMAP_DSS_DISPLAY_ACTIVE || !t->pixel_clock) {
+		fprintf(stderr, "dsscomp_flip: display%d is not active\n",
+			display);
+		return 1;
+	}
+	if (ioctl(fd, DSSCIOC_QUERY_PLATFORM, &platform))
+		die("DSSCIOC_QUERY_PLATFORM");
+
+	if (!src_w)
+		src_w = t->x_res;
+	if (!src_h)
+		src_h = t->y_res;
+	frame_ns = (uint64_t)(t->x_res + t->hfp + t->hsw + t->hbp) *
+		   (t->y_res + t->vfp + t->vsw + t->vbp) * 1000000 /
+		   t->pixel_clock;
+	refresh = 1e9 / frame_ns;
+	interval = fps ? (int)(refresh / fps + 0.5) : 1;
+	if (interval < 1)
+		interval = 1;
+
+	if (!use_tiler && (size_t)nr_ovls * src_w * 4 * src_h >
+	    platform.tiler1d_slot_size) {
+		fprintf(stderr, "dsscomp_flip: %d overlays of %dx%d do not "
+			"fit a %u byte TILER 1D slot\n", nr_ovls, src_w,
+			src_h, platform.tiler1d_slot_size);
+		return 2;
+	}
+
+	if (use_tiler) {
+		ion = open("/dev/ion", O_RDWR);
+		if (ion < 0)
+			die("/dev/ion");
+	}
+	for (i = 0; i < nr_ovls; i++) {
+		for (j = 0; j < nr_bufs; j++) {
+			if (use_tiler)
+				alloc_2d(ion, &bufs[i][j]);
+			else
+				alloc_1d(&bufs[i][j]);
+			fill(&bufs[i][j], (0x40 << (8 * (i % 3))) * (j + 1));
+		}
+	}
+
+	submit = calloc(nr_flips, sizeof(*submit));
+	if (!submit)
+		die("calloc");
+
+	mask = 1 << info.channel;
+	if (ioctl(fd, DSSCIOC_SET_VSYNC, &mask))
+		die("DSSCIOC_SET_VSYNC");
+
+	flip_stats("0");
+	start_ns = now_ns();
+
+	while (flips < nr_flips) {
+		if (read(fd, &ev, sizeof(ev)) != sizeof(ev))
+			die("read vsync");
+		if (vsyncs && ev.count != last_count + 1)
+			gaps += ev.count - last_count - 1;
+		last_count = ev.count;
+		if (vsyncs++ % interval)
+			continue;
+
+		memset(&d, 0, sizeof(d));
+		d.sync_id = flips;
+		d.num_mgrs = 1;
+		d.mgrs[0].ix = display;
+		d.mgrs[0].alpha_blending = 1;
+		d.num_ovls = nr_ovls;
+		for (i = 0; i < nr_ovls; i++)
+			setup_ovl(&d.ovls[i], i, &bufs[i][flips % nr_bufs], t);
+
+		submit[flips] = now_ns();
+		if (ioctl(fd, DSSCIOC_SETUP_DISPC, &d))
+			failed++;
+		submit[flips] = now_ns() - submit[flips];
+		submit_ns += submit[flips];
+		flips++;
+	}
+	end_ns = now_ns();
+
+	/* let the last flips reach the screen before reading the stats */
+	for (i = 0; i < 3; i++)
+		if (read(fd, &ev, sizeof(ev)) != sizeof(ev))
+			die("read vsync");
+
+	qsort(submit, nr_flips, sizeof(*submit), cmp_u64);
+	printf("display%d %dx%d@%.2f: %d x %dx%d %s overlays, scale %d%%, "
+	       "rotation %d, %d buffers\n", display, t->x_res, t->y_res,
+	       refresh, nr_ovls, src_w, src_h, use_tiler ? "TILER 2D" :
+	       "TILER 1D", scale, rotation * 90, nr_bufs);
+	printf("  flips: %d in %.3f s, %.2f /s, every %d vsyncs, failed %d\n",
+	       flips, (end_ns - start_ns) / 1e9,
+	       flips * 1e9 / (end_ns - start_ns), interval, failed);
+	printf("  vsyncs: %u, not seen by the tool %u\n", vsyncs, gaps);
+	printf("  ioctl us: avg %.1f p50 %.1f p99 %.1f max %.1f\n",
+	       submit_ns / 1e3 / flips, submit[nr_flips / 2] / 1e3,
+	       submit[nr_flips * 99 / 100] / 1e3, submit[nr_flips - 1] / 1e3);
+	flip_stats(NULL);
+
+	return failed ? 1 : 0;
+}